@@ -0,0 +1,1913 @@
+/*
+ * z80 to x86-64 recompiler
+ * (C) agent, 2026
+ *
+ * This work is licensed under the terms of MAME license.
+ * See COPYING file in the top-level directory.
+ *
+ * notes:
+ * - runs on the Cz80 context and is cycle exact to Cz80: ICount is
+ *   updated before every memory access that Cz80 does it for, so
+ *   handlers see the same count, and irqs are taken at the same points.
+ * - blocks are keyed by the host address the code is fetched from
+ *   (CZ80.PC), so SMS bank switching doesn't need a flush, it just
+ *   finds other blocks. Every instruction of a block is an entry, so
+ *   running out of cycles mid block doesn't translate its tail again.
+ * - the z80 registers stay in the context, R is counted at translation
+ *   time and added when leaving a block.
+ * - common instructions are translated, the rest is run by a second
+ *   Cz80 build in step mode (cz80_ops.c), one instruction at a time.
+ * - writes to host memory that has translated code invalidate it
+ *   (32 byte pages). The code itself stays in tcache until a flush, so
+ *   an instruction that writes memory leaves the block if that hit any
+ *   code, like Cz80 which fetches what was just written.
+ * - a block stays in the 4K fetch bank it starts in, and is only made
+ *   if that bank is mapped where pc says. Cz80 keeps fetching whatever
+ *   host memory follows a bank until a jump maps pc again, code there
+ *   is left to the stepper.
+ * - x86-64 only, there's no AArch64 emitter in cpu/drc/ for it yet.
+ */
+#include <stddef.h>
+
+#include "../../pico/pico_int.h"
+#include "../../pico/memory.h"
+#include "compiler.h"
+
+typedef signed char s8;
+
+#define TCACHE_SIZE     (1024*1024)
+#define TCACHE_RESERVE  0x4000 // room one block may need
+#define MAX_BLOCKS      0x2000
+#define MAX_ENTRIES     0x10000
+#define INVAL_LIMIT     32 // writes over code in a page before it's stepped
+#define HASH_SIZE       0x1000
+#define JC_SIZE         0x1000 // jump cache entries
+#define PAGE_SHIFT      CZ80_DRC_PAGE_SHIFT
+#define PAGE_HASH       CZ80_DRC_PAGE_HASH
+#define BLOCK_INSNS     64
+#define BLOCK_BYTES     128
+#define BLOCK_PAGES     ((BLOCK_BYTES + 4) / (1 << PAGE_SHIFT) + 2)
+#define MAX_STUBS       (BLOCK_INSNS * 3)
+
+#define TR_NO   0 // not translated, step and end the block
+#define TR_OK   1
+#define TR_END  2 // block ends here
+#define TR_STEP 3 // not translated, step and go on
+
+INT32 cz80_ops_step(cz80_struc *CPU, INT32 cycles);
+void  cz80_ops_init(cz80_struc *CPU);
+void  cz80_ops_tables(const UINT8 **szp, const UINT8 **sz_bit,
+        const UINT8 **inc, const UINT8 **dec,
+        const UINT8 **add, const UINT8 **sub);
+
+struct block_desc;
+
+struct block_entry {
+  const u8 *src;
+  u8 *code;
+  struct block_desc *block;
+  struct block_entry *next; // hash chain
+};
+
+struct page_link {
+  struct block_desc *block;
+  struct page_link *next, *prev;
+};
+
+struct block_desc {
+  const u8 *src;
+  u32 len;
+  u32 hash;
+  u8 *code;
+  struct block_entry *entries;
+  int nentries;
+  int npages;
+  struct page_link pages[BLOCK_PAGES];
+};
+
+// layout is used by the dispatcher
+struct jc_entry {
+  const u8 *src;
+  u8 *code;
+};
+
+// allocated by cz80_drc_init, so that every emulator instance
+// (see pico/context.c) has its own and only these pointers are swapped
+static u8 *tcache_z80; // TCACHE_SIZE
+static u8 *tcache_ptr;
+static u8 *tcache_blocks; // first block, after the stubs
+
+static struct block_desc *blocks;
+static int block_count;
+static struct block_entry *entries;
+static int entry_count;
+static struct block_entry **hash_table; // HASH_SIZE
+static struct page_link **page_list;    // PAGE_HASH
+static u8 page_inval[PAGE_HASH];
+static struct jc_entry *jc;             // JC_SIZE
+unsigned char cz80_drc_page_code[PAGE_HASH];
+
+// SZP, SZ_BIT, SZHV_inc, SZHV_dec; SZHVC_add and _sub are used in place
+static u8 flag_tabs[4][256];
+static const UINT8 *tab_add, *tab_sub;
+static cz80_struc ops_scratch;
+
+static void (*drc_entry)(cz80_struc *ctx, const u8 *code);
+static u8 *drc_exit;
+static u8 *dispatch;
+static u8 *rd8, *rd16, *wr8, *wr16;
+static int drc_ready;
+static int drc_depth;
+static int flush_pending;
+static u8 code_written; // a write invalidated code, checked after writes
+
+#define page_code cz80_drc_page_code
+
+#define COUNT_OP
+#include "../drc/emit_x86.c"
+
+#define CTX(f)     offsetof(cz80_struc, f)
+#define ICNT       CTX(ICount)
+#define REG_F      CTX(AF)
+#define REG_A      (CTX(AF) + 1)
+#define REG_B      (CTX(BC) + 1)
+#define REG_R      CTX(R)
+
+#define TAB_SZP    0x000
+#define TAB_SZ_BIT 0x100
+#define TAB_INC    0x200
+#define TAB_DEC    0x300
+
+// translated code: rbp = &CZ80, these point to the flag tables
+#define xICNT      xR13 // ICount, in the context only around calls out
+#define xTAB       xR15
+#define xADD       xR14
+#define xSUB       xR12
+
+#define HASH_FUNC(p)   (((uptr)(p) ^ ((uptr)(p) >> 12)) & (HASH_SIZE - 1))
+#define PAGE_FUNC(p)   (((uptr)(p) >> PAGE_SHIFT) & (PAGE_HASH - 1))
+
+// Cz80 r8 index (B C D E H L F A) to the context offset
+static const u8 r8_offs[8] = { 1, 0, 3, 2, 5, 4, 6, 7 };
+#define R8(r)      (CTX(BC) + r8_offs[r])
+
+// --------------------------------------------------------------------
+// x86 emitters not in emit_x86.c, sz is the operand size (1, 2, 4)
+
+// spl, bpl, sil, dil need REX for 8bit access
+static int rex8(int sz, int r)
+{
+  return (sz == 1 && r >= xSP && r <= xDI) ? 2 : 0;
+}
+
+static void emit_osize(int sz)
+{
+  if (sz == 2)
+    EMIT(0x66, u8);
+}
+
+static void emit_imm(int sz, u32 imm)
+{
+  if (sz == 1)
+    EMIT(imm, u8);
+  else if (sz == 2)
+    EMIT(imm, u16);
+  else
+    EMIT(imm, u32);
+}
+
+// <op> [rbp+offs], r; op is the byte form (00 add, 08 or, 20 and, 28 sub,
+// 30 xor, 38 cmp, 84 test, 88 mov)
+static void emit_op_m_r(int sz, int op, int r, int offs)
+{
+  emit_osize(sz);
+  emith_deref_op_(rex8(sz, r), sz == 1 ? op : op + 1, r, xBP, offs);
+}
+
+// group 1 (80/81 /ext): 0 add, 1 or, 4 and, 5 sub, 6 xor, 7 cmp
+static void emit_op_m_imm(int sz, int ext, int offs, u32 imm)
+{
+  emit_osize(sz);
+  emith_deref_op(sz == 1 ? 0x80 : 0x81, ext, xBP, offs);
+  emit_imm(sz, imm);
+}
+
+// group 2 (c0/c1 /ext): 0 rol, 1 ror, 4 shl, 5 shr, 7 sar
+static void emit_shift_r(int sz, int ext, int r, int n)
+{
+  emit_osize(sz);
+  EMIT_REX_IF(rex8(sz, r), 0, r);
+  EMIT_OP(sz == 1 ? 0xc0 : 0xc1);
+  EMIT_MODRM(3, ext, r);
+  EMIT(n, u8);
+}
+
+// r = zero extended [rbp+offs]
+static void emit_load(int sz, int r, int offs)
+{
+  if (sz == 2)
+    emith_deref_op(0x0fb7, r, xBP, offs);
+  else
+    emith_deref_op(0x0fb6, r, xBP, offs);
+}
+
+static void emit_store(int sz, int r, int offs)
+{
+  emit_op_m_r(sz, 0x88, r, offs);
+}
+
+static void emit_store_imm(int sz, int offs, u32 imm)
+{
+  emit_osize(sz);
+  emith_deref_op(sz == 1 ? 0xc6 : 0xc7, 0, xBP, offs);
+  emit_imm(sz, imm);
+}
+
+// movzx d, s (8 or 16 bit)
+static void emit_ext_r(int sz, int d, int s)
+{
+  EMIT_REX_IF(rex8(sz, s), d, s);
+  EMIT(0x0f, u8);
+  EMIT_OP(0xb6 + (sz == 2));
+  EMIT_MODRM(3, d, s);
+}
+
+// <op> r, [base + index*(1 << scale)], base can't be rbp/r13
+static void emit_op_sib(int w, int op, int r, int base, int index, int scale)
+{
+  EMIT_REX_IF(w, r, base);
+  if (op > 0xff)
+    EMIT(op >> 8, u8);
+  EMIT_OP(op & 0xff);
+  EMIT_MODRM(0, r, 4);
+  EMIT_SIB(scale, index, base);
+}
+
+// movzx r, byte [tab + index + offs]
+static void emit_tab(int r, int tab, int index, int offs)
+{
+  EMIT_REX_IF(0, r, tab);
+  EMIT(0x0f, u8);
+  EMIT_OP(0xb6);
+  EMIT_MODRM(offs ? 2 : 0, r, 4);
+  EMIT_SIB(0, index, tab);
+  if (offs)
+    EMIT(offs, u32);
+}
+
+static void emit_jump_far(const void *f)
+{
+  emith_move_r_ptr_imm(xR11, f);
+  emith_jump_reg(xR11);
+}
+
+// --------------------------------------------------------------------
+// translation state
+
+static struct {
+  const u8 *op;      // current instruction
+  const u8 *p;       // next byte
+  int n;
+  const u8 *insn_src[BLOCK_INSNS];
+  u8 *insn_code[BLOCK_INSNS];
+  u8 insn_r[BLOCK_INSNS];
+  int r;             // R increments not yet added to the context
+  int pre;           // cycles to take before the next memory access
+  int used;          // cycles of this insn already taken
+  int data;          // HL, IX or IY
+  int xy;            // DD/FD prefixed
+  int wrote;         // insn writes memory
+  int nstubs;
+  struct {
+    u8 *jmp;
+    const u8 *pc;
+    int r;
+  } stubs[MAX_STUBS];
+} tr;
+
+static u32 fetch8(void)
+{
+  return *tr.p++;
+}
+
+static u32 fetch16(void)
+{
+  u32 v = tr.p[0] | (tr.p[1] << 8);
+  tr.p += 2;
+  return v;
+}
+
+static void emit_add_r(int r)
+{
+  if (r & 0xff)
+    emit_op_m_imm(1, 0, REG_R, r & 0xff);
+}
+
+// sub ICount, pre: what Cz80 takes before a memory access
+static void emit_sync(void)
+{
+  if (tr.pre) {
+    emith_sub_r_imm(xICNT, tr.pre);
+    tr.used += tr.pre;
+    tr.pre = 0;
+  }
+}
+
+// take the rest of cyc, exit at host pc if out of cycles
+static void emit_cycles(int cyc, const u8 *pc)
+{
+  emith_sub_r_imm(xICNT, cyc - tr.used);
+  tr.stubs[tr.nstubs].jmp = tcache_ptr;
+  tr.stubs[tr.nstubs].pc = pc;
+  tr.stubs[tr.nstubs].r = tr.r;
+  tr.nstubs++;
+  emith_jump_cond(ICOND_JLE, tcache_ptr);
+}
+
+// same, pc is in rax and R is in the context
+static void emit_cycles_rax(int cyc)
+{
+  emith_sub_r_imm(xICNT, cyc - tr.used);
+  emith_jump_cond(ICOND_JLE, drc_exit);
+}
+
+// leave for pc if this insn's writes hit translated code
+static void emit_wcheck(const u8 *pc)
+{
+  emith_move_r_ptr_imm(xCX, &code_written);
+  EMIT_OP(0x80);
+  EMIT_MODRM(0, 7, xCX);                      // cmp byte [rcx], 0
+  EMIT(0, u8);
+  tr.stubs[tr.nstubs].jmp = tcache_ptr;
+  tr.stubs[tr.nstubs].pc = pc;
+  tr.stubs[tr.nstubs].r = tr.r;
+  tr.nstubs++;
+  emith_jump_cond(ICOND_JNE, tcache_ptr);
+}
+
+// continue at a known host pc, cycles are already accounted
+static void emit_goto(const u8 *pc)
+{
+  int i;
+  for (i = 0; i < tr.n; i++) {
+    if (tr.insn_src[i] == pc) {
+      emit_add_r(tr.r - tr.insn_r[i]);
+      emith_jump(tr.insn_code[i]);
+      return;
+    }
+  }
+  emit_add_r(tr.r);
+  emith_move_r_ptr_imm(xAX, pc);
+  emith_jump(dispatch);
+}
+
+// pc in rax, R in the context: stay in the block if pc is one of its
+// instructions, else dispatch
+static void emit_goto_rax(const u8 *pc)
+{
+  u8 *jmiss;
+  int i;
+  for (i = 0; i < tr.n; i++) {
+    if (tr.insn_src[i] == pc) {
+      if (tr.wrote) {
+        // the target may have just been written, the dispatcher knows
+        emith_move_r_ptr_imm(xCX, &code_written);
+        EMIT_OP(0x80);
+        EMIT_MODRM(0, 7, xCX);                // cmp byte [rcx], 0
+        EMIT(0, u8);
+        emith_jump_cond(ICOND_JNE, dispatch);
+      }
+      emith_move_r_ptr_imm(xDX, pc);
+      EMIT_OP_MODRM_PTR(0x39, 3, xDX, xAX);   // cmp rax, rdx
+      JMP8_POS(jmiss);
+      emit_add_r(-tr.insn_r[i]);
+      emith_jump(tr.insn_code[i]);
+      JMP8_EMIT(ICOND_JNE, jmiss);
+      break;
+    }
+  }
+  emith_jump(dispatch);
+}
+
+// rax = host pc of z80 address a (SET_PC), eax holds a if a < 0
+static void emit_set_pc(int a)
+{
+  if (a >= 0) {
+    emith_ctx_read_ptr(xAX, CTX(Fetch) + (a >> CZ80_FETCH_SFT) * sizeof(FPTR));
+    emith_ctx_write_ptr(xAX, CTX(BasePC));
+    emith_add_r_ptr_imm(xAX, a);
+  }
+  else {
+    emith_move_r_r(xCX, xAX);
+    emith_lsr(xCX, xCX, CZ80_FETCH_SFT);
+    EMIT_REX_IF(1, xDX, xBP);
+    EMIT_OP(0x8b);
+    EMIT_MODRM(2, xDX, 4);
+    EMIT_SIB(3, xCX, xBP);                    // mov rdx, [rbp + rcx*8 + Fetch]
+    EMIT(CTX(Fetch), u32);
+    emith_ctx_write_ptr(xDX, CTX(BasePC));
+    EMIT_OP_MODRM_PTR(0x01, 3, xDX, xAX);     // add rax, rdx
+  }
+}
+
+// host pc a z80 address has now, for staying in the block
+static const u8 *host_pc(u32 a)
+{
+  return (const u8 *)(CZ80.Fetch[a >> CZ80_FETCH_SFT] + a);
+}
+
+// --------------------------------------------------------------------
+// memory
+
+// edi = (HL), (IX+d) or (IY+d)
+static void emit_mem_addr(void)
+{
+  emit_load(2, xDI, tr.data);
+  if (tr.xy) {
+    s8 d = fetch8();
+    if (d != 0)
+      emith_add_r_imm(xDI, d);
+  }
+}
+
+// eax = [edi]
+static void emit_read8(void)
+{
+  emit_sync();
+  emith_call(rd8);
+}
+
+// [edi] = esi
+static void emit_write8(void)
+{
+  emit_sync();
+  emith_call(wr8);
+  tr.wrote = 1;
+}
+
+static void emit_read16(void)
+{
+  emit_sync();
+  emith_call(rd16);
+}
+
+static void emit_write16(void)
+{
+  emit_sync();
+  emith_call(wr16);
+  tr.wrote = 1;
+}
+
+// PUSH_16, value in esi
+static void emit_push(void)
+{
+  emit_load(2, xDI, CTX(SP));
+  emith_sub_r_imm(xDI, 2);
+  emit_store(2, xDI, CTX(SP));
+  emit_write16();
+}
+
+// POP_16 to eax
+static void emit_pop(void)
+{
+  emit_load(2, xDI, CTX(SP));
+  emith_move_r_r(xBX, xDI);
+  emit_read16();
+  emith_add_r_imm(xBX, 2);
+  emit_store(2, xBX, CTX(SP));
+}
+
+// --------------------------------------------------------------------
+// flags
+
+// A op= edx; kind: ADD ADC SUB SBC AND XOR OR CP
+static void emit_alu(int kind)
+{
+  static const u8 x86op[8] = { 0, 0, 0, 0, 0x20, 0x30, 0x08, 0 };
+
+  switch (kind) {
+  case 0: case 2: case 7:
+    emit_load(1, xCX, REG_A);
+    emith_move_r_r(xAX, xCX);
+    if (kind == 0)
+      emith_add_r_r(xAX, xDX);
+    else
+      emith_sub_r_r(xAX, xDX);
+    emit_ext_r(1, xAX, xAX);
+    if (kind != 7)
+      emit_store(1, xAX, REG_A);
+    emith_lsl(xCX, xCX, 8);
+    emith_or_r_r(xCX, xAX);
+    emit_tab(xAX, kind == 0 ? xADD : xSUB, xCX, 0);
+    if (kind == 7) {
+      // CP: X and Y from the operand
+      emith_and_r_imm(xAX, ~0x28);
+      emith_and_r_imm(xDX, 0x28);
+      emith_or_r_r(xAX, xDX);
+    }
+    emit_store(1, xAX, REG_F);
+    break;
+  case 1: case 3:
+    emit_load(1, xCX, REG_A);
+    emit_load(1, xSI, REG_F);
+    emith_and_r_imm(xSI, 1);
+    emith_move_r_r(xAX, xCX);
+    if (kind == 1) {
+      emith_add_r_r(xAX, xDX);
+      emith_add_r_r(xAX, xSI);
+    }
+    else {
+      emith_sub_r_r(xAX, xDX);
+      emith_sub_r_r(xAX, xSI);
+    }
+    emit_ext_r(1, xAX, xAX);
+    emit_store(1, xAX, REG_A);
+    emith_lsl(xSI, xSI, 16);
+    emith_lsl(xCX, xCX, 8);
+    emith_or_r_r(xCX, xSI);
+    emith_or_r_r(xCX, xAX);
+    emit_tab(xAX, kind == 1 ? xADD : xSUB, xCX, 0);
+    emit_store(1, xAX, REG_F);
+    break;
+  default:
+    emit_op_m_r(1, x86op[kind], xDX, REG_A);
+    emit_load(1, xAX, REG_A);
+    emit_tab(xAX, xTAB, xAX, TAB_SZP);
+    if (kind == 4)
+      emith_or_r_imm(xAX, 0x10);              // HF
+    emit_store(1, xAX, REG_F);
+    break;
+  }
+}
+
+// F for INC/DEC, result in eax
+static void emit_incdec_flags(int dec)
+{
+  emit_tab(xCX, xTAB, xAX, dec ? TAB_DEC : TAB_INC);
+  emit_load(1, xDX, REG_F);
+  emith_and_r_imm(xDX, 1);
+  emith_or_r_r(xCX, xDX);
+  emit_store(1, xCX, REG_F);
+}
+
+// CB rotates and shifts of eax, result in ecx, sets F
+static void emit_rot(int type)
+{
+  emith_move_r_r(xCX, xAX);
+  switch (type) {
+  case 0: emit_shift_r(1, 0, xCX, 1); break;  // RLC
+  case 1: emit_shift_r(1, 1, xCX, 1); break;  // RRC
+  case 2:                                     // RL
+    emith_lsl(xCX, xCX, 1);
+    emit_load(1, xSI, REG_F);
+    emith_and_r_imm(xSI, 1);
+    emith_or_r_r(xCX, xSI);
+    break;
+  case 3:                                     // RR
+    emith_lsr(xCX, xCX, 1);
+    emit_load(1, xSI, REG_F);
+    emith_lsl(xSI, xSI, 7);
+    emith_and_r_imm(xSI, 0x80);
+    emith_or_r_r(xCX, xSI);
+    break;
+  case 4: emith_lsl(xCX, xCX, 1); break;      // SLA
+  case 5: emit_shift_r(1, 7, xCX, 1); break;  // SRA
+  case 6:                                     // SLL
+    emith_lsl(xCX, xCX, 1);
+    emith_or_r_imm(xCX, 1);
+    break;
+  case 7: emith_lsr(xCX, xCX, 1); break;      // SRL
+  }
+  emit_ext_r(1, xCX, xCX);
+  // carry is the bit shifted out
+  if (type & 1)
+    emith_and_r_imm(xAX, 1);
+  else
+    emith_lsr(xAX, xAX, 7);
+  emit_tab(xDX, xTAB, xCX, TAB_SZP);
+  emith_or_r_r(xAX, xDX);
+  emit_store(1, xAX, REG_F);
+}
+
+// BIT n of eax; xy: X and Y from the address high byte (ebx)
+static void emit_bit(int n, int xy)
+{
+  emith_and_r_imm(xAX, 1 << n);
+  emit_tab(xAX, xTAB, xAX, TAB_SZ_BIT);
+  emit_load(1, xCX, REG_F);
+  emith_and_r_imm(xCX, 1);
+  emith_or_r_r(xAX, xCX);
+  emith_or_r_imm(xAX, 0x10);
+  if (xy) {
+    emith_and_r_imm(xAX, ~0x28);
+    emith_move_r_r(xCX, xBX);
+    emith_lsr(xCX, xCX, 8);
+    emith_and_r_imm(xCX, 0x28);
+    emith_or_r_r(xAX, xCX);
+  }
+  emit_store(1, xAX, REG_F);
+}
+
+// --------------------------------------------------------------------
+// instructions
+
+static void emit_interp(const u8 *next);
+
+// mask of the F bit a condition tests, taken if set for odd cc
+static const u8 cond_mask[8] = { 0x40, 0x40, 0x01, 0x01, 0x04, 0x04, 0x80, 0x80 };
+
+// test the condition, returns a jcc to patch to the not taken path
+static u8 *emit_cond(int cc)
+{
+  u8 *j;
+  emith_deref_op(0xf6, 0, xBP, REG_F);        // test byte [F], mask
+  EMIT(cond_mask[cc], u8);
+  j = tcache_ptr;
+  emith_jump_cond((cc & 1) ? ICOND_JE : ICOND_JNE, tcache_ptr);
+  return j;
+}
+
+// CALL nn / RST, after the operands were read
+static void emit_call(u32 a, int cyc)
+{
+  emith_move_r_ptr_imm(xSI, tr.p);
+  emith_deref_op_(1, 0x2b, xSI, xBP, CTX(BasePC)); // sub rsi, [BasePC]
+  emit_push();
+  emit_add_r(tr.r);
+  emit_set_pc(a);
+  emit_cycles_rax(cyc);
+  emit_goto_rax(host_pc(a));
+}
+
+// JP nn
+static void emit_jp(u32 a, int cyc)
+{
+  emit_add_r(tr.r);
+  emit_set_pc(a);
+  emit_cycles_rax(cyc);
+  emit_goto_rax(host_pc(a));
+}
+
+// RET, after the pre cycles
+static void emit_ret(int cyc)
+{
+  emit_pop();
+  emit_set_pc(-1);
+  emit_add_r(tr.r);
+  emit_cycles_rax(cyc);
+  emith_jump(dispatch);
+}
+
+static int tr_main(u32 op)
+{
+  const u8 *t;
+  int x = tr.xy ? 4 : 0;
+  int r, s, cc, used, pre;
+  u8 *j;
+  u32 a;
+
+  switch (op >> 6) {
+  case 1:
+    // LD r,r'
+    if (op == 0x76)
+      return TR_NO; // HALT
+    r = (op >> 3) & 7;
+    s = op & 7;
+    if (r == 6) {
+      emit_mem_addr();
+      emit_load(1, xSI, R8(s));
+      emit_write8();
+      emit_cycles(x ? 19 : 7, tr.p);
+    }
+    else if (s == 6) {
+      emit_mem_addr();
+      emit_read8();
+      emit_store(1, xAX, R8(r));
+      emit_cycles(x ? 19 : 7, tr.p);
+    }
+    else {
+      if (x && (r == 4 || r == 5 || s == 4 || s == 5))
+        return TR_STEP; // IXh, IXl
+      if (r != s) {
+        emit_load(1, xAX, R8(s));
+        emit_store(1, xAX, R8(r));
+      }
+      emit_cycles(4 + x, tr.p);
+    }
+    return TR_OK;
+
+  case 2:
+    // ALU A,r
+    s = op & 7;
+    if (s == 6) {
+      emit_mem_addr();
+      emit_read8();
+      emith_move_r_r(xDX, xAX);
+      emit_alu((op >> 3) & 7);
+      emit_cycles(x ? 19 : 7, tr.p);
+      return TR_OK;
+    }
+    if (x && (s == 4 || s == 5))
+      return TR_STEP;
+    emit_load(1, xDX, R8(s));
+    emit_alu((op >> 3) & 7);
+    emit_cycles(4 + x, tr.p);
+    return TR_OK;
+  }
+
+  // 8 bit INC, DEC, LD r,n
+  r = (op >> 3) & 7;
+  if (op < 0x40 && (op & 7) >= 4 && (op & 7) <= 6) {
+    if (r == 6) {
+      emit_mem_addr();
+      if ((op & 7) == 6) {
+        emith_move_r_imm(xSI, fetch8());
+        emit_write8();
+        emit_cycles(x ? 19 : 10, tr.p);
+        return TR_OK;
+      }
+      tr.pre += x ? 8 : 0;
+      emith_move_r_r(xBX, xDI);
+      emit_read8();
+      if (op & 1)
+        emith_sub_r_imm(xAX, 1);
+      else
+        emith_add_r_imm(xAX, 1);
+      emit_ext_r(1, xAX, xAX);
+      emit_incdec_flags(op & 1);
+      emith_move_r_r(xDI, xBX);
+      emith_move_r_r(xSI, xAX);
+      emit_write8();
+      emit_cycles(x ? 23 : 11, tr.p);
+      return TR_OK;
+    }
+    if (x && (r == 4 || r == 5))
+      return TR_STEP;
+    if ((op & 7) == 6) {
+      emit_store_imm(1, R8(r), fetch8());
+      emit_cycles(7 + x, tr.p);
+      return TR_OK;
+    }
+    emit_op_m_imm(1, (op & 1) ? 5 : 0, R8(r), 1);
+    emit_load(1, xAX, R8(r));
+    emit_incdec_flags(op & 1);
+    emit_cycles(4 + x, tr.p);
+    return TR_OK;
+  }
+
+  switch (op) {
+  case 0x00: // NOP
+    emit_cycles(4 + x, tr.p);
+    return TR_OK;
+
+  case 0x01: case 0x11: case 0x21: case 0x31: // LD rr,nn
+    a = fetch16();
+    emit_store_imm(2, op == 0x31 ? CTX(SP) : op == 0x21 ? tr.data : CTX(BC) + ((op >> 3) & 6), a);
+    emit_cycles(10 + x, tr.p);
+    return TR_OK;
+
+  case 0x09: case 0x19: case 0x29: case 0x39: // ADD HL,rr
+    emit_load(2, xCX, tr.data);
+    emit_load(2, xDX, op == 0x39 ? CTX(SP) : op == 0x29 ? tr.data : CTX(BC) + ((op >> 3) & 6));
+    emith_move_r_r(xAX, xCX);
+    emith_add_r_r(xAX, xDX);
+    emit_store(2, xAX, tr.data);
+    emith_eor_r_r(xCX, xDX);
+    emith_eor_r_r(xCX, xAX);
+    emith_lsr(xCX, xCX, 8);
+    emith_and_r_imm(xCX, 0x10);               // HF
+    emith_move_r_r(xDX, xAX);
+    emith_lsr(xDX, xDX, 16);
+    emith_or_r_r(xCX, xDX);                   // CF
+    emith_lsr(xAX, xAX, 8);
+    emith_and_r_imm(xAX, 0x28);
+    emith_or_r_r(xCX, xAX);
+    emit_load(1, xAX, REG_F);
+    emith_and_r_imm(xAX, 0xc4);
+    emith_or_r_r(xAX, xCX);
+    emit_store(1, xAX, REG_F);
+    emit_cycles(11 + x, tr.p);
+    return TR_OK;
+
+  case 0x02: case 0x12: // LD (BC),A / LD (DE),A
+    emit_load(2, xDI, CTX(BC) + ((op >> 3) & 6));
+    emit_load(1, xSI, REG_A);
+    emit_write8();
+    emit_cycles(7 + x, tr.p);
+    return TR_OK;
+
+  case 0x0a: case 0x1a: // LD A,(BC) / LD A,(DE)
+    emit_load(2, xDI, CTX(BC) + ((op >> 3) & 6));
+    emit_read8();
+    emit_store(1, xAX, REG_A);
+    emit_cycles(7 + x, tr.p);
+    return TR_OK;
+
+  case 0x22: // LD (nn),HL
+    emith_move_r_imm(xDI, fetch16());
+    emit_load(2, xSI, tr.data);
+    emit_write16();
+    emit_cycles(16 + x, tr.p);
+    return TR_OK;
+
+  case 0x2a: // LD HL,(nn)
+    emith_move_r_imm(xDI, fetch16());
+    emit_read16();
+    emit_store(2, xAX, tr.data);
+    emit_cycles(16 + x, tr.p);
+    return TR_OK;
+
+  case 0x32: // LD (nn),A
+    emith_move_r_imm(xDI, fetch16());
+    emit_load(1, xSI, REG_A);
+    emit_write8();
+    emit_cycles(13 + x, tr.p);
+    return TR_OK;
+
+  case 0x3a: // LD A,(nn)
+    emith_move_r_imm(xDI, fetch16());
+    emit_read8();
+    emit_store(1, xAX, REG_A);
+    emit_cycles(13 + x, tr.p);
+    return TR_OK;
+
+  case 0x03: case 0x13: case 0x23: case 0x33: // INC rr
+  case 0x0b: case 0x1b: case 0x2b: case 0x3b: // DEC rr
+    s = op & 0x30;
+    emit_op_m_imm(2, (op & 8) ? 5 : 0,
+      s == 0x30 ? CTX(SP) : s == 0x20 ? tr.data : CTX(BC) + (s >> 3), 1);
+    emit_cycles(6 + x, tr.p);
+    return TR_OK;
+
+  case 0x07: // RLCA
+    emit_load(1, xAX, REG_A);
+    emit_shift_r(1, 0, xAX, 1);
+    emit_store(1, xAX, REG_A);
+    emith_and_r_imm(xAX, 0x29);
+    goto rot_a_flags;
+  case 0x0f: // RRCA
+    emit_load(1, xAX, REG_A);
+    emith_move_r_r(xDX, xAX);
+    emith_and_r_imm(xDX, 1);
+    emit_shift_r(1, 1, xAX, 1);
+    goto rot_a_store;
+  case 0x17: // RLA
+    emit_load(1, xAX, REG_A);
+    emith_move_r_r(xDX, xAX);
+    emith_lsr(xDX, xDX, 7);
+    emith_lsl(xAX, xAX, 1);
+    emit_load(1, xCX, REG_F);
+    emith_and_r_imm(xCX, 1);
+    emith_or_r_r(xAX, xCX);
+    goto rot_a_store;
+  case 0x1f: // RRA
+    emit_load(1, xAX, REG_A);
+    emith_move_r_r(xDX, xAX);
+    emith_and_r_imm(xDX, 1);
+    emith_lsr(xAX, xAX, 1);
+    emit_load(1, xCX, REG_F);
+    emith_lsl(xCX, xCX, 7);
+    emith_or_r_r(xAX, xCX);
+  rot_a_store:
+    // edx = carry
+    emit_store(1, xAX, REG_A);
+    emith_and_r_imm(xAX, 0x28);
+    emith_or_r_r(xAX, xDX);
+  rot_a_flags:
+    emit_load(1, xCX, REG_F);
+    emith_and_r_imm(xCX, 0xc4);
+    emith_or_r_r(xCX, xAX);
+    emit_store(1, xCX, REG_F);
+    emit_cycles(4 + x, tr.p);
+    return TR_OK;
+
+  case 0x27: // DAA
+    return TR_STEP;
+
+  case 0x2f: // CPL
+    emit_op_m_imm(1, 6, REG_A, 0xff);
+    emit_load(1, xAX, REG_A);
+    emith_and_r_imm(xAX, 0x28);
+    emith_or_r_imm(xAX, 0x12);
+    emit_load(1, xCX, REG_F);
+    emith_and_r_imm(xCX, 0xc5);
+    goto f_store;
+  case 0x37: // SCF
+    emit_load(1, xAX, REG_A);
+    emith_and_r_imm(xAX, 0x28);
+    emith_or_r_imm(xAX, 1);
+    emit_load(1, xCX, REG_F);
+    emith_and_r_imm(xCX, 0xc4);
+    goto f_store;
+  case 0x3f: // CCF
+    emit_load(1, xCX, REG_F);
+    emith_move_r_r(xDX, xCX);
+    emith_and_r_imm(xDX, 1);
+    emith_lsl(xDX, xDX, 4);
+    emith_and_r_imm(xCX, 0xc5);
+    emith_or_r_r(xCX, xDX);
+    emith_eor_r_imm(xCX, 1);
+    emit_load(1, xAX, REG_A);
+    emith_and_r_imm(xAX, 0x28);
+  f_store:
+    emith_or_r_r(xCX, xAX);
+    emit_store(1, xCX, REG_F);
+    emit_cycles(4 + x, tr.p);
+    return TR_OK;
+
+  case 0x08: // EX AF,AF'
+    emit_load(2, xAX, CTX(AF));
+    emit_load(2, xCX, CTX(AF2));
+    emit_store(2, xCX, CTX(AF));
+    emit_store(2, xAX, CTX(AF2));
+    emit_cycles(4 + x, tr.p);
+    return TR_OK;
+
+  case 0xd9: // EXX
+    for (s = 0; s < 3; s++) {
+      emit_load(2, xAX, CTX(BC) + s * 2);
+      emit_load(2, xCX, CTX(BC2) + s * 2);
+      emit_store(2, xCX, CTX(BC) + s * 2);
+      emit_store(2, xAX, CTX(BC2) + s * 2);
+    }
+    emit_cycles(4 + x, tr.p);
+    return TR_OK;
+
+  case 0xeb: // EX DE,HL, never IX
+    emit_load(2, xAX, CTX(DE));
+    emit_load(2, xCX, CTX(HL));
+    emit_store(2, xCX, CTX(DE));
+    emit_store(2, xAX, CTX(HL));
+    emit_cycles(4 + x, tr.p);
+    return TR_OK;
+
+  case 0xe3: // EX (SP),HL
+    emit_load(2, xDI, CTX(SP));
+    emith_move_r_r(xBX, xDI);
+    emit_read16();
+    emit_load(2, xSI, tr.data);
+    emit_store(2, xAX, tr.data);
+    emith_move_r_r(xDI, xBX);
+    emit_write16();
+    emit_cycles(19 + x, tr.p);
+    return TR_OK;
+
+  case 0xf9: // LD SP,HL
+    emit_load(2, xAX, tr.data);
+    emit_store(2, xAX, CTX(SP));
+    emit_cycles(6 + x, tr.p);
+    return TR_OK;
+
+  case 0xc1: case 0xd1: case 0xe1: case 0xf1: // POP
+    emit_pop();
+    emit_store(2, xAX, op == 0xf1 ? CTX(AF) : op == 0xe1 ? tr.data : CTX(BC) + ((op >> 3) & 6));
+    emit_cycles(10 + x, tr.p);
+    return TR_OK;
+
+  case 0xc5: case 0xd5: case 0xe5: case 0xf5: // PUSH
+    emit_load(2, xSI, op == 0xf5 ? CTX(AF) : op == 0xe5 ? tr.data : CTX(BC) + ((op >> 3) & 6));
+    emit_push();
+    emit_cycles(11 + x, tr.p);
+    return TR_OK;
+
+  case 0xc6: case 0xce: case 0xd6: case 0xde: // ALU A,n
+  case 0xe6: case 0xee: case 0xf6: case 0xfe:
+    emith_move_r_imm(xDX, fetch8());
+    emit_alu((op >> 3) & 7);
+    emit_cycles(7 + x, tr.p);
+    return TR_OK;
+
+  case 0xd3: // OUT (n),A
+    emit_load(1, xDI, REG_A);
+    emith_lsl(xDI, xDI, 8);
+    emith_or_r_imm(xDI, fetch8());
+    emit_load(1, xSI, REG_A);
+    emit_sync();
+    emith_ctx_write(xICNT, ICNT);
+    emith_call_ctx(CTX(OUT_Port));
+    emith_ctx_read(xICNT, ICNT);
+    emit_cycles(11 + x, tr.p);
+    return TR_OK;
+
+  case 0xdb: // IN A,(n)
+    emit_load(1, xDI, REG_A);
+    emith_lsl(xDI, xDI, 8);
+    emith_or_r_imm(xDI, fetch8());
+    emit_sync();
+    emith_ctx_write(xICNT, ICNT);
+    emith_call_ctx(CTX(IN_Port));
+    emith_ctx_read(xICNT, ICNT);
+    emit_store(1, xAX, REG_A);
+    emit_cycles(11 + x, tr.p);
+    return TR_OK;
+
+  case 0xf3: // DI
+    emit_store_imm(2, CTX(IFF), 0);
+    emit_cycles(4 + x, tr.p);
+    return TR_OK;
+
+  case 0xfb: // EI, irqs may come after the next insn
+    return TR_NO;
+
+  // branches
+  case 0x10: // DJNZ
+    t = tr.p + 1 + (s8)tr.p[0];
+    tr.p++;
+    emit_op_m_imm(1, 5, REG_B, 1);
+    j = tcache_ptr;
+    emith_jump_cond(ICOND_JE, tcache_ptr);
+    emit_cycles(13 + x, t);
+    emit_goto(t);
+    emith_jump_patch(j, tcache_ptr);
+    emit_cycles(8 + x, tr.p);
+    return TR_OK;
+
+  case 0x18: // JR
+    t = tr.p + 1 + (s8)tr.p[0];
+    tr.p++;
+    emit_cycles(12 + x, t);
+    emit_goto(t);
+    return TR_END;
+
+  case 0x20: case 0x28: case 0x30: case 0x38: // JR cc
+    t = tr.p + 1 + (s8)tr.p[0];
+    tr.p++;
+    j = emit_cond((op >> 3) & 3);
+    emit_cycles(12 + x, t);
+    emit_goto(t);
+    emith_jump_patch(j, tcache_ptr);
+    emit_cycles(7 + x, tr.p);
+    return TR_OK;
+
+  case 0xc3: // JP nn
+    emit_jp(fetch16(), 10 + x);
+    return TR_END;
+
+  case 0xe9: // JP (HL)
+    emit_load(2, xAX, tr.data);
+    emit_set_pc(-1);
+    emit_add_r(tr.r);
+    emit_cycles_rax(4 + x);
+    emith_jump(dispatch);
+    return TR_END;
+
+  case 0xcd: // CALL nn
+    a = fetch16();
+    emit_call(a, 17 + x);
+    return TR_END;
+
+  case 0xc9: // RET
+    emit_ret(10 + x);
+    return TR_END;
+
+  case 0xc7: case 0xcf: case 0xd7: case 0xdf: // RST
+  case 0xe7: case 0xef: case 0xf7: case 0xff:
+    emit_call(op & 0x38, 11 + x);
+    return TR_END;
+  }
+
+  cc = (op >> 3) & 7;
+  switch (op & 7) {
+  case 0: // RET cc
+    j = emit_cond(cc);
+    used = tr.used; pre = tr.pre;
+    tr.pre += 1;
+    emit_ret(11 + x);
+    tr.used = used; tr.pre = pre;
+    emith_jump_patch(j, tcache_ptr);
+    emit_cycles(5 + x, tr.p);
+    return TR_OK;
+  case 2: // JP cc,nn
+    a = fetch16();
+    j = emit_cond(cc);
+    emit_jp(a, 10 + x);
+    emith_jump_patch(j, tcache_ptr);
+    emit_cycles(10 + x, tr.p);
+    return TR_OK;
+  case 4: // CALL cc,nn
+    a = fetch16();
+    j = emit_cond(cc);
+    used = tr.used; pre = tr.pre;
+    emit_call(a, 17 + x);
+    tr.used = used; tr.pre = pre;
+    emith_jump_patch(j, tcache_ptr);
+    emit_cycles(10 + x, tr.p);
+    return TR_OK;
+  }
+  return TR_NO;
+}
+
+static int tr_cb(void)
+{
+  u32 op = fetch8();
+  int r = op & 7, n = (op >> 3) & 7;
+
+  tr.r++;
+  if (r != 6) {
+    switch (op >> 6) {
+    case 0:
+      emit_load(1, xAX, R8(r));
+      emit_rot(n);
+      emit_store(1, xCX, R8(r));
+      break;
+    case 1:
+      emit_load(1, xAX, R8(r));
+      emit_bit(n, 0);
+      break;
+    case 2:
+      emit_op_m_imm(1, 4, R8(r), ~(1 << n) & 0xff);
+      break;
+    case 3:
+      emit_op_m_imm(1, 1, R8(r), 1 << n);
+      break;
+    }
+    emit_cycles(8, tr.p);
+    return TR_OK;
+  }
+
+  emit_load(2, xDI, CTX(HL));
+  emith_move_r_r(xBX, xDI);
+  emit_read8();
+  switch (op >> 6) {
+  case 0:
+    emit_rot(n);
+    emith_move_r_r(xSI, xCX);
+    break;
+  case 1:
+    emit_bit(n, 0);
+    emit_cycles(12, tr.p);
+    return TR_OK;
+  case 2:
+    emith_and_r_imm(xAX, ~(1 << n));
+    emith_move_r_r(xSI, xAX);
+    break;
+  case 3:
+    emith_or_r_imm(xAX, 1 << n);
+    emith_move_r_r(xSI, xAX);
+    break;
+  }
+  emith_move_r_r(xDI, xBX);
+  emit_write8();
+  emit_cycles(15, tr.p);
+  return TR_OK;
+}
+
+// DD CB d op / FD CB d op
+static int tr_xycb(void)
+{
+  int r, n, op;
+
+  emit_mem_addr();
+  op = fetch8();
+  r = op & 7;
+  n = (op >> 3) & 7;
+  tr.r++;
+
+  emit_ext_r(2, xDI, xDI);
+  emith_move_r_r(xBX, xDI);
+  emit_read8();
+  switch (op >> 6) {
+  case 0:
+    emit_rot(n);
+    emith_move_r_r(xSI, xCX);
+    break;
+  case 1:
+    emit_bit(n, 1);
+    emit_cycles(20, tr.p);
+    return TR_OK;
+  case 2:
+    emith_and_r_imm(xAX, ~(1 << n));
+    emith_move_r_r(xSI, xAX);
+    break;
+  case 3:
+    emith_or_r_imm(xAX, 1 << n);
+    emith_move_r_r(xSI, xAX);
+    break;
+  }
+  // undocumented: the result also goes to a register
+  if (r != 6)
+    emit_store(1, xSI, R8(r));
+  emith_move_r_r(xDI, xBX);
+  emit_write8();
+  emit_cycles(23, tr.p);
+  return TR_OK;
+}
+
+// ADC HL,rr / SBC HL,rr
+static void emit_adc16(int sub, int offs)
+{
+  emit_load(2, xCX, CTX(HL));
+  emit_load(2, xDX, offs);
+  emit_load(1, xSI, REG_F);
+  emith_and_r_imm(xSI, 1);
+  emith_move_r_r(xAX, xCX);
+  if (sub) {
+    emith_sub_r_r(xAX, xDX);
+    emith_sub_r_r(xAX, xSI);
+  }
+  else {
+    emith_add_r_r(xAX, xDX);
+    emith_add_r_r(xAX, xSI);
+  }
+  emit_store(2, xAX, CTX(HL));
+  emith_move_r_r(xDI, xCX);
+  emith_eor_r_r(xDI, xAX);
+  emith_eor_r_r(xDI, xDX);
+  emith_lsr(xDI, xDI, 8);
+  emith_and_r_imm(xDI, 0x10);                 // HF
+  emith_move_r_r(xSI, xAX);
+  emith_lsr(xSI, xSI, 16);
+  emith_and_r_imm(xSI, 1);
+  emith_or_r_r(xDI, xSI);                     // CF
+  emith_move_r_r(xSI, xAX);
+  emith_lsr(xSI, xSI, 8);
+  emith_and_r_imm(xSI, 0xa8);
+  emith_or_r_r(xDI, xSI);                     // SF, YF, XF
+  emith_move_r_r(xSI, xAX);
+  emith_and_r_imm(xSI, 0xffff);
+  emith_sub_r_imm(xSI, 1);
+  emith_lsr(xSI, xSI, 16);
+  emith_and_r_imm(xSI, 1);
+  emith_lsl(xSI, xSI, 6);
+  emith_or_r_r(xDI, xSI);                     // ZF
+  // VF: operands of the same sign (add) or different (sub), result not
+  emith_move_r_r(xSI, xDX);
+  emith_eor_r_r(xSI, xCX);
+  if (sub) {
+    emith_eor_r_r(xCX, xAX);
+    emith_and_r_r(xSI, xCX);
+    emith_or_r_imm(xDI, 0x02);                // NF
+  }
+  else {
+    emith_eor_r_imm(xSI, 0x8000);
+    emith_eor_r_r(xDX, xAX);
+    emith_and_r_r(xSI, xDX);
+  }
+  emith_and_r_imm(xSI, 0x8000);
+  emith_lsr(xSI, xSI, 13);
+  emith_or_r_r(xDI, xSI);
+  emit_store(1, xDI, REG_F);
+}
+
+static int tr_ed(void)
+{
+  u32 op = fetch8();
+  int offs;
+
+  tr.r++;
+  tr.pre = 4;
+  // block ops may repeat, RETI/RETN take irqs
+  if ((op & 0xe4) == 0xa0 || (op & 0xc7) == 0x45)
+    return TR_NO;
+
+  // the ones Cz80 takes as NOP
+  if (op < 0x40 || op >= 0xc0 || (op & 0xe0) == 0x80
+      || (op & 0xe4) == 0xa4 || op == 0x77 || op == 0x7f)
+  {
+    emit_cycles(8, tr.p);
+    return TR_OK;
+  }
+
+  offs = (op & 0x30) == 0x30 ? CTX(SP) : CTX(BC) + ((op >> 3) & 6);
+  switch (op & 0xcf) {
+  case 0x43: // LD (nn),rr
+    emith_move_r_imm(xDI, fetch16());
+    emit_load(2, xSI, offs);
+    emit_write16();
+    emit_cycles(20, tr.p);
+    return TR_OK;
+
+  case 0x4b: // LD rr,(nn)
+    emith_move_r_imm(xDI, fetch16());
+    emit_read16();
+    emit_store(2, xAX, offs);
+    emit_cycles(20, tr.p);
+    return TR_OK;
+
+  case 0x42: // SBC HL,rr
+  case 0x4a: // ADC HL,rr
+    emit_adc16(!(op & 8), offs);
+    emit_cycles(15, tr.p);
+    return TR_OK;
+  }
+
+  switch (op) {
+  case 0x44: case 0x4c: case 0x54: case 0x5c:
+  case 0x64: case 0x6c: case 0x74: case 0x7c: // NEG
+    emit_load(1, xDX, REG_A);
+    emit_store_imm(1, REG_A, 0);
+    emit_alu(2);
+    emit_cycles(8, tr.p);
+    return TR_OK;
+
+  case 0x46: case 0x4e: case 0x66: case 0x6e: // IM 0
+  case 0x56: case 0x76:                       // IM 1
+  case 0x5e: case 0x7e:                       // IM 2
+    emit_store_imm(1, CTX(IM), (op & 0x10) ? ((op & 8) ? 2 : 1) : 0);
+    emit_cycles(8, tr.p);
+    return TR_OK;
+  }
+
+  return TR_STEP;
+}
+
+static int tr_insn(void)
+{
+  u32 op = fetch8();
+
+  tr.r++;
+  tr.data = CTX(HL);
+  tr.xy = 0;
+  tr.pre = tr.used = 0;
+
+  switch (op) {
+  case 0xcb:
+    return tr_cb();
+  case 0xed:
+    return tr_ed();
+  case 0xdd:
+  case 0xfd:
+    tr.data = op == 0xdd ? CTX(IX) : CTX(IY);
+    tr.xy = 1;
+    tr.pre = 4;
+    op = fetch8();
+    tr.r++;
+    if (op == 0xdd || op == 0xfd || op == 0xed)
+      return TR_NO;
+    if (op == 0xcb)
+      return tr_xycb();
+    if (op == 0x26 || op == 0x2e)
+      tr.p++; // LD IXh,n / LD IXl,n go to TR_STEP
+    break;
+  }
+  return tr_main(op);
+}
+
+// --------------------------------------------------------------------
+// runtime
+
+// run the instruction at tr.op with Cz80, go on at next or dispatch
+static void emit_interp(const u8 *next)
+{
+  emit_add_r(tr.r);
+  tr.r = 0;
+  emith_move_r_ptr_imm(xAX, tr.op);
+  emith_ctx_write_ptr(xAX, CTX(PC));
+  emith_move_r_r_ptr(xDI, xBP);
+  emith_ctx_write(xICNT, ICNT);
+  emith_call(cz80_ops_step);
+  emith_ctx_read(xICNT, ICNT);
+  if (next != NULL) {
+    tr.used = 0;
+    tr.wrote = 1;
+    emit_cycles(0, next);
+    return;
+  }
+  emith_cmp_r_imm(xICNT, 0);
+  emith_ctx_read_ptr(xAX, CTX(PC));
+  emith_jump_cond(ICOND_JLE, drc_exit);
+  emith_jump(dispatch);
+}
+
+// --------------------------------------------------------------------
+// blocks
+
+static u32 block_hash(const u8 *p, u32 len)
+{
+  u32 h = 2166136261u;
+  while (len-- > 0)
+    h = (h ^ *p++) * 16777619u;
+  return h;
+}
+
+static void block_unlink(struct block_desc *bd)
+{
+  struct block_entry **pbe, *be;
+  struct jc_entry *j;
+  int i;
+
+  for (i = 0; i < bd->nentries; i++) {
+    be = &bd->entries[i];
+    for (pbe = &hash_table[HASH_FUNC(be->src)]; *pbe != NULL; pbe = &(*pbe)->next) {
+      if (*pbe == be) {
+        *pbe = be->next;
+        break;
+      }
+    }
+
+    j = &jc[(uptr)be->src & (JC_SIZE - 1)];
+    if (j->code == be->code)
+      j->src = NULL;
+  }
+  bd->nentries = 0;
+
+  for (i = 0; i < bd->npages; i++) {
+    struct page_link *pl = &bd->pages[i];
+    u32 h = PAGE_FUNC(bd->src) + i;
+    h &= PAGE_HASH - 1;
+    if (pl->prev != NULL)
+      pl->prev->next = pl->next;
+    else
+      page_list[h] = pl->next;
+    if (pl->next != NULL)
+      pl->next->prev = pl->prev;
+    if (page_list[h] == NULL)
+      page_code[h] = 0;
+  }
+  bd->npages = 0;
+  bd->code = NULL;
+}
+
+static void block_link(struct block_desc *bd)
+{
+  u32 h, first, last;
+  int i;
+
+  for (i = 0; i < bd->nentries; i++) {
+    struct block_entry *be = &bd->entries[i];
+    h = HASH_FUNC(be->src);
+    be->block = bd;
+    be->next = hash_table[h];
+    hash_table[h] = be;
+  }
+
+  first = PAGE_FUNC(bd->src);
+  last = PAGE_FUNC(bd->src + bd->len - 1);
+  bd->npages = ((last - first) & (PAGE_HASH - 1)) + 1;
+  for (i = 0; i < bd->npages; i++) {
+    struct page_link *pl = &bd->pages[i];
+    h = (first + i) & (PAGE_HASH - 1);
+    pl->block = bd;
+    pl->prev = NULL;
+    pl->next = page_list[h];
+    if (pl->next != NULL)
+      pl->next->prev = pl;
+    page_list[h] = pl;
+    page_code[h] = 1;
+  }
+}
+
+static struct block_entry *entry_find(const u8 *src)
+{
+  struct block_entry *be;
+
+  for (be = hash_table[HASH_FUNC(src)]; be != NULL; be = be->next)
+    if (be->src == src)
+      return be;
+  return NULL;
+}
+
+static void drc_flush(void)
+{
+  tcache_ptr = tcache_blocks;
+  block_count = 0;
+  entry_count = 0;
+  memset(hash_table, 0, HASH_SIZE * sizeof(hash_table[0]));
+  memset(page_list, 0, PAGE_HASH * sizeof(page_list[0]));
+  memset(page_code, 0, sizeof(page_code));
+  memset(page_inval, 0, sizeof(page_inval));
+  memset(jc, 0, JC_SIZE * sizeof(jc[0]));
+  flush_pending = 0;
+}
+
+// Cz80 only maps pc on jumps, code running off a bank keeps fetching the
+// host memory that follows it. Blocks are made for pcs in a mapped bank and
+// end with it, the rest is left to the stepper
+static int bank_of(const u8 *p)
+{
+  return ((uptr)p - CZ80.BasePC) >> CZ80_FETCH_SFT;
+}
+
+static int pc_mapped(const u8 *p)
+{
+  uptr a = (uptr)p - CZ80.BasePC;
+  return a <= 0xffff && CZ80.Fetch[a >> CZ80_FETCH_SFT] == CZ80.BasePC;
+}
+
+static struct block_desc *translate(const u8 *src)
+{
+  struct block_desc *bd;
+  const u8 *p = src;
+  u8 *block_code, *insn_code;
+  int i, j, ret, nstubs, r;
+
+  if (!pc_mapped(src))
+    return NULL;
+
+  if (tcache_ptr > tcache_z80 + TCACHE_SIZE - TCACHE_RESERVE
+      || block_count >= MAX_BLOCKS
+      || entry_count > MAX_ENTRIES - BLOCK_INSNS)
+  {
+    // can't drop code that's still running
+    if (drc_depth > 1) {
+      flush_pending = 1;
+      return NULL;
+    }
+    elprintf(EL_STATUS, "z80 drc: tcache flush");
+    drc_flush();
+  }
+
+  tr.n = tr.nstubs = 0;
+  tr.r = 0;
+  block_code = tcache_ptr;
+
+  for (;;) {
+    tr.op = tr.p = p;
+    tr.insn_src[tr.n] = p;
+    tr.insn_code[tr.n] = insn_code = tcache_ptr;
+    tr.insn_r[tr.n] = r = tr.r;
+    tr.n++;
+    tr.wrote = 0;
+    nstubs = tr.nstubs;
+
+    ret = tr_insn();
+    if (ret == TR_NO || ret == TR_STEP) {
+      tcache_ptr = insn_code;
+      tr.nstubs = nstubs;
+      tr.r = r;
+      emit_interp(ret == TR_STEP ? tr.p : NULL);
+      ret = ret == TR_STEP ? TR_OK : TR_END;
+    }
+    p = tr.p;
+    if (ret == TR_END)
+      break;
+    if (tr.wrote)
+      emit_wcheck(p);
+    if (tr.n >= BLOCK_INSNS || p - src >= BLOCK_BYTES
+        || tr.nstubs > MAX_STUBS - 4 || bank_of(p) != bank_of(src))
+    {
+      emit_add_r(tr.r);
+      emith_move_r_ptr_imm(xAX, p);
+      emith_jump(dispatch);
+      break;
+    }
+  }
+
+  // out of cycles exits, shared by pc and R
+  for (i = 0; i < tr.nstubs; i++) {
+    for (j = 0; j < i; j++)
+      if (tr.stubs[j].pc == tr.stubs[i].pc && tr.stubs[j].r == tr.stubs[i].r)
+        break;
+    if (j < i) {
+      emith_jump_patch(tr.stubs[i].jmp, tr.stubs[j].jmp);
+      continue;
+    }
+    emith_jump_patch(tr.stubs[i].jmp, tcache_ptr);
+    tr.stubs[i].jmp = tcache_ptr; // now the stub
+    emit_add_r(tr.stubs[i].r);
+    emith_move_r_ptr_imm(xAX, tr.stubs[i].pc);
+    emith_jump(drc_exit);
+  }
+
+  // entries, with R taken back to what the block has counted up to them
+  bd = &blocks[block_count++];
+  bd->entries = &entries[entry_count];
+  bd->nentries = tr.n;
+  entry_count += tr.n;
+  for (i = 0; i < tr.n; i++) {
+    bd->entries[i].src = tr.insn_src[i];
+    bd->entries[i].code = tr.insn_code[i];
+    if (tr.insn_r[i] == 0)
+      continue;
+    bd->entries[i].code = tcache_ptr;
+    emit_add_r(-tr.insn_r[i]);
+    emith_jump(tr.insn_code[i]);
+  }
+
+  bd->src = src;
+  bd->len = p - src;
+  bd->hash = block_hash(src, bd->len);
+  bd->code = block_code;
+  block_link(bd);
+  return bd;
+}
+
+static u8 *drc_lookup(const u8 *src)
+{
+  struct jc_entry *j = &jc[(uptr)src & (JC_SIZE - 1)];
+  struct block_entry *be;
+  struct block_desc *bd;
+  u8 *code;
+
+  if (j->src == src)
+    return j->code;
+
+  be = entry_find(src);
+  if (be != NULL)
+    code = be->code;
+  else if (page_inval[PAGE_FUNC(src)] >= INVAL_LIMIT)
+    return NULL; // code mixed with data, not worth translating again
+  else {
+    bd = translate(src);
+    if (bd == NULL)
+      return NULL;
+    code = bd->code;
+  }
+  j->src = src;
+  j->code = code;
+  return code;
+}
+
+void cz80_drc_wcheck(const void *ptr, int len)
+{
+  const u8 *p = ptr;
+  u32 h, first = PAGE_FUNC(p), last = PAGE_FUNC(p + len - 1);
+  struct page_link *pl, *next;
+
+  for (h = first; ; h = (h + 1) & (PAGE_HASH - 1)) {
+    if (page_code[h]) {
+      for (pl = page_list[h]; pl != NULL; pl = next) {
+        struct block_desc *bd = pl->block;
+        next = pl->next;
+        if (bd->src < p + len && p < bd->src + bd->len) {
+          block_unlink(bd);
+          code_written = 1;
+          if (page_inval[h] < INVAL_LIMIT)
+            page_inval[h]++;
+        }
+      }
+    }
+    if (h == last)
+      break;
+  }
+}
+
+// after memory was replaced, drop blocks whose code changed
+void cz80_drc_verify(const void *ptr, int len)
+{
+  const u8 *p = ptr;
+  int i;
+
+  for (i = 0; i < block_count; i++) {
+    struct block_desc *bd = &blocks[i];
+    if (bd->code == NULL || bd->src + bd->len <= p || bd->src >= p + len)
+      continue;
+    if (block_hash(bd->src, bd->len) != bd->hash)
+      block_unlink(bd);
+  }
+}
+
+void cz80_drc_flush_all(void)
+{
+  if (drc_depth > 0)
+    flush_pending = 1;
+  else if (drc_ready)
+    drc_flush();
+}
+
+// --------------------------------------------------------------------
+// stubs, memory helpers: edi = address, esi = data, eax = result,
+// caller saved regs are clobbered
+
+// rax = map entry doubled, jumps to the returned jmp8 if it's a handler
+static u8 *gen_map_lookup(uptr *map)
+{
+  u8 *jh;
+
+  emit_ext_r(2, xDI, xDI);
+  emith_move_r_r(xAX, xDI);
+  emith_lsr(xAX, xAX, Z80_MEM_SHIFT);
+  emith_move_r_ptr_imm(xDX, map);
+  emit_op_sib(1, 0x8b, xAX, xDX, xAX, 3);     // mov rax, [rdx + rax*8]
+  EMIT_OP_MODRM_PTR(0x01, 3, xAX, xAX);       // add rax, rax
+  JMP8_POS(jh);
+  return jh;
+}
+
+// host write in rax done, invalidate if there's code
+static void gen_write_check(void)
+{
+  u8 *jp;
+
+  emith_move_r_r_ptr(xDX, xAX);
+  EMIT_OP_MODRM_PTR(0xc1, 3, 5, xDX);         // shr rdx, PAGE_SHIFT
+  EMIT(PAGE_SHIFT, u8);
+  emith_and_r_imm(xDX, PAGE_HASH - 1);
+  emith_move_r_ptr_imm(xCX, page_code);
+  emit_op_sib(0, 0x80, 7, xCX, xDX, 0);       // cmp byte [rcx + rdx], 0
+  EMIT(0, u8);
+  JMP8_POS(jp);
+  emith_ret();
+  JMP8_EMIT(ICOND_JNE, jp);
+  emith_move_r_r_ptr(xDI, xAX);
+  emith_move_r_imm(xSI, 1);
+  emit_jump_far(cz80_drc_wcheck);
+}
+
+static void gen_helpers(void)
+{
+  u8 *jh;
+
+  rd8 = tcache_ptr;
+  jh = gen_map_lookup(z80_read_map);
+  emit_op_sib(0, 0x0fb6, xAX, xAX, xDI, 0);   // movzx eax, byte [rax + rdi]
+  emith_ret();
+  JMP8_EMIT(ICOND_JB, jh);
+  emith_ctx_write(xICNT, ICNT);
+  emith_sub_r_ptr_imm(xSP, 8);
+  emith_call_reg(xAX);
+  emith_add_r_ptr_imm(xSP, 8);
+  emith_ctx_read(xICNT, ICNT);
+  emit_ext_r(1, xAX, xAX);
+  emith_ret();
+
+  // READ_MEM16: low byte first
+  rd16 = tcache_ptr;
+  emith_sub_r_ptr_imm(xSP, 24);
+  emith_write_r_r_offs(xDI, xSP, 0);
+  emith_call(rd8);
+  emith_write_r_r_offs(xAX, xSP, 4);
+  emith_read_r_r_offs(xDI, xSP, 0);
+  emith_add_r_imm(xDI, 1);
+  emith_call(rd8);
+  emith_lsl(xAX, xAX, 8);
+  emith_read_r_r_offs(xCX, xSP, 4);
+  emith_or_r_r(xAX, xCX);
+  emith_add_r_ptr_imm(xSP, 24);
+  emith_ret();
+
+  wr8 = tcache_ptr;
+  jh = gen_map_lookup(z80_write_map);
+  EMIT_OP_MODRM_PTR(0x01, 3, xDI, xAX);       // add rax, rdi
+  emith_write8_r_r_offs(xSI, xAX, 0);
+  gen_write_check();
+  JMP8_EMIT(ICOND_JB, jh);
+  emit_ext_r(1, xSI, xSI);
+  emith_ctx_write(xICNT, ICNT);
+  emith_sub_r_ptr_imm(xSP, 8);
+  emith_call_reg(xAX);
+  emith_add_r_ptr_imm(xSP, 8);
+  emith_ctx_read(xICNT, ICNT);
+  emith_ret();
+
+  wr16 = tcache_ptr;
+  emith_sub_r_ptr_imm(xSP, 24);
+  emith_write_r_r_offs(xDI, xSP, 0);
+  emith_write_r_r_offs(xSI, xSP, 4);
+  emith_call(wr8);
+  emith_read_r_r_offs(xDI, xSP, 0);
+  emith_add_r_imm(xDI, 1);
+  emith_read_r_r_offs(xSI, xSP, 4);
+  emith_lsr(xSI, xSI, 8);
+  emith_call(wr8);
+  emith_add_r_ptr_imm(xSP, 24);
+  emith_ret();
+}
+
+// rax = host pc, rbp = ctx
+static void gen_dispatcher(void)
+{
+  u8 *jmiss;
+
+  dispatch = tcache_ptr;
+  emith_move_r_r(xCX, xAX);
+  emith_and_r_imm(xCX, JC_SIZE - 1);
+  emith_lsl(xCX, xCX, 4);
+  emith_move_r_ptr_imm(xSI, jc);
+  EMIT_OP_MODRM_PTR(0x01, 3, xCX, xSI);       // add rsi, rcx
+  EMIT_OP_MODRM_PTR(0x39, 0, xAX, xSI);       // cmp [rsi], rax
+  JMP8_POS(jmiss);
+  emith_deref_op(0xff, 4, xSI, offsetof(struct jc_entry, code));
+  JMP8_EMIT(ICOND_JNE, jmiss);
+  emith_jump(drc_exit);
+}
+
+static void drc_free(void)
+{
+  if (tcache_z80 != NULL)
+    plat_munmap(tcache_z80, TCACHE_SIZE);
+  free(blocks);
+  free(entries);
+  free(hash_table);
+  free(page_list);
+  free(jc);
+  tcache_z80 = NULL;
+  blocks = NULL;
+  entries = NULL;
+  hash_table = NULL;
+  page_list = NULL;
+  jc = NULL;
+}
+
+int cz80_drc_init(void)
+{
+  const UINT8 *szp, *sz_bit, *inc, *dec;
+
+  if (drc_ready)
+    return 0;
+  tcache_z80 = plat_mmap(0, TCACHE_SIZE, 1, 0);
+  if (tcache_z80 == NULL)
+    return -1;
+  if (plat_mem_set_exec(tcache_z80, TCACHE_SIZE) != 0) {
+    elprintf(EL_STATUS, "z80 drc: can't make tcache executable");
+    goto fail;
+  }
+  blocks = calloc(MAX_BLOCKS, sizeof(blocks[0]));
+  entries = calloc(MAX_ENTRIES, sizeof(entries[0]));
+  hash_table = calloc(HASH_SIZE, sizeof(hash_table[0]));
+  page_list = calloc(PAGE_HASH, sizeof(page_list[0]));
+  jc = calloc(JC_SIZE, sizeof(jc[0]));
+  if (blocks == NULL || entries == NULL || hash_table == NULL
+      || page_list == NULL || jc == NULL)
+    goto fail;
+
+  cz80_ops_init(&ops_scratch);
+  cz80_ops_tables(&szp, &sz_bit, &inc, &dec, &tab_add, &tab_sub);
+  memcpy(flag_tabs[0], szp, 256);
+  memcpy(flag_tabs[1], sz_bit, 256);
+  memcpy(flag_tabs[2], inc, 256);
+  memcpy(flag_tabs[3], dec, 256);
+
+  tcache_ptr = tcache_z80;
+
+  // entry(ctx, code)
+  drc_entry = (void *)tcache_ptr;
+  emith_sh2_drc_entry();
+  emith_move_r_r_ptr(xBP, xDI);
+  emith_ctx_read(xICNT, ICNT);
+  emith_move_r_ptr_imm(xTAB, flag_tabs);
+  emith_move_r_ptr_imm(xADD, tab_add);
+  emith_move_r_ptr_imm(xSUB, tab_sub);
+  emith_jump_reg(xSI);
+
+  drc_exit = tcache_ptr;
+  emith_ctx_write(xICNT, ICNT);
+  emith_ctx_write_ptr(xAX, CTX(PC));
+  emith_sh2_drc_exit();
+
+  gen_dispatcher();
+  gen_helpers();
+  tcache_blocks = tcache_ptr;
+  drc_flush();
+
+  drc_ready = 1;
+  elprintf(EL_STATUS, "z80 drc: %d bytes of stubs", (int)(tcache_blocks - tcache_z80));
+  return 0;
+
+fail:
+  drc_free();
+  return -1;
+}
+
+void cz80_drc_finish(void)
+{
+  if (!drc_ready)
+    return;
+  drc_free();
+  memset(page_code, 0, sizeof(page_code));
+  drc_ready = 0;
+}
+
+int cz80_drc_exec(int cycles)
+{
+  u8 *code;
+
+  if (!drc_ready || CZ80.HaltState)
+    return Cz80_Exec(&CZ80, cycles);
+
+  CZ80.ICount = cycles - CZ80.ExtraCycles;
+  CZ80.ExtraCycles = 0;
+
+  drc_depth++;
+  while (CZ80.ICount > 0) {
+    code_written = 0;
+    code = drc_lookup((const u8 *)CZ80.PC);
+    if (code != NULL)
+      drc_entry(&CZ80, code);
+    else
+      cz80_ops_step(&CZ80, 0);
+  }
+  drc_depth--;
+  if (flush_pending && drc_depth == 0)
+    drc_flush();
+
+  return cycles - CZ80.ICount;
+}
+
+// per emulator instance, the translations stay in the buffers above
+const struct pico_ctx_area ctx_areas_cz80_drc[] = {
+  PICO_CTX_AREA(tcache_z80),
+  PICO_CTX_AREA(tcache_ptr),
+  PICO_CTX_AREA(tcache_blocks),
+  PICO_CTX_AREA(blocks),
+  PICO_CTX_AREA(block_count),
+  PICO_CTX_AREA(entries),
+  PICO_CTX_AREA(entry_count),
+  PICO_CTX_AREA(hash_table),
+  PICO_CTX_AREA(page_list),
+  PICO_CTX_AREA(page_inval),
+  PICO_CTX_AREA(jc),
+  PICO_CTX_AREA(cz80_drc_page_code),
+  PICO_CTX_AREA(drc_entry),
+  PICO_CTX_AREA(drc_exit),
+  PICO_CTX_AREA(dispatch),
+  PICO_CTX_AREA(rd8),
+  PICO_CTX_AREA(rd16),
+  PICO_CTX_AREA(wr8),
+  PICO_CTX_AREA(wr16),
+  PICO_CTX_AREA(drc_ready),
+  PICO_CTX_AREA(flush_pending),
+  PICO_CTX_AREA_END
+};
+
+// vim:shiftwidth=2:ts=2:expandtab
@@ -0,0 +1,29 @@
+// z80 recompiler, runs on the Cz80 context (CZ80)
+
+#ifdef DRC_Z80
+#define CZ80_DRC_PAGE_SHIFT 5
+#define CZ80_DRC_PAGE_HASH  0x2000
+
+int  cz80_drc_init(void);
+void cz80_drc_finish(void);
+int  cz80_drc_exec(int cycles);
+void cz80_drc_flush_all(void);
+void cz80_drc_wcheck(const void *ptr, int len);
+void cz80_drc_verify(const void *ptr, int len);
+
+// pages of host memory holding translated code, for the inline check
+extern unsigned char cz80_drc_page_code[CZ80_DRC_PAGE_HASH];
+
+#define cz80_drc_wcheck8(p) do { \
+  if (cz80_drc_page_code[((unsigned long)(p) >> CZ80_DRC_PAGE_SHIFT) \
+                         & (CZ80_DRC_PAGE_HASH - 1)]) \
+    cz80_drc_wcheck(p, 1); \
+} while (0)
+#else
+#define cz80_drc_init() 0
+#define cz80_drc_finish()
+#define cz80_drc_flush_all()
+#define cz80_drc_wcheck(ptr, len)
+#define cz80_drc_verify(ptr, len)
+#define cz80_drc_wcheck8(p)
+#endif
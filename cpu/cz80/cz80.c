@@ -15,6 +15,7 @@
 
 #if PICODRIVE_HACKS
 #include <pico/memory.h>
+#include "compiler.h"
 #endif
 
 #ifndef ALIGN_DATA
@@ -50,7 +51,9 @@
 	O[o\
 ******************************************************************************/
 
+#ifndef CZ80_STEP
 cz80_struc ALIGN_DATA CZ80;
+#endif
 
 
 /******************************************************************************
@@ -245,18 +248,30 @@ INT32 Cz80_Exec(cz80_struc *CPU, INT32 cycles)
 	UINT32 val;
 	int afterEI = 0;
 	union16 *data;
+#ifdef CZ80_STEP
+	int stepped = 0;
+#endif
 
 	PC = CPU->PC;
 #if CZ80_ENCRYPTED_ROM
 	OPBase = CPU->OPBase;
 #endif
+#ifdef CZ80_STEP
+	// one instruction on the caller's ICount
+	cycles = CPU->ICount;
+#else
 	CPU->ICount = cycles - CPU->ExtraCycles;
 	CPU->ExtraCycles = 0;
+#endif
 
 	if (!CPU->HaltState)
 	{
 Cz80_Exec:
+#ifdef CZ80_STEP
+		if (CPU->ICount > 0 && !stepped++)
+#else
 		if (CPU->ICount > 0)
+#endif
 		{
 Cz80_Exec_nocheck:
 			data = pzHL;
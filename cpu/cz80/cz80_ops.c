@@ -0,0 +1,36 @@
+/*
+ * Cz80 built a second time in step mode, for the z80 recompiler to
+ * run single instructions it doesn't translate. Uses the context of
+ * the main build (CZ80) and takes cycles from its ICount.
+ */
+
+#define CZ80_STEP
+
+#define Cz80_Init              cz80_ops_init
+#define Cz80_Reset             cz80_ops_reset
+#define Cz80_Exec              cz80_ops_step
+#define Cz80_Set_IRQ           cz80_ops_set_irq
+#define Cz80_Get_Reg           cz80_ops_get_reg
+#define Cz80_Set_Reg           cz80_ops_set_reg
+#define Cz80_Set_Fetch         cz80_ops_set_fetch
+#define Cz80_Set_Encrypt_Range cz80_ops_set_encrypt_range
+#define Cz80_Set_ReadB         cz80_ops_set_readb
+#define Cz80_Set_WriteB        cz80_ops_set_writeb
+#define Cz80_Set_INPort        cz80_ops_set_inport
+#define Cz80_Set_OUTPort       cz80_ops_set_outport
+#define Cz80_Set_IRQ_Callback  cz80_ops_set_irq_callback
+
+#include "cz80.c"
+
+// flag tables for the translated code, filled by cz80_ops_init
+void cz80_ops_tables(const UINT8 **szp, const UINT8 **sz_bit,
+	const UINT8 **inc, const UINT8 **dec,
+	const UINT8 **add, const UINT8 **sub)
+{
+	*szp = SZP;
+	*sz_bit = SZ_BIT;
+	*inc = SZHV_inc;
+	*dec = SZHV_dec;
+	*add = SZHVC_add;
+	*sub = SZHVC_sub;
+}
@@ -76,8 +76,10 @@
 	unsigned long v = z80_write_map[a >> Z80_MEM_SHIFT]; \
 	if (map_flag_set(v)) \
 		((z80_write_f *)(v << 1))(a, d); \
-	else \
+	else { \
 		*(unsigned char *)((v << 1) + a) = d; \
+		cz80_drc_wcheck8((unsigned char *)((v << 1) + a)); \
+	} \
 }
 #else
 #define WRITE_MEM8(A, D)	CPU->Write_Byte(A, D);
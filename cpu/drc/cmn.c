@@ -10,14 +10,39 @@
 #include <pico/pico_int.h>
 #include "cmn.h"
 
-u8 __attribute__((aligned(4096))) tcache[DRC_TCACHE_SIZE];
+#ifdef __arm__
+static u8 __attribute__((aligned(4096)))
+  tcache_slots[DRC_TCACHE_SLOTS][DRC_TCACHE_SIZE];
+u8 *tcache = tcache_slots[0];
+
+void drc_cmn_slot(int slot)
+{
+  tcache = tcache_slots[slot];
+}
+#else
+u8 *tcache;
+#endif
 
+const struct pico_ctx_area ctx_areas_drc_cmn[] = {
+  PICO_CTX_AREA(tcache),
+  PICO_CTX_AREA_END
+};
 
-void drc_cmn_init(void)
+
+int drc_cmn_init(void)
 {
-  int ret = plat_mem_set_exec(tcache, sizeof(tcache));
-  elprintf(EL_STATUS, "drc_cmn_init: %p, %zd bytes: %d",
-    tcache, sizeof(tcache), ret);
+  int ret;
+
+#ifndef __arm__
+  if (tcache == NULL) {
+    tcache = plat_mmap(0, DRC_TCACHE_SIZE, 1, 0);
+    if (tcache == NULL)
+      return -1;
+  }
+#endif
+  ret = plat_mem_set_exec(tcache, DRC_TCACHE_SIZE);
+  elprintf(EL_STATUS, "drc_cmn_init: %p, %d bytes: %d",
+    tcache, DRC_TCACHE_SIZE, ret);
 
 #ifdef __arm__
   if (PicoOpt & POPT_EN_DRC)
@@ -35,16 +60,22 @@ void drc_cmn_init(void)
 
       // we'll usually crash on broken platforms or bad ports,
       // but do a value check too just in case
-      ret = testfunc();
-      elprintf(EL_STATUS, "test %s.", ret == 0xdd ? "passed" : "failed");
+      int v = testfunc();
+      elprintf(EL_STATUS, "test %s.", v == 0xdd ? "passed" : "failed");
       test_done = 1;
     }
   }
 #endif
+  return ret;
 }
 
 void drc_cmn_cleanup(void)
 {
+#ifndef __arm__
+  if (tcache != NULL)
+    plat_munmap(tcache, DRC_TCACHE_SIZE);
+  tcache = NULL;
+#endif
 }
 
 // vim:shiftwidth=2:expandtab
@@ -5,8 +5,15 @@ typedef unsigned int   u32;
 
 #define DRC_TCACHE_SIZE         (2*1024*1024)
 
-extern u8 tcache[DRC_TCACHE_SIZE];
+// one per emulator instance (pico/context.c). Mapped by drc_cmn_init,
+// except on ARM, where branches out of it must reach the code, so there
+// are DRC_TCACHE_SLOTS of them in .bss, handed out with drc_cmn_slot()
+extern u8 *tcache;
+#ifdef __arm__
+#define DRC_TCACHE_SLOTS        2
+void drc_cmn_slot(int slot);
+#endif
 
-void drc_cmn_init(void);
+int  drc_cmn_init(void);
 void drc_cmn_cleanup(void);
 
@@ -6,6 +6,7 @@
  * See COPYING file in the top-level directory.
  */
 #define CONTEXT_REG 11
+#define RET_REG     0
 
 // XXX: tcache_ptr type for SVP and SH2 compilers differs..
 #define EMIT_PTR(ptr, x) \
@@ -360,6 +361,9 @@ static int emith_xbranch(int cond, void *target, int is_call)
 #define emith_move_r_r(d, s) \
 	EOP_MOV_REG_SIMPLE(d, s)
 
+#define emith_move_r_r_ptr(d, s) \
+	emith_move_r_r(d, s)
+
 #define emith_mvn_r_r(d, s) \
 	EOP_MVN_REG(A_COND_AL,0,d,s,A_AM1_LSL,0)
 
@@ -411,6 +415,12 @@ static int emith_xbranch(int cond, void *target, int is_call)
 #define emith_tst_r_r(d, s) \
 	EOP_TST_REG(A_COND_AL,d,s,A_AM1_LSL,0)
 
+#define emith_add_r_r_ptr(d, s) \
+	emith_add_r_r(d, s)
+
+#define emith_tst_r_r_ptr(d, s) \
+	emith_tst_r_r(d, s)
+
 #define emith_teq_r_r(d, s) \
 	EOP_TEQ_REG(A_COND_AL,d,s,A_AM1_LSL,0)
 
@@ -435,6 +445,9 @@ static int emith_xbranch(int cond, void *target, int is_call)
 #define emith_move_r_imm(r, imm) \
 	emith_op_imm(A_COND_AL, 0, A_OP_MOV, r, imm)
 
+#define emith_move_r_ptr_imm(r, imm) \
+	emith_move_r_imm(r, (u32)(imm))
+
 #define emith_add_r_imm(r, imm) \
 	emith_op_imm(A_COND_AL, 0, A_OP_ADD, r, imm)
 
@@ -444,6 +457,12 @@ static int emith_xbranch(int cond, void *target, int is_call)
 #define emith_sub_r_imm(r, imm) \
 	emith_op_imm(A_COND_AL, 0, A_OP_SUB, r, imm)
 
+#define emith_add_r_ptr_imm(r, imm) \
+	emith_add_r_imm(r, imm)
+
+#define emith_sub_r_ptr_imm(r, imm) \
+	emith_sub_r_imm(r, imm)
+
 #define emith_bic_r_imm(r, imm) \
 	emith_op_imm(A_COND_AL, 0, A_OP_BIC, r, imm)
 
@@ -503,6 +522,9 @@ static int emith_xbranch(int cond, void *target, int is_call)
 #define emith_add_r_r_imm(d, s, imm) \
 	emith_op_imm2(A_COND_AL, 0, A_OP_ADD, d, s, imm)
 
+#define emith_add_r_r_ptr_imm(d, s, imm) \
+	emith_add_r_r_imm(d, s, imm)
+
 #define emith_sub_r_r_imm(d, s, imm) \
 	emith_op_imm2(A_COND_AL, 0, A_OP_SUB, d, s, imm)
 
@@ -590,12 +612,21 @@ static int emith_xbranch(int cond, void *target, int is_call)
 #define emith_read16_r_r_offs(r, rs, offs) \
 	emith_read16_r_r_offs_c(A_COND_AL, r, rs, offs)
 
+#define emith_write_r_r_offs(r, rs, offs) \
+	EOP_STR_IMM(r, rs, offs)
+
 #define emith_ctx_read(r, offs) \
 	emith_read_r_r_offs(r, CONTEXT_REG, offs)
 
 #define emith_ctx_write(r, offs) \
 	EOP_STR_IMM(r, CONTEXT_REG, offs)
 
+#define emith_ctx_read_ptr(r, offs) \
+	emith_ctx_read(r, offs)
+
+#define emith_ctx_write_ptr(r, offs) \
+	emith_ctx_write(r, offs)
+
 #define emith_ctx_do_multiple(op, r, offs, count, tmpr) do { \
 	int v_, r_ = r, c_ = count, b_ = CONTEXT_REG;        \
 	for (v_ = 0; c_; c_--, r_++)                         \
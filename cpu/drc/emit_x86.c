@@ -1,21 +1,35 @@
 /*
- * Basic macros to emit x86 instructions and some utils
+ * Basic macros to emit x86 and x86-64 instructions and some utils
  * Copyright (C) 2008,2009,2010 notaz
  *
  * This work is licensed under the terms of MAME license.
  * See COPYING file in the top-level directory.
  *
  * note:
- *  temp registers must be eax-edx due to use of SETcc and r/w 8/16.
+ *  temp registers must be eax-edx due to use of SETcc and r/w 8/16
+ *  (i386 only, x86-64 can use any reg thanks to REX prefix).
  * note about silly things like emith_eor_r_r_r:
  *  these are here because the compiler was designed
  *  for ARM as it's primary target.
  */
 #include <stdarg.h>
+#include <stddef.h>
 
-enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
+enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI,	// x86-64,i386 common
+       xR8, xR9, xR10, xR11, xR12, xR13, xR14, xR15 };	// x86-64 only
 
 #define CONTEXT_REG xBP
+#define RET_REG     xAX
+
+#ifdef __x86_64__
+#define PTR_SIZE 8
+// ax, cx, dx, si, di, r8-r11
+#define CALLER_SAVE_REGS 0x0fc7
+#else
+#define PTR_SIZE 4
+// ax, cx, dx
+#define CALLER_SAVE_REGS 0x0007
+#endif
 
 #define ICOND_JO  0x00
 #define ICOND_JNO 0x01
@@ -53,27 +67,49 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 #define EMIT_PTR(ptr, val, type) \
 	*(type *)(ptr) = val
 
-#define EMIT(val, type) { \
+#define EMIT(val, type) do { \
 	EMIT_PTR(tcache_ptr, val, type); \
 	tcache_ptr += sizeof(type); \
-}
+} while (0)
 
-#define EMIT_OP(op) { \
+#define EMIT_OP(op) do { \
 	COUNT_OP; \
 	EMIT(op, u8); \
-}
+} while (0)
 
 #define EMIT_MODRM(mod,r,rm) \
-	EMIT(((mod)<<6) | ((r)<<3) | (rm), u8)
+	EMIT(((mod)<<6) | (((r)&7)<<3) | ((rm)&7), u8)
 
 #define EMIT_SIB(scale,index,base) \
-	EMIT(((scale)<<6) | ((index)<<3) | (base), u8)
+	EMIT(((scale)<<6) | (((index)&7)<<3) | ((base)&7), u8)
+
+// REX prefix: w - 64bit operand, r - ModRM.reg, x - SIB.index, b - ModRM.rm
+#define EMIT_REX(w,r,x,b) \
+	EMIT(0x40 | ((w)<<3) | (((r)>>3)<<2) | (((x)>>3)<<1) | ((b)>>3), u8)
 
-#define EMIT_OP_MODRM(op,mod,r,rm) do { \
+// w: 0 - only if needed, 1 - 64bit operand, 2 - always (for sil, dil, ..)
+#ifdef __x86_64__
+#define EMIT_REX_IF(w,r,b) do { \
+	if ((w) || ((r) | (b)) > 7) \
+		EMIT_REX((w) & 1, r, 0, b); \
+} while (0)
+#else
+#define EMIT_REX_IF(w,r,b) do {} while (0)
+#endif
+
+#define EMIT_OP_MODRM_(w,op,mod,r,rm) do { \
+	EMIT_REX_IF(w, r, rm); \
 	EMIT_OP(op); \
 	EMIT_MODRM(mod, r, rm); \
 } while (0)
 
+#define EMIT_OP_MODRM(op,mod,r,rm) \
+	EMIT_OP_MODRM_(0, op, mod, r, rm)
+
+// same as above, but operating on pointer sized values
+#define EMIT_OP_MODRM_PTR(op,mod,r,rm) \
+	EMIT_OP_MODRM_(1, op, mod, r, rm)
+
 #define JMP8_POS(ptr) \
 	ptr = tcache_ptr; \
 	tcache_ptr += 2
@@ -90,6 +126,9 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 #define emith_move_r_r(dst, src) \
 	EMIT_OP_MODRM(0x8b, 3, dst, src)
 
+#define emith_move_r_r_ptr(dst, src) \
+	EMIT_OP_MODRM_PTR(0x8b, 3, dst, src)
+
 #define emith_add_r_r(d, s) \
 	EMIT_OP_MODRM(0x01, 3, s, d)
 
@@ -114,38 +153,44 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 #define emith_tst_r_r(d, s) \
 	EMIT_OP_MODRM(0x85, 3, s, d) /* TEST */
 
+#define emith_add_r_r_ptr(d, s) \
+	EMIT_OP_MODRM_PTR(0x01, 3, s, d)
+
+#define emith_tst_r_r_ptr(d, s) \
+	EMIT_OP_MODRM_PTR(0x85, 3, s, d)
+
 #define emith_cmp_r_r(d, s) \
 	EMIT_OP_MODRM(0x39, 3, s, d)
 
 // fake teq - test equivalence - get_flags(d ^ s)
-#define emith_teq_r_r(d, s) { \
+#define emith_teq_r_r(d, s) do { \
 	emith_push(d); \
 	emith_eor_r_r(d, s); \
 	emith_pop(d); \
-}
+} while (0)
 
-#define emith_mvn_r_r(d, s) { \
+#define emith_mvn_r_r(d, s) do { \
 	if (d != s) \
 		emith_move_r_r(d, s); \
 	EMIT_OP_MODRM(0xf7, 3, 2, d); /* NOT d */ \
-}
+} while (0)
 
-#define emith_negc_r_r(d, s) { \
+#define emith_negc_r_r(d, s) do { \
 	int tmp_ = rcache_get_tmp(); \
 	emith_move_r_imm(tmp_, 0); \
 	emith_sbc_r_r(tmp_, s); \
 	emith_move_r_r(d, tmp_); \
 	rcache_free_tmp(tmp_); \
-}
+} while (0)
 
-#define emith_neg_r_r(d, s) { \
+#define emith_neg_r_r(d, s) do { \
 	if (d != s) \
 		emith_move_r_r(d, s); \
 	EMIT_OP_MODRM(0xf7, 3, 3, d); /* NEG d */ \
-}
+} while (0)
 
 // _r_r_r
-#define emith_add_r_r_r(d, s1, s2) { \
+#define emith_add_r_r_r(d, s1, s2) do { \
 	if (d == s1) { \
 		emith_add_r_r(d, s2); \
 	} else if (d == s2) { \
@@ -154,9 +199,9 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 		emith_move_r_r(d, s1); \
 		emith_add_r_r(d, s2); \
 	} \
-}
+} while (0)
 
-#define emith_eor_r_r_r(d, s1, s2) { \
+#define emith_eor_r_r_r(d, s1, s2) do { \
 	if (d == s1) { \
 		emith_eor_r_r(d, s2); \
 	} else if (d == s2) { \
@@ -165,29 +210,41 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 		emith_move_r_r(d, s1); \
 		emith_eor_r_r(d, s2); \
 	} \
-}
+} while (0)
 
 // _r_r_shift
-#define emith_or_r_r_lsl(d, s, lslimm) { \
+#define emith_or_r_r_lsl(d, s, lslimm) do { \
 	int tmp_ = rcache_get_tmp(); \
 	emith_lsl(tmp_, s, lslimm); \
 	emith_or_r_r(d, tmp_); \
 	rcache_free_tmp(tmp_); \
-}
+} while (0)
 
 // d != s
-#define emith_eor_r_r_lsr(d, s, lsrimm) { \
+#define emith_eor_r_r_lsr(d, s, lsrimm) do { \
 	emith_push(s); \
 	emith_lsr(s, s, lsrimm); \
 	emith_eor_r_r(d, s); \
 	emith_pop(s); \
-}
+} while (0)
 
 // _r_imm
-#define emith_move_r_imm(r, imm) { \
-	EMIT_OP(0xb8 + (r)); \
+#define emith_move_r_imm(r, imm) do { \
+	EMIT_REX_IF(0, 0, r); \
+	EMIT_OP(0xb8 + ((r)&7)); \
 	EMIT(imm, u32); \
-}
+} while (0)
+
+#ifdef __x86_64__
+#define emith_move_r_ptr_imm(r, imm) do { \
+	EMIT_REX_IF(1, 0, r); \
+	EMIT_OP(0xb8 + ((r)&7)); \
+	EMIT((unsigned long)(imm), unsigned long); \
+} while (0)
+#else
+#define emith_move_r_ptr_imm(r, imm) \
+	emith_move_r_imm(r, (u32)(imm))
+#endif
 
 #define emith_move_r_imm_s8(r, imm) \
 	emith_move_r_imm(r, (u32)(signed int)(signed char)(imm))
@@ -197,6 +254,18 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 	EMIT(imm, u32); \
 } while (0)
 
+// 32bit imm is sign extended to 64bit
+#define emith_arith_r_ptr_imm(op, r, imm) do { \
+	EMIT_OP_MODRM_PTR(0x81, 3, op, r); \
+	EMIT(imm, u32); \
+} while (0)
+
+#define emith_add_r_ptr_imm(r, imm) \
+	emith_arith_r_ptr_imm(0, r, imm)
+
+#define emith_sub_r_ptr_imm(r, imm) \
+	emith_arith_r_ptr_imm(5, r, imm)
+
 #define emith_add_r_imm(r, imm) \
 	emith_arith_r_imm(0, r, imm)
 
@@ -231,20 +300,23 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 	emith_arith_r_imm(4, r, ~(imm))
 
 // fake conditionals (using SJMP instead)
-#define emith_move_r_imm_c(cond, r, imm) { \
-	(void)(cond); \
+// except these two, which may be used without SJMP and must keep flags
+#define emith_move_r_imm_c(cond, r, imm) do { \
+	EMITH_SJMP_START((cond) ^ 1); \
 	emith_move_r_imm(r, imm); \
-}
+	EMITH_SJMP_END((cond) ^ 1); \
+} while (0)
 
-#define emith_add_r_imm_c(cond, r, imm) { \
+#define emith_add_r_imm_c(cond, r, imm) do { \
 	(void)(cond); \
 	emith_add_r_imm(r, imm); \
-}
+} while (0)
 
-#define emith_sub_r_imm_c(cond, r, imm) { \
-	(void)(cond); \
-	emith_sub_r_imm(r, imm); \
-}
+#define emith_sub_r_imm_c(cond, r, imm) do { \
+	EMITH_SJMP_START((cond) ^ 1); \
+	emith_lea_r_r_offs(r, r, -(imm)); \
+	EMITH_SJMP_END((cond) ^ 1); \
+} while (0)
 
 #define emith_or_r_imm_c(cond, r, imm) \
 	emith_or_r_imm(r, imm)
@@ -275,25 +347,31 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 	emith_ret()
 
 // _r_r_imm
-#define emith_add_r_r_imm(d, s, imm) { \
+#define emith_add_r_r_imm(d, s, imm) do { \
 	if (d != s) \
 		emith_move_r_r(d, s); \
 	emith_add_r_imm(d, imm); \
-}
+} while (0)
+
+#define emith_add_r_r_ptr_imm(d, s, imm) do { \
+	if (d != s) \
+		emith_move_r_r_ptr(d, s); \
+	emith_add_r_ptr_imm(d, imm); \
+} while (0)
 
-#define emith_and_r_r_imm(d, s, imm) { \
+#define emith_and_r_r_imm(d, s, imm) do { \
 	if (d != s) \
 		emith_move_r_r(d, s); \
 	emith_and_r_imm(d, imm); \
-}
+} while (0)
 
 // shift
-#define emith_shift(op, d, s, cnt) { \
+#define emith_shift(op, d, s, cnt) do { \
 	if (d != s) \
 		emith_move_r_r(d, s); \
 	EMIT_OP_MODRM(0xc1, 3, op, d); \
 	EMIT(cnt, u8); \
-}
+} while (0)
 
 #define emith_lsl(d, s, cnt) \
 	emith_shift(4, d, s, cnt)
@@ -317,45 +395,51 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 	EMIT_OP_MODRM(0xd1, 3, 3, r)
 
 // misc
-#define emith_push(r) \
-	EMIT_OP(0x50 + (r))
+#define emith_push(r) do { \
+	EMIT_REX_IF(0, 0, r); \
+	EMIT_OP(0x50 + ((r)&7)); \
+} while (0)
 
-#define emith_push_imm(imm) { \
+#define emith_push_imm(imm) do { \
 	EMIT_OP(0x68); \
 	EMIT(imm, u32); \
-}
+} while (0)
 
-#define emith_pop(r) \
-	EMIT_OP(0x58 + (r))
+#define emith_pop(r) do { \
+	EMIT_REX_IF(0, 0, r); \
+	EMIT_OP(0x58 + ((r)&7)); \
+} while (0)
 
 #define emith_neg_r(r) \
 	EMIT_OP_MODRM(0xf7, 3, 3, r)
 
-#define emith_clear_msb(d, s, count) { \
+#define emith_clear_msb(d, s, count) do { \
 	u32 t = (u32)-1; \
 	t >>= count; \
 	if (d != s) \
 		emith_move_r_r(d, s); \
 	emith_and_r_imm(d, t); \
-}
+} while (0)
 
-#define emith_clear_msb_c(cond, d, s, count) { \
+#define emith_clear_msb_c(cond, d, s, count) do { \
 	(void)(cond); \
 	emith_clear_msb(d, s, count); \
-}
+} while (0)
 
-#define emith_sext(d, s, bits) { \
+#define emith_sext(d, s, bits) do { \
 	emith_lsl(d, s, 32 - (bits)); \
 	emith_asr(d, d, 32 - (bits)); \
-}
+} while (0)
 
-#define emith_setc(r) { \
+#define emith_setc(r) do { \
+	EMIT_REX_IF(2, 0, r); /* for sil, dil */ \
 	EMIT_OP(0x0f); \
-	EMIT_OP_MODRM(0x92, 3, 0, r); /* SETC r */ \
-}
+	EMIT_OP(0x92); \
+	EMIT_MODRM(3, 0, r); /* SETC r */ \
+} while (0)
 
 // XXX: stupid mess
-#define emith_mul_(op, dlo, dhi, s1, s2) { \
+#define emith_mul_(op, dlo, dhi, s1, s2) do { \
 	int rmr; \
 	if (dlo != xAX && dhi != xAX) \
 		emith_push(xAX); \
@@ -381,7 +465,7 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 		emith_pop(xDX); \
 	if (dlo != xAX && dhi != xAX) \
 		emith_pop(xAX); \
-}
+} while (0)
 
 #define emith_mul_u64(dlo, dhi, s1, s2) \
 	emith_mul_(4, dlo, dhi, s1, s2) /* MUL */
@@ -393,7 +477,7 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 	emith_mul_(4, d, -1, s1, s2)
 
 // (dlo,dhi) += signed(s1) * signed(s2)
-#define emith_mula_s64(dlo, dhi, s1, s2) { \
+#define emith_mula_s64(dlo, dhi, s1, s2) do { \
 	emith_push(dhi); \
 	emith_push(dlo); \
 	emith_mul_(5, dlo, dhi, s1, s2); \
@@ -401,9 +485,9 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 	EMIT_SIB(0, 4, 4); /* add dlo, [esp] */ \
 	EMIT_OP_MODRM(0x13, 1, dhi, 4); \
 	EMIT_SIB(0, 4, 4); \
-	EMIT(4, u8); /* adc dhi, [esp+4] */ \
-	emith_add_r_imm(xSP, 4*2); \
-}
+	EMIT(PTR_SIZE, u8); /* adc dhi, [esp+4] */ \
+	emith_add_r_ptr_imm(xSP, PTR_SIZE*2); \
+} while (0)
 
 // "flag" instructions are the same
 #define emith_subf_r_imm emith_sub_r_imm
@@ -422,37 +506,57 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 #define emith_rolcf emith_rolc
 #define emith_rorcf emith_rorc
 
-#define emith_deref_op(op, r, rs, offs) do { \
+// op > 0xff: two byte 0x0f xx opcode
+#define emith_deref_op_(w, op, r, rs, offs) do { \
 	/* mov r <-> [ebp+#offs] */ \
-	if ((offs) >= 0x80) { \
-		EMIT_OP_MODRM(op, 2, r, rs); \
+	int mod_ = ((offs) < -0x80 || (offs) >= 0x80) ? 2 : 1; \
+	EMIT_REX_IF(w, r, rs); \
+	if ((op) > 0xff) \
+		EMIT((op) >> 8, u8); \
+	EMIT_OP((op) & 0xff); \
+	EMIT_MODRM(mod_, r, rs); \
+	if (((rs) & 7) == xSP) \
+		EMIT_SIB(0, 4, xSP); /* [esp], [r12] need SIB */ \
+	if (mod_ == 2) \
 		EMIT(offs, u32); \
-	} else { \
-		EMIT_OP_MODRM(op, 1, r, rs); \
-		EMIT(offs, u8); \
-	} \
+	else \
+		EMIT((u8)(offs), u8); \
 } while (0)
 
+#define emith_deref_op(op, r, rs, offs) \
+	emith_deref_op_(0, op, r, rs, offs)
+
 #define is_abcdx(r) (xAX <= (r) && (r) <= xDX)
 
+// doesn't touch flags
+#define emith_lea_r_r_offs(r, rs, offs) \
+	emith_deref_op(0x8d, r, rs, offs)
+
 #define emith_read_r_r_offs(r, rs, offs) \
 	emith_deref_op(0x8b, r, rs, offs)
 
 #define emith_write_r_r_offs(r, rs, offs) \
 	emith_deref_op(0x89, r, rs, offs)
 
-// note: don't use prefixes on this
-#define emith_read8_r_r_offs(r, rs, offs) do { \
-	int r_ = r; \
-	if (!is_abcdx(r)) \
-		r_ = rcache_get_tmp(); \
-	emith_deref_op(0x8a, r_, rs, offs); \
-	if ((r) != r_) { \
-		emith_move_r_r(r, r_); \
-		rcache_free_tmp(r_); \
-	} \
-} while (0)
+#define emith_read_r_r_offs_ptr(r, rs, offs) \
+	emith_deref_op_(1, 0x8b, r, rs, offs)
+
+#define emith_write_r_r_offs_ptr(r, rs, offs) \
+	emith_deref_op_(1, 0x89, r, rs, offs)
 
+// movzx, like ARM ldrb/ldrh
+#define emith_read8_r_r_offs(r, rs, offs) \
+	emith_deref_op(0x0fb6, r, rs, offs)
+
+#define emith_read16_r_r_offs(r, rs, offs) \
+	emith_deref_op(0x0fb7, r, rs, offs)
+
+#ifdef __x86_64__
+// REX makes sil, dil, r8b.. accessible, no need for temporaries
+#define emith_write8_r_r_offs(r, rs, offs) \
+	emith_deref_op_(2, 0x88, r, rs, offs)
+#else
+// note: don't use prefixes on this
 #define emith_write8_r_r_offs(r, rs, offs) do {\
 	int r_ = r; \
 	if (!is_abcdx(r)) { \
@@ -463,16 +567,12 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 	if ((r) != r_) \
 		rcache_free_tmp(r_); \
 } while (0)
+#endif
 
-#define emith_read16_r_r_offs(r, rs, offs) { \
-	EMIT(0x66, u8); /* operand override */ \
-	emith_read_r_r_offs(r, rs, offs); \
-}
-
-#define emith_write16_r_r_offs(r, rs, offs) { \
+#define emith_write16_r_r_offs(r, rs, offs) do { \
 	EMIT(0x66, u8); \
 	emith_write_r_r_offs(r, rs, offs); \
-}
+} while (0)
 
 #define emith_ctx_read(r, offs) \
 	emith_read_r_r_offs(r, CONTEXT_REG, offs)
@@ -480,6 +580,12 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 #define emith_ctx_write(r, offs) \
 	emith_write_r_r_offs(r, CONTEXT_REG, offs)
 
+#define emith_ctx_read_ptr(r, offs) \
+	emith_read_r_r_offs_ptr(r, CONTEXT_REG, offs)
+
+#define emith_ctx_write_ptr(r, offs) \
+	emith_write_r_r_offs_ptr(r, CONTEXT_REG, offs)
+
 #define emith_ctx_read_multiple(r, offs, cnt, tmpr) do { \
 	int r_ = r, offs_ = offs, cnt_ = cnt;     \
 	for (; cnt_ > 0; r_++, offs_ += 4, cnt_--) \
@@ -493,47 +599,54 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 } while (0)
 
 // assumes EBX is free
-#define emith_ret_to_ctx(offs) { \
+#define emith_ret_to_ctx(offs) do { \
 	emith_pop(xBX); \
 	emith_ctx_write(xBX, offs); \
-}
+} while (0)
 
-#define emith_jump(ptr) { \
-	u32 disp = (u32)(ptr) - ((u32)tcache_ptr + 5); \
+#define emith_jump(ptr) do { \
+	u32 disp = (u8 *)(ptr) - ((u8 *)tcache_ptr + 5); \
 	EMIT_OP(0xe9); \
 	EMIT(disp, u32); \
-}
+} while (0)
 
 #define emith_jump_patchable(target) \
 	emith_jump(target)
 
-#define emith_jump_cond(cond, ptr) { \
-	u32 disp = (u32)(ptr) - ((u32)tcache_ptr + 6); \
+#define emith_jump_cond(cond, ptr) do { \
+	u32 disp = (u8 *)(ptr) - ((u8 *)tcache_ptr + 6); \
 	EMIT(0x0f, u8); \
 	EMIT_OP(0x80 | (cond)); \
 	EMIT(disp, u32); \
-}
+} while (0)
 
 #define emith_jump_cond_patchable(cond, target) \
 	emith_jump_cond(cond, target)
 
 #define emith_jump_patch(ptr, target) do { \
-	u32 disp_ = (u32)(target) - ((u32)(ptr) + 4); \
+	u32 disp_ = (u8 *)(target) - ((u8 *)(ptr) + 4); \
 	u32 offs_ = (*(u8 *)(ptr) == 0x0f) ? 2 : 1; \
 	EMIT_PTR((u8 *)(ptr) + offs_, disp_ - offs_, u32); \
 } while (0)
 
-#define emith_jump_at(ptr, target) { \
-	u32 disp_ = (u32)(target) - ((u32)(ptr) + 5); \
+#define emith_jump_at(ptr, target) do { \
+	u32 disp_ = (u8 *)(target) - ((u8 *)(ptr) + 5); \
 	EMIT_PTR(ptr, 0xe9, u8); \
 	EMIT_PTR((u8 *)(ptr) + 1, disp_, u32); \
-}
+} while (0)
 
-#define emith_call(ptr) { \
-	u32 disp = (u32)(ptr) - ((u32)tcache_ptr + 5); \
-	EMIT_OP(0xe8); \
-	EMIT(disp, u32); \
-}
+// x86-64: functions may be out of rel32 reach from tcache,
+// call through r11 (not used for args or by reg cache) then
+#define emith_call(ptr) do { \
+	ptrdiff_t disp_ = (u8 *)(ptr) - ((u8 *)tcache_ptr + 5); \
+	if (PTR_SIZE == 8 && disp_ != (int)disp_) { \
+		emith_move_r_ptr_imm(xR11, ptr); \
+		emith_call_reg(xR11); \
+	} else { \
+		EMIT_OP(0xe8); \
+		EMIT((u32)disp_, u32); \
+	} \
+} while (0)
 
 #define emith_call_cond(cond, ptr) \
 	emith_call(ptr)
@@ -541,10 +654,10 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 #define emith_call_reg(r) \
 	EMIT_OP_MODRM(0xff, 3, 2, r)
 
-#define emith_call_ctx(offs) { \
+#define emith_call_ctx(offs) do { \
 	EMIT_OP_MODRM(0xff, 2, 2, CONTEXT_REG); \
 	EMIT(offs, u32); \
-}
+} while (0)
 
 #define emith_ret() \
 	EMIT_OP(0xc3)
@@ -552,10 +665,10 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 #define emith_jump_reg(r) \
 	EMIT_OP_MODRM(0xff, 3, 4, r)
 
-#define emith_jump_ctx(offs) { \
+#define emith_jump_ctx(offs) do { \
 	EMIT_OP_MODRM(0xff, 2, 4, CONTEXT_REG); \
 	EMIT(offs, u32); \
-}
+} while (0)
 
 #define emith_push_ret()
 
@@ -591,19 +704,92 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 #define EMITH_SJMP3_MID EMITH_JMP3_MID
 #define EMITH_SJMP3_END EMITH_JMP3_END
 
-#define emith_pass_arg_r(arg, reg) { \
+#define emith_pass_arg_r(arg, reg) do { \
 	int rd = 7; \
 	host_arg2reg(rd, arg); \
-	emith_move_r_r(rd, reg); \
-}
+	emith_move_r_r_ptr(rd, reg); \
+} while (0)
 
-#define emith_pass_arg_imm(arg, imm) { \
+#define emith_pass_arg_imm(arg, imm) do { \
 	int rd = 7; \
 	host_arg2reg(rd, arg); \
 	emith_move_r_imm(rd, imm); \
+} while (0)
+
+#define host_instructions_updated(base, end) do { \
+	(void)(base); (void)(end); \
+} while (0)
+
+// save/restore scratch regs around calls, keeping stack aligned to 16
+// for the SysV x86-64 ABI
+#define emith_save_caller_regs(mask) do { \
+	u32 m_ = (mask) & CALLER_SAVE_REGS; \
+	int r_; \
+	if (PTR_SIZE == 8 && (__builtin_popcount(m_) & 1)) \
+		emith_sub_r_ptr_imm(xSP, PTR_SIZE); \
+	for (r_ = 0; m_ != 0; r_++, m_ >>= 1) \
+		if (m_ & 1) \
+			emith_push(r_); \
+} while (0)
+
+#define emith_restore_caller_regs(mask) do { \
+	u32 m_ = (mask) & CALLER_SAVE_REGS; \
+	int r_; \
+	for (r_ = 15; r_ >= 0; r_--) \
+		if (m_ & (1 << r_)) \
+			emith_pop(r_); \
+	if (PTR_SIZE == 8 && (__builtin_popcount(m_) & 1)) \
+		emith_add_r_ptr_imm(xSP, PTR_SIZE); \
+} while (0)
+
+#ifdef __x86_64__
+
+// SysV ABI
+#define host_arg2reg(rd, arg) \
+	switch (arg) { \
+	case 0: rd = xDI; break; \
+	case 1: rd = xSI; break; \
+	case 2: rd = xDX; break; \
+	case 3: rd = xCX; break; \
+	}
+
+/* SH2 drc specific */
+// 6 pushes + ret addr + pad keep the stack 16 byte aligned for calls
+#define emith_sh2_drc_entry() do { \
+	emith_push(xBX);        \
+	emith_push(xBP);        \
+	emith_push(xR12);       \
+	emith_push(xR13);       \
+	emith_push(xR14);       \
+	emith_push(xR15);       \
+	emith_sub_r_ptr_imm(xSP, 8); \
+} while (0)
+
+#define emith_sh2_drc_exit() {  \
+	emith_add_r_ptr_imm(xSP, 8); \
+	emith_pop(xR15);        \
+	emith_pop(xR14);        \
+	emith_pop(xR13);        \
+	emith_pop(xR12);        \
+	emith_pop(xBP);         \
+	emith_pop(xBX);         \
+	emith_ret();            \
 }
 
-#define host_instructions_updated(base, end)
+// r11 is not used by reg cache
+#define emith_sh2_wcall(a, tab) do { \
+	int arg2_; \
+	host_arg2reg(arg2_, 2); \
+	emith_lsr(xR11, a, SH2_WRITE_SHIFT); \
+	EMIT_REX(1, xR11, xR11, tab); \
+	EMIT_OP(0x8b); \
+	EMIT_MODRM(0, xR11, 4); \
+	EMIT_SIB(3, xR11, tab); /* mov r11, [tab + r11 * 8] */ \
+	emith_move_r_r_ptr(arg2_, CONTEXT_REG); \
+	emith_jump_reg(xR11); \
+} while (0)
+
+#else // i386
 
 #define host_arg2reg(rd, arg) \
 	switch (arg) { \
@@ -613,12 +799,12 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 	}
 
 /* SH2 drc specific */
-#define emith_sh2_drc_entry() { \
+#define emith_sh2_drc_entry() do { \
 	emith_push(xBX);        \
 	emith_push(xBP);        \
 	emith_push(xSI);        \
 	emith_push(xDI);        \
-}
+} while (0)
 
 #define emith_sh2_drc_exit() {  \
 	emith_pop(xDI);         \
@@ -629,7 +815,7 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 }
 
 // assumes EBX is free temporary
-#define emith_sh2_wcall(a, tab) { \
+#define emith_sh2_wcall(a, tab) do { \
 	int arg2_; \
 	host_arg2reg(arg2_, 2); \
 	emith_lsr(xBX, a, SH2_WRITE_SHIFT); \
@@ -637,9 +823,11 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 	EMIT_SIB(2, xBX, tab); /* mov ebx, [tab + ebx * 4] */ \
 	emith_move_r_r(arg2_, CONTEXT_REG); \
 	emith_jump_reg(xBX); \
-}
+} while (0)
+
+#endif
 
-#define emith_sh2_dtbf_loop() { \
+#define emith_sh2_dtbf_loop() do { \
 	u8 *jmp0; /* negative cycles check */            \
 	u8 *jmp1; /* unsinged overflow check */          \
 	int cr, rn;                                      \
@@ -663,15 +851,15 @@ enum { xAX = 0, xCX, xDX, xBX, xSP, xBP, xSI, xDI };
 	emith_move_r_imm(rn, 0);                         \
 	JMP8_EMIT(ICOND_JA, jmp1);                       \
 	rcache_free_tmp(tmp_);                           \
-}
+} while (0)
 
-#define emith_write_sr(sr, srcr) { \
+#define emith_write_sr(sr, srcr) do { \
 	int tmp_ = rcache_get_tmp(); \
 	emith_clear_msb(tmp_, srcr, 22); \
 	emith_bic_r_imm(sr, 0x3ff); \
 	emith_or_r_r(sr, tmp_); \
 	rcache_free_tmp(tmp_); \
-}
+} while (0)
 
 #define emith_tpop_carry(sr, is_sub) \
 	emith_lsr(sr, sr, 1)
@@ -0,0 +1,3008 @@
+/*
+ * 68000 to x86-64 recompiler
+ * (C) agent, 2026
+ *
+ * This work is licensed under the terms of MAME license.
+ * See COPYING file in the top-level directory.
+ *
+ * notes:
+ * - runs on FAME contexts and is cycle exact to FAME: the counter is
+ *   updated after every instruction, so memory handlers see the same
+ *   SekCyclesLeft, and irqs are taken at the same points.
+ * - blocks are keyed by pc and the host address the code is fetched
+ *   from (Fetch[]), so bank switched ROM and word RAM swaps don't need
+ *   a flush, they just find other blocks.
+ * - common instructions are translated, the rest (and anything that
+ *   would take an exception) is run by a second FAME build with
+ *   function handlers (famec_ops.c), one opcode at a time.
+ * - while in translated code the ccr is kept in x86 format:
+ *   drc_ccr[0] is OF, [1] is lahf AH (SF ZF CF), [2] is X. The first
+ *   two live in r14 (as AX after lahf/seto), the counter in r15, and
+ *   the 68k registers a block uses most in rbx, r12, r13, r9, r10.
+ *   The context is updated when leaving a block or calling into C.
+ * - writes to host memory that has translated code invalidate it
+ *   (64 byte pages), a block modifying itself is not handled. Pages
+ *   that keep losing their blocks are left to FAME.
+ * - the main 68k's ram is read and written inline, other memory goes
+ *   through the map helpers.
+ */
+#include <stddef.h>
+
+#include "../../pico/pico_int.h"
+#include "../../pico/memory.h"
+#include "compiler.h"
+
+typedef signed char  s8;
+typedef signed short s16;
+typedef signed int   s32;
+
+#define TCACHE_SIZE     (4*1024*1024)
+#define TCACHE_RESERVE  0x10000 // room one block may need
+#define MAX_BLOCKS      0x4000
+#define HASH_SIZE       0x4000
+#define JC_SIZE         0x1000  // jump cache entries, per cpu
+#define PAGE_SHIFT      6
+#define PAGE_HASH       0x10000
+#define BLOCK_INSNS     64
+#define BLOCK_BYTES     256
+#define BLOCK_PAGES     ((BLOCK_BYTES + 16) / (1 << PAGE_SHIFT) + 2)
+#define MAX_STUBS       (BLOCK_INSNS * 3)
+#define MAX_FWD         BLOCK_INSNS
+#define SMC_LIMIT       4 // invalidations before a page is left to FAME
+
+#define TR_NO   0 // not translated, interpret
+#define TR_OK   1
+#define TR_END  2 // block ends here
+
+// FAME exception cost when an address error ends a run
+#define GROUP0_CYCLES   50
+
+struct block_desc;
+
+struct page_link {
+  struct block_desc *block;
+  struct page_link *next, *prev;
+};
+
+struct block_desc {
+  u32 pc;
+  int cpu;
+  const u8 *src;
+  u32 len;
+  u32 hash;
+  u8 *code;
+  struct block_desc *next; // hash chain
+  int npages;
+  struct page_link pages[BLOCK_PAGES];
+};
+
+// layout is used by the dispatcher
+struct jc_entry {
+  u32 pc;
+  u32 pad;
+  const u8 *src;
+  u8 *code;
+  void *pad2;
+};
+
+static struct drc_cpu {
+  M68K_CONTEXT *ctx;
+  u8 *dispatch;
+  u8 *rd8, *rd16, *rd32;
+  u8 *wr8, *wr16, *wr32, *wr32dec;
+  u8 *wcheck;
+  uptr *r8map, *r16map, *w8map, *w16map;
+  // memory callbacks the helpers match, and their invalidating versions
+  void *read8, *read16, *read32, *write8, *write16, *write32;
+  void *wrap8, *wrap16, *wrap32;
+  struct jc_entry *jc; // JC_SIZE
+  int ram;             // e00000-ffffff is Pico.ram, accessed inline
+  s32 ram_offs;        // Pico.ram - ctx
+  s32 ram_code_offs;   // ram_code - ctx
+} cpus[2];
+
+#define RAM_PAGES  (0x10000 >> PAGE_SHIFT)
+
+// blocks in each page of Pico.ram, so that inline writes can tell
+// cheaply if they need the invalidating helper; one spare for .l
+static u16 ram_code[RAM_PAGES + 1];
+
+// all allocated by fm68k_drc_init, so that every emulator instance
+// (see pico/context.c) has its own and only these pointers are swapped
+static u8 *tcache_m68k; // TCACHE_SIZE
+static u8 *tcache_ptr;
+static u8 *tcache_blocks; // first block, after the stubs
+
+static struct block_desc *blocks;
+static int block_count;
+static struct block_desc **hash_table; // HASH_SIZE
+static struct page_link **page_list;   // PAGE_HASH
+static u8 *page_code;                  // PAGE_HASH
+static u8 *page_inval;                 // PAGE_HASH, blocks lost to writes
+
+static void (*drc_entry)(M68K_CONTEXT *ctx, const u8 *code);
+static u8 *drc_exit;
+static void (**ops_jt)(void);
+static int drc_ready;
+static int drc_depth;
+static int flush_pending;
+static int stop_left, stop_hit; // end the run early, FAME style
+static int inval_left, inval_hit; // leave translated code, then go on
+static int sr_hit; // SR was written, irq or trace to check
+
+#define COUNT_OP
+#include "../drc/emit_x86.c"
+
+#define CTX(f)     offsetof(M68K_CONTEXT, f)
+#define DREG(r)    (CTX(dreg) + (r) * 4) // 8-15 are An
+#define AREG(r)    (CTX(areg) + (r) * 4)
+#define CNT        CTX(io_cycle_counter)
+#define CCR        CTX(drc_ccr)
+
+// host registers in translated code, see notes
+#define RCNT       xR15
+#define RCCR       xR14
+static const s8 cache_regs[] = { xBX, xR12, xR13, xR9, xR10 };
+
+#define HASH_FUNC(pc)  (((pc) >> 1) & (HASH_SIZE - 1))
+#define PAGE_FUNC(p)   (((uptr)(p) >> PAGE_SHIFT) & (PAGE_HASH - 1))
+
+// --------------------------------------------------------------------
+// x86 emitters not in emit_x86.c, sz is the 68k size (1, 2, 4)
+
+// spl, bpl, sil, dil need REX for 8bit access
+static int rex8(int sz, int r)
+{
+  return (sz == 1 && r >= xSP && r <= xDI) ? 2 : 0;
+}
+
+static void emit_osize(int sz)
+{
+  if (sz == 2)
+    EMIT(0x66, u8);
+}
+
+static void emit_imm(int sz, u32 imm)
+{
+  if (sz == 1)
+    EMIT(imm, u8);
+  else if (sz == 2)
+    EMIT(imm, u16);
+  else
+    EMIT(imm, u32);
+}
+
+// <op> [rbp+offs], r; op is the byte form (00 add, 08 or, 20 and, 28 sub,
+// 30 xor, 38 cmp, 84 test, 88 mov), +2 gives <op> r, [rbp+offs]
+static void emit_op_m_r(int sz, int op, int r, int offs)
+{
+  emit_osize(sz);
+  emith_deref_op_(rex8(sz, r), sz == 1 ? op : op + 1, r, xBP, offs);
+}
+
+// <op> d, s
+static void emit_op_r_r(int sz, int op, int d, int s)
+{
+  emit_osize(sz);
+  EMIT_REX_IF(rex8(sz, d) | rex8(sz, s), s, d);
+  EMIT_OP(sz == 1 ? op : op + 1);
+  EMIT_MODRM(3, s, d);
+}
+
+// group 1 (80/81 /ext): 0 add, 1 or, 4 and, 5 sub, 6 xor, 7 cmp
+static void emit_op_r_imm(int sz, int ext, int r, u32 imm)
+{
+  emit_osize(sz);
+  EMIT_REX_IF(rex8(sz, r), 0, r);
+  EMIT_OP(sz == 1 ? 0x80 : 0x81);
+  EMIT_MODRM(3, ext, r);
+  emit_imm(sz, imm);
+}
+
+static void emit_op_m_imm(int sz, int ext, int offs, u32 imm)
+{
+  emit_osize(sz);
+  emith_deref_op(sz == 1 ? 0x80 : 0x81, ext, xBP, offs);
+  emit_imm(sz, imm);
+}
+
+// group 3 (f6/f7 /ext): 2 not, 3 neg
+static void emit_unary_r(int sz, int ext, int r)
+{
+  emit_osize(sz);
+  EMIT_REX_IF(rex8(sz, r), 0, r);
+  EMIT_OP(sz == 1 ? 0xf6 : 0xf7);
+  EMIT_MODRM(3, ext, r);
+}
+
+// group 2 (c0/c1 /ext): 0 rol, 1 ror, 4 shl, 5 shr, 7 sar
+static void emit_shift_r(int sz, int ext, int r, int n)
+{
+  emit_osize(sz);
+  EMIT_REX_IF(rex8(sz, r), 0, r);
+  EMIT_OP(sz == 1 ? 0xc0 : 0xc1);
+  EMIT_MODRM(3, ext, r);
+  EMIT(n, u8);
+}
+
+// r = zero or sign extended [rbp+offs]
+static void emit_load(int sz, int sx, int r, int offs)
+{
+  if (sz == 4)
+    emith_ctx_read(r, offs);
+  else if (sz == 2)
+    emith_deref_op(sx ? 0x0fbf : 0x0fb7, r, xBP, offs);
+  else
+    emith_deref_op(sx ? 0x0fbe : 0x0fb6, r, xBP, offs);
+}
+
+static void emit_store(int sz, int r, int offs)
+{
+  emit_op_m_r(sz, 0x88, r, offs);
+}
+
+static void emit_store_imm(int sz, int offs, u32 imm)
+{
+  emit_osize(sz);
+  emith_deref_op(sz == 1 ? 0xc6 : 0xc7, 0, xBP, offs);
+  emit_imm(sz, imm);
+}
+
+// movzx/movsx d, s (8 or 16 bit)
+static void emit_ext_r(int sz, int sx, int d, int s)
+{
+  EMIT_REX_IF(rex8(sz, s), d, s);
+  EMIT(0x0f, u8);
+  EMIT_OP((sx ? 0xbe : 0xb6) + (sz == 2));
+  EMIT_MODRM(3, d, s);
+}
+
+static void emit_sext_imm(int sz, u32 *v)
+{
+  if (sz == 1)
+    *v = (s8)*v;
+  else if (sz == 2)
+    *v = (s16)*v;
+}
+
+// <op> r, [base + index*(1 << scale)], base can't be rbp/r13
+static void emit_op_sib(int w, int op, int r, int base, int index, int scale)
+{
+  EMIT_REX_IF(w, r, base | (index & 8));
+  if (index > 7)
+    tcache_ptr[-1] |= 2; // REX.X
+  if (op > 0xff)
+    EMIT(op >> 8, u8);
+  EMIT_OP(op & 0xff);
+  EMIT_MODRM(0, r, 4);
+  EMIT_SIB(scale, index, base);
+}
+
+// ccr from the flags of the last x86 op, x: also X = C
+static void emit_flags(int x)
+{
+  if (x)
+    emith_deref_op(0x0f92, 0, xBP, CCR + 2); // setc [x]
+  EMIT_OP(0x9f);                             // lahf
+  EMIT(0x0f, u8); EMIT_OP(0x90);
+  EMIT_MODRM(3, 0, xAX);                     // seto al
+  emith_move_r_r(RCCR, xAX);
+}
+
+// same, V cleared (shifts)
+static void emit_flags_v0(int x)
+{
+  if (x)
+    emith_deref_op(0x0f92, 0, xBP, CCR + 2);
+  EMIT_OP(0x9f);
+  EMIT_OP(0xb0); EMIT(0, u8);                // mov al, 0
+  emith_move_r_r(RCCR, xAX);
+}
+
+// N and Z known, V and C clear
+static void emit_flags_const(u32 v, int sz)
+{
+  int ah = 0;
+  emit_sext_imm(sz, &v);
+  if ((s32)v < 0)  ah |= 0x80;
+  if (v == 0)      ah |= 0x40;
+  emith_move_r_imm(RCCR, ah << 8);
+}
+
+// only Z changes, Z = !CF (bit ops)
+static void emit_flags_z_nc(void)
+{
+  EMIT(0x0f, u8); EMIT_OP(0x93); EMIT_MODRM(3, 0, xAX); // setnc al
+  emit_ext_r(1, 0, xAX, xAX);
+  emith_lsl(xAX, xAX, 14);
+  emith_and_r_imm(RCCR, ~0x4000);
+  emith_or_r_r(RCCR, xAX);
+}
+
+// x86 flags from the ccr, for jcc/setcc
+static void emit_flags_load(void)
+{
+  emith_move_r_r(xAX, RCCR);
+  EMIT_OP(0x04); EMIT(0x7f, u8);             // add al, 0x7f: OF
+  EMIT_OP(0x9e);                             // sahf
+}
+
+// CF = X, for adc, sbb, rcl, rcr
+static void emit_x_to_cf(void)
+{
+  emit_load(1, 0, xAX, CCR + 2);
+  emith_lsr(xAX, xAX, 1);
+}
+
+// ccr after adc/sbb (ADDX SUBX NEGX): like emit_flags(1), but Z is
+// only ever cleared. FAME's .l forms get C and X their own way:
+enum {
+  XC_X86,      // x86 CF
+  XC_NZ,       // NEGX: result not zero
+  XC_ADD,      // ADDX: carry of src (ecx) + dst (esi), without X
+  XC_SUB,      // SUBX: carry of src (ecx) + result (edx)
+};
+
+static void emit_flags_addx(int xc)
+{
+  if (xc == XC_X86)
+    emith_deref_op(0x0f92, 0, xBP, CCR + 2);   // setc [x]
+  EMIT_OP(0x9f);                               // lahf
+  EMIT(0x0f, u8); EMIT_OP(0x90);
+  EMIT_MODRM(3, 0, xAX);                       // seto al
+  if (xc != XC_X86) {
+    if (xc == XC_NZ) {
+      emith_move_r_r(xCX, xAX);
+      emith_lsr(xCX, xCX, 14);
+      emith_and_r_imm(xCX, 1);
+      emith_eor_r_imm(xCX, 1);
+    }
+    else {
+      if (xc == XC_SUB)
+        emith_move_r_r(xSI, xDX);
+      emith_add_r_r(xSI, xCX);
+      EMIT(0x0f, u8); EMIT_OP(0x92); EMIT_MODRM(3, 0, xCX); // setc cl
+      emit_ext_r(1, 0, xCX, xCX);
+    }
+    emit_store(1, xCX, CCR + 2);
+    emith_lsl(xCX, xCX, 8);
+    emith_and_r_imm(xAX, ~0x100);
+    emith_or_r_r(xAX, xCX);
+  }
+  emith_move_r_r(xCX, RCCR);
+  emith_or_r_imm(xCX, ~0x4000);
+  emith_and_r_r(xAX, xCX);
+  emith_move_r_r(RCCR, xAX);
+}
+
+// 68k condition -> x86 jcc, T and F are handled by callers
+static const s8 cond_x86[16] = {
+  -1, -1, ICOND_JA, ICOND_JBE, ICOND_JAE, ICOND_JB, ICOND_JNE, ICOND_JE,
+  ICOND_JNO, ICOND_JO, ICOND_JNS, ICOND_JS, ICOND_JGE, ICOND_JL, ICOND_JG, ICOND_JLE
+};
+
+// --------------------------------------------------------------------
+// translation state
+
+static struct {
+  struct drc_cpu *c;
+  u32 start_pc;
+  u32 pc;            // current instruction
+  const u16 *op;
+  const u16 *p;      // next extension word
+  int n;
+  u32 insn_pc[BLOCK_INSNS];
+  u8 *insn_code[BLOCK_INSNS];
+  int nstubs;
+  struct {
+    u8 *jmp;
+    u32 pc;
+  } stubs[MAX_STUBS], fwd[MAX_FWD]; // fwd: jumps ahead in the block
+  int nfwd;
+  s8 hreg[16];       // host register of Dn/An, -1 if in the context
+  int use[16];       // accesses, counted in the first pass
+  u32 dirty;         // registers the block writes
+  u8 *exit, *disp;   // write back, then drc_exit or the dispatcher
+  u8 *entry;         // loads the cached registers
+} tr;
+
+#define NEXT_PC (tr.pc + (u32)((const u8 *)tr.p - (const u8 *)tr.op))
+
+static u32 fetch16(void)
+{
+  return *tr.p++;
+}
+
+static u32 fetch32(void)
+{
+  u32 v = *tr.p++ << 16;
+  return v | *tr.p++;
+}
+
+// --------------------------------------------------------------------
+// 68k registers, r is 0-15 (An is 8 + n). Cached ones are operated on
+// in their host register, the others in the context
+
+#define reg_count(r)  tr.use[r]++
+#define reg_dirty(r)  tr.dirty |= 1 << (r)
+
+// d = zero or sign extended Rr
+static void reg_load(int sz, int sx, int d, int r)
+{
+  int h = tr.hreg[r];
+  reg_count(r);
+  if (h < 0)
+    emit_load(sz, sx, d, DREG(r));
+  else if (sz < 4)
+    emit_ext_r(sz, sx, d, h);
+  else if (d != h)
+    emith_move_r_r(d, h);
+}
+
+// low sz bytes of Rr = s
+static void reg_store(int sz, int s, int r)
+{
+  int h = tr.hreg[r];
+  reg_count(r);
+  reg_dirty(r);
+  if (h < 0)
+    emit_store(sz, s, DREG(r));
+  else if (sz < 4)
+    emit_op_r_r(sz, 0x88, h, s);
+  else if (s != h)
+    emith_move_r_r(h, s);
+}
+
+static void reg_store_imm(int sz, int r, u32 imm)
+{
+  int h = tr.hreg[r];
+  reg_count(r);
+  reg_dirty(r);
+  if (h < 0)
+    emit_store_imm(sz, DREG(r), imm);
+  else if (sz == 4)
+    emith_move_r_imm(h, imm);
+  else {
+    emit_osize(sz);
+    EMIT_REX_IF(rex8(sz, h), 0, h);
+    EMIT_OP((sz == 1 ? 0xb0 : 0xb8) + (h & 7)); // mov r8/r16, imm
+    emit_imm(sz, imm);
+  }
+}
+
+// <op> Rr, s (op as for emit_op_m_r), only 0x38 and 0x84 don't write
+static void reg_op(int sz, int op, int s, int r)
+{
+  int h = tr.hreg[r];
+  reg_count(r);
+  if (op != 0x38 && op != 0x84)
+    reg_dirty(r);
+  if (h < 0)
+    emit_op_m_r(sz, op, s, DREG(r));
+  else
+    emit_op_r_r(sz, op, h, s);
+}
+
+// <op> d, Rr
+static void reg_op_to(int sz, int op, int d, int r)
+{
+  int h = tr.hreg[r];
+  reg_count(r);
+  if (h < 0)
+    emit_op_m_r(sz, op + 2, d, DREG(r));
+  else
+    emit_op_r_r(sz, op, d, h);
+}
+
+// group 1 <ext> Rr, imm
+static void reg_op_imm(int sz, int ext, int r, u32 imm)
+{
+  int h = tr.hreg[r];
+  reg_count(r);
+  if (ext != 7)
+    reg_dirty(r);
+  if (h < 0)
+    emit_op_m_imm(sz, ext, DREG(r), imm);
+  else
+    emit_op_r_imm(sz, ext, h, imm);
+}
+
+// registers the block changed back to the context
+static void emit_reg_writeback(void)
+{
+  int r;
+  for (r = 0; r < 16; r++)
+    if (tr.hreg[r] >= 0 && (tr.dirty & (1 << r)))
+      emith_ctx_write(tr.hreg[r], DREG(r));
+}
+
+static void emit_reg_reload(void)
+{
+  int r;
+  for (r = 0; r < 16; r++)
+    if (tr.hreg[r] >= 0)
+      emith_ctx_read(tr.hreg[r], DREG(r));
+}
+
+// give the most used registers a host register, for the second pass
+static void reg_alloc(void)
+{
+  int i, r, best;
+
+  memset(tr.hreg, -1, sizeof(tr.hreg));
+  for (i = 0; i < (int)ARRAY_SIZE(cache_regs); i++) {
+    best = -1;
+    for (r = 0; r < 16; r++)
+      if (tr.hreg[r] < 0 && tr.use[r] >= 2
+          && (best < 0 || tr.use[r] > tr.use[best]))
+        best = r;
+    if (best < 0)
+      break;
+    tr.hreg[best] = cache_regs[i];
+  }
+}
+
+// cycle counter and ccr to the context and back, around calls that
+// use them
+static void emit_sync_out(void)
+{
+  emith_ctx_write(RCNT, CNT);
+  emit_op_m_r(2, 0x88, RCCR, CCR);
+}
+
+static void emit_sync_in(void)
+{
+  emith_ctx_read(RCNT, CNT);
+  emith_deref_op(0x0fb7, RCCR, xBP, CCR);
+}
+
+// sub cnt, cyc; exit with pc if out of cycles
+static void emit_cycles(int cyc, u32 pc)
+{
+  emit_op_r_imm(4, 5, RCNT, cyc);
+  tr.stubs[tr.nstubs].jmp = tcache_ptr;
+  tr.stubs[tr.nstubs].pc = pc;
+  tr.nstubs++;
+  emith_jump_cond(ICOND_JLE, tcache_ptr);
+}
+
+// same, pc is in eax
+static void emit_cycles_eax(int cyc)
+{
+  emit_op_r_imm(4, 5, RCNT, cyc);
+  emith_jump_cond(ICOND_JLE, tr.exit);
+}
+
+// continue at a known pc, cycles are already accounted. Targets ahead
+// that the block may reach are patched in translate()
+static void emit_goto(u32 pc)
+{
+  int i;
+  for (i = 0; i < tr.n; i++) {
+    if (tr.insn_pc[i] == pc) {
+      emith_jump(tr.insn_code[i]);
+      return;
+    }
+  }
+  if (pc > tr.pc && pc - tr.start_pc < BLOCK_BYTES && tr.nfwd < MAX_FWD) {
+    tr.fwd[tr.nfwd].jmp = tcache_ptr;
+    tr.fwd[tr.nfwd].pc = pc;
+    tr.nfwd++;
+    emith_jump(tcache_ptr);
+    return;
+  }
+  emith_move_r_imm(xAX, pc);
+  emith_jump(tr.disp);
+}
+
+// run the instruction at tr.pc with FAME, ends the block
+static void emit_interp(void);
+
+// --------------------------------------------------------------------
+// effective addresses
+
+enum { EA_DN, EA_AN, EA_AI, EA_PI, EA_PD, EA_DI, EA_IX,
+       EA_AW, EA_AL, EA_PCDI, EA_PCIX, EA_IMM };
+
+struct ea {
+  int mode;
+  int reg;
+  u32 val; // displacement, address or immediate
+  u32 ext; // index extension word
+};
+
+// FAME timing
+static const u8 ea_cyc_bw[12] = { 0, 0, 4, 4, 6, 8, 10, 8, 12, 8, 10, 4 };
+static const u8 ea_cyc_l[12]  = { 0, 0, 8, 8, 10, 12, 14, 12, 16, 12, 14, 8 };
+
+#define ea_cyc(ea, sz) \
+  ((sz) == 4 ? ea_cyc_l[(ea)->mode] : ea_cyc_bw[(ea)->mode])
+#define ea_is_mem(ea) \
+  ((ea)->mode >= EA_AI && (ea)->mode != EA_IMM)
+
+static int ea_decode(struct ea *ea, int mode, int reg, int sz)
+{
+  ea->reg = reg;
+  ea->mode = mode < 7 ? mode : 7 + reg;
+  switch (ea->mode) {
+  case EA_DI:
+  case EA_AW:
+    ea->val = (s16)fetch16();
+    break;
+  case EA_IX:
+    ea->ext = fetch16();
+    break;
+  case EA_AL:
+    ea->val = fetch32();
+    break;
+  case EA_PCDI:
+    ea->val = NEXT_PC;
+    ea->val += (s16)fetch16();
+    break;
+  case EA_PCIX:
+    ea->val = NEXT_PC;
+    ea->ext = fetch16();
+    break;
+  case EA_IMM:
+    ea->val = sz == 4 ? fetch32() : fetch16();
+    if (sz == 1)
+      ea->val &= 0xff;
+    break;
+  default:
+    if (ea->mode > EA_IMM)
+      return 0;
+    break;
+  }
+  return 1;
+}
+
+static void emit_index(u32 ext)
+{
+  reg_load((ext & 0x800) ? 4 : 2, 1, xCX, ext >> 12);
+  emith_add_r_r(xDI, xCX);
+  if ((s8)ext != 0)
+    emith_add_r_imm(xDI, (s8)ext);
+}
+
+// edi = address, does (An)+ and -(An) updates, uses ecx
+static void emit_ea_addr(const struct ea *ea, int sz)
+{
+  int inc = (sz == 1 && ea->reg == 7) ? 2 : sz;
+
+  switch (ea->mode) {
+  case EA_AI:
+    reg_load(4, 0, xDI, 8 + ea->reg);
+    break;
+  case EA_PI:
+    reg_load(4, 0, xDI, 8 + ea->reg);
+    reg_op_imm(4, 0, 8 + ea->reg, inc);
+    break;
+  case EA_PD:
+    reg_load(4, 0, xDI, 8 + ea->reg);
+    emith_sub_r_imm(xDI, inc);
+    reg_store(4, xDI, 8 + ea->reg);
+    break;
+  case EA_DI:
+    reg_load(4, 0, xDI, 8 + ea->reg);
+    emith_add_r_imm(xDI, ea->val);
+    break;
+  case EA_IX:
+    reg_load(4, 0, xDI, 8 + ea->reg);
+    emit_index(ea->ext);
+    break;
+  case EA_AW:
+  case EA_AL:
+  case EA_PCDI:
+    emith_move_r_imm(xDI, ea->val);
+    break;
+  case EA_PCIX:
+    emith_move_r_imm(xDI, ea->val);
+    emit_index(ea->ext);
+    break;
+  }
+}
+
+// <op> r, [rbp + rax], Pico.ram is at a fixed distance from ctx
+static void emit_op_ram(int w, int op, int r)
+{
+  EMIT_REX_IF(w, r, 0);
+  if (op > 0xff)
+    EMIT(op >> 8, u8);
+  EMIT_OP(op & 0xff);
+  EMIT_MODRM(2, r, 4);
+  EMIT_SIB(0, xAX, xBP);
+  EMIT(tr.c->ram_offs, u32);
+}
+
+// eax = ram offset of edi, jumps to the returned jmp8s if it isn't ram
+static void emit_ram_check(int sz, u8 **jr, u8 **jc)
+{
+  emith_move_r_r(xAX, xDI);
+  emith_and_r_imm(xAX, 0xe00000);
+  emith_cmp_r_imm(xAX, 0xe00000);
+  JMP8_POS(*jr);
+  emit_ext_r(2, 0, xAX, xDI);
+  *jc = NULL;
+  if (sz == 4) {
+    // crosses the end of the bank
+    emith_cmp_r_imm(xAX, 0xfffe);
+    JMP8_POS(*jc);
+  }
+  else if (sz == 1)
+    emith_eor_r_imm(xAX, 1);
+}
+
+// is there code in the ram page at eax? .l checks the next one too;
+// jne to the returned jmp8
+static u8 *emit_ram_code_check(int sz)
+{
+  u8 *jp;
+
+  emith_move_r_r(xDX, xAX);
+  emith_lsr(xDX, xDX, PAGE_SHIFT);
+  if (sz != 4)
+    EMIT(0x66, u8);
+  EMIT_OP(0x83);
+  EMIT_MODRM(2, 7, 4);
+  EMIT_SIB(1, xDX, xBP);
+  EMIT(tr.c->ram_code_offs, u32);
+  EMIT(0, u8);                                  // cmp [rbp + rdx*2 + ..], 0
+  JMP8_POS(jp);
+  return jp;
+}
+
+// eax = read from edi, main 68k ram inline, the rest in the helpers
+static void emit_read(int sz)
+{
+  u8 *helper = sz == 1 ? tr.c->rd8 : sz == 2 ? tr.c->rd16 : tr.c->rd32;
+  u8 *jr, *jc, *jd;
+
+  if (!tr.c->ram) {
+    emith_call(helper);
+    return;
+  }
+  emit_ram_check(sz, &jr, &jc);
+  if (sz == 1)
+    emit_op_ram(0, 0x0fb6, xAX);
+  else if (sz == 2)
+    emit_op_ram(0, 0x0fb7, xAX);
+  else {
+    emit_op_ram(0, 0x8b, xAX);
+    emith_rol(xAX, xAX, 16);
+  }
+  JMP8_POS(jd);
+  JMP8_EMIT(ICOND_JNE, jr);
+  if (jc != NULL) {
+    JMP8_EMIT(ICOND_JAE, jc);
+  }
+  emith_call(helper);
+  JMP8_EMIT_NC(jd);
+}
+
+// write esi to edi, ram pages without code inline
+static void emit_write(int sz)
+{
+  u8 *helper = sz == 1 ? tr.c->wr8 : sz == 2 ? tr.c->wr16 : tr.c->wr32;
+  u8 *jr, *jc, *jp, *jd;
+
+  if (!tr.c->ram) {
+    emith_call(helper);
+    return;
+  }
+  emit_ram_check(sz, &jr, &jc);
+  jp = emit_ram_code_check(sz);
+  if (sz == 1)
+    emit_op_ram(2, 0x88, xSI);                  // mov [..], sil
+  else if (sz == 2) {
+    emit_osize(2);
+    emit_op_ram(0, 0x89, xSI);
+  }
+  else {
+    emith_rol(xSI, xSI, 16);
+    emit_op_ram(0, 0x89, xSI);
+  }
+  JMP8_POS(jd);
+  JMP8_EMIT(ICOND_JNE, jr);
+  if (jc != NULL) {
+    JMP8_EMIT(ICOND_JAE, jc);
+  }
+  JMP8_EMIT(ICOND_JNE, jp);
+  emith_call(helper);
+  JMP8_EMIT_NC(jd);
+}
+
+// eax = operand, zero or sign extended
+static void emit_ea_read(const struct ea *ea, int sz, int sx)
+{
+  u32 v;
+
+  switch (ea->mode) {
+  case EA_DN:
+  case EA_AN:
+    reg_load(sz, sx, xAX, (ea->mode == EA_AN) * 8 + ea->reg);
+    break;
+  case EA_IMM:
+    v = ea->val;
+    if (sx)
+      emit_sext_imm(sz, &v);
+    emith_move_r_imm(xAX, v);
+    break;
+  default:
+    emit_ea_addr(ea, sz);
+    emit_read(sz);
+    if (sx && sz < 4)
+      emit_ext_r(sz, 1, xAX, xAX);
+    break;
+  }
+}
+
+// [rsp] is free in translated code, keeps values across helper calls
+static void emit_tmp_write(int r)
+{
+  emith_write_r_r_offs(r, xSP, 0);
+}
+
+static void emit_tmp_read(int r)
+{
+  emith_read_r_r_offs(r, xSP, 0);
+}
+
+// edx = memory operand for read-modify-write, its address goes to [rsp]
+static void emit_rmw_read(const struct ea *ea, int sz)
+{
+  emit_ea_addr(ea, sz);
+  emit_tmp_write(xDI);
+  emit_read(sz);
+  emith_move_r_r(xDX, xAX);
+}
+
+static void emit_rmw_write(int sz)
+{
+  emit_tmp_read(xDI);
+  emith_move_r_r(xSI, xDX);
+  emit_write(sz);
+}
+
+// push a long to the stack, value in esi
+static void emit_push32(void)
+{
+  reg_load(4, 0, xDI, 15);
+  emith_sub_r_imm(xDI, 4);
+  reg_store(4, xDI, 15);
+  emit_write(4);
+}
+
+// --------------------------------------------------------------------
+// instructions
+
+static const u8 move_sz[4] = { 0, 1, 4, 2 };
+static const u8 op_sz[4] = { 1, 2, 4, 0 };
+
+static int tr_move(u32 op)
+{
+  int sz = move_sz[(op >> 12) & 3];
+  int dmode = (op >> 6) & 7, dreg = (op >> 9) & 7;
+  int cyc;
+  struct ea s, d;
+
+  if (!ea_decode(&s, (op >> 3) & 7, op & 7, sz))
+    return TR_NO;
+  if (!ea_decode(&d, dmode, dreg, sz) || d.mode > EA_AL)
+    return TR_NO;
+
+  cyc = 4 + ea_cyc(&s, sz);
+  if (d.mode == EA_AN) {
+    emit_ea_read(&s, sz, 1);
+    reg_store(4, xAX, 8 + dreg);
+  }
+  else {
+    if (s.mode == EA_IMM) {
+      emith_move_r_imm(xDX, s.val);
+      emit_flags_const(s.val, sz);
+    }
+    else {
+      emit_ea_read(&s, sz, 0);
+      emith_move_r_r(xDX, xAX);
+      emit_op_r_r(sz, 0x84, xDX, xDX);
+      emit_flags(0);
+    }
+    if (d.mode == EA_DN)
+      reg_store(sz, xDX, dreg);
+    else {
+      emit_ea_addr(&d, sz);
+      emith_move_r_r(xSI, xDX);
+      if (d.mode == EA_PD && sz == 4)
+        emith_call(tr.c->wr32dec);
+      else
+        emit_write(sz);
+      // -(An) costs the same as (An) here
+      if (d.mode == EA_PD)
+        d.mode = EA_AI;
+      cyc += ea_cyc(&d, sz);
+    }
+  }
+  emit_cycles(cyc, NEXT_PC);
+  return TR_OK;
+}
+
+static int tr_moveq(u32 op)
+{
+  u32 v = (s8)op;
+  if (op & 0x100)
+    return TR_NO; // idle loop ops live here
+  reg_store_imm(4, (op >> 9) & 7, v);
+  emit_flags_const(v, 4);
+  emit_cycles(4, NEXT_PC);
+  return TR_OK;
+}
+
+// ADDX SUBX, Dy,Dx and -(Ay),-(Ax)
+static int tr_addx(u32 op, int sub, int sz)
+{
+  int rx = (op >> 9) & 7, ry = op & 7;
+  struct ea ea;
+
+  if (op & 8) {
+    ea.mode = EA_PD;
+    ea.reg = ry;
+    emit_ea_addr(&ea, sz);
+    emit_read(sz);
+    emith_write_r_r_offs(xAX, xSP, 4);
+    ea.reg = rx;
+    emit_rmw_read(&ea, sz);
+    emith_read_r_r_offs(xCX, xSP, 4);
+  }
+  else {
+    reg_load(sz, 0, xDX, rx);
+    reg_load(sz, 0, xCX, ry);
+  }
+  if (sz == 4 && !sub)
+    emith_move_r_r(xSI, xDX);
+  emit_x_to_cf();
+  emit_op_r_r(sz, sub ? 0x18 : 0x10, xDX, xCX); // sbb, adc
+  emit_flags_addx(sz < 4 ? XC_X86 : sub ? XC_SUB : XC_ADD);
+  if (op & 8) {
+    emit_rmw_write(sz);
+    emit_cycles(sz == 4 ? 30 : 18, NEXT_PC);
+  }
+  else {
+    reg_store(sz, xDX, rx);
+    emit_cycles(sz == 4 ? 8 : 4, NEXT_PC);
+  }
+  return TR_OK;
+}
+
+// ADD SUB AND OR EOR CMP (x86 op byte form) <ea>,Dn and Dn,<ea>
+static int tr_alu(u32 op)
+{
+  int line = op >> 12, opmode = (op >> 6) & 7;
+  int reg = (op >> 9) & 7, sz = op_sz[opmode & 3];
+  int x86op, x = 0, cyc;
+  struct ea ea;
+
+  switch (line) {
+  case 0x8: x86op = 0x08; break;
+  case 0x9: x86op = 0x28; x = 1; break;
+  case 0xb: x86op = (opmode <= 3 || opmode == 7) ? 0x38 : 0x30; break;
+  case 0xc: x86op = 0x20; break;
+  case 0xd: x86op = 0x00; x = 1; break;
+  default:  return TR_NO;
+  }
+  if (opmode == 3 || opmode == 7) {
+    // ADDA SUBA CMPA, MULU MULS, DIVU DIVS
+    sz = opmode == 3 ? 2 : 4;
+    if (line == 0x8)
+      return TR_NO;
+    if (!ea_decode(&ea, (op >> 3) & 7, op & 7, line == 0xc ? 2 : sz))
+      return TR_NO;
+    if (line == 0xc) {
+      emit_ea_read(&ea, 2, opmode == 7);
+      reg_load(2, opmode == 7, xDX, reg);
+      EMIT(0x0f, u8); EMIT_OP(0xaf); EMIT_MODRM(3, xDX, xAX); // imul edx, eax
+      reg_store(4, xDX, reg);
+      emith_tst_r_r(xDX, xDX);
+      emit_flags(0);
+      emit_cycles(54 + ea_cyc(&ea, 2), NEXT_PC);
+      return TR_OK;
+    }
+    emit_ea_read(&ea, sz, 1);
+    reg_op(4, x86op, xAX, 8 + reg);
+    if (line == 0xb) {
+      emit_flags(0);
+      cyc = 6;
+    }
+    else if (sz == 2)
+      cyc = 8;
+    else
+      cyc = (ea.mode <= EA_AN || ea.mode == EA_IMM) ? 8 : 6;
+    emit_cycles(cyc + ea_cyc(&ea, sz), NEXT_PC);
+    return TR_OK;
+  }
+
+  if (!ea_decode(&ea, (op >> 3) & 7, op & 7, sz))
+    return TR_NO;
+
+  if (opmode < 3) {
+    // <ea>,Dn
+    if (line == 0xb && x86op == 0x30)
+      return TR_NO;
+    emit_ea_read(&ea, sz, 0);
+    reg_op(sz, x86op, xAX, reg);
+    emit_flags(x);
+    if (line == 0xb)
+      cyc = sz == 4 ? 6 : 4;
+    else if (sz == 4)
+      cyc = (ea.mode <= EA_AN || ea.mode == EA_IMM) ? 8 : 6;
+    else
+      cyc = 4;
+    emit_cycles(cyc + ea_cyc(&ea, sz), NEXT_PC);
+    return TR_OK;
+  }
+
+  // Dn,<ea>; ADDX SUBX ABCD SBCD EXG CMPM share the encoding
+  if (ea.mode == EA_DN || ea.mode == EA_AN) {
+    if (line == 0x9 || line == 0xd)
+      return tr_addx(op, line == 0x9, sz);
+  }
+  if (ea.mode == EA_DN) {
+    if (line == 0xc && (op & 0x1f8) == 0x140)
+      goto exg;
+    if (line != 0xb)
+      return TR_NO;
+    // EOR Dn,Dn
+    reg_load(sz, 0, xCX, reg);
+    reg_op(sz, 0x30, xCX, ea.reg);
+    emit_flags(0);
+    emit_cycles(sz == 4 ? 8 : 4, NEXT_PC);
+    return TR_OK;
+  }
+  if (ea.mode == EA_AN) {
+    if (line == 0xc && (op & 0x1f8) == 0x148)
+      goto exg;
+    if (line == 0xc && (op & 0x1f8) == 0x188)
+      goto exg;
+    return TR_NO;
+  }
+  if (!ea_is_mem(&ea) || ea.mode >= EA_PCDI)
+    return TR_NO;
+  emit_rmw_read(&ea, sz);
+  reg_op_to(sz, x86op, xDX, reg); // op dl, Dn
+  emit_flags(x);
+  emit_rmw_write(sz);
+  emit_cycles((sz == 4 ? 12 : 8) + ea_cyc(&ea, sz), NEXT_PC);
+  return TR_OK;
+
+exg:
+  {
+    int rx = (op >> 9) & 7, ry = op & 7;
+    if ((op & 0x1f8) == 0x148)
+      rx += 8;
+    if ((op & 0x1f8) != 0x140)
+      ry += 8;
+    reg_load(4, 0, xAX, rx);
+    reg_load(4, 0, xCX, ry);
+    reg_store(4, xCX, rx);
+    reg_store(4, xAX, ry);
+    emit_cycles(6, NEXT_PC);
+    return TR_OK;
+  }
+}
+
+// sub cnt, reg (cycles known at runtime)
+static void emit_cycles_r(int r, u32 pc)
+{
+  emit_op_r_r(4, 0x28, RCNT, r);
+  tr.stubs[tr.nstubs].jmp = tcache_ptr;
+  tr.stubs[tr.nstubs].pc = pc;
+  tr.nstubs++;
+  emith_jump_cond(ICOND_JLE, tcache_ptr);
+}
+
+static int tr_bitop(u32 op)
+{
+  static const u8 bt_reg[4] = { 0xa3, 0xbb, 0xb3, 0xab }; // bt btc btr bts
+  static const u8 bt_imm[4] = { 4, 7, 6, 5 };
+  static const u8 cyc_dn[2][4] = { { 10, 12, 14, 12 }, { 6, 8, 10, 8 } };
+  int type = (op >> 6) & 3, dyn = (op >> 8) & 1;
+  u32 bit = 0;
+  struct ea ea;
+
+  if (dyn && ((op >> 3) & 7) == 1)
+    return TR_NO; // MOVEP
+  if (!dyn)
+    bit = fetch16() & 0xff;
+  if (!ea_decode(&ea, (op >> 3) & 7, op & 7, 1))
+    return TR_NO;
+  if (ea.mode == EA_AN || ea.mode == EA_IMM)
+    return TR_NO;
+  if (type != 0 && ea.mode >= EA_PCDI)
+    return TR_NO;
+
+  if (ea.mode == EA_DN)
+    reg_load(4, 0, xDX, ea.reg);
+  else if (type != 0)
+    emit_rmw_read(&ea, 1);
+  else {
+    emit_ea_addr(&ea, 1);
+    emit_read(1);
+    emith_move_r_r(xDX, xAX);
+  }
+  if (dyn) {
+    reg_load(4, 0, xCX, (op >> 9) & 7);
+    if (ea.mode != EA_DN)
+      emith_and_r_imm(xCX, 7);
+    EMIT(0x0f, u8);
+    EMIT_OP(bt_reg[type]);
+    EMIT_MODRM(3, xCX, xDX);
+  }
+  else {
+    EMIT(0x0f, u8);
+    EMIT_OP(0xba);
+    EMIT_MODRM(3, bt_imm[type], xDX);
+    EMIT(bit & (ea.mode == EA_DN ? 31 : 7), u8);
+  }
+  emit_flags_z_nc();
+
+  if (ea.mode == EA_DN) {
+    if (type != 0)
+      reg_store(4, xDX, ea.reg);
+    emit_cycles(cyc_dn[dyn][type], NEXT_PC);
+  }
+  else {
+    if (type != 0)
+      emit_rmw_write(1);
+    emit_cycles((dyn ? 4 : 8) + (type ? 4 : 0) + ea_cyc(&ea, 1), NEXT_PC);
+  }
+  return TR_OK;
+}
+
+// --------------------------------------------------------------------
+// ccr and sr
+
+#define SR_S 0x2000
+#define SR_MASK 0xa71f // T S I2-0 XNZVC
+
+static u16 ccr_drc[32]; // 68k ccr -> RCCR
+
+static int drc_set_sr(u32 sr);
+
+// eax = 68k ccr, uses ecx
+static void emit_ccr_get(void)
+{
+  emith_move_r_r(xAX, RCCR);
+  emith_lsr(xAX, xAX, 12);
+  emith_and_r_imm(xAX, 0x0c);          // N Z
+  emith_move_r_r(xCX, RCCR);
+  emith_lsr(xCX, xCX, 8);
+  emith_and_r_imm(xCX, 1);             // C
+  emith_or_r_r(xAX, xCX);
+  emith_move_r_r(xCX, RCCR);
+  emith_and_r_imm(xCX, 1);
+  emith_add_r_r(xCX, xCX);             // V
+  emith_or_r_r(xAX, xCX);
+  emit_load(1, 0, xCX, CCR + 2);
+  emith_lsl(xCX, xCX, 4);              // X
+  emith_or_r_r(xAX, xCX);
+}
+
+// ccr from eax, uses ecx
+static void emit_ccr_set(void)
+{
+  emith_and_r_imm(xAX, 0x1f);
+  emith_move_r_ptr_imm(xCX, ccr_drc);
+  emit_op_sib(0, 0x0fb7, RCCR, xCX, xAX, 1); // movzx r14d, [rcx + rax*2]
+  emith_lsr(xAX, xAX, 4);
+  emit_store(1, xAX, CCR + 2);
+}
+
+// eax = sr
+static void emit_sr_get(void)
+{
+  emit_ccr_get();
+  emit_op_m_r(4, 0x0a, xAX, CTX(flag_S));       // or eax, [flag_S]
+  emit_op_m_r(4, 0x0a, xAX, CTX(flag_T));
+  emith_ctx_read(xCX, CTX(flag_I));
+  emith_lsl(xCX, xCX, 8);
+  emith_or_r_r(xAX, xCX);
+}
+
+// sr = eax, leaves the block after the instruction if an irq is due
+static void emit_sr_set(int cyc)
+{
+  u8 *jnoirq;
+
+  emith_move_r_r(xDI, xAX);
+  emit_reg_writeback();
+  emit_sync_out();
+  emith_call(drc_set_sr);
+  emit_sync_in();
+  emit_reg_reload();
+  emit_cycles(cyc, NEXT_PC);
+  emith_tst_r_r(xAX, xAX);
+  JMP8_POS(jnoirq);
+  emith_move_r_imm(xAX, NEXT_PC);
+  emith_jump(tr.exit);
+  JMP8_EMIT(ICOND_JE, jnoirq);
+}
+
+// the sr ops are privileged, FAME takes the exception in user mode
+static void emit_check_super(void)
+{
+  u8 *jsuper;
+
+  emit_op_m_imm(4, 7, CTX(flag_S), 0);
+  jsuper = tcache_ptr;
+  emith_jump_cond(ICOND_JNE, tcache_ptr);
+  emit_interp();
+  emith_jump_patch(jsuper, tcache_ptr);
+}
+
+// ORI ANDI EORI to CCR and SR
+static int tr_ccr_imm(u32 op)
+{
+  static const s8 x86_ext[8] = { 1, 4, -1, -1, -1, 6, -1, -1 };
+  int ext = x86_ext[(op >> 9) & 7];
+  u32 imm = fetch16();
+
+  if (ext < 0)
+    return TR_NO;
+  if (op & 0x40) {
+    emit_check_super();
+    emit_sr_get();
+    emit_op_r_imm(4, ext, xAX, imm & SR_MASK);
+    emit_sr_set(20);
+  }
+  else {
+    emit_ccr_get();
+    emit_op_r_imm(4, ext, xAX, imm & 0x1f);
+    emit_ccr_set();
+    emit_cycles(20, NEXT_PC);
+  }
+  return TR_OK;
+}
+
+// MOVE from SR, MOVE to CCR, MOVE to SR
+static int tr_move_sr(u32 op)
+{
+  struct ea ea;
+
+  if (!ea_decode(&ea, (op >> 3) & 7, op & 7, 2) || ea.mode == EA_AN)
+    return TR_NO;
+
+  if ((op & 0xffc0) == 0x40c0) {
+    if (ea.mode >= EA_PCDI)
+      return TR_NO;
+    emit_sr_get();
+    if (ea.mode == EA_DN) {
+      reg_store(2, xAX, ea.reg);
+      emit_cycles(6, NEXT_PC);
+      return TR_OK;
+    }
+    emith_move_r_r(xSI, xAX);
+    emit_ea_addr(&ea, 2);
+    emit_write(2);
+    emit_cycles(8 + ea_cyc(&ea, 2), NEXT_PC);
+    return TR_OK;
+  }
+
+  if (op & 0x200)
+    emit_check_super();
+  emit_ea_read(&ea, 2, 0);
+  if (op & 0x200)
+    emit_sr_set(12 + ea_cyc(&ea, 2));
+  else {
+    emit_ccr_set();
+    emit_cycles(12 + ea_cyc(&ea, 2), NEXT_PC);
+  }
+  return TR_OK;
+}
+
+// ORI ANDI SUBI ADDI EORI CMPI, static bit ops
+static int tr_imm(u32 op)
+{
+  static const s8 x86_ext[8] = { 1, 4, 5, 0, -1, 6, 7, -1 };
+  int type = (op >> 9) & 7, sz = op_sz[(op >> 6) & 3];
+  int ext = x86_ext[type], x = type == 2 || type == 3;
+  int cyc;
+  struct ea ea;
+  u32 imm;
+
+  if ((op & 0x100) || type == 4)
+    return tr_bitop(op);
+  if ((op & 0xbf) == 0x3c)
+    return tr_ccr_imm(op);
+  if (ext < 0 || sz == 0)
+    return TR_NO;
+  imm = sz == 4 ? fetch32() : fetch16();
+  if (sz == 1)
+    imm &= 0xff;
+  if (!ea_decode(&ea, (op >> 3) & 7, op & 7, sz))
+    return TR_NO;
+  if (ea.mode == EA_AN || ea.mode >= EA_PCDI)
+    return TR_NO; // also to CCR/SR
+
+  if (ea.mode == EA_DN) {
+    reg_op_imm(sz, ext, ea.reg, imm);
+    emit_flags(x);
+    if (type == 6 || type == 1)
+      cyc = sz == 4 ? 14 : 8; // ANDI.L as Cyclone times it
+    else
+      cyc = sz == 4 ? 16 : 8;
+  }
+  else {
+    emit_rmw_read(&ea, sz);
+    emit_op_r_imm(sz, ext, xDX, imm);
+    emit_flags(x);
+    if (type == 6)
+      cyc = sz == 4 ? 12 : 8;
+    else {
+      emit_rmw_write(sz);
+      cyc = sz == 4 ? 20 : 12;
+    }
+    cyc += ea_cyc(&ea, sz);
+  }
+  emit_cycles(cyc, NEXT_PC);
+  return TR_OK;
+}
+
+// NEGX CLR NEG NOT TST
+static int tr_unary(u32 op)
+{
+  int sz = op_sz[(op >> 6) & 3], type = (op >> 9) & 7;
+  int cyc;
+  struct ea ea;
+
+  if (sz == 0 || !ea_decode(&ea, (op >> 3) & 7, op & 7, sz))
+    return TR_NO;
+  if (ea.mode == EA_AN || ea.mode >= EA_PCDI)
+    return TR_NO;
+
+  if (type == 5) {
+    emit_ea_read(&ea, sz, 0);
+    emit_op_r_r(sz, 0x84, xAX, xAX);
+    emit_flags(0);
+    emit_cycles(4 + ea_cyc(&ea, sz), NEXT_PC);
+    return TR_OK;
+  }
+
+  if (type == 1) {
+    // no read cycle here
+    if (ea.mode == EA_DN)
+      reg_store_imm(sz, ea.reg, 0);
+    else {
+      emit_ea_addr(&ea, sz);
+      emith_move_r_imm(xSI, 0);
+      emit_write(sz);
+    }
+    emit_flags_const(0, sz);
+  }
+  else {
+    if (ea.mode == EA_DN)
+      reg_load(sz, 0, xDX, ea.reg);
+    else
+      emit_rmw_read(&ea, sz);
+    if (type == 0) {
+      // NEGX: 0 - Rn - X
+      emith_move_r_r(xCX, xDX);
+      emith_move_r_imm(xDX, 0);
+      emit_x_to_cf();
+      emit_op_r_r(sz, 0x18, xDX, xCX);
+      emit_flags_addx(sz == 4 ? XC_NZ : XC_X86);
+    }
+    else {
+      emit_unary_r(sz, type == 2 ? 3 : 2, xDX);
+      if (type == 3)
+        emit_op_r_r(sz, 0x84, xDX, xDX); // x86 not doesn't set flags
+      emit_flags(type == 2);
+    }
+    if (ea.mode == EA_DN)
+      reg_store(sz, xDX, ea.reg);
+    else
+      emit_rmw_write(sz);
+  }
+  if (ea.mode == EA_DN)
+    cyc = sz == 4 ? 6 : 4;
+  else
+    cyc = (sz == 4 ? 12 : 8) + ea_cyc(&ea, sz);
+  emit_cycles(cyc, NEXT_PC);
+  return TR_OK;
+}
+
+// LEA, PEA, JMP, JSR; indexed by ea mode
+static const u8 lea_cyc[EA_IMM] =
+  { 0, 0, 4, 0, 0, 8, 12, 8, 12, 8, 12 };
+static const u8 jmp_cyc[EA_IMM] =
+  { 0, 0, 8, 0, 0, 10, 14, 10, 12, 10, 14 };
+
+static int tr_lea(u32 op, int pea)
+{
+  struct ea ea;
+
+  if (!ea_decode(&ea, (op >> 3) & 7, op & 7, 4))
+    return TR_NO;
+  if (ea.mode >= EA_IMM || lea_cyc[ea.mode] == 0)
+    return TR_NO;
+  emit_ea_addr(&ea, 4);
+  if (pea) {
+    emith_move_r_r(xSI, xDI);
+    emit_push32();
+  }
+  else
+    reg_store(4, xDI, 8 + ((op >> 9) & 7));
+  emit_cycles(lea_cyc[ea.mode] + (pea ? 8 : 0), NEXT_PC);
+  return TR_OK;
+}
+
+static int tr_jmp(u32 op)
+{
+  int jsr = !(op & 0x40);
+  int cyc;
+  u8 *jodd;
+  struct ea ea;
+
+  if (!ea_decode(&ea, (op >> 3) & 7, op & 7, 4))
+    return TR_NO;
+  if (ea.mode >= EA_IMM || jmp_cyc[ea.mode] == 0)
+    return TR_NO;
+  cyc = jmp_cyc[ea.mode] + (jsr ? 8 : 0);
+
+  if (ea.mode == EA_AW || ea.mode == EA_AL || ea.mode == EA_PCDI) {
+    if (ea.val & 1)
+      return TR_NO;
+    if (jsr) {
+      emith_move_r_imm(xSI, NEXT_PC);
+      emit_push32();
+    }
+    emit_cycles(cyc, ea.val);
+    emit_goto(ea.val);
+    return TR_END;
+  }
+
+  // odd targets raise an address error after the push, let FAME do it
+  emit_ea_addr(&ea, 4);
+  emith_tst_r_imm(xDI, 1);
+  jodd = tcache_ptr;
+  emith_jump_cond(ICOND_JNE, tcache_ptr); // too far for a jmp8 with the push
+  if (jsr) {
+    emit_tmp_write(xDI);
+    emith_move_r_imm(xSI, NEXT_PC);
+    emit_push32();
+    emit_tmp_read(xAX);
+  }
+  else
+    emith_move_r_r(xAX, xDI);
+  emit_cycles_eax(cyc);
+  emith_jump(tr.disp);
+  emith_jump_patch(jodd, tcache_ptr);
+  emit_interp();
+  return TR_END;
+}
+
+static int tr_movem(u32 op)
+{
+  static const u8 cyc_to_reg[EA_IMM] =
+    { 0, 0, 12, 12, 0, 16, 18, 16, 20, 16, 18 };
+  static const u8 cyc_to_mem[EA_IMM] =
+    { 0, 0, 8, 0, 8, 12, 14, 12, 16, 0, 0 };
+  int to_mem = !(op & 0x400), sz = (op & 0x40) ? 4 : 2;
+  u32 mask = fetch16();
+  int i, k = 0, cyc;
+  struct ea ea;
+
+  if (!ea_decode(&ea, (op >> 3) & 7, op & 7, sz) || ea.mode >= EA_IMM)
+    return TR_NO;
+  cyc = to_mem ? cyc_to_mem[ea.mode] : cyc_to_reg[ea.mode];
+  if (cyc == 0)
+    return TR_NO;
+
+  // the base address is kept in [rsp]
+  if (ea.mode == EA_PD) {
+    // mask is reversed, A7 first
+    reg_load(4, 0, xDI, 8 + ea.reg);
+    emit_tmp_write(xDI);
+    for (i = 0; i < 16; i++) {
+      if (!(mask & (1 << i)))
+        continue;
+      k += sz;
+      if (k > sz)
+        emit_tmp_read(xDI);
+      emith_lea_r_r_offs(xDI, xDI, -k);
+      reg_load(4, 0, xSI, 15 - i);
+      emith_call(sz == 4 ? tr.c->wr32dec : tr.c->wr16);
+    }
+    emit_tmp_read(xAX);
+    emith_lea_r_r_offs(xAX, xAX, -k);
+    reg_store(4, xAX, 8 + ea.reg);
+  }
+  else {
+    if (ea.mode == EA_PI)
+      reg_load(4, 0, xDI, 8 + ea.reg);
+    else
+      emit_ea_addr(&ea, sz);
+    emit_tmp_write(xDI);
+    for (i = 0; i < 16; i++) {
+      if (!(mask & (1 << i)))
+        continue;
+      if (k > 0) {
+        emit_tmp_read(xDI);
+        emith_lea_r_r_offs(xDI, xDI, k);
+      }
+      if (to_mem) {
+        reg_load(4, 0, xSI, i);
+        emit_write(sz);
+      }
+      else {
+        emit_read(sz);
+        if (sz == 2)
+          emit_ext_r(2, 1, xAX, xAX);
+        reg_store(4, xAX, i);
+      }
+      k += sz;
+    }
+    if (ea.mode == EA_PI) {
+      emit_tmp_read(xAX);
+      emith_lea_r_r_offs(xAX, xAX, k);
+      reg_store(4, xAX, 8 + ea.reg);
+    }
+  }
+  emit_cycles(cyc + k * 2, NEXT_PC);
+  return TR_OK;
+}
+
+static int tr_group4(u32 op)
+{
+  int reg = op & 7;
+  u8 *jodd;
+
+  if ((op & 0xf1c0) == 0x41c0)
+    return tr_lea(op, 0);
+
+  switch (op & 0xffc0) {
+  case 0x40c0:
+  case 0x44c0:
+  case 0x46c0:
+    return tr_move_sr(op);
+  case 0x4000: case 0x4040: case 0x4080:
+  case 0x4200: case 0x4240: case 0x4280:
+  case 0x4400: case 0x4440: case 0x4480:
+  case 0x4600: case 0x4640: case 0x4680:
+  case 0x4a00: case 0x4a40: case 0x4a80:
+    return tr_unary(op);
+  case 0x4840:
+    if (op & 0x38)
+      return tr_lea(op, 1);
+    // SWAP
+    reg_load(4, 0, xDX, reg);
+    emith_rol(xDX, xDX, 16);
+    reg_store(4, xDX, reg);
+    emith_tst_r_r(xDX, xDX);
+    emit_flags(0);
+    emit_cycles(4, NEXT_PC);
+    return TR_OK;
+  case 0x4880:
+  case 0x48c0:
+    if (op & 0x38)
+      return tr_movem(op);
+    // EXT
+    if (op & 0x40) {
+      reg_load(2, 1, xDX, reg);
+      reg_store(4, xDX, reg);
+    }
+    else {
+      reg_load(1, 1, xDX, reg);
+      reg_store(2, xDX, reg);
+    }
+    emith_tst_r_r(xDX, xDX);
+    emit_flags(0);
+    emit_cycles(4, NEXT_PC);
+    return TR_OK;
+  case 0x4c80:
+  case 0x4cc0:
+    return tr_movem(op);
+  case 0x4e80:
+  case 0x4ec0:
+    return tr_jmp(op);
+  }
+
+  switch (op) {
+  case 0x4e71: // NOP
+    emit_cycles(4, NEXT_PC);
+    return TR_OK;
+  case 0x4e75: // RTS
+    reg_load(4, 0, xDI, 15);
+    emit_read(4);
+    emith_tst_r_imm(xAX, 1);
+    JMP8_POS(jodd);
+    reg_op_imm(4, 0, 15, 4);
+    emit_cycles_eax(16);
+    emith_jump(tr.disp);
+    JMP8_EMIT(ICOND_JNE, jodd);
+    emit_interp();
+    return TR_END;
+  }
+
+  if ((op & 0xfff8) == 0x4e50 && reg != 7) {
+    // LINK
+    u32 disp = (s16)fetch16();
+    reg_load(4, 0, xSI, 8 + reg);
+    emit_push32();
+    reg_load(4, 0, xAX, 15);
+    reg_store(4, xAX, 8 + reg);
+    reg_op_imm(4, 0, 15, disp);
+    emit_cycles(16, NEXT_PC);
+    return TR_OK;
+  }
+  if ((op & 0xfff8) == 0x4e58 && reg != 7) {
+    // UNLK
+    reg_load(4, 0, xDI, 8 + reg);
+    emith_lea_r_r_offs(xAX, xDI, 4);
+    reg_store(4, xAX, 15);
+    emit_read(4);
+    reg_store(4, xAX, 8 + reg);
+    emit_cycles(12, NEXT_PC);
+    return TR_OK;
+  }
+  return TR_NO;
+}
+
+// ADDQ SUBQ Scc DBcc
+static int tr_group5(u32 op)
+{
+  int cc = (op >> 8) & 15, reg = op & 7;
+  int sz, sub, cyc;
+  u32 data;
+  struct ea ea;
+
+  if ((op & 0xc0) == 0xc0) {
+    if ((op & 0x38) == 0x08) {
+      // DBcc
+      u32 target = NEXT_PC;
+      u8 *jtrue = NULL, *jexp, *jend = NULL;
+      target += (s16)fetch16();
+      if (cc == 0) {
+        emit_cycles(12, NEXT_PC);
+        return TR_OK;
+      }
+      if (target & 1)
+        return TR_NO;
+      emit_store_imm(1, CTX(not_polling), 1);
+      if (cc != 1) {
+        emit_flags_load();
+        JMP8_POS(jtrue);
+      }
+      reg_op_imm(2, 5, reg, 1);
+      JMP8_POS(jexp);
+      emit_cycles(10, target);
+      emit_goto(target);
+      if (jtrue != NULL) {
+        JMP8_EMIT(cond_x86[cc], jtrue);
+        emit_cycles(12, NEXT_PC);
+        JMP8_POS(jend);
+      }
+      JMP8_EMIT(ICOND_JB, jexp);
+      emit_cycles(14, NEXT_PC);
+      if (jtrue != NULL) {
+        JMP8_EMIT_NC(jend);
+      }
+      return TR_OK;
+    }
+
+    // Scc
+    if (!ea_decode(&ea, (op >> 3) & 7, reg, 1))
+      return TR_NO;
+    if (ea.mode == EA_AN || ea.mode >= EA_PCDI)
+      return TR_NO;
+    if (cc < 2)
+      emith_move_r_imm(xDX, cc == 0 ? 0xff : 0);
+    else {
+      emit_flags_load();
+      EMIT(0x0f, u8);
+      EMIT_OP(0x90 | cond_x86[cc]);
+      EMIT_MODRM(3, 0, xDX);       // setcc dl
+      emit_unary_r(1, 3, xDX);     // neg dl
+    }
+    if (ea.mode != EA_DN) {
+      emit_ea_addr(&ea, 1);
+      emit_ext_r(1, 0, xSI, xDX);
+      emit_write(1);
+      emit_cycles(8 + ea_cyc(&ea, 1), NEXT_PC);
+      return TR_OK;
+    }
+    reg_store(1, xDX, reg);
+    if (cc < 2)
+      emit_cycles(cc == 0 ? 6 : 4, NEXT_PC);
+    else {
+      // 6 if set, 4 if not
+      emit_ext_r(1, 0, xCX, xDX);
+      emith_and_r_imm(xCX, 2);
+      emith_add_r_imm(xCX, 4);
+      emit_cycles_r(xCX, NEXT_PC);
+    }
+    return TR_OK;
+  }
+
+  sz = op_sz[(op >> 6) & 3];
+  sub = op & 0x100;
+  data = ((op >> 9) - 1) & 7;
+  data++;
+  if (!ea_decode(&ea, (op >> 3) & 7, reg, sz))
+    return TR_NO;
+  if (ea.mode >= EA_PCDI)
+    return TR_NO;
+  switch (ea.mode) {
+  case EA_DN:
+    reg_op_imm(sz, sub ? 5 : 0, reg, data);
+    emit_flags(1);
+    cyc = sz == 4 ? 8 : 4;
+    break;
+  case EA_AN:
+    // whole register, no flags
+    if (sz == 1)
+      return TR_NO;
+    reg_op_imm(4, sub ? 5 : 0, 8 + reg, data);
+    cyc = (sz == 2 && !sub) ? 4 : 8; // FAME's Cyclone timing
+    break;
+  default:
+    emit_rmw_read(&ea, sz);
+    emit_op_r_imm(sz, sub ? 5 : 0, xDX, data);
+    emit_flags(1);
+    emit_rmw_write(sz);
+    cyc = (sz == 4 ? 12 : 8) + ea_cyc(&ea, sz);
+    break;
+  }
+  emit_cycles(cyc, NEXT_PC);
+  return TR_OK;
+}
+
+// BRA BSR Bcc
+static int tr_branch(u32 op)
+{
+  int cc = (op >> 8) & 15;
+  u32 target = NEXT_PC;
+  int word = (op & 0xff) == 0;
+  u8 *jnot;
+
+  if (word)
+    target += (s16)fetch16();
+  else if (cc < 2) {
+    target += (s8)op;
+    // idle loop detection may have taken over this one
+    if (ops_jt[op] != ops_jt[(op & 0xff00) | 1])
+      return TR_NO;
+  }
+  else {
+    // FAME doesn't check these for odd offsets
+    target += (s8)(op & 0xfe);
+    if (ops_jt[op] != ops_jt[(op & 0xff00) | 1])
+      return TR_NO;
+  }
+  if ((word || cc < 2) && (target & 1))
+    return TR_NO;
+
+  if (cc == 0 || cc == 1) {
+    if (cc == 1) {
+      emith_move_r_imm(xSI, NEXT_PC);
+      emit_push32();
+    }
+    emit_cycles(cc == 1 ? 18 : 10, target);
+    emit_goto(target);
+    return TR_END;
+  }
+
+  emit_flags_load();
+  JMP8_POS(jnot);
+  emit_cycles(10, target);
+  emit_goto(target);
+  JMP8_EMIT(cond_x86[cc] ^ 1, jnot);
+  emit_cycles(word ? 12 : 8, NEXT_PC);
+  return TR_OK;
+}
+
+// immediate count register shifts
+static int tr_shift(u32 op)
+{
+  int sz = op_sz[(op >> 6) & 3], type = (op >> 3) & 3;
+  int left = op & 0x100, r = op & 7;
+  int n = ((op >> 9) - 1) & 7;
+  int bits = sz * 8;
+
+  n++;
+  if (sz == 0 || (op & 0x20))
+    return TR_NO;
+
+  switch (type) {
+  case 0:
+    if (left)
+      goto lsl;
+    // ASR
+    reg_load(sz, 1, xDX, r);
+    emith_asr(xDX, xDX, n);
+    emit_flags_v0(1);
+    break;
+  case 1:
+  lsl:
+    reg_load(sz, 0, xDX, r);
+    if (left) {
+      // at the top, so that x86 gets the flags right
+      if (bits < 32)
+        emith_lsl(xDX, xDX, 32 - bits);
+      if (type == 0)
+        emith_move_r_r(xCX, xDX);
+      emith_lsl(xDX, xDX, n);
+      emit_flags_v0(1);
+      if (bits < 32)
+        emith_lsr(xDX, xDX, 32 - bits);
+      if (type == 0) {
+        // ASL: V if the top n + 1 bits weren't all the same
+        emith_asr(xCX, xCX, 31 - n);
+        EMIT_OP_MODRM(0xff, 3, 0, xCX);            // inc ecx
+        emith_cmp_r_imm(xCX, 1);
+        EMIT(0x0f, u8); EMIT_OP(0x97); EMIT_MODRM(3, 0, xCX); // seta cl
+        emit_ext_r(1, 0, xCX, xCX);
+        emith_or_r_r(RCCR, xCX);
+      }
+    }
+    else {
+      emith_lsr(xDX, xDX, n);
+      emit_flags_v0(1);
+    }
+    break;
+  case 2: // ROXd
+    reg_load(4, 0, xDX, r);
+    emit_x_to_cf();
+    emit_shift_r(sz, left ? 2 : 3, xDX, n);   // rcl, rcr
+    emith_deref_op(0x0f92, 0, xBP, CCR + 2);   // setc [x]
+    EMIT(0x0f, u8); EMIT_OP(0x92); EMIT_MODRM(3, 0, xCX); // setc cl
+    emit_op_r_r(sz, 0x84, xDX, xDX);
+    EMIT_OP(0x9f);                            // lahf
+    EMIT_OP(0x08); EMIT_MODRM(3, xCX, 4);     // or ah, cl
+    EMIT_OP(0xb0); EMIT(0, u8);
+    emith_move_r_r(RCCR, xAX);
+    break;
+  case 3:
+    reg_load(4, 0, xDX, r);
+    emit_shift_r(sz, left ? 0 : 1, xDX, n);
+    emit_op_r_r(sz, 0x84, xDX, xDX);
+    EMIT_OP(0x9f);                        // lahf
+    if (left) {
+      // C is the lsb of the result
+      EMIT_OP(0x88); EMIT_MODRM(3, xDX, xAX);
+      EMIT_OP(0x24); EMIT(1, u8);
+    }
+    else {
+      // .. or the msb, which is in SF
+      EMIT_OP(0x88); EMIT_MODRM(3, 4, xAX);
+      EMIT_OP(0xc0); EMIT_MODRM(3, 5, xAX); EMIT(7, u8);
+    }
+    EMIT_OP(0x08); EMIT_MODRM(3, xAX, 4); // or ah, al
+    EMIT_OP(0xb0); EMIT(0, u8);
+    emith_move_r_r(RCCR, xAX);
+    break;
+  }
+  reg_store(sz, xDX, r);
+  emit_cycles((sz == 4 ? 8 : 6) + n * 2, NEXT_PC);
+  return TR_OK;
+}
+
+static int tr_insn(u32 op)
+{
+  // anything FAME doesn't know goes to its exception code
+  if (ops_jt[op] == ops_jt[0x4afc])
+    return TR_NO;
+
+  switch (op >> 12) {
+  case 0x0:
+    return tr_imm(op);
+  case 0x1: case 0x2: case 0x3:
+    return tr_move(op);
+  case 0x4:
+    return tr_group4(op);
+  case 0x5:
+    return tr_group5(op);
+  case 0x6:
+    return tr_branch(op);
+  case 0x7:
+    return tr_moveq(op);
+  case 0x8: case 0x9: case 0xb: case 0xc: case 0xd:
+    return tr_alu(op);
+  case 0xe:
+    return tr_shift(op);
+  }
+  return TR_NO;
+}
+
+// --------------------------------------------------------------------
+// runtime
+
+extern void fm68k_ops_init(void);
+extern int  fm68k_ops_emulate(int n, int idle_mode);
+extern void *fm68k_ops_jumptab(void);
+
+static u32 drc_ccr68k(const M68K_CONTEXT *ctx)
+{
+  u32 f = ctx->drc_ccr[1];
+  return ((f >> 4) & 0x0c) | (ctx->drc_ccr[0] << 1) | (f & 1) | (ctx->drc_ccr[2] << 4);
+}
+
+static u32 drc_sr(const M68K_CONTEXT *ctx)
+{
+  return ctx->flag_T | ctx->flag_S | (ctx->flag_I << 8) | drc_ccr68k(ctx);
+}
+
+static void ccr_to_drc(M68K_CONTEXT *ctx, u32 ccr)
+{
+  ctx->drc_ccr[0] = (ccr >> 1) & 1;
+  ctx->drc_ccr[1] = ((ccr & 0x0c) << 4) | (ccr & 1);
+  ctx->drc_ccr[2] = (ccr >> 4) & 1;
+}
+
+static void ccr_to_fame(M68K_CONTEXT *ctx)
+{
+  u32 f = ctx->drc_ccr[1];
+  ctx->flag_C = (f & 1) << 8;
+  ctx->flag_V = ctx->drc_ccr[0] << 7;
+  ctx->flag_NotZ = ~f & 0x40;
+  ctx->flag_N = f & 0x80;
+  ctx->flag_X = ctx->drc_ccr[2] << 8;
+}
+
+static void ccr_from_fame(M68K_CONTEXT *ctx)
+{
+  ctx->drc_ccr[0] = (ctx->flag_V >> 7) & 1;
+  ctx->drc_ccr[1] = (ctx->flag_N & 0x80) | (ctx->flag_NotZ ? 0 : 0x40)
+    | ((ctx->flag_C >> 8) & 1);
+  ctx->drc_ccr[2] = (ctx->flag_X >> 8) & 1;
+}
+
+// SR write from translated code, SET_SR; 1 if the block should
+// leave for an irq or trace
+static int drc_set_sr(u32 sr)
+{
+  M68K_CONTEXT *ctx = g_m68kcontext;
+  u32 sp;
+
+  ccr_to_drc(ctx, sr);
+  ctx->flag_T = sr & 0x8000;
+  ctx->flag_S = sr & SR_S;
+  ctx->flag_I = (sr >> 8) & 7;
+  if (!ctx->flag_S) {
+    sp = ctx->asp;
+    ctx->asp = ctx->areg[7].D;
+    ctx->areg[7].D = sp;
+  }
+  if (ctx->interrupts[0] > ctx->flag_I || ctx->flag_T)
+    sr_hit = 1;
+  return sr_hit;
+}
+
+// interrupt, as FAME does it
+static u32 drc_irq(M68K_CONTEXT *ctx, u32 pc)
+{
+  int line = ctx->interrupts[0];
+  u32 sr, sp, new_pc;
+
+  if (ctx->iack_handler != NULL)
+    ctx->iack_handler(line);
+  else
+    ctx->interrupts[0] = 0;
+
+  sr = drc_sr(ctx);
+  ctx->io_cycle_counter -= 44;
+  new_pc = ctx->read_long((line + 0x18) * 4);
+  if (!ctx->flag_S) {
+    sp = ctx->asp;
+    ctx->asp = ctx->areg[7].D;
+    ctx->areg[7].D = sp;
+  }
+  ctx->areg[7].D -= 4;
+  ctx->write_long(ctx->areg[7].D, pc);
+  ctx->areg[7].D -= 2;
+  ctx->write_word(ctx->areg[7].D, sr);
+  ctx->flag_S = SR_S;
+  ctx->flag_I = line;
+  return new_pc & ~1;
+}
+
+// run one instruction with FAME, returns the new pc
+static u32 drc_interp(u32 pc)
+{
+  M68K_CONTEXT *ctx = g_m68kcontext;
+  int cnt = ctx->io_cycle_counter;
+  u32 g0 = ctx->execinfo & FM68K_EMULATE_GROUP_0;
+
+  ccr_to_fame(ctx);
+  ctx->execinfo &= ~FM68K_EMULATE_GROUP_0;
+  ctx->cycles_needed = 0;
+  ctx->BasePC = ctx->Fetch[(pc >> 16) & 0xff] - (pc & 0xff000000);
+  ctx->PC = (u16 *)(uptr)(pc + ctx->BasePC);
+  ctx->Opcode = *ctx->PC++;
+  ops_jt[ctx->Opcode]();
+  pc = (u32)((uptr)ctx->PC - ctx->BasePC);
+
+  if (ctx->execinfo & FM68K_EMULATE_GROUP_0) {
+    // address error, FAME ends the run after it
+    stop_left = cnt - GROUP0_CYCLES;
+    stop_hit = 1;
+    ctx->io_cycle_counter = 0;
+  }
+  else if (ctx->Opcode != 0x4e73) // RTE clears it
+    ctx->execinfo |= g0;
+  ccr_from_fame(ctx);
+
+  // CHECK_INT_TO_JUMP
+  if (ctx->cycles_needed != 0) {
+    ctx->io_cycle_counter = ctx->cycles_needed;
+    ctx->cycles_needed = 0;
+    if (ctx->io_cycle_counter <= 0)
+      return pc;
+    if (ctx->interrupts[0] > ctx->flag_I)
+      pc = drc_irq(ctx, pc);
+    if (ctx->flag_T) {
+      // trace on, let FAME take it from the next run
+      stop_left = ctx->io_cycle_counter;
+      stop_hit = 1;
+      ctx->io_cycle_counter = 0;
+    }
+  }
+  return pc;
+}
+
+static void emit_interp_call(void)
+{
+  emit_reg_writeback();
+  emit_sync_out();
+  emith_move_r_imm(xDI, tr.pc);
+  emith_call(drc_interp);
+  emit_sync_in();
+  emith_tst_r_r(RCNT, RCNT);
+  emith_jump_cond(ICOND_JLE, drc_exit);
+}
+
+static void emit_interp(void)
+{
+  emit_interp_call();
+  emith_jump(tr.c->dispatch);
+}
+
+// same, but the block goes on if FAME ended up at next_pc
+static void emit_interp_next(u32 next_pc)
+{
+  emit_interp_call();
+  emith_cmp_r_imm(xAX, next_pc);
+  emith_jump_cond(ICOND_JNE, tr.c->dispatch);
+  emit_reg_reload();
+}
+
+// ea extension bytes
+static int ea_len(int mode, int reg, int sz)
+{
+  static const u8 len7[8] = { 2, 4, 2, 2, 0, 0, 0, 0 };
+  if (mode == 5 || mode == 6)
+    return 2;
+  if (mode < 7)
+    return 0;
+  if (reg == 4)
+    return sz == 4 ? 4 : 2;
+  return len7[reg];
+}
+
+// length of an instruction the block doesn't translate, 0 if the
+// block should end there (control flow, exceptions, stop)
+static int insn_len(const u16 *p)
+{
+  u32 op = *p;
+  int mode = (op >> 3) & 7, reg = op & 7;
+  int sz = op_sz[(op >> 6) & 3];
+
+  if (ops_jt[op] == ops_jt[0x4afc])
+    return 0;
+  switch (op >> 12) {
+  case 0x0:
+    if (op & 0x100)
+      return mode == 1 ? 4 : 2 + ea_len(mode, reg, 1);
+    if ((op & 0xff00) == 0x0800)
+      return 4 + ea_len(mode, reg, 1);
+    if ((op & 0x3f) == 0x3c)
+      return 4; // to CCR/SR
+    return 2 + (sz == 4 ? 4 : 2) + ea_len(mode, reg, sz);
+  case 0x1: case 0x2: case 0x3:
+    sz = move_sz[(op >> 12) & 3];
+    return 2 + ea_len(mode, reg, sz) + ea_len((op >> 6) & 7, (op >> 9) & 7, sz);
+  case 0x4:
+    if ((op & 0xffc0) == 0x4e80 || (op & 0xffc0) == 0x4ec0
+        || ((op & 0xfff0) == 0x4e40) || (op & 0xfff8) == 0x4e70)
+      return 0; // JSR JMP TRAP RESET.. RTR
+    if ((op & 0xfff0) == 0x4e50)
+      return (op & 8) ? 2 : 4; // UNLK LINK
+    if ((op & 0xfff0) == 0x4e60)
+      return 2; // MOVE USP
+    if ((op & 0xfb80) == 0x4880 && mode >= 2)
+      return 4 + ea_len(mode, reg, 2); // MOVEM
+    if ((op & 0xffb8) == 0x4880)
+      return 2; // EXT
+    if ((op & 0xfff8) == 0x4840)
+      return 2; // SWAP
+    if ((op & 0xf1c0) == 0x4180)
+      sz = 2; // CHK
+    return 2 + ea_len(mode, reg, sz ? sz : 2);
+  case 0x5:
+    if ((op & 0xf8) == 0xc8)
+      return 4; // DBcc
+    return 2 + ea_len(mode, reg, sz ? sz : 1);
+  case 0x6:
+    if ((op & 0xfe00) == 0x6000)
+      return 0; // BRA BSR
+    return (op & 0xff) ? 2 : 4;
+  case 0x7:
+    return 2;
+  case 0x8: case 0x9: case 0xb: case 0xc: case 0xd:
+    if (((op >> 6) & 3) == 3) {
+      // MUL DIV word, ADDA SUBA CMPA
+      sz = (op & 0x100) && (op >> 12) != 0x8 && (op >> 12) != 0xc ? 4 : 2;
+      return 2 + ea_len(mode, reg, sz);
+    }
+    if ((op & 0x100) && mode < 2)
+      return 2; // ADDX SUBX ABCD SBCD CMPM EXG, EOR Dn,Dn
+    return 2 + ea_len(mode, reg, sz);
+  case 0xe:
+    return ((op >> 6) & 3) == 3 ? 2 + ea_len(mode, reg, 2) : 2;
+  }
+  return 0;
+}
+
+// --------------------------------------------------------------------
+// blocks
+
+static u32 block_hash(const u8 *p, u32 len)
+{
+  u32 h = 2166136261u;
+  while (len-- > 0)
+    h = (h ^ *p++) * 16777619u;
+  return h;
+}
+
+// count the block in ram_code if it's in the main 68k's ram
+static void block_ram_code(const struct block_desc *bd, int add)
+{
+  ptrdiff_t offs = bd->src - Pico.ram;
+  int i;
+
+  if (bd->cpu != 0 || offs < 0 || offs >= 0x10000)
+    return;
+  for (i = offs >> PAGE_SHIFT; i <= (offs + bd->len - 1) >> PAGE_SHIFT; i++)
+    if (i < RAM_PAGES)
+      ram_code[i] += add;
+}
+
+static void block_unlink(struct block_desc *bd)
+{
+  struct block_desc **pbd;
+  struct jc_entry *jc;
+  int i;
+
+  for (pbd = &hash_table[HASH_FUNC(bd->pc)]; *pbd != NULL; pbd = &(*pbd)->next) {
+    if (*pbd == bd) {
+      *pbd = bd->next;
+      break;
+    }
+  }
+
+  jc = &cpus[bd->cpu].jc[(bd->pc >> 1) & (JC_SIZE - 1)];
+  if (jc->code == bd->code)
+    jc->src = NULL;
+
+  for (i = 0; i < bd->npages; i++) {
+    struct page_link *pl = &bd->pages[i];
+    u32 h = PAGE_FUNC(bd->src) + i;
+    h &= PAGE_HASH - 1;
+    if (pl->prev != NULL)
+      pl->prev->next = pl->next;
+    else
+      page_list[h] = pl->next;
+    if (pl->next != NULL)
+      pl->next->prev = pl->prev;
+    if (page_list[h] == NULL)
+      page_code[h] = 0;
+  }
+  bd->npages = 0;
+  bd->code = NULL;
+  block_ram_code(bd, -1);
+}
+
+static void block_link(struct block_desc *bd)
+{
+  u32 h, first, last;
+  int i;
+
+  bd->next = hash_table[HASH_FUNC(bd->pc)];
+  hash_table[HASH_FUNC(bd->pc)] = bd;
+
+  first = PAGE_FUNC(bd->src);
+  last = PAGE_FUNC(bd->src + bd->len - 1);
+  bd->npages = ((last - first) & (PAGE_HASH - 1)) + 1;
+  for (i = 0; i < bd->npages; i++) {
+    struct page_link *pl = &bd->pages[i];
+    h = (first + i) & (PAGE_HASH - 1);
+    pl->block = bd;
+    pl->prev = NULL;
+    pl->next = page_list[h];
+    if (pl->next != NULL)
+      pl->next->prev = pl;
+    page_list[h] = pl;
+    page_code[h] = 1;
+  }
+  block_ram_code(bd, 1);
+}
+
+static struct block_desc *block_find(int cpu, u32 pc, const u8 *src)
+{
+  struct block_desc *bd;
+
+  for (bd = hash_table[HASH_FUNC(pc)]; bd != NULL; bd = bd->next)
+    if (bd->pc == pc && bd->src == src && bd->cpu == cpu)
+      return bd;
+  return NULL;
+}
+
+static void drc_flush(void)
+{
+  tcache_ptr = tcache_blocks;
+  block_count = 0;
+  memset(hash_table, 0, HASH_SIZE * sizeof(hash_table[0]));
+  memset(page_list, 0, PAGE_HASH * sizeof(page_list[0]));
+  memset(page_code, 0, PAGE_HASH * sizeof(page_code[0]));
+  memset(page_inval, 0, PAGE_HASH * sizeof(page_inval[0]));
+  memset(ram_code, 0, sizeof(ram_code));
+  memset(cpus[0].jc, 0, JC_SIZE * sizeof(cpus[0].jc[0]));
+  memset(cpus[1].jc, 0, JC_SIZE * sizeof(cpus[1].jc[0]));
+  flush_pending = 0;
+}
+
+// emit the instructions from pc on, returns the end of the block
+static const u16 *translate_insns(u32 pc, const u16 *p)
+{
+  const u16 *src = p;
+  u32 start_pc = pc;
+  u8 *insn_code;
+  int i, j, ret, nstubs, len;
+
+  tr.n = tr.nstubs = tr.nfwd = 0;
+
+  // exits shared by the block, eax = pc
+  tr.exit = tcache_ptr;
+  emit_reg_writeback();
+  emith_jump(drc_exit);
+  tr.disp = tcache_ptr;
+  emit_reg_writeback();
+  emith_jump(tr.c->dispatch);
+  tr.entry = tcache_ptr;
+  emit_reg_reload();
+
+  for (;;) {
+    tr.pc = pc;
+    tr.op = p;
+    tr.p = p + 1;
+    tr.insn_pc[tr.n] = pc;
+    tr.insn_code[tr.n] = insn_code = tcache_ptr;
+    tr.n++;
+    nstubs = tr.nstubs;
+
+    ret = tr_insn(*p);
+    if (ret == TR_NO) {
+      tcache_ptr = insn_code;
+      tr.nstubs = nstubs;
+      len = insn_len(p);
+      tr.p = p + (len ? len / 2 : 1);
+      if (len) {
+        emit_interp_next(NEXT_PC);
+        ret = TR_OK;
+      }
+      else {
+        emit_interp();
+        ret = TR_END;
+      }
+    }
+    pc = NEXT_PC;
+    p = tr.p;
+    if (ret == TR_END) {
+      // go on if a jump ahead lands right here (if/else)
+      for (i = 0; i < tr.nfwd; i++)
+        if (tr.fwd[i].pc == pc)
+          break;
+      if (i == tr.nfwd || tr.n >= BLOCK_INSNS
+          || p - src >= BLOCK_BYTES / 2 || ((pc ^ start_pc) >> 16))
+        break;
+      continue;
+    }
+    if (tr.n >= BLOCK_INSNS || p - src >= BLOCK_BYTES / 2
+        || tr.nstubs > MAX_STUBS - 4 || ((pc ^ start_pc) >> 16))
+    {
+      emith_move_r_imm(xAX, pc);
+      emith_jump(tr.disp);
+      break;
+    }
+  }
+
+  // jumps ahead, to the block or out
+  for (i = 0; i < tr.nfwd; i++) {
+    for (j = 0; j < tr.n; j++)
+      if (tr.insn_pc[j] == tr.fwd[i].pc)
+        break;
+    if (j < tr.n) {
+      emith_jump_patch(tr.fwd[i].jmp, tr.insn_code[j]);
+      continue;
+    }
+    emith_jump_patch(tr.fwd[i].jmp, tcache_ptr);
+    emith_move_r_imm(xAX, tr.fwd[i].pc);
+    emith_jump(tr.disp);
+  }
+
+  // out of cycles exits, shared by pc
+  for (i = 0; i < tr.nstubs; i++) {
+    for (j = 0; j < i; j++)
+      if (tr.stubs[j].pc == tr.stubs[i].pc)
+        break;
+    if (j < i) {
+      emith_jump_patch(tr.stubs[i].jmp, tr.stubs[j].jmp);
+      continue;
+    }
+    emith_jump_patch(tr.stubs[i].jmp, tcache_ptr);
+    tr.stubs[i].jmp = tcache_ptr; // now the stub
+    emith_move_r_imm(xAX, tr.stubs[i].pc);
+    emith_jump(tr.exit);
+  }
+  return p;
+}
+
+static struct block_desc *translate(struct drc_cpu *c, u32 pc, const u8 *src)
+{
+  struct block_desc *bd;
+  const u16 *end;
+  u8 *block_start;
+
+  if (tcache_ptr > tcache_m68k + TCACHE_SIZE - TCACHE_RESERVE
+      || block_count >= MAX_BLOCKS)
+  {
+    // can't drop code that's still running
+    if (drc_depth > 1) {
+      flush_pending = 1;
+      return NULL;
+    }
+    elprintf(EL_STATUS, "m68k drc: tcache flush");
+    drc_flush();
+  }
+
+  // the first pass only counts register uses, the second one emits
+  // the block again with the most used ones in host registers
+  tr.c = c;
+  tr.start_pc = pc;
+  memset(tr.hreg, -1, sizeof(tr.hreg));
+  memset(tr.use, 0, sizeof(tr.use));
+  tr.dirty = 0;
+  block_start = tcache_ptr;
+  translate_insns(pc, (const u16 *)src);
+
+  tcache_ptr = block_start;
+  reg_alloc();
+  end = translate_insns(pc, (const u16 *)src);
+
+  bd = &blocks[block_count++];
+  bd->pc = pc;
+  bd->cpu = c - cpus;
+  bd->src = src;
+  bd->len = (const u8 *)end - src;
+  bd->hash = block_hash(src, bd->len);
+  bd->code = tr.entry;
+  block_link(bd);
+  return bd;
+}
+
+static u8 *drc_lookup(struct drc_cpu *c, u32 pc)
+{
+  const u8 *src = (const u8 *)(c->ctx->Fetch[(pc >> 16) & 0xff] + (pc & 0xffffff));
+  struct jc_entry *jc = &c->jc[(pc >> 1) & (JC_SIZE - 1)];
+  struct block_desc *bd;
+
+  if (jc->pc == pc && jc->src == src)
+    return jc->code;
+
+  bd = block_find(c - cpus, pc, src);
+  if (bd == NULL) {
+    // code that keeps rewriting itself is cheaper to interpret
+    if ((pc & 1) || page_inval[PAGE_FUNC(src)] >= SMC_LIMIT)
+      return NULL;
+    bd = translate(c, pc, src);
+    if (bd == NULL)
+      return NULL;
+  }
+  jc->pc = pc;
+  jc->src = src;
+  jc->code = bd->code;
+  return bd->code;
+}
+
+void fm68k_drc_wcheck(const void *ptr, int len)
+{
+  const u8 *p = ptr;
+  u32 h, first = PAGE_FUNC(p), last = PAGE_FUNC(p + len - 1);
+  struct page_link *pl, *next;
+  int hit = 0;
+
+  for (h = first; ; h = (h + 1) & (PAGE_HASH - 1)) {
+    if (page_code[h]) {
+      for (pl = page_list[h]; pl != NULL; pl = next) {
+        struct block_desc *bd = pl->block;
+        next = pl->next;
+        if (bd->src < p + len && p < bd->src + bd->len) {
+          if (page_inval[PAGE_FUNC(bd->src)] < SMC_LIMIT)
+            page_inval[PAGE_FUNC(bd->src)]++;
+          block_unlink(bd);
+          hit = 1;
+        }
+      }
+    }
+    if (h == last)
+      break;
+  }
+
+  // the running block may be one of them, leave it after this insn
+  if (hit && drc_depth > 0 && !inval_hit) {
+    inval_left = g_m68kcontext->io_cycle_counter;
+    inval_hit = 1;
+    g_m68kcontext->io_cycle_counter = 0;
+  }
+}
+
+// after memory was replaced, drop blocks whose code changed
+void fm68k_drc_verify(const void *ptr, int len)
+{
+  const u8 *p = ptr;
+  int i;
+
+  for (i = 0; i < block_count; i++) {
+    struct block_desc *bd = &blocks[i];
+    if (bd->code == NULL || bd->src + bd->len <= p || bd->src >= p + len)
+      continue;
+    if (block_hash(bd->src, bd->len) != bd->hash)
+      block_unlink(bd);
+  }
+}
+
+void fm68k_drc_flush_all(void)
+{
+  if (drc_depth > 0)
+    flush_pending = 1;
+  else if (drc_ready)
+    drc_flush();
+}
+
+static void wcheck_map(uptr *map, u32 a, int len)
+{
+  uptr v;
+
+  a &= 0xfffffe;
+  v = map[a >> M68K_MEM_SHIFT];
+  if (!map_flag_set(v))
+    fm68k_drc_wcheck((u8 *)(v << 1) + a, len);
+}
+
+// the write callbacks for FAME ops, with code invalidation
+#define MAKE_WRAPPERS(cpu, w8map, w16map) \
+static void wrap8_##cpu(unsigned int a, unsigned char d) \
+{ \
+  ((void (*)(unsigned int, unsigned char))cpus[cpu].write8)(a, d); \
+  wcheck_map(w8map, a, 2); \
+} \
+static void wrap16_##cpu(unsigned int a, unsigned short d) \
+{ \
+  ((void (*)(unsigned int, unsigned short))cpus[cpu].write16)(a, d); \
+  wcheck_map(w16map, a, 2); \
+} \
+static void wrap32_##cpu(unsigned int a, unsigned int d) \
+{ \
+  ((void (*)(unsigned int, unsigned int))cpus[cpu].write32)(a, d); \
+  wcheck_map(w16map, a, 4); \
+}
+
+MAKE_WRAPPERS(0, m68k_write8_map, m68k_write16_map)
+MAKE_WRAPPERS(1, s68k_write8_map, s68k_write16_map)
+
+// the main 68k's ram and its mirrors, as PicoMemSetup maps them
+static int drc_ram_check(struct drc_cpu *c)
+{
+  ptrdiff_t offs = Pico.ram - (u8 *)c->ctx;
+  ptrdiff_t code_offs = (u8 *)ram_code - (u8 *)c->ctx;
+  uptr v;
+  u32 a;
+
+  if (c != &cpus[0] || offs != (s32)offs || code_offs != (s32)code_offs)
+    return 0;
+  for (a = 0xe00000; a < 0x1000000; a += 1 << M68K_MEM_SHIFT) {
+    v = ((uptr)Pico.ram - a) >> 1;
+    if (c->r8map[a >> M68K_MEM_SHIFT] != v || c->r16map[a >> M68K_MEM_SHIFT] != v
+        || c->w8map[a >> M68K_MEM_SHIFT] != v || c->w16map[a >> M68K_MEM_SHIFT] != v)
+      return 0;
+  }
+  c->ram_offs = offs;
+  c->ram_code_offs = code_offs;
+  return 1;
+}
+
+// helpers match the standard callbacks only. The invalidating write
+// wrappers go in while the recompiler is used, fm68k_drc_unhook takes
+// them out
+static int drc_mem_check(struct drc_cpu *c)
+{
+  M68K_CONTEXT *ctx = c->ctx;
+
+  if ((void *)ctx->write_byte == c->wrap8 && (void *)ctx->write_word == c->wrap16
+      && (void *)ctx->write_long == c->wrap32)
+    goto check_reads;
+  if ((void *)ctx->write_byte != c->write8 || (void *)ctx->write_word != c->write16
+      || (void *)ctx->write_long != c->write32)
+    return 0;
+  ctx->write_byte = c->wrap8;
+  ctx->write_word = c->wrap16;
+  ctx->write_long = c->wrap32;
+  // memory was set up again, the blocks may have the old ram built in
+  c->ram = drc_ram_check(c);
+  fm68k_drc_flush_all();
+
+check_reads:
+  return (void *)ctx->read_byte == c->read8 && (void *)ctx->read_word == c->read16
+    && (void *)ctx->read_long == c->read32;
+}
+
+// --------------------------------------------------------------------
+// stubs, memory helpers: edi = address, esi = data, eax = result,
+// caller saved regs but r9 and r10 are clobbered
+
+// call the C function in rax from a helper, with the counter in the
+// context and r9, r10 kept
+static void gen_call_c(void)
+{
+  emith_ctx_write(RCNT, CNT);
+  emith_push(xR9);
+  emith_push(xR10);
+  emith_sub_r_ptr_imm(xSP, 8);
+  emith_call_reg(xAX);
+  emith_add_r_ptr_imm(xSP, 8);
+  emith_pop(xR10);
+  emith_pop(xR9);
+  emith_ctx_read(RCNT, CNT);
+}
+
+static void gen_jump_c(const void *f)
+{
+  emith_move_r_ptr_imm(xAX, f);
+  gen_call_c();
+  emith_ret();
+}
+
+// rax = map entry doubled, jumps to the returned jmp8 if it's a handler
+static u8 *gen_map_lookup(uptr *map, u32 amask)
+{
+  u8 *jh;
+
+  emith_and_r_imm(xDI, amask);
+  emith_move_r_r(xAX, xDI);
+  emith_lsr(xAX, xAX, M68K_MEM_SHIFT);
+  emith_move_r_ptr_imm(xDX, map);
+  emit_op_sib(1, 0x8b, xAX, xDX, xAX, 3);     // mov rax, [rdx + rax*8]
+  EMIT_OP_MODRM_PTR(0x01, 3, xAX, xAX);       // add rax, rax
+  JMP8_POS(jh);
+  return jh;
+}
+
+// cmp the page of host address in r, jne to the returned jmp8
+static u8 *gen_page_check(int r)
+{
+  u8 *jp;
+
+  emith_move_r_r_ptr(xDX, r);
+  EMIT_OP_MODRM_PTR(0xc1, 3, 5, xDX);         // shr rdx, PAGE_SHIFT
+  EMIT(PAGE_SHIFT, u8);
+  emith_and_r_imm(xDX, PAGE_HASH - 1);
+  emith_move_r_ptr_imm(xCX, page_code);
+  emit_op_sib(0, 0x80, 7, xCX, xDX, 0);       // cmp byte [rcx + rdx], 0
+  EMIT(0, u8);
+  JMP8_POS(jp);
+  return jp;
+}
+
+// host write in rax done, invalidate if there's code
+static void gen_write_check(struct drc_cpu *c, int len)
+{
+  u8 *jp, *jp2 = NULL;
+
+  jp = gen_page_check(xAX);
+  if (len == 4) {
+    emith_deref_op_(1, 0x8d, xR8, xAX, 3);    // lea r8, [rax + 3]
+    jp2 = gen_page_check(xR8);
+  }
+  emith_ret();
+  JMP8_EMIT(ICOND_JNE, jp);
+  if (jp2 != NULL) {
+    JMP8_EMIT(ICOND_JNE, jp2);
+  }
+  emith_move_r_r_ptr(xDI, xAX);
+  emith_move_r_imm(xSI, len);
+  emith_jump(c->wcheck);
+}
+
+// long accesses crossing a bank go to the C handlers, jae to the returned jmp8
+static u8 *gen_bank_cross_check(void)
+{
+  u8 *jc;
+
+  emit_ext_r(2, 0, xAX, xDI);
+  emith_cmp_r_imm(xAX, 0xfffe);
+  JMP8_POS(jc);
+  return jc;
+}
+
+static void gen_read_handler(int sz)
+{
+  gen_call_c();
+  emit_ext_r(sz, 0, xAX, xAX);
+  emith_ret();
+}
+
+static void gen_write_handler(int sz)
+{
+  emit_ext_r(sz, 0, xSI, xSI);
+  gen_call_c();
+  emith_ret();
+}
+
+static void gen_helpers(struct drc_cpu *c)
+{
+  u8 *jh, *jc;
+
+  c->wcheck = tcache_ptr;
+  gen_jump_c(fm68k_drc_wcheck);
+
+  c->rd8 = tcache_ptr;
+  jh = gen_map_lookup(c->r8map, 0xffffff);
+  emith_eor_r_imm(xDI, 1);
+  emit_op_sib(0, 0x0fb6, xAX, xAX, xDI, 0);   // movzx eax, byte [rax + rdi]
+  emith_ret();
+  JMP8_EMIT(ICOND_JB, jh);
+  gen_read_handler(1);
+
+  c->rd16 = tcache_ptr;
+  jh = gen_map_lookup(c->r16map, 0xfffffe);
+  emit_op_sib(0, 0x0fb7, xAX, xAX, xDI, 0);
+  emith_ret();
+  JMP8_EMIT(ICOND_JB, jh);
+  gen_read_handler(2);
+
+  c->rd32 = tcache_ptr;
+  jc = gen_bank_cross_check();
+  jh = gen_map_lookup(c->r16map, 0xfffffe);
+  emit_op_sib(0, 0x8b, xAX, xAX, xDI, 0);
+  emith_rol(xAX, xAX, 16);
+  emith_ret();
+  JMP8_EMIT(ICOND_JB, jh);
+  JMP8_EMIT(ICOND_JAE, jc);
+  gen_jump_c(c->read32);
+
+  c->wr8 = tcache_ptr;
+  jh = gen_map_lookup(c->w8map, 0xffffff);
+  emith_eor_r_imm(xDI, 1);
+  EMIT_OP_MODRM_PTR(0x01, 3, xDI, xAX);       // add rax, rdi
+  emith_write8_r_r_offs(xSI, xAX, 0);
+  gen_write_check(c, 1);
+  JMP8_EMIT(ICOND_JB, jh);
+  gen_write_handler(1);
+
+  c->wr16 = tcache_ptr;
+  jh = gen_map_lookup(c->w16map, 0xfffffe);
+  EMIT_OP_MODRM_PTR(0x01, 3, xDI, xAX);
+  emith_write16_r_r_offs(xSI, xAX, 0);
+  gen_write_check(c, 2);
+  JMP8_EMIT(ICOND_JB, jh);
+  gen_write_handler(2);
+
+  c->wr32 = tcache_ptr;
+  jc = gen_bank_cross_check();
+  jh = gen_map_lookup(c->w16map, 0xfffffe);
+  EMIT_OP_MODRM_PTR(0x01, 3, xDI, xAX);
+  emith_rol(xSI, xSI, 16);
+  emith_write_r_r_offs(xSI, xAX, 0);
+  gen_write_check(c, 4);
+  JMP8_EMIT(ICOND_JB, jh);
+  JMP8_EMIT(ICOND_JAE, jc);
+  gen_jump_c(c->write32);
+
+  // WRITE_LONG_DEC_F: low word first
+  c->wr32dec = tcache_ptr;
+  emith_sub_r_ptr_imm(xSP, 24);
+  emith_write_r_r_offs(xDI, xSP, 0);
+  emith_write_r_r_offs(xSI, xSP, 4);
+  emith_add_r_imm(xDI, 2);
+  emith_call(c->wr16);
+  emith_read_r_r_offs(xDI, xSP, 0);
+  emith_read_r_r_offs(xSI, xSP, 4);
+  emith_lsr(xSI, xSI, 16);
+  emith_call(c->wr16);
+  emith_add_r_ptr_imm(xSP, 24);
+  emith_ret();
+}
+
+// eax = pc, rbp = ctx
+static void gen_dispatcher(struct drc_cpu *c)
+{
+  u8 *jmiss1, *jmiss2;
+
+  c->dispatch = tcache_ptr;
+  // rdx = host address of the code
+  emith_move_r_r(xCX, xAX);
+  emith_lsr(xCX, xCX, 16);
+  emith_and_r_imm(xCX, 0xff);
+  EMIT_REX_IF(1, xDX, xBP);
+  EMIT_OP(0x8b);
+  EMIT_MODRM(2, xDX, 4);
+  EMIT_SIB(3, xCX, xBP);                      // mov rdx, [rbp + rcx*8 + Fetch]
+  EMIT(CTX(Fetch), u32);
+  emith_move_r_r(xCX, xAX);
+  emith_and_r_imm(xCX, 0xffffff);
+  EMIT_OP_MODRM_PTR(0x01, 3, xCX, xDX);       // add rdx, rcx
+  // rsi = jump cache entry
+  emith_move_r_r(xCX, xAX);
+  emith_and_r_imm(xCX, (JC_SIZE - 1) << 1);
+  emith_lsl(xCX, xCX, 4);
+  emith_move_r_ptr_imm(xSI, c->jc);
+  EMIT_OP_MODRM_PTR(0x01, 3, xCX, xSI);       // add rsi, rcx
+  EMIT_OP_MODRM(0x39, 0, xAX, xSI);           // cmp [rsi], eax
+  JMP8_POS(jmiss1);
+  emith_deref_op_(1, 0x39, xDX, xSI, offsetof(struct jc_entry, src));
+  JMP8_POS(jmiss2);
+  emith_deref_op(0xff, 4, xSI, offsetof(struct jc_entry, code));
+  JMP8_EMIT(ICOND_JNE, jmiss1);
+  JMP8_EMIT(ICOND_JNE, jmiss2);
+  emith_jump(drc_exit);
+}
+
+static int cpu_has_lahf(void)
+{
+  unsigned int a = 0x80000001, b, c = 0, d;
+  asm ("cpuid" : "+a"(a), "=b"(b), "+c"(c), "=d"(d));
+  return c & 1;
+}
+
+static void drc_free(void)
+{
+  if (tcache_m68k != NULL)
+    plat_munmap(tcache_m68k, TCACHE_SIZE);
+  free(blocks);
+  free(hash_table);
+  free(page_list);
+  free(page_code);
+  free(page_inval);
+  free(cpus[0].jc);
+  free(cpus[1].jc);
+  tcache_m68k = NULL;
+  blocks = NULL;
+  hash_table = NULL;
+  page_list = NULL;
+  page_code = NULL;
+  page_inval = NULL;
+  cpus[0].jc = cpus[1].jc = NULL;
+}
+
+int fm68k_drc_init(void)
+{
+  int i;
+
+  if (drc_ready)
+    return 0;
+  if (!cpu_has_lahf()) {
+    elprintf(EL_STATUS, "m68k drc: no lahf/sahf, disabled");
+    return -1;
+  }
+  tcache_m68k = plat_mmap(0, TCACHE_SIZE, 1, 0);
+  if (tcache_m68k == NULL)
+    return -1;
+  if (plat_mem_set_exec(tcache_m68k, TCACHE_SIZE) != 0) {
+    elprintf(EL_STATUS, "m68k drc: can't make tcache executable");
+    goto fail;
+  }
+  blocks = calloc(MAX_BLOCKS, sizeof(blocks[0]));
+  hash_table = calloc(HASH_SIZE, sizeof(hash_table[0]));
+  page_list = calloc(PAGE_HASH, sizeof(page_list[0]));
+  page_code = calloc(PAGE_HASH, sizeof(page_code[0]));
+  page_inval = calloc(PAGE_HASH, sizeof(page_inval[0]));
+  cpus[0].jc = calloc(JC_SIZE, sizeof(cpus[0].jc[0]));
+  cpus[1].jc = calloc(JC_SIZE, sizeof(cpus[1].jc[0]));
+  if (blocks == NULL || hash_table == NULL || page_list == NULL
+      || page_code == NULL || page_inval == NULL
+      || cpus[0].jc == NULL || cpus[1].jc == NULL)
+    goto fail;
+
+  fm68k_ops_init();
+  ops_jt = fm68k_ops_jumptab();
+  for (i = 0; i < 32; i++)
+    ccr_drc[i] = ((i >> 1) & 1) | ((i & 0x0c) << 12) | ((i & 1) << 8);
+
+  cpus[0].ctx = &PicoCpuFM68k;
+  cpus[0].r8map = m68k_read8_map;
+  cpus[0].r16map = m68k_read16_map;
+  cpus[0].w8map = m68k_write8_map;
+  cpus[0].w16map = m68k_write16_map;
+  cpus[0].read8 = m68k_read8;
+  cpus[0].read16 = m68k_read16;
+  cpus[0].read32 = m68k_read32;
+  cpus[0].write8 = m68k_write8;
+  cpus[0].write16 = m68k_write16;
+  cpus[0].write32 = m68k_write32;
+  cpus[0].wrap8 = wrap8_0;
+  cpus[0].wrap16 = wrap16_0;
+  cpus[0].wrap32 = wrap32_0;
+
+  cpus[1].ctx = &PicoCpuFS68k;
+  cpus[1].r8map = s68k_read8_map;
+  cpus[1].r16map = s68k_read16_map;
+  cpus[1].w8map = s68k_write8_map;
+  cpus[1].w16map = s68k_write16_map;
+  cpus[1].read8 = s68k_read8;
+  cpus[1].read16 = s68k_read16;
+  cpus[1].read32 = s68k_read32;
+  cpus[1].write8 = s68k_write8;
+  cpus[1].write16 = s68k_write16;
+  cpus[1].write32 = s68k_write32;
+  cpus[1].wrap8 = wrap8_1;
+  cpus[1].wrap16 = wrap16_1;
+  cpus[1].wrap32 = wrap32_1;
+
+  tcache_ptr = tcache_m68k;
+
+  // entry(ctx, code)
+  drc_entry = (void *)tcache_ptr;
+  emith_sh2_drc_entry();
+  emith_move_r_r_ptr(xBP, xDI);
+  emit_sync_in();
+  emith_jump_reg(xSI);
+
+  drc_exit = tcache_ptr;
+  emith_ctx_write(xAX, CTX(pc));
+  emit_sync_out();
+  emith_sh2_drc_exit();
+
+  for (i = 0; i < 2; i++) {
+    gen_dispatcher(&cpus[i]);
+    gen_helpers(&cpus[i]);
+  }
+  tcache_blocks = tcache_ptr;
+  drc_flush();
+
+  drc_ready = 1;
+  elprintf(EL_STATUS, "m68k drc: %d bytes of stubs", (int)(tcache_blocks - tcache_m68k));
+  return 0;
+
+fail:
+  drc_free();
+  return -1;
+}
+
+// FAME runs alone again, give it the plain write callbacks back. The
+// translations aren't invalidated from now on, drc_mem_check flushes
+// them when the wrappers go in again.
+void fm68k_drc_unhook(void)
+{
+  int i;
+
+  if (!drc_ready)
+    return;
+  for (i = 0; i < 2; i++) {
+    M68K_CONTEXT *ctx = cpus[i].ctx;
+    if ((void *)ctx->write_byte == cpus[i].wrap8) {
+      ctx->write_byte = cpus[i].write8;
+      ctx->write_word = cpus[i].write16;
+      ctx->write_long = cpus[i].write32;
+    }
+  }
+}
+
+void fm68k_drc_finish(void)
+{
+  if (!drc_ready)
+    return;
+  fm68k_drc_unhook();
+  drc_free();
+  drc_ready = 0;
+}
+
+void fm68k_drc_idle_det(int mode)
+{
+  if (!drc_ready)
+    return;
+  fm68k_ops_emulate(0, mode);
+  fm68k_drc_flush_all();
+}
+
+int fm68k_drc_emulate(int cycles)
+{
+  M68K_CONTEXT *ctx = g_m68kcontext;
+  struct drc_cpu *c = &cpus[ctx == &PicoCpuFS68k];
+  u8 *code;
+
+  // trace mode and unknown memory setups are left to FAME
+  if (!drc_ready || (ctx->sr & 0x8000) || !drc_mem_check(c))
+    return fm68k_emulate(cycles, 0);
+
+  if (ctx->execinfo & FM68K_HALTED) {
+    if (ctx->interrupts[0] <= ((ctx->sr >> 8) & 7))
+      return cycles;
+    ctx->execinfo &= ~FM68K_HALTED;
+  }
+
+  ctx->execinfo |= M68K_RUNNING;
+  ctx->flag_T = 0;
+  ctx->flag_S = ctx->sr & SR_S;
+  ctx->flag_I = (ctx->sr >> 8) & 7;
+  ccr_to_drc(ctx, ctx->sr);
+  ctx->io_cycle_counter = cycles;
+  ctx->cycles_needed = 0;
+
+  if (ctx->interrupts[0] > ctx->flag_I)
+    ctx->pc = drc_irq(ctx, ctx->pc);
+
+  drc_depth++;
+  while (ctx->io_cycle_counter > 0) {
+    code = drc_lookup(c, ctx->pc);
+    if (code != NULL)
+      drc_entry(ctx, code);
+    else
+      ctx->pc = drc_interp(ctx->pc);
+    if (inval_hit) {
+      inval_hit = 0;
+      ctx->io_cycle_counter += inval_left;
+    }
+    if (sr_hit) {
+      // CHECK_INT_TO_JUMP after the SR write
+      sr_hit = 0;
+      if (ctx->io_cycle_counter > 0 && ctx->interrupts[0] > ctx->flag_I)
+        ctx->pc = drc_irq(ctx, ctx->pc);
+      if (ctx->io_cycle_counter > 0 && ctx->flag_T) {
+        stop_left = ctx->io_cycle_counter;
+        stop_hit = 1;
+        ctx->io_cycle_counter = 0;
+      }
+    }
+    if (stop_hit) {
+      stop_hit = 0;
+      ctx->io_cycle_counter = stop_left;
+      break;
+    }
+  }
+  drc_depth--;
+  if (flush_pending && drc_depth == 0)
+    drc_flush();
+
+  ctx->sr = drc_sr(ctx);
+  ctx->execinfo &= ~M68K_RUNNING;
+  return cycles - ctx->io_cycle_counter;
+}
+
+// per emulator instance, the translations stay in the buffers above
+const struct pico_ctx_area ctx_areas_fm68k_drc[] = {
+  PICO_CTX_AREA(cpus),
+  PICO_CTX_AREA(tcache_m68k),
+  PICO_CTX_AREA(tcache_ptr),
+  PICO_CTX_AREA(tcache_blocks),
+  PICO_CTX_AREA(blocks),
+  PICO_CTX_AREA(block_count),
+  PICO_CTX_AREA(hash_table),
+  PICO_CTX_AREA(page_list),
+  PICO_CTX_AREA(page_code),
+  PICO_CTX_AREA(page_inval),
+  PICO_CTX_AREA(ram_code),
+  PICO_CTX_AREA(drc_entry),
+  PICO_CTX_AREA(drc_exit),
+  PICO_CTX_AREA(drc_ready),
+  PICO_CTX_AREA(flush_pending),
+  PICO_CTX_AREA_END
+};
+
+// vim:shiftwidth=2:ts=2:expandtab
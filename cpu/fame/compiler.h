@@ -0,0 +1,20 @@
+// 68000 recompiler, runs on FAME contexts (g_m68kcontext)
+
+#ifdef DRC_M68K
+int  fm68k_drc_init(void);
+void fm68k_drc_finish(void);
+void fm68k_drc_unhook(void);
+int  fm68k_drc_emulate(int cycles);
+void fm68k_drc_flush_all(void);
+void fm68k_drc_wcheck(const void *ptr, int len);
+void fm68k_drc_verify(const void *ptr, int len);
+void fm68k_drc_idle_det(int mode);
+#else
+#define fm68k_drc_init() (void)0
+#define fm68k_drc_finish()
+#define fm68k_drc_unhook()
+#define fm68k_drc_flush_all()
+#define fm68k_drc_wcheck(ptr, len)
+#define fm68k_drc_verify(ptr, len)
+#define fm68k_drc_idle_det(mode)
+#endif
@@ -138,7 +138,7 @@ typedef struct
 	unsigned int   flag_I;
 
 	unsigned char  not_polling;
-	unsigned char  pad[3];
+	unsigned char  drc_ccr[3]; // ccr in x86 format while in recompiled code
 
 	unsigned long  Fetch[M68K_FETCHBANK1];
 } M68K_CONTEXT;
@@ -534,7 +534,9 @@ typedef signed int	s32;
 ///////////////////
 
 /* Current CPU context */
+#ifndef FAMEC_EXTERN_CONTEXT
 M68K_CONTEXT *g_m68kcontext;
+#endif
 #define m68kcontext (*g_m68kcontext)
 
 #ifdef FAMEC_NO_GOTOS
@@ -0,0 +1,17 @@
+/*
+ * FAME built a second time with opcode handlers as functions,
+ * for the 68000 recompiler to run single instructions it doesn't
+ * translate. Uses the context of the main build (g_m68kcontext).
+ */
+
+#define FAMEC_NO_GOTOS
+#define FAMEC_EXTERN_CONTEXT
+
+#define fm68k_init            fm68k_ops_init
+#define fm68k_reset           fm68k_ops_reset
+#define fm68k_get_pc          fm68k_ops_get_pc
+#define fm68k_would_interrupt fm68k_ops_would_interrupt
+#define fm68k_emulate         fm68k_ops_emulate
+#define get_jumptab           fm68k_ops_jumptab
+
+#include "famec.c"
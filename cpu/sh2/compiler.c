@@ -17,6 +17,10 @@
  * - block-local branch linking
  * - block linking (except between tcaches)
  * - some constant propagation
+ * - recompilation of hot blocks with constant propagation across
+ *   labels, T flag liveness and inline SDRAM/data array accesses
+ * - list of translated blocks kept on disk, translated again in bulk
+ *   before they're first run
  *
  * TODO:
  * - better constant propagation
@@ -37,15 +41,27 @@
 // features
 #define PROPAGATE_CONSTANTS     1
 #define LINK_BRANCHES           1
+#define HOT_BLOCKS              1
+
+// hot blocks access SDRAM and data arrays directly, needs enough temps
+#if defined(__x86_64__) && !defined(PDB_NET)
+#define INLINE_RAM_ACCESS       1
+#else
+#define INLINE_RAM_ACCESS       0
+#endif
 
 // limits (per block)
 #define MAX_BLOCK_SIZE          (BLOCK_INSN_LIMIT * 6 * 6)
+#define MAX_HOT_BLOCK_SIZE      (MAX_BLOCK_SIZE * 6)
 
 // max literal offset from the block end
 #define MAX_LITERAL_OFFSET      32*2
 #define MAX_LITERALS            (BLOCK_INSN_LIMIT / 4)
 #define MAX_LOCAL_BRANCHES      32
 
+// block entry runs before it's recompiled as a hot block
+#define HOT_BLOCK_THRESHOLD     256
+
 // debug stuff
 // 1 - warnings/errors
 // 2 - block info/smc
@@ -123,6 +139,7 @@ enum op_types {
   OP_MOVA,
   OP_SLEEP,
   OP_RTE,
+  OP_UNDEFINED,
 };
 
 #ifdef DRC_SH2
@@ -183,9 +200,8 @@ struct block_entry {
   void *tcache_ptr;          // translated block for above PC
   struct block_entry *next;  // next block in hash_table with same pc hash
   struct block_link *links;  // links to this entry
-#if (DRC_DEBUG & 2)
   struct block_desc *block;
-#endif
+  int hits;                  // runs left until hot block recompilation
 };
 
 struct block_desc {
@@ -196,6 +212,7 @@ struct block_desc {
   int refcount;
 #endif
   int entry_count;
+  struct block_desc *cold;   // block this hot block was recompiled from
   struct block_entry entryp[MAX_BLOCK_ENTRIES];
 };
 
@@ -304,6 +321,32 @@ static temp_reg_t reg_temp[] = {
   {  3, },
 };
 
+#elif defined(__x86_64__)
+#include "../drc/emit_x86.c"
+
+// rbx, rbp, r12-r15 are callee saved in SysV ABI, rbp is context
+static const int reg_map_g2h[] = {
+  xR12, xR13, xR14, -1,
+  -1, -1, -1, -1,
+  -1, -1, -1, -1,
+  -1, -1, -1, xR15, // r12 .. sp
+  -1, -1, -1, xBX,  // SHR_PC,  SHR_PPC, SHR_PR,   SHR_SR,
+  -1, -1, -1, -1,   // SHR_GBR, SHR_VBR, SHR_MACH, SHR_MACL,
+};
+
+// scratch regs, r11 is reserved for the emitter;
+// non-arg regs first, so that temporaries don't take arg regs
+static temp_reg_t reg_temp[] = {
+  { xAX, },
+  { xR8, },
+  { xR9, },
+  { xR10, },
+  { xCX, },
+  { xDX, },
+  { xSI, },
+  { xDI, },
+};
+
 #elif defined(__i386__)
 #include "../drc/emit_x86.c"
 
@@ -343,6 +386,7 @@ static void REGPARM(1) (*sh2_drc_entry)(SH2 *sh2);
 static void            (*sh2_drc_dispatcher)(void);
 static void            (*sh2_drc_exit)(void);
 static void            (*sh2_drc_test_irq)(void);
+static void            (*sh2_drc_hot)(void);
 
 static u32  REGPARM(2) (*sh2_drc_read8)(u32 a, SH2 *sh2);
 static u32  REGPARM(2) (*sh2_drc_read16)(u32 a, SH2 *sh2);
@@ -381,15 +425,20 @@ static int dr_ctx_get_mem_ptr(u32 a, u32 *mask)
   return poffs;
 }
 
-static struct block_entry *dr_get_entry(u32 pc, int is_slave, int *tcache_id)
+static int dr_tcache_id(u32 pc, int is_slave)
 {
-  struct block_entry *be;
-  u32 tcid = 0, mask;
-
   // data arrays have their own caches
   if ((pc & 0xe0000000) == 0xc0000000 || (pc & ~0xfff) == 0)
-    tcid = 1 + is_slave;
+    return 1 + is_slave;
+  return 0;
+}
 
+static struct block_entry *dr_get_entry(u32 pc, int is_slave, int *tcache_id)
+{
+  struct block_entry *be;
+  u32 tcid, mask;
+
+  tcid = dr_tcache_id(pc, is_slave);
   *tcache_id = tcid;
 
   mask = hash_table_sizes[tcid] - 1;
@@ -403,6 +452,195 @@ static struct block_entry *dr_get_entry(u32 pc, int is_slave, int *tcache_id)
 
 // ---------------------------------------------------------------
 
+// persistent block list. Translated code has absolute addresses in it,
+// so the list of translated blocks is kept on disk instead, and listed
+// blocks that still match memory are translated on misses: all of them for
+// the tcache, then the ones near the missed pc. Warm-up translation is
+// limited to BLIST_FRAME_BLOCKS per frame, the rest waits for later misses.
+#define BLIST_MAX      0x4000
+#define BLIST_HASH     0x400
+#define BLIST_VERSION  1
+#define BLIST_FRAME_BLOCKS 64
+
+#define BRF_SLAVE      (1 << 0)
+#define BRF_HOT        (1 << 1) // was recompiled as hot block
+#define BRF_DONE       (1 << 7) // translated or stale, not saved
+
+struct block_rec {
+  u32 pc;
+  u32 hash;                  // of the block insns
+  u16 size;                  // insn bytes
+  u8 flags;                  // BRF_*
+  u8 pad;
+};
+
+struct blist_header {
+  char magic[4];             // "SH2B"
+  u32 version;
+  u32 rom_crc;
+  u32 count;                 // block_recs that follow
+};
+
+static struct block_rec *blist;
+static int blist_count;
+static u16 blist_head[BLIST_HASH]; // index + 1, 0 ends a chain
+static u16 blist_next[BLIST_MAX];
+static u8 blist_warm_all[TCACHE_BUFFERS];
+static int blist_warm_pos[TCACHE_BUFFERS]; // next record of the full pass
+static int blist_budget;                   // blocks left this frame
+static u32 blist_rom_crc;
+static char blist_fname[256];
+
+static void *dr_get_pc_base(u32 pc, int is_slave);
+
+static int dr_blist_hash(u32 pc, int size, int is_slave, u32 *hash)
+{
+  u16 *dr_pc_base;
+  u32 end = pc + size;
+  u32 h = 0x811c9dc5;
+
+  dr_pc_base = dr_get_pc_base(pc, is_slave);
+  if (dr_pc_base == (void *)-1 || dr_get_pc_base(end - 2, is_slave) != dr_pc_base)
+    return 0;
+
+  for (; pc < end; pc += 2)
+    h = (h ^ FETCH_OP(pc)) * 0x01000193; // FNV-1a
+  *hash = h;
+  return 1;
+}
+
+static void dr_blist_link(int i)
+{
+  u32 h = (blist[i].pc >> 1) & (BLIST_HASH - 1);
+
+  blist_next[i] = blist_head[h];
+  blist_head[h] = i + 1;
+}
+
+static void dr_blist_add(u32 pc, int size, int is_slave, int flags)
+{
+  struct block_rec *rec;
+  u32 hash;
+  int i;
+
+  if (blist == NULL || !dr_blist_hash(pc, size, is_slave, &hash))
+    return;
+
+  for (i = blist_head[(pc >> 1) & (BLIST_HASH - 1)]; i != 0; i = blist_next[i - 1]) {
+    rec = &blist[i - 1];
+    if (rec->pc == pc && rec->hash == hash && rec->size == size
+        && (dr_tcache_id(pc, is_slave) == 0
+            || !(rec->flags & BRF_SLAVE) == !is_slave))
+    {
+      rec->flags |= flags | BRF_DONE;
+      return;
+    }
+  }
+
+  if (blist_count >= BLIST_MAX)
+    return;
+
+  rec = &blist[blist_count];
+  rec->pc = pc;
+  rec->hash = hash;
+  rec->size = size;
+  rec->flags = flags | BRF_DONE | (is_slave ? BRF_SLAVE : 0);
+  rec->pad = 0;
+  dr_blist_link(blist_count++);
+}
+
+static void dr_blist_flushed(int tcid)
+{
+  int i;
+
+  // translate again on misses near them
+  for (i = 0; i < blist_count; i++)
+    if (dr_tcache_id(blist[i].pc, blist[i].flags & BRF_SLAVE) == tcid)
+      blist[i].flags &= ~BRF_DONE;
+}
+
+void sh2_drc_blist_save(void)
+{
+  struct blist_header hdr;
+  FILE *f;
+  int i;
+
+  if (blist == NULL)
+    return;
+
+  f = fopen(blist_fname, "wb");
+  if (f != NULL) {
+    memcpy(hdr.magic, "SH2B", sizeof(hdr.magic));
+    hdr.version = BLIST_VERSION;
+    hdr.rom_crc = blist_rom_crc;
+    hdr.count = blist_count;
+    for (i = 0; i < blist_count; i++)
+      blist[i].flags &= ~BRF_DONE;
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1
+        || fwrite(blist, sizeof(blist[0]), blist_count, f) != (size_t)blist_count)
+      elprintf(EL_STATUS, "sh2 drc: failed to write %s", blist_fname);
+    fclose(f);
+  }
+  else
+    elprintf(EL_STATUS, "sh2 drc: can't create %s", blist_fname);
+
+  free(blist);
+  blist = NULL;
+  blist_count = 0;
+}
+
+int sh2_drc_blist_load(const char *fname, unsigned int rom_crc)
+{
+  struct blist_header hdr;
+  struct block_rec *rec;
+  FILE *f;
+  int i, n;
+
+  if (blist != NULL && rom_crc == blist_rom_crc
+      && strcmp(fname, blist_fname) == 0)
+    return blist_count;
+
+  sh2_drc_blist_save();
+  blist = malloc(BLIST_MAX * sizeof(blist[0]));
+  if (blist == NULL)
+    return -1;
+
+  snprintf(blist_fname, sizeof(blist_fname), "%s", fname);
+  blist_rom_crc = rom_crc;
+  blist_count = 0;
+  memset(blist_head, 0, sizeof(blist_head));
+  memset(blist_warm_all, 1, sizeof(blist_warm_all));
+  memset(blist_warm_pos, 0, sizeof(blist_warm_pos));
+  blist_budget = BLIST_FRAME_BLOCKS;
+
+  f = fopen(fname, "rb");
+  if (f == NULL)
+    return 0;
+
+  if (fread(&hdr, sizeof(hdr), 1, f) == 1
+      && memcmp(hdr.magic, "SH2B", sizeof(hdr.magic)) == 0
+      && hdr.version == BLIST_VERSION && hdr.rom_crc == rom_crc)
+  {
+    n = hdr.count < BLIST_MAX ? hdr.count : BLIST_MAX;
+    n = fread(blist, sizeof(blist[0]), n, f);
+    for (i = 0; i < n; i++) {
+      rec = &blist[i];
+      if ((rec->pc & 1) || (rec->size & 1) || rec->size == 0
+          || rec->size > BLOCK_INSN_LIMIT * 2)
+        continue;
+      rec->flags &= BRF_SLAVE | BRF_HOT;
+      blist[blist_count] = *rec;
+      dr_blist_link(blist_count++);
+    }
+  }
+  fclose(f);
+
+  elprintf(EL_STATUS, "sh2 drc: %d blocks listed in %s", blist_count, fname);
+  return blist_count;
+}
+
+// ---------------------------------------------------------------
+
 // block management
 static void add_to_block_list(struct block_list **blist, struct block_desc *block)
 {
@@ -471,6 +709,8 @@ static void REGPARM(1) flush_tcache(int tcid)
 
   for (i = 0; i < ram_sizes[tcid] / INVAL_PAGE_SIZE; i++)
     rm_block_list(&inval_lookup[tcid][i]);
+
+  dr_blist_flushed(tcid);
 }
 
 static void add_to_hashlist(struct block_entry *be, int tcache_id)
@@ -539,11 +779,13 @@ static struct block_desc *dr_add_block(u32 addr, u16 size_lit,
   bd->size_nolit = size_nolit;
 
   bd->entry_count = 1;
+  bd->cold = NULL;
   bd->entryp[0].pc = addr;
   bd->entryp[0].tcache_ptr = tcache_ptr;
   bd->entryp[0].links = NULL;
-#if (DRC_DEBUG & 2)
   bd->entryp[0].block = bd;
+  bd->entryp[0].hits = HOT_BLOCK_THRESHOLD;
+#if (DRC_DEBUG & 2)
   bd->refcount = 0;
 #endif
   add_to_hashlist(&bd->entryp[0], tcache_id);
@@ -680,6 +922,9 @@ typedef enum {
 
 static int rcache_get_reg_(sh2_reg_e r, rc_gr_mode mode, int do_locking);
 
+// set while recompiling a hot block
+static int dr_hot;
+
 // guest regs with constants
 static u32 dr_gcregs[24];
 // a mask of constant/dirty regs
@@ -853,10 +1098,9 @@ do_alloc:
   ret = tr->hreg;
 
   if (mode != RC_GR_WRITE) {
-    if (gconst_check(r)) {
-      if (gconst_try_read(ret, r))
-        tr->flags |= HRF_DIRTY;
-    }
+    // clean constants not in a host reg are in ctx
+    if (gconst_check(r) && gconst_try_read(ret, r))
+      tr->flags |= HRF_DIRTY;
     else
       emith_ctx_read(tr->hreg, r * 4);
   }
@@ -891,10 +1135,9 @@ do_alloc:
   return tr->hreg;
 }
 
-static int rcache_get_arg_id(int arg)
+static int rcache_get_hr_id(int r)
 {
-  int i, r = 0;
-  host_arg2reg(r, arg);
+  int i;
 
   for (i = 0; i < ARRAY_SIZE(reg_temp); i++)
     if (reg_temp[i].hreg == r)
@@ -910,7 +1153,7 @@ static int rcache_get_arg_id(int arg)
     gconst_check_evict(reg_temp[i].greg);
   }
   else if (reg_temp[i].type == HR_TEMP) {
-    printf("arg %d reg %d already used, aborting\n", arg, r);
+    printf("reg %d already used, aborting\n", r);
     exit(1);
   }
 
@@ -920,6 +1163,13 @@ static int rcache_get_arg_id(int arg)
   return i;
 }
 
+static int rcache_get_arg_id(int arg)
+{
+  int r = 0;
+  host_arg2reg(r, arg);
+  return rcache_get_hr_id(r);
+}
+
 // get a reg to be used as function arg
 static int rcache_get_tmp_arg(int arg)
 {
@@ -929,6 +1179,15 @@ static int rcache_get_tmp_arg(int arg)
   return reg_temp[id].hreg;
 }
 
+// get the reg function return value is in
+static int rcache_get_tmp_ret(void)
+{
+  int id = rcache_get_hr_id(RET_REG);
+  reg_temp[id].type = HR_TEMP;
+
+  return reg_temp[id].hreg;
+}
+
 // same but caches a reg. RC_GR_READ only.
 static int rcache_get_reg_arg(int arg, sh2_reg_e r)
 {
@@ -957,10 +1216,8 @@ static int rcache_get_reg_arg(int arg, sh2_reg_e r)
 
   // must read
   srcr = dstr;
-  if (gconst_check(r)) {
-    if (gconst_try_read(srcr, r))
-      dirty = 1;
-  }
+  if (gconst_check(r) && gconst_try_read(srcr, r))
+    dirty = 1;
   else
     emith_ctx_read(srcr, r * 4);
 
@@ -1074,8 +1331,8 @@ static int emit_get_rbase_and_offs(u32 a, u32 *offs)
 
   // XXX: could use some related reg
   hr = rcache_get_tmp();
-  emith_ctx_read(hr, poffs);
-  emith_add_r_imm(hr, a & mask & ~0xff);
+  emith_ctx_read_ptr(hr, poffs);
+  emith_add_r_ptr_imm(hr, a & mask & ~0xff);
   *offs = a & 0xff; // XXX: ARM oriented..
   return hr;
 }
@@ -1106,17 +1363,113 @@ static void emit_or_t_if_eq(int srr)
   EMITH_SJMP_END(DCOND_NE);
 }
 
+#if INLINE_RAM_ACCESS
+// SDRAM/data array fast paths, taken if (a & amask) == base.
+// they jump over the handler call, returning the jump to patch
+static void *emit_ram_read(int a, int ret, int tmp, int tmp2, int size,
+  u32 base, u32 amask, u32 mask, int poffs)
+{
+  void *jmp;
+
+  emith_and_r_r_imm(tmp, a, amask | ((1 << size) - 1));
+  emith_cmp_r_imm(tmp, base);
+  EMITH_JMP_START(DCOND_NE);
+  emith_and_r_r_imm(tmp, a, mask);
+  if (size == 0)
+    emith_eor_r_imm(tmp, 1);
+  emith_ctx_read_ptr(tmp2, poffs);
+  emith_add_r_r_ptr(tmp2, tmp);
+  switch (size) {
+  case 0: // 8
+    emith_read8_r_r_offs(ret, tmp2, 0);
+    break;
+  case 1: // 16
+    emith_read16_r_r_offs(ret, tmp2, 0);
+    break;
+  case 2: // 32
+    emith_read_r_r_offs(ret, tmp2, 0);
+    emith_ror(ret, ret, 16);
+    break;
+  }
+  jmp = tcache_ptr;
+  emith_jump_patchable(tcache_ptr);
+  EMITH_JMP_END(DCOND_NE);
+
+  return jmp;
+}
+
+// same for writes, compiled code must be left to the handler for SMC
+static void *emit_ram_write(int a, int d, int tmp, int tmp2, int size,
+  u32 base, u32 amask, u32 mask, int poffs, int blk_poffs)
+{
+  void *jmp;
+
+  emith_and_r_r_imm(tmp, a, amask | ((1 << size) - 1));
+  emith_cmp_r_imm(tmp, base);
+  EMITH_JMP_START(DCOND_NE);
+  emith_and_r_r_imm(tmp, a, mask & ~1);
+  emith_ctx_read_ptr(tmp2, blk_poffs);
+  emith_add_r_r_ptr(tmp2, tmp);
+  if (size == 2)
+    emith_read_r_r_offs(tmp2, tmp2, 0);
+  else
+    emith_read16_r_r_offs(tmp2, tmp2, 0);
+  emith_tst_r_r(tmp2, tmp2);
+  EMITH_JMP_START(DCOND_NE);
+  if (size == 0) {
+    emith_and_r_r_imm(tmp, a, mask);
+    emith_eor_r_imm(tmp, 1);
+  }
+  emith_ctx_read_ptr(tmp2, poffs);
+  emith_add_r_r_ptr(tmp2, tmp);
+  switch (size) {
+  case 0: // 8
+    emith_write8_r_r_offs(d, tmp2, 0);
+    break;
+  case 1: // 16
+    emith_write16_r_r_offs(d, tmp2, 0);
+    break;
+  case 2: // 32
+    emith_ror(d, d, 16);
+    emith_write_r_r_offs(d, tmp2, 0);
+    break;
+  }
+  jmp = tcache_ptr;
+  emith_jump_patchable(tcache_ptr);
+  EMITH_JMP_END(DCOND_NE);
+  EMITH_JMP_END(DCOND_NE);
+
+  return jmp;
+}
+#endif
+
 // arguments must be ready
 // reg cache must be clean before call
 static int emit_memhandler_read_(int size, int ram_check)
 {
-  int arg1;
-#if 0
-  int arg0;
-  host_arg2reg(arg0, 0);
-#endif
+  void *fast_jmp[2] = { NULL, NULL };
+  u32 gcregs_mask;
+  int arg1, i;
 
   rcache_clean();
+  gcregs_mask = dr_gcregs_mask;
+
+#if INLINE_RAM_ACCESS
+  if (dr_hot && ram_check) {
+    int arg0, ret, tmp, tmp2;
+    host_arg2reg(arg0, 0);
+    ret  = rcache_get_tmp_ret();
+    tmp  = rcache_get_tmp();
+    tmp2 = rcache_get_tmp();
+    fast_jmp[0] = emit_ram_read(arg0, ret, tmp, tmp2, size,
+      0x06000000, 0xde000000, 0x3ffff, offsetof(SH2, p_sdram));
+    fast_jmp[1] = emit_ram_read(arg0, ret, tmp, tmp2, size,
+      0xc0000000, 0xfe000000, 0xfff, offsetof(SH2, p_da));
+    rcache_free_tmp(tmp2);
+    rcache_free_tmp(tmp);
+    rcache_free_tmp(ret);
+  }
+#endif
 
   // must writeback cycles for poll detection stuff
   // FIXME: rm
@@ -1124,62 +1477,33 @@ static int emit_memhandler_read_(int size, int ram_check)
     emith_ctx_write(reg_map_g2h[SHR_SR], SHR_SR * 4);
 
   arg1 = rcache_get_tmp_arg(1);
-  emith_move_r_r(arg1, CONTEXT_REG);
-
-#if 0 // can't do this because of unmapped reads
- // ndef PDB_NET
-  if (ram_check && Pico.rom == (void *)0x02000000 && Pico32xMem->sdram == (void *)0x06000000) {
-    int tmp = rcache_get_tmp();
-    emith_and_r_r_imm(tmp, arg0, 0xfb000000);
-    emith_cmp_r_imm(tmp, 0x02000000);
-    switch (size) {
-    case 0: // 8
-      EMITH_SJMP3_START(DCOND_NE);
-      emith_eor_r_imm_c(DCOND_EQ, arg0, 1);
-      emith_read8_r_r_offs_c(DCOND_EQ, arg0, arg0, 0);
-      EMITH_SJMP3_MID(DCOND_NE);
-      emith_call_cond(DCOND_NE, sh2_drc_read8);
-      EMITH_SJMP3_END();
-      break;
-    case 1: // 16
-      EMITH_SJMP3_START(DCOND_NE);
-      emith_read16_r_r_offs_c(DCOND_EQ, arg0, arg0, 0);
-      EMITH_SJMP3_MID(DCOND_NE);
-      emith_call_cond(DCOND_NE, sh2_drc_read16);
-      EMITH_SJMP3_END();
-      break;
-    case 2: // 32
-      EMITH_SJMP3_START(DCOND_NE);
-      emith_read_r_r_offs_c(DCOND_EQ, arg0, arg0, 0);
-      emith_ror_c(DCOND_EQ, arg0, arg0, 16);
-      EMITH_SJMP3_MID(DCOND_NE);
-      emith_call_cond(DCOND_NE, sh2_drc_read32);
-      EMITH_SJMP3_END();
-      break;
-    }
-  }
-  else
-#endif
-  {
-    switch (size) {
-    case 0: // 8
-      emith_call(sh2_drc_read8);
-      break;
-    case 1: // 16
-      emith_call(sh2_drc_read16);
-      break;
-    case 2: // 32
-      emith_call(sh2_drc_read32);
-      break;
-    }
+  emith_move_r_r_ptr(arg1, CONTEXT_REG);
+
+  switch (size) {
+  case 0: // 8
+    emith_call(sh2_drc_read8);
+    break;
+  case 1: // 16
+    emith_call(sh2_drc_read16);
+    break;
+  case 2: // 32
+    emith_call(sh2_drc_read32);
+    break;
   }
   rcache_invalidate();
 
   if (reg_map_g2h[SHR_SR] != -1)
     emith_ctx_read(reg_map_g2h[SHR_SR], SHR_SR * 4);
 
-  // assuming arg0 and retval reg matches
-  return rcache_get_tmp_arg(0);
+  for (i = 0; i < ARRAY_SIZE(fast_jmp); i++)
+    if (fast_jmp[i] != NULL)
+      emith_jump_patch(fast_jmp[i], tcache_ptr);
+
+  // constants were written back above, hot blocks keep them
+  if (dr_hot)
+    dr_gcregs_mask = gcregs_mask;
+
+  return rcache_get_tmp_ret();
 }
 
 static int emit_memhandler_read(int size)
@@ -1233,12 +1557,34 @@ static int emit_memhandler_read_rr(sh2_reg_e rd, sh2_reg_e rs, u32 offs, int siz
 
 static void emit_memhandler_write(int size)
 {
-  int ctxr;
+  void *fast_jmp[2] = { NULL, NULL };
+  u32 gcregs_mask;
+  int ctxr, i;
   host_arg2reg(ctxr, 2);
-  if (reg_map_g2h[SHR_SR] != -1)
-    emith_ctx_write(reg_map_g2h[SHR_SR], SHR_SR * 4);
 
   rcache_clean();
+  gcregs_mask = dr_gcregs_mask;
+
+#if INLINE_RAM_ACCESS
+  if (dr_hot) {
+    int arg0, arg1, tmp, tmp2;
+    host_arg2reg(arg0, 0);
+    host_arg2reg(arg1, 1);
+    tmp  = rcache_get_tmp();
+    tmp2 = rcache_get_tmp();
+    // 8bit writes to the cache-through area have a sync hack
+    fast_jmp[0] = emit_ram_write(arg0, arg1, tmp, tmp2, size, 0x06000000,
+      size == 0 ? 0xfe000000 : 0xde000000, 0x3ffff,
+      offsetof(SH2, p_sdram), offsetof(SH2, p_drcblk_ram));
+    fast_jmp[1] = emit_ram_write(arg0, arg1, tmp, tmp2, size, 0xc0000000,
+      0xfe000000, 0xfff, offsetof(SH2, p_da), offsetof(SH2, p_drcblk_da));
+    rcache_free_tmp(tmp2);
+    rcache_free_tmp(tmp);
+  }
+#endif
+
+  if (reg_map_g2h[SHR_SR] != -1)
+    emith_ctx_write(reg_map_g2h[SHR_SR], SHR_SR * 4);
 
   switch (size) {
   case 0: // 8
@@ -1249,7 +1595,7 @@ static void emit_memhandler_write(int size)
     emith_call(sh2_drc_write16);
     break;
   case 2: // 32
-    emith_move_r_r(ctxr, CONTEXT_REG);
+    emith_move_r_r_ptr(ctxr, CONTEXT_REG);
     emith_call(sh2_drc_write32);
     break;
   }
@@ -1257,6 +1603,13 @@ static void emit_memhandler_write(int size)
   rcache_invalidate();
   if (reg_map_g2h[SHR_SR] != -1)
     emith_ctx_read(reg_map_g2h[SHR_SR], SHR_SR * 4);
+
+  for (i = 0; i < ARRAY_SIZE(fast_jmp); i++)
+    if (fast_jmp[i] != NULL)
+      emith_jump_patch(fast_jmp[i], tcache_ptr);
+
+  if (dr_hot)
+    dr_gcregs_mask = gcregs_mask;
 }
 
 // @(Rx,Ry)
@@ -1321,26 +1674,26 @@ static void emit_do_static_regs(int is_write, int tmpr)
   }
 }
 
+// block ptr is in RET_REG (return value of lookup/translate)
 static void emit_block_entry(void)
 {
-  int arg0;
-
-  host_arg2reg(arg0, 0);
-
 #if (DRC_DEBUG & 8) || defined(PDB)
-  int arg1, arg2;
+  int arg0, arg1, arg2;
+  host_arg2reg(arg0, 0);
   host_arg2reg(arg1, 1);
   host_arg2reg(arg2, 2);
 
   emit_do_static_regs(1, arg2);
-  emith_move_r_r(arg1, CONTEXT_REG);
+  if (arg0 != RET_REG)
+    emith_move_r_r_ptr(arg0, RET_REG);
+  emith_move_r_r_ptr(arg1, CONTEXT_REG);
   emith_move_r_r(arg2, rcache_get_reg(SHR_SR, RC_GR_READ));
   emith_call(sh2_drc_log_entry);
   rcache_invalidate();
 #endif
-  emith_tst_r_r(arg0, arg0);
+  emith_tst_r_r_ptr(RET_REG, RET_REG);
   EMITH_SJMP_START(DCOND_EQ);
-  emith_jump_reg_c(DCOND_NE, arg0);
+  emith_jump_reg_c(DCOND_NE, RET_REG);
   EMITH_SJMP_END(DCOND_EQ);
 }
 
@@ -1358,9 +1711,360 @@ static void emit_block_entry(void)
     cycles = 0; \
   }
 
-static void *dr_get_pc_base(u32 pc, int is_slave);
+// ---------------------------------------------------------------
 
-static void REGPARM(2) *sh2_translate(SH2 *sh2, int tcache_id)
+// hot block analysis
+struct gconst_state {
+  u32 mask;    // R0-R15 with known values
+  u32 vals[16];
+};
+
+// value of a simple ALU insn if its sources are known,
+// returns the dest reg or -1
+static int dr_const_op(int op, u32 mask, const u32 *vals, u32 *val)
+{
+  int n = GET_Rn(), m = GET_Rm();
+  u32 vn = vals[n], vm = vals[m];
+
+  switch (op & 0xf000) {
+  case 0x2000:
+    if ((mask & BITMASK2(n, m)) != BITMASK2(n, m))
+      return -1;
+    switch (op & 0x0f) {
+    case 0x09: // AND    Rm,Rn
+      *val = vn & vm;
+      return n;
+    case 0x0a: // XOR    Rm,Rn
+      *val = vn ^ vm;
+      return n;
+    case 0x0b: // OR     Rm,Rn
+      *val = vn | vm;
+      return n;
+    case 0x0d: // XTRCT  Rm,Rn
+      *val = (vn >> 16) | (vm << 16);
+      return n;
+    }
+    break;
+  case 0x3000:
+    if ((mask & BITMASK2(n, m)) != BITMASK2(n, m))
+      return -1;
+    switch (op & 0x0f) {
+    case 0x08: // SUB    Rm,Rn
+      *val = vn - vm;
+      return n;
+    case 0x0c: // ADD    Rm,Rn
+      *val = vn + vm;
+      return n;
+    }
+    break;
+  case 0x4000:
+    if (!(mask & BITMASK1(n)))
+      return -1;
+    switch (op & 0xff) {
+    case 0x08: // SHLL2  Rn
+      *val = vn << 2;
+      return n;
+    case 0x09: // SHLR2  Rn
+      *val = vn >> 2;
+      return n;
+    case 0x18: // SHLL8  Rn
+      *val = vn << 8;
+      return n;
+    case 0x19: // SHLR8  Rn
+      *val = vn >> 8;
+      return n;
+    case 0x28: // SHLL16 Rn
+      *val = vn << 16;
+      return n;
+    case 0x29: // SHLR16 Rn
+      *val = vn >> 16;
+      return n;
+    }
+    break;
+  case 0x6000:
+    if (!(mask & BITMASK1(m)))
+      return -1;
+    switch (op & 0x0f) {
+    case 0x03: // MOV    Rm,Rn
+      *val = vm;
+      return n;
+    case 0x07: // NOT    Rm,Rn
+      *val = ~vm;
+      return n;
+    case 0x08: // SWAP.B Rm,Rn
+      *val = (vm & 0xffff0000) | ((vm & 0xff) << 8) | ((vm >> 8) & 0xff);
+      return n;
+    case 0x09: // SWAP.W Rm,Rn
+      *val = (vm >> 16) | (vm << 16);
+      return n;
+    case 0x0b: // NEG    Rm,Rn
+      *val = -vm;
+      return n;
+    case 0x0c: // EXTU.B Rm,Rn
+      *val = vm & 0xff;
+      return n;
+    case 0x0d: // EXTU.W Rm,Rn
+      *val = vm & 0xffff;
+      return n;
+    case 0x0e: // EXTS.B Rm,Rn
+      *val = (u32)(int)(signed char)vm;
+      return n;
+    case 0x0f: // EXTS.W Rm,Rn
+      *val = (u32)(int)(signed short)vm;
+      return n;
+    }
+    break;
+  case 0x7000: // ADD #imm,Rn
+    if (!(mask & BITMASK1(n)))
+      return -1;
+    *val = vn + (u32)(int)(signed char)op;
+    return n;
+  case 0xc000:
+    if (!(mask & BITMASK1(SHR_R0)))
+      return -1;
+    switch (op & 0x0f00) {
+    case 0x0900: // AND #imm,R0
+      *val = vals[SHR_R0] & (op & 0xff);
+      return SHR_R0;
+    case 0x0a00: // XOR #imm,R0
+      *val = vals[SHR_R0] ^ (op & 0xff);
+      return SHR_R0;
+    case 0x0b00: // OR  #imm,R0
+      *val = vals[SHR_R0] | (op & 0xff);
+      return SHR_R0;
+    }
+    break;
+  }
+
+  return -1;
+}
+
+// insns that have no effect other than setting T
+static int dr_t_only_op(int op)
+{
+  switch (op & 0xf00f) {
+  case 0x2008: // TST    Rm,Rn
+  case 0x200c: // CMP/STR Rm,Rn
+  case 0x3000: // CMP/EQ Rm,Rn
+  case 0x3002: // CMP/HS Rm,Rn
+  case 0x3003: // CMP/GE Rm,Rn
+  case 0x3006: // CMP/HI Rm,Rn
+  case 0x3007: // CMP/GT Rm,Rn
+    return 1;
+  }
+  switch (op & 0xff00) {
+  case 0x8800: // CMP/EQ #imm,R0
+  case 0xc800: // TST #imm,R0
+    return 1;
+  }
+  switch (op & 0xf0ff) {
+  case 0x4011: // CMP/PZ Rn
+  case 0x4015: // CMP/PL Rn
+    return 1;
+  }
+  return op == 0x0008 || op == 0x0018; // CLRT, SETT
+}
+
+// find the local target of the branch taken after insn i, if any.
+// must match the local branch decisions of sh2_translate_()
+static void dr_find_local_branches(const u8 *op_flags, int i_end,
+  u32 *branch_target_pc, int branch_target_count, s8 *local_target)
+{
+  struct op_data *opd;
+  int i, v, count = 0;
+
+  for (i = 0; i < i_end; i++) {
+    local_target[i] = -1;
+    if (op_flags[i + 1] & OF_DELAY_OP)
+      continue;
+    opd = (op_flags[i] & OF_DELAY_OP) ? &ops[i - 1] : &ops[i];
+    if (opd->op != OP_BRANCH && opd->op != OP_BRANCH_CT
+        && opd->op != OP_BRANCH_CF)
+      continue;
+    v = find_in_array(branch_target_pc, branch_target_count, opd->imm);
+    if (v >= 0 && count < MAX_LOCAL_BRANCHES) {
+      local_target[i] = v;
+      count++;
+    }
+  }
+}
+
+static int dr_gconst_meet(struct gconst_state *t, u8 *visited,
+  const struct gconst_state *st)
+{
+  u32 mask;
+  int r;
+
+  if (!*visited) {
+    *t = *st;
+    *visited = 1;
+    return 1;
+  }
+
+  mask = t->mask & st->mask;
+  for (r = 0; r < ARRAY_SIZE(t->vals); r++)
+    if ((mask & BITMASK1(r)) && t->vals[r] != st->vals[r])
+      mask &= ~BITMASK1(r);
+  if (mask == t->mask)
+    return 0;
+
+  t->mask = mask;
+  return 1;
+}
+
+// find guest regs with values known on all paths to local branch targets.
+// hot blocks have no entries other than the start, so all paths are known
+static void dr_analyse_consts(u16 *dr_pc_base, const u8 *op_flags,
+  int i_end, u32 base_pc, u32 end_literals, u32 *branch_target_pc,
+  int branch_target_count, const s8 *local_target, struct gconst_state *tgt)
+{
+  u8 visited[MAX_LOCAL_BRANCHES];
+  struct gconst_state st;
+  struct op_data *opd;
+  int i, v, n, pass, changed, reachable, literal_count;
+  u32 pc, val;
+  int op;
+
+  memset(visited, 0, sizeof(visited));
+  for (pass = 0; pass < 16; pass++) {
+    changed = 0;
+    reachable = 1;
+    literal_count = 0;
+    st.mask = 0;
+
+    for (i = 0, pc = base_pc; i < i_end; i++, pc += 2) {
+      opd = &ops[i];
+      op = FETCH_OP(pc);
+
+      if (op_flags[i] & OF_BTARGET) {
+        v = find_in_array(branch_target_pc, branch_target_count, pc);
+        if (v < 0) {
+          // only branched to through block exits
+          st.mask = 0;
+          reachable = 1;
+        }
+        else {
+          if (reachable)
+            changed |= dr_gconst_meet(&tgt[v], &visited[v], &st);
+          reachable = visited[v];
+          if (reachable)
+            st = tgt[v];
+        }
+      }
+
+      if (opd->op == OP_LOAD_POOL) {
+        // same literals as the ones sh2_translate_() makes constants
+        if (opd->imm != 0 && opd->imm < end_literals
+            && literal_count < MAX_LITERALS)
+        {
+          literal_count++;
+          if (opd->size == 2)
+            val = FETCH32(opd->imm);
+          else
+            val = (u32)(int)(signed short)FETCH_OP(opd->imm);
+          n = GET_Rn();
+        }
+        else
+          n = -1;
+      }
+      else if (opd->op == OP_MOVA && opd->imm != 0) {
+        val = opd->imm;
+        n = SHR_R0;
+      }
+      else if ((op & 0xf000) == 0xe000) { // MOV #imm,Rn
+        val = (u32)(int)(signed char)op;
+        n = GET_Rn();
+      }
+      else if (opd->op == OP_UNDEFINED) {
+        st.mask = 0;
+        n = -1;
+      }
+      else
+        n = dr_const_op(op, st.mask, st.vals, &val);
+
+      st.mask &= ~opd->dest;
+      if (n >= 0) {
+        st.mask |= BITMASK1(n);
+        st.vals[n] = val;
+      }
+      st.mask &= 0xffff;
+
+      // branches are taken after the delay slot
+      if (local_target[i] >= 0 && reachable)
+        changed |= dr_gconst_meet(&tgt[local_target[i]],
+                     &visited[local_target[i]], &st);
+      if (op_flags[i + 1] & OF_DELAY_OP)
+        continue;
+      if (op_flags[i] & OF_DELAY_OP)
+        opd = &ops[i - 1];
+      if (opd->op == OP_BRANCH || opd->op == OP_BRANCH_R
+          || opd->op == OP_BRANCH_RF || opd->op == OP_RTE
+          || (op & 0xff00) == 0xc300) // TRAPA
+        reachable = 0;
+    }
+
+    if (!changed)
+      break;
+  }
+
+  for (v = 0; v < branch_target_count; v++)
+    if (changed || !visited[v])
+      tgt[v].mask = 0;
+}
+
+// mark insns setting T that is never read afterwards
+static void dr_analyse_t(u8 *op_flags, int i_end, u32 base_pc,
+  u32 *branch_target_pc, int branch_target_count, const s8 *local_target)
+{
+  u8 live_in[MAX_LOCAL_BRANCHES];
+  struct op_data *opd, *opd_b;
+  int i, v, changed, live, out, def;
+  u32 pc;
+
+  memset(live_in, 0, sizeof(live_in));
+  do {
+    changed = 0;
+    live = 1; // leaving the block
+    for (i = i_end - 1, pc = base_pc + i * 2; i >= 0; i--, pc -= 2) {
+      opd = &ops[i];
+      opd_b = (op_flags[i] & OF_DELAY_OP) ? &ops[i - 1] : opd;
+
+      // T after this insn
+      out = live;
+      if (!(op_flags[i + 1] & OF_DELAY_OP)) {
+        if (opd_b->op == OP_BRANCH || opd_b->op == OP_BRANCH_CT
+            || opd_b->op == OP_BRANCH_CF)
+        {
+          v = local_target[i] >= 0 ? live_in[local_target[i]] : 1;
+          out = (opd_b->op == OP_BRANCH) ? v : (live | v);
+        }
+        else if (opd_b->op == OP_BRANCH_R || opd_b->op == OP_BRANCH_RF
+                 || opd_b->op == OP_RTE)
+          out = 1;
+      }
+
+      def = (opd->dest & BITMASK1(SHR_T)) != 0;
+      op_flags[i] &= ~OF_T_DEAD;
+      if (def && !out)
+        op_flags[i] |= OF_T_DEAD;
+
+      live = def ? 0 : out;
+      if ((opd->source & BITMASK1(SHR_T)) || opd->op == OP_UNDEFINED)
+        live = 1;
+
+      if ((op_flags[i] & OF_BTARGET) && live) {
+        v = find_in_array(branch_target_pc, branch_target_count, pc);
+        if (v >= 0 && !live_in[v]) {
+          live_in[v] = 1;
+          changed = 1;
+        }
+      }
+    }
+  } while (changed);
+}
+
+static void *sh2_translate_(SH2 *sh2, int tcache_id,
+  struct block_entry *hot_be)
 {
   u32 branch_target_pc[MAX_LOCAL_BRANCHES];
   void *branch_target_ptr[MAX_LOCAL_BRANCHES];
@@ -1371,6 +2075,8 @@ static void REGPARM(2) *sh2_translate(SH2 *sh2, int tcache_id)
   u32 literal_addr[MAX_LITERALS];
   int literal_addr_count = 0;
   u8 op_flags[BLOCK_INSN_LIMIT];
+  s8 local_target[BLOCK_INSN_LIMIT];
+  struct gconst_state tgt_consts[MAX_LOCAL_BRANCHES];
   struct {
     u32 test_irq:1;
     u32 pending_branch_direct:1;
@@ -1383,6 +2089,7 @@ static void REGPARM(2) *sh2_translate(SH2 *sh2, int tcache_id)
   u32 end_literals;
   void *block_entry_ptr;
   struct block_desc *block;
+  struct block_entry *entry;
   u16 *dr_pc_base;
   struct op_data *opd;
   int blkid_main = 0;
@@ -1392,7 +2099,7 @@ static void REGPARM(2) *sh2_translate(SH2 *sh2, int tcache_id)
   int i, v;
   int op;
 
-  base_pc = sh2->pc;
+  base_pc = hot_be != NULL ? hot_be->pc : sh2->pc;
   drcf.literals_disabled = literal_disabled_frames != 0;
 
   // get base/validate PC
@@ -1407,7 +2114,7 @@ static void REGPARM(2) *sh2_translate(SH2 *sh2, int tcache_id)
 
   // predict tcache overflow
   tmp = tcache_ptr - tcache_bases[tcache_id];
-  if (tmp > tcache_sizes[tcache_id] - MAX_BLOCK_SIZE) {
+  if (tmp > tcache_sizes[tcache_id] - (dr_hot ? MAX_HOT_BLOCK_SIZE : MAX_BLOCK_SIZE)) {
     dbg(1, "tcache %d overflow", tcache_id);
     return NULL;
   }
@@ -1444,6 +2151,18 @@ static void REGPARM(2) *sh2_translate(SH2 *sh2, int tcache_id)
     memset(branch_target_ptr, 0, sizeof(branch_target_ptr[0]) * branch_target_count);
   }
 
+  if (dr_hot) {
+    v = (end_pc - base_pc) / 2;
+    dr_find_local_branches(op_flags, v, branch_target_pc,
+      branch_target_count, local_target);
+#if PROPAGATE_CONSTANTS
+    dr_analyse_consts(dr_pc_base, op_flags, v, base_pc, end_literals,
+      branch_target_pc, branch_target_count, local_target, tgt_consts);
+#endif
+    dr_analyse_t(op_flags, v, base_pc, branch_target_pc,
+      branch_target_count, local_target);
+  }
+
   // clear stale state after compile errors
   rcache_invalidate();
 
@@ -1470,21 +2189,23 @@ static void REGPARM(2) *sh2_translate(SH2 *sh2, int tcache_id)
 
     if ((op_flags[i] & OF_BTARGET) || pc == base_pc)
     {
+      entry = &block->entryp[0];
       if (pc != base_pc)
       {
         sr = rcache_get_reg(SHR_SR, RC_GR_RMW);
         FLUSH_CYCLES(sr);
         rcache_flush();
 
-        // make block entry
+        // make block entry, hot blocks are only entered at the start
+        entry = NULL;
         v = block->entry_count;
-        if (v < ARRAY_SIZE(block->entryp)) {
+        if (!dr_hot && v < ARRAY_SIZE(block->entryp)) {
+          entry = &block->entryp[v];
           block->entryp[v].pc = pc;
           block->entryp[v].tcache_ptr = tcache_ptr;
           block->entryp[v].links = NULL;
-#if (DRC_DEBUG & 2)
           block->entryp[v].block = block;
-#endif
+          block->entryp[v].hits = HOT_BLOCK_THRESHOLD;
           add_to_hashlist(&block->entryp[v], tcache_id);
           block->entry_count++;
 
@@ -1496,11 +2217,24 @@ static void REGPARM(2) *sh2_translate(SH2 *sh2, int tcache_id)
           // that jump to current pc
           dr_link_blocks(&block->entryp[v], tcache_id);
         }
-        else {
+        else if (!dr_hot) {
           dbg(1, "too many entryp for block #%d,%d pc=%08x",
             tcache_id, blkid_main, pc);
         }
 
+#if PROPAGATE_CONSTANTS
+        // values known on all paths here are already in ctx
+        v = find_in_array(branch_target_pc, branch_target_count, pc);
+        if (dr_hot && v >= 0) {
+          for (tmp = 0; tmp < ARRAY_SIZE(tgt_consts[v].vals); tmp++) {
+            if (tgt_consts[v].mask & BITMASK1(tmp)) {
+              dr_gcregs_mask |= BITMASK1(tmp);
+              dr_gcregs[tmp] = tgt_consts[v].vals[tmp];
+            }
+          }
+        }
+#endif
+
         do_host_disasm(tcache_id);
       }
 
@@ -1518,6 +2252,22 @@ static void REGPARM(2) *sh2_translate(SH2 *sh2, int tcache_id)
       emith_jump_cond(DCOND_LE, sh2_drc_exit);
       do_host_disasm(tcache_id);
       rcache_unlock_all();
+
+#if HOT_BLOCKS
+      // count entry runs, recompile as hot block when done
+      if (!dr_hot && entry != NULL) {
+        tmp = rcache_get_tmp_arg(1);
+        tmp2 = rcache_get_tmp();
+        emith_move_r_ptr_imm(tmp, entry);
+        emith_read_r_r_offs(tmp2, tmp, offsetof(struct block_entry, hits));
+        emith_subf_r_imm(tmp2, 1);
+        emith_write_r_r_offs(tmp2, tmp, offsetof(struct block_entry, hits));
+        emith_jump_cond(DCOND_EQ, sh2_drc_hot);
+        rcache_free_tmp(tmp2);
+        rcache_free_tmp(tmp);
+        do_host_disasm(tcache_id);
+      }
+#endif
     }
 
 #ifdef DRC_CMP
@@ -1584,6 +2334,19 @@ static void REGPARM(2) *sh2_translate(SH2 *sh2, int tcache_id)
         dbg(1, "unhandled delay_dep_bk: %x", delay_dep_bk);
     }
 
+#if PROPAGATE_CONSTANTS
+    if (dr_hot) {
+      // fold insns with known source values
+      v = dr_const_op(op, dr_gcregs_mask, dr_gcregs, &tmp);
+      if (v >= 0) {
+        gconst_new(v, tmp);
+        goto end_op;
+      }
+    }
+#endif
+    if ((op_flags[i] & OF_T_DEAD) && dr_t_only_op(op))
+      goto end_op;
+
     switch (opd->op)
     {
     case OP_BRANCH:
@@ -1925,6 +2688,10 @@ static void REGPARM(2) *sh2_translate(SH2 *sh2, int tcache_id)
       case 0x0d: // XTRCT  Rm,Rn        0010nnnnmmmm1101
         tmp  = rcache_get_reg(GET_Rn(), RC_GR_RMW);
         tmp2 = rcache_get_reg(GET_Rm(), RC_GR_READ);
+        if (tmp == tmp2) {
+          emith_ror(tmp, tmp, 16);
+          goto end_op;
+        }
         emith_lsr(tmp, tmp, 16);
         emith_or_r_r_lsl(tmp, tmp2, 16);
         goto end_op;
@@ -2056,6 +2823,13 @@ static void REGPARM(2) *sh2_translate(SH2 *sh2, int tcache_id)
       case 0x0f: // ADDV    Rm,Rn       0011nnnnmmmm1111
         tmp  = rcache_get_reg(GET_Rn(), RC_GR_RMW);
         tmp2 = rcache_get_reg(GET_Rm(), RC_GR_READ);
+        if (op_flags[i] & OF_T_DEAD) {
+          if (op & 4) {
+            emith_add_r_r(tmp, tmp2);
+          } else
+            emith_sub_r_r(tmp, tmp2);
+          goto end_op;
+        }
         sr   = rcache_get_reg(SHR_SR, RC_GR_RMW);
         emith_bic_r_imm(sr, T);
         if (op & 4) {
@@ -2086,28 +2860,45 @@ static void REGPARM(2) *sh2_translate(SH2 *sh2, int tcache_id)
         case 0: // SHLL Rn    0100nnnn00000000
         case 2: // SHAL Rn    0100nnnn00100000
           tmp = rcache_get_reg(GET_Rn(), RC_GR_RMW);
+          if (op_flags[i] & OF_T_DEAD) {
+            emith_lsl(tmp, tmp, 1);
+            goto end_op;
+          }
           sr  = rcache_get_reg(SHR_SR, RC_GR_RMW);
           emith_tpop_carry(sr, 0); // dummy
           emith_lslf(tmp, tmp, 1);
           emith_tpush_carry(sr, 0);
           goto end_op;
         case 1: // DT Rn      0100nnnn00010000
-          sr  = rcache_get_reg(SHR_SR, RC_GR_RMW);
-#if 0 // scheduling needs tuning
-          if (FETCH_OP(pc) == 0x8bfd) { // BF #-2
-            if (gconst_get(GET_Rn(), &tmp)) {
-              // XXX: limit burned cycles
-              emit_move_r_imm32(GET_Rn(), 0);
-              emith_or_r_imm(sr, T);
-              cycles += tmp * 4 + 1; // +1 syncs with noconst version, not sure why
-              skip_op = 1;
-            }
-            else
-              emith_sh2_dtbf_loop();
+          tmp = rcache_get_reg(GET_Rn(), RC_GR_RMW);
+          if (op_flags[i] & OF_T_DEAD) {
+            emith_sub_r_imm(tmp, 1);
             goto end_op;
           }
-#endif
-          tmp = rcache_get_reg(GET_Rn(), RC_GR_RMW);
+          sr  = rcache_get_reg(SHR_SR, RC_GR_RMW);
+          if (dr_hot && (op_flags[i] & OF_BTARGET) && cycles == 0
+              && FETCH_OP(pc) == 0x8bfd) // BF #-2
+          {
+            // delay loop: run all iterations but the last one that
+            // would still start before cycles run out
+            tmp2 = rcache_get_tmp();
+            tmp3 = rcache_get_tmp();
+            emith_asr(tmp2, sr, 12);
+            emith_add_r_imm(tmp2, 3);
+            emith_lsr(tmp2, tmp2, 2);
+            emith_sub_r_imm(tmp2, 1);
+            emith_move_r_r(tmp3, tmp);
+            emith_sub_r_imm(tmp3, 1);
+            emith_cmp_r_r(tmp3, tmp2);
+            EMITH_JMP_START(DCOND_HS);
+            emith_move_r_r(tmp2, tmp3);
+            EMITH_JMP_END(DCOND_HS);
+            emith_sub_r_r(tmp, tmp2);
+            emith_lsl(tmp2, tmp2, 14); // 4 cycles per iteration
+            emith_sub_r_r(sr, tmp2);
+            rcache_free_tmp(tmp3);
+            rcache_free_tmp(tmp2);
+          }
           emith_bic_r_imm(sr, T);
           emith_subf_r_imm(tmp, 1);
           emit_or_t_if_eq(sr);
@@ -2120,6 +2911,13 @@ static void REGPARM(2) *sh2_translate(SH2 *sh2, int tcache_id)
         case 0: // SHLR Rn    0100nnnn00000001
         case 2: // SHAR Rn    0100nnnn00100001
           tmp = rcache_get_reg(GET_Rn(), RC_GR_RMW);
+          if (op_flags[i] & OF_T_DEAD) {
+            if (op & 0x20) {
+              emith_asr(tmp, tmp, 1);
+            } else
+              emith_lsr(tmp, tmp, 1);
+            goto end_op;
+          }
           sr  = rcache_get_reg(SHR_SR, RC_GR_RMW);
           emith_tpop_carry(sr, 0); // dummy
           if (op & 0x20) {
@@ -2180,6 +2978,13 @@ static void REGPARM(2) *sh2_translate(SH2 *sh2, int tcache_id)
         case 0x04: // ROTL   Rn          0100nnnn00000100
         case 0x05: // ROTR   Rn          0100nnnn00000101
           tmp = rcache_get_reg(GET_Rn(), RC_GR_RMW);
+          if (op_flags[i] & OF_T_DEAD) {
+            if (op & 1) {
+              emith_ror(tmp, tmp, 1);
+            } else
+              emith_rol(tmp, tmp, 1);
+            goto end_op;
+          }
           sr  = rcache_get_reg(SHR_SR, RC_GR_RMW);
           emith_tpop_carry(sr, 0); // dummy
           if (op & 1) {
@@ -2795,6 +3600,28 @@ end_op:
 
   do_host_disasm(tcache_id);
 
+  dr_blist_add(base_pc, end_pc - base_pc, sh2->is_slave,
+    dr_hot ? BRF_HOT : 0);
+
+  if (hot_be != NULL) {
+    struct block_link *bl, *bl_next;
+
+    // enter the hot block from the cold entry and the blocks linked to it
+    tcache_ptr = hot_be->tcache_ptr;
+    emith_jump(block_entry_ptr);
+    host_instructions_updated(hot_be->tcache_ptr, tcache_ptr);
+    tcache_ptr = tcache_ptrs[tcache_id];
+
+    for (bl = hot_be->links; bl != NULL; bl = bl_next) {
+      bl_next = bl->next;
+      emith_jump_patch(bl->jump, block_entry_ptr);
+      bl->next = block->entryp[0].links;
+      block->entryp[0].links = bl;
+    }
+    hot_be->links = NULL;
+    block->cold = hot_be->block;
+  }
+
   if (drcf.literals_disabled && literal_addr_count)
     dbg(1, "literals_disabled && literal_addr_count?");
   dbg(2, " block #%d,%d tcache %d/%d, insns %d -> %d %.3f",
@@ -2817,6 +3644,114 @@ end_op:
   return block_entry_ptr;
 }
 
+// translate listed blocks that still match memory
+static void dr_blist_warm(SH2 *sh2, int tcache_id)
+{
+  struct block_entry *be;
+  struct block_rec *rec;
+  u32 pc = sh2->pc, hash;
+  void *block;
+  int i, all, tcid;
+
+  if (blist_budget <= 0)
+    return;
+
+  // the full pass resumes where the last frame's budget ran out
+  all = blist_warm_all[tcache_id];
+  i = all ? blist_warm_pos[tcache_id] : 0;
+  for (; i < blist_count; i++) {
+    rec = &blist[i];
+    if ((rec->flags & BRF_DONE) || (!all && ((rec->pc ^ pc) & ~0xfff)))
+      continue;
+    if (dr_tcache_id(rec->pc, rec->flags & BRF_SLAVE) != tcache_id)
+      continue;
+
+    if (!dr_blist_hash(rec->pc, rec->size, sh2->is_slave, &hash)
+        || hash != rec->hash)
+    {
+      // ROM and BIOS don't change, RAM may get the code later
+      if ((rec->pc & 0xc6000000) != 0x06000000
+          && (rec->pc & 0xfffff000) != 0xc0000000)
+        rec->flags |= BRF_DONE;
+      continue;
+    }
+
+    // leave room for blocks that are actually run
+    if (tcache_ptrs[tcache_id] - tcache_bases[tcache_id] > tcache_sizes[tcache_id] / 2
+        || block_counts[tcache_id] > block_max_counts[tcache_id] / 2
+        || block_link_pool_counts[tcache_id] > block_link_pool_max_counts[tcache_id] / 2)
+    {
+      i = blist_count;
+      break;
+    }
+
+    if (dr_get_entry(rec->pc, sh2->is_slave, &tcid) != NULL) {
+      rec->flags |= BRF_DONE;
+      continue;
+    }
+    if (blist_budget <= 0)
+      break;
+
+    rec->flags |= BRF_DONE;
+    blist_budget--;
+    sh2->pc = rec->pc;
+    block = sh2_translate_(sh2, tcache_id, NULL);
+    sh2->pc = pc;
+    if (block == NULL) {
+      flush_tcache(tcache_id);
+      i = blist_count;
+      break;
+    }
+#if HOT_BLOCKS
+    be = dr_get_entry(rec->pc, sh2->is_slave, &tcid);
+    if ((rec->flags & BRF_HOT) && be != NULL)
+      be->hits = 1;
+#endif
+  }
+
+  if (all) {
+    blist_warm_pos[tcache_id] = i;
+    blist_warm_all[tcache_id] = i < blist_count;
+  }
+}
+
+static void REGPARM(2) *sh2_translate(SH2 *sh2, int tcache_id)
+{
+  struct block_entry *be;
+  int tcid;
+
+  if (blist != NULL) {
+    dr_blist_warm(sh2, tcache_id);
+    be = dr_get_entry(sh2->pc, sh2->is_slave, &tcid);
+    if (be != NULL)
+      return be->tcache_ptr;
+  }
+
+  return sh2_translate_(sh2, tcache_id, NULL);
+}
+
+#if HOT_BLOCKS
+static void REGPARM(2) *dr_hot_block(SH2 *sh2, struct block_entry *be)
+{
+  void *block;
+  int tcache_id;
+
+  if (be->block->entry_count == 0)
+    return NULL;
+
+  dr_get_entry(be->pc, sh2->is_slave, &tcache_id);
+  dbg(2, "hot %csh2 block %08x", sh2->is_slave ? 's' : 'm', be->pc);
+
+  dr_hot = 1;
+  block = sh2_translate_(sh2, tcache_id, be);
+  dr_hot = 0;
+  if (block == NULL)
+    flush_tcache(tcache_id);
+
+  return block;
+}
+#endif
+
 static void sh2_generate_utils(void)
 {
   int arg0, arg1, arg2, sr, tmp;
@@ -2844,24 +3779,34 @@ static void sh2_generate_utils(void)
   rcache_invalidate();
   emith_ctx_read(arg0, SHR_PC * 4);
   emith_ctx_read(arg1, offsetof(SH2, is_slave));
-  emith_add_r_r_imm(arg2, CONTEXT_REG, offsetof(SH2, drc_tmp));
+  emith_add_r_r_ptr_imm(arg2, CONTEXT_REG, offsetof(SH2, drc_tmp));
   emith_call(dr_lookup_block);
   emit_block_entry();
   // lookup failed, call sh2_translate()
-  emith_move_r_r(arg0, CONTEXT_REG);
+  emith_move_r_r_ptr(arg0, CONTEXT_REG);
   emith_ctx_read(arg1, offsetof(SH2, drc_tmp)); // tcache_id
   emith_call(sh2_translate);
   emit_block_entry();
   // sh2_translate() failed, flush cache and retry
   emith_ctx_read(arg0, offsetof(SH2, drc_tmp));
   emith_call(flush_tcache);
-  emith_move_r_r(arg0, CONTEXT_REG);
+  emith_move_r_r_ptr(arg0, CONTEXT_REG);
   emith_ctx_read(arg1, offsetof(SH2, drc_tmp));
   emith_call(sh2_translate);
   emit_block_entry();
   // XXX: can't translate, fail
   emith_call(dr_failure);
 
+#if HOT_BLOCKS
+  // sh2_drc_hot(void), arg1 = block entry
+  // recompile the block entered as hot block and run it
+  sh2_drc_hot = (void *)tcache_ptr;
+  emith_move_r_r_ptr(arg0, CONTEXT_REG);
+  emith_call(dr_hot_block);
+  emit_block_entry();
+  emith_jump(sh2_drc_dispatcher);
+#endif
+
   // sh2_drc_test_irq(void)
   // assumes it's called from main function (may jump to dispatcher)
   sh2_drc_test_irq = (void *)tcache_ptr;
@@ -2873,6 +3818,10 @@ static void sh2_generate_utils(void)
   EMITH_SJMP_START(DCOND_GT);
   emith_ret_c(DCOND_LE);     // nope, return
   EMITH_SJMP_END(DCOND_GT);
+#if defined(__i386__) || defined(__x86_64__)
+  // not returning, drop return address (also realigns x86-64 stack)
+  emith_add_r_ptr_imm(xSP, PTR_SIZE);
+#endif
   // adjust SP
   tmp = rcache_get_reg(SHR_SP, RC_GR_RMW);
   emith_sub_r_imm(tmp, 4*2);
@@ -2882,13 +3831,13 @@ static void sh2_generate_utils(void)
   emith_add_r_imm(tmp, 4);
   tmp = rcache_get_reg_arg(1, SHR_SR);
   emith_clear_msb(tmp, tmp, 22);
-  emith_move_r_r(arg2, CONTEXT_REG);
+  emith_move_r_r_ptr(arg2, CONTEXT_REG);
   emith_call(p32x_sh2_write32); // XXX: use sh2_drc_write32?
   rcache_invalidate();
   // push PC
   rcache_get_reg_arg(0, SHR_SP);
   emith_ctx_read(arg1, SHR_PC * 4);
-  emith_move_r_r(arg2, CONTEXT_REG);
+  emith_move_r_r_ptr(arg2, CONTEXT_REG);
   emith_call(p32x_sh2_write32);
   rcache_invalidate();
   // update I, cycles, do callback
@@ -2898,36 +3847,33 @@ static void sh2_generate_utils(void)
   emith_or_r_r_lsl(sr, arg1, I_SHIFT);
   emith_sub_r_imm(sr, 13 << 12); // at least 13 cycles
   rcache_flush();
-  emith_move_r_r(arg0, CONTEXT_REG);
+  emith_move_r_r_ptr(arg0, CONTEXT_REG);
   emith_call_ctx(offsetof(SH2, irq_callback)); // vector = sh2->irq_callback(sh2, level);
   // obtain new PC
-  emith_lsl(arg0, arg0, 2);
+  emith_lsl(arg0, RET_REG, 2);
   emith_ctx_read(arg1, SHR_VBR * 4);
   emith_add_r_r(arg0, arg1);
-  emit_memhandler_read(2);
-  emith_ctx_write(arg0, SHR_PC * 4);
-#ifdef __i386__
-  emith_add_r_imm(xSP, 4); // fix stack
-#endif
+  tmp = emit_memhandler_read(2);
+  emith_ctx_write(tmp, SHR_PC * 4);
   emith_jump(sh2_drc_dispatcher);
   rcache_invalidate();
 
   // sh2_drc_entry(SH2 *sh2)
   sh2_drc_entry = (void *)tcache_ptr;
   emith_sh2_drc_entry();
-  emith_move_r_r(CONTEXT_REG, arg0); // move ctx, arg0
+  emith_move_r_r_ptr(CONTEXT_REG, arg0); // move ctx, arg0
   emit_do_static_regs(0, arg2);
   emith_call(sh2_drc_test_irq);
   emith_jump(sh2_drc_dispatcher);
 
   // sh2_drc_write8(u32 a, u32 d)
   sh2_drc_write8 = (void *)tcache_ptr;
-  emith_ctx_read(arg2, offsetof(SH2, write8_tab));
+  emith_ctx_read_ptr(arg2, offsetof(SH2, write8_tab));
   emith_sh2_wcall(arg0, arg2);
 
   // sh2_drc_write16(u32 a, u32 d)
   sh2_drc_write16 = (void *)tcache_ptr;
-  emith_ctx_read(arg2, offsetof(SH2, write16_tab));
+  emith_ctx_read_ptr(arg2, offsetof(SH2, write16_tab));
   emith_sh2_wcall(arg0, arg2);
 
 #ifdef PDB_NET
@@ -2937,7 +3883,7 @@ static void sh2_generate_utils(void)
     emith_push_ret(); \
     emith_call(func); \
     emith_ctx_read(arg2, offsetof(SH2, pdb_io_csum[0]));  \
-    emith_addf_r_r(arg2, arg0);                           \
+    emith_addf_r_r(arg2, RET_REG);                        \
     emith_ctx_write(arg2, offsetof(SH2, pdb_io_csum[0])); \
     emith_ctx_read(arg2, offsetof(SH2, pdb_io_csum[1]));  \
     emith_adc_r_imm(arg2, 0x01000000);                    \
@@ -2953,7 +3899,7 @@ static void sh2_generate_utils(void)
     emith_ctx_read(arg2, offsetof(SH2, pdb_io_csum[1]));  \
     emith_adc_r_imm(arg2, 0x01000000);                    \
     emith_ctx_write(arg2, offsetof(SH2, pdb_io_csum[1])); \
-    emith_move_r_r(arg2, CONTEXT_REG);                    \
+    emith_move_r_r_ptr(arg2, CONTEXT_REG);                \
     emith_jump(func); \
     func = tmp; \
   }
@@ -2986,6 +3932,7 @@ static void sh2_generate_utils(void)
 static void sh2_smc_rm_block_entry(struct block_desc *bd, int tcache_id, u32 ram_mask)
 {
   struct block_link *bl, *bl_next, *bl_unresolved;
+  struct block_desc *cold;
   u32 i, addr, end_addr;
   void *tmp;
 
@@ -3007,6 +3954,7 @@ static void sh2_smc_rm_block_entry(struct block_desc *bd, int tcache_id, u32 ram
 
   tmp = tcache_ptr;
   bl_unresolved = unresolved_links[tcache_id];
+  cold = bd->cold;
 
   // remove from hash table, make incoming links unresolved
   // XXX: maybe patch branches w/flush instead?
@@ -3035,6 +3983,11 @@ static void sh2_smc_rm_block_entry(struct block_desc *bd, int tcache_id, u32 ram
 
   bd->addr = bd->size = bd->size_nolit = 0;
   bd->entry_count = 0;
+  bd->cold = NULL;
+
+  // the cold block enters this one
+  if (cold != NULL && cold->entry_count != 0)
+    sh2_smc_rm_block_entry(cold, tcache_id, ram_mask);
 }
 
 static void sh2_smc_rm_block(u32 a, u16 *drc_ram_blk, int tcache_id, u32 shift, u32 mask)
@@ -3184,12 +4137,15 @@ void sh2_drc_mem_setup(SH2 *sh2)
   sh2->p_da = sh2->data_array;
   sh2->p_sdram = Pico32xMem->sdram;
   sh2->p_rom = Pico.rom;
+  sh2->p_drcblk_da = Pico32xMem->drcblk_da[sh2->is_slave];
+  sh2->p_drcblk_ram = Pico32xMem->drcblk_ram;
 }
 
 void sh2_drc_frame(void)
 {
   if (literal_disabled_frames > 0)
     literal_disabled_frames--;
+  blist_budget = BLIST_FRAME_BLOCKS;
 }
 
 int sh2_drc_init(SH2 *sh2)
@@ -3220,7 +4176,8 @@ int sh2_drc_init(SH2 *sh2)
     memset(block_counts, 0, sizeof(block_counts));
     memset(block_link_pool_counts, 0, sizeof(block_link_pool_counts));
 
-    drc_cmn_init();
+    if (drc_cmn_init() != 0)
+      goto fail;
     tcache_ptr = tcache;
     sh2_generate_utils();
     host_instructions_updated(tcache, tcache_ptr);
@@ -3268,11 +4225,11 @@ void sh2_drc_finish(SH2 *sh2)
     if (block_tables[i] != NULL)
       free(block_tables[i]);
     block_tables[i] = NULL;
-    if (block_link_pool[i] == NULL)
+    if (block_link_pool[i] != NULL)
       free(block_link_pool[i]);
     block_link_pool[i] = NULL;
 
-    if (inval_lookup[i] == NULL)
+    if (inval_lookup[i] != NULL)
       free(inval_lookup[i]);
     inval_lookup[i] = NULL;
 
@@ -3285,6 +4242,41 @@ void sh2_drc_finish(SH2 *sh2)
   drc_cmn_cleanup();
 }
 
+// per emulator instance, tcache itself is switched by cmn.c
+const struct pico_ctx_area ctx_areas_sh2_drc[] = {
+  PICO_CTX_AREA(tcache_bases),
+  PICO_CTX_AREA(tcache_ptrs),
+  PICO_CTX_AREA(block_tables),
+  PICO_CTX_AREA(block_counts),
+  PICO_CTX_AREA(block_link_pool),
+  PICO_CTX_AREA(block_link_pool_counts),
+  PICO_CTX_AREA(unresolved_links),
+  PICO_CTX_AREA(inval_lookup),
+  PICO_CTX_AREA(hash_tables),
+  PICO_CTX_AREA(literal_disabled_frames),
+  PICO_CTX_AREA(sh2_drc_entry),
+  PICO_CTX_AREA(sh2_drc_dispatcher),
+  PICO_CTX_AREA(sh2_drc_exit),
+  PICO_CTX_AREA(sh2_drc_test_irq),
+  PICO_CTX_AREA(sh2_drc_hot),
+  PICO_CTX_AREA(sh2_drc_read8),
+  PICO_CTX_AREA(sh2_drc_read16),
+  PICO_CTX_AREA(sh2_drc_read32),
+  PICO_CTX_AREA(sh2_drc_write8),
+  PICO_CTX_AREA(sh2_drc_write16),
+  PICO_CTX_AREA(sh2_drc_write32),
+  PICO_CTX_AREA(blist),
+  PICO_CTX_AREA(blist_count),
+  PICO_CTX_AREA(blist_head),
+  PICO_CTX_AREA(blist_next),
+  PICO_CTX_AREA(blist_warm_all),
+  PICO_CTX_AREA(blist_warm_pos),
+  PICO_CTX_AREA(blist_budget),
+  PICO_CTX_AREA(blist_rom_crc),
+  PICO_CTX_AREA(blist_fname),
+  PICO_CTX_AREA_END
+};
+
 #endif /* DRC_SH2 */
 
 static void *dr_get_pc_base(u32 pc, int is_slave)
@@ -3420,7 +4412,7 @@ void scan_block(u32 base_pc, int is_slave, u8 *op_flags, u32 *end_pc_out,
           opd->imm = 1;
           break;
         case 2: // CLRMAC             0000000000101000
-          opd->dest = BITMASK3(SHR_T, SHR_MACL, SHR_MACH);
+          opd->dest = BITMASK2(SHR_MACL, SHR_MACH);
           break;
         default:
           goto undefined;
@@ -3483,7 +4475,7 @@ void scan_block(u32 base_pc, int is_slave, u8 *op_flags, u32 *end_pc_out,
         case 2: // RTE        0000000000101011
           opd->op = OP_RTE;
           opd->source = BITMASK1(SHR_SP);
-          opd->dest = BITMASK2(SHR_SR, SHR_PC);
+          opd->dest = BITMASK3(SHR_SR, SHR_PC, SHR_SP);
           opd->cycles = 4;
           next_is_delay = 1;
           end_block = 1;
@@ -3972,8 +4964,8 @@ void scan_block(u32 base_pc, int is_slave, u8 *op_flags, u32 *end_pc_out,
         opd->imm = (op & 0xff) << opd->size;
         break;
       case 0x0300: // TRAPA #imm      11000011iiiiiiii
-        opd->source = BITMASK2(SHR_PC, SHR_SR);
-        opd->dest = BITMASK1(SHR_PC);
+        opd->source = BITMASK3(SHR_SP, SHR_PC, SHR_SR);
+        opd->dest = BITMASK2(SHR_SP, SHR_PC);
         opd->imm = (op & 0xff) * 4;
         opd->cycles = 8;
         end_block = 1; // FIXME
@@ -4058,6 +5050,7 @@ void scan_block(u32 base_pc, int is_slave, u8 *op_flags, u32 *end_pc_out,
 
     default:
     undefined:
+      opd->op = OP_UNDEFINED;
       elprintf(EL_ANOMALY, "%csh2 drc: unhandled op %04x @ %08x",
         is_slave ? 's' : 'm', op, pc);
       break;
@@ -7,10 +7,14 @@ void sh2_drc_wcheck_da(unsigned int a, int val, int cpuid);
 void sh2_drc_mem_setup(SH2 *sh2);
 void sh2_drc_flush_all(void);
 void sh2_drc_frame(void);
+int  sh2_drc_blist_load(const char *fname, unsigned int rom_crc);
+void sh2_drc_blist_save(void);
 #else
 #define sh2_drc_mem_setup(x)
 #define sh2_drc_flush_all()
 #define sh2_drc_frame()
+#define sh2_drc_blist_load(fname, rom_crc) 0
+#define sh2_drc_blist_save()
 #endif
 
 #define BLOCK_INSN_LIMIT 128
@@ -20,6 +24,7 @@ void sh2_drc_frame(void);
 #define OF_BTARGET    (1 << 1)
 #define OF_T_SET      (1 << 2) // T is known to be set
 #define OF_T_CLEAR    (1 << 3) // ... clear
+#define OF_T_DEAD     (1 << 4) // T set by this insn is never read
 
 void scan_block(unsigned int base_pc, int is_slave,
 		unsigned char *op_flags, unsigned int *end_pc,
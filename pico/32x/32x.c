@@ -8,6 +8,7 @@
 #include "../pico_int.h"
 #include "../sound/ym2612.h"
 #include "../../cpu/sh2/compiler.h"
+#include "../../zlib/zlib.h"
 
 struct Pico32x Pico32x;
 SH2 sh2s[2];
@@ -94,16 +95,41 @@ void p32x_update_cmd_irq(SH2 *sh2, int m68k_cycles)
   p32x_update_irls(sh2, m68k_cycles);
 }
 
+static char p32x_cache_dir[256];
+
+void Pico32xSetCacheDir(const char *dir)
+{
+  snprintf(p32x_cache_dir, sizeof(p32x_cache_dir), "%s", dir ? dir : "");
+}
+
+// POPT_EN_DRC_CACHE: one block list file per ROM
+static void p32x_drc_blist_load(void)
+{
+#ifdef DRC_SH2
+  char fname[sizeof(p32x_cache_dir) + 16];
+  unsigned int crc;
+
+  if (!(PicoOpt & POPT_EN_DRC_CACHE))
+    return;
+
+  crc = crc32(0, Pico.rom, Pico.romsize);
+  snprintf(fname, sizeof(fname), "%ssh2_%08x.blk", p32x_cache_dir, crc);
+  sh2_drc_blist_load(fname, crc);
+#endif
+}
+
 void Pico32xStartup(void)
 {
   elprintf(EL_STATUS|EL_32X, "32X startup");
 
   // TODO: OOM handling
   PicoAHW |= PAHW_32X;
+  PicoContextDrcClaim();
   sh2_init(&msh2, 0, &ssh2);
   msh2.irq_callback = sh2_irq_cb;
   sh2_init(&ssh2, 1, &msh2);
   ssh2.irq_callback = sh2_irq_cb;
+  p32x_drc_blist_load();
 
   PicoMemSetup32x();
   p32x_pwm_ctl_changed();
@@ -194,6 +220,8 @@ void PicoUnload32x(void)
   if (Pico32xMem != NULL)
     plat_munmap(Pico32xMem, sizeof(*Pico32xMem));
   Pico32xMem = NULL;
+  PicoContextDrcClaim();
+  sh2_drc_blist_save();
   sh2_finish(&msh2);
   sh2_finish(&ssh2);
 
@@ -234,7 +262,7 @@ static void p32x_start_blank(void)
       // we draw full layer (not line-by-line)
       PicoDraw32xLayer(offs, lines, md_bg);
     }
-    else if (Pico32xDrawMode != PDM32X_32X_ONLY)
+    else if (Pico32xDrawMode == PDM32X_BOTH)
       PicoDraw32xLayerMdOnly(offs, lines);
 
     pprof_end(draw);
@@ -373,7 +401,15 @@ static inline void run_sh2(SH2 *sh2, int m68k_cycles)
   elprintf_sh2(sh2, EL_32X, "+run %u %d @%08x",
     sh2->m68krcycles_done, cycles, sh2->pc);
 
-  done = sh2_execute(sh2, cycles, PicoOpt & POPT_EN_DRC);
+  if (sh2->is_slave) {
+    pprof_start(ssh2);
+    done = sh2_execute(sh2, cycles, PicoOpt & POPT_EN_DRC);
+    pprof_end(ssh2);
+  } else {
+    pprof_start(msh2);
+    done = sh2_execute(sh2, cycles, PicoOpt & POPT_EN_DRC);
+    pprof_end(msh2);
+  }
 
   sh2->m68krcycles_done += C_SH2_TO_M68K(*sh2, done);
   sh2->state &= ~SH2_STATE_RUN;
@@ -405,7 +441,16 @@ void p32x_sync_other_sh2(SH2 *sh2, unsigned int m68k_target)
   elprintf_sh2(osh2, EL_32X, "sync to %u %d",
     m68k_target, m68k_cycles);
 
-  run_sh2(osh2, m68k_cycles);
+  // don't count the other sh2 for this one
+  if (sh2->is_slave) {
+    pprof_start(ssh2);
+    run_sh2(osh2, m68k_cycles);
+    pprof_end_sub(ssh2);
+  } else {
+    pprof_start(msh2);
+    run_sh2(osh2, m68k_cycles);
+    pprof_end_sub(msh2);
+  }
 
   // there might be new event to schedule current sh2 to
   if (event_time_next) {
@@ -587,4 +632,9 @@ void Pico32xStateLoaded(int is_early)
   p32x_run_events(SekCyclesDone());
 }
 
+const struct pico_ctx_area ctx_areas_32x[] = {
+  PICO_CTX_AREA(event_time_next),
+  PICO_CTX_AREA_END
+};
+
 // vim:shiftwidth=2:ts=2:expandtab
@@ -11,6 +11,16 @@ int (*PicoScan32xBegin)(unsigned int num);
 int (*PicoScan32xEnd)(unsigned int num);
 int Pico32xDrawMode;
 
+// pixels are made as RGB565, PX() converts them for the output
+#define PX(t) (t)
+
+static inline unsigned int px565_8888(unsigned int t)
+{
+  unsigned int r = t >> 11, g = (t >> 5) & 0x3f, b = t & 0x1f;
+  return (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8)
+    | (b << 3) | (b >> 2);
+}
+
 static void convert_pal555(int invert_prio)
 {
   unsigned int *ps = (void *)Pico32xMem->pal;
@@ -48,7 +58,7 @@ static void convert_pal555(int invert_prio)
       continue;                                                   \
     }                                                             \
                                                                   \
-    *pd = ((t & m1) << 11) | ((t & m2) << 1) | ((t & m3) >> 10);  \
+    *pd = PX(((t & m1) << 11) | ((t & m2) << 1) | ((t & m3) >> 10)); \
   }                                                               \
 }
 
@@ -60,7 +70,7 @@ static void convert_pal555(int invert_prio)
   for (i = 320; i > 0; i--, pd++, p32x++, pmd++) {                \
     t = pal[*(unsigned char *)((long)p32x ^ 1)];                  \
     if ((t & 0x20) || (*pmd & 0x3f) == mdbg)                      \
-      *pd = t;                                                    \
+      *pd = PX(t);                                                \
     else                                                          \
       pmd_draw_code;                                              \
   }                                                               \
@@ -75,7 +85,7 @@ static void convert_pal555(int invert_prio)
     t = pal[*p32x & 0xff];                                        \
     for (len = (*p32x >> 8) + 1; len > 0 && i > 0; len--, i--, pd++, pmd++) { \
       if ((*pmd & 0x3f) == mdbg || (t & 0x20))                    \
-        *pd = t;                                                  \
+        *pd = PX(t);                                              \
       else                                                        \
         pmd_draw_code;                                            \
     }                                                             \
@@ -135,15 +145,16 @@ void FinalizeLine32xRGB555(int sh, int line)
 #define PICOSCAN_POST \
   PicoScan32xEnd(l + (lines_sft_offs & 0xff)); \
 
-#define make_do_loop(name, pre_code, post_code, md_code)        \
+#define make_do_loop_c(name, pixel_t, palmd_src,                \
+    pre_code, post_code, md_code)                               \
 /* Direct Color Mode */                                         \
-static void do_loop_dc##name(unsigned short *dst,               \
+static void do_loop_dc##name(pixel_t *dst,                      \
     unsigned short *dram, int lines_sft_offs, int mdbg)         \
 {                                                               \
   int inv_bit = (Pico32x.vdp_regs[0] & P32XV_PRI) ? 0x8000 : 0; \
   unsigned char  *pmd = PicoDraw2FB +                           \
                           328 * (lines_sft_offs & 0xff) + 8;    \
-  unsigned short *palmd = HighPal;                              \
+  pixel_t *palmd = palmd_src;                                   \
   unsigned short *p32x;                                         \
   int lines = lines_sft_offs >> 16;                             \
   int l;                                                        \
@@ -157,13 +168,13 @@ static void do_loop_dc##name(unsigned short *dst,               \
 }                                                               \
                                                                 \
 /* Packed Pixel Mode */                                         \
-static void do_loop_pp##name(unsigned short *dst,               \
+static void do_loop_pp##name(pixel_t *dst,                      \
     unsigned short *dram, int lines_sft_offs, int mdbg)         \
 {                                                               \
   unsigned short *pal = Pico32xMem->pal_native;                 \
   unsigned char  *pmd = PicoDraw2FB +                           \
                           328 * (lines_sft_offs & 0xff) + 8;    \
-  unsigned short *palmd = HighPal;                              \
+  pixel_t *palmd = palmd_src;                                   \
   unsigned char  *p32x;                                         \
   int lines = lines_sft_offs >> 16;                             \
   int l;                                                        \
@@ -178,13 +189,13 @@ static void do_loop_pp##name(unsigned short *dst,               \
 }                                                               \
                                                                 \
 /* Run Length Mode */                                           \
-static void do_loop_rl##name(unsigned short *dst,               \
+static void do_loop_rl##name(pixel_t *dst,                      \
     unsigned short *dram, int lines_sft_offs, int mdbg)         \
 {                                                               \
   unsigned short *pal = Pico32xMem->pal_native;                 \
   unsigned char  *pmd = PicoDraw2FB +                           \
                           328 * (lines_sft_offs & 0xff) + 8;    \
-  unsigned short *palmd = HighPal;                              \
+  pixel_t *palmd = palmd_src;                                   \
   unsigned short *p32x;                                         \
   int lines = lines_sft_offs >> 16;                             \
   int l;                                                        \
@@ -197,6 +208,9 @@ static void do_loop_rl##name(unsigned short *dst,               \
   }                                                             \
 }
 
+#define make_do_loop(name, pre_code, post_code, md_code)        \
+  make_do_loop_c(name, unsigned short, HighPal, pre_code, post_code, md_code)
+
 #ifdef _ASM_32X_DRAW
 #undef make_do_loop
 #define make_do_loop(name, pre_code, post_code, md_code) \
@@ -213,6 +227,12 @@ make_do_loop(_md, , , MD_LAYER_CODE)
 make_do_loop(_scan, PICOSCAN_PRE, PICOSCAN_POST, )
 make_do_loop(_scan_md, PICOSCAN_PRE, PICOSCAN_POST, MD_LAYER_CODE)
 
+// XRGB8888, MD pixels are already there from FinalizeLine8888
+#undef PX
+#define PX(t) px565_8888(t)
+make_do_loop_c(_8888, unsigned int, HighPal32, , , )
+make_do_loop_c(_scan_8888, unsigned int, HighPal32, PICOSCAN_PRE, PICOSCAN_POST, )
+
 typedef void (*do_loop_func)(unsigned short *dst, unsigned short *dram, int lines, int mdbg);
 enum { DO_LOOP, DO_LOOP_MD, DO_LOOP_SCAN, DO_LOOP_MD_SCAN };
 
@@ -220,10 +240,17 @@ static const do_loop_func do_loop_dc_f[] = { do_loop_dc, do_loop_dc_md, do_loop_
 static const do_loop_func do_loop_pp_f[] = { do_loop_pp, do_loop_pp_md, do_loop_pp_scan, do_loop_pp_scan_md };
 static const do_loop_func do_loop_rl_f[] = { do_loop_rl, do_loop_rl_md, do_loop_rl_scan, do_loop_rl_scan_md };
 
+typedef void (*do_loop_func_8888)(unsigned int *dst, unsigned short *dram, int lines, int mdbg);
+
+static const do_loop_func_8888 do_loop_dc_f_8888[] = { do_loop_dc_8888, do_loop_dc_scan_8888 };
+static const do_loop_func_8888 do_loop_pp_f_8888[] = { do_loop_pp_8888, do_loop_pp_scan_8888 };
+static const do_loop_func_8888 do_loop_rl_f_8888[] = { do_loop_rl_8888, do_loop_rl_scan_8888 };
+
 void PicoDraw32xLayer(int offs, int lines, int md_bg)
 {
   int have_scan = PicoScan32xBegin != NULL && PicoScan32xEnd != NULL;
   const do_loop_func *do_loop;
+  const do_loop_func_8888 *do_loop_8888;
   unsigned short *dram;
   int lines_sft_offs;
   int which_func;
@@ -240,6 +267,7 @@ void PicoDraw32xLayer(int offs, int lines, int md_bg)
   {
     // Direct Color Mode
     do_loop = do_loop_dc_f;
+    do_loop_8888 = do_loop_dc_f_8888;
     goto do_it;
   }
 
@@ -250,21 +278,29 @@ void PicoDraw32xLayer(int offs, int lines, int md_bg)
   {
     // Packed Pixel Mode
     do_loop = do_loop_pp_f;
+    do_loop_8888 = do_loop_pp_f_8888;
   }
   else
   {
     // Run Length Mode
     do_loop = do_loop_rl_f;
+    do_loop_8888 = do_loop_rl_f_8888;
   }
 
 do_it:
+  lines_sft_offs = (lines << 16) | offs;
+  if (Pico32x.vdp_regs[2 / 2] & P32XV_SFT)
+    lines_sft_offs |= 1 << 8;
+
+  if (Pico32xDrawMode == PDM32X_32X_ONLY_8888) {
+    do_loop_8888[have_scan](DrawLineDest, dram, lines_sft_offs, md_bg);
+    return;
+  }
+
   if (Pico32xDrawMode == PDM32X_BOTH)
     which_func = have_scan ? DO_LOOP_MD_SCAN : DO_LOOP_MD;
   else
     which_func = have_scan ? DO_LOOP_SCAN : DO_LOOP;
-  lines_sft_offs = (lines << 16) | offs;
-  if (Pico32x.vdp_regs[2 / 2] & P32XV_SFT)
-    lines_sft_offs |= 1 << 8;
 
   do_loop[which_func](DrawLineDest, dram, lines_sft_offs, md_bg);
 }
@@ -323,7 +359,10 @@ void PicoDrawSetOutFormat32x(pdso_t which, int use_32x_line_mode)
 
   // use the same layout as alt renderer
   PicoDrawSetInternalBuf(PicoDraw2FB, 328);
-  Pico32xDrawMode = (which == PDF_RGB555) ? PDM32X_32X_ONLY : PDM32X_BOTH;
+  if (which == PDF_XRGB8888)
+    Pico32xDrawMode = PDM32X_32X_ONLY_8888;
+  else
+    Pico32xDrawMode = (which == PDF_RGB555) ? PDM32X_32X_ONLY : PDM32X_BOTH;
 }
 
 // vim:shiftwidth=2:ts=2:expandtab
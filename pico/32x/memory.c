@@ -178,6 +178,14 @@ static u32 sh2_comm_faker(u32 a)
 // ------------------------------------------------------------------
 // 68k regs
 
+// from 68k handlers, sh2 run time isn't 68k time for pprof
+static void m68k_sync_sh2s(unsigned int cycles)
+{
+  pprof_start(m68k);
+  p32x_sync_sh2s(cycles);
+  pprof_end_sub(m68k);
+}
+
 static u32 p32x_reg_read16(u32 a)
 {
   a &= 0x3e;
@@ -192,7 +200,7 @@ static u32 p32x_reg_read16(u32 a)
 
     if (cycles - msh2.m68krcycles_done > 244
         || (Pico32x.comm_dirty_68k & comreg))
-      p32x_sync_sh2s(cycles);
+      m68k_sync_sh2s(cycles);
 
     if (Pico32x.comm_dirty_sh2 & comreg)
       Pico32x.comm_dirty_sh2 &= ~comreg;
@@ -207,7 +215,7 @@ static u32 p32x_reg_read16(u32 a)
   if (a == 2) { // INTM, INTS
     unsigned int cycles = SekCyclesDone();
     if (cycles - msh2.m68krcycles_done > 64)
-      p32x_sync_sh2s(cycles);
+      m68k_sync_sh2s(cycles);
     goto out;
   }
 
@@ -235,7 +243,7 @@ static void dreq0_write(u16 *r, u32 d)
       r[6 / 2] &= ~P32XS_68S;
 
     if ((Pico32x.dmac0_fifo_ptr & 3) == 0) {
-      p32x_sync_sh2s(SekCyclesDone());
+      m68k_sync_sh2s(SekCyclesDone());
       p32x_dreq0_trigger();
     }
   }
@@ -267,7 +275,7 @@ static void p32x_reg_write8(u32 a, u32 d)
     case 0x03: // irq ctl
       if ((d ^ r[0x02 / 2]) & 3) {
         int cycles = SekCyclesDone();
-        p32x_sync_sh2s(cycles);
+        m68k_sync_sh2s(cycles);
         r[0x02 / 2] = d & 3;
         p32x_update_cmd_irq(NULL, cycles);
       }
@@ -390,7 +398,7 @@ static void p32x_reg_write8(u32 a, u32 d)
 
     comreg = 1 << (a & 0x0f) / 2;
     if (Pico32x.comm_dirty_68k & comreg)
-      p32x_sync_sh2s(cycles);
+      m68k_sync_sh2s(cycles);
 
     REG8IN16(r, a) = d;
     p32x_sh2_poll_event(&sh2s[0], SH2_STATE_CPOLL, cycles);
@@ -398,7 +406,7 @@ static void p32x_reg_write8(u32 a, u32 d)
     Pico32x.comm_dirty_68k |= comreg;
 
     if (cycles - (int)msh2.m68krcycles_done > 120)
-      p32x_sync_sh2s(cycles);
+      m68k_sync_sh2s(cycles);
     return;
   }
 }
@@ -456,7 +464,7 @@ static void p32x_reg_write16(u32 a, u32 d)
 
     comreg = 1 << (a & 0x0f) / 2;
     if (Pico32x.comm_dirty_68k & comreg)
-      p32x_sync_sh2s(cycles);
+      m68k_sync_sh2s(cycles);
 
     r[a / 2] = d;
     p32x_sh2_poll_event(&sh2s[0], SH2_STATE_CPOLL, cycles);
@@ -464,7 +472,7 @@ static void p32x_reg_write16(u32 a, u32 d)
     Pico32x.comm_dirty_68k |= comreg;
 
     if (cycles - (int)msh2.m68krcycles_done > 120)
-      p32x_sync_sh2s(cycles);
+      m68k_sync_sh2s(cycles);
     return;
   }
   // PWM
@@ -544,6 +552,7 @@ static void p32x_vdp_write16(u32 a, u32 d, SH2 *sh2)
     a = Pico32x.vdp_regs[6 / 2];
     while (len1--) {
       dram[a] = d;
+      PicoDirtyDram((Pico32x.vdp_regs[0x0a/2] & P32XV_FS) ^ 1, a * 2);
       a = (a & 0xff00) | ((a + 1) & 0xff);
     }
     Pico32x.vdp_regs[0x06 / 2] = a;
@@ -1037,6 +1046,7 @@ void PicoWrite16_32x(u32 a, u32 d)
   if ((d & 0xff) != 0) { \
     u8 *dram = (u8 *)Pico32xMem->dram[n]; \
     dram[(a & 0x1ffff) ^ 1] = d; \
+    PicoDirtyDram(n, a); \
   }
 
 static void m68k_write8_dram0_ow(u32 a, u32 d)
@@ -1051,6 +1061,7 @@ static void m68k_write8_dram1_ow(u32 a, u32 d)
 
 #define sh2_write16_dramN(n) \
   u16 *pd = &Pico32xMem->dram[n][(a & 0x1ffff) / 2]; \
+  PicoDirtyDram(n, a); \
   if (!(a & 0x20000)) { \
     *pd = d; \
     return; \
@@ -1883,4 +1894,13 @@ void Pico32xMemStateLoaded(void)
   sh2_drc_flush_all();
 }
 
+const struct pico_ctx_area ctx_areas_32x_memory[] = {
+  PICO_CTX_AREA(m68k_poll),
+  PICO_CTX_AREA(sh2_read8_map),
+  PICO_CTX_AREA(sh2_read16_map),
+  PICO_CTX_AREA(sh2_write8_map),
+  PICO_CTX_AREA(sh2_write16_map),
+  PICO_CTX_AREA_END
+};
+
 // vim:shiftwidth=2:ts=2:expandtab
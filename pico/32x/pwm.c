@@ -6,6 +6,8 @@
  * See COPYING file in the top-level directory.
  */
 #include "../pico_int.h"
+#include "../sound/mix.h"
+#include "../sound/resampler.h"
 
 static int pwm_cycles;
 static int pwm_mult;
@@ -13,6 +15,7 @@ static int pwm_ptr;
 static int pwm_irq_reload;
 static int pwm_doing_fifo;
 static int pwm_silent;
+static struct rsmp pwm_rs; // for native rate synthesis
 
 void p32x_pwm_ctl_changed(void)
 {
@@ -240,6 +243,41 @@ void p32x_pwm_write16(unsigned int a, unsigned int d,
   }
 }
 
+// resample this frame's samples to the synthesis rate
+static void pwm_native_update(int *buf32, int length, int xmd)
+{
+  static int tmp[2*1280];
+  int rate, i;
+
+  rate = (Pico.m.pal ? OSC_PAL : OSC_NTSC) / 7 * 3;
+  rate = pwm_cycles > 0 ? rate / pwm_cycles : PsndNativeRate;
+  if (pwm_rs.out_rate != PsndNativeRate || pwm_rs.in_rate != rate)
+    rsmp_init(&pwm_rs, rate, PsndNativeRate, 1);
+
+  rsmp_set_step(&pwm_rs, pwm_ptr, length);
+  rsmp_push16(&pwm_rs, Pico32xMem->pwm, pwm_ptr);
+  if (xmd == 0x05) {
+    rsmp_pull(&pwm_rs, buf32, length);
+    return;
+  }
+
+  if (length > 1280)
+    length = 1280;
+  memset(tmp, 0, length * 8);
+  rsmp_pull(&pwm_rs, tmp, length);
+  if (xmd == 0x0a) {
+    for (i = 0; i < length; i++, buf32 += 2) {
+      buf32[0] += tmp[i*2+1];
+      buf32[1] += tmp[i*2];
+    }
+    return;
+  }
+
+  // mono - LMD, RMD specify dst
+  for (i = 0; i < length; i++)
+    buf32[i*2 + ((xmd & 0x0c) ? 1 : 0)] += tmp[i*2 + ((xmd & 0x06) ? 1 : 0)];
+}
+
 void p32x_pwm_update(int *buf32, int length, int stereo)
 {
   short *pwmb;
@@ -258,18 +296,14 @@ void p32x_pwm_update(int *buf32, int length, int stereo)
   step = (pwm_ptr << 16) / length;
   pwmb = Pico32xMem->pwm;
 
-  if (stereo)
+  if (stereo && PsndNativeRate)
+    pwm_native_update(buf32, length, xmd);
+  else if (stereo)
   {
     if (xmd == 0x05) {
       // normal
-      while (length-- > 0) {
-        *buf32++ += pwmb[0];
-        *buf32++ += pwmb[1];
-
-        p += step;
-        pwmb += (p >> 16) * 2;
-        p &= 0xffff;
-      }
+      mix_16_to_32_step(buf32, pwmb, length, step);
+      pwmb += ((unsigned int)length * step >> 16) * 2;
     }
     else if (xmd == 0x0a) {
       // channel swap
@@ -334,4 +368,15 @@ void p32x_pwm_state_loaded(void)
   }
 }
 
+const struct pico_ctx_area ctx_areas_pwm[] = {
+  PICO_CTX_AREA(pwm_cycles),
+  PICO_CTX_AREA(pwm_mult),
+  PICO_CTX_AREA(pwm_ptr),
+  PICO_CTX_AREA(pwm_irq_reload),
+  PICO_CTX_AREA(pwm_doing_fifo),
+  PICO_CTX_AREA(pwm_silent),
+  PICO_CTX_AREA(pwm_rs),
+  PICO_CTX_AREA_END
+};
+
 // vim:shiftwidth=2:ts=2:expandtab
@@ -516,4 +516,10 @@ void p32x_dreq1_trigger(void)
   (void)hit;
 }
 
+const struct pico_ctx_area ctx_areas_sh2soc[] = {
+  PICO_CTX_AREA(timer_cycles),
+  PICO_CTX_AREA(timer_tick_cycles),
+  PICO_CTX_AREA_END
+};
+
 // vim:shiftwidth=2:ts=2:expandtab
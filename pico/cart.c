@@ -12,9 +12,19 @@
 #include "../cpu/debug.h"
 #include "../unzip/unzip.h"
 #include "../unzip/unzip_stream.h"
+#include "cd/hcd.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ROM_CACHE
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 
 static int rom_alloc_size;
+static int rom_cached; // Pico.rom maps a file from PicoCartCacheDir
 static const char *rom_exts[] = { "bin", "gen", "smd", "iso", "sms", "gg", "sg" };
 
 void (*PicoCartUnloadHook)(void);
@@ -23,6 +33,9 @@ void (*PicoCartMemSetup)(void);
 void (*PicoCartLoadProgressCB)(int percent) = NULL;
 void (*PicoCDLoadProgressCB)(const char *fname, int percent) = NULL; // handled in Pico/cd/cd_file.c
 
+// loaded ROMs are stored here, to be mapped by later loads, NULL disables
+const char *PicoCartCacheDir;
+
 int PicoGameLoaded;
 
 static void PicoCartDetect(const char *carthw_cfg);
@@ -50,6 +63,22 @@ typedef struct _cso_struct
 }
 cso_struct;
 
+/* hcd struct */
+#define HCD_CACHE_HUNKS 16
+
+typedef struct
+{
+  hcd_header header;      // first, load_cd_image() takes the track list from it
+  unsigned int fpos_out;  // pos in virtual decompressed file
+  unsigned int lru_clock;
+  int hunk[HCD_CACHE_HUNKS];          // hunk in each cache slot, -1 if none
+  unsigned int used[HCD_CACHE_HUNKS]; // lru_clock of last use
+  unsigned char *in_buff; // compressed hunk
+  unsigned char *cache;   // HCD_CACHE_HUNKS decompressed hunks
+  unsigned int index[0];
+}
+hcd_struct;
+
 static int uncompress2(void *dest, int destLen, void *source, int sourceLen)
 {
     z_stream stream;
@@ -209,6 +238,67 @@ cso_failed:
     if (f != NULL) fclose(f);
     return NULL;
   }
+  else if (strcasecmp(ext, "hcd") == 0)
+  {
+    hcd_struct *hcd = NULL;
+    hcd_header hdr;
+    int i, count;
+    f = fopen(path, "rb");
+    if (f == NULL)
+      goto hcd_failed;
+
+    if (fread(&hdr, 1, sizeof(hdr), f) != sizeof(hdr)
+        || memcmp(hdr.magic, HCD_MAGIC, sizeof(hdr.magic)) != 0) {
+      elprintf(EL_STATUS, "hcd: bad header");
+      goto hcd_failed;
+    }
+
+    if ((hdr.frame_size != 2048 && hdr.frame_size != 2352)
+        || hdr.hunk_size == 0 || hdr.hunk_size > 0x100000
+        || hdr.hunk_size % hdr.frame_size != 0
+        || hdr.hunk_count != (hdr.total_bytes + hdr.hunk_size - 1) / hdr.hunk_size
+        || hdr.track_count < 1 || hdr.track_count > HCD_MAX_TRACKS) {
+      elprintf(EL_STATUS, "hcd: bad geometry (frame %u, hunk %u)",
+        hdr.frame_size, hdr.hunk_size);
+      goto hcd_failed;
+    }
+
+    count = hdr.hunk_count + 1;
+    hcd = calloc(1, sizeof(*hcd) + count * 4);
+    if (hcd == NULL)
+      goto hcd_failed;
+    hcd->header = hdr;
+    if (fread(hcd->index, 4, count, f) != count) {
+      elprintf(EL_STATUS, "hcd: premature EOF");
+      goto hcd_failed;
+    }
+
+    hcd->in_buff = malloc(hdr.hunk_size);
+    hcd->cache = malloc(HCD_CACHE_HUNKS * hdr.hunk_size);
+    if (hcd->in_buff == NULL || hcd->cache == NULL)
+      goto hcd_failed;
+    for (i = 0; i < HCD_CACHE_HUNKS; i++)
+      hcd->hunk[i] = -1;
+
+    // all ok
+    file = calloc(1, sizeof(*file));
+    if (file == NULL) goto hcd_failed;
+    file->file  = f;
+    file->param = hcd;
+    file->size  = hdr.total_bytes;
+    file->type  = PMT_HCD;
+    strncpy(file->ext, ext, sizeof(file->ext) - 1);
+    return file;
+
+hcd_failed:
+    if (hcd != NULL) {
+      free(hcd->in_buff);
+      free(hcd->cache);
+      free(hcd);
+    }
+    if (f != NULL) fclose(f);
+    return NULL;
+  }
 
   /* not a zip, treat as uncompressed file */
   f = fopen(path, "rb");
@@ -236,7 +326,71 @@ cso_failed:
   return file;
 }
 
+// get a decompressed hunk, through the cache
+static unsigned char *hcd_get_hunk(pm_file *stream, int hunk)
+{
+  hcd_struct *hcd = stream->param;
+  unsigned int hunk_size = hcd->header.hunk_size;
+  unsigned int start, end, out_len;
+  unsigned char *dst;
+  uLongf dst_len;
+  int i, slot = 0;
+
+  hcd->lru_clock++;
+  for (i = 0; i < HCD_CACHE_HUNKS; i++) {
+    if (hcd->hunk[i] == hunk) {
+      hcd->used[i] = hcd->lru_clock;
+      return hcd->cache + i * hunk_size;
+    }
+    if (hcd->used[i] < hcd->used[slot])
+      slot = i;
+  }
+
+  dst = hcd->cache + slot * hunk_size;
+  hcd->hunk[slot] = -1;
+
+  start = hcd->index[hunk] & 0x7fffffff;
+  end = hcd->index[hunk+1] & 0x7fffffff;
+  out_len = hcd->header.total_bytes - hunk * hunk_size;
+  if (out_len > hunk_size)
+    out_len = hunk_size;
+  if (end < start || end - start > hunk_size)
+    goto fail;
+
+  fseek(stream->file, start, SEEK_SET);
+  if (hcd->index[hunk] & 0x80000000) {
+    if (fread(dst, 1, out_len, stream->file) != out_len)
+      goto fail;
+  }
+  else {
+    if (fread(hcd->in_buff, 1, end - start, stream->file) != end - start)
+      goto fail;
+    dst_len = out_len;
+    if (uncompress(dst, &dst_len, hcd->in_buff, end - start) != Z_OK
+        || dst_len != out_len)
+      goto fail;
+  }
+
+  hcd->hunk[slot] = hunk;
+  hcd->used[slot] = hcd->lru_clock;
+  return dst;
+
+fail:
+  elprintf(EL_STATUS, "hcd: failed to get hunk %d @ %08x", hunk, start);
+  return NULL;
+}
+
 size_t pm_read(void *ptr, size_t bytes, pm_file *stream)
+{
+#ifdef CD_READAHEAD
+  if (stream->ra)
+    return cdra_read(ptr, bytes, stream);
+#endif
+  return pm_read_direct(ptr, bytes, stream);
+}
+
+// bypassing read-ahead
+size_t pm_read_direct(void *ptr, size_t bytes, pm_file *stream)
 {
   int ret;
 
@@ -316,6 +470,34 @@ size_t pm_read(void *ptr, size_t bytes, pm_file *stream)
       index_end = cso->index[block+1];
     }
   }
+  else if (stream->type == PMT_HCD)
+  {
+    hcd_struct *hcd = stream->param;
+    unsigned int hunk_size = hcd->header.hunk_size;
+    unsigned int offs, len;
+    unsigned char *out = ptr, *src;
+
+    ret = 0;
+    while (bytes != 0 && hcd->fpos_out < hcd->header.total_bytes)
+    {
+      src = hcd_get_hunk(stream, hcd->fpos_out / hunk_size);
+      if (src == NULL)
+        break;
+
+      offs = hcd->fpos_out % hunk_size;
+      len = hunk_size - offs;
+      if (len > bytes)
+        len = bytes;
+      if (len > hcd->header.total_bytes - hcd->fpos_out)
+        len = hcd->header.total_bytes - hcd->fpos_out;
+      memcpy(out, src + offs, len);
+
+      ret += len;
+      out += len;
+      hcd->fpos_out += len;
+      bytes -= len;
+    }
+  }
   else
     ret = 0;
 
@@ -323,6 +505,15 @@ size_t pm_read(void *ptr, size_t bytes, pm_file *stream)
 }
 
 int pm_seek(pm_file *stream, long offset, int whence)
+{
+#ifdef CD_READAHEAD
+  if (stream->ra)
+    return cdra_seek(stream, offset, whence);
+#endif
+  return pm_seek_direct(stream, offset, whence);
+}
+
+int pm_seek_direct(pm_file *stream, long offset, int whence)
 {
   if (stream->type == PMT_UNCOMPRESSED)
   {
@@ -349,6 +540,17 @@ int pm_seek(pm_file *stream, long offset, int whence)
     }
     return cso->fpos_out;
   }
+  else if (stream->type == PMT_HCD)
+  {
+    hcd_struct *hcd = stream->param;
+    switch (whence)
+    {
+      case SEEK_CUR: hcd->fpos_out += offset; break;
+      case SEEK_SET: hcd->fpos_out  = offset; break;
+      case SEEK_END: hcd->fpos_out  = hcd->header.total_bytes + offset; break;
+    }
+    return hcd->fpos_out;
+  }
   else
     return -1;
 }
@@ -359,6 +561,8 @@ int pm_close(pm_file *fp)
 
   if (fp == NULL) return EOF;
 
+  cdra_detach(fp);
+
   if (fp->type == PMT_UNCOMPRESSED)
   {
     fclose(fp->file);
@@ -375,6 +579,14 @@ int pm_close(pm_file *fp)
     free(fp->param);
     fclose(fp->file);
   }
+  else if (fp->type == PMT_HCD)
+  {
+    hcd_struct *hcd = fp->param;
+    free(hcd->in_buff);
+    free(hcd->cache);
+    free(hcd);
+    fclose(fp->file);
+  }
   else
     ret = EOF;
 
@@ -464,10 +676,308 @@ static unsigned char *PicoCartAlloc(int filesize, int is_sms)
   return rom;
 }
 
+#ifdef ROM_CACHE
+/*
+ * ROM cache.
+ * A loaded ROM is written out as it sits in memory (decoded, byteswapped
+ * and padded), named by the sha256 of the source file. Later loads of the
+ * same file, from this or any other process, map it MAP_PRIVATE, so the
+ * pages are shared until something writes to them, and archives don't
+ * need to be unpacked again.
+ * file: rom image (rom_alloc_size bytes), struct rom_cache_tail
+ */
+#define ROM_CACHE_MAGIC "PDROMC1"
+
+struct rom_cache_tail {
+  char magic[8];
+  unsigned int size;
+  unsigned int alloc_size;
+  unsigned char key[32];
+};
+
+struct sha256 {
+  unsigned int h[8];
+  unsigned char buf[64];
+  unsigned long long len;
+};
+
+static const unsigned int sha256_k[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ror32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(unsigned int *h, const unsigned char *p)
+{
+  unsigned int w[64], v[8], t1, t2;
+  int i;
+
+  for (i = 0; i < 16; i++, p += 4)
+    w[i] = ((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+  for (; i < 64; i++) {
+    t1 = ror32(w[i-2], 17) ^ ror32(w[i-2], 19) ^ (w[i-2] >> 10);
+    t2 = ror32(w[i-15], 7) ^ ror32(w[i-15], 18) ^ (w[i-15] >> 3);
+    w[i] = w[i-16] + t2 + w[i-7] + t1;
+  }
+
+  memcpy(v, h, sizeof(v));
+  for (i = 0; i < 64; i++) {
+    t1 = v[7] + (ror32(v[4], 6) ^ ror32(v[4], 11) ^ ror32(v[4], 25))
+       + ((v[4] & v[5]) ^ (~v[4] & v[6])) + sha256_k[i] + w[i];
+    t2 = (ror32(v[0], 2) ^ ror32(v[0], 13) ^ ror32(v[0], 22))
+       + ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+    memmove(v + 1, v, 7 * sizeof(v[0]));
+    v[4] += t1;
+    v[0] = t1 + t2;
+  }
+  for (i = 0; i < 8; i++)
+    h[i] += v[i];
+}
+
+static void sha256_init(struct sha256 *s)
+{
+  static const unsigned int h0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+  };
+  memcpy(s->h, h0, sizeof(s->h));
+  s->len = 0;
+}
+
+static void sha256_update(struct sha256 *s, const unsigned char *p, size_t len)
+{
+  size_t n, fill;
+
+  for (; len > 0; p += n, len -= n) {
+    fill = s->len & 63;
+    n = 64 - fill;
+    if (n > len)
+      n = len;
+    s->len += n;
+    if (fill == 0 && n == 64) {
+      sha256_block(s->h, p);
+      continue;
+    }
+    memcpy(s->buf + fill, p, n);
+    if (fill + n == 64)
+      sha256_block(s->h, s->buf);
+  }
+}
+
+static void sha256_final(struct sha256 *s, unsigned char *out)
+{
+  unsigned long long bits = s->len << 3;
+  unsigned char pad[72] = { 0x80 };
+  int i, n;
+
+  n = 64 - ((s->len + 8) & 63);
+  if (n == 0)
+    n = 64;
+  for (i = 0; i < 8; i++)
+    pad[n + i] = bits >> (56 - i * 8);
+  sha256_update(s, pad, n + 8);
+
+  for (i = 0; i < 32; i++)
+    out[i] = s->h[i >> 2] >> (24 - (i & 3) * 8);
+}
+
+// hash the file as stored, archives are not unpacked for this
+static int rom_cache_path(pm_file *f, int is_sms, unsigned char *key,
+  char *path, size_t path_size)
+{
+  struct sha256 s;
+  unsigned char *buf;
+  off_t pos = 0;
+  ssize_t ret;
+  int fd, i, n;
+
+  if (PicoCartCacheDir == NULL || (PicoAHW & PAHW_MCD))
+    return -1;
+
+  if (f->type == PMT_UNCOMPRESSED)
+    fd = dup(fileno((FILE *)f->file));
+  else if (f->type == PMT_ZIP)
+    fd = open(((ZIP *)f->file)->zip, O_RDONLY);
+  else
+    return -1;
+  if (fd < 0)
+    return -1;
+
+  buf = malloc(0x10000);
+  if (buf == NULL) {
+    close(fd);
+    return -1;
+  }
+
+  sha256_init(&s);
+  while ((ret = pread(fd, buf, 0x10000, pos)) > 0) {
+    sha256_update(&s, buf, ret);
+    pos += ret;
+  }
+  close(fd);
+  // sms files are loaded differently
+  buf[0] = is_sms;
+  buf[1] = f->type;
+  sha256_update(&s, buf, 2);
+  sha256_final(&s, key);
+  free(buf);
+  if (ret < 0)
+    return -1;
+
+  n = snprintf(path, path_size, "%s/", PicoCartCacheDir);
+  for (i = 0; i < 32 && n < path_size; i++)
+    n += snprintf(path + n, path_size - n, "%02x", key[i]);
+  return n + 5 < path_size ? (strcpy(path + n, ".rom"), 0) : -1;
+}
+
+static int rom_cache_check(int fd, const unsigned char *key,
+  struct rom_cache_tail *t)
+{
+  struct stat st;
+
+  if (fstat(fd, &st) != 0 || st.st_size < sizeof(*t))
+    return -1;
+  if (pread(fd, t, sizeof(*t), st.st_size - sizeof(*t)) != sizeof(*t))
+    return -1;
+  if (memcmp(t->magic, ROM_CACHE_MAGIC, sizeof(t->magic)) != 0
+      || memcmp(t->key, key, sizeof(t->key)) != 0
+      || t->alloc_size != st.st_size - sizeof(*t)
+      || t->size + 4 > t->alloc_size)
+    return -1;
+  return 0;
+}
+
+static unsigned char *rom_cache_map(const char *path, const unsigned char *key,
+  unsigned int *psize)
+{
+  struct rom_cache_tail t;
+  void *rom;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  if (rom_cache_check(fd, key, &t) != 0) {
+    close(fd);
+    return NULL;
+  }
+
+  // same address as PicoCartAlloc, for 32x dynarec
+  rom = mmap((void *)0x02000000, t.alloc_size, PROT_READ | PROT_WRITE,
+    MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (rom == MAP_FAILED)
+    return NULL;
+
+  rom_alloc_size = t.alloc_size;
+  *psize = t.size;
+  return rom;
+}
+
+// write the image out and map it over the anonymous copy
+static int rom_cache_store(const char *path, const unsigned char *key,
+  unsigned char *rom, unsigned int size)
+{
+  struct rom_cache_tail t;
+  char tmp[512];
+  void *ret;
+  int fd;
+
+  // what PicoCartInsert would add
+  *(unsigned long *)(rom+size) = 0xFFFE4EFA;
+
+  memset(&t, 0, sizeof(t));
+  memcpy(t.magic, ROM_CACHE_MAGIC, sizeof(t.magic));
+  memcpy(t.key, key, sizeof(t.key));
+  t.size = size;
+  t.alloc_size = rom_alloc_size;
+
+  // other processes may be doing the same, only complete files get renamed
+  if (snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid()) >= sizeof(tmp))
+    return -1;
+  fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    elprintf(EL_STATUS, "rom cache: can't create %s", tmp);
+    return -1;
+  }
+  if (write(fd, rom, rom_alloc_size) != rom_alloc_size
+      || write(fd, &t, sizeof(t)) != sizeof(t)) {
+    close(fd);
+    unlink(tmp);
+    return -1;
+  }
+  if (close(fd) != 0) {
+    unlink(tmp);
+    return -1;
+  }
+  if (rename(tmp, path) != 0) {
+    unlink(tmp);
+    return -1;
+  }
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  if (rom_cache_check(fd, key, &t) != 0 || t.alloc_size != rom_alloc_size) {
+    close(fd);
+    return -1;
+  }
+  ret = mmap(rom, rom_alloc_size, PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_FIXED, fd, 0);
+  close(fd);
+  return ret == rom ? 0 : -1;
+}
+
+// turn Pico.rom back to private memory, a file mapping can't grow
+static int rom_cache_detach(void)
+{
+  void *tmp, *ret;
+
+  tmp = malloc(rom_alloc_size);
+  if (tmp == NULL)
+    return -1;
+  memcpy(tmp, Pico.rom, rom_alloc_size);
+  ret = mmap(Pico.rom, rom_alloc_size, PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+  if (ret == Pico.rom)
+    memcpy(Pico.rom, tmp, rom_alloc_size);
+  free(tmp);
+  if (ret != Pico.rom)
+    return -1;
+  rom_cached = 0;
+  return 0;
+}
+#endif // ROM_CACHE
+
+static void rom_free(unsigned char *rom)
+{
+#ifdef ROM_CACHE
+  if (rom_cached) {
+    munmap(rom, rom_alloc_size);
+    rom_cached = 0;
+    return;
+  }
+#endif
+  plat_munmap(rom, rom_alloc_size);
+}
+
 int PicoCartLoad(pm_file *f,unsigned char **prom,unsigned int *psize,int is_sms)
 {
   unsigned char *rom;
   int size, bytes_read;
+#ifdef ROM_CACHE
+  unsigned char key[32];
+  char cache_path[512];
+  int cache_ok = 0;
+  unsigned int csize;
+#endif
 
   if (f == NULL)
     return 1;
@@ -476,6 +986,20 @@ int PicoCartLoad(pm_file *f,unsigned char **prom,unsigned int *psize,int is_sms)
   if (size <= 0) return 1;
   size = (size+3)&~3; // Round up to a multiple of 4
 
+  rom_cached = 0;
+#ifdef ROM_CACHE
+  if (rom_cache_path(f, is_sms, key, cache_path, sizeof(cache_path)) == 0) {
+    rom = rom_cache_map(cache_path, key, &csize);
+    if (rom != NULL) {
+      elprintf(EL_STATUS, "rom cache: mapped %s", cache_path);
+      rom_cached = 1;
+      size = csize;
+      goto out;
+    }
+    cache_ok = 1;
+  }
+#endif
+
   // Allocate space for the rom plus padding
   rom = PicoCartAlloc(size, is_sms);
   if (rom == NULL) {
@@ -504,7 +1028,7 @@ int PicoCartLoad(pm_file *f,unsigned char **prom,unsigned int *psize,int is_sms)
     bytes_read = pm_read(rom,size,f); // Load up the rom
   if (bytes_read <= 0) {
     elprintf(EL_STATUS, "read failed");
-    free(rom);
+    plat_munmap(rom, rom_alloc_size);
     return 3;
   }
 
@@ -534,6 +1058,16 @@ int PicoCartLoad(pm_file *f,unsigned char **prom,unsigned int *psize,int is_sms)
     }
   }
 
+#ifdef ROM_CACHE
+  // not the MegaCD BIOS, Pico_mcd lives there
+  if (cache_ok && !(PicoAHW & PAHW_MCD)) {
+    if (rom_cache_store(cache_path, key, rom, size) == 0)
+      rom_cached = 1;
+    else
+      elprintf(EL_STATUS, "rom cache: store failed");
+  }
+out:
+#endif
   if (prom)  *prom = rom;
   if (psize) *psize = size;
 
@@ -546,7 +1080,8 @@ int PicoCartInsert(unsigned char *rom, unsigned int romsize, const char *carthw_
   // notaz: add a 68k "jump one op back" opcode to the end of ROM.
   // This will hang the emu, but will prevent nasty crashes.
   // note: 4 bytes are padded to every ROM
-  if (rom != NULL)
+  // (already there for cached ROMs, don't dirty the page)
+  if (rom != NULL && *(unsigned int *)(rom+romsize) != 0xFFFE4EFA)
     *(unsigned long *)(rom+romsize) = 0xFFFE4EFA; // 4EFA FFFE byteswapped
 
   Pico.rom=rom;
@@ -598,9 +1133,22 @@ int PicoCartInsert(unsigned char *rom, unsigned int romsize, const char *carthw_
   return 0;
 }
 
+// for a ROM from PicoCartLoad that didn't get inserted
+void PicoCartLoadFree(unsigned char *rom)
+{
+  if (rom != NULL)
+    rom_free(rom);
+}
+
 int PicoCartResize(int newsize)
 {
-  void *tmp = plat_mremap(Pico.rom, rom_alloc_size, newsize);
+  void *tmp;
+
+#ifdef ROM_CACHE
+  if (rom_cached && rom_cache_detach() != 0)
+    return -1;
+#endif
+  tmp = plat_mremap(Pico.rom, rom_alloc_size, newsize);
   if (tmp == NULL)
     return -1;
 
@@ -616,12 +1164,18 @@ void PicoCartUnload(void)
     PicoCartUnloadHook = NULL;
   }
 
+  // idle patches may be in the 32X m68k BIOS copy, undo them first
+  if (Pico.rom != NULL)
+    SekFinishIdleDet();
+
   if (PicoAHW & PAHW_32X)
     PicoUnload32x();
 
+  // history belongs to this cart
+  PicoRewindClear();
+
   if (Pico.rom != NULL) {
-    SekFinishIdleDet();
-    plat_munmap(Pico.rom, rom_alloc_size);
+    rom_free(Pico.rom);
     Pico.rom = NULL;
   }
   PicoGameLoaded = 0;
@@ -629,13 +1183,19 @@ void PicoCartUnload(void)
 
 static unsigned int rom_crc32(void)
 {
-  unsigned int crc;
+  unsigned int crc = 0, buf[0x400];
+  int i, len;
   elprintf(EL_STATUS, "caclulating CRC32..");
 
   // have to unbyteswap for calculation..
-  Byteswap(Pico.rom, Pico.rom, Pico.romsize);
-  crc = crc32(0, Pico.rom, Pico.romsize);
-  Byteswap(Pico.rom, Pico.rom, Pico.romsize);
+  // (a piece at a time to a copy, the ROM may be shared)
+  for (i = 0; i < Pico.romsize; i += len) {
+    len = Pico.romsize - i;
+    if (len > sizeof(buf))
+      len = sizeof(buf);
+    Byteswap(buf, Pico.rom + i, len);
+    crc = crc32(crc, (void *)buf, len);
+  }
   return crc;
 }
 
@@ -1030,4 +1590,10 @@ static void PicoCartDetect(const char *carthw_cfg)
     *(int *) (Pico.rom + 0x1f0) = 0x20204520;
 }
 
+const struct pico_ctx_area ctx_areas_cart[] = {
+  PICO_CTX_AREA(rom_alloc_size),
+  PICO_CTX_AREA(rom_cached),
+  PICO_CTX_AREA_END
+};
+
 // vim:shiftwidth=2:expandtab
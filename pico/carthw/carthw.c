@@ -679,3 +679,17 @@ void carthw_prot_lk3_startup(void)
   PicoCartMemSetup = carthw_prot_lk3_mem_setup;
 }
 
+const struct pico_ctx_area ctx_areas_carthw[] = {
+  PICO_CTX_AREA(ssf2_banks),
+  PICO_CTX_AREA(carthw_Xin1_baddr),
+  PICO_CTX_AREA(realtec_bank),
+  PICO_CTX_AREA(realtec_size),
+  PICO_CTX_AREA(pier_regs),
+  PICO_CTX_AREA(pier_dump_prot),
+  PICO_CTX_AREA(sprot_items),
+  PICO_CTX_AREA(sprot_item_alloc),
+  PICO_CTX_AREA(sprot_item_count),
+  PICO_CTX_AREA(prot_lk3_cmd),
+  PICO_CTX_AREA(prot_lk3_data),
+  PICO_CTX_AREA_END
+};
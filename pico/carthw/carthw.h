@@ -13,6 +13,7 @@ extern svp_t *svp;
 void PicoSVPInit(void);
 void PicoSVPStartup(void);
 void PicoSVPMemSetup(void);
+void PicoSVPDrcReinit(void);
 
 /* misc */
 void carthw_ssf2_startup(void);
@@ -1907,3 +1907,13 @@ void ssp1601_dyn_run(int cycles)
 #endif
 }
 
+// per emulator instance, tcache itself is switched by cmn.c
+const struct pico_ctx_area ctx_areas_svp_drc[] = {
+	PICO_CTX_AREA(ssp_block_table),
+	PICO_CTX_AREA(ssp_block_table_iram),
+	PICO_CTX_AREA(tcache_ptr),
+	PICO_CTX_AREA(nblocks),
+	PICO_CTX_AREA(n_in_ops),
+	PICO_CTX_AREA_END
+};
+
@@ -1,3 +1,4 @@
+#ifdef __arm__
 int  ssp_drc_entry(ssp1601_t *ssp, int cycles);
 void ssp_drc_next(void);
 void ssp_drc_next_patch(void);
@@ -11,6 +12,7 @@ void ssp_hle_07_036(void);
 void ssp_hle_11_12c(void);
 void ssp_hle_11_384(void);
 void ssp_hle_11_38a(void);
+#endif
 
 int  ssp1601_dyn_startup(void);
 void ssp1601_dyn_exit(void);
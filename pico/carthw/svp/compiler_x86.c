@@ -0,0 +1,2170 @@
+/*
+ * SSP1601 to x86-64 recompiler
+ * (C) notaz, 2008,2009,2010
+ *
+ * Derived from compiler.c, the ARM one. The Virtua Racing HLE blocks
+ * from stub_arm.S are not available here, everything is translated.
+ *
+ * This work is licensed under the terms of MAME license.
+ * See COPYING file in the top-level directory.
+ */
+
+#include "../../pico_int.h"
+#include "../../../cpu/drc/cmn.h"
+#include "compiler.h"
+
+// FIXME: asm has these hardcoded
+#define SSP_BLOCKTAB_ENTS       (0x5090/2)
+#define SSP_BLOCKTAB_IRAM_ONE   (0x800/2) // table entries
+#define SSP_BLOCKTAB_IRAM_ENTS  (15*SSP_BLOCKTAB_IRAM_ONE)
+
+static void **ssp_block_table; // [0x5090/2];
+static void **ssp_block_table_iram; // [15][0x800/2];
+
+static u8 *tcache_ptr = NULL;
+
+// generated at startup, see ssp_generate_stubs()
+static int (*ssp_drc_entry)(ssp1601_t *ssp, int cycles);
+static void *ssp_drc_next, *ssp_drc_next_patch, *ssp_drc_end;
+
+static int nblocks = 0;
+static int n_in_ops = 0;
+
+extern ssp1601_t *ssp;
+
+#define rPC    ssp->gr[SSP_PC].h
+#define rPMC   ssp->gr[SSP_PMC]
+
+#define SSP_FLAG_Z (1<<0xd)
+#define SSP_FLAG_N (1<<0xf)
+
+//#define DUMP_BLOCK 0x0c9a
+
+#define COUNT_OP
+#include "../../../cpu/drc/emit_x86.c"
+#define COND_AL 0x10 // not a valid x86 cond
+
+// -----------------------------------------------------
+
+static int get_inc(int mode)
+{
+	int inc = (mode >> 11) & 7;
+	if (inc != 0) {
+		if (inc != 7) inc--;
+		inc = 1 << inc; // 0 1 2 4 8 16 32 128
+		if (mode & 0x8000) inc = -inc; // decrement mode
+	}
+	return inc;
+}
+
+u32 ssp_pm_read(int reg)
+{
+	u32 d = 0, mode;
+
+	if (ssp->emu_status & SSP_PMC_SET)
+	{
+		ssp->pmac_read[reg] = rPMC.v;
+		ssp->emu_status &= ~SSP_PMC_SET;
+		return 0;
+	}
+
+	// just in case
+	ssp->emu_status &= ~SSP_PMC_HAVE_ADDR;
+
+	mode = ssp->pmac_read[reg]>>16;
+	if      ((mode & 0xfff0) == 0x0800) // ROM
+	{
+		d = ((unsigned short *)Pico.rom)[ssp->pmac_read[reg]&0xfffff];
+		ssp->pmac_read[reg] += 1;
+	}
+	else if ((mode & 0x47ff) == 0x0018) // DRAM
+	{
+		unsigned short *dram = (unsigned short *)svp->dram;
+		int inc = get_inc(mode);
+		d = dram[ssp->pmac_read[reg]&0xffff];
+		ssp->pmac_read[reg] += inc;
+	}
+
+	// PMC value corresponds to last PMR accessed
+	rPMC.v = ssp->pmac_read[reg];
+
+	return d;
+}
+
+#define overwrite_write(dst, d) \
+{ \
+	if (d & 0xf000) { dst &= ~0xf000; dst |= d & 0xf000; } \
+	if (d & 0x0f00) { dst &= ~0x0f00; dst |= d & 0x0f00; } \
+	if (d & 0x00f0) { dst &= ~0x00f0; dst |= d & 0x00f0; } \
+	if (d & 0x000f) { dst &= ~0x000f; dst |= d & 0x000f; } \
+}
+
+void ssp_pm_write(u32 d, int reg)
+{
+	unsigned short *dram;
+	int mode, addr;
+
+	if (ssp->emu_status & SSP_PMC_SET)
+	{
+		ssp->pmac_write[reg] = rPMC.v;
+		ssp->emu_status &= ~SSP_PMC_SET;
+		return;
+	}
+
+	// just in case
+	ssp->emu_status &= ~SSP_PMC_HAVE_ADDR;
+
+	dram = (unsigned short *)svp->dram;
+	mode = ssp->pmac_write[reg]>>16;
+	addr = ssp->pmac_write[reg]&0xffff;
+	if      ((mode & 0x43ff) == 0x0018) // DRAM
+	{
+		int inc = get_inc(mode);
+		if (mode & 0x0400) {
+		       overwrite_write(dram[addr], d);
+		} else dram[addr] = d;
+		ssp->pmac_write[reg] += inc;
+	}
+	else if ((mode & 0xfbff) == 0x4018) // DRAM, cell inc
+	{
+		if (mode & 0x0400) {
+		       overwrite_write(dram[addr], d);
+		} else dram[addr] = d;
+		ssp->pmac_write[reg] += (addr&1) ? 0x1f : 1;
+	}
+	else if ((mode & 0x47ff) == 0x001c) // IRAM
+	{
+		int inc = get_inc(mode);
+		((unsigned short *)svp->iram_rom)[addr&0x3ff] = d;
+		ssp->pmac_write[reg] += inc;
+		ssp->drc.iram_dirty = 1;
+	}
+
+	rPMC.v = ssp->pmac_write[reg];
+}
+
+
+// -----------------------------------------------------
+
+// 14 IRAM blocks
+static unsigned char iram_context_map[] =
+{
+	 0, 0, 0, 0, 1, 0, 0, 0, // 04
+	 0, 0, 0, 0, 0, 0, 2, 0, // 0e
+	 0, 0, 0, 0, 0, 3, 0, 4, // 15 17
+	 5, 0, 0, 6, 0, 7, 0, 0, // 18 1b 1d
+	 8, 9, 0, 0, 0,10, 0, 0, // 20 21 25
+	 0, 0, 0, 0, 0, 0, 0, 0,
+	 0, 0,11, 0, 0,12, 0, 0, // 32 35
+	13,14, 0, 0, 0, 0, 0, 0  // 38 39
+};
+
+int ssp_get_iram_context(void)
+{
+	unsigned char *ir = (unsigned char *)svp->iram_rom;
+	int val1, val = ir[0x083^1] + ir[0x4FA^1] + ir[0x5F7^1] + ir[0x47B^1];
+	val1 = iram_context_map[(val>>1)&0x3f];
+
+	if (val1 == 0) {
+		elprintf(EL_ANOMALY, "svp: iram ctx val: %02x PC=%04x\n", (val>>1)&0x3f, rPC);
+		//debug_dump2file(name, svp->iram_rom, 0x800);
+		//exit(1);
+	}
+	return val1;
+}
+
+// -----------------------------------------------------
+
+/* regs with known values */
+static struct
+{
+	ssp_reg_t gr[8];
+	unsigned char r[8];
+	unsigned int pmac_read[5];
+	unsigned int pmac_write[5];
+	ssp_reg_t pmc;
+	unsigned int emu_status;
+} known_regs;
+
+#define KRREG_X     (1 << SSP_X)
+#define KRREG_Y     (1 << SSP_Y)
+#define KRREG_A     (1 << SSP_A)	/* AH only */
+#define KRREG_ST    (1 << SSP_ST)
+#define KRREG_STACK (1 << SSP_STACK)
+#define KRREG_PC    (1 << SSP_PC)
+#define KRREG_P     (1 << SSP_P)
+#define KRREG_PR0   (1 << 8)
+#define KRREG_PR4   (1 << 12)
+#define KRREG_AL    (1 << 16)
+#define KRREG_PMCM  (1 << 18)		/* only mode word of PMC */
+#define KRREG_PMC   (1 << 19)
+#define KRREG_PM0R  (1 << 20)
+#define KRREG_PM1R  (1 << 21)
+#define KRREG_PM2R  (1 << 22)
+#define KRREG_PM3R  (1 << 23)
+#define KRREG_PM4R  (1 << 24)
+#define KRREG_PM0W  (1 << 25)
+#define KRREG_PM1W  (1 << 26)
+#define KRREG_PM2W  (1 << 27)
+#define KRREG_PM3W  (1 << 28)
+#define KRREG_PM4W  (1 << 29)
+
+/* bitfield of known register values */
+static u32 known_regb = 0;
+
+/* known value of gr reg (AL included), -1 if unknown.
+ * note: bits 8-15 of known_regb are r0-r7, not gr[8+] */
+static int tr_known_gr(int r)
+{
+	if (r == SSP_AL)
+		return (known_regb & KRREG_AL) ? known_regs.gr[SSP_A].l : -1;
+	if (r < 8 && (known_regb & (1 << r)))
+		return known_regs.gr[r].h;
+	return -1;
+}
+
+/* known vals, which need to be flushed
+ * (only ST, P, r0-r7, PMCx, PMxR, PMxW)
+ * ST means N and Z are derived from r15
+ * P means that it needs to be recalculated
+ */
+static u32 dirty_regb = 0;
+
+/* known values of host regs.
+ * -1            - unknown
+ * 000000-00ffff - 16bit value
+ * 100000-10ffff - base reg (r7) + 16bit val
+ * 0r0000        - means reg (low) eq gr[r].h, r != AL
+ * x86: r0-r3 are eax, ecx, edx, esi
+ */
+static int hostreg_r[4];
+
+static void hostreg_clear(void)
+{
+	int i;
+	for (i = 0; i < 4; i++)
+		hostreg_r[i] = -1;
+}
+
+static void hostreg_sspreg_changed(int sspreg)
+{
+	int i;
+	for (i = 0; i < 4; i++)
+		if (hostreg_r[i] == (sspreg<<16) ||
+		    (sspreg == SSP_A && hostreg_r[i] == (SSP_AL<<16))) // A ops touch AL too
+			hostreg_r[i] = -1;
+}
+
+
+#define PROGRAM(x)   ((unsigned short *)svp->iram_rom)[x]
+#define PROGRAM_P(x) ((unsigned short *)svp->iram_rom + (x))
+
+void tr_unhandled(void)
+{
+	//FILE *f = fopen("tcache.bin", "wb");
+	//fwrite(tcache, 1, (u8 *)tcache_ptr - tcache, f);
+	//fclose(f);
+	elprintf(EL_ANOMALY, "unhandled @ %04x\n", known_regs.gr[SSP_PC].h<<1);
+	//exit(1);
+}
+
+// check if AL is going to be used later in block
+static int tr_predict_al_need(void)
+{
+	int tmpv, tmpv2, op, pc = known_regs.gr[SSP_PC].h;
+
+	while (1)
+	{
+		op = PROGRAM(pc);
+		switch (op >> 9)
+		{
+			// ld d, s
+			case 0x00:
+				tmpv2 = (op >> 4) & 0xf; // dst
+				tmpv  = op & 0xf; // src
+				if (tmpv == SSP_AL || tmpv2 == SSP_PC) // ld *, AL; ret
+					return 1;
+				if ((tmpv2 == SSP_A && tmpv == SSP_P) || tmpv2 == SSP_AL) // ld A, P; ld AL, *
+					return 0;
+				break;
+
+			// ld d, (ri); ld d, ((ri)); ld d, ri; ld d, (a)
+			case 0x01: case 0x05: case 0x09: case 0x25:
+				tmpv2 = (op >> 4) & 0xf; // dst
+				if (tmpv2 == SSP_PC)
+					return 1;
+				if (tmpv2 == SSP_AL)
+					return 0;
+				break;
+
+			// ld (ri), s
+			case 0x02:
+			// ld ri, s
+			case 0x0a:
+				tmpv  = (op >> 4) & 0xf; // src
+				if (tmpv == SSP_AL) // ld *, AL
+					return 1;
+				break;
+
+			// ldi d, imm
+			case 0x04:
+				tmpv2 = (op >> 4) & 0xf; // dst
+				if (tmpv2 == SSP_PC)
+					return 1;
+				if (tmpv2 == SSP_AL)
+					return 0;
+				pc++; break;
+
+			case 0x06: pc++; break;
+
+			// sub, cmp, add, or, eor: flags come from all 32 bits
+			case 0x10: case 0x11: case 0x13: case 0x14: case 0x15: case 0x19: case 0x1c:
+			case 0x30: case 0x31: case 0x33: case 0x34: case 0x35: case 0x39: case 0x3c:
+			case 0x40: case 0x41: case 0x43: case 0x44: case 0x45: case 0x49: case 0x4c:
+			case 0x60: case 0x61: case 0x63: case 0x64: case 0x65: case 0x69: case 0x6c:
+			case 0x70: case 0x71: case 0x73: case 0x74: case 0x75: case 0x79: case 0x7c:
+				return 1;
+
+			// call cond, addr
+			case 0x24:
+			// bra cond, addr
+			case 0x26:
+			// mod cond, op
+			case 0x48:
+			// mpys?
+			case 0x1b:
+			// mpya (rj), (ri), b
+			case 0x4b: return 1;
+
+			// mld (rj), (ri), b
+			case 0x5b: return 0; // cleared anyway
+
+			// and A, *
+			case 0x50:
+				tmpv  = op & 0xf; // src
+				if (tmpv == SSP_AL || tmpv == SSP_A || tmpv == SSP_P) return 1;
+			case 0x51: case 0x53: case 0x54: case 0x55: case 0x59: case 0x5c:
+				return 0;
+		}
+		pc++;
+	}
+}
+
+static int tr_neg_cond(int cond)
+{
+	switch (cond) {
+		case COND_AL:  elprintf(EL_ANOMALY, "neg for AL?\n"); exit(1);
+		case DCOND_EQ: return DCOND_NE;
+		case DCOND_NE: return DCOND_EQ;
+		case DCOND_MI: return DCOND_PL;
+		case DCOND_PL: return DCOND_MI;
+		default:       elprintf(EL_ANOMALY, "bad cond for neg\n"); exit(1);
+	}
+	return 0;
+}
+
+static void tr_r0_to_STACK(int const_val);
+
+
+// x86-64 register map:
+// rbx: A
+// rbp: SSP context
+// r12: XXYY
+// r13: cycles
+// r14: P
+// r15: value ST N and Z flags are derived from, if ST is dirty
+// ST, STACK and pr0-pr7 are kept in the context.
+// eax, ecx, edx, esi are r0-r3, r10 and r11 are used for ST flushing.
+#define HR_A      xBX
+#define HR_XXYY   xR12
+#define HR_CYCLES xR13
+#define HR_P      xR14
+#define HR_FLAGS  xR15
+
+// 0x0f xx r, rm
+#define emith_op0f_r_r(op, r, rm) do { \
+	EMIT_REX_IF(0, r, rm); \
+	EMIT(0x0f, u8); \
+	EMIT_OP(op); \
+	EMIT_MODRM(3, r, rm); \
+} while (0)
+
+// op r, [ctx + index*2 + offs], op > 0xff are 0x0f xx
+#define emith_ctx_idx2_op(op, r, index, offs) do { \
+	if (((r) | (index)) > 7) \
+		EMIT_REX(0, r, index, 0); \
+	if ((op) > 0xff) \
+		EMIT((op) >> 8, u8); \
+	EMIT_OP((op) & 0xff); \
+	EMIT_MODRM(2, r, 4); \
+	EMIT_SIB(1, index, CONTEXT_REG); \
+	EMIT(offs, u32); \
+} while (0)
+
+// op [ctx + offs], imm
+#define emith_ctx_op8_imm(op, ext, offs, imm) do { \
+	emith_deref_op(op, ext, CONTEXT_REG, offs); \
+	EMIT(imm, u8); \
+} while (0)
+
+#define emith_ctx_op32_imm(op, ext, offs, imm) do { \
+	emith_deref_op(op, ext, CONTEXT_REG, offs); \
+	EMIT(imm, u32); \
+} while (0)
+
+// svp_t members are at fixed offsets from the context,
+// and svp is allocated right after ROM (see PicoSVPStartup)
+#define CTX_OFFS(p) ((int)((u8 *)(p) - (u8 *)ssp))
+
+/* update P, if needed. Trashes r0 */
+static void tr_flush_dirty_P(void)
+{
+	if (!(dirty_regb & KRREG_P)) return;
+	emith_asr(xAX, HR_XXYY, 16);
+	emith_lsl(HR_P, HR_XXYY, 16);
+	emith_asr(HR_P, HR_P, 15);
+	emith_op0f_r_r(0xaf, HR_P, xAX);	// imul r14d, eax
+	dirty_regb &= ~KRREG_P;
+	hostreg_r[0] = -1;
+}
+
+/* write dirty pr to context. Nothing is trashed */
+static void tr_flush_dirty_pr(int r)
+{
+	if (!(dirty_regb & (1 << (r+8)))) return;
+	emith_ctx_op8_imm(0xc6, 0, 0x440+r, known_regs.r[r]);
+	dirty_regb &= ~(1 << (r+8));
+}
+
+/* write all dirty pr0-pr7 to context. Nothing is trashed */
+static void tr_flush_dirty_prs(void)
+{
+	int i;
+	for (i = 0; i < 8; i++)
+		tr_flush_dirty_pr(i);
+}
+
+/* derive N and Z from r15 and merge them to ST. Trashes r10,r11 */
+static void tr_flush_dirty_ST(void)
+{
+	if (!(dirty_regb & KRREG_ST)) return;
+	emith_lsr(xR10, HR_FLAGS, 16);
+	emith_and_r_imm(xR10, SSP_FLAG_N);
+	emith_cmp_r_imm(HR_FLAGS, 1);
+	emith_sbc_r_r(xR11, xR11);
+	emith_and_r_imm(xR11, SSP_FLAG_Z);
+	emith_or_r_r(xR10, xR11);
+	emith_read16_r_r_offs(xR11, CONTEXT_REG, 0x400+SSP_ST*4+2);
+	emith_and_r_imm(xR11, ~(SSP_FLAG_N|SSP_FLAG_Z) & 0xffff);
+	emith_or_r_r(xR11, xR10);
+	emith_write16_r_r_offs(xR11, CONTEXT_REG, 0x400+SSP_ST*4+2);
+	dirty_regb &= ~KRREG_ST;
+}
+
+/* load 16bit val into host reg r0-r2. Nothing is trashed */
+static void tr_mov16(int r, int val)
+{
+	if (hostreg_r[r] != val) {
+		emith_move_r_imm(r, val);
+		hostreg_r[r] = val;
+	}
+}
+
+/* flags are preserved */
+static void tr_mov16_cond(int cond, int r, int val)
+{
+	if (cond == COND_AL)
+		emith_move_r_imm(r, val);
+	else
+		emith_move_r_imm_c(cond, r, val);
+	hostreg_r[r] = -1;
+}
+
+static void tr_flush_dirty_pmcrs(void)
+{
+	int i;
+	if (!(dirty_regb & 0x3ff80000)) return;
+
+	if (dirty_regb & KRREG_PMC) {
+		emith_ctx_op32_imm(0xc7, 0, 0x400+SSP_PMC*4, known_regs.pmc.v);
+
+		if (known_regs.emu_status & (SSP_PMC_SET|SSP_PMC_HAVE_ADDR)) {
+			elprintf(EL_ANOMALY, "!! SSP_PMC_SET|SSP_PMC_HAVE_ADDR set on flush\n");
+			tr_unhandled();
+		}
+	}
+	for (i = 0; i < 5; i++)
+	{
+		if (dirty_regb & (1 << (20+i)))
+			emith_ctx_op32_imm(0xc7, 0, 0x454+i*4, known_regs.pmac_read[i]);
+		if (dirty_regb & (1 << (25+i)))
+			emith_ctx_op32_imm(0xc7, 0, 0x46c+i*4, known_regs.pmac_write[i]);
+	}
+	dirty_regb &= ~0x3ff80000;
+}
+
+static void tr_ctx_write_imm32(int offs, u32 val)
+{
+	emith_ctx_op32_imm(0xc7, 0, offs, val);
+}
+
+/* read bank word to r0 (upper bits zero) */
+static void tr_bank_read(int addr) /* word addr 0-0x1ff */
+{
+	emith_read16_r_r_offs(xAX, CONTEXT_REG, addr << 1);
+	hostreg_r[0] = -1;
+}
+
+/* write r0 to bank */
+static void tr_bank_write(int addr)
+{
+	emith_write16_r_r_offs(xAX, CONTEXT_REG, addr << 1);
+}
+
+/* modify pr with modulo from ST. Trashes r1-r3 */
+static void tr_ptrr_mod_st(int r, int mod, int count)
+{
+	// ST low bits are always valid in context
+	emith_read8_r_r_offs(xCX, CONTEXT_REG, 0x400+SSP_ST*4+2);
+	emith_sub_r_imm(xCX, 1);
+	emith_and_r_imm(xCX, 7);
+	emith_add_r_imm(xCX, 1);		// 1-8, 0 (no modulo) becomes 8
+	emith_move_r_imm(xSI, 1);
+	EMIT_OP_MODRM(0xd3, 3, 4, xSI);		// shl esi, cl
+	emith_sub_r_imm(xSI, 1);		// modulo mask
+	emith_read8_r_r_offs(xDX, CONTEXT_REG, 0x440+r);
+	emith_lea_r_r_offs(xCX, xDX, (mod == 2) ? -count : count);
+	emith_eor_r_r(xCX, xDX);
+	emith_and_r_r(xCX, xSI);
+	emith_eor_r_r(xDX, xCX);		// (pr & ~mask) | (new & mask)
+	emith_write8_r_r_offs(xDX, CONTEXT_REG, 0x440+r);
+	hostreg_r[1] = hostreg_r[2] = hostreg_r[3] = -1;
+}
+
+/* modify pr with known modulo. Trashes r1,r2 if modulo is used */
+static void tr_ptrr_mod_const(int r, int mod, int modulo_shift, int count)
+{
+	if (modulo_shift == 8) {
+		// {add|sub} byte [ctx+pr], count
+		emith_ctx_op8_imm(0x80, (mod == 2) ? 5 : 0, 0x440+r, count);
+		return;
+	}
+	emith_read8_r_r_offs(xCX, CONTEXT_REG, 0x440+r);
+	emith_lea_r_r_offs(xDX, xCX, (mod == 2) ? -count : count);
+	emith_eor_r_r(xDX, xCX);
+	emith_and_r_imm(xDX, (1 << modulo_shift) - 1);
+	emith_eor_r_r(xCX, xDX);
+	emith_write8_r_r_offs(xCX, CONTEXT_REG, 0x440+r);
+	hostreg_r[1] = hostreg_r[2] = -1;
+}
+
+/* r1 = pr, word index into RAMx */
+static void tr_rX_ptr_to_r1(int r)
+{
+	emith_read8_r_r_offs(xCX, CONTEXT_REG, 0x440+r);
+}
+
+static void tr_r1_ptr_read(int r)
+{
+	emith_ctx_idx2_op(0x0fb7, xAX, xCX, (r & 4) ? 0x200 : 0);	// movzx eax, word [RAMx + ecx*2]
+}
+
+static void tr_r1_ptr_write(int r)
+{
+	EMIT(0x66, u8);
+	emith_ctx_idx2_op(0x89, xAX, xCX, (r & 4) ? 0x200 : 0);
+}
+
+/* r2 = r0 (PROGRAM index), r0++ */
+static void tr_prog_ptr_to_r2(void)
+{
+	emith_move_r_r(xDX, xAX);
+	emith_add_r_imm(xAX, 1);
+}
+
+static void tr_r2_ptr_read(void)
+{
+	emith_ctx_idx2_op(0x0fb7, xAX, xDX, CTX_OFFS(svp->iram_rom));
+}
+
+/* r0 = PROGRAM(r0) */
+static void tr_prog_read(void)
+{
+	emith_ctx_idx2_op(0x0fb7, xAX, xAX, CTX_OFFS(svp->iram_rom));
+}
+
+/* get x86 cond which would mean that SSP cond is satisfied. No trash. */
+static int tr_cond_check(int op)
+{
+	int f = (op & 0x100) >> 8;
+	switch (op&0xf0) {
+		case 0x00: return COND_AL;	/* always true */
+		case 0x50:			/* Z matches f(?) bit */
+			if (dirty_regb & KRREG_ST) {
+				emith_tst_r_r(HR_FLAGS, HR_FLAGS);
+				return f ? DCOND_EQ : DCOND_NE;
+			}
+			emith_ctx_op8_imm(0xf6, 0, 0x400+SSP_ST*4+3, SSP_FLAG_Z >> 8);
+			return f ? DCOND_NE : DCOND_EQ;
+		case 0x70:			/* N matches f(?) bit */
+			if (dirty_regb & KRREG_ST) {
+				emith_tst_r_r(HR_FLAGS, HR_FLAGS);
+				return f ? DCOND_MI : DCOND_PL;
+			}
+			emith_ctx_op8_imm(0xf6, 0, 0x400+SSP_ST*4+3, SSP_FLAG_N >> 8);
+			return f ? DCOND_NE : DCOND_EQ;
+		default:
+			elprintf(EL_ANOMALY, "unimplemented cond?\n");
+			tr_unhandled();
+			return 0;
+	}
+}
+
+// returns group 1 opcode extension
+static int tr_aop_ssp2host(int op)
+{
+	switch (op) {
+		case 1: return 5; // sub
+		case 3: return 7; // cmp
+		case 4: return 0; // add
+		case 5: return 4; // and
+		case 6: return 1; // or
+		case 7: return 6; // xor
+	}
+
+	tr_unhandled();
+	return 0;
+}
+
+// read general reg to r0
+static void tr_X_to_r0(int op)
+{
+	if (hostreg_r[0] != (SSP_X<<16)) {
+		emith_lsr(xAX, HR_XXYY, 16);
+		hostreg_r[0] = SSP_X<<16;
+	}
+}
+
+static void tr_Y_to_r0(int op)
+{
+	if (hostreg_r[0] != (SSP_Y<<16)) {
+		emith_op0f_r_r(0xb7, xAX, HR_XXYY);	// movzx eax, r12w
+		hostreg_r[0] = SSP_Y<<16;
+	}
+}
+
+static void tr_A_to_r0(int op)
+{
+	if (hostreg_r[0] != (SSP_A<<16)) {
+		emith_lsr(xAX, HR_A, 16);
+		hostreg_r[0] = SSP_A<<16;
+	}
+}
+
+static void tr_ST_to_r0(int op)
+{
+	tr_flush_dirty_ST();
+	emith_read16_r_r_offs(xAX, CONTEXT_REG, 0x400+SSP_ST*4+2);
+	hostreg_r[0] = -1;
+}
+
+static void tr_STACK_to_r0(int op)
+{
+	emith_read16_r_r_offs(xCX, CONTEXT_REG, 0x400+SSP_STACK*4+2);
+	emith_sub_r_imm(xCX, 1);
+	EMITH_JMP_START(DCOND_PL);
+	emith_move_r_imm(xCX, 5);		// underflow
+	EMITH_JMP_END(DCOND_PL);
+	emith_write16_r_r_offs(xCX, CONTEXT_REG, 0x400+SSP_STACK*4+2);
+	emith_ctx_idx2_op(0x0fb7, xAX, xCX, 0x448);	// stack[]
+	hostreg_r[0] = hostreg_r[1] = -1;
+}
+
+static void tr_P_to_r0(int op)
+{
+	tr_flush_dirty_P();
+	emith_lsr(xAX, HR_P, 16);
+	hostreg_r[0] = -1;
+}
+
+static void tr_AL_to_r0(int op)
+{
+	if (op == 0x000f) {
+		if (known_regb & KRREG_PMC) {
+			known_regs.emu_status &= ~(SSP_PMC_SET|SSP_PMC_HAVE_ADDR);
+		} else {
+			emith_ctx_op32_imm(0x81, 4, 0x484, ~(SSP_PMC_SET|SSP_PMC_HAVE_ADDR));
+		}
+	}
+
+	if (hostreg_r[0] != (SSP_AL<<16)) {
+		emith_op0f_r_r(0xb7, xAX, HR_A);	// movzx eax, bx
+		hostreg_r[0] = SSP_AL<<16;
+	}
+}
+
+static void tr_XST_to_r0(int op)
+{
+	emith_read16_r_r_offs(xAX, CONTEXT_REG, 0x400+SSP_XST*4+2);
+	hostreg_r[0] = -1;
+}
+
+/* r0 = ROM word at byte offset offs */
+static void tr_rom_to_r0(int offs)
+{
+	emith_read16_r_r_offs(xAX, CONTEXT_REG, CTX_OFFS(Pico.rom) + offs);
+}
+
+/* r0 = DRAM word at byte offset offs */
+static void tr_dram_to_r0(int offs)
+{
+	emith_read16_r_r_offs(xAX, CONTEXT_REG, CTX_OFFS(svp->dram) + offs);
+}
+
+/* if r0 == 0, the SSP is waiting for 68k */
+static void tr_wait_loop_check(int flag)
+{
+	emith_tst_r_r(xAX, xAX);
+	EMITH_JMP_START(DCOND_NE);
+	emith_sub_r_imm(HR_CYCLES, 1024);
+	emith_ctx_op32_imm(0x81, 1, 0x484, flag);	// or emu_status, flag
+	EMITH_JMP_END(DCOND_NE);
+}
+
+static void tr_pm_read_call(int reg)
+{
+	emith_move_r_imm(xDI, reg);
+	emith_call(ssp_pm_read);
+}
+
+/* PMC read with unknown PMC state. Trashes r1 */
+static void tr_PMC_read(int op)
+{
+	emith_ctx_read(xCX, 0x484);		// emu_status
+	if (op != 0x000e)
+		emith_read16_r_r_offs(xAX, CONTEXT_REG, 0x400+SSP_PMC*4);
+	emith_tst_r_imm(xCX, SSP_PMC_HAVE_ADDR);
+	EMITH_SJMP3_START(DCOND_NE);
+	emith_or_r_imm(xCX, SSP_PMC_HAVE_ADDR);
+	EMITH_SJMP3_MID(DCOND_NE);
+	emith_and_r_imm(xCX, ~SSP_PMC_HAVE_ADDR);
+	emith_or_r_imm(xCX, SSP_PMC_SET);
+	EMITH_SJMP3_END();
+	emith_ctx_write(xCX, 0x484);
+}
+
+// write r0 to general reg handlers. Trashes r1
+#define TR_WRITE_R0_TO_REG(reg) \
+{ \
+	hostreg_sspreg_changed(reg); \
+	hostreg_r[0] = (reg)<<16; \
+	if (const_val != -1) { \
+		known_regs.gr[reg].h = const_val; \
+		known_regb |= 1 << (reg); \
+	} else { \
+		known_regb &= ~(1 << (reg)); \
+	} \
+}
+
+static void tr_r0_to_X(int const_val)
+{
+	emith_and_r_imm(HR_XXYY, 0xffff);
+	emith_lsl(xCX, xAX, 16);
+	emith_or_r_r(HR_XXYY, xCX);
+	hostreg_r[1] = -1;
+	dirty_regb |= KRREG_P;			// touching X or Y makes P dirty.
+	TR_WRITE_R0_TO_REG(SSP_X);
+}
+
+static void tr_r0_to_Y(int const_val)
+{
+	emith_and_r_imm(HR_XXYY, 0xffff0000);
+	emith_op0f_r_r(0xb7, xCX, xAX);		// movzx ecx, ax
+	emith_or_r_r(HR_XXYY, xCX);
+	hostreg_r[1] = -1;
+	dirty_regb |= KRREG_P;
+	TR_WRITE_R0_TO_REG(SSP_Y);
+}
+
+static void tr_r0_to_A(int const_val)
+{
+	if (tr_predict_al_need()) {
+		emith_and_r_imm(HR_A, 0xffff);	// keep AL
+		emith_lsl(xCX, xAX, 16);
+		emith_or_r_r(HR_A, xCX);
+		hostreg_r[1] = -1;
+	}
+	else
+		emith_lsl(HR_A, xAX, 16);
+	TR_WRITE_R0_TO_REG(SSP_A);
+}
+
+static void tr_r0_to_ST(int const_val)
+{
+	emith_write16_r_r_offs(xAX, CONTEXT_REG, 0x400+SSP_ST*4+2);
+	TR_WRITE_R0_TO_REG(SSP_ST);
+	dirty_regb &= ~KRREG_ST;
+}
+
+static void tr_r0_to_STACK(int const_val)
+{
+	emith_read16_r_r_offs(xCX, CONTEXT_REG, 0x400+SSP_STACK*4+2);
+	emith_cmp_r_imm(xCX, 6);
+	EMITH_JMP_START(DCOND_LO);
+	emith_eor_r_r(xCX, xCX);		// overflow
+	EMITH_JMP_END(DCOND_LO);
+	EMIT(0x66, u8);
+	emith_ctx_idx2_op(0x89, xAX, xCX, 0x448);	// stack[]
+	emith_add_r_imm(xCX, 1);
+	emith_write16_r_r_offs(xCX, CONTEXT_REG, 0x400+SSP_STACK*4+2);
+	hostreg_r[1] = -1;
+}
+
+static void tr_r0_to_AL(int const_val)
+{
+	emith_and_r_imm(HR_A, 0xffff0000);
+	emith_op0f_r_r(0xb7, xCX, xAX);		// movzx ecx, ax
+	emith_or_r_r(HR_A, xCX);
+	hostreg_r[1] = -1;
+	hostreg_sspreg_changed(SSP_AL);
+	if (const_val != -1) {
+		known_regs.gr[SSP_A].l = const_val;
+		known_regb |= KRREG_AL;
+	} else
+		known_regb &= ~KRREG_AL;
+}
+
+/* write r0 to DRAM at byte offset offs */
+static void tr_r0_to_dram(int offs)
+{
+	emith_write16_r_r_offs(xAX, CONTEXT_REG, CTX_OFFS(svp->dram) + offs);
+}
+
+/* write r0 to IRAM at byte offset offs */
+static void tr_r0_to_iram(int offs)
+{
+	emith_write16_r_r_offs(xAX, CONTEXT_REG, CTX_OFFS(svp->iram_rom) + offs);
+	emith_ctx_op32_imm(0xc7, 0, 0x494, 1);	// iram_dirty
+}
+
+static void tr_pm_write_call(int reg)
+{
+	emith_move_r_r(xDI, xAX);
+	emith_move_r_imm(xSI, reg);
+	emith_call(ssp_pm_write);
+}
+
+/* PMC write with unknown PMC state. Trashes r1 */
+static void tr_PMC_write(void)
+{
+	emith_ctx_read(xCX, 0x484);		// emu_status
+	emith_tst_r_imm(xCX, SSP_PMC_HAVE_ADDR);
+	EMITH_SJMP3_START(DCOND_NE);
+	emith_write16_r_r_offs(xAX, CONTEXT_REG, 0x400+SSP_PMC*4);
+	emith_or_r_imm(xCX, SSP_PMC_HAVE_ADDR);
+	EMITH_SJMP3_MID(DCOND_NE);
+	emith_write16_r_r_offs(xAX, CONTEXT_REG, 0x400+SSP_PMC*4+2);
+	emith_and_r_imm(xCX, ~SSP_PMC_HAVE_ADDR);
+	emith_or_r_imm(xCX, SSP_PMC_SET);
+	EMITH_SJMP3_END();
+	emith_ctx_write(xCX, 0x484);
+}
+
+static void tr_rX_read(int r, int mod);
+
+static void tr_mac_load_XY(int op)
+{
+	tr_rX_read(op&3, (op>>2)&3); // X
+	emith_lsl(HR_XXYY, xAX, 16);
+	tr_rX_read(((op>>4)&3)|4, (op>>6)&3); // Y
+	emith_or_r_r(HR_XXYY, xAX);
+	dirty_regb |= KRREG_P;
+	hostreg_sspreg_changed(SSP_X);
+	hostreg_sspreg_changed(SSP_Y);
+	known_regb &= ~KRREG_X;
+	known_regb &= ~KRREG_Y;
+}
+
+static void tr_P_to_A(void)
+{
+	emith_move_r_r(HR_A, HR_P);
+}
+
+/* r0 = pr */
+static void tr_ri_to_r0(int r)
+{
+	emith_read8_r_r_offs(xAX, CONTEXT_REG, 0x440+r);
+}
+
+/* pr = r0 & 0xff */
+static void tr_r0_to_ri(int r)
+{
+	emith_write8_r_r_offs(xAX, CONTEXT_REG, 0x440+r);
+}
+
+/* conditional call, r0 = new PC. returns cond */
+static int tr_call(int op, int pc, int imm)
+{
+	u8 *jump_ptr = NULL;
+	int cond;
+
+	tr_mov16(0, pc);
+	cond = tr_cond_check(op);
+	if (cond != COND_AL) {
+		JMP8_POS(jump_ptr);
+	}
+	tr_r0_to_STACK(pc);
+	emith_move_r_imm(xAX, imm);
+	if (cond != COND_AL) {
+		JMP8_EMIT(tr_neg_cond(cond), jump_ptr);
+	}
+	hostreg_r[0] = -1;
+	return cond;
+}
+
+/* mod cond, op */
+static void tr_mod(int op, int count)
+{
+	u8 *jump_ptr = NULL;
+	int cond = tr_cond_check(op);
+
+	if (cond != COND_AL) {
+		JMP8_POS(jump_ptr);
+	}
+	switch (op & 7) {
+		case 2: emith_asr(HR_A, HR_A, count); break; // shr (arithmetic)
+		case 3: emith_lsl(HR_A, HR_A, count); break; // shl
+		case 6: emith_neg_r(HR_A); break; // neg
+		case 7: emith_asr(xCX, HR_A, 31); // abs
+			emith_eor_r_r(HR_A, xCX);
+			emith_sub_r_r(HR_A, xCX);
+			hostreg_r[1] = -1; break;
+		default: tr_unhandled();
+	}
+	emith_move_r_r(HR_FLAGS, HR_A);
+	if (cond != COND_AL && !(dirty_regb & KRREG_ST)) {
+		// r15 is not valid if skipped, so flush here
+		dirty_regb |= KRREG_ST;
+		tr_flush_dirty_ST();
+	}
+	else
+		dirty_regb |= KRREG_ST;
+	if (cond != COND_AL) {
+		JMP8_EMIT(tr_neg_cond(cond), jump_ptr);
+	}
+}
+
+/* A -= P or A += P, sets flags */
+static void tr_A_add_P(int sub)
+{
+	if (sub)
+	     emith_sub_r_r(HR_A, HR_P);
+	else emith_add_r_r(HR_A, HR_P);
+	emith_move_r_r(HR_FLAGS, HR_A);
+}
+
+/* A = 0, sets flags */
+static void tr_A_clear(void)
+{
+	emith_eor_r_r(HR_A, HR_A);
+	emith_eor_r_r(HR_FLAGS, HR_FLAGS);
+}
+
+// OPs A, <src>; cmp only sets flags
+static void tr_aop_r(int op, int r)
+{
+	if (op == 7) {
+		emith_move_r_r(HR_FLAGS, HR_A);
+		emith_sub_r_r(HR_FLAGS, r);
+	} else {
+		EMIT_OP_MODRM((op << 3) | 1, 3, r, HR_A); // OP ebx, r
+		emith_move_r_r(HR_FLAGS, HR_A);
+	}
+}
+
+static void tr_aop_r0(int op)
+{
+	emith_lsl(xCX, xAX, 16);
+	tr_aop_r(op, xCX);
+	hostreg_r[1] = -1;
+}
+
+static void tr_aop_P(int op)
+{
+	tr_aop_r(op, HR_P);
+}
+
+static void tr_aop_A(int op)
+{
+	tr_aop_r(op, HR_A);
+}
+
+static void tr_aop_imm(int op, int imm8)
+{
+	if (op == 7) {
+		emith_move_r_r(HR_FLAGS, HR_A);
+		emith_sub_r_imm(HR_FLAGS, imm8 << 16);
+	} else {
+		emith_arith_r_imm(op, HR_A, imm8 << 16);
+		emith_move_r_r(HR_FLAGS, HR_A);
+	}
+}
+
+// ldi ST, 60h
+static void tr_ST_write_60(void)
+{
+	EMIT(0x66, u8);
+	emith_deref_op(0xc7, 0, CONTEXT_REG, 0x400+SSP_ST*4+2);
+	EMIT(0x60, u16);
+}
+
+/* r0 = (r0 << 4) | (r0 >> 12), low 16 bits */
+static void tr_r0_rol4(void)
+{
+	emith_lsl(xAX, xAX, 4);
+	emith_lsr(xCX, xAX, 16);
+	emith_or_r_r(xAX, xCX);
+	hostreg_r[1] = -1;
+}
+
+static void emit_block_prologue(void)
+{
+	// check if there are enough cycles..
+	// note: eax must contain PC of current block
+	emith_cmp_r_imm(HR_CYCLES, 0);
+	emith_jump_cond(DCOND_LE, ssp_drc_end);
+}
+
+/* cond:
+ * >0: direct (un)conditional jump
+ * <0: indirect jump
+ */
+static void *emit_block_epilogue(int cycles, int cond, int pc, int end_pc)
+{
+	void *end_ptr = NULL;
+
+	if (cycles > 0xff) {
+		elprintf(EL_ANOMALY, "large cycle count: %i\n", cycles);
+		cycles = 0xff;
+	}
+	emith_sub_r_imm(HR_CYCLES, cycles);
+
+	if (cond < 0 || (end_pc >= 0x400 && pc < 0x400)) {
+		// indirect jump, or rom -> iram jump, must use dispatcher
+		emith_jump(ssp_drc_next);
+	}
+	else if (cond == COND_AL) {
+		void *target = (pc < 0x400) ?
+			ssp_block_table_iram[ssp->drc.iram_context * SSP_BLOCKTAB_IRAM_ONE + pc] :
+			ssp_block_table[pc];
+		if (target != NULL)
+			emith_jump(target);
+		else {
+			emith_jump(ssp_drc_next);
+			end_ptr = tcache_ptr;
+			// cause the next block to be emitted over jump instruction
+			tcache_ptr -= 5;
+		}
+	}
+	else {
+		void *target1 = (pc     < 0x400) ?
+			ssp_block_table_iram[ssp->drc.iram_context * SSP_BLOCKTAB_IRAM_ONE + pc] :
+			ssp_block_table[pc];
+		void *target2 = (end_pc < 0x400) ?
+			ssp_block_table_iram[ssp->drc.iram_context * SSP_BLOCKTAB_IRAM_ONE + end_pc] :
+			ssp_block_table[end_pc];
+		// host flags are gone by now, but eax holds the taken PC
+		emith_cmp_r_imm(xAX, pc);
+		// calls to ssp_drc_next_patch get patched to jumps
+		if (target1 != NULL)
+			emith_jump_cond(DCOND_EQ, target1);
+		else {
+			EMITH_JMP_START(DCOND_NE);
+			emith_call(ssp_drc_next_patch);
+			EMITH_JMP_END(DCOND_NE);
+		}
+		if (target2 != NULL)
+			emith_jump(target2);
+		else
+			emith_call(ssp_drc_next_patch);
+	}
+
+	if (end_ptr == NULL)
+		end_ptr = tcache_ptr;
+
+	return end_ptr;
+}
+
+
+/* write dirty pr and "forget" it. Nothing is trashed. */
+static void tr_release_pr(int r)
+{
+	tr_flush_dirty_pr(r);
+	known_regb &= ~(1 << (r+8));
+}
+
+/* handle RAM bank pointer modifiers. if need_modulo, trash r1-r3, else nothing */
+static void tr_ptrr_mod(int r, int mod, int need_modulo, int count)
+{
+	int modulo_shift = -1;	/* unknown */
+
+	if (mod == 0) return;
+
+	if (!need_modulo || mod == 1) // +!
+		modulo_shift = 8;
+	else if (need_modulo && (known_regb & KRREG_ST)) {
+		modulo_shift = known_regs.gr[SSP_ST].h & 7;
+		if (modulo_shift == 0) modulo_shift = 8;
+	}
+
+	if (modulo_shift == -1)
+	{
+		tr_release_pr(r);
+		tr_ptrr_mod_st(r, mod, count);
+	}
+	else if (known_regb & (1 << (r + 8)))
+	{
+		int modulo = (1 << modulo_shift) - 1;
+		if (mod == 2)
+		     known_regs.r[r] = (known_regs.r[r] & ~modulo) | ((known_regs.r[r] - count) & modulo);
+		else known_regs.r[r] = (known_regs.r[r] & ~modulo) | ((known_regs.r[r] + count) & modulo);
+	}
+	else
+	{
+		tr_ptrr_mod_const(r, mod, modulo_shift, count);
+	}
+}
+
+/* handle writes r0 to (rX). Trashes r1.
+ * fortunately we can ignore modulo increment modes for writes. */
+static void tr_rX_write(int op)
+{
+	if ((op&3) == 3)
+	{
+		int mod = (op>>2) & 3; // direct addressing
+		tr_bank_write((op & 0x100) + mod);
+	}
+	else
+	{
+		int r = (op&3) | ((op>>6)&4);
+		if (known_regb & (1 << (r + 8))) {
+			tr_bank_write((op&0x100) | known_regs.r[r]);
+		} else {
+			tr_rX_ptr_to_r1(r);
+			tr_r1_ptr_write(r);
+			hostreg_r[1] = -1;
+		}
+		tr_ptrr_mod(r, (op>>2) & 3, 0, 1);
+	}
+}
+
+/* read (rX) to r0. Trashes r1-r3. */
+static void tr_rX_read(int r, int mod)
+{
+	if ((r&3) == 3)
+	{
+		tr_bank_read(((r << 6) & 0x100) + mod); // direct addressing
+	}
+	else
+	{
+		if (known_regb & (1 << (r + 8))) {
+			tr_bank_read(((r << 6) & 0x100) | known_regs.r[r]);
+		} else {
+			tr_rX_ptr_to_r1(r);
+			tr_r1_ptr_read(r);
+			hostreg_r[0] = hostreg_r[1] = -1;
+		}
+		tr_ptrr_mod(r, mod, 1, 1);
+	}
+}
+
+/* read ((rX)) to r0. Trashes r1,r2. */
+static void tr_rX_read2(int op)
+{
+	int r = (op&3) | ((op>>6)&4); // src
+
+	if ((r&3) == 3) {
+		tr_bank_read((op&0x100) | ((op>>2)&3));
+	} else if (known_regb & (1 << (r+8))) {
+		tr_bank_read((op&0x100) | known_regs.r[r]);
+	} else {
+		tr_rX_ptr_to_r1(r);
+		tr_r1_ptr_read(r);
+	}
+	tr_prog_ptr_to_r2();
+	if ((r&3) == 3) {
+		tr_bank_write((op&0x100) | ((op>>2)&3));
+	} else if (known_regb & (1 << (r+8))) {
+		tr_bank_write((op&0x100) | known_regs.r[r]);
+	} else {
+		tr_r1_ptr_write(r);
+		hostreg_r[1] = -1;
+	}
+	tr_r2_ptr_read();
+	hostreg_r[0] = hostreg_r[2] = -1;
+}
+
+// -----------------------------------------------------
+
+// read general reg to r0. Trashes r1
+static void tr_GR0_to_r0(int op)
+{
+	tr_mov16(0, 0xffff);
+}
+
+static void tr_PC_to_r0(int op)
+{
+	tr_mov16(0, known_regs.gr[SSP_PC].h);
+}
+
+static void tr_PMX_to_r0(int reg)
+{
+	if ((known_regb & KRREG_PMC) && (known_regs.emu_status & SSP_PMC_SET))
+	{
+		known_regs.pmac_read[reg] = known_regs.pmc.v;
+		known_regs.emu_status &= ~SSP_PMC_SET;
+		known_regb |= 1 << (20+reg);
+		dirty_regb |= 1 << (20+reg);
+		return;
+	}
+
+	if ((known_regb & KRREG_PMC) && (known_regb & (1 << (20+reg))))
+	{
+		u32 pmcv = known_regs.pmac_read[reg];
+		int mode = pmcv>>16;
+		known_regs.emu_status &= ~SSP_PMC_HAVE_ADDR;
+
+		if      ((mode & 0xfff0) == 0x0800)
+		{
+			tr_rom_to_r0((pmcv&0xfffff)<<1);
+			known_regs.pmac_read[reg] += 1;
+		}
+		else if ((mode & 0x47ff) == 0x0018) // DRAM
+		{
+			int inc = get_inc(mode);
+			tr_dram_to_r0((pmcv&0xffff)<<1);
+			if (reg == 4 && (pmcv == 0x187f03 || pmcv == 0x187f04)) // wait loop detection
+			{
+				int flag = (pmcv == 0x187f03) ? SSP_WAIT_30FE06 : SSP_WAIT_30FE08;
+				tr_wait_loop_check(flag);
+			}
+			known_regs.pmac_read[reg] += inc;
+		}
+		else
+		{
+			tr_unhandled();
+		}
+		known_regs.pmc.v = known_regs.pmac_read[reg];
+		//known_regb |= KRREG_PMC;
+		dirty_regb |= KRREG_PMC;
+		dirty_regb |= 1 << (20+reg);
+		hostreg_r[0] = hostreg_r[1] = -1;
+		return;
+	}
+
+	// C code needs the current address
+	if (dirty_regb & (1 << (20+reg)))
+		tr_ctx_write_imm32(0x454+reg*4, known_regs.pmac_read[reg]);
+	known_regb &= ~KRREG_PMC;
+	dirty_regb &= ~KRREG_PMC;
+	known_regb &= ~(1 << (20+reg));
+	dirty_regb &= ~(1 << (20+reg));
+
+	// call the C code to handle this
+	//tr_flush_dirty_pmcrs();
+	tr_pm_read_call(reg);
+	hostreg_clear();
+}
+
+static void tr_PM0_to_r0(int op)
+{
+	tr_PMX_to_r0(0);
+}
+
+static void tr_PM1_to_r0(int op)
+{
+	tr_PMX_to_r0(1);
+}
+
+static void tr_PM2_to_r0(int op)
+{
+	tr_PMX_to_r0(2);
+}
+
+static void tr_PM4_to_r0(int op)
+{
+	tr_PMX_to_r0(4);
+}
+
+static void tr_PMC_to_r0(int op)
+{
+	if (known_regb & KRREG_PMC)
+	{
+		if (known_regs.emu_status & SSP_PMC_HAVE_ADDR) {
+			known_regs.emu_status |= SSP_PMC_SET;
+			known_regs.emu_status &= ~SSP_PMC_HAVE_ADDR;
+			// do nothing - this is handled elsewhere
+		} else {
+			tr_mov16(0, known_regs.pmc.l);
+			known_regs.emu_status |= SSP_PMC_HAVE_ADDR;
+		}
+	}
+	else
+	{
+		tr_PMC_read(op);
+		hostreg_r[0] = hostreg_r[1] = -1;
+	}
+}
+
+
+typedef void (tr_read_func)(int op);
+
+static tr_read_func *tr_read_funcs[16] =
+{
+	tr_GR0_to_r0,
+	tr_X_to_r0,
+	tr_Y_to_r0,
+	tr_A_to_r0,
+	tr_ST_to_r0,
+	tr_STACK_to_r0,
+	tr_PC_to_r0,
+	tr_P_to_r0,
+	tr_PM0_to_r0,
+	tr_PM1_to_r0,
+	tr_PM2_to_r0,
+	tr_XST_to_r0,
+	tr_PM4_to_r0,
+	(tr_read_func *)tr_unhandled,
+	tr_PMC_to_r0,
+	tr_AL_to_r0
+};
+
+
+// write r0 to general reg handlers. Trashes r1
+static void tr_r0_to_GR0(int const_val)
+{
+	// do nothing
+}
+
+static void tr_r0_to_PC(int const_val)
+{
+/*
+ * do nothing - dispatcher will take care of this
+	EOP_MOV_REG_LSL(1, 0, 16);		// mov  r1, r0, lsl #16
+	EOP_STR_IMM(1,7,0x400+6*4);		// str  r1, [r7, #(0x400+6*8)]
+	hostreg_r[1] = -1;
+*/
+}
+
+static void tr_r0_to_PMX(int reg)
+{
+	if ((known_regb & KRREG_PMC) && (known_regs.emu_status & SSP_PMC_SET))
+	{
+		known_regs.pmac_write[reg] = known_regs.pmc.v;
+		known_regs.emu_status &= ~SSP_PMC_SET;
+		known_regb |= 1 << (25+reg);
+		dirty_regb |= 1 << (25+reg);
+		return;
+	}
+
+	if ((known_regb & KRREG_PMC) && (known_regb & (1 << (25+reg))))
+	{
+		int mode, addr;
+
+		known_regs.emu_status &= ~SSP_PMC_HAVE_ADDR;
+
+		mode = known_regs.pmac_write[reg]>>16;
+		addr = known_regs.pmac_write[reg]&0xffff;
+		if      ((mode & 0x43ff) == 0x0018) // DRAM
+		{
+			int inc = get_inc(mode);
+			if (mode & 0x0400) tr_unhandled();
+			tr_r0_to_dram(addr << 1);
+			known_regs.pmac_write[reg] += inc;
+		}
+		else if ((mode & 0xfbff) == 0x4018) // DRAM, cell inc
+		{
+			if (mode & 0x0400) tr_unhandled();
+			tr_r0_to_dram(addr << 1);
+			known_regs.pmac_write[reg] += (addr&1) ? 31 : 1;
+		}
+		else if ((mode & 0x47ff) == 0x001c) // IRAM
+		{
+			int inc = get_inc(mode);
+			tr_r0_to_iram((addr&0x3ff) << 1);
+			known_regs.pmac_write[reg] += inc;
+		}
+		else
+			tr_unhandled();
+
+		known_regs.pmc.v = known_regs.pmac_write[reg];
+		//known_regb |= KRREG_PMC;
+		dirty_regb |= KRREG_PMC;
+		dirty_regb |= 1 << (25+reg);
+		hostreg_r[1] = hostreg_r[2] = -1;
+		return;
+	}
+
+	// C code needs the current address
+	if (dirty_regb & (1 << (25+reg)))
+		tr_ctx_write_imm32(0x46c+reg*4, known_regs.pmac_write[reg]);
+	known_regb &= ~KRREG_PMC;
+	dirty_regb &= ~KRREG_PMC;
+	known_regb &= ~(1 << (25+reg));
+	dirty_regb &= ~(1 << (25+reg));
+
+	// call the C code to handle this
+	//tr_flush_dirty_pmcrs();
+	tr_pm_write_call(reg);
+	hostreg_clear();
+}
+
+static void tr_r0_to_PM0(int const_val)
+{
+	tr_r0_to_PMX(0);
+}
+
+static void tr_r0_to_PM1(int const_val)
+{
+	tr_r0_to_PMX(1);
+}
+
+static void tr_r0_to_PM2(int const_val)
+{
+	tr_r0_to_PMX(2);
+}
+
+static void tr_r0_to_PM4(int const_val)
+{
+	tr_r0_to_PMX(4);
+}
+
+static void tr_r0_to_PMC(int const_val)
+{
+	if ((known_regb & KRREG_PMC) && const_val != -1)
+	{
+		if (known_regs.emu_status & SSP_PMC_HAVE_ADDR) {
+			known_regs.emu_status |= SSP_PMC_SET;
+			known_regs.emu_status &= ~SSP_PMC_HAVE_ADDR;
+			known_regs.pmc.h = const_val;
+		} else {
+			known_regs.emu_status |= SSP_PMC_HAVE_ADDR;
+			known_regs.pmc.l = const_val;
+		}
+	}
+	else
+	{
+		tr_flush_dirty_ST();
+		if (known_regb & KRREG_PMC) {
+			tr_ctx_write_imm32(0x400+SSP_PMC*4, known_regs.pmc.v);
+			known_regb &= ~KRREG_PMC;
+			dirty_regb &= ~KRREG_PMC;
+		}
+		tr_PMC_write();
+		hostreg_r[1] = hostreg_r[2] = -1;
+	}
+}
+
+typedef void (tr_write_func)(int const_val);
+
+static tr_write_func *tr_write_funcs[16] =
+{
+	tr_r0_to_GR0,
+	tr_r0_to_X,
+	tr_r0_to_Y,
+	tr_r0_to_A,
+	tr_r0_to_ST,
+	tr_r0_to_STACK,
+	tr_r0_to_PC,
+	(tr_write_func *)tr_unhandled,
+	tr_r0_to_PM0,
+	tr_r0_to_PM1,
+	tr_r0_to_PM2,
+	(tr_write_func *)tr_unhandled,
+	tr_r0_to_PM4,
+	(tr_write_func *)tr_unhandled,
+	tr_r0_to_PMC,
+	tr_r0_to_AL
+};
+
+// -----------------------------------------------------
+
+static int tr_detect_set_pm(unsigned int op, int *pc, int imm)
+{
+	u32 pmcv, tmpv;
+	if (!((op&0xfef0) == 0x08e0 && (PROGRAM(*pc)&0xfef0) == 0x08e0)) return 0;
+
+	// programming PMC:
+	// ldi PMC, imm1
+	// ldi PMC, imm2
+	(*pc)++;
+	pmcv = imm | (PROGRAM((*pc)++) << 16);
+	known_regs.pmc.v = pmcv;
+	known_regb |= KRREG_PMC;
+	dirty_regb |= KRREG_PMC;
+	known_regs.emu_status |= SSP_PMC_SET;
+	n_in_ops++;
+
+	// check for possible reg programming
+	tmpv = PROGRAM(*pc);
+	if ((tmpv & 0xfff8) == 0x08 || (tmpv & 0xff8f) == 0x80)
+	{
+		int is_write = (tmpv & 0xff8f) == 0x80;
+		int reg = is_write ? ((tmpv>>4)&0x7) : (tmpv&0x7);
+		if (reg > 4) tr_unhandled();
+		if ((tmpv & 0x0f) != 0 && (tmpv & 0xf0) != 0) tr_unhandled();
+		if (is_write)
+			known_regs.pmac_write[reg] = pmcv;
+		else
+			known_regs.pmac_read[reg] = pmcv;
+		known_regb |= is_write ? (1 << (reg+25)) : (1 << (reg+20));
+		dirty_regb |= is_write ? (1 << (reg+25)) : (1 << (reg+20));
+		known_regs.emu_status &= ~SSP_PMC_SET;
+		(*pc)++;
+		n_in_ops++;
+		return 5;
+	}
+
+	tr_unhandled();
+	return 4;
+}
+
+static const short pm0_block_seq[] = { 0x0880, 0, 0x0880, 0, 0x0840, 0x60 };
+
+static int tr_detect_pm0_block(unsigned int op, int *pc, int imm)
+{
+	// ldi ST, 0
+	// ldi PM0, 0
+	// ldi PM0, 0
+	// ldi ST, 60h
+	unsigned short *pp;
+	if (op != 0x0840 || imm != 0) return 0;
+	pp = PROGRAM_P(*pc);
+	if (memcmp(pp, pm0_block_seq, sizeof(pm0_block_seq)) != 0) return 0;
+
+	tr_ST_write_60();
+	hostreg_sspreg_changed(SSP_ST);
+	known_regs.gr[SSP_ST].h = 0x60;
+	known_regb |= 1 << SSP_ST;
+	dirty_regb &= ~KRREG_ST;
+	(*pc) += 3*2;
+	n_in_ops += 3;
+	return 4*2;
+}
+
+static int tr_detect_rotate(unsigned int op, int *pc, int imm)
+{
+	// @ 3DA2 and 426A
+	// ld PMC, (r3|00)
+	// ld (r3|00), PMC
+	// ld -, AL
+	if (op != 0x02e3 || PROGRAM(*pc) != 0x04e3 || PROGRAM(*pc + 1) != 0x000f) return 0;
+
+	tr_bank_read(0);
+	tr_r0_rol4();
+	tr_bank_write(0);
+	(*pc) += 2;
+	n_in_ops += 2;
+	return 3;
+}
+
+// -----------------------------------------------------
+
+static int translate_op(unsigned int op, int *pc, int imm, int *end_cond, int *jump_pc)
+{
+	u32 tmpv, tmpv2;
+	int ret = 0;
+	known_regs.gr[SSP_PC].h = *pc;
+
+	switch (op >> 9)
+	{
+		// ld d, s
+		case 0x00:
+			if (op == 0) { ret++; break; } // nop
+			tmpv  = op & 0xf; // src
+			tmpv2 = (op >> 4) & 0xf; // dst
+			if (tmpv2 == SSP_A && tmpv == SSP_P) { // ld A, P
+				tr_flush_dirty_P();
+				tr_P_to_A();
+				hostreg_sspreg_changed(SSP_A);
+				known_regb &= ~(KRREG_A|KRREG_AL);
+				ret++; break;
+			}
+			tr_read_funcs[tmpv](op);
+			tr_write_funcs[tmpv2](tr_known_gr(tmpv));
+			if (tmpv2 == SSP_PC) {
+				ret |= 0x10000;
+				*end_cond = -COND_AL;
+			}
+			ret++; break;
+
+		// ld d, (ri)
+		case 0x01: {
+			int r = (op&3) | ((op>>6)&4);
+			int mod = (op>>2)&3;
+			tmpv = (op >> 4) & 0xf; // dst
+			ret = tr_detect_rotate(op, pc, imm);
+			if (ret > 0) break;
+			if (tmpv != 0)
+				tr_rX_read(r, mod);
+			else {
+				int cnt = 1;
+				while (PROGRAM(*pc) == op) {
+					(*pc)++; cnt++; ret++;
+					n_in_ops++;
+				}
+				tr_ptrr_mod(r, mod, 1, cnt); // skip
+			}
+			tr_write_funcs[tmpv](-1);
+			if (tmpv == SSP_PC) {
+				ret |= 0x10000;
+				*end_cond = -COND_AL;
+			}
+			ret++; break;
+		}
+
+		// ld (ri), s
+		case 0x02:
+			tmpv = (op >> 4) & 0xf; // src
+			tr_read_funcs[tmpv](op);
+			tr_rX_write(op);
+			ret++; break;
+
+		// ld a, adr
+		case 0x03:
+			tr_bank_read(op&0x1ff);
+			tr_r0_to_A(-1);
+			ret++; break;
+
+		// ldi d, imm
+		case 0x04:
+			tmpv = (op & 0xf0) >> 4; // dst
+			ret = tr_detect_pm0_block(op, pc, imm);
+			if (ret > 0) break;
+			ret = tr_detect_set_pm(op, pc, imm);
+			if (ret > 0) break;
+			tr_mov16(0, imm);
+			tr_write_funcs[tmpv](imm);
+			if (tmpv == SSP_PC) {
+				ret |= 0x10000;
+				*jump_pc = imm;
+			}
+			ret += 2; break;
+
+		// ld d, ((ri))
+		case 0x05:
+			tmpv2 = (op >> 4) & 0xf;  // dst
+			tr_rX_read2(op);
+			tr_write_funcs[tmpv2](-1);
+			if (tmpv2 == SSP_PC) {
+				ret |= 0x10000;
+				*end_cond = -COND_AL;
+			}
+			ret += 3; break;
+
+		// ldi (ri), imm
+		case 0x06:
+			tr_mov16(0, imm);
+			tr_rX_write(op);
+			ret += 2; break;
+
+		// ld adr, a
+		case 0x07:
+			tr_A_to_r0(op);
+			tr_bank_write(op&0x1ff);
+			ret++; break;
+
+		// ld d, ri
+		case 0x09: {
+			int r;
+			r = (op&3) | ((op>>6)&4); // src
+			tmpv2 = (op >> 4) & 0xf;  // dst
+			if ((r&3) == 3) tr_unhandled();
+
+			if (known_regb & (1 << (r+8))) {
+				tr_mov16(0, known_regs.r[r]);
+				tr_write_funcs[tmpv2](known_regs.r[r]);
+			} else {
+				tr_ri_to_r0(r);
+				hostreg_r[0] = -1;
+				tr_write_funcs[tmpv2](-1);
+			}
+			ret++; break;
+		}
+
+		// ld ri, s
+		case 0x0a: {
+			int r;
+			r = (op&3) | ((op>>6)&4); // dst
+			tmpv = (op >> 4) & 0xf;   // src
+			if ((r&3) == 3) tr_unhandled();
+
+			if (tr_known_gr(tmpv) != -1) {
+				known_regs.r[r] = tr_known_gr(tmpv);
+				known_regb |= 1 << (r + 8);
+				dirty_regb |= 1 << (r + 8);
+			} else {
+				tr_read_funcs[tmpv](op);
+				tr_r0_to_ri(r);
+				hostreg_r[0] = -1;
+				known_regb &= ~(1 << (r+8));
+				dirty_regb &= ~(1 << (r+8));
+			}
+			ret++; break;
+		}
+
+		// ldi ri, simm
+		case 0x0c: case 0x0d: case 0x0e: case 0x0f:
+			tmpv = (op>>8)&7;
+			known_regs.r[tmpv] = op;
+			known_regb |= 1 << (tmpv + 8);
+			dirty_regb |= 1 << (tmpv + 8);
+			ret++; break;
+
+		// call cond, addr
+		case 0x24:
+			tmpv = tr_call(op, *pc, imm);
+			tr_r0_to_PC(tmpv == COND_AL ? imm : -1);
+			ret |= 0x10000;
+			*end_cond = tmpv;
+			*jump_pc = imm;
+			ret += 2; break;
+
+		// ld d, (a)
+		case 0x25:
+			tmpv2 = (op >> 4) & 0xf;  // dst
+			tr_A_to_r0(op);
+			tr_prog_read();
+			hostreg_r[0] = hostreg_r[1] = -1;
+			tr_write_funcs[tmpv2](-1);
+			if (tmpv2 == SSP_PC) {
+				ret |= 0x10000;
+				*end_cond = -COND_AL;
+			}
+			ret += 3; break;
+
+		// bra cond, addr
+		case 0x26:
+			tmpv = tr_cond_check(op);
+			tr_mov16_cond(tmpv, 0, imm);
+			if (tmpv != COND_AL)
+				tr_mov16_cond(tr_neg_cond(tmpv), 0, *pc);
+			tr_r0_to_PC(tmpv == COND_AL ? imm : -1);
+			ret |= 0x10000;
+			*end_cond = tmpv;
+			*jump_pc = imm;
+			ret += 2; break;
+
+		// mod cond, op
+		case 0x48: {
+			// check for repeats of this op
+			// (conditional ones may change their own condition)
+			tmpv = 1; // count
+			while (PROGRAM(*pc) == op && (op & 7) != 6 && (op & 0xf0) == 0) {
+				(*pc)++; tmpv++;
+				n_in_ops++;
+			}
+			tr_mod(op, tmpv);
+			hostreg_sspreg_changed(SSP_A);
+			known_regb &= ~KRREG_ST;
+			known_regb &= ~(KRREG_A|KRREG_AL);
+			ret += tmpv; break;
+		}
+
+		// mpys?
+		case 0x1b:
+			tr_flush_dirty_P();
+			tr_mac_load_XY(op);
+			tr_A_add_P(1);
+			hostreg_sspreg_changed(SSP_A);
+			known_regb &= ~(KRREG_A|KRREG_AL);
+			dirty_regb |= KRREG_ST;
+			ret++; break;
+
+		// mpya (rj), (ri), b
+		case 0x4b:
+			tr_flush_dirty_P();
+			tr_mac_load_XY(op);
+			tr_A_add_P(0);
+			hostreg_sspreg_changed(SSP_A);
+			known_regb &= ~(KRREG_A|KRREG_AL);
+			dirty_regb |= KRREG_ST;
+			ret++; break;
+
+		// mld (rj), (ri), b
+		case 0x5b:
+			tr_A_clear();
+			hostreg_sspreg_changed(SSP_A);
+			known_regs.gr[SSP_A].v = 0;
+			known_regb |= (KRREG_A|KRREG_AL);
+			dirty_regb |= KRREG_ST;
+			tr_mac_load_XY(op);
+			ret++; break;
+
+		// OP a, s
+		case 0x10:
+		case 0x30:
+		case 0x40:
+		case 0x50:
+		case 0x60:
+		case 0x70:
+			tmpv = op & 0xf; // src
+			tmpv2 = tr_aop_ssp2host(op>>13); // op
+			if (tmpv == SSP_P) {
+				tr_flush_dirty_P();
+				tr_aop_P(tmpv2);
+			} else if (tmpv == SSP_A) {
+				tr_aop_A(tmpv2);
+			} else {
+				tr_read_funcs[tmpv](op);
+				tr_aop_r0(tmpv2);
+			}
+			hostreg_sspreg_changed(SSP_A);
+			known_regb &= ~(KRREG_A|KRREG_AL|KRREG_ST);
+			dirty_regb |= KRREG_ST;
+			ret++; break;
+
+		// OP a, (ri)
+		case 0x11:
+		case 0x31:
+		case 0x41:
+		case 0x51:
+		case 0x61:
+		case 0x71:
+			tmpv2 = tr_aop_ssp2host(op>>13); // op
+			tr_rX_read((op&3)|((op>>6)&4), (op>>2)&3);
+			tr_aop_r0(tmpv2);
+			hostreg_sspreg_changed(SSP_A);
+			known_regb &= ~(KRREG_A|KRREG_AL|KRREG_ST);
+			dirty_regb |= KRREG_ST;
+			ret++; break;
+
+		// OP a, adr
+		case 0x13:
+		case 0x33:
+		case 0x43:
+		case 0x53:
+		case 0x63:
+		case 0x73:
+			tmpv2 = tr_aop_ssp2host(op>>13); // op
+			tr_bank_read(op&0x1ff);
+			tr_aop_r0(tmpv2);
+			hostreg_sspreg_changed(SSP_A);
+			known_regb &= ~(KRREG_A|KRREG_AL|KRREG_ST);
+			dirty_regb |= KRREG_ST;
+			ret++; break;
+
+		// OP a, imm
+		case 0x14:
+		case 0x34:
+		case 0x44:
+		case 0x54:
+		case 0x64:
+		case 0x74:
+			tmpv2 = tr_aop_ssp2host(op>>13); // op
+			tr_mov16(0, imm);
+			tr_aop_r0(tmpv2);
+			hostreg_sspreg_changed(SSP_A);
+			known_regb &= ~(KRREG_A|KRREG_AL|KRREG_ST);
+			dirty_regb |= KRREG_ST;
+			ret += 2; break;
+
+		// OP a, ((ri))
+		case 0x15:
+		case 0x35:
+		case 0x45:
+		case 0x55:
+		case 0x65:
+		case 0x75:
+			tmpv2 = tr_aop_ssp2host(op>>13); // op
+			tr_rX_read2(op);
+			tr_aop_r0(tmpv2);
+			hostreg_sspreg_changed(SSP_A);
+			known_regb &= ~(KRREG_A|KRREG_AL|KRREG_ST);
+			dirty_regb |= KRREG_ST;
+			ret += 3; break;
+
+		// OP a, ri
+		case 0x19:
+		case 0x39:
+		case 0x49:
+		case 0x59:
+		case 0x69:
+		case 0x79: {
+			int r;
+			tmpv2 = tr_aop_ssp2host(op>>13); // op
+			r = (op&3) | ((op>>6)&4); // src
+			if ((r&3) == 3) tr_unhandled();
+
+			if (known_regb & (1 << (r+8))) {
+				tr_aop_imm(tmpv2, known_regs.r[r]);
+			} else {
+				tr_ri_to_r0(r);
+				tr_aop_r0(tmpv2);
+				hostreg_r[0] = -1;
+			}
+			hostreg_sspreg_changed(SSP_A);
+			known_regb &= ~(KRREG_A|KRREG_AL|KRREG_ST);
+			dirty_regb |= KRREG_ST;
+			ret++; break;
+		}
+
+		// OP simm
+		case 0x1c:
+		case 0x3c:
+		case 0x4c:
+		case 0x5c:
+		case 0x6c:
+		case 0x7c:
+			tmpv2 = tr_aop_ssp2host(op>>13); // op
+			tr_aop_imm(tmpv2, op & 0xff);
+			hostreg_sspreg_changed(SSP_A);
+			known_regb &= ~(KRREG_A|KRREG_AL|KRREG_ST);
+			dirty_regb |= KRREG_ST;
+			ret++; break;
+	}
+
+	n_in_ops++;
+
+	return ret;
+}
+
+void *ssp_translate_block(int pc)
+{
+	unsigned int op, op1, imm, ccount = 0;
+	void *block_start, *block_end;
+	int ret, end_cond = COND_AL, jump_pc = -1;
+
+	//printf("translate %04x -> %04x\n", pc<<1, (u8 *)tcache_ptr-tcache);
+
+	block_start = tcache_ptr;
+	known_regb = 0;
+	dirty_regb = KRREG_P;
+	known_regs.emu_status = 0;
+	hostreg_clear();
+
+	emit_block_prologue();
+
+	for (; ccount < 100;)
+	{
+		op = PROGRAM(pc++);
+		op1 = op >> 9;
+		imm = (u32)-1;
+
+		if ((op1 & 0xf) == 4 || (op1 & 0xf) == 6)
+			imm = PROGRAM(pc++); // immediate
+
+		ret = translate_op(op, &pc, imm, &end_cond, &jump_pc);
+		if (ret <= 0)
+		{
+			elprintf(EL_ANOMALY, "NULL func! op=%08x (%02x)\n", op, op1);
+			//exit(1);
+		}
+
+		ccount += ret & 0xffff;
+		if (ret & 0x10000) break;
+	}
+
+	// block too long, but don't override the branch that ended it
+	if (ccount >= 100 && !(ret & 0x10000)) {
+		end_cond = COND_AL;
+		jump_pc = pc;
+		emith_move_r_imm(0, pc);
+	}
+
+	tr_flush_dirty_prs();
+	tr_flush_dirty_ST();
+	tr_flush_dirty_pmcrs();
+	block_end = emit_block_epilogue(ccount, end_cond, jump_pc, pc);
+
+	if ((u8 *)tcache_ptr - tcache > DRC_TCACHE_SIZE) {
+		elprintf(EL_ANOMALY|EL_STATUS|EL_SVP, "tcache overflow!\n");
+		fflush(stdout);
+		exit(1);
+	}
+
+	// stats
+	nblocks++;
+	//printf("%i blocks, %i bytes, k=%.3f\n", nblocks, (u8 *)tcache_ptr - tcache,
+	//	(double)((u8 *)tcache_ptr - tcache) / (double)n_in_ops);
+
+#ifdef DUMP_BLOCK
+	{
+		FILE *f = fopen("tcache.bin", "wb");
+		fwrite(tcache, 1, (u8 *)tcache_ptr - tcache, f);
+		fclose(f);
+	}
+	printf("dumped tcache.bin\n");
+	exit(0);
+#endif
+
+	host_instructions_updated(block_start, block_end);
+
+	return block_start;
+}
+
+
+/* find or translate block, optionally patching the call at patch_ptr - 5 */
+static void *ssp_drc_lookup(int pc, u8 *patch_ptr)
+{
+	void **bt;
+
+	if (pc < 0x400) {
+		if (ssp->drc.iram_dirty) {
+			ssp->drc.iram_context = ssp_get_iram_context();
+			ssp->drc.iram_dirty = 0;
+		}
+		bt = &ssp_block_table_iram[ssp->drc.iram_context * SSP_BLOCKTAB_IRAM_ONE + pc];
+	}
+	else
+		bt = &ssp_block_table[pc];
+
+	if (*bt == NULL)
+		*bt = ssp_translate_block(pc);
+	if (patch_ptr != NULL)
+		emith_jump_at(patch_ptr - 5, *bt);
+
+	return *bt;
+}
+
+// what stub_arm.S does on ARM
+static void ssp_generate_stubs(void)
+{
+	u8 *dispatch;
+
+	// int ssp_drc_entry(ssp1601_t *ssp, int cycles)
+	ssp_drc_entry = (void *)tcache_ptr;
+	emith_push(xBX);
+	emith_push(xBP);
+	emith_push(xR12);
+	emith_push(xR13);
+	emith_push(xR14);
+	emith_push(xR15);
+	emith_sub_r_ptr_imm(xSP, 8);		// keep stack 16 byte aligned
+	emith_move_r_r_ptr(CONTEXT_REG, xDI);
+	emith_move_r_r(HR_CYCLES, xSI);
+	emith_ctx_read(HR_XXYY, 0x400+SSP_X*4);
+	emith_and_r_imm(HR_XXYY, 0xffff0000);
+	emith_read16_r_r_offs(xAX, CONTEXT_REG, 0x400+SSP_Y*4+2);
+	emith_or_r_r(HR_XXYY, xAX);
+	emith_ctx_read(HR_A, 0x400+SSP_A*4);
+	emith_ctx_read(HR_P, 0x400+SSP_P*4);
+	emith_read16_r_r_offs(xAX, CONTEXT_REG, 0x400+SSP_PC*4+2);
+
+	// eax: PC
+	ssp_drc_next = tcache_ptr;
+	emith_eor_r_r(xSI, xSI);
+	dispatch = tcache_ptr;
+	emith_op0f_r_r(0xb7, xAX, xAX);		// movzx eax, ax
+	emith_ctx_write(xAX, 0x4a4);		// tmp0, entry PC
+	emith_move_r_r(xDI, xAX);
+	emith_call(ssp_drc_lookup);
+	emith_move_r_r_ptr(xDX, xAX);
+	emith_ctx_read(xAX, 0x4a4);
+	emith_jump_reg(xDX);
+
+	// eax: PC, called from block
+	ssp_drc_next_patch = tcache_ptr;
+	emith_pop(xSI);
+	emith_jump(dispatch);
+
+	// eax: PC
+	ssp_drc_end = tcache_ptr;
+	emith_lsl(xCX, xAX, 16);
+	emith_ctx_write(xCX, 0x400+SSP_PC*4);
+	emith_and_r_r_imm(xCX, HR_XXYY, 0xffff0000);
+	emith_ctx_write(xCX, 0x400+SSP_X*4);
+	emith_lsl(xCX, HR_XXYY, 16);
+	emith_ctx_write(xCX, 0x400+SSP_Y*4);
+	emith_ctx_write(HR_A, 0x400+SSP_A*4);
+	emith_ctx_write(HR_P, 0x400+SSP_P*4);
+	emith_move_r_r(xAX, HR_CYCLES);
+	emith_add_r_ptr_imm(xSP, 8);
+	emith_pop(xR15);
+	emith_pop(xR14);
+	emith_pop(xR13);
+	emith_pop(xR12);
+	emith_pop(xBP);
+	emith_pop(xBX);
+	emith_ret();
+}
+
+
+// -----------------------------------------------------
+
+static void ssp1601_state_load(void)
+{
+	ssp->drc.iram_dirty = 1;
+	ssp->drc.iram_context = 0;
+}
+
+void ssp1601_dyn_exit(void)
+{
+	free(ssp_block_table);
+	free(ssp_block_table_iram);
+	ssp_block_table = ssp_block_table_iram = NULL;
+
+	drc_cmn_cleanup();
+}
+
+int ssp1601_dyn_startup(void)
+{
+	if (drc_cmn_init() != 0)
+		return -1;
+
+	ssp_block_table = calloc(sizeof(ssp_block_table[0]), SSP_BLOCKTAB_ENTS);
+	if (ssp_block_table == NULL)
+		return -1;
+	ssp_block_table_iram = calloc(sizeof(ssp_block_table_iram[0]), SSP_BLOCKTAB_IRAM_ENTS);
+	if (ssp_block_table_iram == NULL) {
+		free(ssp_block_table);
+		return -1;
+	}
+
+	memset(tcache, 0, DRC_TCACHE_SIZE);
+	tcache_ptr = (void *)tcache;
+
+	PicoLoadStateHook = ssp1601_state_load;
+
+	n_in_ops = 0;
+	ssp_generate_stubs();
+
+	return 0;
+}
+
+
+void ssp1601_dyn_reset(ssp1601_t *ssp)
+{
+	ssp1601_reset(ssp);
+	ssp->drc.iram_dirty = 1;
+	ssp->drc.iram_context = 0;
+
+	// prevent new versions of IRAM from appearing
+	memset(svp->iram_rom, 0, 0x800);
+}
+
+
+void ssp1601_dyn_run(int cycles)
+{
+	if (ssp->emu_status & SSP_WAIT_MASK) return;
+
+#ifdef DUMP_BLOCK
+	ssp_translate_block(DUMP_BLOCK >> 1);
+#endif
+	ssp_drc_entry(ssp, cycles);
+}
+
+// per emulator instance, tcache itself is switched by cmn.c
+const struct pico_ctx_area ctx_areas_svp_drc[] = {
+	PICO_CTX_AREA(ssp_block_table),
+	PICO_CTX_AREA(ssp_block_table_iram),
+	PICO_CTX_AREA(tcache_ptr),
+	PICO_CTX_AREA(ssp_drc_entry),
+	PICO_CTX_AREA(ssp_drc_next),
+	PICO_CTX_AREA(ssp_drc_next_patch),
+	PICO_CTX_AREA(ssp_drc_end),
+	PICO_CTX_AREA(nblocks),
+	PICO_CTX_AREA(n_in_ops),
+	PICO_CTX_AREA_END
+};
+
@@ -1244,3 +1244,9 @@ void ssp1601_run(int cycles)
 	read_P(); // update P
 }
 
+const struct pico_ctx_area ctx_areas_ssp16[] = {
+	PICO_CTX_AREA(ssp),
+	PICO_CTX_AREA(PC),
+	PICO_CTX_AREA(g_cycles),
+	PICO_CTX_AREA_END
+};
@@ -128,10 +128,27 @@ void PicoSVPInit(void)
 static void PicoSVPExit(void)
 {
 #ifdef _SVP_DRC
+	PicoContextDrcClaim();
 	ssp1601_dyn_exit();
 #endif
 }
 
+// translation cache was taken by someone else, start over
+void PicoSVPDrcReinit(void)
+{
+#ifdef _SVP_DRC
+	ssp1601_dyn_exit();
+	if (!(PicoAHW & PAHW_SVP) || !svp_dyn_ready)
+		return;
+
+	if (ssp1601_dyn_startup() != 0) {
+		svp_dyn_ready = 0;
+		return;
+	}
+	svp->ssp1601.drc.iram_dirty = 1;
+#endif
+}
+
 
 void PicoSVPStartup(void)
 {
@@ -152,6 +169,7 @@ void PicoSVPStartup(void)
 	svp_dyn_ready = 0;
 #ifdef _SVP_DRC
 	if (PicoOpt & POPT_EN_DRC) {
+		PicoContextDrcClaim();
 		if (ssp1601_dyn_startup())
 			return;
 		svp_dyn_ready = 1;
@@ -173,3 +191,8 @@ void PicoSVPStartup(void)
 	PicoAHW |= PAHW_SVP;
 }
 
+const struct pico_ctx_area ctx_areas_svp[] = {
+	PICO_CTX_AREA(svp_dyn_ready),
+	PICO_CTX_AREA(svp_states),
+	PICO_CTX_AREA_END
+};
@@ -10,6 +10,7 @@
 #include "genplus_macros.h"
 #include "cdd.h"
 #include "cue.h"
+#include "hcd.h"
 
 static int handle_mp3(const char *fname, int index)
 {
@@ -104,6 +105,7 @@ int load_cd_image(const char *cd_img_name, int *type)
     return -1;
   }
   tracks[0].fd = pmf;
+  cdra_attach(pmf);
 
   if (*type == CT_ISO)
        cd_img_sectors = pmf->size >>= 11;  // size in sectors
@@ -120,6 +122,37 @@ int load_cd_image(const char *cd_img_name, int *type)
 
   lba = cd_img_sectors;
 
+  if (cue_data == NULL && pmf->type == PMT_HCD)
+  {
+    // audio tracks are in the same stream, like a single file .bin
+    const hcd_header *hdr = pmf->param;
+    int count = hdr->track_count;
+
+    // cdda is read as 2352 byte frames
+    if (hdr->frame_size != 2352)
+      count = 1;
+
+    for (n = 2; n <= count; n++)
+    {
+      index = n - 1;
+      tracks[index].offset = hdr->track_start[index];
+      tracks[index].start = hdr->track_start[index];
+      tracks[index].end = n < count ?
+        hdr->track_start[index + 1] : cd_img_sectors;
+      if (tracks[index].end < tracks[index].start)
+        tracks[index].end = tracks[index].start;
+      Pico_mcd->cdda_type = CT_BIN;
+
+      sprintf_lba(tmp_ext, sizeof(tmp_ext), tracks[index].start);
+      elprintf(EL_STATUS, "Track %2i: %s %9i AUDIO (hcd)",
+        n, tmp_ext, tracks[index].end - tracks[index].start);
+    }
+    if (count > 1)
+      tracks[0].end = hdr->track_start[1];
+    lba = tracks[n - 2].end;
+    goto finish;
+  }
+
   if (cue_data != NULL)
   {
     if (cue_data->tracks[2].fname == NULL) {
@@ -148,6 +181,7 @@ int load_cd_image(const char *cd_img_name, int *type)
         {
           // assume raw, ignore header for wav..
           tracks[index].fd = f;
+          cdra_attach(f);
           tracks[index].offset = cue_data->tracks[n].sector_offset;
           length = f->size / 2352;
         }
@@ -315,6 +315,7 @@ static void do_dma(enum dma_type type, int words_in)
     elprintf(EL_ANOMALY, "cd dma %d oflow: %x %x", type, dst_addr, words);
     words = (dst_limit - dst_addr) / 2;
   }
+  fm68k_drc_wcheck(dst, words * 2);
   while (words > 0)
   {
     if (src_addr + words * 2 > 0x4000) {
@@ -843,4 +844,9 @@ unsigned short cdc_host_r(void)
   return 0xffff;
 }
 
+const struct pico_ctx_area ctx_areas_cdc[] = {
+  PICO_CTX_AREA(cdc),
+  PICO_CTX_AREA_END
+};
+
 // vim:shiftwidth=2:ts=2:expandtab
@@ -448,4 +448,9 @@ void gfx_update(unsigned int cycles)
   }
 }
 
+const struct pico_ctx_area ctx_areas_gfx[] = {
+  PICO_CTX_AREA(gfx),
+  PICO_CTX_AREA_END
+};
+
 // vim:shiftwidth=2:ts=2:expandtab
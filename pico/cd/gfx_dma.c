@@ -18,7 +18,7 @@ typedef unsigned short u16;
 PICO_INTERNAL void DmaSlowCell(unsigned int source, unsigned int a, int len, unsigned char inc)
 {
   unsigned char *base;
-  unsigned int asrc, a2;
+  unsigned int asrc, a2, span;
   u16 *r;
 
   base = Pico_mcd->word_ram1M[Pico_mcd->s68k_regs[3]&1];
@@ -27,17 +27,22 @@ PICO_INTERNAL void DmaSlowCell(unsigned int source, unsigned int a, int len, uns
   {
     case 1: // vram
       r = Pico.vram;
+      span = len ? (len-1)*inc+2 : 0;
       for(; len; len--)
       {
         asrc = cell_map(source >> 2) << 2;
         asrc |= source & 2;
         // if(a&1) d=(d<<8)|(d>>8); // ??
         r[a>>1] = *(u16 *)(base + asrc);
+        PicoDirtyVram(a);
 	source += 2;
         // AutoIncrement
         a=(u16)(a+inc);
       }
-      rendstatus |= PDRAW_SPRITES_MOVED;
+      if (PicoDrawThreaded)
+        PicoDrawMtBlock(DMT_VRAM, Pico.video.addr, span, PDRAW_SPRITES_MOVED);
+      else
+        rendstatus |= PDRAW_SPRITES_MOVED;
       break;
 
     case 3: // cram
@@ -55,6 +60,8 @@ PICO_INTERNAL void DmaSlowCell(unsigned int source, unsigned int a, int len, uns
         if(a2 >= 0x80) break;
       }
       a=(a&0xff00)|a2;
+      if (PicoDrawThreaded)
+        PicoDrawMtBlock(DMT_CRAM, 0, 0x80, 0);
       break;
 
     case 5: // vsram[a&0x003f]=d;
@@ -71,6 +78,8 @@ PICO_INTERNAL void DmaSlowCell(unsigned int source, unsigned int a, int len, uns
         if(a2 >= 0x80) break;
       }
       a=(a&0xff00)|a2;
+      if (PicoDrawThreaded)
+        PicoDrawMtBlock(DMT_VSRAM, 0, 0x80, 0);
       break;
   }
   // remember addr
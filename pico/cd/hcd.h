@@ -0,0 +1,31 @@
+/*
+ * hunked compressed disc image (.hcd)
+ * (C) agent, 2026
+ *
+ * This work is licensed under the terms of MAME license.
+ * See COPYING file in the top-level directory.
+ *
+ * The whole disc as one stream of frame_size byte sectors (data track
+ * followed by the audio tracks, like a single .bin), cut into hunks
+ * which are deflated separately (zlib format), so any sector can be
+ * reached by inflating one hunk.
+ * file: hcd_header, index[hunk_count + 1], hunk data
+ * index[] are file offsets, bit31 set: hunk stored as is.
+ * All fields are little endian.
+ */
+
+#define HCD_MAGIC "HCD1"
+#define HCD_MAX_TRACKS 99
+#define HCD_HUNK_FRAMES 8	/* what mkhcd uses */
+
+typedef struct
+{
+	char magic[4];
+	unsigned int frame_size;	/* 2048 (iso) or 2352 (bin) */
+	unsigned int hunk_size;		/* bytes, multiple of frame_size */
+	unsigned int hunk_count;
+	unsigned int total_bytes;
+	unsigned int track_count;	/* track 1 is data, the rest audio */
+	unsigned int track_start[HCD_MAX_TRACKS]; /* in frames */
+} hcd_header;
+
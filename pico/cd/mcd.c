@@ -95,7 +95,9 @@ static void SekRunM68kOnce(void)
   int cyc_do;
   pevt_log_m68k_o(EVT_RUN_START);
 
-  if ((cyc_do = SekCycleAim - SekCycleCnt) > 0) {
+  if ((cyc_do = SekCycleAim - SekCycleCnt) > 0 && SekIdleSkip(0, cyc_do))
+    SekCycleCnt = SekCycleAim;
+  else if ((cyc_do = SekCycleAim - SekCycleCnt) > 0) {
     SekCycleCnt += cyc_do;
 
 #if defined(EMU_C68K)
@@ -105,7 +107,7 @@ static void SekRunM68kOnce(void)
 #elif defined(EMU_M68K)
     SekCycleCnt += m68k_execute(cyc_do) - cyc_do;
 #elif defined(EMU_F68K)
-    SekCycleCnt += fm68k_emulate(cyc_do, 0) - cyc_do;
+    SekCycleCnt += fm68k_run(cyc_do) - cyc_do;
 #endif
   }
 
@@ -126,6 +128,13 @@ static void SekRunS68k(unsigned int to)
   if (SekShouldInterrupt())
     Pico_mcd->m.s68k_poll_a = 0;
 
+  if (SekIdleSkip(1, cyc_do)) {
+    SekCycleCntS68k = SekCycleAimS68k;
+    return;
+  }
+  if ((cyc_do = SekCycleAimS68k - SekCycleCntS68k) <= 0)
+    return;
+
   SekCycleCntS68k += cyc_do;
 #if defined(EMU_C68K)
   PicoCpuCS68k.cycles = cyc_do;
@@ -137,7 +146,7 @@ static void SekRunS68k(unsigned int to)
   m68k_set_context(&PicoCpuMM68k);
 #elif defined(EMU_F68K)
   g_m68kcontext = &PicoCpuFS68k;
-  SekCycleCntS68k += fm68k_emulate(cyc_do, 0) - cyc_do;
+  SekCycleCntS68k += fm68k_run(cyc_do) - cyc_do;
   g_m68kcontext = &PicoCpuFM68k;
 #endif
 }
@@ -412,4 +421,12 @@ void pcd_state_loaded(void)
   pcd_run_events(SekCycleCntS68k);
 }
 
+const struct pico_ctx_area ctx_areas_mcd[] = {
+  PICO_CTX_AREA(mcd_m68k_cycle_mult),
+  PICO_CTX_AREA(mcd_m68k_cycle_base),
+  PICO_CTX_AREA(mcd_s68k_cycle_base),
+  PICO_CTX_AREA(event_time_next),
+  PICO_CTX_AREA_END
+};
+
 // vim:shiftwidth=2:ts=2:expandtab
@@ -358,6 +358,7 @@ void s68k_reg_write8(u32 a, u32 d)
         if (!(dold & 4)) {
           elprintf(EL_CDREG3, "wram mode 2M->1M");
           wram_2M_to_1M(Pico_mcd->word_ram2M);
+          fm68k_drc_wcheck(Pico_mcd->word_ram2M, 0x60000);
         }
 
         if ((d ^ dold) & 0x1d)
@@ -371,6 +372,7 @@ void s68k_reg_write8(u32 a, u32 d)
         if (dold & 4) {
           elprintf(EL_CDREG3, "wram mode 1M->2M");
           wram_1M_to_2M(Pico_mcd->word_ram2M);
+          fm68k_drc_wcheck(Pico_mcd->word_ram2M, 0x60000);
           remap_word_ram(d);
         }
         d = (d & ~3) | Pico_mcd->m.dmna_ret_2m;
@@ -576,24 +578,28 @@ static void PicoWriteM68k8_cell0(u32 a, u32 d)
 {
   a = (a&3) | (cell_map(a >> 2) << 2);
   Pico_mcd->word_ram1M[0][a ^ 1] = d;
+  fm68k_drc_wcheck(&Pico_mcd->word_ram1M[0][a ^ 1], 1);
 }
 
 static void PicoWriteM68k8_cell1(u32 a, u32 d)
 {
   a = (a&3) | (cell_map(a >> 2) << 2);
   Pico_mcd->word_ram1M[1][a ^ 1] = d;
+  fm68k_drc_wcheck(&Pico_mcd->word_ram1M[1][a ^ 1], 1);
 }
 
 static void PicoWriteM68k16_cell0(u32 a, u32 d)
 {
   a = (a&3) | (cell_map(a >> 2) << 2);
   *(u16 *)(Pico_mcd->word_ram1M[0] + a) = d;
+  fm68k_drc_wcheck(Pico_mcd->word_ram1M[0] + a, 2);
 }
 
 static void PicoWriteM68k16_cell1(u32 a, u32 d)
 {
   a = (a&3) | (cell_map(a >> 2) << 2);
   *(u16 *)(Pico_mcd->word_ram1M[1] + a) = d;
+  fm68k_drc_wcheck(Pico_mcd->word_ram1M[1] + a, 2);
 }
 #endif
 
@@ -744,14 +750,18 @@ static void s68k_unmapped_write16(u32 a, u32 d)
 // XXX verify: ff00 or 1fe00 max?
 static void PicoWriteS68k8_prgwp(u32 a, u32 d)
 {
-  if (a >= (Pico_mcd->s68k_regs[2] << 9))
+  if (a >= (Pico_mcd->s68k_regs[2] << 9)) {
     Pico_mcd->prg_ram[a ^ 1] = d;
+    fm68k_drc_wcheck(&Pico_mcd->prg_ram[a ^ 1], 1);
+  }
 }
 
 static void PicoWriteS68k16_prgwp(u32 a, u32 d)
 {
-  if (a >= (Pico_mcd->s68k_regs[2] << 9))
+  if (a >= (Pico_mcd->s68k_regs[2] << 9)) {
     *(u16 *)(Pico_mcd->prg_ram + a) = d;
+    fm68k_drc_wcheck(Pico_mcd->prg_ram + a, 2);
+  }
 }
 
 #ifndef _ASM_CD_MEMORY_C
@@ -1095,8 +1105,10 @@ void pcd_state_loaded_mem(void)
   u32 r3 = Pico_mcd->s68k_regs[3];
 
   /* after load events */
-  if (r3 & 4) // 1M mode?
+  if (r3 & 4) { // 1M mode?
     wram_2M_to_1M(Pico_mcd->word_ram2M);
+    fm68k_drc_wcheck(Pico_mcd->word_ram2M, 0x60000);
+  }
   remap_word_ram(r3);
   remap_prg_window(Pico_mcd->m.busreq, r3);
   Pico_mcd->m.dmna_ret_2m &= 3;
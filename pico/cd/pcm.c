@@ -7,8 +7,14 @@
  */
 
 #include "../pico_int.h"
+#include "../sound/mix.h"
+#include "../sound/resampler.h"
 
 #define PCM_STEP_SHIFT 11
+#define PCM_RATE (12500000 / 384) // a sample every 384 s68k cycles
+
+// for native rate synthesis
+static struct rsmp pcm_rs;
 
 void pcd_pcm_write(unsigned int a, unsigned int d)
 {
@@ -133,16 +139,15 @@ void pcd_pcm_update(int *buf32, int length, int stereo)
   step = (Pico_mcd->pcm_mixpos << 16) / length;
   pcm = Pico_mcd->pcm_mixbuf;
 
-  if (stereo) {
-    while (length-- > 0) {
-      *buf32++ += pcm[0];
-      *buf32++ += pcm[1];
-
-      p += step;
-      pcm += (p >> 16) * 2;
-      p &= 0xffff;
-    }
+  if (stereo && PsndNativeRate) {
+    if (pcm_rs.out_rate != PsndNativeRate)
+      rsmp_init(&pcm_rs, PCM_RATE, PsndNativeRate, 1);
+    rsmp_set_step(&pcm_rs, Pico_mcd->pcm_mixpos, length);
+    rsmp_push(&pcm_rs, pcm, Pico_mcd->pcm_mixpos);
+    rsmp_pull(&pcm_rs, buf32, length);
   }
+  else if (stereo)
+    mix_32_to_32_step(buf32, pcm, length, step);
   else {
     while (length-- > 0) {
       // mostly unused
@@ -162,4 +167,9 @@ out:
   Pico_mcd->pcm_mixpos = 0;
 }
 
+const struct pico_ctx_area ctx_areas_pcm[] = {
+  PICO_CTX_AREA(pcm_rs),
+  PICO_CTX_AREA_END
+};
+
 // vim:shiftwidth=2:ts=2:expandtab
@@ -0,0 +1,290 @@
+/*
+ * CD image read-ahead
+ * (C) agent, 2026
+ *
+ * This work is licensed under the terms of MAME license.
+ * See COPYING file in the top-level directory.
+ *
+ * Streams of the loaded disc are attached here with
+ * POPT_EN_CD_READAHEAD. pm_seek on them only moves ra_pos, pm_read
+ * copies from a cache of RA_BLOCK sized pieces of the file. A thread
+ * keeps the RA_AHEAD blocks after the last seek/read position loaded.
+ * cdd seeks before each data sector and on every play/seek command,
+ * so it follows cdd.lba and the file I/O happens while the drive
+ * emulation is still counting its seek latency.
+ */
+
+#include "../pico_int.h"
+
+#ifdef CD_READAHEAD
+#include <pthread.h>
+
+#define RA_BLOCK  0x8000
+#define RA_BLOCKS 64
+#define RA_AHEAD  16
+
+#define SLOT_FREE    0
+#define SLOT_LOADING 1
+#define SLOT_VALID   2
+
+static struct {
+  pthread_t thread;
+  pthread_mutex_t lock;  // everything below
+  pthread_mutex_t io;    // direct pm_* calls
+  pthread_cond_t wake;   // for the thread: want changed
+  pthread_cond_t loaded; // for readers: a slot finished loading
+  int started;
+  int quit;
+  unsigned int clock;
+  pm_file *want_f;       // read-ahead target
+  unsigned int want_blk;
+  struct {
+    pm_file *f;
+    unsigned int blk;
+    int state;
+    int len;
+    unsigned int used;
+  } slot[RA_BLOCKS];
+  unsigned char data[RA_BLOCKS][RA_BLOCK];
+} ra;
+
+static int ra_find(pm_file *f, unsigned int blk)
+{
+  int i;
+  for (i = 0; i < RA_BLOCKS; i++)
+    if (ra.slot[i].state != SLOT_FREE && ra.slot[i].f == f && ra.slot[i].blk == blk)
+      return i;
+  return -1;
+}
+
+// least recently used slot that isn't being loaded, ra.lock held
+static int ra_victim(void)
+{
+  int i, v = -1;
+  for (i = 0; i < RA_BLOCKS; i++) {
+    if (ra.slot[i].state == SLOT_FREE)
+      return i;
+    if (ra.slot[i].state == SLOT_LOADING)
+      continue;
+    if (v < 0 || (int)(ra.slot[i].used - ra.slot[v].used) < 0)
+      v = i;
+  }
+  return v;
+}
+
+// read a block into a slot marked as loading, ra.lock held (dropped meanwhile)
+static void ra_load(int s)
+{
+  pm_file *f = ra.slot[s].f;
+  int ret;
+
+  pthread_mutex_unlock(&ra.lock);
+  pthread_mutex_lock(&ra.io);
+  pm_seek_direct(f, ra.slot[s].blk * RA_BLOCK, SEEK_SET);
+  ret = pm_read_direct(ra.data[s], RA_BLOCK, f);
+  pthread_mutex_unlock(&ra.io);
+  pthread_mutex_lock(&ra.lock);
+
+  ra.slot[s].len = ret > 0 ? ret : 0;
+  ra.slot[s].used = ++ra.clock;
+  ra.slot[s].state = SLOT_VALID;
+  pthread_cond_broadcast(&ra.loaded);
+}
+
+static void ra_want(pm_file *f, unsigned int pos)
+{
+  unsigned int blk = pos / RA_BLOCK;
+  if (ra.want_f == f && ra.want_blk == blk)
+    return;
+  ra.want_f = f;
+  ra.want_blk = blk;
+  pthread_cond_signal(&ra.wake);
+}
+
+static void *ra_worker(void *arg)
+{
+  unsigned int blk;
+  int i, s;
+
+  pthread_mutex_lock(&ra.lock);
+  while (!ra.quit)
+  {
+    s = -1;
+    for (i = 0; ra.want_f != NULL && i < RA_AHEAD; i++) {
+      blk = ra.want_blk + i;
+      s = ra_find(ra.want_f, blk);
+      if (s < 0)
+        break;
+      // stop at end of file
+      if (ra.slot[s].state == SLOT_VALID && ra.slot[s].len < RA_BLOCK) {
+        i = RA_AHEAD;
+        break;
+      }
+    }
+    if (ra.want_f == NULL || i == RA_AHEAD || (s = ra_victim()) < 0) {
+      pthread_cond_wait(&ra.wake, &ra.lock);
+      continue;
+    }
+
+    ra.slot[s].f = ra.want_f;
+    ra.slot[s].blk = blk;
+    ra.slot[s].state = SLOT_LOADING;
+    ra_load(s);
+  }
+  pthread_mutex_unlock(&ra.lock);
+  return NULL;
+}
+
+static int ra_start(void)
+{
+  pthread_mutex_init(&ra.lock, NULL);
+  pthread_mutex_init(&ra.io, NULL);
+  pthread_cond_init(&ra.wake, NULL);
+  pthread_cond_init(&ra.loaded, NULL);
+  ra.quit = 0;
+
+  if (pthread_create(&ra.thread, NULL, ra_worker, NULL) != 0) {
+    elprintf(EL_STATUS, "cd read-ahead thread creation failed");
+    pthread_cond_destroy(&ra.loaded);
+    pthread_cond_destroy(&ra.wake);
+    pthread_mutex_destroy(&ra.io);
+    pthread_mutex_destroy(&ra.lock);
+    return -1;
+  }
+  ra.started = 1;
+  return 0;
+}
+
+void cdra_stop(void)
+{
+  if (!ra.started)
+    return;
+
+  pthread_mutex_lock(&ra.lock);
+  ra.quit = 1;
+  pthread_cond_signal(&ra.wake);
+  pthread_mutex_unlock(&ra.lock);
+  pthread_join(ra.thread, NULL);
+
+  pthread_cond_destroy(&ra.loaded);
+  pthread_cond_destroy(&ra.wake);
+  pthread_mutex_destroy(&ra.io);
+  pthread_mutex_destroy(&ra.lock);
+  memset(ra.slot, 0, sizeof(ra.slot));
+  ra.want_f = NULL;
+  ra.started = 0;
+}
+
+void cdra_attach(pm_file *f)
+{
+  if (f == NULL || !(PicoOpt & POPT_EN_CD_READAHEAD))
+    return;
+  if (!ra.started && ra_start() != 0)
+    return;
+
+  f->ra_pos = 0;
+  f->ra = 1;
+  pm_seek_direct(f, 0, SEEK_SET);
+
+  pthread_mutex_lock(&ra.lock);
+  ra_want(f, 0);
+  pthread_mutex_unlock(&ra.lock);
+}
+
+// before pm_close
+void cdra_detach(pm_file *f)
+{
+  int i;
+
+  if (!f->ra)
+    return;
+
+  pthread_mutex_lock(&ra.lock);
+  if (ra.want_f == f)
+    ra.want_f = NULL;
+  for (i = 0; i < RA_BLOCKS; i++) {
+    if (ra.slot[i].f != f)
+      continue;
+    while (ra.slot[i].state == SLOT_LOADING)
+      pthread_cond_wait(&ra.loaded, &ra.lock);
+    if (ra.slot[i].f == f)
+      ra.slot[i].state = SLOT_FREE;
+  }
+  pthread_mutex_unlock(&ra.lock);
+  f->ra = 0;
+}
+
+size_t cdra_read(void *ptr, size_t bytes, pm_file *f)
+{
+  unsigned char *out = ptr;
+  unsigned int blk, offs, len;
+  size_t ret = 0;
+  int s;
+
+  pthread_mutex_lock(&ra.lock);
+  while (bytes > 0)
+  {
+    blk = f->ra_pos / RA_BLOCK;
+    offs = f->ra_pos % RA_BLOCK;
+
+    s = ra_find(f, blk);
+    if (s < 0) {
+      // not predicted, have to wait for the disk
+      s = ra_victim();
+      if (s < 0) {
+        pthread_cond_wait(&ra.loaded, &ra.lock);
+        continue;
+      }
+      ra.slot[s].f = f;
+      ra.slot[s].blk = blk;
+      ra.slot[s].state = SLOT_LOADING;
+      ra_load(s);
+      continue;
+    }
+    if (ra.slot[s].state == SLOT_LOADING) {
+      pthread_cond_wait(&ra.loaded, &ra.lock);
+      continue;
+    }
+
+    ra.slot[s].used = ++ra.clock;
+    if (offs >= (unsigned int)ra.slot[s].len)
+      break; // eof
+    len = ra.slot[s].len - offs;
+    if (len > bytes)
+      len = bytes;
+    memcpy(out, ra.data[s] + offs, len);
+
+    ret += len;
+    out += len;
+    f->ra_pos += len;
+    bytes -= len;
+  }
+  ra_want(f, f->ra_pos);
+  pthread_mutex_unlock(&ra.lock);
+
+  return ret;
+}
+
+int cdra_seek(pm_file *f, long offset, int whence)
+{
+  switch (whence)
+  {
+    case SEEK_CUR: f->ra_pos += offset; break;
+    case SEEK_SET: f->ra_pos  = offset; break;
+    case SEEK_END:
+      // size isn't kept in bytes for cd images, ask the file
+      pthread_mutex_lock(&ra.io);
+      f->ra_pos = pm_seek_direct(f, offset, SEEK_END);
+      pthread_mutex_unlock(&ra.io);
+      break;
+  }
+
+  pthread_mutex_lock(&ra.lock);
+  ra_want(f, f->ra_pos);
+  pthread_mutex_unlock(&ra.lock);
+  return f->ra_pos;
+}
+
+#endif // CD_READAHEAD
+
+// vim:shiftwidth=2:ts=2:expandtab
@@ -0,0 +1,434 @@
+/*
+ * PicoDrive
+ * (C) agent, 2026
+ *
+ * This work is licensed under the terms of MAME license.
+ * See COPYING file in the top-level directory.
+ *
+ * Multiple emulator instances, time sliced.
+ * The core keeps its state in globals, so a context is a saved copy
+ * of all of them that gets swapped in when the context is entered.
+ * That is two memcpys of ~0.5MB per switch (the add-on memory is
+ * behind pointers), and there's one set of globals, so contexts are
+ * serialized: entering blocks until the previous user leaves.
+ * Threads don't make N instances run faster than N times one.
+ * Nothing is flushed on a switch. The recompilers keep their
+ * translation caches per context (only the pointers to them are
+ * swapped), so a switch doesn't retranslate anything. On ARM the SH2
+ * and SSP1601 ones have to be in .bss, which has DRC_TCACHE_SLOTS of
+ * them; a context only starts over when its slot was given to another
+ * one, see PicoContextDrcClaim().
+ */
+
+#include "pico_int.h"
+#include "memory.h"
+#include "patch.h"
+#include "sound/ym2612.h"
+#include "cd/genplus_macros.h"
+#include "cd/cue.h"
+#include "cd/cdd.h"
+#ifdef __arm__
+#include "../cpu/drc/cmn.h"
+#if !defined(NO_32X) && defined(DRC_SH2)
+#include "../cpu/sh2/compiler.h"
+#endif
+#endif
+
+#if defined(NO_THREADS)
+#define ctx_lock()
+#define ctx_unlock()
+#elif defined(_WIN32)
+#include <windows.h>
+static volatile LONG ctx_locked;
+static void ctx_lock(void)
+{
+  while (InterlockedCompareExchange(&ctx_locked, 1, 0) != 0)
+    Sleep(0);
+}
+#define ctx_unlock() InterlockedExchange(&ctx_locked, 0)
+#elif defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+static pthread_mutex_t ctx_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define ctx_lock()   pthread_mutex_lock(&ctx_mutex)
+#define ctx_unlock() pthread_mutex_unlock(&ctx_mutex)
+#else
+#define ctx_lock()
+#define ctx_unlock()
+#endif
+
+extern int *sn76496_regs;
+extern int HighPreSpr[];
+extern unsigned char *PicoDraw2FB;
+extern unsigned short *PicoCramHigh;
+extern void (*PicoPrepareCram)();
+extern int (*PicoDmaHook)(unsigned int source, int len,
+  unsigned short **srcp, unsigned short **limitp);
+
+struct PicoContext {
+  unsigned int id;
+  unsigned char *state;
+#ifdef __arm__
+  int drc_slot;                   // tcache slot + 1, 0 if none yet
+#endif
+};
+
+static const struct pico_ctx_area ctx_areas_core[] = {
+  PICO_CTX_AREA(Pico),
+  PICO_CTX_AREA(SRam),
+  PICO_CTX_AREA(PicoOpt),
+  PICO_CTX_AREA(PicoAHW),
+  PICO_CTX_AREA(PicoQuirks),
+  PICO_CTX_AREA(PicoSkipFrame),
+  PICO_CTX_AREA(PicoRegionOverride),
+  PICO_CTX_AREA(PicoAutoRgnOrder),
+  PICO_CTX_AREA(PicoPad),
+  PICO_CTX_AREA(PicoPadInt),
+  PICO_CTX_AREA(emustatus),
+  PICO_CTX_AREA(scanlines_total),
+  PICO_CTX_AREA(line_base_cycles),
+  PICO_CTX_AREA(last_z80_sync),
+  PICO_CTX_AREA(z80_cycle_cnt),
+  PICO_CTX_AREA(z80_cycle_aim),
+  PICO_CTX_AREA(z80_scanline),
+  PICO_CTX_AREA(z80_scanline_cycles),
+  PICO_CTX_AREA(PicoWriteSound),
+  PICO_CTX_AREA(PicoMessage),
+  PICO_CTX_AREA(PicoResetHook),
+  PICO_CTX_AREA(PicoLineHook),
+  PICO_CTX_AREA(PicoDmaHook),
+  PICO_CTX_AREA(PicoCartMemSetup),
+  PICO_CTX_AREA(PicoCartUnloadHook),
+  PICO_CTX_AREA(PicoCartLoadProgressCB),
+  PICO_CTX_AREA(PicoCDLoadProgressCB),
+  PICO_CTX_AREA(PicoGameLoaded),
+  PICO_CTX_AREA(PicoLoadStateHook),
+  PICO_CTX_AREA(PicoStateProgressCB),
+  PICO_CTX_AREA(PicoMCDopenTray),
+  PICO_CTX_AREA(PicoMCDcloseTray),
+  PICO_CTX_AREA(carthw_chunks),
+  PICO_CTX_AREA(PicoPatches),
+  PICO_CTX_AREA(PicoPatchCount),
+  PICO_CTX_AREA(media_id_header),
+  // cpus
+  PICO_CTX_AREA(SekCycleCnt),
+  PICO_CTX_AREA(SekCycleAim),
+  PICO_CTX_AREA(SekCycleCntS68k),
+  PICO_CTX_AREA(SekCycleAimS68k),
+#ifdef EMU_C68K
+  PICO_CTX_AREA(PicoCpuCM68k),
+  PICO_CTX_AREA(PicoCpuCS68k),
+#endif
+#ifdef EMU_F68K
+  PICO_CTX_AREA(PicoCpuFM68k),
+  PICO_CTX_AREA(PicoCpuFS68k),
+  PICO_CTX_AREA(g_m68kcontext),
+#endif
+#ifdef EMU_M68K
+  PICO_CTX_AREA(PicoCpuMM68k),
+  PICO_CTX_AREA(PicoCpuMS68k),
+  PICO_CTX_AREA(m68ki_cpu),
+#endif
+#ifdef _USE_DRZ80
+  PICO_CTX_AREA(drZ80),
+#endif
+#ifdef _USE_CZ80
+  PICO_CTX_AREA(CZ80),
+#endif
+  PICO_CTX_AREA(m68k_read8_map),
+  PICO_CTX_AREA(m68k_read16_map),
+  PICO_CTX_AREA(m68k_write8_map),
+  PICO_CTX_AREA(m68k_write16_map),
+  PICO_CTX_AREA(s68k_read8_map),
+  PICO_CTX_AREA(s68k_read16_map),
+  PICO_CTX_AREA(s68k_write8_map),
+  PICO_CTX_AREA(s68k_write16_map),
+  PICO_CTX_AREA(z80_read_map),
+  PICO_CTX_AREA(z80_write_map),
+  // sound
+  PICO_CTX_AREA(ym2612),
+  PICO_CTX_AREA(sn76496_regs),
+  PICO_CTX_AREA(cdda_out_buffer),
+  PICO_CTX_AREA(PsndRate),
+  PICO_CTX_AREA(PsndLen),
+  PICO_CTX_AREA(PsndLen_exc_add),
+  PICO_CTX_AREA(PsndLen_exc_cnt),
+  PICO_CTX_AREA(PsndDacLine),
+  PICO_CTX_AREA(PsndOut),
+  PICO_CTX_AREA(PsndMix_32_to_16l),
+  PICO_CTX_AREA(timer_a_next_oflow),
+  PICO_CTX_AREA(timer_a_step),
+  PICO_CTX_AREA(timer_b_next_oflow),
+  PICO_CTX_AREA(timer_b_step),
+  // video
+  PICO_CTX_AREA(HighCol),
+  PICO_CTX_AREA(HighPal),
+  PICO_CTX_AREA(HighLnSpr),
+  PICO_CTX_AREA(DrawLineDest),
+  PICO_CTX_AREA(DrawLineDestBase),
+  PICO_CTX_AREA(DrawLineDestBase2),
+  PICO_CTX_AREA(DrawLineDestIncrement),
+  PICO_CTX_AREA(DrawScanline),
+  PICO_CTX_AREA(PicoScanBegin),
+  PICO_CTX_AREA(PicoScanEnd),
+  PICO_CTX_AREA(PicoDrawMask),
+  PICO_CTX_AREA(rendstatus),
+  PICO_CTX_AREA(rendstatus_old),
+  PICO_CTX_AREA(rendlines),
+  PICO_CTX_AREA(PicoDraw2FB),
+  PICO_CTX_AREA(PicoCramHigh),
+  PICO_CTX_AREA(PicoPrepareCram),
+  // add-ons
+  PICO_CTX_AREA(pcd_event_times),
+  PICO_CTX_AREA(cdd),
+  PICO_CTX_AREA(PicoPicohw),
+  PICO_CTX_AREA(svp),
+  PICO_CTX_AREA(PicoSVPCycles),
+#ifndef NO_32X
+  PICO_CTX_AREA(Pico32x),
+  PICO_CTX_AREA(Pico32xMem),
+  PICO_CTX_AREA(sh2s),
+  PICO_CTX_AREA(p32x_event_times),
+  PICO_CTX_AREA(p32x_bios_g),
+  PICO_CTX_AREA(p32x_bios_m),
+  PICO_CTX_AREA(p32x_bios_s),
+  PICO_CTX_AREA(Pico32xDrawMode),
+  PICO_CTX_AREA(PicoScan32xBegin),
+  PICO_CTX_AREA(PicoScan32xEnd),
+#endif
+  PICO_CTX_AREA_END
+};
+
+static const struct pico_ctx_area *ctx_tables[] = {
+  ctx_areas_core,
+  ctx_areas_sound,
+  ctx_areas_ym2612,
+  ctx_areas_sn76496,
+  ctx_areas_draw,
+  ctx_areas_draw2,
+  ctx_areas_mode4,
+  ctx_areas_memory,
+  ctx_areas_sek,
+#ifndef NO_SMS
+  ctx_areas_sms,
+#endif
+  ctx_areas_eeprom,
+  ctx_areas_cart,
+  ctx_areas_carthw,
+  ctx_areas_svp,
+  ctx_areas_ssp16,
+  ctx_areas_mcd,
+  ctx_areas_cdc,
+  ctx_areas_gfx,
+  ctx_areas_pcm,
+  ctx_areas_pico,
+  ctx_areas_xpcm,
+#ifndef NO_32X
+  ctx_areas_32x,
+  ctx_areas_32x_memory,
+  ctx_areas_pwm,
+  ctx_areas_sh2soc,
+#endif
+  ctx_areas_rewind,
+  ctx_areas_runahead,
+  // recompilers
+#ifdef DRC_M68K
+  ctx_areas_fm68k_drc,
+#endif
+#ifdef DRC_Z80
+  ctx_areas_cz80_drc,
+#endif
+  ctx_areas_drc_cmn,
+#if !defined(NO_32X) && defined(DRC_SH2)
+  ctx_areas_sh2_drc,
+#endif
+#ifdef _SVP_DRC
+  ctx_areas_svp_drc,
+#endif
+};
+
+static size_t ctx_size;
+static unsigned char *ctx_pristine;  // globals as they were before any use
+static unsigned int ctx_last_id;
+static struct PicoContext *ctx_active;  // whose state is in the globals now
+static struct PicoContext *ctx_current; // entered and not left yet
+#ifdef __arm__
+static unsigned int drc_owner[DRC_TCACHE_SLOTS]; // context ids
+static int drc_victim;                  // slot to take when all are in use
+#endif
+
+static void ctx_copy(unsigned char *state, int save)
+{
+  const struct pico_ctx_area *a;
+  int i;
+
+  for (i = 0; i < ARRAY_SIZE(ctx_tables); i++) {
+    for (a = ctx_tables[i]; a->ptr != NULL; a++) {
+      if (save)
+        memcpy(state, a->ptr, a->size);
+      else
+        memcpy(a->ptr, state, a->size);
+      state += a->size;
+    }
+  }
+}
+
+PicoContext *PicoContextCreate(void)
+{
+  const struct pico_ctx_area *a;
+  PicoContext *ctx;
+  int i;
+
+  ctx_lock();
+
+  if (ctx_pristine == NULL) {
+    ctx_size = 0;
+    for (i = 0; i < ARRAY_SIZE(ctx_tables); i++)
+      for (a = ctx_tables[i]; a->ptr != NULL; a++)
+        ctx_size += a->size;
+
+    ctx_pristine = malloc(ctx_size);
+    if (ctx_pristine == NULL)
+      goto fail;
+    ctx_copy(ctx_pristine, 1);
+  }
+
+  ctx = calloc(1, sizeof(*ctx));
+  if (ctx == NULL)
+    goto fail;
+  ctx->state = malloc(ctx_size);
+  if (ctx->state == NULL) {
+    free(ctx);
+    goto fail;
+  }
+  memcpy(ctx->state, ctx_pristine, ctx_size);
+  ctx->id = ++ctx_last_id;
+
+  ctx_unlock();
+  return ctx;
+
+fail:
+  elprintf(EL_STATUS, "OOM for context");
+  ctx_unlock();
+  return NULL;
+}
+
+void PicoContextDestroy(PicoContext *ctx)
+{
+  if (ctx == NULL)
+    return;
+
+  // let go of what it still holds: ROM, 32X memory, translation caches..
+  // PicoExit doesn't mind having been called already
+  PicoContextEnter(ctx);
+  PicoExit();
+  ctx_current = NULL;
+  ctx_active = NULL;
+#ifdef __arm__
+  if (ctx->drc_slot != 0 && drc_owner[ctx->drc_slot - 1] == ctx->id)
+    drc_owner[ctx->drc_slot - 1] = 0;
+#endif
+  free(ctx->state);
+  free(ctx);
+  ctx_unlock();
+}
+
+#ifdef __arm__
+// the tcache slot this context translated into went to another one,
+// so its translations are gone and it starts over in the new slot
+static void drc_takeover(void)
+{
+#if !defined(NO_32X) && defined(DRC_SH2)
+  sh2_drc_finish(&msh2);
+  if (PicoAHW & PAHW_32X)
+    sh2_drc_init(&msh2);
+#endif
+  PicoSVPDrcReinit();
+}
+#endif
+
+void PicoContextDrcClaim(void)
+{
+#ifdef __arm__
+  int slot;
+
+  if (ctx_current == NULL)
+    return;
+  slot = ctx_current->drc_slot - 1;
+  if (slot >= 0 && drc_owner[slot] == ctx_current->id)
+    return;
+
+  for (slot = 0; slot < DRC_TCACHE_SLOTS; slot++)
+    if (drc_owner[slot] == 0)
+      break;
+  if (slot == DRC_TCACHE_SLOTS) {
+    slot = drc_victim;
+    drc_victim = (drc_victim + 1) % DRC_TCACHE_SLOTS;
+  }
+  drc_owner[slot] = ctx_current->id;
+  drc_cmn_slot(slot);
+  if (ctx_current->drc_slot != 0)
+    drc_takeover();
+  ctx_current->drc_slot = slot + 1;
+#endif
+}
+
+void PicoContextEnter(PicoContext *ctx)
+{
+  ctx_lock();
+
+  if (ctx_active != ctx) {
+    PicoDrawMtFrameEnd(); // the draw thread may still be on its last frame
+    if (ctx_active != NULL)
+      ctx_copy(ctx_active->state, 1);
+    ctx_copy(ctx->state, 0);
+    ctx_active = ctx;
+  }
+  ctx_current = ctx;
+
+  if (PicoAHW & (PAHW_32X|PAHW_SVP))
+    PicoContextDrcClaim();
+}
+
+void PicoContextLeave(PicoContext *ctx)
+{
+  ctx_current = NULL;
+  ctx_unlock();
+}
+
+void PicoCtxFrame(PicoContext *ctx)
+{
+  PicoContextEnter(ctx);
+  PicoFrame();
+  PicoContextLeave(ctx);
+}
+
+int PicoCtxState(PicoContext *ctx, const char *fname, int is_save)
+{
+  int ret;
+
+  PicoContextEnter(ctx);
+  ret = PicoState(fname, is_save);
+  PicoContextLeave(ctx);
+
+  return ret;
+}
+
+void PicoCtxPower(PicoContext *ctx)
+{
+  PicoContextEnter(ctx);
+  PicoPower();
+  PicoContextLeave(ctx);
+}
+
+int PicoCtxReset(PicoContext *ctx)
+{
+  int ret;
+
+  PicoContextEnter(ctx);
+  ret = PicoReset();
+  PicoContextLeave(ctx);
+
+  return ret;
+}
+
+// vim:shiftwidth=2:ts=2:expandtab
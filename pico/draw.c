@@ -31,6 +31,16 @@
 
 #include "pico_int.h"
 
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_AVX2_CLUT
+#endif
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 int (*PicoScanBegin)(unsigned int num) = NULL;
 int (*PicoScanEnd)  (unsigned int num) = NULL;
 
@@ -42,6 +52,7 @@ static int HighColIncrement;
 static unsigned int DefOutBuff[320*2/2];
 void *DrawLineDest = DefOutBuff; // pointer to dest buffer where to draw this line to
 void *DrawLineDestBase = DefOutBuff;
+void *DrawLineDestBase2; // the other one for the draw thread, if any
 int DrawLineDestIncrement;
 
 static int  HighCacheA[41+1];   // caches for high layers
@@ -59,6 +70,11 @@ int rendlines;
 int DrawScanline;
 int PicoDrawMask = -1;
 
+#ifdef DRAW_THREADS
+// vdp state to draw from, a private copy while the draw thread runs
+struct Pico *PicoDrawSrc = &Pico;
+#endif
+
 static int skip_next_line=0;
 
 //unsigned short ppt[] = { 0x0f11, 0x0ff1, 0x01f1, 0x011f, 0x01ff, 0x0f1f, 0x0f0e, 0x0e7c };
@@ -95,13 +111,96 @@ void blockcpy_or(void *dst, void *src, size_t n, int pat)
 #endif
 
 
+#if defined(__SSE2__) && defined(__GNUC__) || defined(__aarch64__) && defined(__ARM_NEON)
+// vector tile row decoder, 8 pixels are processed at once in the low
+// half of a register. pix_func ops have v* counterparts with the same
+// logic, made of compare masks and selects instead of branches.
+#define HAVE_TILE_VEC
+
+#ifdef __SSE2__
+typedef __m128i tvec;
+#define tv_load(p)      _mm_loadl_epi64((const void *)(p))
+#define tv_store(p, v)  _mm_storel_epi64((void *)(p), v)
+#define tv_dup(x)       _mm_set1_epi8((char)(x))
+#define tv_and          _mm_and_si128
+#define tv_or           _mm_or_si128
+#define tv_andn(a, b)   _mm_andnot_si128(b, a)
+#define tv_eq           _mm_cmpeq_epi8
+#define tv_gt           _mm_cmpgt_epi8 // only for values < 0x80
+#define tv_sel(m, a, b) _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b))
+
+// vram word order is swapped: px 2 3 0 1 6 7 4 5
+static inline tvec tile_row(unsigned int pack, int flip)
+{
+  __m128i x = _mm_cvtsi32_si128(pack), m = _mm_set1_epi8(0x0f);
+  __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), m);
+  __m128i lo = _mm_and_si128(x, m);
+  if (!flip)
+    return _mm_shufflelo_epi16(_mm_unpacklo_epi8(hi, lo), _MM_SHUFFLE(2,3,0,1));
+  return _mm_shufflelo_epi16(_mm_unpacklo_epi8(lo, hi), _MM_SHUFFLE(1,0,3,2));
+}
+#else
+typedef uint8x8_t tvec;
+#define tv_load(p)      vld1_u8(p)
+#define tv_store(p, v)  vst1_u8(p, v)
+#define tv_dup(x)       vdup_n_u8(x)
+#define tv_and          vand_u8
+#define tv_or           vorr_u8
+#define tv_andn         vbic_u8
+#define tv_eq           vceq_u8
+#define tv_gt           vcgt_u8
+#define tv_sel          vbsl_u8
+
+static inline tvec tile_row(unsigned int pack, int flip)
+{
+  uint8x8_t x = vreinterpret_u8_u32(vdup_n_u32(pack)), v;
+  uint8x8_t hi = vshr_n_u8(x, 4), lo = vand_u8(x, vdup_n_u8(0x0f));
+  if (!flip)
+    return vreinterpret_u8_u16(vrev32_u16(vreinterpret_u16_u8(vzip_u8(hi, lo).val[0])));
+  v = vzip_u8(lo, hi).val[0];
+  return vext_u8(v, v, 4);
+}
+#endif
+
+#define tv_z(a)  tv_eq(a, tv_dup(0))
+#define tv_op(t) tv_gt(t, tv_dup(0x0d)) // 0xe, 0xf operator colors
+
+// (pd & 0x3f) | (t << 6) for operator pixels
+static inline tvec tv_sh_op(tvec p, tvec t)
+{
+  tvec v = tv_and(tv_eq(t, tv_dup(0x0f)), tv_dup(0x40));
+  return tv_or(tv_and(p, tv_dup(0x3f)), tv_or(v, tv_dup(0x80)));
+}
+
+#define TileVecMaker(funcname,pix_func,flip)                 \
+static int funcname(int sx,int addr,int pal)                 \
+{                                                            \
+  unsigned char *pd = HighCol+sx;                            \
+  unsigned int pack;                                         \
+                                                             \
+  pack=*(unsigned int *)(PicoDrawSrc->vram+addr); /* 8 px */ \
+  if (pack)                                                  \
+  {                                                          \
+    tvec t = tile_row(pack, flip);                           \
+    tv_store(pd, v##pix_func(tv_load(pd), t, tv_dup(pal)));  \
+    return 0;                                                \
+  }                                                          \
+                                                             \
+  return 1; /* Tile blank */                                 \
+}
+
+#define TileNormMaker(funcname,pix_func) TileVecMaker(funcname,pix_func,0)
+#define TileFlipMaker(funcname,pix_func) TileVecMaker(funcname,pix_func,1)
+
+#else
+
 #define TileNormMaker(funcname,pix_func)                     \
 static int funcname(int sx,int addr,int pal)                 \
 {                                                            \
   unsigned char *pd = HighCol+sx;                            \
   unsigned int pack=0; unsigned int t=0;                     \
                                                              \
-  pack=*(unsigned int *)(Pico.vram+addr); /* Get 8 pixels */ \
+  pack=*(unsigned int *)(PicoDrawSrc->vram+addr); /* 8 px */ \
   if (pack)                                                  \
   {                                                          \
     t=(pack&0x0000f000)>>12; pix_func(0);                    \
@@ -125,7 +224,7 @@ static int funcname(int sx,int addr,int pal)                 \
   unsigned char *pd = HighCol+sx;                            \
   unsigned int pack=0; unsigned int t=0;                     \
                                                              \
-  pack=*(unsigned int *)(Pico.vram+addr); /* Get 8 pixels */ \
+  pack=*(unsigned int *)(PicoDrawSrc->vram+addr); /* 8 px */ \
   if (pack)                                                  \
   {                                                          \
     t=(pack&0x000f0000)>>16; pix_func(0);                    \
@@ -142,6 +241,8 @@ static int funcname(int sx,int addr,int pal)                 \
   return 1; /* Tile blank */                                 \
 }
 
+#endif
+
 
 #ifdef _ASM_DRAW_C_AMIPS
 int TileNorm(int sx,int addr,int pal);
@@ -151,6 +252,13 @@ int TileFlip(int sx,int addr,int pal);
 #define pix_just_write(x) \
   if (t) pd[x]=pal|t
 
+#ifdef HAVE_TILE_VEC
+static inline tvec vpix_just_write(tvec p, tvec t, tvec pal)
+{
+  return tv_sel(tv_z(t), p, tv_or(pal, t));
+}
+#endif
+
 TileNormMaker(TileNorm,pix_just_write)
 TileFlipMaker(TileFlip,pix_just_write)
 
@@ -164,6 +272,14 @@ TileFlipMaker(TileFlip,pix_just_write)
   else if (t>=0xe) pd[x]=(pd[x]&0x3f)|(t<<6); /* c0 shadow, 80 hilight */ \
   else pd[x]=pal|t
 
+#ifdef HAVE_TILE_VEC
+static inline tvec vpix_sh(tvec p, tvec t, tvec pal)
+{
+  tvec v = tv_sel(tv_op(t), tv_sh_op(p, t), tv_or(pal, t));
+  return tv_sel(tv_z(t), p, v);
+}
+#endif
+
 TileNormMaker(TileNormSH, pix_sh)
 TileFlipMaker(TileFlipSH, pix_sh)
 
@@ -173,6 +289,15 @@ TileFlipMaker(TileFlipSH, pix_sh)
   else if (t>=0xe) pd[x]|=0x80; \
   else pd[x]=pal|t
 
+#ifdef HAVE_TILE_VEC
+static inline tvec vpix_sh_markop(tvec p, tvec t, tvec pal)
+{
+  tvec op = tv_op(t);
+  p = tv_sel(tv_z(t), p, tv_sel(op, p, tv_or(pal, t)));
+  return tv_or(p, tv_and(op, tv_dup(0x80)));
+}
+#endif
+
 TileNormMaker(TileNormSH_markop, pix_sh_markop)
 TileFlipMaker(TileFlipSH_markop, pix_sh_markop)
 
@@ -181,6 +306,14 @@ TileFlipMaker(TileFlipSH_markop, pix_sh_markop)
   if (t>=0xe && (pd[x]&0xc0)) \
     pd[x]=(pd[x]&0x3f)|(t<<6); /* c0 shadow, 80 hilight */ \
 
+#ifdef HAVE_TILE_VEC
+static inline tvec vpix_sh_onlyop(tvec p, tvec t, tvec pal)
+{
+  tvec m = tv_andn(tv_op(t), tv_z(tv_and(p, tv_dup(0xc0))));
+  return tv_sel(m, tv_sh_op(p, t), p);
+}
+#endif
+
 TileNormMaker(TileNormSH_onlyop_lp, pix_sh_onlyop)
 TileFlipMaker(TileFlipSH_onlyop_lp, pix_sh_onlyop)
 
@@ -190,6 +323,14 @@ TileFlipMaker(TileFlipSH_onlyop_lp, pix_sh_onlyop)
 #define pix_as(x) \
   if (t && !(pd[x]&0x80)) pd[x]=pal|t
 
+#ifdef HAVE_TILE_VEC
+static inline tvec vpix_as(tvec p, tvec t, tvec pal)
+{
+  tvec m = tv_andn(tv_z(tv_and(p, tv_dup(0x80))), tv_z(t));
+  return tv_sel(m, tv_or(pal, t), p);
+}
+#endif
+
 TileNormMaker(TileNormAS, pix_as)
 TileFlipMaker(TileFlipAS, pix_as)
 
@@ -197,6 +338,14 @@ TileFlipMaker(TileFlipAS, pix_as)
 #define pix_sh_as_noop(x) \
   if (t && t < 0xe && !(pd[x]&0x80)) pd[x]=pal|t
 
+#ifdef HAVE_TILE_VEC
+static inline tvec vpix_sh_as_noop(tvec p, tvec t, tvec pal)
+{
+  tvec m = tv_andn(tv_z(tv_and(p, tv_dup(0x80))), tv_or(tv_z(t), tv_op(t)));
+  return tv_sel(m, tv_or(pal, t), p);
+}
+#endif
+
 TileNormMaker(TileNormAS_noop, pix_sh_as_noop)
 TileFlipMaker(TileFlipAS_noop, pix_sh_as_noop)
 
@@ -204,6 +353,13 @@ TileFlipMaker(TileFlipAS_noop, pix_sh_as_noop)
 #define pix_sh_as_onlymark(x) \
   if (t) pd[x]|=0x80
 
+#ifdef HAVE_TILE_VEC
+static inline tvec vpix_sh_as_onlymark(tvec p, tvec t, tvec pal)
+{
+  return tv_or(p, tv_andn(tv_dup(0x80), tv_z(t)));
+}
+#endif
+
 TileNormMaker(TileNormAS_onlymark, pix_sh_as_onlymark)
 TileFlipMaker(TileFlipAS_onlymark, pix_sh_as_onlymark)
 
@@ -230,7 +386,7 @@ static void DrawStrip(struct TileStrip *ts, int plane_sh, int cellskip)
   {
     int zero=0;
 
-    code=Pico.vram[ts->nametab+(tilex&ts->xmask)];
+    code=PicoDrawSrc->vram[ts->nametab+(tilex&ts->xmask)];
     if (code==blank) continue;
     if (code>>15) { // high priority tile
       int cval = code | (dx<<16) | (ty<<25);
@@ -283,7 +439,7 @@ void DrawStripVSRam(struct TileStrip *ts, int plane_sh, int cellskip)
     //if((cell&1)==0)
     {
       int line,vscroll;
-      vscroll=Pico.vsram[(plane_sh&1)+(cell&~1)];
+      vscroll=PicoDrawSrc->vsram[(plane_sh&1)+(cell&~1)];
 
       // Find the line in the name table
       line=(vscroll+scan)&ts->line&0xffff; // ts->line is really ymask ..
@@ -291,7 +447,7 @@ void DrawStripVSRam(struct TileStrip *ts, int plane_sh, int cellskip)
       ty=(line&7)<<1; // Y-Offset into tile
     }
 
-    code=Pico.vram[ts->nametab+nametabadd+(tilex&ts->xmask)];
+    code=PicoDrawSrc->vram[ts->nametab+nametabadd+(tilex&ts->xmask)];
     if (code==blank) continue;
     if (code>>15) { // high priority tile
       int cval = code | (dx<<16) | (ty<<25);
@@ -341,7 +497,7 @@ void DrawStripInterlace(struct TileStrip *ts)
   {
     int zero=0;
 
-    code=Pico.vram[ts->nametab+(tilex&ts->xmask)];
+    code=PicoDrawSrc->vram[ts->nametab+(tilex&ts->xmask)];
     if (code==blank) continue;
     if (code>>15) { // high priority tile
       int cval = (code&0xfc00) | (dx<<16) | (ty<<25);
@@ -357,7 +513,7 @@ void DrawStripInterlace(struct TileStrip *ts)
       addr=(code&0x7ff)<<5;
       if (code&0x1000) addr+=30-ty; else addr+=ty; // Y-flip
 
-//      pal=Pico.cram+((code>>9)&0x30);
+//      pal=PicoDrawSrc->cram+((code>>9)&0x30);
       pal=((code>>9)&0x30);
     }
 
@@ -376,7 +532,7 @@ void DrawStripInterlace(struct TileStrip *ts)
 #ifndef _ASM_DRAW_C
 static void DrawLayer(int plane_sh, int *hcache, int cellskip, int maxcells)
 {
-  struct PicoVideo *pvid=&Pico.video;
+  struct PicoVideo *pvid=&PicoDrawSrc->video;
   const char shift[4]={5,6,5,7}; // 32,64 or 128 sized tilemaps (2 is invalid)
   struct TileStrip ts;
   int width, height, ymask;
@@ -406,11 +562,11 @@ static void DrawLayer(int plane_sh, int *hcache, int cellskip, int maxcells)
   htab+=plane_sh&1; // A or B
 
   // Get horizontal scroll value, will be masked later
-  ts.hscroll=Pico.vram[htab&0x7fff];
+  ts.hscroll=PicoDrawSrc->vram[htab&0x7fff];
 
   if((pvid->reg[12]&6) == 6) {
     // interlace mode 2
-    vscroll=Pico.vsram[plane_sh&1]; // Get vertical scroll value
+    vscroll=PicoDrawSrc->vsram[plane_sh&1]; // Get vertical scroll value
 
     // Find the line in the name table
     ts.line=(vscroll+(DrawScanline<<1))&((ymask<<1)|1);
@@ -423,7 +579,7 @@ static void DrawLayer(int plane_sh, int *hcache, int cellskip, int maxcells)
     ts.line=ymask|(shift[width]<<24); // save some stuff instead of line
     DrawStripVSRam(&ts, plane_sh, cellskip);
   } else {
-    vscroll=Pico.vsram[plane_sh&1]; // Get vertical scroll value
+    vscroll=PicoDrawSrc->vsram[plane_sh&1]; // Get vertical scroll value
 
     // Find the line in the name table
     ts.line=(vscroll+DrawScanline)&ymask;
@@ -439,7 +595,7 @@ static void DrawLayer(int plane_sh, int *hcache, int cellskip, int maxcells)
 // tstart & tend are tile pair numbers
 static void DrawWindow(int tstart, int tend, int prio, int sh) // int *hcache
 {
-  struct PicoVideo *pvid=&Pico.video;
+  struct PicoVideo *pvid=&PicoDrawSrc->video;
   int tilex,ty,nametab,code=0;
   int blank=-1; // The tile we know is blank
 
@@ -459,7 +615,7 @@ static void DrawWindow(int tstart, int tend, int prio, int sh) // int *hcache
 
   if (!(rendstatus & PDRAW_WND_DIFF_PRIO)) {
     // check the first tile code
-    code=Pico.vram[nametab+tilex];
+    code=PicoDrawSrc->vram[nametab+tilex];
     // if the whole window uses same priority (what is often the case), we may be able to skip this field
     if ((code>>15) != prio) return;
   }
@@ -475,7 +631,7 @@ static void DrawWindow(int tstart, int tend, int prio, int sh) // int *hcache
       int addr=0,zero=0;
       int pal;
 
-      code=Pico.vram[nametab+tilex];
+      code=PicoDrawSrc->vram[nametab+tilex];
       if (code==blank) continue;
       if ((code>>15) != prio) {
         rendstatus |= PDRAW_WND_DIFF_PRIO;
@@ -501,7 +657,7 @@ static void DrawWindow(int tstart, int tend, int prio, int sh) // int *hcache
       int addr=0,zero=0;
       int pal;
 
-      code=Pico.vram[nametab+tilex];
+      code=PicoDrawSrc->vram[nametab+tilex];
       if(code==blank) continue;
       if((code>>15) != prio) {
         rendstatus |= PDRAW_WND_DIFF_PRIO;
@@ -602,7 +758,7 @@ static void DrawTilesFromCache(int *hc, int sh, int rlim)
 
 last_cut_tile:
   {
-    unsigned int t, pack=*(unsigned int *)(Pico.vram+addr); // Get 8 pixels
+    unsigned int t, pack=*(unsigned int *)(PicoDrawSrc->vram+addr); // Get 8 pixels
     unsigned char *pd = HighCol+dx;
     if (!pack) return;
     if (code&0x0800)
@@ -737,7 +893,7 @@ static void DrawSpriteInterlace(unsigned int *sprite)
 
 static void DrawAllSpritesInterlace(int pri, int sh)
 {
-  struct PicoVideo *pvid=&Pico.video;
+  struct PicoVideo *pvid=&PicoDrawSrc->video;
   int i,u,table,link=0,sline=DrawScanline<<1;
   unsigned int *sprites[80]; // Sprite index
 
@@ -750,7 +906,7 @@ static void DrawAllSpritesInterlace(int pri, int sh)
     unsigned int *sprite;
     int code, sx, sy, height;
 
-    sprite=(unsigned int *)(Pico.vram+((table+(link<<2))&0x7ffc)); // Find sprite
+    sprite=(unsigned int *)(PicoDrawSrc->vram+((table+(link<<2))&0x7ffc)); // Find sprite
 
     // get sprite info
     code = sprite[0];
@@ -954,20 +1110,20 @@ static void DrawSpritesHiAS(unsigned char *sprited, int sh)
 
 void PrepareSprites(int full)
 {
-  struct PicoVideo *pvid=&Pico.video;
+  struct PicoVideo *pvid=&PicoDrawSrc->video;
   int u,link=0,sh;
   int table=0;
   int *pd = HighPreSpr;
   int max_lines = 224, max_sprites = 80, max_width = 328;
   int max_line_sprites = 20; // 20 sprites, 40 tiles
 
-  if (!(Pico.video.reg[12]&1))
+  if (!(PicoDrawSrc->video.reg[12]&1))
     max_sprites = 64, max_line_sprites = 16, max_width = 264;
   if (PicoOpt & POPT_DIS_SPRITE_LIM)
     max_line_sprites = MAX_LINE_SPRITES;
 
   if (pvid->reg[1]&8) max_lines = 240;
-  sh = Pico.video.reg[0xC]&8; // shadow/hilight?
+  sh = PicoDrawSrc->video.reg[0xC]&8; // shadow/hilight?
 
   table=pvid->reg[5]&0x7f;
   if (pvid->reg[12]&1) table&=0x7e; // Lowest bit 0 in 40-cell mode
@@ -982,7 +1138,7 @@ void PrepareSprites(int full)
       unsigned int *sprite;
       int code2, sx, sy, height;
 
-      sprite=(unsigned int *)(Pico.vram+((table+(link<<2))&0x7ffc)); // Find sprite
+      sprite=(unsigned int *)(PicoDrawSrc->vram+((table+(link<<2))&0x7ffc)); // Find sprite
 
       // parse sprite info
       code2 = sprite[1];
@@ -1034,7 +1190,7 @@ found:;
       unsigned int *sprite;
       int code, code2, sx, sy, hv, height, width;
 
-      sprite=(unsigned int *)(Pico.vram+((table+(link<<2))&0x7ffc)); // Find sprite
+      sprite=(unsigned int *)(PicoDrawSrc->vram+((table+(link<<2))&0x7ffc)); // Find sprite
 
       // parse sprite info
       code = sprite[0];
@@ -1164,9 +1320,9 @@ void PicoDoHighPal555(int sh)
   unsigned int *spal, *dpal;
   unsigned int t, i;
 
-  Pico.m.dirtyPal = 0;
+  PicoDrawSrc->m.dirtyPal = 0;
 
-  spal = (void *)Pico.cram;
+  spal = (void *)PicoDrawSrc->cram;
   dpal = (void *)HighPal;
 
   for (i = 0; i < 0x40 / 2; i++) {
@@ -1202,10 +1358,10 @@ static void FinalizeLineBGR444(int sh, int line)
 {
   unsigned short *pd=DrawLineDest;
   unsigned char  *ps=HighCol+8;
-  unsigned short *pal=Pico.cram;
+  unsigned short *pal=PicoDrawSrc->cram;
   int len, i, t, mask=0xff;
 
-  if (Pico.video.reg[12]&1) {
+  if (PicoDrawSrc->video.reg[12]&1) {
     len = 320;
   } else {
     if(!(PicoOpt&POPT_DIS_32C_BORDER)) pd+=32;
@@ -1214,8 +1370,8 @@ static void FinalizeLineBGR444(int sh, int line)
 
   if(sh) {
     pal=HighPal;
-    if(Pico.m.dirtyPal) {
-      blockcpy(pal, Pico.cram, 0x40*2);
+    if(PicoDrawSrc->m.dirtyPal) {
+      blockcpy(pal, PicoDrawSrc->cram, 0x40*2);
       // shadowed pixels
       for(i = 0x3f; i >= 0; i--)
         pal[0x40|i] = pal[0xc0|i] = (unsigned short)((pal[i]>>1)&0x0777);
@@ -1224,7 +1380,7 @@ static void FinalizeLineBGR444(int sh, int line)
         t=pal[i]&0xeee;t+=0x444;if(t&0x10)t|=0xe;if(t&0x100)t|=0xe0;if(t&0x1000)t|=0xe00;t&=0xeee;
         pal[0x80|i]=(unsigned short)t;
       }
-      Pico.m.dirtyPal = 0;
+      PicoDrawSrc->m.dirtyPal = 0;
     }
   }
 
@@ -1244,10 +1400,10 @@ void FinalizeLine555(int sh, int line)
   unsigned short *pal=HighPal;
   int len;
 
-  if (Pico.m.dirtyPal)
+  if (PicoDrawSrc->m.dirtyPal)
     PicoDoHighPal555(sh);
 
-  if (Pico.video.reg[12]&1) {
+  if (PicoDrawSrc->video.reg[12]&1) {
     len = 320;
   } else {
     if (!(PicoOpt&POPT_DIS_32C_BORDER)) pd+=32;
@@ -1273,13 +1429,222 @@ void FinalizeLine555(int sh, int line)
 }
 #endif
 
+// XRGB8888 output.
+// HighPal already has s/h entries in the upper 3/4, so expanding all
+// 0x100 entries lets the finalizers do a plain 8bit lookup for any mode.
+// channels are widened by bit replication, so full intensity is 0xff.
+unsigned int HighPal32[0x100];
+#if defined(__aarch64__) && defined(__ARM_NEON)
+static unsigned char HighPalB[0x100], HighPalG[0x100], HighPalR[0x100];
+#endif
+
+#if defined(__SSE2__) && defined(__GNUC__)
+void PicoDoHighPal8888(void)
+{
+  const __m128i m5 = _mm_set1_epi16(0x1f), m6 = _mm_set1_epi16(0x3f);
+  __m128i t, r, g, b, gb;
+  int i;
+
+  for (i = 0; i < 0x100; i += 8) {
+    t = _mm_loadu_si128((void *)&HighPal[i]);
+#ifdef USE_BGR555
+    r = _mm_and_si128(t, m5);
+    g = _mm_and_si128(_mm_srli_epi16(t, 5), m5);
+    g = _mm_or_si128(_mm_slli_epi16(g, 3), _mm_srli_epi16(g, 2));
+    b = _mm_and_si128(_mm_srli_epi16(t, 10), m5);
+#else
+    r = _mm_srli_epi16(t, 11);
+    g = _mm_and_si128(_mm_srli_epi16(t, 5), m6);
+    g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+    b = _mm_and_si128(t, m5);
+#endif
+    r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+    b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+    gb = _mm_or_si128(_mm_slli_epi16(g, 8), b);
+    _mm_storeu_si128((void *)&HighPal32[i],     _mm_unpacklo_epi16(gb, r));
+    _mm_storeu_si128((void *)&HighPal32[i + 4], _mm_unpackhi_epi16(gb, r));
+  }
+}
+
+static void clut8888_sse2(unsigned int *pd, const unsigned char *ps, int len, int mask)
+{
+  const unsigned int *pal = HighPal32;
+  int i;
+
+  for (i = 0; i < len; i += 4)
+    _mm_storeu_si128((void *)&pd[i], _mm_set_epi32(pal[ps[i+3] & mask],
+      pal[ps[i+2] & mask], pal[ps[i+1] & mask], pal[ps[i] & mask]));
+}
+
+#ifdef HAVE_AVX2_CLUT
+__attribute__((target("avx2")))
+static void clut8888_avx2(unsigned int *pd, const unsigned char *ps, int len, int mask)
+{
+  __m256i m = _mm256_set1_epi32(mask), idx;
+  int i;
+
+  for (i = 0; i < len; i += 8) {
+    idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const void *)&ps[i]));
+    idx = _mm256_and_si256(idx, m);
+    _mm256_storeu_si256((void *)&pd[i],
+      _mm256_i32gather_epi32((const int *)HighPal32, idx, 4));
+  }
+}
+#endif
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+void PicoDoHighPal8888(void)
+{
+  uint16x8_t t, r, g, b;
+  int i;
+
+  for (i = 0; i < 0x100; i += 8) {
+    t = vld1q_u16(&HighPal[i]);
+#ifdef USE_BGR555
+    r = vandq_u16(t, vdupq_n_u16(0x1f));
+    g = vandq_u16(vshrq_n_u16(t, 5), vdupq_n_u16(0x1f));
+    g = vorrq_u16(vshlq_n_u16(g, 3), vshrq_n_u16(g, 2));
+    b = vshrq_n_u16(t, 10);
+#else
+    r = vshrq_n_u16(t, 11);
+    g = vandq_u16(vshrq_n_u16(t, 5), vdupq_n_u16(0x3f));
+    g = vorrq_u16(vshlq_n_u16(g, 2), vshrq_n_u16(g, 4));
+    b = vandq_u16(t, vdupq_n_u16(0x1f));
+#endif
+    r = vorrq_u16(vshlq_n_u16(r, 3), vshrq_n_u16(r, 2));
+    b = vorrq_u16(vshlq_n_u16(b, 3), vshrq_n_u16(b, 2));
+    vst1_u8(&HighPalR[i], vmovn_u16(r));
+    vst1_u8(&HighPalG[i], vmovn_u16(g));
+    vst1_u8(&HighPalB[i], vmovn_u16(b));
+    vst1q_u32(&HighPal32[i], vorrq_u32(vshll_n_u16(vget_low_u16(r), 16),
+      vmovl_u16(vget_low_u16(vorrq_u16(vshlq_n_u16(g, 8), b)))));
+    vst1q_u32(&HighPal32[i + 4], vorrq_u32(vshll_n_u16(vget_high_u16(r), 16),
+      vmovl_u16(vget_high_u16(vorrq_u16(vshlq_n_u16(g, 8), b)))));
+  }
+}
+
+static uint8x16x4_t clut_tab(const unsigned char *p)
+{
+  uint8x16x4_t t;
+  t.val[0] = vld1q_u8(p);
+  t.val[1] = vld1q_u8(p + 0x10);
+  t.val[2] = vld1q_u8(p + 0x20);
+  t.val[3] = vld1q_u8(p + 0x30);
+  return t;
+}
+
+// 0x100 entry byte lookup per channel, tbx leaves out of range lanes alone
+static uint8x16_t clut_plane(const unsigned char *plane, uint8x16_t idx)
+{
+  const uint8x16_t k64 = vdupq_n_u8(0x40);
+  uint8x16_t r;
+
+  r = vqtbl4q_u8(clut_tab(plane), idx);
+  idx = vsubq_u8(idx, k64);
+  r = vqtbx4q_u8(r, clut_tab(plane + 0x40), idx);
+  idx = vsubq_u8(idx, k64);
+  r = vqtbx4q_u8(r, clut_tab(plane + 0x80), idx);
+  idx = vsubq_u8(idx, k64);
+  return vqtbx4q_u8(r, clut_tab(plane + 0xc0), idx);
+}
+
+static void clut8888_neon(unsigned int *pd, const unsigned char *ps, int len, int mask)
+{
+  uint8x16_t m = vdupq_n_u8(mask), idx;
+  uint8x16x4_t px;
+  int i;
+
+  px.val[3] = vdupq_n_u8(0);
+  for (i = 0; i < len; i += 16) {
+    idx = vandq_u8(vld1q_u8(&ps[i]), m);
+    px.val[0] = clut_plane(HighPalB, idx);
+    px.val[1] = clut_plane(HighPalG, idx);
+    px.val[2] = clut_plane(HighPalR, idx);
+    vst4q_u8((unsigned char *)&pd[i], px);
+  }
+}
+
+#else
+void PicoDoHighPal8888(void)
+{
+  unsigned int t, r, g, b;
+  int i;
+
+  for (i = 0; i < 0x100; i++) {
+    t = HighPal[i];
+#ifdef USE_BGR555
+    r = t & 0x1f; g = (t >> 5) & 0x1f; b = (t >> 10) & 0x1f;
+    g = (g << 3) | (g >> 2);
+#else
+    r = t >> 11; g = (t >> 5) & 0x3f; b = t & 0x1f;
+    g = (g << 2) | (g >> 4);
+#endif
+    r = (r << 3) | (r >> 2);
+    b = (b << 3) | (b >> 2);
+    HighPal32[i] = (r << 16) | (g << 8) | b;
+  }
+}
+#endif
+
+static void clut8888_c(unsigned int *pd, const unsigned char *ps, int len, int mask)
+{
+  const unsigned int *pal = HighPal32;
+  int i;
+
+  for (i = 0; i < len; i += 4) {
+    pd[i + 0] = pal[ps[i + 0] & mask];
+    pd[i + 1] = pal[ps[i + 1] & mask];
+    pd[i + 2] = pal[ps[i + 2] & mask];
+    pd[i + 3] = pal[ps[i + 3] & mask];
+  }
+}
+
+static void (*clut8888)(unsigned int *pd, const unsigned char *ps, int len, int mask) = clut8888_c;
+
+static void clut8888_select(void)
+{
+#if defined(__SSE2__) && defined(__GNUC__)
+  clut8888 = clut8888_sse2;
+#ifdef HAVE_AVX2_CLUT
+  if (__builtin_cpu_supports("avx2"))
+    clut8888 = clut8888_avx2;
+#endif
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  clut8888 = clut8888_neon;
+#endif
+}
+
+void FinalizeLine8888(int sh, int line)
+{
+  unsigned int *pd = DrawLineDest;
+  int len, mask = 0xff;
+
+  if (PicoDrawSrc->m.dirtyPal) {
+    PicoDoHighPal555(sh);
+    PicoDoHighPal8888();
+  }
+
+  if (PicoDrawSrc->video.reg[12]&1) {
+    len = 320;
+  } else {
+    if (!(PicoOpt&POPT_DIS_32C_BORDER)) pd+=32;
+    len = 256;
+  }
+
+  if (!sh && (rendstatus & PDRAW_SPR_LO_ON_HI))
+    mask=0x3f; // accurate sprites, upper bits are priority stuff
+
+  clut8888(pd, HighCol+8, len, mask);
+}
+
+static int dirty_count;
+
 static void FinalizeLine8bit(int sh, int line)
 {
   unsigned char *pd = DrawLineDest;
   int len, rs = rendstatus;
-  static int dirty_count;
 
-  if (!sh && Pico.m.dirtyPal == 1)
+  if (!sh && PicoDrawSrc->m.dirtyPal == 1)
   {
     // a hack for mid-frame palette changes
     if (!(rs & PDRAW_SONIC_MODE))
@@ -1288,13 +1653,13 @@ static void FinalizeLine8bit(int sh, int line)
     rs |= PDRAW_SONIC_MODE;
     rendstatus = rs;
     if (dirty_count == 3) {
-      blockcpy(HighPal, Pico.cram, 0x40*2);
+      blockcpy(HighPal, PicoDrawSrc->cram, 0x40*2);
     } else if (dirty_count == 11) {
-      blockcpy(HighPal+0x40, Pico.cram, 0x40*2);
+      blockcpy(HighPal+0x40, PicoDrawSrc->cram, 0x40*2);
     }
   }
 
-  if (Pico.video.reg[12]&1) {
+  if (PicoDrawSrc->video.reg[12]&1) {
     len = 320;
   } else {
     if (!(PicoOpt & POPT_DIS_32C_BORDER))
@@ -1320,7 +1685,7 @@ static void (*FinalizeLine)(int sh, int line);
 static int DrawDisplay(int sh)
 {
   unsigned char *sprited = &HighLnSpr[DrawScanline][0];
-  struct PicoVideo *pvid=&Pico.video;
+  struct PicoVideo *pvid=&PicoDrawSrc->video;
   int win=0,edge=0,hvwind=0;
   int maxw,maxcells;
 
@@ -1401,25 +1766,106 @@ static int DrawDisplay(int sh)
     int *c, a, b;
     for (a = 0, c = HighCacheA; *c; c++, a++);
     for (b = 0, c = HighCacheB; *c; c++, b++);
-    printf("%i:%03i: a=%i, b=%i\n", Pico.m.frame_count, DrawScanline, a, b);
+    printf("%i:%03i: a=%i, b=%i\n", PicoDrawSrc->m.frame_count, DrawScanline, a, b);
   }
 #endif
 
   return 0;
 }
 
+// unchanged frame detection.
+// a frame starting from the same display state as the last one drawn
+// completely from a single state is not drawn, the out buffer already
+// has it. The renderer is lazy, so the decision is made when the frame's
+// lines are requested; a vdp write before that means a normal draw.
+int PicoFrameUnchanged;
+int PicoDisplayDirty = 1; // vram/cram/vsram/regs written since frame start
+
+static struct {
+  int skip;                // passing over lines of this frame
+  int valid;               // out buffer has the image of state 'hash'
+  unsigned long long hash;
+  int opt, mask;
+} same;
+
+static void same_reset(void)
+{
+  same.skip = same.valid = 0;
+  PicoFrameUnchanged = 0;
+}
+
+static unsigned long long hash_words(unsigned long long h, const void *p, int size)
+{
+  const unsigned long long *w = p;
+  int i;
+
+  for (i = 0; i < size / 8; i++)
+    h = (h ^ w[i]) * 0x100000001b3ull;
+  return h;
+}
+
+static int same_check(void)
+{
+  unsigned long long h;
+
+  if (!(PicoOpt & POPT_EN_FRAME_REUSE) || (PicoOpt & POPT_ALT_RENDERER)
+      || (PicoAHW & (PAHW_32X|PAHW_SMS))
+      || PicoScanBegin != NULL || PicoScanEnd != NULL) {
+    same.valid = 0;
+    return 0;
+  }
+
+  if (PicoDisplayDirty) {
+    PicoDisplayDirty = 0;
+    h = hash_words(0xcbf29ce484222325ull, Pico.vram, sizeof(Pico.vram));
+    h = hash_words(h, Pico.cram, sizeof(Pico.cram));
+    h = hash_words(h, Pico.vsram, sizeof(Pico.vsram));
+    h = hash_words(h, Pico.video.reg, sizeof(Pico.video.reg));
+    if (h != same.hash)
+      same.valid = 0;
+    same.hash = h;
+  }
+  if (PicoOpt != same.opt || PicoDrawMask != same.mask) {
+    same.opt = PicoOpt;
+    same.mask = PicoDrawMask;
+    same.valid = 0;
+  }
+  return same.valid;
+}
+
+// lines already in the out buffer
+static void SkipLines(int to)
+{
+  int n = to + 1 - DrawScanline;
+
+  if (n <= 0)
+    return;
+  HighCol += n * HighColIncrement;
+  DrawLineDest = (char *)DrawLineDest + n * DrawLineDestIncrement;
+  DrawScanline = to + 1;
+}
+
 // MUST be called every frame
 PICO_INTERNAL void PicoFrameStart(void)
 {
   int offs = 8, lines = 224;
 
+  same.skip = 0;
+  if (!PicoSkipFrame)
+    same.skip = same_check();
+  PicoFrameUnchanged = same.skip;
+
+#ifdef DRAW_THREADS
+  PicoDrawMtFrameStart();
+#endif
+
   // prepare to do this frame
   rendstatus = 0;
-  if ((Pico.video.reg[12] & 6) == 6)
+  if ((PicoDrawSrc->video.reg[12] & 6) == 6)
     rendstatus |= PDRAW_INTERLACE; // interlace mode
-  if (!(Pico.video.reg[12] & 1))
+  if (!(PicoDrawSrc->video.reg[12] & 1))
     rendstatus |= PDRAW_32_COLS;
-  if (Pico.video.reg[1] & 8) {
+  if (PicoDrawSrc->video.reg[1] & 8) {
     offs = 0;
     lines = 240;
   }
@@ -1428,11 +1874,19 @@ PICO_INTERNAL void PicoFrameStart(void)
     rendlines = lines;
     // mode_change() might reset rendstatus_old by calling SetColorFormat
     emu_video_mode_change((lines == 240) ? 0 : 8,
-      lines, (Pico.video.reg[12] & 1) ? 0 : 1);
+      lines, (PicoDrawSrc->video.reg[12] & 1) ? 0 : 1);
     rendstatus_old = rendstatus;
   }
 
   HighCol = HighColBase + offs * HighColIncrement;
+#ifdef DRAW_THREADS
+  // draw into the buffer not shown, see PicoDrawLastFrame()
+  if (PicoDrawThreaded && DrawLineDestBase2 != NULL) {
+    void *tmp = DrawLineDestBase;
+    DrawLineDestBase = DrawLineDestBase2;
+    DrawLineDestBase2 = tmp;
+  }
+#endif
   DrawLineDest = (char *)DrawLineDestBase + offs * DrawLineDestIncrement;
   DrawScanline = 0;
   skip_next_line = 0;
@@ -1440,8 +1894,8 @@ PICO_INTERNAL void PicoFrameStart(void)
   if (PicoOpt & POPT_ALT_RENDERER)
     return;
 
-  if (Pico.m.dirtyPal)
-    Pico.m.dirtyPal = 2; // reset dirty if needed
+  if (PicoDrawSrc->m.dirtyPal)
+    PicoDrawSrc->m.dirtyPal = 2; // reset dirty if needed
   PrepareSprites(1);
 }
 
@@ -1482,7 +1936,7 @@ static void PicoLine(int line, int offs, int sh, int bgc)
 
   // Draw screen:
   BackFill(bgc, sh);
-  if (Pico.video.reg[1]&0x40)
+  if (PicoDrawSrc->video.reg[1]&0x40)
     DrawDisplay(sh);
 
   if (FinalizeLine != NULL)
@@ -1495,11 +1949,11 @@ static void PicoLine(int line, int offs, int sh, int bgc)
   DrawLineDest = (char *)DrawLineDest + DrawLineDestIncrement;
 }
 
-void PicoDrawSync(int to, int blank_last_line)
+void PicoDrawLines(int to, int blank_last_line)
 {
   int line, offs = 0;
-  int sh = (Pico.video.reg[0xC] & 8) >> 3; // shadow/hilight?
-  int bgc = Pico.video.reg[7];
+  int sh = (PicoDrawSrc->video.reg[0xC] & 8) >> 3; // shadow/hilight?
+  int bgc = PicoDrawSrc->video.reg[7];
 
   pprof_start(draw);
 
@@ -1524,10 +1978,34 @@ void PicoDrawSync(int to, int blank_last_line)
   pprof_end(draw);
 }
 
+void PicoDrawSync(int to, int blank_last_line)
+{
+  // any earlier sync comes before a vdp write, the lines must then be
+  // really drawn, as some renderer state builds up over the frame
+  if (same.skip) {
+    if (!PicoDisplayDirty && !blank_last_line && to >= rendlines - 1) {
+      SkipLines(to);
+      return;
+    }
+    same.skip = PicoFrameUnchanged = 0;
+  }
+  // the last line, was the frame drawn from one state?
+  if (to >= rendlines - 1)
+    same.valid = !PicoDisplayDirty;
+
+#ifdef DRAW_THREADS
+  if (PicoDrawThreaded) {
+    PicoDrawMtSync(to, blank_last_line);
+    return;
+  }
+#endif
+  PicoDrawLines(to, blank_last_line);
+}
+
 // also works for fast renderer
 void PicoDrawUpdateHighPal(void)
 {
-  int sh = (Pico.video.reg[0xC] & 8) >> 3; // shadow/hilight?
+  int sh = (PicoDrawSrc->video.reg[0xC] & 8) >> 3; // shadow/hilight?
   if (PicoOpt & POPT_ALT_RENDERER)
     sh = 0; // no s/h support
 
@@ -1537,10 +2015,13 @@ void PicoDrawUpdateHighPal(void)
     memcpy(HighPal + 0x40, HighPal, 0x40*2);
     memcpy(HighPal + 0x80, HighPal, 0x40*2);
   }
+  if (FinalizeLine == FinalizeLine8888)
+    PicoDoHighPal8888();
 }
 
 void PicoDrawSetOutFormat(pdso_t which, int use_32x_line_mode)
 {
+  PicoDrawMtFrameEnd();
   switch (which)
   {
     case PDF_8BIT:
@@ -1554,6 +2035,11 @@ void PicoDrawSetOutFormat(pdso_t which, int use_32x_line_mode)
         FinalizeLine = FinalizeLine555;
       break;
 
+    case PDF_XRGB8888:
+      clut8888_select();
+      FinalizeLine = FinalizeLine8888;
+      break;
+
     default:
       FinalizeLine = NULL;
       break;
@@ -1561,18 +2047,38 @@ void PicoDrawSetOutFormat(pdso_t which, int use_32x_line_mode)
   PicoDrawSetOutFormat32x(which, use_32x_line_mode);
   PicoDrawSetOutputMode4(which);
   rendstatus_old = -1;
+  same_reset();
 }
 
 // note: may be called on the middle of frame
 void PicoDrawSetOutBuf(void *dest, int increment)
 {
+  PicoDrawMtFrameEnd();
+  if (dest == DrawLineDestBase2)
+    DrawLineDestBase2 = DrawLineDestBase; // keep the pair
   DrawLineDestBase = dest;
   DrawLineDestIncrement = increment;
   DrawLineDest = DrawLineDestBase + DrawScanline * increment;
+  same_reset();
+}
+
+void PicoDrawSetOutBuf2(void *dest2)
+{
+  PicoDrawMtFrameEnd();
+  DrawLineDestBase2 = dest2;
+}
+
+// with the draw thread still on a frame, its buffer isn't done yet
+void *PicoDrawLastFrame(void)
+{
+  if (PicoDrawThreaded && DrawLineDestBase2 != NULL)
+    return DrawLineDestBase2;
+  return DrawLineDestBase;
 }
 
 void PicoDrawSetInternalBuf(void *dest, int increment)
 {
+  PicoDrawMtFrameEnd();
   if (dest != NULL) {
     HighColBase = dest;
     HighColIncrement = increment;
@@ -1582,6 +2088,7 @@ void PicoDrawSetInternalBuf(void *dest, int increment)
     HighColBase = DefHighCol;
     HighColIncrement = 0;
   }
+  same_reset();
 }
 
 void PicoDrawSetCallbacks(int (*begin)(unsigned int num), int (*end)(unsigned int num))
@@ -1600,3 +2107,19 @@ void PicoDrawSetCallbacks(int (*begin)(unsigned int num), int (*end)(unsigned in
     PicoScanEnd = end;
   }
 }
+
+const struct pico_ctx_area ctx_areas_draw[] = {
+  PICO_CTX_AREA(DefHighCol),
+  PICO_CTX_AREA(HighColBase),
+  PICO_CTX_AREA(HighColIncrement),
+  PICO_CTX_AREA(DefOutBuff),
+  PICO_CTX_AREA(HighCacheA),
+  PICO_CTX_AREA(HighCacheB),
+  PICO_CTX_AREA(skip_next_line),
+  PICO_CTX_AREA(dirty_count),
+  PICO_CTX_AREA(FinalizeLine),
+  PICO_CTX_AREA(same),
+  PICO_CTX_AREA(PicoDisplayDirty),
+  PICO_CTX_AREA(PicoFrameUnchanged),
+  PICO_CTX_AREA_END
+};
@@ -622,3 +622,9 @@ PICO_INTERNAL void PicoFrameFull()
 	pprof_end(draw);
 }
 
+const struct pico_ctx_area ctx_areas_draw2[] = {
+	PICO_CTX_AREA(PicoDraw2FB_),
+	PICO_CTX_AREA(HighCache2A),
+	PICO_CTX_AREA(HighCache2B),
+	PICO_CTX_AREA_END
+};
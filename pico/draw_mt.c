@@ -0,0 +1,324 @@
+/*
+ * PicoDrive
+ * (C) agent, 2026
+ *
+ * This work is licensed under the terms of MAME license.
+ * See COPYING file in the top-level directory.
+ *
+ * Line renderer on a separate thread.
+ * At frame start the draw thread gets a copy of the vdp state, after
+ * that every vram/cram/vsram/reg write is appended to a log, together
+ * with the draw requests normally served by PicoDrawSync. The thread
+ * replays the log in order, so each line sees the same vdp state as
+ * it would when drawn inline. The frame is complete when PicoFrame
+ * returns, unless the frontend gave a second out buffer: frames then
+ * alternate between the two and the thread is only waited for at the
+ * next frame start, or before anything else touches the draw state.
+ */
+
+#include "pico_int.h"
+
+#ifdef DRAW_THREADS
+#include <pthread.h>
+#include <sched.h>
+
+#define DMT_DRAW   0x10
+#define DMT_BLOCK  0x11
+
+#define DMT_LOG_SIZE 0x80000 // in u16 entries, power of 2
+#define DMT_SPINS    0x4000
+
+#define log_at(i) dmt_log[(i) & (DMT_LOG_SIZE - 1)]
+
+int PicoDrawThreaded;
+
+static struct Pico dpico;  // vdp state as the renderer sees it
+static unsigned short dmt_log[DMT_LOG_SIZE];
+
+static struct {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int started;
+  volatile int sleeping;
+  volatile int quit;
+  volatile unsigned int wr; // published log end
+  volatile unsigned int rd; // consumed by draw thread
+  unsigned int pos;         // log end, emu thread only
+  int line;                 // next line to request
+} mt;
+
+static void replay_reg(int num, int d)
+{
+  int dold = dpico.video.reg[num];
+
+  dpico.video.reg[num] = d;
+  if (num == 0x05 && (d ^ dold))
+    rendstatus |= PDRAW_SPRITES_MOVED;
+  else if (num == 0x0c && ((d ^ dold) & 8))
+    dpico.m.dirtyPal = 2;
+}
+
+static unsigned int replay(unsigned int rd)
+{
+  unsigned int a, i, n;
+  unsigned short *r;
+
+  switch (log_at(rd))
+  {
+    case DMT_DRAW:
+      PicoDrawLines((short)log_at(rd + 1), log_at(rd + 2));
+      return rd + 3;
+
+    case DMT_VRAM:
+      a = log_at(rd + 1);
+      dpico.vram[(a >> 1) & 0x7fff] = log_at(rd + 2);
+      if (a - ((unsigned)(dpico.video.reg[5] & 0x7f) << 9) < 0x400)
+        rendstatus |= PDRAW_DIRTY_SPRITES;
+      return rd + 3;
+
+    case DMT_CRAM:
+      dpico.m.dirtyPal = 1;
+      dpico.cram[(log_at(rd + 1) >> 1) & 0x3f] = log_at(rd + 2);
+      return rd + 3;
+
+    case DMT_VSRAM:
+      dpico.vsram[(log_at(rd + 1) >> 1) & 0x3f] = log_at(rd + 2);
+      return rd + 3;
+
+    case DMT_REG:
+      replay_reg(log_at(rd + 1), log_at(rd + 2));
+      return rd + 3;
+
+    case DMT_BLOCK:
+      switch (log_at(rd + 1)) {
+        case DMT_VRAM: r = dpico.vram; break;
+        case DMT_CRAM: r = dpico.cram; dpico.m.dirtyPal = 1; break;
+        default:       r = dpico.vsram; break;
+      }
+      a = log_at(rd + 2);
+      n = log_at(rd + 3);
+      rendstatus |= log_at(rd + 4);
+      rd += 5;
+      for (i = 0; i < n; i++, rd++)
+        r[a + i] = log_at(rd);
+      return rd;
+  }
+
+  elprintf(EL_STATUS, "draw_mt: bad log entry %04x", log_at(rd));
+  return mt.wr;
+}
+
+static void *draw_mt_worker(void *arg)
+{
+  unsigned int rd = mt.rd, end;
+  int spins;
+
+  for (;;) {
+    for (spins = 0; mt.wr == rd && !mt.quit; spins++) {
+      if (spins < DMT_SPINS)
+        continue;
+      pthread_mutex_lock(&mt.lock);
+      mt.sleeping = 1;
+      __sync_synchronize();
+      while (mt.wr == rd && !mt.quit)
+        pthread_cond_wait(&mt.cond, &mt.lock);
+      mt.sleeping = 0;
+      pthread_mutex_unlock(&mt.lock);
+    }
+    if (mt.quit)
+      break;
+    __sync_synchronize();
+
+    end = mt.wr;
+    while (rd != end)
+      rd = replay(rd);
+
+    __sync_synchronize();
+    mt.rd = rd;
+  }
+  return NULL;
+}
+
+static int draw_mt_start(void)
+{
+  pthread_mutex_init(&mt.lock, NULL);
+  pthread_cond_init(&mt.cond, NULL);
+  mt.quit = 0;
+  mt.wr = mt.rd = mt.pos = 0;
+
+  if (pthread_create(&mt.thread, NULL, draw_mt_worker, NULL) != 0) {
+    elprintf(EL_STATUS, "draw thread creation failed");
+    pthread_cond_destroy(&mt.cond);
+    pthread_mutex_destroy(&mt.lock);
+    PicoOpt &= ~POPT_EN_DRAW_THREAD;
+    return -1;
+  }
+  mt.started = 1;
+  return 0;
+}
+
+void PicoDrawMtStop(void)
+{
+  if (!mt.started)
+    return;
+
+  PicoDrawMtFrameEnd();
+  pthread_mutex_lock(&mt.lock);
+  mt.quit = 1;
+  pthread_cond_signal(&mt.cond);
+  pthread_mutex_unlock(&mt.lock);
+  pthread_join(mt.thread, NULL);
+
+  pthread_cond_destroy(&mt.cond);
+  pthread_mutex_destroy(&mt.lock);
+  mt.started = 0;
+}
+
+static void publish(void)
+{
+  __sync_synchronize();
+  mt.wr = mt.pos;
+  __sync_synchronize();
+  if (mt.sleeping) {
+    pthread_mutex_lock(&mt.lock);
+    pthread_cond_signal(&mt.cond);
+    pthread_mutex_unlock(&mt.lock);
+  }
+}
+
+static void wait_rd(unsigned int need)
+{
+  int spins = 0;
+
+  while (need ? mt.pos + need - mt.rd > DMT_LOG_SIZE : mt.rd != mt.pos) {
+    if (++spins > DMT_SPINS)
+      sched_yield(), spins = 0;
+  }
+  __sync_synchronize();
+}
+
+static void reserve(unsigned int n)
+{
+  if (mt.pos + n - mt.rd > DMT_LOG_SIZE) {
+    publish();
+    wait_rd(n);
+  }
+}
+
+#define log_put(v) log_at(mt.pos++) = (v)
+
+void PicoDrawMtWrite(int type, unsigned int a, unsigned int d)
+{
+  reserve(3);
+  log_put(type);
+  log_put(a);
+  log_put(d);
+}
+
+// log (part of) vram/cram/vsram starting at byte address a
+void PicoDrawMtBlock(int type, unsigned int a, unsigned int bytes, int rs_flags)
+{
+  unsigned short *src;
+  unsigned int mask, i, n, c;
+
+  if (bytes == 0)
+    return;
+
+  switch (type) {
+    case DMT_VRAM: src = Pico.vram;  mask = 0x7fff; break;
+    case DMT_CRAM: src = Pico.cram;  mask = 0x3f; break;
+    default:       src = Pico.vsram; mask = 0x3f; break;
+  }
+
+  i = (a >> 1) & mask;
+  n = ((a & 1) + bytes + 1) >> 1;
+  if (n > mask + 1)
+    n = mask + 1;
+
+  do {
+    c = n;
+    if (i + c > mask + 1)
+      c = mask + 1 - i;
+    reserve(5 + c);
+    log_put(DMT_BLOCK);
+    log_put(type);
+    log_put(i);
+    log_put(c);
+    log_put(rs_flags);
+    for (n -= c; c > 0; c--, i++)
+      log_put(src[i]);
+    i &= mask;
+  }
+  while (n > 0);
+}
+
+void PicoDrawMtSync(int to, int blank_last_line)
+{
+  if (to < mt.line)
+    return;
+
+  reserve(3);
+  log_put(DMT_DRAW);
+  log_put(to);
+  log_put(blank_last_line);
+  mt.line = to + 1;
+  publish();
+}
+
+// called from PicoFrameStart, the draw thread is idle here
+void PicoDrawMtFrameStart(void)
+{
+  PicoDrawMtFrameEnd();
+  PicoDrawSrc = &Pico;
+
+  if (!(PicoOpt & POPT_EN_DRAW_THREAD) || (PicoOpt & POPT_ALT_RENDERER)
+      || (PicoAHW & (PAHW_32X|PAHW_SMS)) || PicoSkipFrame || PicoFrameUnchanged
+      || PicoScanBegin != NULL || PicoScanEnd != NULL)
+    return;
+
+  if (!mt.started && draw_mt_start() != 0)
+    return;
+
+  memcpy(dpico.vram, Pico.vram, sizeof(dpico.vram));
+  memcpy(dpico.cram, Pico.cram, sizeof(dpico.cram));
+  memcpy(dpico.vsram, Pico.vsram, sizeof(dpico.vsram));
+  dpico.m = Pico.m;
+  dpico.video = Pico.video;
+
+  mt.line = 0;
+  PicoDrawSrc = &dpico;
+  PicoDrawThreaded = 1;
+}
+
+// wait for the draw thread to catch up. Between frames, that is before
+// anything that touches the draw state or the vdp outside of PicoFrame
+void PicoDrawMtFrameEnd(void)
+{
+  if (!PicoDrawThreaded)
+    return;
+
+  publish();
+  wait_rd(0);
+
+  Pico.m.dirtyPal = dpico.m.dirtyPal;
+  PicoDrawSrc = &Pico;
+  PicoDrawThreaded = 0;
+}
+
+// end of PicoFrame. With a buffer of its own, the thread finishes the
+// frame while PicoFrame returns, PicoDrawMtFrameEnd() joins it later
+void PicoDrawMtFrameDone(void)
+{
+  if (!PicoDrawThreaded)
+    return;
+
+  if (DrawLineDestBase2 != NULL)
+    publish();
+  else
+    PicoDrawMtFrameEnd();
+}
+
+#endif // DRAW_THREADS
+
+// vim:shiftwidth=2:ts=2:expandtab
@@ -210,3 +210,7 @@ unsigned int EEPROM_read(void)
   return (d << SRam.eeprom_bit_out);
 }
 
+const struct pico_ctx_area ctx_areas_eeprom[] = {
+  PICO_CTX_AREA(last_write),
+  PICO_CTX_AREA_END
+};
@@ -304,8 +304,7 @@ enum media_type_e PicoLoadMedia(const char *filename,
     PicoSetInputDevice(0, PICO_INPUT_PAD_6BTN);
 
 out:
-  if (rom_data)
-    free(rom_data);
+  PicoCartLoadFree(rom_data);
   return media_type;
 }
 
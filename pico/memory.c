@@ -152,6 +152,14 @@ MAKE_68K_WRITE32(m68k_write32, m68k_write16_map)
 
 static u32 ym2612_read_local_68k(void);
 static int ym2612_write_local(u32 a, u32 d, int is_from_z80);
+
+static void psg_write(u32 d)
+{
+  if (PsndThreaded)
+    PsndMtPsgWrite(d);
+  else
+    SN76496Write(d);
+}
 static void z80_mem_setup(void);
 
 #ifdef _ASM_MEMORY_C
@@ -494,6 +502,7 @@ static void PicoWrite8_z80(u32 a, u32 d)
   if ((a & 0x4000) == 0x0000) { // z80 RAM
     SekCyclesBurnRun(2); // FIXME hack
     Pico.zram[a & 0x1fff] = (u8)d;
+    cz80_drc_wcheck8(&Pico.zram[a & 0x1fff]);
     return;
   }
   if ((a & 0x6000) == 0x4000) { // FM Sound
@@ -504,7 +513,7 @@ static void PicoWrite8_z80(u32 a, u32 d)
   // TODO: probably other VDP access too? Maybe more mirrors?
   if ((a & 0x7ff9) == 0x7f11) { // PSG Sound
     if (PicoOpt & POPT_EN_PSG)
-      SN76496Write(d);
+      psg_write(d);
     return;
   }
   if ((a & 0x7f00) == 0x6000) // Z80 BANK register
@@ -679,7 +688,7 @@ static void PicoWrite8_vdp(u32 a, u32 d)
 {
   if ((a & 0x00f9) == 0x0011) { // PSG Sound
     if (PicoOpt & POPT_EN_PSG)
-      SN76496Write(d);
+      psg_write(d);
     return;
   }
   if ((a & 0x00e0) == 0x0000) {
@@ -695,7 +704,7 @@ static void PicoWrite16_vdp(u32 a, u32 d)
 {
   if ((a & 0x00f9) == 0x0010) { // PSG Sound
     if (PicoOpt & POPT_EN_PSG)
-      SN76496Write(d);
+      psg_write(d);
     return;
   }
   if ((a & 0x00e0) == 0x0000) {
@@ -1024,6 +1033,8 @@ static int ym2612_write_local(u32 a, u32 d, int is_from_z80)
   if (PicoOpt & POPT_EXT_FM)
     return YM2612Write_940(a, d, get_scanline(is_from_z80));
 #endif
+  if (PsndThreaded)
+    return PsndMtYmWrite(addr, d);
   return YM2612Write_(a, d);
 }
 
@@ -1173,7 +1184,7 @@ static void z80_md_vdp_br_write(unsigned int a, unsigned char data)
   if ((a&0xfff9) == 0x7f11) // 7f11 7f13 7f15 7f17
   {
     if (PicoOpt & POPT_EN_PSG)
-      SN76496Write(data);
+      psg_write(data);
     return;
   }
 
@@ -1197,6 +1208,13 @@ static void z80_md_bank_write(unsigned int a, unsigned char data)
 
   elprintf(EL_Z80BNK, "z80->68k w8 [%06x] %02x", addr68k, data);
   m68k_write8(addr68k, data);
+#ifdef DRC_M68K
+  {
+    uptr v = m68k_write8_map[addr68k >> M68K_MEM_SHIFT];
+    if (!map_flag_set(v))
+      fm68k_drc_wcheck((u8 *)(v << 1) + addr68k, 1);
+  }
+#endif
 }
 
 // -----------------------------------------------------------------
@@ -1238,4 +1256,9 @@ static void z80_mem_setup(void)
 #endif
 }
 
+const struct pico_ctx_area ctx_areas_memory[] = {
+  PICO_CTX_AREA(port_readers),
+  PICO_CTX_AREA_END
+};
+
 // vim:shiftwidth=2:ts=2:expandtab
@@ -30,6 +30,16 @@ extern u32 m68k_read8(u32 a);
 extern u32 m68k_read16(u32 a);
 extern void m68k_write8(u32 a, u8 d);
 extern void m68k_write16(u32 a, u16 d);
+extern u32 m68k_read32(u32 a);
+extern void m68k_write32(u32 a, u32 d);
+
+// sub 68k
+extern u32 s68k_read8(u32 a);
+extern u32 s68k_read16(u32 a);
+extern u32 s68k_read32(u32 a);
+extern void s68k_write8(u32 a, u8 d);
+extern void s68k_write16(u32 a, u16 d);
+extern void s68k_write32(u32 a, u32 d);
 
 // z80
 #define Z80_MEM_SHIFT 13
@@ -280,6 +280,16 @@ static void FinalizeLineRGB555M4(int line)
   FinalizeLine555(0, line);
 }
 
+static void FinalizeLine8888M4(int line)
+{
+  if (Pico.m.dirtyPal) {
+    PicoDoHighPal555M4();
+    PicoDoHighPal8888();
+  }
+
+  FinalizeLine8888(0, line);
+}
+
 static void FinalizeLine8bitM4(int line)
 {
   unsigned char *pd = DrawLineDest;
@@ -296,7 +306,14 @@ void PicoDrawSetOutputMode4(pdso_t which)
   {
     case PDF_8BIT:   FinalizeLineM4 = FinalizeLine8bitM4; break;
     case PDF_RGB555: FinalizeLineM4 = FinalizeLineRGB555M4; break;
+    case PDF_XRGB8888: FinalizeLineM4 = FinalizeLine8888M4; break;
     default:         FinalizeLineM4 = NULL; break;
   }
 }
 
+const struct pico_ctx_area ctx_areas_mode4[] = {
+  PICO_CTX_AREA(FinalizeLineM4),
+  PICO_CTX_AREA(skip_next_line),
+  PICO_CTX_AREA(screen_offset),
+  PICO_CTX_AREA_END
+};
@@ -323,6 +323,7 @@ void PicoPatchApply(void)
 				if (u == i)
 					*(unsigned short *)(Pico.rom + addr) = PicoPatches[i].data_old;
 			}
+			fm68k_drc_wcheck(Pico.rom + addr, 2);
 			// fprintf(stderr, "patched %i: %06x:%04x\n", PicoPatches[i].active, addr,
 			//	*(unsigned short *)(Pico.rom + addr));
 		}
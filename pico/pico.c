@@ -52,19 +52,29 @@ void PicoExit(void)
     PicoExitMCD();
   PicoCartUnload();
   z80_exit();
+  PicoDrawMtStop();
+  PsndMtStop();
+  cdra_stop();
+  PicoRewindFinish();
+  PicoRunAheadFinish();
+  fm68k_drc_finish();
+  cz80_drc_finish();
 
   if (SRam.data)
     free(SRam.data);
+  SRam.data = NULL;
   pevt_dump();
 }
 
 void PicoPower(void)
 {
+  PicoDrawMtFrameEnd();
   Pico.m.frame_count = 0;
   SekCycleCnt = SekCycleAim = 0;
 
   // clear all memory of the emulated machine
   memset(&Pico.ram,0,(unsigned char *)&Pico.rom - Pico.ram);
+  PicoDirtyAll();
 
   memset(&Pico.video,0,sizeof(Pico.video));
   memset(&Pico.m,0,sizeof(Pico.m));
@@ -86,6 +96,8 @@ void PicoPower(void)
   if (PicoOpt & POPT_EN_32X)
     PicoPower32x();
 
+  fm68k_drc_flush_all();
+  cz80_drc_flush_all();
   PicoReset();
 }
 
@@ -151,6 +163,8 @@ int PicoReset(void)
   if (Pico.romsize <= 0)
     return 1;
 
+  PicoDrawMtFrameEnd();
+
 #if defined(CPU_CMP_R) || defined(CPU_CMP_W) || defined(DRC_CMP)
   PicoOpt |= POPT_DIS_VDP_FIFO|POPT_DIS_IDLE_DET;
 #endif
@@ -163,6 +177,7 @@ int PicoReset(void)
   emustatus = 0;
 
   if (PicoAHW & PAHW_SMS) {
+    SekInitIdleProbe((PicoOpt & POPT_DIS_IDLE_DET) ? 0 : IDLE_Z80);
     PicoResetMS();
     return 0;
   }
@@ -190,6 +205,9 @@ int PicoReset(void)
   SekFinishIdleDet();
 
   if (PicoAHW & PAHW_MCD) {
+    // code runs from RAM here, so it can't be patched
+    SekInitIdleProbe((PicoOpt & POPT_DIS_IDLE_DET) ? 0 :
+      IDLE_M68K | IDLE_S68K | IDLE_Z80);
     PicoResetMCD();
     return 0;
   }
@@ -216,6 +234,7 @@ int PicoReset(void)
 // flush config changes before emu loop starts
 void PicoLoopPrepare(void)
 {
+  PicoDrawMtFrameEnd();
   if (PicoRegionOverride)
     // force setting possibly changed..
     Pico.m.pal = (PicoRegionOverride == 2 || PicoRegionOverride == 8) ? 1 : 0;
@@ -300,7 +319,7 @@ PICO_INTERNAL void PicoSyncZ80(unsigned int m68k_cycles_done)
     z80_cycle_aim, z80_cycle_aim / 288);
 
   if (cnt > 0)
-    z80_cycle_cnt += z80_run(cnt);
+    z80_cycle_cnt += z80_run_idle(cnt);
 
   pprof_end(z80);
 }
@@ -330,9 +349,12 @@ void PicoFrame(void)
   //if(Pico.video.reg[12]&0x2) Pico.video.status ^= 0x10; // change odd bit in interlace mode
 
   PicoFrameStart();
+  PsndMtFrameStart();
   PicoFrameHints();
 
 end:
+  PicoDrawMtFrameDone();
+  PsndMtFrameEnd();
   pprof_end(frame);
 }
 
@@ -341,6 +363,7 @@ void PicoFrameDrawOnly(void)
   if (!(PicoAHW & PAHW_SMS)) {
     PicoFrameStart();
     PicoDrawSync(223, 0);
+    PicoDrawMtFrameEnd();
   } else {
     PicoFrameDrawOnlyMS();
   }
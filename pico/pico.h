@@ -52,7 +52,7 @@ extern void *p32x_bios_g, *p32x_bios_m, *p32x_bios_s;
 #define POPT_EN_Z80         (1<< 2)
 #define POPT_EN_STEREO      (1<< 3)
 #define POPT_ALT_RENDERER   (1<< 4) // 00 00x0
-// unused                   (1<< 5)
+#define POPT_EN_FRAME_REUSE (1<< 5) // don't draw frames that match the last one
 // unused                   (1<< 6)
 #define POPT_ACC_SPRITES    (1<< 7)
 #define POPT_DIS_32C_BORDER (1<< 8) // 00 0x00
@@ -69,6 +69,12 @@ extern void *p32x_bios_g, *p32x_bios_m, *p32x_bios_s;
 #define POPT_DIS_IDLE_DET   (1<<19)
 #define POPT_EN_32X         (1<<20)
 #define POPT_EN_PWM         (1<<21)
+#define POPT_EN_DRAW_THREAD (1<<23) // line renderer on own thread
+#define POPT_EN_SND_THREAD  (1<<24) // fm/psg synthesis on own thread
+#define POPT_EN_SND_NATIVE  (1<<25) // synthesize at the fm chip rate, resample to PsndRate
+#define POPT_EN_CD_READAHEAD (1<<26) // cd image reads through a prefetch thread
+#define POPT_EN_DRC_CACHE   (1<<27) // 32X: keep the list of translated sh2 blocks on disk
+#define POPT_EN_DRC_M68K    (1<<28) // 68k on its recompiler too (with POPT_EN_DRC)
 extern int PicoOpt; // bitfield
 
 #define PAHW_MCD  (1<<0)
@@ -82,6 +88,7 @@ extern int PicoAHW;            // Pico active hw
 extern int PicoQuirks;
 
 extern int PicoSkipFrame;      // skip rendering frame, but still do sound (if enabled) and emulation stuff
+extern int PicoFrameUnchanged; // POPT_EN_FRAME_REUSE: last frame wasn't drawn, out buffer already had it
 extern int PicoRegionOverride; // override the region detection 0: auto, 1: Japan NTSC, 2: Japan PAL, 4: US, 8: Europe
 extern int PicoAutoRgnOrder;   // packed priority list of regions, for example 0x148 means this detection order: EUR, USA, JAP
 extern int PicoSVPCycles;
@@ -99,6 +106,24 @@ typedef enum { PI_ROM, PI_ISPAL, PI_IS40_CELL, PI_IS240_LINES } pint_t;
 typedef union { int vint; void *vptr; } pint_ret_t;
 void PicoGetInternal(pint_t which, pint_ret_t *ret);
 
+// context.c
+// Independent emulator instances. Create all of them before PicoInit(),
+// then call the usual API (PicoInit, PicoCartInsert, ..) between
+// PicoContextEnter() and PicoContextLeave(), or use the PicoCtx* wrappers.
+// Contexts are time sliced, not parallel: they may be used from different
+// threads, but only one runs at a time and a switch copies the machine
+// state. PicoContextDestroy() does PicoExit() in the context, so don't
+// call it from inside one.
+typedef struct PicoContext PicoContext;
+PicoContext *PicoContextCreate(void);
+void PicoContextDestroy(PicoContext *ctx);
+void PicoContextEnter(PicoContext *ctx);
+void PicoContextLeave(PicoContext *ctx);
+void PicoCtxFrame(PicoContext *ctx);
+int  PicoCtxState(PicoContext *ctx, const char *fname, int is_save);
+void PicoCtxPower(PicoContext *ctx);
+int  PicoCtxReset(PicoContext *ctx);
+
 // cd/mcd.c
 extern void (*PicoMCDopenTray)(void);
 extern void (*PicoMCDcloseTray)(void);
@@ -126,6 +151,22 @@ int PicoStateLoadGfx(const char *fname);
 void *PicoTmpStateSave(void);
 void  PicoTmpStateRestore(void *data);
 extern void (*PicoStateProgressCB)(const char *str);
+// fixed layout in memory, size depends on the loaded media only
+size_t PicoStateSize(void);
+int    PicoStateSaveMem(void *buf, size_t size);
+int    PicoStateLoadMem(const void *buf, size_t size);
+
+// rewind.c
+// budget: bytes for the delta history, a snapshot every interval frames
+int  PicoRewindInit(unsigned int budget, int interval);
+void PicoRewindFinish(void);
+void PicoRewindClear(void);
+void PicoRewindCapture(void); // call after each PicoFrame
+int  PicoRewindStep(void);    // 0 if a state was loaded
+
+// runahead.c
+// like PicoFrame, but presents the frame that is frames ahead
+void PicoFrameRunAhead(int frames);
 
 // cd/cdd.c
 int cdd_load(const char *filename, int type);
@@ -136,7 +177,8 @@ typedef enum
 {
 	PMT_UNCOMPRESSED = 0,
 	PMT_ZIP,
-	PMT_CSO
+	PMT_CSO,
+	PMT_HCD
 } pm_type;
 typedef struct
 {
@@ -145,6 +187,8 @@ typedef struct
 	unsigned int size;	/* size */
 	pm_type type;
 	char ext[4];
+	int ra;			/* reads go through cd read-ahead */
+	unsigned int ra_pos;	/* stream position then */
 } pm_file;
 pm_file *pm_open(const char *path);
 size_t   pm_read(void *ptr, size_t bytes, pm_file *stream);
@@ -153,7 +197,9 @@ int      pm_close(pm_file *fp);
 int PicoCartLoad(pm_file *f,unsigned char **prom,unsigned int *psize,int is_sms);
 int PicoCartInsert(unsigned char *rom, unsigned int romsize, const char *carthw_cfg);
 void PicoCartUnload(void);
+void PicoCartLoadFree(unsigned char *rom); // PicoCartLoad result, not inserted
 extern void (*PicoCartLoadProgressCB)(int percent);
+extern const char *PicoCartCacheDir; // share loaded ROMs through files here
 extern void (*PicoCDLoadProgressCB)(const char *fname, int percent);
 extern int PicoGameLoaded;
 
@@ -165,9 +211,16 @@ typedef enum
 	PDF_NONE = 0,    // no conversion
 	PDF_RGB555,      // RGB/BGR output, depends on compile options
 	PDF_8BIT,        // 8-bit out (handles shadow/hilight mode, sonic water)
+	PDF_XRGB8888,    // 32-bit out, also handles s/h, no 32x line mode
 } pdso_t;
 void PicoDrawSetOutFormat(pdso_t which, int use_32x_line_mode);
 void PicoDrawSetOutBuf(void *dest, int increment);
+// a second buffer of the same layout: threaded frames (POPT_EN_DRAW_THREAD)
+// then alternate between the two and PicoFrame doesn't wait for the draw
+// thread. PicoDrawLastFrame() is the newest complete frame, so the frame
+// just emulated shows up a frame late.
+void PicoDrawSetOutBuf2(void *dest2);
+void *PicoDrawLastFrame(void);
 void PicoDrawSetCallbacks(int (*begin)(unsigned int num), int (*end)(unsigned int num));
 extern void *DrawLineDest;
 extern unsigned char *HighCol;
@@ -176,6 +229,8 @@ extern unsigned char *HighCol;
 void vidConvCpyRGB565(void *to, void *from, int pixels);
 #endif
 void PicoDoHighPal555(int sh);
+void PicoDoHighPal8888(void);
+extern unsigned int HighPal32[0x100];
 extern int PicoDrawMask;
 #define PDRAW_LAYERB_ON      (1<<2)
 #define PDRAW_LAYERA_ON      (1<<3)
@@ -210,10 +265,12 @@ extern void (*PicoPrepareCram)();    // prepares PicoCramHigh for renderer to us
 #ifndef NO_32X
 
 void Pico32xSetClocks(int msh2_hz, int ssh2_hz);
+void Pico32xSetCacheDir(const char *dir); // POPT_EN_DRC_CACHE files go here, with trailing slash
 
 #else
 
 #define Pico32xSetClocks(msh2_khz, ssh2_khz)
+#define Pico32xSetCacheDir(dir)
 
 #endif
 
@@ -227,6 +284,13 @@ extern int PsndRate,PsndLen;
 extern short *PsndOut;
 extern void (*PsndMix_32_to_16l)(short *dest, int *src, int count);
 void PsndRerate(int preserve_state);
+// POPT_EN_SND_NATIVE: the sample count per frame varies a bit, PsndOut
+// needs room for PsndRate / fps + PSND_OUT_SLACK samples. Frontends
+// can speed up or slow down the output by up to PSND_ADJ_MAX ppm,
+// to match it to the display rate the emulation is locked to.
+#define PSND_OUT_SLACK 8
+#define PSND_ADJ_MAX   5000
+void PsndRateAdjust(int ppm);
 
 // media.c
 enum media_type_e {
@@ -102,3 +102,9 @@ PICO_INTERNAL void PicoInitPico(void)
   }
 }
 
+const struct pico_ctx_area ctx_areas_pico[] = {
+  PICO_CTX_AREA(prev_line_cnt_irq3),
+  PICO_CTX_AREA(prev_line_cnt_irq5),
+  PICO_CTX_AREA(fifo_bytes_line),
+  PICO_CTX_AREA_END
+};
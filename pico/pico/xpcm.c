@@ -118,3 +118,10 @@ end:
   quant = 0x7f;
 }
 
+const struct pico_ctx_area ctx_areas_xpcm[] = {
+  PICO_CTX_AREA(sample),
+  PICO_CTX_AREA(quant),
+  PICO_CTX_AREA(sgn),
+  PICO_CTX_AREA(stepsamples),
+  PICO_CTX_AREA_END
+};
@@ -30,6 +30,12 @@ static void SekSyncM68k(void)
   pevt_log_m68k_o(EVT_RUN_START);
 
   while ((cyc_do = SekCycleAim - SekCycleCnt) > 0) {
+    if (SekIdleSkip(0, cyc_do)) {
+      SekCycleCnt = SekCycleAim;
+      break;
+    }
+    if ((cyc_do = SekCycleAim - SekCycleCnt) <= 0)
+      break;
     SekCycleCnt += cyc_do;
 
 #if defined(EMU_C68K)
@@ -39,7 +45,7 @@ static void SekSyncM68k(void)
 #elif defined(EMU_M68K)
     SekCycleCnt += m68k_execute(cyc_do) - cyc_do;
 #elif defined(EMU_F68K)
-    SekCycleCnt += fm68k_emulate(cyc_do, 0) - cyc_do;
+    SekCycleCnt += fm68k_run(cyc_do) - cyc_do;
 #endif
   }
 
@@ -114,6 +120,11 @@ static int PicoFrameHints(void)
 
     PAD_DELAY();
 
+    // finished lines can go to the draw thread now, display
+    // enabled means any later change would sync them anyway
+    if (PicoDrawThreaded && y > 0 && y < 224 && !skip && (pv->reg[1]&0x40))
+      PicoDrawSync(y - 1, 0);
+
     // H-Interrupts:
     if (--hint < 0) // y <= lines_vis: Comix Zone, Golden Axe
     {
@@ -168,7 +179,7 @@ static int PicoFrameHints(void)
 
   if (!skip)
   {
-    if (DrawScanline < y)
+    if (PicoDrawThreaded || DrawScanline < y)
       PicoDrawSync(y - 1, 0);
 #ifdef DRAW_FINISH_FUNC
     DRAW_FINISH_FUNC();
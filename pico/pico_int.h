@@ -88,6 +88,18 @@ extern M68K_CONTEXT PicoCpuFM68k, PicoCpuFS68k;
 #define SekInterrupt(irq) PicoCpuFM68k.interrupts[0]=irq
 #define SekIrqLevel       PicoCpuFM68k.interrupts[0]
 
+// run current context, on the recompiler if enabled. It's opt-in, it
+// doesn't beat FAME yet
+#ifdef DRC_M68K
+#define fm68k_drc_on() \
+	((PicoOpt & (POPT_EN_DRC|POPT_EN_DRC_M68K)) == (POPT_EN_DRC|POPT_EN_DRC_M68K))
+#define fm68k_run(cyc) \
+	(fm68k_drc_on() ? fm68k_drc_emulate(cyc) : \
+	 (fm68k_drc_unhook(), fm68k_emulate(cyc, 0)))
+#else
+#define fm68k_run(cyc) fm68k_emulate(cyc, 0)
+#endif
+
 #endif
 
 #ifdef EMU_M68K
@@ -128,6 +140,9 @@ extern m68ki_cpu_core PicoCpuMM68k, PicoCpuMS68k;
 #endif
 #endif // EMU_M68K
 
+// 68k recompiler, these are no-ops without it
+#include "../cpu/fame/compiler.h"
+
 // while running, cnt represents target of current timeslice
 // while not in SekRun(), it's actual cycles done
 // (but always use SekCyclesDone() if you need current position)
@@ -189,9 +204,15 @@ extern struct DrZ80 drZ80;
 
 #elif defined(_USE_CZ80)
 #include "../cpu/cz80/cz80.h"
+#include "../cpu/cz80/compiler.h"
 
+#ifdef DRC_Z80
+#define z80_run(cycles)    ((PicoOpt & POPT_EN_DRC) ? cz80_drc_exec(cycles) : Cz80_Exec(&CZ80, cycles))
+#define z80_run_nr(cycles) z80_run(cycles)
+#else
 #define z80_run(cycles)    Cz80_Exec(&CZ80, cycles)
 #define z80_run_nr(cycles) Cz80_Exec(&CZ80, cycles)
+#endif
 #define z80_int()          Cz80_Set_IRQ(&CZ80, 0, HOLD_LINE)
 #define z80_nmi()          Cz80_Set_IRQ(&CZ80, IRQ_LINE_NMI, 0)
 
@@ -570,22 +591,71 @@ extern void Byteswap(void *dst, const void *src, int len);
 extern void (*PicoCartMemSetup)(void);
 extern void (*PicoCartUnloadHook)(void);
 
+// context.c
+struct pico_ctx_area {
+  void *ptr;
+  size_t size;
+};
+#define PICO_CTX_AREA(v) { &(v), sizeof(v) }
+#define PICO_CTX_AREA_END { NULL, 0 }
+extern const struct pico_ctx_area ctx_areas_sound[], ctx_areas_ym2612[],
+  ctx_areas_sn76496[], ctx_areas_draw[], ctx_areas_draw2[], ctx_areas_mode4[],
+  ctx_areas_memory[], ctx_areas_sek[], ctx_areas_sms[], ctx_areas_eeprom[],
+  ctx_areas_cart[], ctx_areas_carthw[], ctx_areas_svp[], ctx_areas_ssp16[],
+  ctx_areas_mcd[], ctx_areas_cdc[], ctx_areas_gfx[], ctx_areas_pcm[], ctx_areas_pico[],
+  ctx_areas_xpcm[], ctx_areas_32x[], ctx_areas_32x_memory[], ctx_areas_pwm[],
+  ctx_areas_sh2soc[], ctx_areas_rewind[], ctx_areas_runahead[],
+  ctx_areas_fm68k_drc[], ctx_areas_cz80_drc[], ctx_areas_drc_cmn[],
+  ctx_areas_sh2_drc[], ctx_areas_svp_drc[];
+void PicoContextDrcClaim(void);
+
 // debug.c
 int CM_compareRun(int cyc, int is_sub);
 
 // draw.c
 PICO_INTERNAL void PicoFrameStart(void);
 void PicoDrawSync(int to, int blank_last_line);
+void PicoDrawLines(int to, int blank_last_line);
 void BackFill(int reg7, int sh);
 void FinalizeLine555(int sh, int line);
+void FinalizeLine8888(int sh, int line);
+extern int PicoDisplayDirty;
 extern int (*PicoScanBegin)(unsigned int num);
 extern int (*PicoScanEnd)(unsigned int num);
 extern int DrawScanline;
 #define MAX_LINE_SPRITES 29
 extern unsigned char HighLnSpr[240][3 + MAX_LINE_SPRITES];
 extern void *DrawLineDestBase;
+extern void *DrawLineDestBase2;
 extern int DrawLineDestIncrement;
 
+// draw_mt.c
+// write log entry types, the memory ones match PicoVideo.type
+#define DMT_VRAM  1
+#define DMT_CRAM  3
+#define DMT_VSRAM 5
+#define DMT_REG   8
+#if !defined(NO_THREADS) && !defined(_ASM_DRAW_C) && (defined(__unix__) || defined(__APPLE__))
+#define DRAW_THREADS 1
+extern int PicoDrawThreaded;
+extern struct Pico *PicoDrawSrc;
+void PicoDrawMtFrameStart(void);
+void PicoDrawMtFrameEnd(void);
+void PicoDrawMtFrameDone(void);
+void PicoDrawMtSync(int to, int blank_last_line);
+void PicoDrawMtWrite(int type, unsigned int a, unsigned int d);
+void PicoDrawMtBlock(int type, unsigned int a, unsigned int bytes, int rs_flags);
+void PicoDrawMtStop(void);
+#else
+#define PicoDrawThreaded 0
+#define PicoDrawSrc (&Pico)
+#define PicoDrawMtFrameEnd()
+#define PicoDrawMtFrameDone()
+#define PicoDrawMtWrite(type, a, d)
+#define PicoDrawMtBlock(type, a, bytes, rs_flags)
+#define PicoDrawMtStop()
+#endif
+
 // draw2.c
 PICO_INTERNAL void PicoFrameFull();
 
@@ -630,6 +700,24 @@ void cdd_process(void);
 // cd/cd_image.c
 int load_cd_image(const char *cd_img_name, int *type);
 
+// cd/readahead.c
+#if !defined(NO_THREADS) && (defined(__unix__) || defined(__APPLE__))
+#define CD_READAHEAD 1
+void   cdra_attach(pm_file *f);
+void   cdra_detach(pm_file *f);
+size_t cdra_read(void *ptr, size_t bytes, pm_file *f);
+int    cdra_seek(pm_file *f, long offset, int whence);
+void   cdra_stop(void);
+#else
+#define cdra_attach(f)
+#define cdra_detach(f)
+#define cdra_stop()
+#endif
+
+// cart.c
+size_t pm_read_direct(void *ptr, size_t bytes, pm_file *stream);
+int    pm_seek_direct(pm_file *stream, long offset, int whence);
+
 // cd/gfx.c
 void gfx_init(void);
 void gfx_start(unsigned int base);
@@ -716,6 +804,13 @@ PICO_INTERNAL void SekUnpackCpu(const unsigned char *cpu, int is_sub);
 void SekStepM68k(void);
 void SekInitIdleDet(void);
 void SekFinishIdleDet(void);
+void SekInitIdleProbe(int cpus);
+int  SekIsIdleReady(void);
+int  SekIdleSkip(int is_sub, int cycles);
+extern int idleprobe_cpus;
+#define IDLE_M68K 1
+#define IDLE_S68K 2
+#define IDLE_Z80  4
 #if defined(CPU_CMP_R) || defined(CPU_CMP_W)
 void SekTrace(int is_s68k);
 #else
@@ -784,6 +879,7 @@ PICO_INTERNAL void z80_pack(void *data);
 PICO_INTERNAL int  z80_unpack(const void *data);
 PICO_INTERNAL void z80_reset(void);
 PICO_INTERNAL void z80_exit(void);
+PICO_INTERNAL int  z80_run_idle(int cycles);
 
 // cd/misc.c
 PICO_INTERNAL_ASM void wram_2M_to_1M(unsigned char *m);
@@ -796,6 +892,43 @@ PICO_INTERNAL void PsndClear(void);
 PICO_INTERNAL void PsndGetSamples(int y);
 PICO_INTERNAL void PsndGetSamplesMS(void);
 extern int PsndDacLine;
+extern int PsndNativeRate; // synthesis rate with POPT_EN_SND_NATIVE, else 0
+#if !defined(NO_THREADS) && (defined(__unix__) || defined(__APPLE__))
+#define SOUND_THREADS 1
+extern int PsndThreaded;
+void PsndMtFrameStart(void);
+void PsndMtFrameEnd(void);
+int  PsndMtYmWrite(int addr, int d);
+void PsndMtPsgWrite(int d);
+void PsndMtStop(void);
+#else
+#define PsndThreaded 0
+#define PsndMtFrameStart()
+#define PsndMtFrameEnd()
+#define PsndMtYmWrite(addr, d) 0
+#define PsndMtPsgWrite(d)
+#define PsndMtStop()
+#endif
+
+// runahead.c
+// pages written since the last run-ahead snapshot
+#define DIRTY_PAGE_SHIFT 10
+struct PicoDirtyPages {
+  unsigned char vram[0x10000 >> DIRTY_PAGE_SHIFT];
+  unsigned char dram[0x40000 >> DIRTY_PAGE_SHIFT]; // both 32x framebuffers
+};
+extern struct PicoDirtyPages PicoDirtyPages;
+#define PicoDirtyVram(a) \
+  PicoDirtyPages.vram[((a) & 0xffff) >> DIRTY_PAGE_SHIFT] = 1
+#define PicoDirtyDram(n, a) \
+  PicoDirtyPages.dram[((n) << (17 - DIRTY_PAGE_SHIFT)) + (((a) & 0x1ffff) >> DIRTY_PAGE_SHIFT)] = 1
+void PicoDirtyVramRange(unsigned int a, unsigned int bytes);
+void PicoDirtyAll(void);
+void PicoRunAheadFinish(void);
+
+// state.c
+int  PicoStateSnapSave(void *buf, size_t size);
+void PicoStateSnapLoad(const void *buf);
 
 // sms.c
 #ifndef NO_SMS
@@ -865,6 +998,7 @@ enum {
   PDM32X_OFF,
   PDM32X_32X_ONLY,
   PDM32X_BOTH,
+  PDM32X_32X_ONLY_8888,
 };
 extern int Pico32xDrawMode;
 
@@ -0,0 +1,345 @@
+/*
+ * PicoDrive
+ * (C) agent, 2026
+ *
+ * This work is licensed under the terms of MAME license.
+ * See COPYING file in the top-level directory.
+ *
+ * Rewind history.
+ * Every N frames the mem state is copied over the last snapshot (cur),
+ * while the xor of old and new words is run length encoded into a ring
+ * of fixed size, so the ring holds backward deltas. Stepping back loads
+ * cur and then xors the newest delta into it. The oldest deltas are
+ * dropped when the ring fills up.
+ */
+
+#include "pico_int.h"
+
+#define RW_MAX_ENTRIES 0x4000
+#define RW_RUN_MAX     0xffff
+
+// delta format, in words: hdr = zero_words | lit_words << 16, lit_words of data
+struct rw_entry {
+  unsigned int start;     // in ring words
+  unsigned int len;
+  unsigned int prev_size; // of the state this delta leads back to, bytes
+};
+
+static struct {
+  unsigned int *ring;
+  unsigned int ring_size; // words
+  unsigned int wpos;      // next ring word to write
+  unsigned int used;      // words in complete entries + the one being made
+  struct rw_entry *ent;
+  unsigned int ent_first, ent_count;
+  unsigned int interval, frames;
+  // last snapshot
+  unsigned int *cur;
+  unsigned int cur_size;  // bytes
+  unsigned int cur_alloc; // words
+  unsigned char *tmp;     // new mem state
+  unsigned int tmp_size;
+  int have_cur;
+  int at_cur;             // emu state is the one in cur
+  // serializer / encoder state
+  unsigned int pos;       // bytes in
+  unsigned char acc[4];
+  int encode;
+  int overflow;           // ring too small for this delta
+  int failed;
+  unsigned int zrun, lit_n, lit_hdr;
+  int lit_open;
+} rw;
+
+static void drop_oldest(void)
+{
+  rw.used -= rw.ent[rw.ent_first].len;
+  rw.ent_first = (rw.ent_first + 1) % RW_MAX_ENTRIES;
+  rw.ent_count--;
+}
+
+static void drop_all(void)
+{
+  rw.ent_first = rw.ent_count = 0;
+  rw.wpos = rw.used = 0;
+}
+
+static void emit(unsigned int w)
+{
+  if (rw.used >= rw.ring_size) {
+    if (rw.ent_count == 0) {
+      rw.overflow = 1;
+      return;
+    }
+    drop_oldest();
+  }
+  rw.ring[rw.wpos] = w;
+  if (++rw.wpos == rw.ring_size)
+    rw.wpos = 0;
+  rw.used++;
+}
+
+static void lit_close(void)
+{
+  rw.ring[rw.lit_hdr] |= rw.lit_n << 16;
+  rw.lit_open = 0;
+}
+
+static void put_word(unsigned int w)
+{
+  unsigned int i = rw.pos >> 2, x;
+
+  if (i >= rw.cur_alloc) {
+    unsigned int n = rw.cur_alloc ? rw.cur_alloc * 2 : 0x10000;
+    void *tmp = realloc(rw.cur, n * 4);
+    if (tmp == NULL) {
+      rw.failed = 1;
+      return;
+    }
+    rw.cur = tmp;
+    memset(rw.cur + rw.cur_alloc, 0, (n - rw.cur_alloc) * 4);
+    rw.cur_alloc = n;
+  }
+
+  if (rw.failed)
+    return;
+  x = rw.cur[i] ^ w;
+  rw.cur[i] = w;
+  if (!rw.encode || rw.overflow)
+    return;
+
+  if (x == 0) {
+    if (rw.lit_open)
+      lit_close();
+    if (++rw.zrun == RW_RUN_MAX) {
+      emit(rw.zrun);
+      rw.zrun = 0;
+    }
+    return;
+  }
+
+  if (!rw.lit_open) {
+    rw.lit_hdr = rw.wpos;
+    emit(rw.zrun);
+    rw.zrun = rw.lit_n = 0;
+    rw.lit_open = 1;
+  }
+  emit(x);
+  if (++rw.lit_n == RW_RUN_MAX)
+    lit_close();
+}
+
+static size_t rw_write(void *p, size_t _size, size_t _n, void *file)
+{
+  const unsigned char *b = p;
+  size_t n = _size * _n, left = n;
+  unsigned int w;
+
+  while (left > 0 && (rw.pos & 3)) {
+    rw.acc[rw.pos++ & 3] = *b++, left--;
+    if (!(rw.pos & 3)) {
+      rw.pos -= 4;
+      memcpy(&w, rw.acc, 4);
+      put_word(w);
+      rw.pos += 4;
+    }
+  }
+  while (left >= 4) {
+    // most of the state doesn't change, skip that in blocks
+    if (left >= 64 && rw.encode && !rw.lit_open && rw.zrun + 16 < RW_RUN_MAX
+        && rw.pos + 64 <= rw.cur_alloc * 4
+        && memcmp((char *)rw.cur + rw.pos, b, 64) == 0)
+    {
+      rw.zrun += 16;
+      rw.pos += 64, b += 64, left -= 64;
+      continue;
+    }
+    memcpy(&w, b, 4);
+    put_word(w);
+    rw.pos += 4, b += 4, left -= 4;
+  }
+  while (left > 0)
+    rw.acc[rw.pos++ & 3] = *b++, left--;
+
+  return n;
+}
+
+static void snapshot(void)
+{
+  unsigned int w, size = PicoStateSize();
+  unsigned int start = rw.wpos, prev_size = rw.cur_size;
+  struct rw_entry *e;
+  void *tmp;
+  int ret;
+
+  if (size > rw.tmp_size) {
+    tmp = realloc(rw.tmp, size);
+    if (tmp == NULL) {
+      PicoRewindClear();
+      return;
+    }
+    rw.tmp = tmp;
+    rw.tmp_size = size;
+  }
+
+  rw.pos = 0;
+  rw.encode = rw.have_cur;
+  rw.overflow = rw.failed = 0;
+  rw.zrun = rw.lit_open = 0;
+
+  ret = PicoStateSaveMem(rw.tmp, size);
+  if (ret == 0)
+    rw_write(rw.tmp, 1, size, NULL);
+
+  // flush the partial word, zero padded
+  if (rw.pos & 3) {
+    memset(rw.acc + (rw.pos & 3), 0, 4 - (rw.pos & 3));
+    rw.pos &= ~3;
+    memcpy(&w, rw.acc, 4);
+    put_word(w);
+    rw.pos += 4;
+  }
+  // old snapshot was longer, its tail goes to the delta too
+  for (; rw.pos < prev_size; rw.pos += 4)
+    put_word(0);
+  if (rw.lit_open)
+    lit_close();
+
+  if (ret != 0 || rw.failed) {
+    PicoRewindClear();
+    return;
+  }
+  rw.cur_size = size;
+  if (rw.overflow) {
+    // history no longer leads to cur
+    drop_all();
+    rw.have_cur = rw.at_cur = 1;
+    return;
+  }
+
+  if (rw.encode) {
+    if (rw.ent_count == RW_MAX_ENTRIES)
+      drop_oldest();
+    e = &rw.ent[(rw.ent_first + rw.ent_count) % RW_MAX_ENTRIES];
+    e->start = start;
+    e->len = rw.wpos >= start ? rw.wpos - start : rw.wpos + rw.ring_size - start;
+    e->prev_size = prev_size;
+    rw.ent_count++;
+  }
+  rw.have_cur = rw.at_cur = 1;
+}
+
+static unsigned int ring_next(unsigned int *k)
+{
+  unsigned int w = rw.ring[*k];
+  if (++*k == rw.ring_size)
+    *k = 0;
+  return w;
+}
+
+// cur = previous snapshot
+static void pop_newest(void)
+{
+  struct rw_entry *e = &rw.ent[(rw.ent_first + rw.ent_count - 1) % RW_MAX_ENTRIES];
+  unsigned int i = 0, k = e->start, left = e->len, n, h;
+
+  while (left > 0) {
+    h = ring_next(&k);
+    i += h & 0xffff;
+    n = h >> 16;
+    left -= n + 1;
+    for (; n > 0; n--, i++)
+      rw.cur[i] ^= ring_next(&k);
+  }
+
+  rw.cur_size = e->prev_size;
+  rw.wpos = e->start;
+  rw.used -= e->len;
+  rw.ent_count--;
+}
+
+// budget is the delta ring size in bytes, the last full snapshot is
+// kept in addition to it; a snapshot is taken every interval frames
+int PicoRewindInit(unsigned int budget, int interval)
+{
+  PicoRewindFinish();
+  if (budget < 0x1000)
+    return -1;
+
+  rw.ring_size = budget / 4;
+  rw.ring = malloc(rw.ring_size * 4);
+  rw.ent = malloc(RW_MAX_ENTRIES * sizeof(rw.ent[0]));
+  if (rw.ring == NULL || rw.ent == NULL) {
+    elprintf(EL_STATUS, "OOM for rewind");
+    PicoRewindFinish();
+    return -1;
+  }
+  rw.interval = interval > 0 ? interval : 1;
+  PicoRewindClear();
+  return 0;
+}
+
+void PicoRewindFinish(void)
+{
+  free(rw.ring);
+  free(rw.ent);
+  free(rw.cur);
+  free(rw.tmp);
+  memset(&rw, 0, sizeof(rw));
+}
+
+void PicoRewindClear(void)
+{
+  drop_all();
+  rw.have_cur = rw.at_cur = 0;
+  rw.cur_size = 0;
+  if (rw.cur != NULL)
+    memset(rw.cur, 0, rw.cur_alloc * 4);
+  rw.frames = 0;
+}
+
+// to be called after every frame
+void PicoRewindCapture(void)
+{
+  if (rw.ring == NULL)
+    return;
+
+  rw.at_cur = 0;
+  if (++rw.frames < rw.interval)
+    return;
+  rw.frames = 0;
+
+  pprof_start(rewind);
+  snapshot();
+  pprof_end(rewind);
+}
+
+// go back to the last snapshot, or to the one before it if the emu
+// is already there; returns -1 if there is no history
+int PicoRewindStep(void)
+{
+  int ret;
+
+  if (!rw.have_cur)
+    return -1;
+
+  if (rw.at_cur) {
+    if (rw.ent_count == 0)
+      return -1;
+    pop_newest();
+  }
+
+  pprof_start(rewind);
+  ret = PicoStateLoadMem(rw.cur, rw.cur_size);
+  pprof_end(rewind);
+  rw.at_cur = 1;
+  rw.frames = 0;
+  return ret;
+}
+
+const struct pico_ctx_area ctx_areas_rewind[] = {
+  PICO_CTX_AREA(rw),
+  PICO_CTX_AREA_END
+};
+
+// vim:shiftwidth=2:ts=2:expandtab
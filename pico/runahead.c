@@ -0,0 +1,105 @@
+/*
+ * PicoDrive
+ * (C) agent, 2026
+ *
+ * This work is licensed under the terms of MAME license.
+ * See COPYING file in the top-level directory.
+ *
+ * Run-ahead.
+ * The real frame is emulated without drawing and a snapshot is taken,
+ * then more frames are run without sound, drawing only the last one,
+ * and the snapshot is restored. The snapshot is a mem state kept from
+ * frame to frame, so only the vram/dram pages written since the last
+ * snapshot or restore need copying (see PicoStateSnapSave).
+ */
+
+#include "pico_int.h"
+
+struct PicoDirtyPages PicoDirtyPages;
+
+static struct {
+  unsigned char *snap;
+  size_t size;
+} ra;
+
+void PicoDirtyVramRange(unsigned int a, unsigned int bytes)
+{
+  unsigned int i, end = a + bytes;
+
+  if (bytes >= 0x10000) {
+    memset(PicoDirtyPages.vram, 1, sizeof(PicoDirtyPages.vram));
+    return;
+  }
+  for (i = a & ~((1 << DIRTY_PAGE_SHIFT) - 1); i < end; i += 1 << DIRTY_PAGE_SHIFT)
+    PicoDirtyVram(i);
+}
+
+// memory was changed by something else than the emulated hw
+void PicoDirtyAll(void)
+{
+  memset(&PicoDirtyPages, 1, sizeof(PicoDirtyPages));
+  PicoDisplayDirty = 1;
+}
+
+void PicoRunAheadFinish(void)
+{
+  free(ra.snap);
+  ra.snap = NULL;
+  ra.size = 0;
+}
+
+void PicoFrameRunAhead(int frames)
+{
+  short *out = PsndOut;
+  int skip = PicoSkipFrame;
+  size_t size;
+  void *tmp;
+  int i;
+
+  if (frames <= 0) {
+    PicoFrame();
+    return;
+  }
+
+  size = PicoStateSize();
+  if (size != ra.size) {
+    tmp = realloc(ra.snap, size);
+    if (size == 0 || tmp == NULL) {
+      PicoFrame();
+      return;
+    }
+    // new layout, every page has to be copied once
+    ra.snap = tmp;
+    ra.size = size;
+    memset(ra.snap, 0, size);
+    PicoDirtyAll();
+  }
+
+  // the real frame, sound only
+  PicoSkipFrame = skip ? skip : 1;
+  PicoFrame();
+
+  if (PicoStateSnapSave(ra.snap, ra.size) != 0) {
+    PicoSkipFrame = skip;
+    return;
+  }
+
+  PsndOut = NULL;
+  for (i = 0; i < frames; i++) {
+    if (i == frames - 1)
+      PicoSkipFrame = skip;
+    PicoFrame();
+  }
+  PsndOut = out;
+  PicoSkipFrame = skip;
+
+  PicoStateSnapLoad(ra.snap);
+}
+
+const struct pico_ctx_area ctx_areas_runahead[] = {
+  PICO_CTX_AREA(ra),
+  PICO_CTX_AREA(PicoDirtyPages),
+  PICO_CTX_AREA_END
+};
+
+// vim:shiftwidth=2:ts=2:expandtab
@@ -135,6 +135,7 @@ PICO_INTERNAL void SekInit(void)
     PicoCpuFM68k.sr = 0x2704; // Z flag
     g_m68kcontext = oldcontext;
   }
+  fm68k_drc_init();
 #endif
 }
 
@@ -279,6 +280,9 @@ static unsigned short **idledet_ptrs = NULL;
 static int idledet_count = 0, idledet_bads = 0;
 static int idledet_start_frame = 0;
 
+// cpus that get probed for idle loops (IDLE_*), instead of core patching
+int idleprobe_cpus;
+
 #if 0
 #define IDLE_STATS 1
 unsigned int idlehit_addrs[128], idlehit_counts[128];
@@ -300,7 +304,7 @@ void SekRegisterIdleHit(unsigned int pc)
 
 void SekInitIdleDet(void)
 {
-  unsigned short **tmp = realloc(idledet_ptrs, 0x200*4);
+  unsigned short **tmp = realloc(idledet_ptrs, 0x200 * sizeof(*idledet_ptrs));
   if (tmp == NULL) {
     free(idledet_ptrs);
     idledet_ptrs = NULL;
@@ -318,6 +322,13 @@ void SekInitIdleDet(void)
 #endif
 #ifdef EMU_F68K
   fm68k_emulate(0, 1);
+  fm68k_drc_idle_det(1);
+#endif
+
+#if defined(EMU_C68K) || defined(EMU_F68K)
+  SekInitIdleProbe(IDLE_Z80);
+#else
+  SekInitIdleProbe(IDLE_M68K | IDLE_Z80);
 #endif
 }
 
@@ -398,8 +409,8 @@ int SekRegisterIdlePatch(unsigned int pc, int oldop, int newop, void *ctx)
     (newop&0x200)?'n':'y', is_main68k?'m':'s', idledet_count);
 
   // XXX: probably shouldn't patch RAM too
-  v = m68k_read16_map[pc >> M68K_MEM_SHIFT];
-  if (!(v & 0x80000000))
+  v = (is_main68k ? m68k_read16_map : s68k_read16_map)[pc >> M68K_MEM_SHIFT];
+  if (!map_flag_set(v))
     target = (u16 *)((v << 1) + pc);
   else {
     if (++idledet_bads > 128)
@@ -408,7 +419,8 @@ int SekRegisterIdlePatch(unsigned int pc, int oldop, int newop, void *ctx)
   }
 
   if (idledet_count >= 0x200 && (idledet_count & 0x1ff) == 0) {
-    unsigned short **tmp = realloc(idledet_ptrs, (idledet_count+0x200)*4);
+    unsigned short **tmp = realloc(idledet_ptrs,
+      (idledet_count + 0x200) * sizeof(*idledet_ptrs));
     if (tmp == NULL)
       return 1;
     idledet_ptrs = tmp;
@@ -421,11 +433,13 @@ int SekRegisterIdlePatch(unsigned int pc, int oldop, int newop, void *ctx)
 
 void SekFinishIdleDet(void)
 {
+  idleprobe_cpus = 0;
 #ifdef EMU_C68K
   CycloneFinishIdle();
 #endif
 #ifdef EMU_F68K
   fm68k_emulate(0, 2);
+  fm68k_drc_idle_det(2);
 #endif
   while (idledet_count > 0)
   {
@@ -441,6 +455,143 @@ void SekFinishIdleDet(void)
   }
 }
 
+/*
+ * Portable idle loop skipping, for cores that can't patch their code
+ * and for CD mode, where code runs from RAM. At run start the pc is
+ * checked for a loop SekIsIdleCode() accepts. If it's in one, short
+ * probe runs are done: if the loop went around and no register
+ * changed, it's waiting on something that can only change in a later
+ * run (irq, other cpu, next line), so the rest of this run is dropped.
+ */
+#define IDLE_PROBE_CYCLES 48
+
+static struct idle_probe {
+  u32 loop;
+  int have_regs;
+  u32 regs[16];
+} idleprobe[2];
+
+void SekInitIdleProbe(int cpus)
+{
+  idleprobe_cpus = cpus;
+  idledet_start_frame = Pico.m.frame_count + 360;
+  memset(idleprobe, 0, sizeof(idleprobe));
+}
+
+// returns loop start + 1 if pc is in a busy-wait loop, else 0
+static u32 SekIdleLoop(int is_sub)
+{
+  const uptr *map = is_sub ? s68k_read16_map : m68k_read16_map;
+  u32 pc = (is_sub ? SekPcS68k : SekPc) & 0xfffffe;
+  int i, bytes;
+  u16 *p;
+  uptr v;
+
+  // keep the loop within one bank
+  if ((pc & M68K_BANK_MASK) < 14 || (pc & M68K_BANK_MASK) > M68K_BANK_MASK - 14)
+    return 0;
+  v = map[pc >> M68K_MEM_SHIFT];
+  if (map_flag_set(v))
+    return 0;
+  p = (u16 *)((v << 1) + pc);
+
+  // bne.s, beq.s or bra.s at pc or after it, going back to pc or before
+  for (i = 0; i <= 12; i += 2) {
+    u16 op = p[i / 2];
+    if ((op & 0xfe00) != 0x6600 && (op & 0xff00) != 0x6000)
+      continue;
+    bytes = -(signed char)op - 2;
+    if (bytes < i || bytes > 12 || (bytes & 1))
+      continue;
+    if (bytes == 0 ? (op & 0xff00) == 0x6000 : SekIsIdleCode(p + (i - bytes) / 2, bytes))
+      return pc + i - bytes + 1;
+  }
+  return 0;
+}
+
+static void SekIdleRegs(int is_sub, u32 *regs)
+{
+  int i;
+  for (i = 0; i < 16; i++)
+    regs[i] = is_sub ? SekDarS68k(i) : SekDar(i);
+}
+
+// run a cpu for a few cycles like the run loops do,
+// returns 1 if an irq is left pending
+static int SekIdleRun(int is_sub, int cyc_do)
+{
+  unsigned int *cnt = is_sub ? &SekCycleCntS68k : &SekCycleCnt;
+  int irq;
+
+  *cnt += cyc_do;
+#if defined(EMU_C68K)
+  struct Cyclone *cpu = is_sub ? &PicoCpuCS68k : &PicoCpuCM68k;
+  cpu->cycles = cyc_do;
+  CycloneRun(cpu);
+  *cnt -= cpu->cycles;
+  irq = cpu->irq > (cpu->srh & 7);
+#elif defined(EMU_M68K)
+  if (is_sub)
+    m68k_set_context(&PicoCpuMS68k);
+  *cnt += m68k_execute(cyc_do) - cyc_do;
+  irq = SekShouldInterrupt();
+  if (is_sub)
+    m68k_set_context(&PicoCpuMM68k);
+#elif defined(EMU_F68K)
+  if (is_sub)
+    g_m68kcontext = &PicoCpuFS68k;
+  *cnt += fm68k_run(cyc_do) - cyc_do;
+  irq = SekShouldInterrupt();
+  if (is_sub)
+    g_m68kcontext = &PicoCpuFM68k;
+#endif
+  if (!is_sub)
+    SekCyclesLeft = 0;
+  return irq;
+}
+
+// call at the start of a run of 'cycles'. May do probe runs itself,
+// so the caller must recalculate what's left if 0 is returned.
+// Returns 1 if the rest of the run can be skipped.
+int SekIdleSkip(int is_sub, int cycles)
+{
+  struct idle_probe *ip = &idleprobe[is_sub];
+  u32 loop, regs[16];
+
+  if (!(idleprobe_cpus & (is_sub ? IDLE_S68K : IDLE_M68K))
+      || cycles < IDLE_PROBE_CYCLES * 3 || !SekIsIdleReady())
+    return 0;
+
+  loop = SekIdleLoop(is_sub);
+  if (loop != ip->loop) {
+    ip->loop = loop;
+    ip->have_regs = 0;
+  }
+  if (loop == 0)
+    return 0;
+
+  // the first time around the loop loads what it polls
+  if (!ip->have_regs) {
+    SekIdleRun(is_sub, IDLE_PROBE_CYCLES);
+    if (SekIdleLoop(is_sub) != loop)
+      return 0;
+    SekIdleRegs(is_sub, ip->regs);
+    ip->have_regs = 1;
+  }
+
+  if (SekIdleRun(is_sub, IDLE_PROBE_CYCLES) || SekIdleLoop(is_sub) != loop)
+    return 0;
+  SekIdleRegs(is_sub, regs);
+  if (memcmp(regs, ip->regs, sizeof(regs)) != 0) {
+    // a counter or such, compare against this next time
+    memcpy(ip->regs, regs, sizeof(ip->regs));
+    return 0;
+  }
+
+  elprintf(EL_IDLE, "idle: %c skip @%06x, %d", is_sub ? 's' : 'm', loop - 1, cycles);
+  return 1;
+}
+
 
 #if defined(CPU_CMP_R) || defined(CPU_CMP_W)
 #include "debug.h"
@@ -586,4 +737,14 @@ void instruction_hook(void)
 }
 #endif
 
+const struct pico_ctx_area ctx_areas_sek[] = {
+  PICO_CTX_AREA(idledet_ptrs),
+  PICO_CTX_AREA(idledet_count),
+  PICO_CTX_AREA(idledet_bads),
+  PICO_CTX_AREA(idledet_start_frame),
+  PICO_CTX_AREA(idleprobe),
+  PICO_CTX_AREA(idleprobe_cpus),
+  PICO_CTX_AREA_END
+};
+
 // vim:shiftwidth=2:ts=2:expandtab
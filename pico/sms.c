@@ -48,6 +48,7 @@ static void vdp_data_write(unsigned char d)
     Pico.m.dirtyPal = 1;
   } else {
     Pico.vramb[pv->addr] = d;
+    PicoDirtyVram(pv->addr);
   }
   pv->addr = (pv->addr + 1) & 0x3fff;
 
@@ -179,8 +180,10 @@ static void write_bank(unsigned short a, unsigned char d)
 static void xwrite(unsigned int a, unsigned char d)
 {
   elprintf(EL_IO, "z80 write [%04x] %02x", a, d);
-  if (a >= 0xc000)
+  if (a >= 0xc000) {
     Pico.zram[a & 0x1fff] = d;
+    cz80_drc_wcheck8(&Pico.zram[a & 0x1fff]);
+  }
   if (a >= 0xfff8)
     write_bank(a, d);
 }
@@ -196,6 +199,8 @@ void PicoPowerMS(void)
   int s, tmp;
 
   memset(&Pico.ram,0,(unsigned char *)&Pico.rom - Pico.ram);
+  PicoDirtyAll();
+  cz80_drc_flush_all();
   memset(&Pico.video,0,sizeof(Pico.video));
   memset(&Pico.m,0,sizeof(Pico.m));
   Pico.m.pal = 0;
@@ -296,7 +301,9 @@ void PicoFrameMS(void)
     }
 
     cycles_aim += cycles_line;
-    cycles_done += z80_run((cycles_aim - cycles_done) >> 8) << 8;
+    pprof_start(z80);
+    cycles_done += z80_run_idle((cycles_aim - cycles_done) >> 8) << 8;
+    pprof_end(z80);
   }
 
   if (PsndOut)
@@ -314,3 +321,7 @@ void PicoFrameDrawOnlyMS(void)
     PicoLineMode4(y);
 }
 
+const struct pico_ctx_area ctx_areas_sms[] = {
+  PICO_CTX_AREA(bank_mask),
+  PICO_CTX_AREA_END
+};
@@ -6,6 +6,9 @@
  * See COPYING file in the top-level directory.
  */
 
+#include <stddef.h>
+#include "mix.h"
+
 #define MAXOUT		(+32767)
 #define MINOUT		(-32768)
 
@@ -15,6 +18,18 @@
 	else if ( val < min ) val = min; \
 }
 
+#ifndef _ASM_MIX_C
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_X86_MIX
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HAVE_NEON_MIX
+#endif
+#endif
+
+#ifndef _ASM_MIX_C
+
 
 void mix_32_to_16l_stereo(short *dest, int *src, int count)
 {
@@ -77,3 +92,362 @@ void mix_16h_to_32_s2(int *dest_buf, short *mp3_buf, int count)
 	}
 }
 
+#endif /* _ASM_MIX_C */
+
+/* stepped (nearest sample) stereo accumulation, as used by the
+ * PWM and CD PCM resamplers; p is the 16.16 fraction to start at */
+static void mix_16_to_32_step_c(int *dest, short *src, int count, int step, unsigned int p)
+{
+	for (; count > 0; count--)
+	{
+		*dest++ += src[0];
+		*dest++ += src[1];
+		p += step;
+		src += (p >> 16) * 2;
+		p &= 0xffff;
+	}
+}
+
+static void mix_32_to_32_step_c(int *dest, int *src, int count, int step, unsigned int p)
+{
+	for (; count > 0; count--)
+	{
+		*dest++ += src[0];
+		*dest++ += src[1];
+		p += step;
+		src += (p >> 16) * 2;
+		p &= 0xffff;
+	}
+}
+
+static void mix_16_to_32(int *dest, short *src, int count)
+{
+	while (count--)
+		*dest++ += *src++;
+}
+
+static void mix_32_to_32(int *dest, int *src, int count)
+{
+	while (count--)
+		*dest++ += *src++;
+}
+
+#ifdef HAVE_X86_MIX
+
+/* dest = sat16(dest + src), elementwise */
+__attribute__((target("sse2")))
+static void mix_32_to_16_sse2(short *dest, int *src, int count)
+{
+	for (; count >= 8; count -= 8, dest += 8, src += 8)
+	{
+		__m128i d = _mm_loadu_si128((__m128i *)dest);
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(d, d), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(d, d), 16);
+		lo = _mm_add_epi32(lo, _mm_loadu_si128((__m128i *)src));
+		hi = _mm_add_epi32(hi, _mm_loadu_si128((__m128i *)(src + 4)));
+		_mm_storeu_si128((__m128i *)dest, _mm_packs_epi32(lo, hi));
+	}
+	mix_32_to_16_mono(dest, src, count);
+}
+
+__attribute__((target("avx2")))
+static void mix_32_to_16_avx2(short *dest, int *src, int count)
+{
+	for (; count >= 16; count -= 16, dest += 16, src += 16)
+	{
+		__m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i *)dest));
+		__m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i *)(dest + 8)));
+		lo = _mm256_add_epi32(lo, _mm256_loadu_si256((__m256i *)src));
+		hi = _mm256_add_epi32(hi, _mm256_loadu_si256((__m256i *)(src + 8)));
+		// packs works in 128bit lanes, put the quads back in order
+		lo = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8);
+		_mm256_storeu_si256((__m256i *)dest, lo);
+	}
+	mix_32_to_16_sse2(dest, src, count);
+}
+
+/* like the C version, only the left dest sample is mixed to both channels */
+__attribute__((target("sse2")))
+static void mix_32_to_16l_stereo_sse2(short *dest, int *src, int count)
+{
+	for (; count >= 4; count -= 4, dest += 8, src += 8)
+	{
+		__m128i d = _mm_loadu_si128((__m128i *)dest);
+		__m128i l = _mm_srai_epi32(_mm_slli_epi32(d, 16), 16);
+		__m128i lo = _mm_add_epi32(_mm_unpacklo_epi32(l, l), _mm_loadu_si128((__m128i *)src));
+		__m128i hi = _mm_add_epi32(_mm_unpackhi_epi32(l, l), _mm_loadu_si128((__m128i *)(src + 4)));
+		_mm_storeu_si128((__m128i *)dest, _mm_packs_epi32(lo, hi));
+	}
+	mix_32_to_16l_stereo(dest, src, count);
+}
+
+__attribute__((target("avx2")))
+static void mix_32_to_16l_stereo_avx2(short *dest, int *src, int count)
+{
+	for (; count >= 8; count -= 8, dest += 16, src += 16)
+	{
+		__m256i d = _mm256_loadu_si256((__m256i *)dest);
+		__m256i l = _mm256_srai_epi32(_mm256_slli_epi32(d, 16), 16);
+		__m256i a = _mm256_unpacklo_epi32(l, l); // 0 1 | 4 5
+		__m256i b = _mm256_unpackhi_epi32(l, l); // 2 3 | 6 7
+		__m256i lo = _mm256_permute2x128_si256(a, b, 0x20);
+		__m256i hi = _mm256_permute2x128_si256(a, b, 0x31);
+		lo = _mm256_add_epi32(lo, _mm256_loadu_si256((__m256i *)src));
+		hi = _mm256_add_epi32(hi, _mm256_loadu_si256((__m256i *)(src + 8)));
+		lo = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8);
+		_mm256_storeu_si256((__m256i *)dest, lo);
+	}
+	mix_32_to_16l_stereo_sse2(dest, src, count);
+}
+
+/* dest += src >> 1 for 4 stereo pairs in v */
+__attribute__((target("sse2")))
+static inline void mix_16h_pairs_sse2(int *dest, __m128i v)
+{
+	__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 17);
+	__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 17);
+	_mm_storeu_si128((__m128i *)dest, _mm_add_epi32(_mm_loadu_si128((__m128i *)dest), lo));
+	_mm_storeu_si128((__m128i *)(dest + 4), _mm_add_epi32(_mm_loadu_si128((__m128i *)(dest + 4)), hi));
+}
+
+__attribute__((target("sse2")))
+static void mix_16h_to_32_sse2(int *dest, short *src, int count)
+{
+	for (; count >= 8; count -= 8, dest += 8, src += 8)
+		mix_16h_pairs_sse2(dest, _mm_loadu_si128((__m128i *)src));
+	mix_16h_to_32(dest, src, count);
+}
+
+// the vector loads cover a bit more than the pairs used,
+// so always leave the last pair for the C loop
+__attribute__((target("sse2")))
+static void mix_16h_to_32_s1_sse2(int *dest, short *src, int count)
+{
+	for (; count > 8; count -= 8, dest += 8, src += 16)
+	{
+		__m128i a = _mm_shuffle_epi32(_mm_loadu_si128((__m128i *)src), 0xd8);
+		__m128i b = _mm_shuffle_epi32(_mm_loadu_si128((__m128i *)(src + 8)), 0xd8);
+		mix_16h_pairs_sse2(dest, _mm_unpacklo_epi64(a, b));
+	}
+	mix_16h_to_32_s1(dest, src, count);
+}
+
+__attribute__((target("sse2")))
+static void mix_16h_to_32_s2_sse2(int *dest, short *src, int count)
+{
+	for (; count > 8; count -= 8, dest += 8, src += 32)
+	{
+		__m128i a = _mm_unpacklo_epi32(_mm_loadu_si128((__m128i *)src),
+			_mm_loadu_si128((__m128i *)(src + 8)));
+		__m128i b = _mm_unpacklo_epi32(_mm_loadu_si128((__m128i *)(src + 16)),
+			_mm_loadu_si128((__m128i *)(src + 24)));
+		mix_16h_pairs_sse2(dest, _mm_unpacklo_epi64(a, b));
+	}
+	mix_16h_to_32_s2(dest, src, count);
+}
+
+__attribute__((target("sse2")))
+static void mix_16_to_32_sse2(int *dest, short *src, int count)
+{
+	for (; count >= 8; count -= 8, dest += 8, src += 8)
+	{
+		__m128i v = _mm_loadu_si128((__m128i *)src);
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		_mm_storeu_si128((__m128i *)dest, _mm_add_epi32(_mm_loadu_si128((__m128i *)dest), lo));
+		_mm_storeu_si128((__m128i *)(dest + 4), _mm_add_epi32(_mm_loadu_si128((__m128i *)(dest + 4)), hi));
+	}
+	mix_16_to_32(dest, src, count);
+}
+
+__attribute__((target("sse2")))
+static void mix_32_to_32_sse2(int *dest, int *src, int count)
+{
+	for (; count >= 4; count -= 4, dest += 4, src += 4)
+		_mm_storeu_si128((__m128i *)dest, _mm_add_epi32(
+			_mm_loadu_si128((__m128i *)dest), _mm_loadu_si128((__m128i *)src)));
+	mix_32_to_32(dest, src, count);
+}
+
+/* sample n is taken from pair (n*step)>>16, so the positions of
+ * a group of outputs can be computed at once and gathered */
+__attribute__((target("avx2")))
+static void mix_16_to_32_step_avx2(int *dest, short *src, int count, int step)
+{
+	__m256i pos = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+				_mm256_set1_epi32(step));
+	__m256i inc = _mm256_set1_epi32(step * 8);
+	unsigned int p;
+	int i;
+
+	for (i = 0; i + 8 <= count; i += 8, dest += 16)
+	{
+		__m256i v = _mm256_i32gather_epi32((const int *)src, _mm256_srli_epi32(pos, 16), 4);
+		__m256i l = _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+		__m256i r = _mm256_srai_epi32(v, 16);
+		__m256i a = _mm256_unpacklo_epi32(l, r); // 0 1 | 4 5
+		__m256i b = _mm256_unpackhi_epi32(l, r); // 2 3 | 6 7
+		__m256i o0 = _mm256_permute2x128_si256(a, b, 0x20);
+		__m256i o1 = _mm256_permute2x128_si256(a, b, 0x31);
+		_mm256_storeu_si256((__m256i *)dest, _mm256_add_epi32(_mm256_loadu_si256((__m256i *)dest), o0));
+		_mm256_storeu_si256((__m256i *)(dest + 8), _mm256_add_epi32(_mm256_loadu_si256((__m256i *)(dest + 8)), o1));
+		pos = _mm256_add_epi32(pos, inc);
+	}
+	p = (unsigned int)i * step;
+	mix_16_to_32_step_c(dest, src + (p >> 16) * 2, count - i, step, p & 0xffff);
+}
+
+__attribute__((target("avx2")))
+static void mix_32_to_32_step_avx2(int *dest, int *src, int count, int step)
+{
+	__m128i pos = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(step));
+	__m128i inc = _mm_set1_epi32(step * 4);
+	unsigned int p;
+	int i;
+
+	for (i = 0; i + 4 <= count; i += 4, dest += 8)
+	{
+		__m256i v = _mm256_i32gather_epi64((const long long *)src, _mm_srli_epi32(pos, 16), 8);
+		_mm256_storeu_si256((__m256i *)dest, _mm256_add_epi32(_mm256_loadu_si256((__m256i *)dest), v));
+		pos = _mm_add_epi32(pos, inc);
+	}
+	p = (unsigned int)i * step;
+	mix_32_to_32_step_c(dest, src + (p >> 16) * 2, count - i, step, p & 0xffff);
+}
+
+#elif defined(HAVE_NEON_MIX)
+
+static void mix_32_to_16_neon(short *dest, int *src, int count)
+{
+	for (; count >= 8; count -= 8, dest += 8, src += 8)
+	{
+		int16x8_t d = vld1q_s16(dest);
+		int32x4_t lo = vaddw_s16(vld1q_s32(src), vget_low_s16(d));
+		int32x4_t hi = vaddw_s16(vld1q_s32(src + 4), vget_high_s16(d));
+		vst1q_s16(dest, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+	}
+	mix_32_to_16_mono(dest, src, count);
+}
+
+/* like the C version, only the left dest sample is mixed to both channels */
+static void mix_32_to_16l_stereo_neon(short *dest, int *src, int count)
+{
+	for (; count >= 8; count -= 8, dest += 16, src += 16)
+	{
+		int16x8x2_t d = vld2q_s16(dest);
+		int32x4x2_t s0 = vld2q_s32(src), s1 = vld2q_s32(src + 8);
+		int16x4_t l0 = vget_low_s16(d.val[0]), l1 = vget_high_s16(d.val[0]);
+		d.val[0] = vcombine_s16(vqmovn_s32(vaddw_s16(s0.val[0], l0)), vqmovn_s32(vaddw_s16(s1.val[0], l1)));
+		d.val[1] = vcombine_s16(vqmovn_s32(vaddw_s16(s0.val[1], l0)), vqmovn_s32(vaddw_s16(s1.val[1], l1)));
+		vst2q_s16(dest, d);
+	}
+	mix_32_to_16l_stereo(dest, src, count);
+}
+
+static inline void mix_16h_pairs_neon(int *dest, int16x8_t v)
+{
+	v = vshrq_n_s16(v, 1);
+	vst1q_s32(dest, vaddw_s16(vld1q_s32(dest), vget_low_s16(v)));
+	vst1q_s32(dest + 4, vaddw_s16(vld1q_s32(dest + 4), vget_high_s16(v)));
+}
+
+static void mix_16h_to_32_neon(int *dest, short *src, int count)
+{
+	for (; count >= 8; count -= 8, dest += 8, src += 8)
+		mix_16h_pairs_neon(dest, vld1q_s16(src));
+	mix_16h_to_32(dest, src, count);
+}
+
+// see the sse2 versions about the last pair
+static void mix_16h_to_32_s1_neon(int *dest, short *src, int count)
+{
+	for (; count > 8; count -= 8, dest += 8, src += 16)
+		mix_16h_pairs_neon(dest, vreinterpretq_s16_u32(vld2q_u32((uint32_t *)src).val[0]));
+	mix_16h_to_32_s1(dest, src, count);
+}
+
+static void mix_16h_to_32_s2_neon(int *dest, short *src, int count)
+{
+	for (; count > 8; count -= 8, dest += 8, src += 32)
+		mix_16h_pairs_neon(dest, vreinterpretq_s16_u32(vld4q_u32((uint32_t *)src).val[0]));
+	mix_16h_to_32_s2(dest, src, count);
+}
+
+static void mix_16_to_32_neon(int *dest, short *src, int count)
+{
+	for (; count >= 8; count -= 8, dest += 8, src += 8)
+	{
+		int16x8_t v = vld1q_s16(src);
+		vst1q_s32(dest, vaddw_s16(vld1q_s32(dest), vget_low_s16(v)));
+		vst1q_s32(dest + 4, vaddw_s16(vld1q_s32(dest + 4), vget_high_s16(v)));
+	}
+	mix_16_to_32(dest, src, count);
+}
+
+static void mix_32_to_32_neon(int *dest, int *src, int count)
+{
+	for (; count >= 4; count -= 4, dest += 4, src += 4)
+		vst1q_s32(dest, vaddq_s32(vld1q_s32(dest), vld1q_s32(src)));
+	mix_32_to_32(dest, src, count);
+}
+
+#endif
+
+void (*mix_32_to_16l_stereo_v)(short *dest, int *src, int count) = mix_32_to_16l_stereo;
+void (*mix_32_to_16_mono_v)(short *dest, int *src, int count) = mix_32_to_16_mono;
+void (*mix_16h_to_32_v)(int *dest, short *src, int count) = mix_16h_to_32;
+void (*mix_16h_to_32_s1_v)(int *dest, short *src, int count) = mix_16h_to_32_s1;
+void (*mix_16h_to_32_s2_v)(int *dest, short *src, int count) = mix_16h_to_32_s2;
+static void (*mix_16_to_32_v)(int *dest, short *src, int count) = mix_16_to_32;
+static void (*mix_32_to_32_v)(int *dest, int *src, int count) = mix_32_to_32;
+static void (*mix_16_to_32_step_v)(int *dest, short *src, int count, int step);
+static void (*mix_32_to_32_step_v)(int *dest, int *src, int count, int step);
+
+void mix_16_to_32_step(int *dest, short *src, int count, int step)
+{
+	if (step == 0x10000)
+		mix_16_to_32_v(dest, src, count * 2);
+	else if (mix_16_to_32_step_v != NULL)
+		mix_16_to_32_step_v(dest, src, count, step);
+	else
+		mix_16_to_32_step_c(dest, src, count, step, 0);
+}
+
+void mix_32_to_32_step(int *dest, int *src, int count, int step)
+{
+	if (step == 0x10000)
+		mix_32_to_32_v(dest, src, count * 2);
+	else if (mix_32_to_32_step_v != NULL)
+		mix_32_to_32_step_v(dest, src, count, step);
+	else
+		mix_32_to_32_step_c(dest, src, count, step, 0);
+}
+
+void mix_init(void)
+{
+#ifdef HAVE_X86_MIX
+	if (__builtin_cpu_supports("sse2")) {
+		mix_32_to_16l_stereo_v = mix_32_to_16l_stereo_sse2;
+		mix_32_to_16_mono_v = mix_32_to_16_sse2;
+		mix_16h_to_32_v = mix_16h_to_32_sse2;
+		mix_16h_to_32_s1_v = mix_16h_to_32_s1_sse2;
+		mix_16h_to_32_s2_v = mix_16h_to_32_s2_sse2;
+		mix_16_to_32_v = mix_16_to_32_sse2;
+		mix_32_to_32_v = mix_32_to_32_sse2;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		mix_32_to_16l_stereo_v = mix_32_to_16l_stereo_avx2;
+		mix_32_to_16_mono_v = mix_32_to_16_avx2;
+		mix_16_to_32_step_v = mix_16_to_32_step_avx2;
+		mix_32_to_32_step_v = mix_32_to_32_step_avx2;
+	}
+#elif defined(HAVE_NEON_MIX)
+	mix_32_to_16l_stereo_v = mix_32_to_16l_stereo_neon;
+	mix_32_to_16_mono_v = mix_32_to_16_neon;
+	mix_16h_to_32_v = mix_16h_to_32_neon;
+	mix_16h_to_32_s1_v = mix_16h_to_32_s1_neon;
+	mix_16h_to_32_s2_v = mix_16h_to_32_s2_neon;
+	mix_16_to_32_v = mix_16_to_32_neon;
+	mix_32_to_32_v = mix_32_to_32_neon;
+#endif
+}
@@ -8,3 +8,15 @@ void mix_32_to_16_mono(short *dest, int *src, int count);
 
 extern int mix_32_to_16l_level;
 void mix_32_to_16l_stereo_lvl(short *dest, int *src, int count);
+
+// stereo pairs from src, stepping by 16.16 step per output pair
+void mix_16_to_32_step(int *dest, short *src, int count, int step);
+void mix_32_to_32_step(int *dest, int *src, int count, int step);
+
+// fastest versions for this cpu, set by mix_init()
+extern void (*mix_32_to_16l_stereo_v)(short *dest, int *src, int count);
+extern void (*mix_32_to_16_mono_v)(short *dest, int *src, int count);
+extern void (*mix_16h_to_32_v)(int *dest, short *src, int count);
+extern void (*mix_16h_to_32_s1_v)(int *dest, short *src, int count);
+extern void (*mix_16h_to_32_s2_v)(int *dest, short *src, int count);
+void mix_init(void);
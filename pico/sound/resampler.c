@@ -0,0 +1,166 @@
+/*
+ * polyphase band-limited resampler
+ * (C) agent, 2026
+ *
+ * This work is licensed under the terms of MAME license.
+ * See COPYING file in the top-level directory.
+ *
+ * Windowed sinc FIR with RSMP_PHASES sub-sample positions. Input is
+ * appended to a fifo, outputs are made while the fifo has enough
+ * frames for a full filter window. The cutoff follows the lower of
+ * the two rates, so downsampling doesn't alias.
+ */
+
+#include <string.h>
+#include <math.h>
+#include "resampler.h"
+
+#define COEF_BITS 14
+
+static void make_coefs(struct rsmp *r)
+{
+  double fc = r->out_rate < r->in_rate ? (double)r->out_rate / r->in_rate : 1.0;
+  double h[RSMP_TAPS], x, w, sum;
+  int p, t;
+
+  fc *= 0.92; // leave some room for the transition band
+
+  for (p = 0; p < RSMP_PHASES; p++) {
+    sum = 0;
+    for (t = 0; t < RSMP_TAPS; t++) {
+      x = t - (RSMP_TAPS / 2 - 1) - (double)p / RSMP_PHASES;
+      // blackman over the whole window
+      w = (x + RSMP_TAPS / 2) / RSMP_TAPS;
+      w = 0.42 - 0.5 * cos(2 * M_PI * w) + 0.08 * cos(4 * M_PI * w);
+      h[t] = x == 0 ? fc : sin(M_PI * fc * x) / (M_PI * x);
+      h[t] *= w;
+      sum += h[t];
+    }
+    for (t = 0; t < RSMP_TAPS; t++)
+      r->coef[p][t] = (short)floor(h[t] / sum * (1 << COEF_BITS) + 0.5);
+  }
+}
+
+void rsmp_set_step(struct rsmp *r, int in_len, int out_len)
+{
+  if (out_len > 0)
+    r->step = ((unsigned long long)in_len << 32) / out_len;
+}
+
+void rsmp_reset(struct rsmp *r)
+{
+  // a window of silence, so that output can start right away
+  r->pos = 0;
+  r->len = RSMP_TAPS;
+  memset(r->fifo, 0, sizeof(r->fifo));
+}
+
+void rsmp_init(struct rsmp *r, int in_rate, int out_rate, int stereo)
+{
+  r->in_rate = in_rate;
+  r->out_rate = out_rate;
+  r->stereo = stereo ? 1 : 0;
+  rsmp_set_step(r, in_rate, out_rate);
+  make_coefs(r);
+  rsmp_reset(r);
+}
+
+static int *push_space(struct rsmp *r, int count)
+{
+  int drop = r->len + count - RSMP_FIFO;
+
+  // shouldn't happen, lose the oldest input if it does
+  if (drop > 0) {
+    if (drop > r->len)
+      drop = r->len;
+    memmove(r->fifo, r->fifo + (drop << r->stereo), (r->len - drop) << r->stereo << 2);
+    r->len -= drop;
+    r->pos = r->pos > ((unsigned long long)drop << 32) ? r->pos - ((unsigned long long)drop << 32) : 0;
+  }
+  return r->fifo + (r->len << r->stereo);
+}
+
+void rsmp_push(struct rsmp *r, const int *in, int count)
+{
+  int *d, i, v;
+
+  if (count > RSMP_FIFO)
+    in += (count - RSMP_FIFO) << r->stereo, count = RSMP_FIFO;
+  d = push_space(r, count);
+  // clip, so that the filter can't overflow
+  for (i = 0; i < count << r->stereo; i++) {
+    v = in[i];
+    d[i] = v > 32767 ? 32767 : v < -32768 ? -32768 : v;
+  }
+  r->len += count;
+}
+
+void rsmp_push16(struct rsmp *r, const short *in, int count)
+{
+  int *d, i;
+
+  if (count > RSMP_FIFO)
+    in += (count - RSMP_FIFO) << r->stereo, count = RSMP_FIFO;
+  d = push_space(r, count);
+  for (i = 0; i < count << r->stereo; i++)
+    d[i] = in[i];
+  r->len += count;
+}
+
+int rsmp_need(const struct rsmp *r, int count)
+{
+  long long last;
+
+  if (count <= 0)
+    return 0;
+  last = (long long)((r->pos + (count - 1) * r->step) >> 32);
+  last += RSMP_TAPS - r->len;
+  return last > 0 ? (int)last : 0;
+}
+
+int rsmp_pull(struct rsmp *r, int *out, int count)
+{
+  unsigned long long pos = r->pos;
+  const short *c;
+  const int *s;
+  int i, n, t, l, rr;
+
+  for (n = 0; n < count; n++, pos += r->step)
+  {
+    i = (int)(pos >> 32);
+    if (i + RSMP_TAPS > r->len)
+      break;
+    c = r->coef[(pos >> (32 - 8)) & (RSMP_PHASES - 1)];
+
+    if (r->stereo) {
+      s = r->fifo + i * 2;
+      for (t = l = rr = 0; t < RSMP_TAPS; t++, s += 2) {
+        l  += s[0] * c[t];
+        rr += s[1] * c[t];
+      }
+      *out++ += l >> COEF_BITS;
+      *out++ += rr >> COEF_BITS;
+    }
+    else {
+      s = r->fifo + i;
+      for (t = l = 0; t < RSMP_TAPS; t++)
+        l += s[t] * c[t];
+      *out++ += l >> COEF_BITS;
+    }
+  }
+
+  // drop the input no longer needed
+  i = (int)(pos >> 32);
+  if (i > r->len)
+    i = r->len;
+  if (i > 0) {
+    memmove(r->fifo, r->fifo + (i << r->stereo), (r->len - i) << r->stereo << 2);
+    r->len -= i;
+    pos -= (unsigned long long)i << 32;
+  }
+  r->pos = pos;
+
+  return n;
+}
+
+// vim:shiftwidth=2:ts=2:expandtab
@@ -0,0 +1,33 @@
+/*
+ * polyphase band-limited resampler
+ * (C) agent, 2026
+ *
+ * This work is licensed under the terms of MAME license.
+ * See COPYING file in the top-level directory.
+ */
+
+#define RSMP_TAPS   32
+#define RSMP_PHASES 256
+#define RSMP_FIFO   2560 // in frames
+
+struct rsmp {
+  unsigned long long pos;  // in fifo frames, 32.32
+  unsigned long long step; // input frames per output frame, 32.32
+  int len;                 // frames in fifo
+  int stereo;
+  int in_rate, out_rate;
+  short coef[RSMP_PHASES][RSMP_TAPS];
+  int fifo[RSMP_FIFO * 2];
+};
+
+void rsmp_init(struct rsmp *r, int in_rate, int out_rate, int stereo);
+void rsmp_reset(struct rsmp *r);
+// ratio change without touching the filter, for rate control
+void rsmp_set_step(struct rsmp *r, int in_len, int out_len);
+
+void rsmp_push(struct rsmp *r, const int *in, int count);
+void rsmp_push16(struct rsmp *r, const short *in, int count);
+// input frames still needed for count more outputs
+int  rsmp_need(const struct rsmp *r, int count);
+// adds up to count output frames to out, returns how many were made
+int  rsmp_pull(struct rsmp *r, int *out, int count);
@@ -21,6 +21,7 @@
 #endif
 
 #include "sn76496.h"
+#include "../pico_int.h"
 
 #define MAX_OUTPUT 0x47ff // was 0x7fff
 
@@ -342,3 +343,7 @@ int SN76496_init(int clock,int sample_rate)
 	return 0;
 }
 
+const struct pico_ctx_area ctx_areas_sn76496[] = {
+	PICO_CTX_AREA(ono_sn),
+	PICO_CTX_AREA_END
+};
@@ -13,17 +13,24 @@
 #include "../pico_int.h"
 #include "../cd/cue.h"
 #include "mix.h"
+#include "resampler.h"
 
 #define SIMPLE_WRITE_SOUND 0
 
 void (*PsndMix_32_to_16l)(short *dest, int *src, int count) = mix_32_to_16l_stereo;
 
+// enough for the native fm rate, which is above the usual output rates
+#define SND_BUF_LEN (2*((OSC_PAL/7/144)/50 + 4))
+
 // master int buffer to mix to
-static int PsndBuffer[2*(44100+100)/50];
+static int PsndBuffer[SND_BUF_LEN];
 
 // dac
 static unsigned short dac_info[312+4]; // pppppppp ppppllll, p - pos in buff, l - length to write for this sample
 
+// samples rendered so far this frame
+static int curr_pos;
+
 // cdda output buffer
 short cdda_out_buffer[2*1152];
 
@@ -35,6 +42,22 @@ int PsndLen_exc_cnt=0;
 int PsndDacLine=0;
 short *PsndOut=NULL; // PCM data buffer
 
+// POPT_EN_SND_NATIVE: everything is synthesized at the YM2612 sample
+// rate to snd_native.buf, which goes through rs_out to PsndOut
+int PsndNativeRate;
+static struct {
+  int ppm;
+  int out_max;
+  short buf[SND_BUF_LEN];
+  int out32[2*(48000/50 + PSND_OUT_SLACK)];
+} snd_native;
+static struct rsmp rs_out, rs_cdda;
+
+static short *snd_buf(void)
+{
+  return PsndNativeRate ? snd_native.buf : PsndOut;
+}
+
 // timers
 int timer_a_next_oflow, timer_a_step; // in z80 cycles
 int timer_b_next_oflow, timer_b_step;
@@ -42,6 +65,12 @@ int timer_b_next_oflow, timer_b_step;
 // sn76496
 extern int *sn76496_regs;
 
+#ifdef SOUND_THREADS
+static void smt_dac(int pos, int len, int dout);
+static void smt_render(int offset, int length);
+static void smt_frame_out(int len);
+#endif
+
 
 static void dac_recalculate(void)
 {
@@ -120,6 +149,14 @@ void PsndRerate(int preserve_state)
 {
   void *state = NULL;
   int target_fps = Pico.m.pal ? 50 : 60;
+  int ym_clock = Pico.m.pal ? OSC_PAL/7 : OSC_NTSC/7;
+  int stereo = (PicoOpt & POPT_EN_STEREO) ? 1 : 0;
+  int rate = PsndRate;
+
+  // the fm chip makes a sample every 144 clocks (24 operator slots * 6)
+  PsndNativeRate = 0;
+  if ((PicoOpt & POPT_EN_SND_NATIVE) && !(PicoAHW & PAHW_PICO) && PsndRate > 0)
+    PsndNativeRate = rate = ym_clock / 144;
 
   if (preserve_state) {
     state = malloc(0x204);
@@ -127,7 +164,7 @@ void PsndRerate(int preserve_state)
     ym2612_pack_state();
     memcpy(state, YM2612GetRegs(), 0x204);
   }
-  YM2612Init(Pico.m.pal ? OSC_PAL/7 : OSC_NTSC/7, PsndRate);
+  YM2612Init(ym_clock, rate);
   if (preserve_state) {
     // feed it back it's own registers, just like after loading state
     memcpy(YM2612GetRegs(), state, 0x204);
@@ -135,33 +172,65 @@ void PsndRerate(int preserve_state)
   }
 
   if (preserve_state) memcpy(state, sn76496_regs, 28*4); // remember old state
-  SN76496_init(Pico.m.pal ? OSC_PAL/15 : OSC_NTSC/15, PsndRate);
+  SN76496_init(Pico.m.pal ? OSC_PAL/15 : OSC_NTSC/15, rate);
   if (preserve_state) memcpy(sn76496_regs, state, 28*4); // restore old state
 
   if (state)
     free(state);
 
   // calculate PsndLen
-  PsndLen=PsndRate / target_fps;
-  PsndLen_exc_add=((PsndRate - PsndLen*target_fps)<<16) / target_fps;
+  PsndLen=rate / target_fps;
+  PsndLen_exc_add=((rate - PsndLen*target_fps)<<16) / target_fps;
   PsndLen_exc_cnt=0;
 
+  if (PsndNativeRate) {
+    snd_native.out_max = PsndRate / target_fps + PSND_OUT_SLACK;
+    if (snd_native.out_max > sizeof(snd_native.out32) / 8)
+      snd_native.out_max = sizeof(snd_native.out32) / 8;
+    rsmp_init(&rs_out, rate, PsndRate, stereo);
+    rsmp_init(&rs_cdda, 44100, rate, 1);
+    PsndRateAdjust(snd_native.ppm);
+  }
+
   // recalculate dac info
   dac_recalculate();
 
   // clear all buffers
   memset32(PsndBuffer, 0, sizeof(PsndBuffer)/4);
   memset(cdda_out_buffer, 0, sizeof(cdda_out_buffer));
-  if (PsndOut)
+  if (snd_buf())
     PsndClear();
 
   // set mixer
-  PsndMix_32_to_16l = (PicoOpt & POPT_EN_STEREO) ? mix_32_to_16l_stereo : mix_32_to_16_mono;
+  mix_init();
+  PsndMix_32_to_16l = (PicoOpt & POPT_EN_STEREO) ? mix_32_to_16l_stereo_v : mix_32_to_16_mono_v;
 
   if (PicoAHW & PAHW_PICO)
     PicoReratePico();
 }
 
+// positive ppm gives more samples per frame
+void PsndRateAdjust(int ppm)
+{
+  if (ppm > PSND_ADJ_MAX)  ppm = PSND_ADJ_MAX;
+  if (ppm < -PSND_ADJ_MAX) ppm = -PSND_ADJ_MAX;
+  snd_native.ppm = ppm;
+  if (PsndNativeRate)
+    rsmp_set_step(&rs_out, PsndNativeRate * 1000,
+      PsndRate * 1000 + PsndRate * ppm / 1000);
+}
+
+
+static void dac_fill(short *out, int pos, int len, int dout)
+{
+  if (PicoOpt & POPT_EN_STEREO) {
+    short *d = out + pos*2;
+    for (; len > 0; len--, d+=2) *d = dout;
+  } else {
+    short *d = out + pos;
+    for (; len > 0; len--, d++)  *d = dout;
+  }
+}
 
 PICO_INTERNAL void PsndDoDAC(int line_to)
 {
@@ -177,15 +246,15 @@ PICO_INTERNAL void PsndDoDAC(int line_to)
   pos =dac_info[line_from]>>4;
   pos1=dac_info[line_to];
   len = ((pos1>>4)-pos) + (pos1&0xf);
-  if (!len) return;
+  if (len <= 0) return;
 
-  if (PicoOpt & POPT_EN_STEREO) {
-    short *d = PsndOut + pos*2;
-    for (; len > 0; len--, d+=2) *d = dout;
-  } else {
-    short *d = PsndOut + pos;
-    for (; len > 0; len--, d++)  *d = dout;
+#ifdef SOUND_THREADS
+  if (PsndThreaded) {
+    smt_dac(pos, len, dout);
+    return;
   }
+#endif
+  dac_fill(snd_buf(), pos, len, dout);
 }
 
 // cdda
@@ -207,12 +276,50 @@ static void cdda_raw_update(int *buffer, int length)
 
   // now mix
   switch (mult) {
-    case 1: mix_16h_to_32(buffer, cdda_out_buffer, length*2); break;
-    case 2: mix_16h_to_32_s1(buffer, cdda_out_buffer, length*2); break;
-    case 4: mix_16h_to_32_s2(buffer, cdda_out_buffer, length*2); break;
+    case 1: mix_16h_to_32_v(buffer, cdda_out_buffer, length*2); break;
+    case 2: mix_16h_to_32_s1_v(buffer, cdda_out_buffer, length*2); break;
+    case 4: mix_16h_to_32_s2_v(buffer, cdda_out_buffer, length*2); break;
   }
 }
 
+// native rate: read what rs_cdda needs at 44.1kHz and resample that
+static void cdda_native_update(int *buffer, int length, int stereo)
+{
+  static int in32[2*1152], out32[SND_BUF_LEN];
+  int need, ret, rate, i;
+
+  need = rsmp_need(&rs_cdda, length);
+  if (need > 1152)
+    need = 1152;
+  memset(in32, 0, need * 8);
+
+  if (Pico_mcd->cdda_type == CT_MP3) {
+    // the decoder picks its stride by the output rate
+    rate = PsndRate;
+    PsndRate = 44100;
+    mp3_update(in32, need, 1);
+    PsndRate = rate;
+  }
+  else {
+    ret = pm_read(cdda_out_buffer, need * 4, Pico_mcd->cdda_stream);
+    if (ret < need * 4) {
+      memset((char *)cdda_out_buffer + ret, 0, need * 4 - ret);
+      Pico_mcd->cdda_stream = NULL;
+    }
+    mix_16h_to_32_v(in32, cdda_out_buffer, need * 2);
+  }
+  rsmp_push(&rs_cdda, in32, need);
+
+  if (stereo) {
+    rsmp_pull(&rs_cdda, buffer, length);
+    return;
+  }
+  memset(out32, 0, length * 8);
+  rsmp_pull(&rs_cdda, out32, length);
+  for (i = 0; i < length; i++)
+    buffer[i] += (out32[i*2] + out32[i*2+1]) >> 1;
+}
+
 void cdda_start_play(int lba_base, int lba_offset, int lb_len)
 {
   if (Pico_mcd->cdda_type == CT_MP3)
@@ -240,9 +347,9 @@ PICO_INTERNAL void PsndClear(void)
   int len = PsndLen;
   if (PsndLen_exc_add) len++;
   if (PicoOpt & POPT_EN_STEREO)
-    memset32((int *) PsndOut, 0, len); // assume PsndOut to be aligned
+    memset32((int *) snd_buf(), 0, len); // assume PsndOut to be aligned
   else {
-    short *out = PsndOut;
+    short *out = snd_buf();
     if ((long)out & 2) { *out++ = 0; len--; }
     memset32((int *) out, 0, len/2);
     if (len & 1) out[len-1] = 0;
@@ -250,11 +357,29 @@ PICO_INTERNAL void PsndClear(void)
 }
 
 
+// hand a frame of samples to the frontend
+static void snd_write(int len)
+{
+  int stereo = (PicoOpt & POPT_EN_STEREO) ? 1 : 0;
+
+  if (PsndNativeRate) {
+    rsmp_push16(&rs_out, snd_native.buf, len);
+    memset(snd_native.out32, 0, snd_native.out_max << stereo << 2);
+    len = rsmp_pull(&rs_out, snd_native.out32, snd_native.out_max);
+    // the mixer takes the left channel from dest
+    memset(PsndOut, 0, len << stereo << 1);
+    PsndMix_32_to_16l(PsndOut, snd_native.out32, len);
+  }
+  if (PicoWriteSound)
+    PicoWriteSound(len << stereo << 1);
+}
+
 static int PsndRender(int offset, int length)
 {
   int  buf32_updated = 0;
   int *buf32 = PsndBuffer+offset;
   int stereo = (PicoOpt & 8) >> 3;
+  short *out = snd_buf();
 
   offset <<= stereo;
 
@@ -271,12 +396,19 @@ static int PsndRender(int offset, int length)
   }
 #endif
 
+#ifdef SOUND_THREADS
+  if (PsndThreaded) {
+    smt_render(offset >> stereo, length);
+    return length;
+  }
+#endif
+
   // PSG
   if (PicoOpt & POPT_EN_PSG)
-    SN76496Update(PsndOut+offset, length, stereo);
+    SN76496Update(out+offset, length, stereo);
 
   if (PicoAHW & PAHW_PICO) {
-    PicoPicoPCMUpdate(PsndOut+offset, length, stereo);
+    PicoPicoPCMUpdate(out+offset, length, stereo);
     return length;
   }
 
@@ -302,7 +434,9 @@ static int PsndRender(int offset, int length)
       && !(Pico_mcd->s68k_regs[0x36] & 1))
   {
     // note: only 44, 22 and 11 kHz supported, with forced stereo
-    if (Pico_mcd->cdda_type == CT_MP3)
+    if (PsndNativeRate)
+      cdda_native_update(buf32, length, stereo);
+    else if (Pico_mcd->cdda_type == CT_MP3)
       mp3_update(buf32, length, stereo);
     else
       cdda_raw_update(buf32, length);
@@ -312,7 +446,7 @@ static int PsndRender(int offset, int length)
     p32x_pwm_update(buf32, length, stereo);
 
   // convert + limit to normal 16bit output
-  PsndMix_32_to_16l(PsndOut+offset, buf32, length);
+  PsndMix_32_to_16l(out+offset, buf32, length);
 
   pprof_end(sound);
 
@@ -329,8 +463,6 @@ PICO_INTERNAL void PsndGetSamples(int y)
     PicoWriteSound(PsndLen * ((PicoOpt & POPT_EN_STEREO) ? 4 : 2));
   PsndClear();
 #else
-  static int curr_pos = 0;
-
   if (y == 224)
   {
     if (emustatus & 2)
@@ -339,8 +471,13 @@ PICO_INTERNAL void PsndGetSamples(int y)
     if (emustatus & 1)
          emustatus |=  2;
     else emustatus &= ~2;
-    if (PicoWriteSound)
-      PicoWriteSound(curr_pos * ((PicoOpt & POPT_EN_STEREO) ? 4 : 2));
+#ifdef SOUND_THREADS
+    if (PsndThreaded) {
+      smt_frame_out(curr_pos);
+      return;
+    }
+#endif
+    snd_write(curr_pos);
     // clear sound buffer
     PsndClear();
   }
@@ -368,17 +505,307 @@ PICO_INTERNAL void PsndGetSamplesMS(void)
 
   // PSG
   if (PicoOpt & POPT_EN_PSG)
-    SN76496Update(PsndOut, length, stereo);
+    SN76496Update(snd_buf(), length, stereo);
 
   // upmix to "stereo" if needed
   if (stereo) {
     int i, *p;
-    for (i = length, p = (void *)PsndOut; i > 0; i--, p++)
+    for (i = length, p = (void *)snd_buf(); i > 0; i--, p++)
       *p |= *p << 16;
   }
 
-  if (PicoWriteSound != NULL)
-    PicoWriteSound(length * ((PicoOpt & POPT_EN_STEREO) ? 4 : 2));
+  snd_write(length);
+  PsndClear();
+}
+
+#ifdef SOUND_THREADS
+#include <pthread.h>
+#include <sched.h>
+
+/*
+ * FM/PSG synthesis on a separate thread.
+ * While a frame runs, register writes, DAC output and the render
+ * requests normally served at line_sample/224 are appended to a log,
+ * which the sound thread replays in order, so it produces exactly the
+ * samples the inline path would. The frame's samples are handed to
+ * PicoWriteSound when PicoFrame finishes instead of at line 224, that's
+ * the only point the emu thread waits for it (or when the log is full).
+ */
+
+#define SMT_YM     1 // addr:9 @8, data:8 @20
+#define SMT_PSG    2 // data @8
+#define SMT_DAC    3 // len @8, pos, dout
+#define SMT_RENDER 4 // offset, length, st_mode | dacen << 8
+#define SMT_SWAP   5 // following output is for the next frame
+
+#define SMT_LOG_SIZE 0x10000 // in u32 entries, power of 2
+#define SMT_SPINS    0x4000
+
+#define log_at(i) smt_log[(i) & (SMT_LOG_SIZE - 1)]
+#define log_put(v) log_at(smt.pos++) = (v)
+
+int PsndThreaded;
+
+static unsigned int smt_log[SMT_LOG_SIZE];
+// dac output for the next frame, collected after line 224
+static short smt_next[SND_BUF_LEN];
+
+static struct {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int started;
+  volatile int sleeping;
+  volatile int quit;
+  volatile unsigned int wr; // published log end
+  volatile unsigned int rd; // consumed by sound thread
+  unsigned int pos;         // log end, emu thread only
+  short *out;               // sound thread output
+  int out_len;              // samples to hand over at frame end
+} smt;
+
+static unsigned int smt_replay(unsigned int rd)
+{
+  unsigned int v = log_at(rd);
+  int *buf32, offset, length, stereo;
+
+  switch (v & 0xff)
+  {
+    case SMT_YM:
+      YM2612WriteReg_((v >> 8) & 0x1ff, v >> 20);
+      return rd + 1;
+
+    case SMT_PSG:
+      SN76496Write(v >> 8);
+      return rd + 1;
+
+    case SMT_DAC:
+      dac_fill(smt.out, log_at(rd + 1), v >> 8, (int)log_at(rd + 2));
+      return rd + 3;
+
+    case SMT_RENDER:
+      // PsndRender, without the parts not used with the thread
+      offset = log_at(rd + 1);
+      length = log_at(rd + 2);
+      v = log_at(rd + 3);
+      buf32 = PsndBuffer + offset;
+      stereo = (PicoOpt & 8) >> 3;
+      offset <<= stereo;
+
+      if (PicoOpt & POPT_EN_PSG)
+        SN76496Update(smt.out + offset, length, stereo);
+      if (PicoOpt & POPT_EN_FM)
+        YM2612UpdateOneSt_(buf32, length, stereo, 1, v & 0xff, v >> 8);
+      else
+        memset32(buf32, 0, length<<stereo);
+      PsndMix_32_to_16l(smt.out + offset, buf32, length);
+      return rd + 4;
+
+    case SMT_SWAP:
+      smt.out = smt_next;
+      return rd + 1;
+  }
+
+  elprintf(EL_STATUS, "sound_mt: bad log entry %08x", v);
+  return smt.wr;
+}
+
+static void *smt_worker(void *arg)
+{
+  unsigned int rd = smt.rd, end;
+  int spins;
+
+  for (;;) {
+    for (spins = 0; smt.wr == rd && !smt.quit; spins++) {
+      if (spins < SMT_SPINS)
+        continue;
+      pthread_mutex_lock(&smt.lock);
+      smt.sleeping = 1;
+      __sync_synchronize();
+      while (smt.wr == rd && !smt.quit)
+        pthread_cond_wait(&smt.cond, &smt.lock);
+      smt.sleeping = 0;
+      pthread_mutex_unlock(&smt.lock);
+    }
+    if (smt.quit)
+      break;
+    __sync_synchronize();
+
+    end = smt.wr;
+    while (rd != end)
+      rd = smt_replay(rd);
+
+    __sync_synchronize();
+    smt.rd = rd;
+  }
+  return NULL;
+}
+
+static int smt_start(void)
+{
+  pthread_mutex_init(&smt.lock, NULL);
+  pthread_cond_init(&smt.cond, NULL);
+  smt.quit = 0;
+  smt.wr = smt.rd = smt.pos = 0;
+
+  if (pthread_create(&smt.thread, NULL, smt_worker, NULL) != 0) {
+    elprintf(EL_STATUS, "sound thread creation failed");
+    pthread_cond_destroy(&smt.cond);
+    pthread_mutex_destroy(&smt.lock);
+    PicoOpt &= ~POPT_EN_SND_THREAD;
+    return -1;
+  }
+  smt.started = 1;
+  return 0;
+}
+
+void PsndMtStop(void)
+{
+  if (!smt.started)
+    return;
+
+  pthread_mutex_lock(&smt.lock);
+  smt.quit = 1;
+  pthread_cond_signal(&smt.cond);
+  pthread_mutex_unlock(&smt.lock);
+  pthread_join(smt.thread, NULL);
+
+  pthread_cond_destroy(&smt.cond);
+  pthread_mutex_destroy(&smt.lock);
+  smt.started = 0;
+}
+
+static void smt_publish(void)
+{
+  __sync_synchronize();
+  smt.wr = smt.pos;
+  __sync_synchronize();
+  if (smt.sleeping) {
+    pthread_mutex_lock(&smt.lock);
+    pthread_cond_signal(&smt.cond);
+    pthread_mutex_unlock(&smt.lock);
+  }
+}
+
+static void smt_wait(unsigned int need)
+{
+  int spins = 0;
+
+  while (need ? smt.pos + need - smt.rd > SMT_LOG_SIZE : smt.rd != smt.pos) {
+    if (++spins > SMT_SPINS)
+      sched_yield(), spins = 0;
+  }
+  __sync_synchronize();
+}
+
+static void smt_reserve(unsigned int n)
+{
+  if (smt.pos + n - smt.rd > SMT_LOG_SIZE) {
+    smt_publish();
+    smt_wait(n);
+  }
+}
+
+// wait for the sound thread to catch up
+static void smt_sync(void)
+{
+  smt_publish();
+  smt_wait(0);
+}
+
+// returns what YM2612Write_ would, for emustatus, so that the
+// line_sample render doesn't have to wait for the write to be done
+int PsndMtYmWrite(int addr, int d)
+{
+  smt_reserve(1);
+  log_put(SMT_YM | (addr << 8) | (d << 20));
+  return YM2612WriteRegRet_(addr, d);
+}
+
+void PsndMtPsgWrite(int d)
+{
+  smt_reserve(1);
+  log_put(SMT_PSG | (d << 8));
+}
+
+static void smt_dac(int pos, int len, int dout)
+{
+  smt_reserve(3);
+  log_put(SMT_DAC | (len << 8));
+  log_put(pos);
+  log_put(dout);
+}
+
+static void smt_render(int offset, int length)
+{
+  smt_reserve(4);
+  log_put(SMT_RENDER);
+  log_put(offset);
+  log_put(length);
+  log_put((ym2612.OPN.ST.mode & 0xff) | (ym2612.dacen << 8));
+  smt_publish();
+}
+
+static void smt_frame_out(int len)
+{
+  smt_reserve(1);
+  log_put(SMT_SWAP);
+  smt_publish();
+  smt.out_len = len;
+}
+
+void PsndMtFrameStart(void)
+{
+  PsndMtFrameEnd();
+
+  if (!(PicoOpt & POPT_EN_SND_THREAD) || (PicoOpt & POPT_EXT_FM)
+      || (PicoAHW & PAHW_PICO) || PsndOut == NULL)
+    return;
+
+  if (!smt.started && smt_start() != 0)
+    return;
+
+  smt.out = snd_buf();
+  smt.out_len = -1;
+  PsndThreaded = 1;
+}
+
+void PsndMtFrameEnd(void)
+{
+  int len, stereo;
+
+  if (!PsndThreaded)
+    return;
+
+  // the only wait, the frame's samples are needed now
+  pprof_start(sound);
+  smt_sync();
+  pprof_end(sound);
+  PsndThreaded = 0;
+  if (smt.out_len < 0)
+    return;
+
+  snd_write(smt.out_len);
   PsndClear();
+
+  // move over dac output that already belongs to the next frame
+  stereo = (PicoOpt & POPT_EN_STEREO) ? 1 : 0;
+  len = PsndLen;
+  if (PsndLen_exc_add) len++;
+  len <<= stereo;
+  memcpy(snd_buf(), smt_next, len * 2);
+  memset(smt_next, 0, len * 2);
 }
 
+#endif // SOUND_THREADS
+
+const struct pico_ctx_area ctx_areas_sound[] = {
+  PICO_CTX_AREA(PsndBuffer),
+  PICO_CTX_AREA(PsndNativeRate),
+  PICO_CTX_AREA(snd_native),
+  PICO_CTX_AREA(rs_out),
+  PICO_CTX_AREA(rs_cdda),
+  PICO_CTX_AREA(dac_info),
+  PICO_CTX_AREA(curr_pos),
+  PICO_CTX_AREA_END
+};
@@ -115,6 +115,7 @@
 
 #ifndef EXTERNAL_YM2612
 #include <stdlib.h>
+#include "../pico_int.h"
 // let it be 1 global to simplify things
 YM2612 ym2612;
 
@@ -126,6 +127,16 @@ extern YM2612 *ym2612_940;
 
 void memset32(int *dest, int c, int count);
 
+#if !defined(_ASM_YM2612_C) || defined(EXTERNAL_YM2612)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_AVX2_OPS
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HAVE_NEON_OPS
+#endif
+#endif
+
 
 #ifndef __GNUC__
 #pragma warning (disable:4100) // unreferenced formal parameter
@@ -189,7 +200,7 @@ void memset32(int *dest, int c, int count);
 */
 //#define TL_TAB_LEN (13*2*TL_RES_LEN)
 #define TL_TAB_LEN (13*TL_RES_LEN*256/8) // 106496*2
-UINT16 ym_tl_tab[TL_TAB_LEN];
+UINT16 ym_tl_tab[TL_TAB_LEN+1]; // +1 for simd gathers reading 32 bits
 
 /* ~3K wasted but oh well */
 UINT16 ym_tl_tab2[13*TL_RES_LEN];
@@ -1081,6 +1092,274 @@ static void chan_render_loop(chan_rend_context *ct, int *buffer, int length)
 		ct->phase4 += ct->incr4;
 	}
 }
+
+/* block renderer, same output as chan_render_loop.
+ * The envelope, lfo and op1 (it has feedback) are run sample by sample.
+ * The other operators only depend on earlier ones of the same sample or,
+ * through mem, on the previous sample, so each of them is then evaluated
+ * over the whole block, several samples at once where simd is there. */
+#define BLK_LEN 64
+
+/* out[i] = op_calc(phase + i*incr, env[i], pm[i]), 0 if env is quiet */
+static void op_run_c(INT32 *out, UINT32 phase, UINT32 incr, const INT32 *env, const INT32 *pm, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++, phase += incr)
+		out[i] = env[i] < ENV_QUIET ? op_calc(phase, env[i], pm[i]) : 0;
+}
+
+#ifdef HAVE_AVX2_OPS
+__attribute__((target("avx2")))
+static void op_run_avx2(INT32 *out, UINT32 phase, UINT32 incr, const INT32 *env, const INT32 *pm, int n)
+{
+	const __m256i x0ff = _mm256_set1_epi32(0xff), x100 = _mm256_set1_epi32(0x100);
+	const __m256i x200 = _mm256_set1_epi32(0x200), quiet = _mm256_set1_epi32(ENV_QUIET);
+	__m256i ph, step, e, s, t, neg, live, ret;
+	int i;
+
+	ph = _mm256_mullo_epi32(_mm256_setr_epi32(0,1,2,3,4,5,6,7), _mm256_set1_epi32(incr));
+	ph = _mm256_add_epi32(ph, _mm256_set1_epi32(phase));
+	step = _mm256_set1_epi32(incr * 8);
+
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		e = _mm256_loadu_si256((const void *)&env[i]);
+		t = _mm256_loadu_si256((const void *)&pm[i]);
+		s = _mm256_add_epi32(_mm256_srli_epi32(ph, 16), _mm256_srai_epi32(t, 1));
+		neg = _mm256_cmpeq_epi32(_mm256_and_si256(s, x200), x200);
+		t = _mm256_cmpeq_epi32(_mm256_and_si256(s, x100), x100);
+		s = _mm256_and_si256(_mm256_xor_si256(s, _mm256_and_si256(t, x0ff)), x0ff);
+		t = _mm256_slli_epi32(_mm256_srli_epi32(e, 1), 8);
+		live = _mm256_cmpgt_epi32(quiet, e);
+		/* 32bit reads of the 16bit table, see ym_tl_tab */
+		ret = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int *)ym_tl_tab,
+			_mm256_or_si256(s, t), live, 2);
+		ret = _mm256_and_si256(ret, _mm256_set1_epi32(0xffff));
+		ret = _mm256_sub_epi32(_mm256_xor_si256(ret, neg), neg);
+		_mm256_storeu_si256((void *)&out[i], ret);
+		ph = _mm256_add_epi32(ph, step);
+	}
+	op_run_c(out + i, phase + i*incr, incr, env + i, pm + i, n - i);
+}
+#endif
+
+#ifdef HAVE_NEON_OPS
+static void op_run_neon(INT32 *out, UINT32 phase, UINT32 incr, const INT32 *env, const INT32 *pm, int n)
+{
+	static const UINT32 lanes[4] = { 0, 1, 2, 3 };
+	uint32x4_t ph, step, neg, live;
+	int32x4_t e, s, t, ret;
+	INT32 idx[4];
+	int i;
+
+	ph = vmlaq_n_u32(vdupq_n_u32(phase), vld1q_u32(lanes), incr);
+	step = vdupq_n_u32(incr * 4);
+
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		e = vld1q_s32(&env[i]);
+		t = vld1q_s32(&pm[i]);
+		s = vaddq_s32(vreinterpretq_s32_u32(vshrq_n_u32(ph, 16)), vshrq_n_s32(t, 1));
+		neg = vtstq_s32(s, vdupq_n_s32(0x200));
+		t = vreinterpretq_s32_u32(vtstq_s32(s, vdupq_n_s32(0x100)));
+		s = vandq_s32(veorq_s32(s, vandq_s32(t, vdupq_n_s32(0xff))), vdupq_n_s32(0xff));
+		live = vcltq_s32(e, vdupq_n_s32(ENV_QUIET));
+		t = vorrq_s32(s, vshlq_n_s32(vshrq_n_s32(e, 1), 8));
+		vst1q_s32(idx, vandq_s32(t, vreinterpretq_s32_u32(live)));
+		ret = vdupq_n_s32(ym_tl_tab[idx[0]]);
+		ret = vsetq_lane_s32(ym_tl_tab[idx[1]], ret, 1);
+		ret = vsetq_lane_s32(ym_tl_tab[idx[2]], ret, 2);
+		ret = vsetq_lane_s32(ym_tl_tab[idx[3]], ret, 3);
+		ret = vandq_s32(ret, vreinterpretq_s32_u32(live));
+		ret = vsubq_s32(veorq_s32(ret, vreinterpretq_s32_u32(neg)), vreinterpretq_s32_u32(neg));
+		vst1q_s32(&out[i], ret);
+		ph = vaddq_u32(ph, step);
+	}
+	op_run_c(out + i, phase + i*incr, incr, env + i, pm + i, n - i);
+}
+#endif
+
+static void (*op_run)(INT32 *out, UINT32 phase, UINT32 incr, const INT32 *env, const INT32 *pm, int n) = op_run_c;
+
+static void op_run_select(void)
+{
+#ifdef HAVE_AVX2_OPS
+	if (__builtin_cpu_supports("avx2"))
+		op_run = op_run_avx2;
+#elif defined(HAVE_NEON_OPS)
+	op_run = op_run_neon;
+#endif
+}
+
+static void chan_render_block(chan_rend_context *ct, int *buffer, int length)
+{
+	static const INT32 zero[BLK_LEN];
+	INT32 env2[BLK_LEN], env3[BLK_LEN], env4[BLK_LEN];
+	INT32 c1m[BLK_LEN+1], o2m[BLK_LEN+1], o3[BLK_LEN], o4[BLK_LEN], smp[BLK_LEN];
+	INT32 *c1 = c1m + 1, *o2 = o2m + 1;
+	UINT32 pack, lfo_cnt, eg_timer, phase1;
+	INT32 op1_out;
+	int done, i, n, any;
+
+	for (done = 0; done < length; done += n, buffer += n << (ct->pack & 1))
+	{
+		n = length - done;
+		if (n > BLK_LEN)
+			n = BLK_LEN;
+
+		/* envelope, lfo and op1, as in chan_render_loop */
+		pack = ct->pack;
+		lfo_cnt = ct->lfo_cnt;
+		eg_timer = ct->eg_timer;
+		op1_out = ct->op1_out;
+		phase1 = ct->phase1;
+		for (i = 0; i < n; i++)
+		{
+			unsigned int eg_out, add = 0;
+
+			if (pack & 8) {
+				pack = (pack&0xffff) | (advance_lfo(pack >> 16, lfo_cnt, lfo_cnt + ct->lfo_inc) << 16);
+				lfo_cnt += ct->lfo_inc;
+				add = pack >> (((pack&0xc0)>>6)+24);
+			}
+
+			eg_timer += ct->eg_timer_add;
+			while (eg_timer >= EG_TIMER_OVERFLOW)
+			{
+				eg_timer -= EG_TIMER_OVERFLOW;
+				ct->eg_cnt++;
+
+				if (ct->CH->SLOT[SLOT1].state != EG_OFF) ct->vol_out1 = update_eg_phase(&ct->CH->SLOT[SLOT1], ct->eg_cnt);
+				if (ct->CH->SLOT[SLOT2].state != EG_OFF) ct->vol_out2 = update_eg_phase(&ct->CH->SLOT[SLOT2], ct->eg_cnt);
+				if (ct->CH->SLOT[SLOT3].state != EG_OFF) ct->vol_out3 = update_eg_phase(&ct->CH->SLOT[SLOT3], ct->eg_cnt);
+				if (ct->CH->SLOT[SLOT4].state != EG_OFF) ct->vol_out4 = update_eg_phase(&ct->CH->SLOT[SLOT4], ct->eg_cnt);
+			}
+
+			eg_out = ct->vol_out1;
+			if (pack & (1<<(SLOT1+8))) eg_out += add;
+			if( eg_out < ENV_QUIET )	/* SLOT 1 */
+			{
+				int out = 0;
+
+				if (pack&0xf000) out = ((op1_out>>16) + ((op1_out<<16)>>16)) << ((pack&0xf000)>>12); /* op1_out0 + op1_out1 */
+				op1_out <<= 16;
+				op1_out |= (unsigned short)op_calc1(phase1, eg_out, out);
+			} else {
+				op1_out <<= 16; /* op1_out0 = op1_out1; op1_out1 = 0; */
+			}
+			phase1 += ct->incr1;
+			c1[i] = op1_out>>16;
+
+			env2[i] = ct->vol_out2 + ((pack & (1<<(SLOT2+8))) ? add : 0);
+			env3[i] = ct->vol_out3 + ((pack & (1<<(SLOT3+8))) ? add : 0);
+			env4[i] = ct->vol_out4 + ((pack & (1<<(SLOT4+8))) ? add : 0);
+		}
+		ct->pack = pack;
+		ct->lfo_cnt = lfo_cnt;
+		ct->eg_timer = eg_timer;
+		ct->op1_out = op1_out;
+		ct->phase1 = phase1;
+
+		/* the rest of the algorithm, m2 inputs are the last sample's mem */
+		c1m[0] = ct->mem;
+		o2m[0] = ct->mem;
+		switch( ct->CH->ALGO )
+		{
+			case 0:	/* M1---C1---MEM---M2---C2---OUT */
+				op_run(o2, ct->phase2, ct->incr2, env2, c1, n);
+				op_run(o3, ct->phase3, ct->incr3, env3, o2m, n);
+				op_run(smp, ct->phase4, ct->incr4, env4, o3, n);
+				ct->mem = o2[n-1];
+				break;
+			case 1:	/* M1------+-MEM---M2---C2---OUT */
+				/*      C1-+                     */
+				op_run(o2, ct->phase2, ct->incr2, env2, zero, n);
+				for (i = 0; i < n; i++)
+					o2[i] += c1[i];
+				op_run(o3, ct->phase3, ct->incr3, env3, o2m, n);
+				op_run(smp, ct->phase4, ct->incr4, env4, o3, n);
+				ct->mem = o2[n-1];
+				break;
+			case 2:	/* M1-----------------+-C2---OUT */
+				/*      C1---MEM---M2-+          */
+				op_run(o2, ct->phase2, ct->incr2, env2, zero, n);
+				op_run(o3, ct->phase3, ct->incr3, env3, o2m, n);
+				for (i = 0; i < n; i++)
+					o3[i] += c1[i];
+				op_run(smp, ct->phase4, ct->incr4, env4, o3, n);
+				ct->mem = o2[n-1];
+				break;
+			case 3:	/* M1---C1---MEM------+-C2---OUT */
+				/*                 M2-+          */
+				op_run(o2, ct->phase2, ct->incr2, env2, c1, n);
+				op_run(o3, ct->phase3, ct->incr3, env3, zero, n);
+				for (i = 0; i < n; i++)
+					o3[i] += o2m[i];
+				op_run(smp, ct->phase4, ct->incr4, env4, o3, n);
+				ct->mem = o2[n-1];
+				break;
+			case 4:	/* M1---C1-+-OUT */
+				/* M2---C2-+     */
+				op_run(o3, ct->phase3, ct->incr3, env3, zero, n);
+				op_run(o2, ct->phase2, ct->incr2, env2, c1, n);
+				op_run(smp, ct->phase4, ct->incr4, env4, o3, n);
+				for (i = 0; i < n; i++)
+					smp[i] += o2[i];
+				break;
+			case 5:	/*    +----C1----+     */
+				/* M1-+-MEM---M2-+-OUT */
+				/*    +----C2----+     */
+				op_run(o3, ct->phase3, ct->incr3, env3, c1m, n);
+				op_run(o2, ct->phase2, ct->incr2, env2, c1, n);
+				op_run(o4, ct->phase4, ct->incr4, env4, c1, n);
+				for (i = 0; i < n; i++)
+					smp[i] = o3[i] + o2[i] + o4[i];
+				ct->mem = c1[n-1];
+				break;
+			case 6:	/* M1---C1-+     */
+				/*      M2-+-OUT */
+				/*      C2-+     */
+				op_run(o3, ct->phase3, ct->incr3, env3, zero, n);
+				op_run(o2, ct->phase2, ct->incr2, env2, c1, n);
+				op_run(o4, ct->phase4, ct->incr4, env4, zero, n);
+				for (i = 0; i < n; i++)
+					smp[i] = o3[i] + o2[i] + o4[i];
+				break;
+			default: /* M1-+     */
+				/* C1-+-OUT */
+				/* M2-+     */
+				/* C2-+     */
+				op_run(o3, ct->phase3, ct->incr3, env3, zero, n);
+				op_run(o2, ct->phase2, ct->incr2, env2, zero, n);
+				op_run(o4, ct->phase4, ct->incr4, env4, zero, n);
+				for (i = 0; i < n; i++)
+					smp[i] = c1[i] + o3[i] + o2[i] + o4[i];
+				break;
+		}
+		ct->phase2 += ct->incr2 * n;
+		ct->phase3 += ct->incr3 * n;
+		ct->phase4 += ct->incr4 * n;
+
+		/* mix samples to output buffer */
+		for (i = any = 0; i < n; i++)
+			any |= smp[i];
+		if (!any)
+			continue;
+		if (ct->pack & 1) { /* stereo */
+			if (ct->pack & 0x20) /* L */
+				for (i = 0; i < n; i++)
+					buffer[i*2] += smp[i];
+			if (ct->pack & 0x10) /* R */
+				for (i = 0; i < n; i++)
+					buffer[i*2+1] += smp[i];
+		} else {
+			for (i = 0; i < n; i++)
+				buffer[i] += smp[i];
+		}
+		ct->algo = 8;
+	}
+}
 #else
 void chan_render_loop(chan_rend_context *ct, int *buffer, unsigned short length);
 #endif
@@ -1183,6 +1462,11 @@ static int chan_render(int *buffer, int length, int c, UINT32 flags) // flags: s
 		crct.incr4 = crct.CH->SLOT[SLOT4].Incr;
 	}
 
+#if !defined(_ASM_YM2612_C) || defined(EXTERNAL_YM2612)
+	if (!(crct.pack & 4))
+		chan_render_block(&crct, buffer, length);
+	else
+#endif
 	chan_render_loop(&crct, buffer, length);
 
 	crct.CH->op1_out = crct.op1_out;
@@ -1604,6 +1888,15 @@ static int OPNWriteReg(int r, int v)
 
 /* Generate samples for YM2612 */
 int YM2612UpdateOne_(int *buffer, int length, int stereo, int is_buf_empty)
+{
+	return YM2612UpdateOneSt_(buffer, length, stereo, is_buf_empty,
+		ym2612.OPN.ST.mode, ym2612.dacen);
+}
+
+/* same, but with timer mode and DAC enable supplied by the caller, */
+/* for when they may change while we render (sound thread) */
+int YM2612UpdateOneSt_(int *buffer, int length, int stereo, int is_buf_empty,
+	int st_mode, int dacen)
 {
 	int pan;
 	int active_chs = 0;
@@ -1632,7 +1925,7 @@ int YM2612UpdateOne_(int *buffer, int length, int stereo, int is_buf_empty)
 	/* refresh PG and EG */
 	refresh_fc_eg_chan( &ym2612.CH[0] );
 	refresh_fc_eg_chan( &ym2612.CH[1] );
-	if( (ym2612.OPN.ST.mode & 0xc0) )
+	if( (st_mode & 0xc0) )
 		/* 3SLOT MODE */
 		refresh_fc_eg_chan_sl3();
 	else
@@ -1652,7 +1945,7 @@ int YM2612UpdateOne_(int *buffer, int length, int stereo, int is_buf_empty)
 	if (ym2612.slot_mask & 0x000f00) active_chs |= chan_render(buffer, length, 2, stereo|((pan&0x030)   )) << 2;
 	if (ym2612.slot_mask & 0x00f000) active_chs |= chan_render(buffer, length, 3, stereo|((pan&0x0c0)>>2)) << 3;
 	if (ym2612.slot_mask & 0x0f0000) active_chs |= chan_render(buffer, length, 4, stereo|((pan&0x300)>>4)) << 4;
-	if (ym2612.slot_mask & 0xf00000) active_chs |= chan_render(buffer, length, 5, stereo|((pan&0xc00)>>6)|(ym2612.dacen<<2)) << 5;
+	if (ym2612.slot_mask & 0xf00000) active_chs |= chan_render(buffer, length, 5, stereo|((pan&0xc00)>>6)|(dacen<<2)) << 5;
 	chan_render_finish();
 
 	return active_chs; // 1 if buffer updated
@@ -1664,6 +1957,9 @@ void YM2612Init_(int clock, int rate)
 {
 	memset(&ym2612, 0, sizeof(ym2612));
 	init_tables();
+#if !defined(_ASM_YM2612_C) || defined(EXTERNAL_YM2612)
+	op_run_select();
+#endif
 
 	ym2612.OPN.ST.clock = clock;
 	ym2612.OPN.ST.rate = rate;
@@ -1709,13 +2005,138 @@ void YM2612ResetChip_(void)
 }
 
 
+/* what YM2612WriteReg_ returns for a write, without doing it */
+int YM2612WriteRegRet_(unsigned int addr, unsigned int v)
+{
+	if (addr < 0x100 && (addr & 0xf0) == 0x20)
+	{
+		switch (addr)
+		{
+		case 0x27: case 0x2a: case 0x2b:
+			return 0;
+		case 0x28:
+			return (v & 3) != 3;
+		default:
+			return 1;
+		}
+	}
+
+	/* OPNWriteReg */
+	if (OPN_CHAN(addr) == 3)
+		return 0;
+	switch (addr & 0xf0)
+	{
+	case 0x30: case 0x40: case 0x50: case 0x60: case 0x70: case 0x80:
+		return 1;
+	case 0xa0:	/* FNUM1, 3CH FNUM1 */
+		return !(OPN_SLOT(addr) & 1);
+	case 0xb0:	/* FB/ALGO, L/R/AMS/PMS */
+		return OPN_SLOT(addr) < 2;
+	}
+	return 0;
+}
+
+/* write to a register with address already latched, addr = 0x000-0x1ff */
+/* returns 1 if sample affecting state changed */
+int YM2612WriteReg_(unsigned int addr, unsigned int v)
+{
+	int ret=1;
+
+	if (addr >= 0x100)
+		return OPNWriteReg(addr, v);
+
+	switch( addr & 0xf0 )
+	{
+	case 0x20:	/* 0x20-0x2f Mode */
+		switch( addr )
+		{
+		case 0x22:	/* LFO FREQ (YM2608/YM2610/YM2610B/YM2612) */
+			if (v&0x08) /* LFO enabled ? */
+			{
+				ym2612.OPN.lfo_inc = ym2612.OPN.lfo_freq[v&7];
+			}
+			else
+			{
+				ym2612.OPN.lfo_inc = 0;
+			}
+			break;
+#if 0 // handled elsewhere
+		case 0x24: { // timer A High 8
+				int TAnew = (ym2612.OPN.ST.TA & 0x03)|(((int)v)<<2);
+				if(ym2612.OPN.ST.TA != TAnew) {
+					// we should reset ticker only if new value is written. Outrun requires this.
+					ym2612.OPN.ST.TA = TAnew;
+					ym2612.OPN.ST.TAC = (1024-TAnew)*18;
+					ym2612.OPN.ST.TAT = 0;
+				}
+			}
+			ret=0;
+			break;
+		case 0x25: { // timer A Low 2
+				int TAnew = (ym2612.OPN.ST.TA & 0x3fc)|(v&3);
+				if(ym2612.OPN.ST.TA != TAnew) {
+					ym2612.OPN.ST.TA = TAnew;
+					ym2612.OPN.ST.TAC = (1024-TAnew)*18;
+					ym2612.OPN.ST.TAT = 0;
+				}
+			}
+			ret=0;
+			break;
+		case 0x26: // timer B
+			if(ym2612.OPN.ST.TB != v) {
+				ym2612.OPN.ST.TB = v;
+				ym2612.OPN.ST.TBC  = (256-v)<<4;
+				ym2612.OPN.ST.TBC *= 18;
+				ym2612.OPN.ST.TBT  = 0;
+			}
+			ret=0;
+			break;
+#endif
+		case 0x27:	/* mode, timer control */
+			set_timers( v );
+			ret=0;
+			break;
+		case 0x28:	/* key on / off */
+			{
+				UINT8 c;
+
+				c = v & 0x03;
+				if( c == 3 ) { ret=0; break; }
+				if( v&0x04 ) c+=3;
+				if(v&0x10) FM_KEYON(c,SLOT1); else FM_KEYOFF(c,SLOT1);
+				if(v&0x20) FM_KEYON(c,SLOT2); else FM_KEYOFF(c,SLOT2);
+				if(v&0x40) FM_KEYON(c,SLOT3); else FM_KEYOFF(c,SLOT3);
+				if(v&0x80) FM_KEYON(c,SLOT4); else FM_KEYOFF(c,SLOT4);
+				break;
+			}
+		case 0x2a:	/* DAC data (YM2612) */
+			ym2612.dacout = ((int)v - 0x80) << 6;	/* level unknown (notaz: 8 seems to be too much) */
+			ret=0;
+			break;
+		case 0x2b:	/* DAC Sel  (YM2612) */
+			/* b7 = dac enable */
+			ym2612.dacen = v & 0x80;
+			ret=0;
+			break;
+		default:
+			break;
+		}
+		break;
+	default:	/* 0x30-0xff OPN section */
+		/* write register */
+		ret = OPNWriteReg(addr,v);
+	}
+
+	return ret;
+}
+
 /* YM2612 write */
 /* a = address */
 /* v = value   */
 /* returns 1 if sample affecting state changed */
 int YM2612Write_(unsigned int a, unsigned int v)
 {
-	int addr, ret=1;
+	int ret=1;
 
 	v &= 0xff;	/* adjust to 8 bit bus */
 
@@ -1732,89 +2153,7 @@ int YM2612Write_(unsigned int a, unsigned int v)
 			break;	/* verified on real YM2608 */
 		}
 
-		addr = ym2612.OPN.ST.address;
-
-		switch( addr & 0xf0 )
-		{
-		case 0x20:	/* 0x20-0x2f Mode */
-			switch( addr )
-			{
-			case 0x22:	/* LFO FREQ (YM2608/YM2610/YM2610B/YM2612) */
-				if (v&0x08) /* LFO enabled ? */
-				{
-					ym2612.OPN.lfo_inc = ym2612.OPN.lfo_freq[v&7];
-				}
-				else
-				{
-					ym2612.OPN.lfo_inc = 0;
-				}
-				break;
-#if 0 // handled elsewhere
-			case 0x24: { // timer A High 8
-					int TAnew = (ym2612.OPN.ST.TA & 0x03)|(((int)v)<<2);
-					if(ym2612.OPN.ST.TA != TAnew) {
-						// we should reset ticker only if new value is written. Outrun requires this.
-						ym2612.OPN.ST.TA = TAnew;
-						ym2612.OPN.ST.TAC = (1024-TAnew)*18;
-						ym2612.OPN.ST.TAT = 0;
-					}
-				}
-				ret=0;
-				break;
-			case 0x25: { // timer A Low 2
-					int TAnew = (ym2612.OPN.ST.TA & 0x3fc)|(v&3);
-					if(ym2612.OPN.ST.TA != TAnew) {
-						ym2612.OPN.ST.TA = TAnew;
-						ym2612.OPN.ST.TAC = (1024-TAnew)*18;
-						ym2612.OPN.ST.TAT = 0;
-					}
-				}
-				ret=0;
-				break;
-			case 0x26: // timer B
-				if(ym2612.OPN.ST.TB != v) {
-					ym2612.OPN.ST.TB = v;
-					ym2612.OPN.ST.TBC  = (256-v)<<4;
-					ym2612.OPN.ST.TBC *= 18;
-					ym2612.OPN.ST.TBT  = 0;
-				}
-				ret=0;
-				break;
-#endif
-			case 0x27:	/* mode, timer control */
-				set_timers( v );
-				ret=0;
-				break;
-			case 0x28:	/* key on / off */
-				{
-					UINT8 c;
-
-					c = v & 0x03;
-					if( c == 3 ) { ret=0; break; }
-					if( v&0x04 ) c+=3;
-					if(v&0x10) FM_KEYON(c,SLOT1); else FM_KEYOFF(c,SLOT1);
-					if(v&0x20) FM_KEYON(c,SLOT2); else FM_KEYOFF(c,SLOT2);
-					if(v&0x40) FM_KEYON(c,SLOT3); else FM_KEYOFF(c,SLOT3);
-					if(v&0x80) FM_KEYON(c,SLOT4); else FM_KEYOFF(c,SLOT4);
-					break;
-				}
-			case 0x2a:	/* DAC data (YM2612) */
-				ym2612.dacout = ((int)v - 0x80) << 6;	/* level unknown (notaz: 8 seems to be too much) */
-				ret=0;
-				break;
-			case 0x2b:	/* DAC Sel  (YM2612) */
-				/* b7 = dac enable */
-				ym2612.dacen = v & 0x80;
-				ret=0;
-				break;
-			default:
-				break;
-			}
-			break;
-		default:	/* 0x30-0xff OPN section */
-			/* write register */
-			ret = OPNWriteReg(addr,v);
-		}
+		ret = YM2612WriteReg_(ym2612.OPN.ST.address, v);
 		break;
 
 	case 2:	/* address port 1 */
@@ -1829,9 +2168,7 @@ int YM2612Write_(unsigned int a, unsigned int v)
 			break;	/* verified on real YM2608 */
 		}
 
-		addr = ym2612.OPN.ST.address | 0x100;
-
-		ret = OPNWriteReg(addr, v);
+		ret = OPNWriteReg(ym2612.OPN.ST.address | 0x100, v);
 		break;
 	}
 
@@ -2054,3 +2391,59 @@ void *YM2612GetRegs(void)
 	return ym2612.REGS;
 }
 
+/* mem states (run-ahead, netplay): the whole chip and the LFO output,
+ * the packed save state above drops the low phase bits and the feedback
+ * history. Detune pointers are kept as dt_tab offsets. */
+#define MEMSTATE_DT(c, s) (offsetof(YM2612, CH) + (c) * sizeof(FM_CH) + \
+	offsetof(FM_CH, SLOT) + (s) * sizeof(FM_SLOT) + offsetof(FM_SLOT, DT))
+
+int YM2612PicoStateMemSize(void)
+{
+	return sizeof(ym2612) + sizeof(g_lfo_ampm);
+}
+
+void YM2612PicoStateSaveMem(void *buf)
+{
+	unsigned char *p = buf;
+	INT32 *dt;
+	int c, s;
+
+	memcpy(p, &ym2612, sizeof(ym2612));
+	for (c = 0; c < 6; c++)
+		for (s = 0; s < 4; s++) {
+			dt = (INT32 *)(size_t)(ym2612.CH[c].SLOT[s].DT - ym2612.OPN.ST.dt_tab[0]);
+			memcpy(p + MEMSTATE_DT(c, s), &dt, sizeof(dt));
+		}
+	memcpy(p + sizeof(ym2612), &g_lfo_ampm, sizeof(g_lfo_ampm));
+}
+
+/* -1 if saved at another rate, the packed state has to do then */
+int YM2612PicoStateLoadMem(const void *buf)
+{
+	const unsigned char *p = buf;
+	int clock, rate;
+	INT32 *dt;
+	int c, s;
+
+	memcpy(&clock, p + offsetof(YM2612, OPN.ST.clock), sizeof(clock));
+	memcpy(&rate, p + offsetof(YM2612, OPN.ST.rate), sizeof(rate));
+	if (clock != ym2612.OPN.ST.clock || rate != ym2612.OPN.ST.rate)
+		return -1;
+
+	memcpy(&ym2612, p, sizeof(ym2612));
+	for (c = 0; c < 6; c++)
+		for (s = 0; s < 4; s++) {
+			memcpy(&dt, p + MEMSTATE_DT(c, s), sizeof(dt));
+			ym2612.CH[c].SLOT[s].DT = ym2612.OPN.ST.dt_tab[0] + (size_t)dt;
+		}
+	memcpy(&g_lfo_ampm, p + sizeof(ym2612), sizeof(g_lfo_ampm));
+	return 0;
+}
+
+#ifndef EXTERNAL_YM2612
+const struct pico_ctx_area ctx_areas_ym2612[] = {
+	PICO_CTX_AREA(crct),
+	PICO_CTX_AREA(g_lfo_ampm),
+	PICO_CTX_AREA_END
+};
+#endif
@@ -151,8 +151,12 @@ extern YM2612 ym2612;
 void YM2612Init_(int baseclock, int rate);
 void YM2612ResetChip_(void);
 int  YM2612UpdateOne_(int *buffer, int length, int stereo, int is_buf_empty);
+int  YM2612UpdateOneSt_(int *buffer, int length, int stereo, int is_buf_empty,
+			int st_mode, int dacen);
 
 int  YM2612Write_(unsigned int a, unsigned int v);
+int  YM2612WriteReg_(unsigned int addr, unsigned int v);
+int  YM2612WriteRegRet_(unsigned int addr, unsigned int v);
 //unsigned char YM2612Read_(void);
 
 int  YM2612PicoTick_(int n);
@@ -161,6 +165,9 @@ void YM2612PicoStateLoad_(void);
 void *YM2612GetRegs(void);
 void YM2612PicoStateSave2(int tat, int tbt);
 int  YM2612PicoStateLoad2(int *tat, int *tbt);
+int  YM2612PicoStateMemSize(void);
+void YM2612PicoStateSaveMem(void *buf);
+int  YM2612PicoStateLoadMem(const void *buf);
 
 #ifndef __GP2X__
 #define YM2612Init          YM2612Init_
@@ -418,6 +418,42 @@ static int g_read_offs = 0;
   CHECKED_READ(len, data); \
 }
 
+static void state_loaded(const unsigned char *buff_m68k,
+  const unsigned char *buff_s68k, const unsigned char *buff_z80)
+{
+  if (PicoAHW & PAHW_SMS)
+    PicoStateLoadedMS();
+
+  if (PicoAHW & PAHW_32X)
+    Pico32xStateLoaded(1);
+
+  // must unpack 68k and z80 after banks are set up
+  if (!(PicoAHW & PAHW_SMS))
+    SekUnpackCpu(buff_m68k, 0);
+  if (PicoAHW & PAHW_MCD)
+    SekUnpackCpu(buff_s68k, 1);
+
+  z80_unpack(buff_z80);
+
+  // ram came from the state, drop code translated from what was there
+  fm68k_drc_verify(Pico.ram, sizeof(Pico.ram));
+  if (PicoAHW & PAHW_MCD) {
+    fm68k_drc_verify(Pico_mcd->prg_ram, sizeof(Pico_mcd->prg_ram));
+    fm68k_drc_verify(Pico_mcd->word_ram2M, sizeof(Pico_mcd->word_ram2M));
+  }
+  cz80_drc_verify(Pico.zram, sizeof(Pico.zram));
+
+  // due to dep from 68k cycles..
+  SekCycleAim = SekCycleCnt;
+  if (PicoAHW & PAHW_32X)
+    Pico32xStateLoaded(0);
+  if (PicoAHW & PAHW_MCD)
+  {
+    SekCycleAimS68k = SekCycleCntS68k;
+    pcd_state_loaded();
+  }
+}
+
 static int state_load(void *file)
 {
   unsigned char buff_m68k[0x60], buff_s68k[0x60];
@@ -583,30 +619,7 @@ breakswitch:
   }
 
 readend:
-  if (PicoAHW & PAHW_SMS)
-    PicoStateLoadedMS();
-
-  if (PicoAHW & PAHW_32X)
-    Pico32xStateLoaded(1);
-
-  // must unpack 68k and z80 after banks are set up
-  if (!(PicoAHW & PAHW_SMS))
-    SekUnpackCpu(buff_m68k, 0);
-  if (PicoAHW & PAHW_MCD)
-    SekUnpackCpu(buff_s68k, 1);
-
-  z80_unpack(buff_z80);
-
-  // due to dep from 68k cycles..
-  SekCycleAim = SekCycleCnt;
-  if (PicoAHW & PAHW_32X)
-    Pico32xStateLoaded(0);
-  if (PicoAHW & PAHW_MCD)
-  {
-    SekCycleAimS68k = SekCycleCntS68k;
-    pcd_state_loaded();
-  }
-
+  state_loaded(buff_m68k, buff_s68k, buff_z80);
   retval = 0;
 
 out:
@@ -677,12 +690,14 @@ static int pico_state_internal(void *afile, int is_save)
   if (is_save)
     ret = state_save(afile);
   else {
+    PicoDrawMtFrameEnd();
     ret = state_load(afile);
     if (ret != 0) {
       areaSeek(afile, 0, SEEK_SET);
       ret = state_load_legacy(afile);
     }
 
+    PicoDirtyAll();
     if (PicoLoadStateHook != NULL)
       PicoLoadStateHook();
     Pico.m.dirtyPal = 1;
@@ -717,6 +732,283 @@ int PicoStateFP(void *afile, int is_save,
   return pico_state_internal(afile, is_save);
 }
 
+// ---------------------------------------------------------------------------
+
+// fixed layout state for frontends keeping states in memory (run-ahead,
+// netplay). Same data as the chunked format, but no chunk headers and no
+// io callbacks; the layout only depends on PicoAHW and the cart hw.
+#define MSTATE_SIZE  0
+#define MSTATE_SAVE  1
+#define MSTATE_LOAD  2
+#define MSTATE_DIRTY 4 // run-ahead: only changed pages of big areas
+
+#define MSTATE_HDR_SIZE 16 // "PicoSMEM", PicoAHW, size
+
+#define MEM_AREA(data, len) { \
+  if (mode & MSTATE_SAVE) \
+    memcpy(p + pos, data, len); \
+  else if (mode & MSTATE_LOAD) \
+    memcpy(data, p + pos, len); \
+  pos += len; \
+}
+
+#define MEM_BUFF(buff) MEM_AREA(&buff, sizeof(buff))
+
+// area tracked in PicoDirtyPages (or compared, if dirty is NULL)
+#define MEM_PAGES(buff, dirty) { \
+  if (mode & MSTATE_DIRTY) { \
+    mem_pages(p + pos, (void *)&buff, sizeof(buff), dirty, mode & MSTATE_SAVE); \
+    pos += sizeof(buff); \
+  } \
+  else \
+    MEM_BUFF(buff); \
+}
+
+// packed cpu state, unpacked by state_loaded() on load
+#define MEM_CPU(buff, len, pack) { \
+  if (mode & MSTATE_SAVE) { \
+    memset(p + pos, 0, len); \
+    pack; \
+  } \
+  else if (mode & MSTATE_LOAD) \
+    memcpy(buff, p + pos, len); \
+  pos += len; \
+}
+
+// cd context, saved with its length
+#define MEM_CTX(save, load) { \
+  int len_ = 0; \
+  if (mode & MSTATE_LOAD) { \
+    memcpy(&len_, p + pos, 4); \
+    load(p + pos + 4); \
+  } \
+  else if (mode & MSTATE_SAVE) { \
+    len_ = save(p + pos + 4); \
+    memcpy(p + pos, &len_, 4); \
+  } \
+  else \
+    len_ = save(scratch); \
+  pos += 4 + len_; \
+}
+
+static void mem_pages(unsigned char *snap, unsigned char *mem, size_t size,
+  unsigned char *dirty, int save)
+{
+  const size_t psize = 1 << DIRTY_PAGE_SHIFT;
+  size_t i;
+
+  for (i = 0; i < size; i += psize) {
+    if (dirty != NULL) {
+      if (!dirty[i >> DIRTY_PAGE_SHIFT])
+        continue;
+      dirty[i >> DIRTY_PAGE_SHIFT] = 0;
+    }
+    else if (memcmp(snap + i, mem + i, psize) == 0)
+      continue;
+
+    if (save)
+      memcpy(snap + i, mem + i, psize);
+    else
+      memcpy(mem + i, snap + i, psize);
+  }
+}
+
+// walks the state in fixed order: counts, saves to or loads from p
+static size_t state_mem(unsigned char *p, int mode)
+{
+  unsigned char buff_m68k[0x60], buff_s68k[0x60];
+  unsigned char buff_z80[Z80_STATE_SIZE];
+  unsigned char *scratch = NULL;
+  void *ym2612_regs = YM2612GetRegs();
+  int ym_size = YM2612PicoStateMemSize();
+  unsigned int aim = SekCycleAim;
+  size_t pos = MSTATE_HDR_SIZE;
+
+  // saving doesn't need the draw thread idle, it has its own vdp copy
+  if (mode & MSTATE_LOAD)
+    PicoDrawMtFrameEnd();
+  memset(buff_s68k, 0, sizeof(buff_s68k));
+
+  if (!(PicoAHW & PAHW_SMS)) {
+    MEM_CPU(buff_m68k, 0x60, SekPackCpu(p + pos, 0));
+    MEM_BUFF(aim); // the 68k may have run past it
+    MEM_PAGES(Pico.ram, NULL); // written directly by the cpu cores
+    MEM_BUFF(Pico.vsram);
+    MEM_BUFF(Pico.ioports);
+    if (mode & MSTATE_SAVE)
+      ym2612_pack_state();
+    MEM_AREA(ym2612_regs, 0x200+4);
+    // the whole chip and exact timers too, the packed state drops the low
+    // phase bits and the feedback history. It's only unpacked if the sound
+    // rate changed, feeding the regs back also hits the DAC output.
+    if (mode & MSTATE_SAVE) {
+      YM2612PicoStateSaveMem(p + pos);
+      memcpy(p + pos + ym_size, &timer_a_next_oflow, 4);
+      memcpy(p + pos + ym_size + 4, &timer_b_next_oflow, 4);
+    }
+    else if ((mode & MSTATE_LOAD) && YM2612PicoStateLoadMem(p + pos) == 0) {
+      memcpy(&timer_a_next_oflow, p + pos + ym_size, 4);
+      memcpy(&timer_b_next_oflow, p + pos + ym_size + 4, 4);
+    }
+    else if (mode & MSTATE_LOAD)
+      ym2612_unpack_state();
+    pos += ym_size + 8;
+  }
+  else {
+    MEM_BUFF(Pico.ms);
+  }
+
+  MEM_PAGES(Pico.vram, PicoDirtyPages.vram);
+  MEM_BUFF(Pico.zram);
+  MEM_BUFF(Pico.cram);
+  MEM_BUFF(Pico.m);
+  MEM_BUFF(Pico.video);
+  MEM_CPU(buff_z80, Z80_STATE_SIZE, z80_pack(p + pos));
+  MEM_AREA(sn76496_regs, 28*4);
+
+  if (PicoAHW & PAHW_MCD)
+  {
+    if (mode == MSTATE_SIZE) {
+      scratch = malloc(CHUNK_LIMIT_W);
+      if (scratch == NULL)
+        return 0;
+    }
+    if (mode & MSTATE_SAVE) {
+      if (Pico_mcd->s68k_regs[3] & 4) // 1M mode?
+        wram_1M_to_2M(Pico_mcd->word_ram2M);
+      memcpy(&Pico_mcd->m.hint_vector, Pico_mcd->bios + 0x72,
+        sizeof(Pico_mcd->m.hint_vector));
+    }
+
+    MEM_CPU(buff_s68k, 0x60, SekPackCpu(p + pos, 1));
+    MEM_BUFF(Pico_mcd->prg_ram);
+    MEM_BUFF(Pico_mcd->word_ram2M); // in 2M format
+    MEM_BUFF(Pico_mcd->pcm_ram);
+    MEM_BUFF(Pico_mcd->bram);
+    MEM_BUFF(Pico_mcd->s68k_regs);
+    MEM_BUFF(Pico_mcd->pcm);
+    MEM_BUFF(Pico_mcd->m);
+    MEM_BUFF(pcd_event_times);
+    MEM_CTX(gfx_context_save, gfx_context_load);
+    MEM_CTX(cdc_context_save, cdc_context_load);
+    MEM_CTX(cdd_context_save, cdd_context_load);
+
+    if ((mode & MSTATE_SAVE) && (Pico_mcd->s68k_regs[3] & 4))
+      wram_2M_to_1M(Pico_mcd->word_ram2M);
+    free(scratch);
+  }
+
+#ifndef NO_32X
+  if (PicoAHW & PAHW_32X)
+  {
+    int i;
+    for (i = 0; i < 2; i++) {
+      if (mode & MSTATE_SAVE) {
+        memset(p + pos, 0, SH2_STATE_SIZE);
+        sh2_pack(&sh2s[i], p + pos);
+      }
+      else if (mode & MSTATE_LOAD)
+        sh2_unpack(&sh2s[i], p + pos);
+      pos += SH2_STATE_SIZE;
+      MEM_BUFF(sh2s[i].data_array);
+      MEM_BUFF(sh2s[i].peri_regs);
+    }
+
+    MEM_BUFF(Pico32x);
+    MEM_BUFF(Pico32xMem->m68k_rom);
+    MEM_BUFF(Pico32xMem->sh2_rom_m);
+    MEM_BUFF(Pico32xMem->sh2_rom_s);
+    MEM_BUFF(Pico32xMem->sdram);
+    MEM_PAGES(Pico32xMem->dram, PicoDirtyPages.dram);
+    MEM_BUFF(Pico32xMem->pal);
+    MEM_BUFF(p32x_event_times);
+  }
+#endif
+
+  if (carthw_chunks != NULL)
+  {
+    carthw_state_chunk *chwc;
+    for (chwc = carthw_chunks; chwc->ptr != NULL; chwc++)
+      MEM_AREA(chwc->ptr, chwc->size);
+  }
+
+  if (mode & MSTATE_LOAD) {
+    state_loaded(buff_m68k, buff_s68k, buff_z80);
+    if (!(PicoAHW & (PAHW_SMS|PAHW_MCD))) // mcd syncs the s68k to it
+      SekCycleAim = aim;
+    PicoDisplayDirty = 1;
+  }
+
+  return pos;
+}
+
+size_t PicoStateSize(void)
+{
+  return state_mem(NULL, MSTATE_SIZE);
+}
+
+static int state_save_mem(void *buf, size_t size, int mode)
+{
+  unsigned int hdr[2];
+  size_t need = PicoStateSize();
+
+  if (need == 0 || size < need)
+    return -1;
+
+  memcpy(buf, "PicoSMEM", 8);
+  hdr[0] = PicoAHW;
+  hdr[1] = need;
+  memcpy((char *)buf + 8, hdr, sizeof(hdr));
+  state_mem(buf, mode);
+  return 0;
+}
+
+int PicoStateSaveMem(void *buf, size_t size)
+{
+  return state_save_mem(buf, size, MSTATE_SAVE);
+}
+
+// returns -1 if buf doesn't hold a state of this layout
+int PicoStateLoadMem(const void *buf, size_t size)
+{
+  unsigned int hdr[2];
+
+  if (size < MSTATE_HDR_SIZE || memcmp(buf, "PicoSMEM", 8) != 0)
+    return -1;
+  memcpy(hdr, (const char *)buf + 8, sizeof(hdr));
+  if ((hdr[0] & PAHW_32X) && !(PicoAHW & PAHW_32X))
+    Pico32xStartup();
+  if (hdr[0] != PicoAHW || hdr[1] > size || hdr[1] != PicoStateSize()) {
+    elprintf(EL_STATUS, "load_state: mem state layout mismatch");
+    return -1;
+  }
+
+  state_mem((void *)buf, MSTATE_LOAD);
+  PicoDirtyAll();
+
+  if (PicoLoadStateHook != NULL)
+    PicoLoadStateHook();
+  Pico.m.dirtyPal = 1;
+  return 0;
+}
+
+// run-ahead snapshot: buf must hold a mem state of the same layout,
+// only the vram/dram pages written since the last snapshot or restore
+// (and ram pages that differ) are copied
+int PicoStateSnapSave(void *buf, size_t size)
+{
+  return state_save_mem(buf, size, MSTATE_SAVE | MSTATE_DIRTY);
+}
+
+void PicoStateSnapLoad(const void *buf)
+{
+  state_mem((void *)buf, MSTATE_LOAD | MSTATE_DIRTY);
+
+  if (PicoLoadStateHook != NULL)
+    PicoLoadStateHook();
+  Pico.m.dirtyPal = 1;
+}
+
 int PicoStateLoadGfx(const char *fname)
 {
   void *afile;
@@ -726,6 +1018,7 @@ int PicoStateLoadGfx(const char *fname)
   if (afile == NULL)
     return -1;
 
+  PicoDrawMtFrameEnd();
   ret = state_load_gfx(afile);
   if (ret != 0) {
     // assume legacy
@@ -738,6 +1031,7 @@ int PicoStateLoadGfx(const char *fname)
     areaRead(&Pico.video, 1, sizeof(Pico.video), afile);
   }
   areaClose(afile);
+  PicoDirtyAll();
   return 0;
 }
 
@@ -788,6 +1082,8 @@ void PicoTmpStateRestore(void *data)
   if (t == NULL)
     return;
 
+  PicoDrawMtFrameEnd();
+
   memcpy(Pico.vram, t->vram, sizeof(Pico.vram));
   memcpy(Pico.cram, t->cram, sizeof(Pico.cram));
   memcpy(Pico.vsram, t->vsram, sizeof(Pico.vsram));
@@ -802,6 +1098,7 @@ void PicoTmpStateRestore(void *data)
     Pico32x.dirty_pal = 1;
   }
 #endif
+  PicoDirtyAll();
 }
 
 // vim:shiftwidth=2:ts=2:expandtab
@@ -34,13 +34,25 @@ static void VideoWrite(u16 d)
   switch (Pico.video.type)
   {
     case 1: if(a&1) d=(u16)((d<<8)|(d>>8)); // If address is odd, bytes are swapped (which game needs this?)
+            if (Pico.vram [(a>>1)&0x7fff] != d) PicoDisplayDirty = 1;
             Pico.vram [(a>>1)&0x7fff]=d;
-            if (a - ((unsigned)(Pico.video.reg[5]&0x7f) << 9) < 0x400)
+            PicoDirtyVram(a);
+            if (PicoDrawThreaded)
+              PicoDrawMtWrite(DMT_VRAM, a, d);
+            else if (a - ((unsigned)(Pico.video.reg[5]&0x7f) << 9) < 0x400)
               rendstatus |= PDRAW_DIRTY_SPRITES;
             break;
     case 3: Pico.m.dirtyPal = 1;
-            Pico.cram [(a>>1)&0x003f]=d; break; // wraps (Desert Strike)
-    case 5: Pico.vsram[(a>>1)&0x003f]=d; break;
+            if (Pico.cram [(a>>1)&0x003f] != d) PicoDisplayDirty = 1;
+            Pico.cram [(a>>1)&0x003f]=d; // wraps (Desert Strike)
+            if (PicoDrawThreaded)
+              PicoDrawMtWrite(DMT_CRAM, a, d);
+            break;
+    case 5: if (Pico.vsram[(a>>1)&0x003f] != d) PicoDisplayDirty = 1;
+            Pico.vsram[(a>>1)&0x003f]=d;
+            if (PicoDrawThreaded)
+              PicoDrawMtWrite(DMT_VSRAM, a, d);
+            break;
     //default:elprintf(EL_ANOMALY, "VDP write %04x with bad type %i", d, Pico.video.type); break;
   }
 
@@ -157,22 +169,30 @@ static void DmaSlow(int len)
       {
         // most used DMA mode
         memcpy16(r + (a>>1), pd, len);
+        PicoDirtyVramRange(a, len*2);
         a += len*2;
+        if (PicoDrawThreaded)
+          PicoDrawMtBlock(DMT_VRAM, Pico.video.addr, len*2, PDRAW_DIRTY_SPRITES);
       }
       else
       {
+        int span = len ? (len-1)*inc+2 : 0;
         for(; len; len--)
         {
           d=*pd++;
           if(a&1) d=(d<<8)|(d>>8);
           r[a>>1] = (u16)d; // will drop the upper bits
+          PicoDirtyVram(a);
           // AutoIncrement
           a=(u16)(a+inc);
           // didn't src overlap?
           //if(pd >= pdend) pd-=0x8000; // should be good for RAM, bad for ROM
         }
+        if (PicoDrawThreaded)
+          PicoDrawMtBlock(DMT_VRAM, Pico.video.addr, span, PDRAW_DIRTY_SPRITES);
       }
-      rendstatus |= PDRAW_DIRTY_SPRITES;
+      if (!PicoDrawThreaded)
+        rendstatus |= PDRAW_DIRTY_SPRITES;
       break;
 
     case 3: // cram
@@ -189,6 +209,8 @@ static void DmaSlow(int len)
         if(a2 >= 0x80) break; // Todds Adventures in Slime World / Andre Agassi tennis
       }
       a=(a&0xff00)|a2;
+      if (PicoDrawThreaded)
+        PicoDrawMtBlock(DMT_CRAM, 0, 0x80, 0);
       break;
 
     case 5: // vsram[a&0x003f]=d;
@@ -204,6 +226,8 @@ static void DmaSlow(int len)
         if(a2 >= 0x80) break;
       }
       a=(a&0xff00)|a2;
+      if (PicoDrawThreaded)
+        PicoDrawMtBlock(DMT_VSRAM, 0, 0x80, 0);
       break;
 
     default:
@@ -221,7 +245,7 @@ static void DmaCopy(int len)
   unsigned char *vr = (unsigned char *) Pico.vram;
   unsigned char *vrs;
   unsigned char inc=Pico.video.reg[0xf];
-  int source;
+  int source, span = 0;
   elprintf(EL_VDPDMA, "DmaCopy len %i [%i]", len, SekCyclesDone());
 
   Pico.m.dma_xfers += len;
@@ -233,22 +257,29 @@ static void DmaCopy(int len)
 
   if (source+len > 0x10000) len=0x10000-source; // clip??
 
+  if (PicoDrawThreaded && len > 0)
+    span = (len-1)*inc+1;
+
   for (; len; len--)
   {
     vr[a] = *vrs++;
+    PicoDirtyVram(a);
     // AutoIncrement
     a=(u16)(a+inc);
   }
+  if (PicoDrawThreaded)
+    PicoDrawMtBlock(DMT_VRAM, Pico.video.addr, span, PDRAW_DIRTY_SPRITES);
+  else
+    rendstatus |= PDRAW_DIRTY_SPRITES;
   // remember addr
   Pico.video.addr=a;
-  rendstatus |= PDRAW_DIRTY_SPRITES;
 }
 
 // check: Contra, Megaman
 // note: this is still inaccurate
 static void DmaFill(int data)
 {
-  int len;
+  int len, span;
   unsigned short a=Pico.video.addr;
   unsigned char *vr=(unsigned char *) Pico.vram;
   unsigned char high = (unsigned char) (data >> 8);
@@ -259,28 +290,34 @@ static void DmaFill(int data)
 
   Pico.m.dma_xfers += len;
   Pico.video.status |= 2; // dma busy
+  PicoDisplayDirty = 1;
 
   // from Charles MacDonald's genvdp.txt:
   // Write lower byte to address specified
   vr[a] = (unsigned char) data;
+  PicoDirtyVram(a);
   a=(u16)(a+inc);
 
   if (!inc) len=1;
+  span = len*inc+1;
 
   for (; len; len--) {
     // Write upper byte to adjacent address
     // (here we are byteswapped, so address is already 'adjacent')
     vr[a] = high;
+    PicoDirtyVram(a);
 
     // Increment address register
     a=(u16)(a+inc);
   }
+  if (PicoDrawThreaded)
+    PicoDrawMtBlock(DMT_VRAM, Pico.video.addr, span, PDRAW_DIRTY_SPRITES);
+  else
+    rendstatus |= PDRAW_DIRTY_SPRITES;
   // remember addr
   Pico.video.addr=a;
   // update length
   Pico.video.reg[0x13] = Pico.video.reg[0x14] = 0; // Dino Dini's Soccer (E) (by Haze)
-
-  rendstatus |= PDRAW_DIRTY_SPRITES;
 }
 
 static void CommandDma(void)
@@ -291,6 +328,7 @@ static void CommandDma(void)
   if ((pvid->reg[1]&0x10)==0) return; // DMA not enabled
 
   len=GetDmaLength();
+  PicoDisplayDirty = 1;
 
   method=pvid->reg[0x17]>>6;
   if (method< 2) DmaSlow(len); // 68000 to VDP
@@ -319,9 +357,11 @@ static void CommandChange(void)
 static void DrawSync(int blank_on)
 {
   if (Pico.m.scanline < 224 && !(PicoOpt & POPT_ALT_RENDERER) &&
-      !PicoSkipFrame && DrawScanline <= Pico.m.scanline) {
+      !PicoSkipFrame && (PicoDrawThreaded || DrawScanline <= Pico.m.scanline)) {
     //elprintf(EL_ANOMALY, "sync");
+    pprof_start(m68k);
     PicoDrawSync(Pico.m.scanline, blank_on);
+    pprof_end_sub(m68k);
   }
 }
 
@@ -399,7 +439,11 @@ PICO_INTERNAL_ASM void PicoVideoWrite(unsigned int a,unsigned short d)
         if (num == 1 && !(d&0x40) && SekCyclesDone() - line_base_cycles <= 488-390)
           blank_on = 1;
         DrawSync(blank_on);
+        if ((unsigned char)d != dold)
+          PicoDisplayDirty = 1;
         pvid->reg[num]=(unsigned char)d;
+        if (PicoDrawThreaded)
+          PicoDrawMtWrite(DMT_REG, num, (unsigned char)d);
         switch (num)
         {
           case 0x00:
@@ -412,7 +456,7 @@ PICO_INTERNAL_ASM void PicoVideoWrite(unsigned int a,unsigned short d)
             goto update_irq;
           case 0x05:
             //elprintf(EL_STATUS, "spritep moved to %04x", (unsigned)(Pico.video.reg[5]&0x7f) << 9);
-            if (d^dold) rendstatus |= PDRAW_SPRITES_MOVED;
+            if ((d^dold) && !PicoDrawThreaded) rendstatus |= PDRAW_SPRITES_MOVED;
             break;
           case 0x0c:
             // renderers should update their palettes if sh/hi mode is changed
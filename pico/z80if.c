@@ -71,6 +71,7 @@ void z80_init(void)
 #ifdef _USE_CZ80
   memset(&CZ80, 0, sizeof(CZ80));
   Cz80_Init(&CZ80);
+  cz80_drc_init();
   Cz80_Set_ReadB(&CZ80, NULL); // unused (hacked in)
   Cz80_Set_WriteB(&CZ80, NULL);
 #endif
@@ -274,6 +275,118 @@ fail:
   return -1;
 }
 
+#if defined(_USE_DRZ80) || defined(_USE_CZ80)
+
+#if defined(_USE_DRZ80)
+#define z80_af() ((drZ80.Z80A & 0xff000000) | (drZ80.Z80F & 0xff))
+#else
+#define z80_af() CZ80.AF.W
+#endif
+
+#define Z80_PROBE_CYCLES 64
+
+static u8 *z80_idle_ptr(u32 a)
+{
+  uptr v = z80_read_map[a >> Z80_MEM_SHIFT];
+  if (map_flag_set(v))
+    return NULL;
+  return (u8 *)(v << 1) + a;
+}
+
+// returns loop start + 1 if pc is in a polling loop like
+//   ld a,(nn) / in a,(vdp); or a|and a|and n|cp n|bit b,a; jr|jp cc,loop
+// or in "jr $" or "jp $", else 0
+static u32 z80_idle_loop(void)
+{
+  u32 pc = z80_pc() & 0xffff;
+  u32 l, j, n, len[3];
+  u8 *p;
+
+  // keep the loop within one bank
+  if ((pc & 0x1fff) > 0x1fff - 8)
+    return 0;
+  if ((p = z80_idle_ptr(pc)) == NULL)
+    return 0;
+  if ((p[0] == 0x18 && p[1] == 0xfe) || (p[0] == 0xc3 && (p[1] | p[2] << 8) == pc))
+    return pc + 1;
+
+  for (l = pc; l + 8 > pc && (l & 0x1fff) != 0x1fff; l--) {
+    p = z80_idle_ptr(l) - l;  // index by address from here
+    if (p[l] == 0x3a) {
+      // only memory which can't change in this run
+      if (z80_idle_ptr(p[l+1] | p[l+2] << 8) == NULL)
+        continue;
+      len[0] = 3;
+    }
+    else if (p[l] == 0xdb && (PicoAHW & PAHW_SMS)) {
+      // vdp status or v counter
+      if ((p[l+1] & 0xc1) != 0x81 && (p[l+1] & 0xc1) != 0x40)
+        continue;
+      len[0] = 2;
+    }
+    else
+      continue;
+
+    j = l + len[0];
+    if (p[j] == 0xb7 || p[j] == 0xa7)
+      len[1] = 1;
+    else if (p[j] == 0xe6 || p[j] == 0xfe)
+      len[1] = 2;
+    else if (p[j] == 0xcb && (p[j+1] & 0xc7) == 0x47)
+      len[1] = 2;
+    else
+      continue;
+
+    j += len[1];
+    if ((p[j] & 0xe7) == 0x20 && j + 2 + (signed char)p[j+1] == l)
+      len[2] = 2;
+    else if ((p[j] & 0xe7) == 0xc2 && (p[j+1] | p[j+2] << 8) == l)
+      len[2] = 3;
+    else
+      continue;
+
+    // pc must be on one of the loop's instructions
+    for (n = 0, j = l; n < 3 && j != pc; j += len[n++])
+      ;
+    if (n < 3)
+      return l + 1;
+  }
+  return 0;
+}
+
+// z80_run() which drops the rest of the run if the z80 is found
+// spinning in a loop polling something that can't change in this run
+int z80_run_idle(int cycles)
+{
+  u32 loop, af;
+  int done;
+
+  if (!(idleprobe_cpus & IDLE_Z80) || cycles < Z80_PROBE_CYCLES * 3
+      || !SekIsIdleReady() || (loop = z80_idle_loop()) == 0)
+    return z80_run(cycles);
+
+  // the first time around the loop loads what it polls
+  done = z80_run(Z80_PROBE_CYCLES);
+  if (z80_idle_loop() != loop)
+    return done + z80_run(cycles - done);
+  af = z80_af();
+  done += z80_run(Z80_PROBE_CYCLES);
+  if (z80_idle_loop() != loop || z80_af() != af)
+    return done + z80_run(cycles - done);
+
+  elprintf(EL_IDLE, "idle: z skip @%04x, %d", loop - 1, cycles);
+  return cycles;
+}
+
+#else
+
+int z80_run_idle(int cycles)
+{
+  return z80_run(cycles);
+}
+
+#endif
+
 void z80_exit(void)
 {
 }
@@ -41,6 +41,10 @@ ifeq "$(pprof)" "1"
 DEFINES += PPROF
 SRCS_COMMON += $(R)platform/linux/pprof.c
 endif
+ifeq "$(bench)" "1"
+# counters for picodrive_bench, which has its own storage for them
+DEFINES += PPROF
+endif
 
 # ARM asm stuff
 ifeq "$(ARCH)" "arm"
@@ -74,6 +78,7 @@ DEFINES += _ASM_32X_DRAW
 SRCS_COMMON += $(R)pico/32x/draw_arm.s
 endif
 ifeq "$(asm_mix)" "1"
+DEFINES += _ASM_MIX_C
 SRCS_COMMON += $(R)pico/sound/mix_arm.s
 endif
 endif # ARCH=arm
@@ -82,9 +87,10 @@ endif # ARCH=arm
 # Pico
 SRCS_COMMON += $(R)pico/pico.c $(R)pico/cart.c $(R)pico/memory.c \
 	$(R)pico/state.c $(R)pico/sek.c $(R)pico/z80if.c \
-	$(R)pico/videoport.c $(R)pico/draw2.c $(R)pico/draw.c \
+	$(R)pico/videoport.c $(R)pico/draw2.c $(R)pico/draw.c $(R)pico/draw_mt.c \
 	$(R)pico/mode4.c $(R)pico/misc.c $(R)pico/eeprom.c \
-	$(R)pico/patch.c $(R)pico/debug.c $(R)pico/media.c
+	$(R)pico/patch.c $(R)pico/debug.c $(R)pico/media.c \
+	$(R)pico/context.c $(R)pico/rewind.c $(R)pico/runahead.c
 # SMS
 ifneq "$(no_sms)" "1"
 SRCS_COMMON += $(R)pico/sms.c
@@ -95,7 +101,7 @@ endif
 SRCS_COMMON += $(R)pico/cd/mcd.c $(R)pico/cd/memory.c $(R)pico/cd/sek.c \
 	$(R)pico/cd/cdc.c $(R)pico/cd/cdd.c $(R)pico/cd/cd_image.c \
 	$(R)pico/cd/cue.c $(R)pico/cd/gfx.c $(R)pico/cd/gfx_dma.c \
-	$(R)pico/cd/misc.c $(R)pico/cd/pcm.c
+	$(R)pico/cd/misc.c $(R)pico/cd/pcm.c $(R)pico/cd/readahead.c
 # 32X
 ifneq "$(no_32x)" "1"
 SRCS_COMMON += $(R)pico/32x/32x.c $(R)pico/32x/memory.c $(R)pico/32x/draw.c \
@@ -112,15 +118,18 @@ SRCS_COMMON += $(R)pico/carthw/svp/svp.c $(R)pico/carthw/svp/memory.c \
 	$(R)pico/carthw/svp/ssp16.c
 ifeq "$(use_svpdrc)" "1"
 DEFINES += _SVP_DRC
+ifeq "$(ARCH)" "arm"
 SRCS_COMMON += $(R)pico/carthw/svp/stub_arm.S
 SRCS_COMMON += $(R)pico/carthw/svp/compiler.c
+else
+SRCS_COMMON += $(R)pico/carthw/svp/compiler_x86.c
+endif
 endif
 # sound
 SRCS_COMMON += $(R)pico/sound/sound.c
 SRCS_COMMON += $(R)pico/sound/sn76496.c $(R)pico/sound/ym2612.c
-ifneq "$(ARCH)$(asm_mix)" "arm1"
 SRCS_COMMON += $(R)pico/sound/mix.c
-endif
+SRCS_COMMON += $(R)pico/sound/resampler.c
 
 # === CPU cores ===
 # --- M68k ---
@@ -137,6 +146,10 @@ endif
 ifeq "$(use_fame)" "1"
 DEFINES += EMU_F68K
 SRCS_COMMON += $(R)cpu/fame/famec.c
+ifeq "$(use_m68kdrc)" "1"
+DEFINES += DRC_M68K
+SRCS_COMMON += $(R)cpu/fame/famec_ops.c $(R)cpu/fame/compiler.c
+endif
 endif
 
 # --- Z80 ---
@@ -148,6 +161,10 @@ endif
 ifeq "$(use_cz80)" "1"
 DEFINES += _USE_CZ80
 SRCS_COMMON += $(R)cpu/cz80/cz80.c
+ifeq "$(use_z80drc)" "1"
+DEFINES += DRC_Z80
+SRCS_COMMON += $(R)cpu/cz80/cz80_ops.c $(R)cpu/cz80/compiler.c
+endif
 endif
 
 # --- SH2 ---
@@ -29,7 +29,7 @@
 static const char *rom_exts[] = {
 	"zip",
 	"bin", "smd", "gen", "md",
-	"iso", "cso", "cue",
+	"iso", "cso", "cue", "hcd",
 	"32x",
 	"sms",
 	NULL
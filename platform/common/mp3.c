@@ -158,7 +158,7 @@ void mp3_start_play(void *f_, int pos1024)
 void mp3_update(int *buffer, int length, int stereo)
 {
 	int length_mp3, shr = 0;
-	void (*mix_samples)(int *dest_buf, short *mp3_buf, int count) = mix_16h_to_32;
+	void (*mix_samples)(int *dest_buf, short *mp3_buf, int count) = mix_16h_to_32_v;
 
 	if (mp3_current_file == NULL || mp3_file_pos >= mp3_file_len)
 		return; /* no file / EOF */
@@ -168,11 +168,11 @@ void mp3_update(int *buffer, int length, int stereo)
 
 	length_mp3 = length;
 	if (PsndRate <= 11025 + 100) {
-		mix_samples = mix_16h_to_32_s2;
+		mix_samples = mix_16h_to_32_s2_v;
 		length_mp3 <<= 2; shr = 2;
 	}
 	else if (PsndRate <= 22050 + 100) {
-		mix_samples = mix_16h_to_32_s1;
+		mix_samples = mix_16h_to_32_s1_v;
 		length_mp3 <<= 1; shr = 1;
 	}
 
@@ -12,6 +12,7 @@
 #include <string.h>
 #ifndef _WIN32
 #include <sys/mman.h>
+#include <sys/stat.h>
 #else
 #include <io.h>
 #include <windows.h>
@@ -38,10 +39,15 @@ static FILE *emu_log;
 
 #define VOUT_MAX_WIDTH 320
 #define VOUT_MAX_HEIGHT 240
-static void *vout_buf;
+static void *vout_buf, *vout_buf2; // 2nd for the draw thread
+static void *vout_shown;
 static int vout_width, vout_height, vout_offset;
+static int vout_bpp = 2, vout_want_8888;
+static bool vout_can_dupe;
+static int runahead_frames;
+static unsigned int rewind_size;
 
-static short __attribute__((aligned(4))) sndBuffer[2*44100/50];
+static short __attribute__((aligned(4))) sndBuffer[2*(44100/50 + PSND_OUT_SLACK)];
 
 static void snd_write(int len);
 
@@ -248,9 +254,10 @@ int plat_mem_set_exec(void *ptr, size_t size)
 
 void emu_video_mode_change(int start_line, int line_count, int is_32cols)
 {
-	memset(vout_buf, 0, 320 * 240 * 2);
+	memset(vout_buf, 0, 320 * 240 * vout_bpp);
+	memset(vout_buf2, 0, 320 * 240 * vout_bpp);
 	vout_width = is_32cols ? 256 : 320;
-	PicoDrawSetOutBuf(vout_buf, vout_width * 2);
+	PicoDrawSetOutBuf(vout_buf, vout_width * vout_bpp);
 
 	vout_height = line_count;
 	vout_offset = vout_width * start_line;
@@ -297,8 +304,21 @@ void retro_set_environment(retro_environment_t cb)
 		{ "picodrive_input2", "Input device 2; 3 button pad|6 button pad|None" },
 		{ "picodrive_sprlim", "No sprite limit; disabled|enabled" },
 		{ "picodrive_ramcart", "MegaCD RAM cart; disabled|enabled" },
+		{ "picodrive_drawthread", "Render on separate thread (1 frame delay); disabled|enabled" },
+		{ "picodrive_sndthread", "Sound synthesis on separate thread; disabled|enabled" },
+		{ "picodrive_sndnative", "Synthesize at native FM rate and resample; disabled|enabled" },
+		{ "picodrive_runahead", "Run-ahead frames; disabled|1|2|3|4" },
+		{ "picodrive_rewind", "Rewind history, hold L2 (MB); disabled|16|64|256" },
+		{ "picodrive_reuse", "Skip drawing unchanged frames; disabled|enabled" },
+		{ "picodrive_romcache", "Share ROMs between instances; disabled|enabled" },
+		{ "picodrive_cdreadahead", "CD image reads on separate thread; disabled|enabled" },
+		{ "picodrive_pixfmt", "Output pixel format (restart); rgb565|xrgb8888" },
 #ifdef DRC_SH2
 		{ "picodrive_drc", "Dynamic recompilers; enabled|disabled" },
+		{ "picodrive_drccache", "Keep 32X SH2 block list on disk; disabled|enabled" },
+#endif
+#ifdef DRC_M68K
+		{ "picodrive_m68kdrc", "68k recompiler (experimental); disabled|enabled" },
 #endif
 		{ NULL, NULL },
 	};
@@ -328,7 +348,7 @@ void retro_get_system_info(struct retro_system_info *info)
 	memset(info, 0, sizeof(*info));
 	info->library_name = "PicoDrive";
 	info->library_version = VERSION;
-	info->valid_extensions = "bin|gen|smd|md|32x|cue|iso|sms";
+	info->valid_extensions = "bin|gen|smd|md|32x|cue|iso|hcd|sms";
 	info->need_fullpath = true;
 }
 
@@ -347,7 +367,6 @@ void retro_get_system_av_info(struct retro_system_av_info *info)
 /* savestates */
 struct savestate_state {
 	const char *load_buf;
-	char *save_buf;
 	size_t size;
 	size_t pos;
 };
@@ -370,33 +389,6 @@ size_t state_read(void *p, size_t size, size_t nmemb, void *file)
 	return bsize;
 }
 
-size_t state_write(void *p, size_t size, size_t nmemb, void *file)
-{
-	struct savestate_state *state = file;
-	size_t bsize = size * nmemb;
-
-	if (state->pos + bsize > state->size) {
-		lprintf("savestate error: %u/%u\n",
-			state->pos + bsize, state->size);
-		bsize = state->size - state->pos;
-		if ((int)bsize <= 0)
-			return 0;
-	}
-
-	memcpy(state->save_buf + state->pos, p, bsize);
-	state->pos += bsize;
-	return bsize;
-}
-
-size_t state_skip(void *p, size_t size, size_t nmemb, void *file)
-{
-	struct savestate_state *state = file;
-	size_t bsize = size * nmemb;
-
-	state->pos += bsize;
-	return bsize;
-}
-
 size_t state_eof(void *file)
 {
 	struct savestate_state *state = file;
@@ -422,32 +414,16 @@ int state_fseek(void *file, long offset, int whence)
 	return (int)state->pos;
 }
 
-/* savestate sizes vary wildly depending if cd/32x or
- * carthw is active, so run the whole thing to get size */
+/* fixed layout for the frequent in-memory saves
+ * (rewind, run-ahead, netplay), size depends on cd/32x/carthw */
 size_t retro_serialize_size(void) 
 { 
-	struct savestate_state state = { 0, };
-	int ret;
-
-	ret = PicoStateFP(&state, 1, NULL, state_skip, NULL, state_fseek);
-	if (ret != 0)
-		return 0;
-
-	return state.pos;
+	return PicoStateSize();
 }
 
 bool retro_serialize(void *data, size_t size)
 { 
-	struct savestate_state state = { 0, };
-	int ret;
-
-	state.save_buf = data;
-	state.size = size;
-	state.pos = 0;
-
-	ret = PicoStateFP(&state, 1, NULL, state_write,
-		NULL, state_fseek);
-	return ret == 0;
+	return PicoStateSaveMem(data, size) == 0;
 }
 
 bool retro_unserialize(const void *data, size_t size)
@@ -455,6 +431,10 @@ bool retro_unserialize(const void *data, size_t size)
 	struct savestate_state state = { 0, };
 	int ret;
 
+	if (PicoStateLoadMem(data, size) == 0)
+		return true;
+
+	/* states from older versions are chunked */
 	state.load_buf = data;
 	state.size = size;
 	state.pos = 0;
@@ -658,6 +638,7 @@ bool retro_load_game(const struct retro_game_info *info)
 {
 	enum media_type_e media_type;
 	static char carthw_path[256];
+	char cache_dir[256];
 	size_t i;
 
 	enum retro_pixel_format fmt = RETRO_PIXEL_FORMAT_RGB565;
@@ -683,6 +664,8 @@ bool retro_load_game(const struct retro_game_info *info)
 	disks[0].fname = strdup(info->path);
 
 	make_system_path(carthw_path, sizeof(carthw_path), "carthw", ".cfg");
+	make_system_path(cache_dir, sizeof(cache_dir), "", "");
+	Pico32xSetCacheDir(cache_dir);
 
 	media_type = PicoLoadMedia(info->path, carthw_path,
 			find_bios, NULL);
@@ -704,6 +687,19 @@ bool retro_load_game(const struct retro_game_info *info)
 		break;
 	}
 
+	vout_bpp = 2;
+	if (vout_want_8888) {
+		fmt = RETRO_PIXEL_FORMAT_XRGB8888;
+		if (environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &fmt))
+			vout_bpp = 4;
+		else {
+			fmt = RETRO_PIXEL_FORMAT_RGB565;
+			environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &fmt);
+		}
+	}
+	PicoDrawSetOutFormat(vout_bpp == 4 ? PDF_XRGB8888 : PDF_RGB555, 0);
+	PicoDrawSetOutBuf(vout_buf, vout_width * vout_bpp);
+
 	PicoLoopPrepare();
 
 	PicoWriteSound = snd_write;
@@ -833,6 +829,93 @@ static void update_variables(void)
 			PicoOpt &= ~POPT_EN_MCD_RAMCART;
 	}
 
+	var.value = NULL;
+	var.key = "picodrive_drawthread";
+	if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+		if (strcmp(var.value, "enabled") == 0)
+			PicoOpt |= POPT_EN_DRAW_THREAD;
+		else
+			PicoOpt &= ~POPT_EN_DRAW_THREAD;
+	}
+
+	var.value = NULL;
+	var.key = "picodrive_sndthread";
+	if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+		if (strcmp(var.value, "enabled") == 0)
+			PicoOpt |= POPT_EN_SND_THREAD;
+		else
+			PicoOpt &= ~POPT_EN_SND_THREAD;
+	}
+
+	var.value = NULL;
+	var.key = "picodrive_sndnative";
+	if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+		int old_opt = PicoOpt;
+		if (strcmp(var.value, "enabled") == 0)
+			PicoOpt |= POPT_EN_SND_NATIVE;
+		else
+			PicoOpt &= ~POPT_EN_SND_NATIVE;
+		if ((old_opt ^ PicoOpt) & POPT_EN_SND_NATIVE && PsndOut != NULL)
+			PsndRerate(1);
+	}
+
+	var.value = NULL;
+	var.key = "picodrive_romcache";
+	if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+		static char cache_dir[256];
+		PicoCartCacheDir = NULL;
+		if (strcmp(var.value, "enabled") == 0) {
+			make_system_path(cache_dir, sizeof(cache_dir), "picodrive_roms", "");
+#ifndef _WIN32
+			mkdir(cache_dir, 0755);
+#endif
+			PicoCartCacheDir = cache_dir;
+		}
+	}
+
+	var.value = NULL;
+	var.key = "picodrive_cdreadahead";
+	if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+		// takes effect with the next disc
+		if (strcmp(var.value, "enabled") == 0)
+			PicoOpt |= POPT_EN_CD_READAHEAD;
+		else
+			PicoOpt &= ~POPT_EN_CD_READAHEAD;
+	}
+
+	var.value = NULL;
+	var.key = "picodrive_runahead";
+	if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+		runahead_frames = atoi(var.value);
+
+	var.value = NULL;
+	var.key = "picodrive_rewind";
+	if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+		// changing the size drops the history
+		unsigned int size = (unsigned int)atoi(var.value) << 20;
+		if (size != rewind_size) {
+			if (size == 0 || PicoRewindInit(size, 1) != 0) {
+				PicoRewindFinish();
+				size = 0;
+			}
+			rewind_size = size;
+		}
+	}
+
+	var.value = NULL;
+	var.key = "picodrive_reuse";
+	if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+		if (strcmp(var.value, "enabled") == 0)
+			PicoOpt |= POPT_EN_FRAME_REUSE;
+		else
+			PicoOpt &= ~POPT_EN_FRAME_REUSE;
+	}
+
+	var.value = NULL;
+	var.key = "picodrive_pixfmt";
+	if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+		vout_want_8888 = strcmp(var.value, "xrgb8888") == 0;
+
 #ifdef DRC_SH2
 	var.value = NULL;
 	var.key = "picodrive_drc";
@@ -842,6 +925,27 @@ static void update_variables(void)
 		else
 			PicoOpt &= ~POPT_EN_DRC;
 	}
+
+	var.value = NULL;
+	var.key = "picodrive_drccache";
+	if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+		// takes effect with the next 32X game
+		if (strcmp(var.value, "enabled") == 0)
+			PicoOpt |= POPT_EN_DRC_CACHE;
+		else
+			PicoOpt &= ~POPT_EN_DRC_CACHE;
+	}
+#endif
+
+#ifdef DRC_M68K
+	var.value = NULL;
+	var.key = "picodrive_m68kdrc";
+	if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+		if (strcmp(var.value, "enabled") == 0)
+			PicoOpt |= POPT_EN_DRC_M68K;
+		else
+			PicoOpt &= ~POPT_EN_DRC_M68K;
+	}
 #endif
 }
 
@@ -849,6 +953,7 @@ void retro_run(void)
 {
 	bool updated = false;
 	int pad, i;
+	void *buf;
 
 	if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE, &updated) && updated)
 		update_variables();
@@ -861,10 +966,29 @@ void retro_run(void)
 			if (input_state_cb(pad, RETRO_DEVICE_JOYPAD, 0, i))
 				PicoPad[pad] |= retro_pico_map[i];
 
-	PicoFrame();
+	if (rewind_size && input_state_cb(0, RETRO_DEVICE_JOYPAD, 0,
+			RETRO_DEVICE_ID_JOYPAD_L2)) {
+		// show the restored frame, its successor is recaptured on release;
+		// at the oldest state the last frame is shown again
+		if (PicoRewindStep() == 0)
+			PicoFrame();
+	}
+	else {
+		if (runahead_frames > 0)
+			PicoFrameRunAhead(runahead_frames);
+		else
+			PicoFrame();
+		PicoRewindCapture();
+	}
 
-	video_cb((short *)vout_buf + vout_offset,
-		vout_width, vout_height, vout_width * 2);
+	// with the draw thread this is the frame before, in either buffer
+	buf = PicoDrawLastFrame();
+	if (PicoFrameUnchanged && vout_can_dupe && buf == vout_shown)
+		video_cb(NULL, vout_width, vout_height, vout_width * vout_bpp);
+	else
+		video_cb((char *)buf + vout_offset * vout_bpp,
+			vout_width, vout_height, vout_width * vout_bpp);
+	vout_shown = buf;
 }
 
 void retro_init(void)
@@ -884,11 +1008,14 @@ void retro_init(void)
 
 	environ_cb(RETRO_ENVIRONMENT_SET_DISK_CONTROL_INTERFACE, &disk_control);
 
+	if (!environ_cb(RETRO_ENVIRONMENT_GET_CAN_DUPE, &vout_can_dupe))
+		vout_can_dupe = false;
+
 	PicoOpt = POPT_EN_STEREO|POPT_EN_FM|POPT_EN_PSG|POPT_EN_Z80
 		| POPT_EN_MCD_PCM|POPT_EN_MCD_CDDA|POPT_EN_MCD_GFX
 		| POPT_EN_32X|POPT_EN_PWM
 		| POPT_ACC_SPRITES|POPT_DIS_32C_BORDER;
-#ifdef __arm__
+#if defined(__arm__) || defined(__x86_64__)
 	PicoOpt |= POPT_EN_DRC;
 #endif
 	PsndRate = 44100;
@@ -896,11 +1023,13 @@ void retro_init(void)
 
 	vout_width = 320;
 	vout_height = 240;
-	vout_buf = malloc(VOUT_MAX_WIDTH * VOUT_MAX_HEIGHT * 2);
+	vout_buf = malloc(VOUT_MAX_WIDTH * VOUT_MAX_HEIGHT * 4);
+	vout_buf2 = malloc(VOUT_MAX_WIDTH * VOUT_MAX_HEIGHT * 4);
 
 	PicoInit();
 	PicoDrawSetOutFormat(PDF_RGB555, 0);
 	PicoDrawSetOutBuf(vout_buf, vout_width * 2);
+	PicoDrawSetOutBuf2(vout_buf2);
 
 	//PicoMessage = plat_status_msg_busy_next;
 	PicoMCDopenTray = disk_tray_open;
@@ -912,4 +1041,5 @@ void retro_init(void)
 void retro_deinit(void)
 {
 	PicoExit();
+	rewind_size = 0;
 }
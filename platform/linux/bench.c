@@ -0,0 +1,392 @@
+/*
+ * headless benchmark for PicoDrive
+ * (C) agent, 2026
+ *
+ * This work is licensed under the terms of MAME license.
+ * See COPYING file in the top-level directory.
+ *
+ * Drives the libretro core without a frontend: loads a ROM or CD image,
+ * runs a fixed number of frames with optional scripted input and prints
+ * frames/sec and the pprof counters as JSON.
+ * build: make -f Makefile.libretro bench=1 picodrive_bench
+ *
+ * input log: one "<frame> <pad1> [pad2]" line per change, pads in
+ * PicoPad format (MXYZ SACB RLDU, hex), held until the next line.
+ * 0x1000 in pad1 holds L2, rewind with picodrive_rewind.
+ *
+ * digest: one "<frame> <ram> <vram> <zram> <sdram> <dram> <video> <audio>"
+ * line per frame with hashes of the emulated memory, for comparing runs
+ * like the recompilers against the interpreters (tools/drccmp.sh). With
+ * the SVP, sdram and dram are its DRAM and the SSP1601 internal RAM.
+ * video and audio hash all the output so far.
+ *
+ * -c runs a second image in another emulator instance (pico/context.c),
+ * switching instances every frame. The first one's digest must be the
+ * same as without -c, see tools/ctxcmp.sh.
+ */
+
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <pico/pico_int.h>
+#include "../common/input_pico.h"
+#include "../libretro.h"
+
+static struct pp_counters counters;
+struct pp_counters *pp_counters = &counters;
+
+#define IT(n) { pp_##n, #n }
+static const struct {
+	enum pprof_points pp;
+	const char *name;
+} pp_tab[] = {
+	IT(frame),
+	IT(m68k),
+	IT(z80),
+	IT(msh2),
+	IT(ssh2),
+	IT(draw),
+	IT(sound),
+	IT(rewind),
+};
+
+static const unsigned char retro_to_gbtn[] = {
+	[RETRO_DEVICE_ID_JOYPAD_B]	= GBTN_B,
+	[RETRO_DEVICE_ID_JOYPAD_Y]	= GBTN_A,
+	[RETRO_DEVICE_ID_JOYPAD_SELECT]	= GBTN_MODE,
+	[RETRO_DEVICE_ID_JOYPAD_START]	= GBTN_START,
+	[RETRO_DEVICE_ID_JOYPAD_UP]	= GBTN_UP,
+	[RETRO_DEVICE_ID_JOYPAD_DOWN]	= GBTN_DOWN,
+	[RETRO_DEVICE_ID_JOYPAD_LEFT]	= GBTN_LEFT,
+	[RETRO_DEVICE_ID_JOYPAD_RIGHT]	= GBTN_RIGHT,
+	[RETRO_DEVICE_ID_JOYPAD_A]	= GBTN_C,
+	[RETRO_DEVICE_ID_JOYPAD_X]	= GBTN_Y,
+	[RETRO_DEVICE_ID_JOYPAD_L]	= GBTN_X,
+	[RETRO_DEVICE_ID_JOYPAD_R]	= GBTN_Z,
+};
+
+#define MAX_OPTS 16
+static struct retro_variable opts[MAX_OPTS];
+static int opt_count;
+static const char *system_dir = ".";
+
+static FILE *input_log;
+static FILE *digest;
+static int input_next = -1;
+static unsigned int input_next_pad[2], input_pad[2];
+
+static unsigned int video_hash = 2166136261u, audio_hash = 2166136261u;
+static int video_bpp = 2;
+
+static PicoContext *ctx[2];
+
+static unsigned int hash(unsigned int h, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	while (len--)
+		h = (h ^ *p++) * 16777619u;
+	return h;
+}
+
+static bool env_cb(unsigned cmd, void *data)
+{
+	struct retro_variable *var = data;
+	int i;
+
+	switch (cmd) {
+	case RETRO_ENVIRONMENT_GET_VARIABLE:
+		for (i = 0; i < opt_count; i++) {
+			if (strcmp(var->key, opts[i].key) == 0) {
+				var->value = opts[i].value;
+				return true;
+			}
+		}
+		var->value = NULL;
+		return false;
+	case RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY:
+		*(const char **)data = system_dir;
+		return true;
+	case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
+		video_bpp = *(enum retro_pixel_format *)data == RETRO_PIXEL_FORMAT_XRGB8888 ? 4 : 2;
+		return true;
+	}
+	return false;
+}
+
+static void video_cb(const void *data, unsigned width, unsigned height, size_t pitch)
+{
+	unsigned int y;
+
+	if (data == NULL)
+		return;
+	for (y = 0; y < height; y++)
+		video_hash = hash(video_hash, (const char *)data + y * pitch, width * video_bpp);
+}
+
+static size_t audio_batch_cb(const int16_t *data, size_t frames)
+{
+	audio_hash = hash(audio_hash, data, frames * 4);
+	return frames;
+}
+
+static void audio_cb(int16_t l, int16_t r) { }
+static void input_poll_cb(void) { }
+
+static int16_t input_state_cb(unsigned port, unsigned device, unsigned index, unsigned id)
+{
+	if (port == 0 && device == RETRO_DEVICE_JOYPAD && id == RETRO_DEVICE_ID_JOYPAD_L2)
+		return (input_pad[0] >> 12) & 1;
+	if (port > 1 || device != RETRO_DEVICE_JOYPAD || id >= sizeof(retro_to_gbtn))
+		return 0;
+	return (input_pad[port] >> retro_to_gbtn[id]) & 1;
+}
+
+static void input_read_next(void)
+{
+	char line[128];
+
+	input_next = -1;
+	while (fgets(line, sizeof(line), input_log) != NULL) {
+		input_next_pad[1] = 0;
+		if (sscanf(line, "%d %x %x", &input_next,
+		    &input_next_pad[0], &input_next_pad[1]) >= 2)
+			return;
+		input_next = -1;
+	}
+}
+
+static void input_update(int frame)
+{
+	while (input_next >= 0 && input_next <= frame) {
+		input_pad[0] = input_next_pad[0];
+		input_pad[1] = input_next_pad[1];
+		input_read_next();
+	}
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void digest_frame(int frame)
+{
+	unsigned int h0 = 2166136261u, sdram = h0, dram = h0;
+
+	if (PicoAHW & PAHW_32X) {
+		sdram = hash(h0, Pico32xMem->sdram, sizeof(Pico32xMem->sdram));
+		dram = hash(h0, Pico32xMem->dram, sizeof(Pico32xMem->dram));
+	}
+	else if (PicoAHW & PAHW_SVP) {
+		sdram = hash(h0, svp->dram, sizeof(svp->dram));
+		dram = hash(h0, svp->ssp1601.RAM, sizeof(svp->ssp1601.RAM));
+	}
+	fprintf(digest, "%d %08x %08x %08x %08x %08x %08x %08x\n", frame,
+		hash(h0, Pico.ram, sizeof(Pico.ram)),
+		hash(h0, Pico.vram, sizeof(Pico.vram)),
+		hash(h0, Pico.zram, sizeof(Pico.zram)),
+		sdram, dram, video_hash, audio_hash);
+}
+
+static void ctx_enter(int n)
+{
+	if (ctx[n] != NULL)
+		PicoContextEnter(ctx[n]);
+}
+
+static void ctx_leave(int n)
+{
+	if (ctx[n] != NULL)
+		PicoContextLeave(ctx[n]);
+}
+
+static int load(int n, const char *path)
+{
+	struct retro_game_info info = { 0, };
+	int ret;
+
+	info.path = path;
+	ctx_enter(n);
+	retro_init();
+	ret = retro_load_game(&info);
+	ctx_leave(n);
+	if (!ret)
+		fprintf(stderr, "failed to load %s\n", path);
+	return ret;
+}
+
+static void run_frame(int frame)
+{
+	input_update(frame);
+	ctx_enter(0);
+	retro_run();
+	if (digest != NULL)
+		digest_frame(frame);
+	ctx_leave(0);
+
+	if (ctx[1] != NULL) {
+		ctx_enter(1);
+		retro_run();
+		ctx_leave(1);
+	}
+}
+
+// a JSON string, quoted
+static void json_string(FILE *f, const char *s)
+{
+	fputc('"', f);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fprintf(f, "\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			fprintf(f, "\\u%04x", (unsigned char)*s);
+		else
+			fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s [options] <rom/cd image>\n"
+		"  -n <frames>     frames to run [3000]\n"
+		"  -w <frames>     warmup frames, not measured [0]\n"
+		"  -i <file>       input log\n"
+		"  -s <dir>        system dir (CD BIOS)\n"
+		"  -o <key=value>  core option, like picodrive_drc=disabled\n"
+		"  -j <file>       JSON output [stdout]\n"
+		"  -d <file>       per frame memory digest\n"
+		"  -c <image>      also run this, in a second instance\n", argv0);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long long ticks = 0, worst = 0;
+	const char *json_name = NULL, *image, *image2 = NULL;
+	int frames = 3000, warmup = 0;
+	unsigned int t0, t1;
+	double start, secs;
+	FILE *json;
+	char *p;
+	int i;
+
+	for (i = 1; i < argc - 1; i++) {
+		if (argv[i][0] != '-' || argv[i][1] == 0 || argv[i][2] != 0)
+			usage(argv[0]);
+		switch (argv[i][1]) {
+		case 'n': frames = atoi(argv[++i]); break;
+		case 'w': warmup = atoi(argv[++i]); break;
+		case 's': system_dir = argv[++i]; break;
+		case 'j': json_name = argv[++i]; break;
+		case 'c': image2 = argv[++i]; break;
+		case 'd':
+			digest = fopen(argv[++i], "w");
+			if (digest == NULL) {
+				perror(argv[i]);
+				return 1;
+			}
+			break;
+		case 'i':
+			input_log = fopen(argv[++i], "r");
+			if (input_log == NULL) {
+				perror(argv[i]);
+				return 1;
+			}
+			break;
+		case 'o':
+			p = strchr(argv[++i], '=');
+			if (p == NULL || opt_count == MAX_OPTS)
+				usage(argv[0]);
+			*p = 0;
+			opts[opt_count].key = argv[i];
+			opts[opt_count++].value = p + 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (i != argc - 1 || frames <= 0)
+		usage(argv[0]);
+	image = argv[i];
+
+	if (image2 != NULL) {
+		ctx[0] = PicoContextCreate();
+		ctx[1] = PicoContextCreate();
+		if (ctx[0] == NULL || ctx[1] == NULL)
+			return 1;
+	}
+
+	retro_set_environment(env_cb);
+	retro_set_video_refresh(video_cb);
+	retro_set_audio_sample(audio_cb);
+	retro_set_audio_sample_batch(audio_batch_cb);
+	retro_set_input_poll(input_poll_cb);
+	retro_set_input_state(input_state_cb);
+
+	if (!load(0, image) || (image2 != NULL && !load(1, image2)))
+		return 1;
+
+	if (input_log != NULL)
+		input_read_next();
+
+	for (i = 0; i < warmup; i++)
+		run_frame(i);
+
+	memset(&counters, 0, sizeof(counters));
+	video_hash = audio_hash = 2166136261u;
+	start = now();
+	for (; i < warmup + frames; i++) {
+		t0 = pprof_get_one();
+		run_frame(i);
+		t1 = pprof_get_one();
+		ticks += t1 - t0;
+		if (t1 - t0 > worst)
+			worst = t1 - t0;
+	}
+	secs = now() - start;
+
+	json = stdout;
+	if (json_name != NULL && (json = fopen(json_name, "w")) == NULL) {
+		perror(json_name);
+		return 1;
+	}
+
+	fprintf(json, "{\n");
+	fprintf(json, "  \"image\": ");
+	json_string(json, image);
+	fprintf(json, ",\n");
+	fprintf(json, "  \"frames\": %d,\n", frames);
+	fprintf(json, "  \"seconds\": %.6f,\n", secs);
+	fprintf(json, "  \"fps\": %.3f,\n", frames / secs);
+	fprintf(json, "  \"timer_hz\": %.0f,\n", ticks / secs);
+	fprintf(json, "  \"worst_frame_ms\": %.4f,\n", ticks ? worst * secs * 1000.0 / ticks : 0.0);
+	fprintf(json, "  \"video_hash\": \"%08x\",\n", video_hash);
+	fprintf(json, "  \"audio_hash\": \"%08x\",\n", audio_hash);
+	fprintf(json, "  \"points\": {\n");
+	for (i = 0; i < ARRAY_SIZE(pp_tab); i++) {
+		unsigned long long c = pp_counters->counter[pp_tab[i].pp];
+		fprintf(json, "    \"%s\": { \"ticks\": %llu, \"ms_per_frame\": %.4f, \"percent\": %.2f }%s\n",
+			pp_tab[i].name, c, ticks ? c * secs * 1000.0 / ticks / frames : 0.0,
+			ticks ? c * 100.0 / ticks : 0.0, i < ARRAY_SIZE(pp_tab) - 1 ? "," : "");
+	}
+	fprintf(json, "  }\n}\n");
+
+	if (json != stdout)
+		fclose(json);
+	if (digest != NULL)
+		fclose(digest);
+	for (i = image2 != NULL; i >= 0; i--) {
+		ctx_enter(i);
+		retro_unload_game();
+		retro_deinit();
+		ctx_leave(i);
+		PicoContextDestroy(ctx[i]);
+	}
+	return 0;
+}
@@ -79,6 +79,7 @@ static const struct {
 	IT(z80),
 	IT(msh2),
 	IT(ssh2),
+	IT(rewind),
 	IT(dummy),
 };
 
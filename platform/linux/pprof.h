@@ -10,6 +10,7 @@ enum pprof_points {
   pp_z80,
   pp_msh2,
   pp_ssh2,
+  pp_rewind,
   pp_dummy,
   pp_total_points
 };
@@ -21,12 +22,13 @@ struct pp_counters
 
 extern struct pp_counters *pp_counters;
 
-#ifdef __i386__
+#if defined(__i386__) || defined(__x86_64__)
+// "=A" is edx:eax on i386 only, only the low word is used anyway
 static __attribute__((always_inline)) inline unsigned int pprof_get_one(void)
 {
-  unsigned long long ret;
-  __asm__ __volatile__ ("rdtsc" : "=A" (ret));
-  return (unsigned int)ret;
+  unsigned int lo, hi;
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+  return lo;
 }
 #define unglitch_timer(x)
 
@@ -38,7 +40,15 @@ extern volatile unsigned long *gp2x_memregl;
   if ((signed int)(di) < 0) di = 0
 
 #else
-#error no timer
+// anything else with posix timers, in ns
+#include <time.h>
+static inline unsigned int pprof_get_one(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#define unglitch_timer(x)
 #endif
 
 #define pprof_start(point) { \
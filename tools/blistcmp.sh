@@ -0,0 +1,52 @@
+#!/bin/sh
+# time the first frames of a 32X game with the SH2 block list
+# (picodrive_drccache) cold, without a list, and warm, with the list
+# the cold run left in the system dir, see sh2_drc_blist_load
+#
+# usage: tools/blistcmp.sh <32x rom> [frames] [runs]
+# prints the best of the runs for each, the warm list is kept between them.
+# needs picodrive_bench (make -f Makefile.libretro bench=1 picodrive_bench)
+
+top=$(dirname "$0")/..
+bench=${BENCH:-$top/picodrive_bench}
+tmp=${TMPDIR:-/tmp}/blistcmp.$$
+rom=$1; frames=${2:-60}; runs=${3:-5}
+
+[ -n "$rom" ] || { echo "usage: $0 <32x rom> [frames] [runs]"; exit 1; }
+[ -x "$bench" ] || { echo "$bench not built"; exit 1; }
+
+mkdir -p "$tmp/cold" "$tmp/warm" || exit 1
+trap 'rm -rf "$tmp"' EXIT
+
+# frame ms, worst frame ms, msh2 and ssh2 ms per frame of a JSON report
+stats()
+{
+	awk -v frames="$frames" '
+		/"seconds"/ { gsub(/[ ,]/, ""); split($0, a, ":"); sec = a[2] }
+		/"worst_frame_ms"/ { gsub(/[ ,]/, ""); split($0, a, ":"); worst = a[2] }
+		/"msh2"|"ssh2"/ { for (i = 1; i <= NF; i++) if ($i ~ /ms_per_frame/) { v = $(i + 1); sub(/,/, "", v); sh2 += v } }
+		END { printf "%.4f %.4f %.4f\n", sec * 1000 / frames, worst, sh2 }' "$1"
+}
+
+best()
+{
+	sort -n -k1 "$1" | head -n 1
+}
+
+n=0
+: > "$tmp/c"; : > "$tmp/w"
+while [ "$n" -lt "$runs" ]; do
+	rm -f "$tmp/cold/"*.blk
+	"$bench" -n "$frames" -s "$tmp/cold" -o picodrive_drccache=enabled \
+		-j "$tmp/j" "$rom" > /dev/null 2>&1 || { echo "cold run failed"; exit 1; }
+	stats "$tmp/j" >> "$tmp/c"
+	[ -f "$tmp/warm/"*.blk ] || cp "$tmp/cold/"*.blk "$tmp/warm/" 2> /dev/null \
+		|| { echo "no block list written"; exit 1; }
+	"$bench" -n "$frames" -s "$tmp/warm" -o picodrive_drccache=enabled \
+		-j "$tmp/j" "$rom" > /dev/null 2>&1 || { echo "warm run failed"; exit 1; }
+	stats "$tmp/j" >> "$tmp/w"
+	n=$((n + 1))
+done
+echo "first $frames frames, best of $runs: ms/frame, worst frame ms, sh2 ms/frame"
+echo "cold: $(best "$tmp/c")"
+echo "warm: $(best "$tmp/w")"
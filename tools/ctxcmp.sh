@@ -0,0 +1,41 @@
+#!/bin/sh
+# run random test ROMs alone and next to another one in a second emulator
+# instance (pico/context.c) and compare the emulated memory every frame,
+# see mkrandrom.c
+#
+# usage: tools/ctxcmp.sh <sys> <other sys> <first seed> <last seed> [frames]
+# sys is 32x, sms, md or svp. Set DRC=disabled for the interpreters.
+# needs picodrive_bench (make -f Makefile.libretro bench=1 picodrive_bench)
+
+top=$(dirname "$0")/..
+bench=${BENCH:-$top/picodrive_bench}
+tmp=${TMPDIR:-/tmp}/ctxcmp.$$
+sys=$1; sys2=$2; first=$3; last=$4; frames=${5:-30}
+drc=${DRC:-enabled}
+
+[ -n "$last" ] || { echo "usage: $0 <sys> <other sys> <first seed> <last seed> [frames]"; exit 1; }
+[ -x "$bench" ] || { echo "$bench not built"; exit 1; }
+make -s -C "$top/tools" mkrandrom || exit 1
+
+mkdir -p "$tmp" || exit 1
+trap 'rm -rf "$tmp"' EXIT
+fails=0
+seed=$first
+while [ "$seed" -le "$last" ]; do
+	"$top/tools/mkrandrom" "$sys" "$seed" "$tmp/rom" || exit 1
+	"$top/tools/mkrandrom" "$sys2" "$((seed + 10000))" "$tmp/rom2" || exit 1
+	"$bench" -n "$frames" -o picodrive_drc=$drc -d "$tmp/alone" \
+		"$tmp/rom" > /dev/null 2>&1 || echo "seed $seed: run failed"
+	"$bench" -n "$frames" -o picodrive_drc=$drc -d "$tmp/ctx" \
+		-c "$tmp/rom2" "$tmp/rom" > /dev/null 2>&1 || echo "seed $seed: -c run failed"
+	# frame number and the ram/vram/zram/sdram/dram hashes
+	cut -d' ' -f1-6 "$tmp/alone" > "$tmp/a"
+	cut -d' ' -f1-6 "$tmp/ctx" > "$tmp/b"
+	if ! cmp -s "$tmp/a" "$tmp/b"; then
+		echo "seed $seed: differs"
+		fails=$((fails + 1))
+	fi
+	seed=$((seed + 1))
+done
+echo "$((last - first + 1)) roms, $fails differ"
+[ "$fails" -eq 0 ]
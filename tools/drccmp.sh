@@ -0,0 +1,50 @@
+#!/bin/sh
+# run random test ROMs with the recompilers and the interpreters and
+# compare the emulated memory, see mkrandrom.c
+#
+# usage: tools/drccmp.sh <32x|sms|md|68k|68kram|svp> <first seed> <last seed> [frames]
+# needs picodrive_bench (make -f Makefile.libretro bench=1 picodrive_bench,
+# with use_m68kdrc=1 for 68k/68kram)
+# 32x: the SH2 recompiler doesn't count cycles like the interpreter, so
+# only the memory after the program is done is compared, same for the
+# SSP1601 (svp). The z80 and 68k ones do, so for sms, md (z80) and
+# 68k/68kram every frame is.
+
+top=$(dirname "$0")/..
+bench=${BENCH:-$top/picodrive_bench}
+tmp=${TMPDIR:-/tmp}/drccmp.$$
+sys=$1; first=$2; last=$3
+
+case "$sys" in
+32x|svp) frames=${4:-60}; cmp_lines=1 ;;
+sms|md|68k|68kram) frames=${4:-30}; cmp_lines=$frames ;;
+*) last= ;;
+esac
+[ -n "$last" ] || { echo "usage: $0 <32x|sms|md|68k|68kram|svp> <first seed> <last seed> [frames]"; exit 1; }
+# the 68k recompiler is opt-in
+opt=picodrive_drc
+case "$sys" in 68k*) opt=picodrive_m68kdrc ;; esac
+[ -x "$bench" ] || { echo "$bench not built"; exit 1; }
+make -s -C "$top/tools" mkrandrom || exit 1
+
+mkdir -p "$tmp" || exit 1
+trap 'rm -rf "$tmp"' EXIT
+fails=0
+seed=$first
+while [ "$seed" -le "$last" ]; do
+	"$top/tools/mkrandrom" "$sys" "$seed" "$tmp/rom" || exit 1
+	for drc in disabled enabled; do
+		"$bench" -n "$frames" -o $opt=$drc -d "$tmp/$drc" \
+			"$tmp/rom" > /dev/null 2>&1 || echo "seed $seed: $drc run failed"
+	done
+	# frame number and the ram/vram/zram/sdram/dram hashes
+	tail -n $cmp_lines "$tmp/disabled" | cut -d' ' -f1-6 > "$tmp/a"
+	tail -n $cmp_lines "$tmp/enabled" | cut -d' ' -f1-6 > "$tmp/b"
+	if ! cmp -s "$tmp/a" "$tmp/b"; then
+		echo "seed $seed: differs"
+		fails=$((fails + 1))
+	fi
+	seed=$((seed + 1))
+done
+echo "$((last - first + 1)) roms, $fails differ"
+[ "$fails" -eq 0 ]
@@ -0,0 +1,193 @@
+/*
+ * make a .hcd (hunked compressed disc) from track files
+ * :make mkhcd CFLAGS=-Wall LDLIBS=-lz
+ *
+ * usage: mkhcd <out.hcd> <track01.bin|iso> [track02.bin|wav ...]
+ * Each track file is taken whole, so pregaps go where the dump put them.
+ * An .iso data track is expanded to 2352 byte frames if there is audio.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "../pico/cd/hcd.h"
+
+static const unsigned char sync_pattern[12] =
+	{ 0, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0 };
+
+static hcd_header hdr;
+static unsigned int *hindex;
+static unsigned char *hunk, *cbuf;
+static unsigned int hunk_fill, hunks_done, out_pos;
+static uLong cbuf_size;
+static FILE *fo;
+
+static void flush_hunk(void)
+{
+	uLongf clen = cbuf_size;
+	int ret;
+
+	if (hunk_fill == 0)
+		return;
+
+	ret = compress2(cbuf, &clen, hunk, hunk_fill, 9);
+	hindex[hunks_done] = out_pos;
+	if (ret == Z_OK && clen < hunk_fill) {
+		fwrite(cbuf, 1, clen, fo);
+		out_pos += clen;
+	}
+	else {
+		// doesn't compress
+		fwrite(hunk, 1, hunk_fill, fo);
+		hindex[hunks_done] |= 0x80000000;
+		out_pos += hunk_fill;
+	}
+	hunks_done++;
+	hunk_fill = 0;
+
+	if ((hunks_done & 0xff) == 0 || hunks_done == hdr.hunk_count) {
+		printf("\r%u/%u", hunks_done, hdr.hunk_count);
+		fflush(stdout);
+	}
+}
+
+static void put(const void *data, unsigned int len)
+{
+	const unsigned char *p = data;
+	unsigned int n;
+
+	while (len > 0) {
+		n = hdr.hunk_size - hunk_fill;
+		if (n > len)
+			n = len;
+		memcpy(hunk + hunk_fill, p, n);
+		hunk_fill += n;
+		p += n;
+		len -= n;
+		if (hunk_fill == hdr.hunk_size)
+			flush_hunk();
+	}
+}
+
+static int bcd(int v)
+{
+	return ((v / 10) << 4) | (v % 10);
+}
+
+// mode1 frame around an iso sector, edc/ecc left zero
+static void put_iso_frame(const unsigned char *data, int lba)
+{
+	unsigned char head[16], tail[288];
+
+	lba += 150;
+	memcpy(head, sync_pattern, sizeof(sync_pattern));
+	head[12] = bcd(lba / 75 / 60);
+	head[13] = bcd(lba / 75 % 60);
+	head[14] = bcd(lba % 75);
+	head[15] = 1;
+	memset(tail, 0, sizeof(tail));
+	put(head, sizeof(head));
+	put(data, 2048);
+	put(tail, sizeof(tail));
+}
+
+static long file_size(FILE *f, long skip)
+{
+	long size;
+	fseek(f, 0, SEEK_END);
+	size = ftell(f) - skip;
+	fseek(f, skip, SEEK_SET);
+	return size < 0 ? 0 : size;
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *fi[HCD_MAX_TRACKS];
+	long skip[HCD_MAX_TRACKS], size[HCD_MAX_TRACKS];
+	unsigned char buf[2352], head[16];
+	unsigned int frames = 0;
+	int i, n, tracks, is_iso, expand;
+	long done;
+
+	if (argc < 3 || argc - 2 > HCD_MAX_TRACKS)
+	{
+		printf("usage: %s <out.hcd> <track01.bin|iso> [track02.bin|wav ...]\n", argv[0]);
+		return 1;
+	}
+	tracks = argc - 2;
+
+	for (i = 0; i < tracks; i++) {
+		fi[i] = fopen(argv[i + 2], "rb");
+		if (fi[i] == NULL) {
+			fprintf(stderr, "can't open %s\n", argv[i + 2]);
+			return 2;
+		}
+		skip[i] = 0;
+		if (i > 0 && fread(head, 1, 4, fi[i]) == 4 && memcmp(head, "RIFF", 4) == 0)
+			skip[i] = 44; // assume 44kHz stereo 16bit
+		size[i] = file_size(fi[i], skip[i]);
+	}
+
+	is_iso = !(fread(head, 1, 16, fi[0]) == 16 && memcmp(head, sync_pattern, sizeof(sync_pattern)) == 0);
+	fseek(fi[0], 0, SEEK_SET);
+	expand = is_iso && tracks > 1;
+
+	memcpy(hdr.magic, HCD_MAGIC, sizeof(hdr.magic));
+	hdr.frame_size = (is_iso && !expand) ? 2048 : 2352;
+	hdr.hunk_size = hdr.frame_size * HCD_HUNK_FRAMES;
+	hdr.track_count = tracks;
+	for (i = 0; i < tracks; i++) {
+		hdr.track_start[i] = frames;
+		if (i == 0 && is_iso)
+			frames += (size[i] + 2047) / 2048;
+		else
+			frames += (size[i] + 2351) / 2352;
+	}
+	hdr.total_bytes = frames * hdr.frame_size;
+	hdr.hunk_count = (hdr.total_bytes + hdr.hunk_size - 1) / hdr.hunk_size;
+
+	hindex = calloc(hdr.hunk_count + 1, 4);
+	hunk = malloc(hdr.hunk_size);
+	cbuf_size = compressBound(hdr.hunk_size);
+	cbuf = malloc(cbuf_size);
+	if (hindex == NULL || hunk == NULL || cbuf == NULL)
+		return 3;
+
+	fo = fopen(argv[1], "wb");
+	if (fo == NULL) {
+		fprintf(stderr, "can't open %s\n", argv[1]);
+		return 2;
+	}
+
+	// header and index are rewritten at the end
+	out_pos = sizeof(hdr) + (hdr.hunk_count + 1) * 4;
+	fseek(fo, out_pos, SEEK_SET);
+
+	for (i = 0; i < tracks; i++) {
+		int fsize = (i == 0 && is_iso) ? 2048 : 2352;
+
+		for (done = 0, n = 0; done < size[i]; done += fsize, n++) {
+			memset(buf, 0, sizeof(buf));
+			fread(buf, 1, fsize, fi[i]);
+			if (i == 0 && expand)
+				put_iso_frame(buf, n);
+			else
+				put(buf, fsize);
+		}
+		fclose(fi[i]);
+	}
+	flush_hunk();
+	hindex[hdr.hunk_count] = out_pos;
+
+	fseek(fo, 0, SEEK_SET);
+	fwrite(&hdr, 1, sizeof(hdr), fo);
+	fwrite(hindex, 4, hdr.hunk_count + 1, fo);
+	if (ferror(fo) || fclose(fo) != 0) {
+		fprintf(stderr, "\nwrite failed\n");
+		return 4;
+	}
+
+	printf("\n%u frames of %u, %d tracks, %u -> %u bytes\n", frames,
+		hdr.frame_size, tracks, hdr.total_bytes, out_pos);
+	return 0;
+}
@@ -0,0 +1,1780 @@
+/*
+ * make random test ROMs for checking the recompilers against the
+ * interpreters, see drccmp.sh
+ * :make mkrandrom CFLAGS=-Wall
+ *
+ * usage: mkrandrom <32x|sms|md|68k|68kram|svp|fm> <seed> <out>
+ * 32x: the master SH2 runs random ALU, memory and branch code out of
+ * SDRAM, stores its registers there and spins. What it computes doesn't
+ * depend on timing, so the final SDRAM must match whatever ran it.
+ * sms, md: the z80 runs random code forever, with irqs, self modifying
+ * code and bank switches. Both z80 cores count cycles the same, so every
+ * frame must match.
+ * 68k, 68kram: the 68k runs random code from ROM, or from RAM with self
+ * modifying code, see make_m68k(). Every frame must match too.
+ * svp: the SSP1601 runs random code, see make_svp(). Like with the 32x,
+ * only the memory after it's done is compared.
+ * fm: the 68k plays random YM2612/PSG writes, see make_fm(), for
+ * comparing sound (racmp.sh).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+static unsigned int rnd_state;
+
+static unsigned int rnd(unsigned int n)
+{
+	// xorshift32
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return n ? rnd_state % n : rnd_state;
+}
+
+#define pick(tab) tab[rnd(sizeof(tab) / sizeof(tab[0]))]
+
+static unsigned char *rom;
+static int rom_size;
+
+static void w16(int a, unsigned int v)
+{
+	rom[a] = v >> 8;
+	rom[a + 1] = v;
+}
+
+static void w32(int a, unsigned int v)
+{
+	w16(a, v >> 16);
+	w16(a + 2, v);
+}
+
+static void fail(const char *what)
+{
+	fprintf(stderr, "mkrandrom: %s\n", what);
+	exit(1);
+}
+
+/* ------------------------------------------------------------------ */
+/* 32x */
+
+#define SH2_CODE	0x1000	// in ROM, copied to SDRAM at 0 by the BIOS
+#define SH2_CSIZE	0x8000
+#define SH2_BASE	0x06000000
+
+static unsigned short *sh2;	// code, in words
+static int sh2_pc;
+static int sh2_lab[0x1000];
+static int sh2_nlab;
+
+static struct {
+	int at, op, lab;
+} sh2_br[0x1000];
+static int sh2_nbr;
+
+static struct {
+	int at, sz, lab;	// lab >= 0: label address
+	unsigned int val;
+	int addr;
+} sh2_lit[0x1000];
+static int sh2_nlit, sh2_pend;	// literals from sh2_pend on are not placed
+
+static int work[11], nwork;	// random registers
+
+static void W(unsigned int v)
+{
+	if (sh2_pc >= SH2_CSIZE / 2)
+		fail("sh2 code too large");
+	sh2[sh2_pc++] = v;
+}
+
+static int newlab(void)
+{
+	sh2_lab[sh2_nlab] = -1;
+	return sh2_nlab++;
+}
+
+static void LAB(int l)
+{
+	sh2_lab[l] = sh2_pc * 2;
+}
+
+// op 0x89 bt, 0x8b bf, 0x8d bt/s, 0x8f bf/s, 0xa bra, 0xb bsr
+static void BR(int op, int l)
+{
+	sh2_br[sh2_nbr].at = sh2_pc;
+	sh2_br[sh2_nbr].op = op;
+	sh2_br[sh2_nbr++].lab = l;
+	W(0);
+}
+
+// mov.l/mov.w @(disp,pc),rn
+static void LIT(int n, unsigned int v, int sz, int lab)
+{
+	sh2_lit[sh2_nlit].at = sh2_pc;
+	sh2_lit[sh2_nlit].sz = sz;
+	sh2_lit[sh2_nlit].lab = lab;
+	sh2_lit[sh2_nlit++].val = v;
+	W((sz == 4 ? 0xd000 : 0x9000) | n << 8);
+}
+
+static void POOL(void)
+{
+	if (sh2_pc & 1)
+		W(0x0009);
+	for (; sh2_pend < sh2_nlit; sh2_pend++) {
+		sh2_lit[sh2_pend].addr = sh2_pc * 2;
+		W(0);
+		W(0);
+	}
+}
+
+// literals go stale 255 words away, put them out with a bra over them
+static void pool_check(void)
+{
+	int l;
+
+	if (sh2_pend == sh2_nlit || sh2_pc - sh2_lit[sh2_pend].at < 64)
+		return;
+	l = newlab();
+	BR(0xa, l);
+	W(0x0009);
+	POOL();
+	LAB(l);
+}
+
+static int rr(void)
+{
+	return work[rnd(nwork)];
+}
+
+static void sh2_alu(int lit_ok)
+{
+	static const unsigned short shifts[] = { 0x4000, 0x4001, 0x4020, 0x4021,
+		0x4004, 0x4005, 0x4024, 0x4025, 0x4008, 0x4009, 0x4018, 0x4019,
+		0x4028, 0x4029 };
+	static const unsigned short rm_ops[] = { 0x6003, 0x300c, 0x3008, 0x2009,
+		0x200b, 0x200a, 0x6007, 0x600b, 0x600a, 0x300e, 0x300a, 0x300f,
+		0x300b, 0x3000, 0x3002, 0x3003, 0x3006, 0x3007, 0x200c, 0x2008,
+		0x600c, 0x600d, 0x600e, 0x600f, 0x6008, 0x6009, 0x200d, 0x0007,
+		0x200f, 0x200e, 0x3005, 0x300d, 0x2007, 0x3004 };
+	static const unsigned short rn_ops[] = { 0x4011, 0x4015, 0x4010, 0x0029,
+		0x001a, 0x000a };
+	static const unsigned short r0_imm[] = { 0xc900, 0xcb00, 0xca00, 0xc800,
+		0x8800 };
+	static const unsigned short no_reg[] = { 0x0008, 0x0018, 0x0019, 0x0028 };
+	int n = rr(), m = rr();
+
+	switch (rnd(lit_ok ? 9 : 8)) {
+	case 0: W(0xe000 | n << 8 | rnd(256)); break;	// mov #imm
+	case 1: W(0x7000 | n << 8 | rnd(256)); break;	// add #imm
+	case 2:
+	case 3: W(pick(rm_ops) | n << 8 | m << 4); break;
+	case 4: W(pick(shifts) | n << 8); break;
+	case 5: W(pick(rn_ops) | n << 8); break;
+	case 6:
+		n = pick(r0_imm);
+		W(n | rnd(256));
+		break;
+	case 7: W(pick(no_reg)); break;
+	case 8:
+		m = rnd(2) ? 4 : 2;
+		LIT(n, rnd(0), m, -1);
+		break;
+	}
+}
+
+// loads and stores through r13 (SDRAM) or r12 (cache data array)
+static void sh2_mem(void)
+{
+	int n = rr(), m = rr(), b = rnd(3) ? 13 : 12, d = rnd(16);
+
+	switch (rnd(12)) {
+	case 0: W(0x5000 | n << 8 | b << 4 | d); break;		// mov.l @(d,b),rn
+	case 1: W(0x1000 | b << 8 | m << 4 | d); break;		// mov.l rm,@(d,b)
+	case 2: W(0x8400 | b << 4 | d); break;			// mov.b @(d,b),r0
+	case 3: W(0x8500 | b << 4 | d); break;			// mov.w @(d,b),r0
+	case 4: W(0x8000 | b << 4 | d); break;			// mov.b r0,@(d,b)
+	case 5: W(0x8100 | b << 4 | d); break;			// mov.w r0,@(d,b)
+	case 6: W(0x6000 | n << 8 | b << 4 | rnd(3)); break;	// mov.x @b,rn
+	case 7: W(0x2000 | b << 8 | m << 4 | rnd(3)); break;	// mov.x rm,@b
+	case 8:								// mov.x @(r0,b),rn
+		W(0xc93c);
+		W((0x000c + rnd(3)) | n << 8 | b << 4);
+		break;
+	case 9:								// mov.x rm,@(r0,b)
+		W(0xc93c);
+		W((0x0004 + rnd(3)) | b << 8 | m << 4);
+		break;
+	case 10:							// mov.x @r14+,rn
+		W(0x6003 | 14 << 8 | b << 4);
+		W((rnd(2) ? 0x6006 : 0x6005) | n << 8 | 14 << 4);
+		break;
+	case 11:							// mov.x rm,@-r14
+		W(0x6003 | 14 << 8 | b << 4);
+		W(0x7e40);
+		W((rnd(2) ? 0x2006 : 0x2005) | 14 << 8 | m << 4);
+		break;
+	}
+}
+
+static void sh2_simple(void)
+{
+	if (rnd(10) < 3)
+		sh2_mem();
+	else
+		sh2_alu(1);
+}
+
+static int sh2_subs[4];
+
+static void sh2_block(int depth, int size)
+{
+	int i, j, k, l, saved;
+
+	for (i = 0; i < size; i++) {
+		if (depth == 0)
+			pool_check();
+		k = rnd(100);
+		if (k < 8 && depth < 3) {
+			// forward conditional branch
+			l = newlab();
+			BR(rnd(2) ? 0x89 : 0x8b, l);
+			for (j = rnd(4) + 1; j > 0; j--)
+				sh2_simple();
+			LAB(l);
+		}
+		else if (k < 12 && depth < 3) {
+			// same, delayed
+			l = newlab();
+			BR(rnd(2) ? 0x8d : 0x8f, l);
+			sh2_alu(0);
+			for (j = rnd(3) + 1; j > 0; j--)
+				sh2_simple();
+			LAB(l);
+		}
+		else if (k < 15 && depth < 2) {
+			// counted loop on r10
+			W(0xea00 | (rnd(11) + 1));
+			l = newlab();
+			LAB(l);
+			saved = nwork;
+			nwork = 10;
+			for (j = rnd(5) + 1; j > 0; j--)
+				sh2_simple();
+			W(0x4a10);
+			BR(0x8b, l);
+			nwork = saved;
+		}
+		else if (k < 18) {
+			// delay loop
+			W(0xea00 | (rnd(127) + 1));
+			l = newlab();
+			LAB(l);
+			W(0x4a10);
+			BR(0x8b, l);
+		}
+		else if (k < 20 && depth == 0) {
+			// jsr to a subroutine
+			LIT(14, 0, 4, sh2_subs[rnd(4)]);
+			W(0x4e0b);
+			W(0x0009);
+		}
+		else if (k < 22) {
+			l = newlab();
+			BR(0xa, l);
+			sh2_alu(0);
+			for (j = rnd(2) + 1; j > 0; j--)
+				sh2_simple();
+			LAB(l);
+		}
+		else
+			sh2_simple();
+	}
+}
+
+static void sh2_assemble(void)
+{
+	int i, t, d;
+
+	for (i = 0; i < sh2_nbr; i++) {
+		t = sh2_lab[sh2_br[i].lab];
+		d = (t - sh2_br[i].at * 2 - 4) / 2;
+		if (sh2_br[i].op < 0x10) {
+			if (d < -2048 || d >= 2048)
+				fail("sh2 branch out of range");
+			sh2[sh2_br[i].at] = sh2_br[i].op << 12 | (d & 0xfff);
+		}
+		else {
+			if (d < -128 || d >= 128)
+				fail("sh2 branch out of range");
+			sh2[sh2_br[i].at] = sh2_br[i].op << 8 | (d & 0xff);
+		}
+	}
+	for (i = 0; i < sh2_nlit; i++) {
+		unsigned int v = sh2_lit[i].val;
+		int at = sh2_lit[i].at * 2, a = sh2_lit[i].addr;
+
+		if (sh2_lit[i].lab >= 0)
+			v = SH2_BASE + sh2_lab[sh2_lit[i].lab];
+		if (sh2_lit[i].sz == 4)
+			d = (a - (at & ~3) - 4) / 4;
+		else
+			d = (a - at - 4) / 2;
+		if (d < 0 || d >= 256)
+			fail("sh2 literal out of range");
+		sh2[at / 2] |= d;
+		sh2[a / 2] = v >> 16;
+		sh2[a / 2 + 1] = v;
+	}
+}
+
+static void make_32x(int outer)
+{
+	int i, l, top;
+
+	rom_size = 0x20000;
+	rom = calloc(rom_size, 1);
+	sh2 = calloc(SH2_CSIZE / 2, 2);
+	if (rom == NULL || sh2 == NULL)
+		fail("out of memory");
+
+	// 68k: turn on the 32x and spin
+	w32(0, 0x00ff0000);
+	w32(4, 0x200);
+	memcpy(rom + 0x100, "SEGA 32X        ", 16);
+	w16(0x200, 0x13fc);			// move.b #3,$a15101
+	w16(0x202, 0x0003);
+	w32(0x204, 0x00a15101);
+	w16(0x208, 0x60fe);			// bra *
+
+	memcpy(rom + 0x3c0, "MARS CHECK MODE ", 16);
+	w32(0x3d4, SH2_CODE);
+	w32(0x3d8, 0);
+	w32(0x3dc, SH2_CSIZE);
+	w32(0x3e0, SH2_BASE);			// master start, vbr
+	w32(0x3e4, 0x02000800);			// slave start, vbr
+	w32(0x3e8, SH2_BASE);
+	w32(0x3ec, SH2_BASE);
+	w16(0x800, 0xaffe);			// slave: bra *
+	w16(0x802, 0x0009);
+
+	for (i = 0; i < 11; i++)
+		work[i] = i;
+	nwork = 11;
+	for (i = 0; i < 4; i++)
+		sh2_subs[i] = newlab();
+
+	// r15 sp, r13 SDRAM data, r12 cache data array, r11 outer count
+	LIT(15, 0x0603f000, 4, -1);
+	LIT(13, 0x06020000, 4, -1);
+	LIT(12, 0xc0000000, 4, -1);
+	LIT(11, outer, 4, -1);
+	for (i = 0; i < 11; i++)
+		W(0xe000 | i << 8 | rnd(256));
+	l = newlab();
+	BR(0xa, l);
+	W(0x0009);
+	POOL();
+	LAB(l);
+
+	top = newlab();
+	LAB(top);
+	for (i = 0; i < 6; i++) {
+		sh2_block(0, 40);
+		l = newlab();
+		BR(0xa, l);
+		W(0x0009);
+		POOL();
+		LAB(l);
+	}
+	l = newlab();
+	W(0x4b10);				// dt r11
+	BR(0x89, l);
+	LIT(14, 0, 4, top);
+	W(0x4e2b);				// jmp @r14
+	W(0x0009);
+	POOL();
+	LAB(l);
+
+	// store the registers and spin
+	LIT(14, 0x06030000, 4, -1);
+	for (i = 0; i < 16; i++) {
+		W(0x2e02 | i << 4);
+		W(0x7e04);
+	}
+	W(0x0002);				// stc sr,r0
+	W(0x010a);				// sts mach,r1
+	W(0x021a);				// sts macl,r2
+	LIT(14, 0x06030100, 4, -1);
+	for (i = 0; i < 3; i++) {
+		W(0x2e02 | i << 4);
+		W(0x7e04);
+	}
+	l = newlab();
+	LAB(l);
+	BR(0xa, l);
+	W(0x0009);
+	POOL();
+
+	for (i = 0; i < 4; i++) {
+		LAB(sh2_subs[i]);
+		sh2_block(1, 12);
+		W(0x000b);			// rts
+		W(0x0009);
+		POOL();
+	}
+
+	sh2_assemble();
+	for (i = 0; i < sh2_pc; i++)
+		w16(SH2_CODE + i * 2, sh2[i]);
+}
+
+/* ------------------------------------------------------------------ */
+/* sms, md z80 */
+
+#define Z80_BASE	0x200	// main code
+
+static unsigned char *z80;	// z80 address space image
+static int z80_pc, z80_md;
+
+static void E(int n, ...)
+{
+	va_list ap;
+
+	va_start(ap, n);
+	while (n-- > 0)
+		z80[z80_pc++] = va_arg(ap, int);
+	va_end(ap);
+}
+
+// high byte of a RAM address, sms RAM is at c000, md z80 RAM at 0
+static int H(int x)
+{
+	if (!z80_md)
+		return x;
+	switch (x) {
+	case 0xc0: return 0x1e;
+	case 0xdf: return 0x1f;
+	default:   return x - 0xb0;	// c1-c8 -> 11-18
+	}
+}
+
+static void hl_ram(void)
+{
+	E(3, 0x21, rnd(0xe0), H(0xc1));
+}
+
+static void z80_simple(void)
+{
+	static const unsigned char alu_imm[] = { 0xc6, 0xce, 0xd6, 0xde, 0xe6, 0xee, 0xf6, 0xfe };
+	static const unsigned char op16[] = { 0x03, 0x13, 0x23, 0x0b, 0x1b, 0x2b, 0x09, 0x19, 0x29, 0x39 };
+	static const unsigned char misc[] = { 0x07, 0x0f, 0x17, 0x1f, 0x27, 0x2f, 0x37, 0x3f, 0x08, 0xd9, 0xeb, 0x00 };
+	static const unsigned char push[] = { 0xc5, 0xd5, 0xe5, 0xf5 };
+	static const unsigned char pop[] = { 0xc1, 0xd1, 0xe1, 0xf1 };
+	static const unsigned char adc16[] = { 0x4a, 0x5a, 0x6a, 0x7a, 0x42, 0x52, 0x62, 0x72 };
+	static const unsigned char ld_ir[] = { 0x57, 0x5f, 0x47 };
+	static const unsigned char blk[] = { 0xb0, 0xa0, 0xa1, 0xb1, 0xa8 };
+	static const unsigned char ldnn[] = { 0x43, 0x53, 0x63, 0x4b, 0x5b, 0x6b };
+	static const unsigned char ld_i[] = { 0x46, 0x4e, 0x56, 0x5e, 0x66, 0x6e, 0x7e,
+		0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x77 };
+	static const unsigned char xy16[] = { 0x09, 0x19, 0x29, 0x39, 0x23, 0x2b };
+	static const unsigned char xy8[] = { 0x44, 0x45, 0x4c, 0x4d, 0x54, 0x5d, 0x60,
+		0x61, 0x67, 0x6c, 0x6f, 0x7c, 0x7d, 0x84, 0x85, 0x8c, 0x94, 0xa5, 0xac,
+		0xb4, 0xbd, 0x24, 0x25, 0x2c, 0x2d };
+	static const unsigned char ld_abs[] = { 0x32, 0x3a, 0x22, 0x2a };
+	static const unsigned char in_port[] = { 0x7e, 0x7f, 0xdd, 0xdc };
+	int k = rnd(30), op, r, p, d;
+
+	// one rnd() per call, argument order is up to the compiler
+
+	if (k < 6) {
+		// ld r,r' and alu a,r
+		op = 0x40 + rnd(0x80);
+		if (op == 0x76)
+			op = 0x78;
+		if ((op & 7) == 6 || (op & 0xf8) == 0x70)
+			hl_ram();
+		E(1, op);
+	}
+	else if (k < 8) {
+		op = pick(alu_imm);
+		E(2, op, rnd(256));
+	}
+	else if (k < 10) {
+		// inc/dec r
+		r = rnd(8);
+		if (r == 6)
+			hl_ram();
+		E(1, r << 3 | (rnd(2) ? 4 : 5));
+	}
+	else if (k < 11) {
+		r = rnd(8);
+		if (r == 6)
+			hl_ram();
+		E(2, r << 3 | 6, rnd(256));
+	}
+	else if (k < 13) {
+		if (rnd(6) == 0) {
+			E(1, rnd(2) ? 0x01 : 0x11);
+			E(1, rnd(256));
+			E(1, rnd(256));
+		}
+		else
+			E(1, pick(op16));
+	}
+	else if (k < 15)
+		E(1, pick(misc));
+	else if (k < 16) {
+		op = pick(push);
+		E(2, op, pick(pop));
+	}
+	else if (k < 17)
+		E(1, 0xe3);				// ex (sp),hl
+	else if (k < 19) {
+		op = rnd(256);
+		if ((op & 7) == 6)
+			hl_ram();
+		E(2, 0xcb, op);
+	}
+	else if (k < 21) {
+		switch (rnd(7)) {
+		case 0: E(2, 0xed, 0x44); break;	// neg
+		case 1: E(2, 0xed, pick(adc16)); break;
+		case 2: hl_ram(); E(2, 0xed, rnd(2) ? 0x67 : 0x6f); break;
+		case 3: E(2, 0xed, pick(ld_ir)); break;
+		case 4:
+			// block ops on RAM
+			E(3, 0x01, rnd(7) + 1, 0);
+			hl_ram();
+			E(3, 0x11, rnd(0x80), H(0xc4));
+			E(2, 0xed, pick(blk));
+			break;
+		case 5:
+			op = pick(ldnn);
+			E(4, 0xed, op, rnd(0x80), H(0xc5));
+			break;
+		case 6: E(2, 0xed, 0x56); break;	// im 1
+		}
+	}
+	else if (k < 25) {
+		p = rnd(2) ? 0xdd : 0xfd;
+		d = (rnd(0x80) - 0x40) & 0xff;
+		E(4, p, 0x21, 0x80, H(p == 0xdd ? 0xc2 : 0xc3));
+		switch (rnd(9)) {
+		case 0: E(3, p, pick(ld_i), d); break;
+		case 1: E(3, p, 0x86 | rnd(8) << 3, d); break;
+		case 2: E(3, p, rnd(2) ? 0x34 : 0x35, d); break;
+		case 3: E(4, p, 0x36, d, rnd(256)); break;
+		case 4: E(2, p, pick(xy16)); break;
+		case 5: E(4, p, 0xcb, d, rnd(256)); break;
+		case 6: E(2, p, pick(xy8)); break;
+		case 7: E(6, p, 0xe5, p, 0xe1, p, 0xe3); break;
+		case 8: E(3, p, 0x26, rnd(256)); break;
+		}
+	}
+	else if (k < 26) {
+		E(3, 0x01, rnd(0xe0), H(0xc1));
+		E(1, rnd(2) ? 0x0a : 0x02);		// ld a,(bc) / ld (bc),a
+	}
+	else if (k < 27) {
+		op = pick(ld_abs);
+		E(3, op, rnd(0x80), H(0xc6));
+	}
+	else if (k < 28)
+		E(2, 0xdb, pick(in_port));
+	else if (k < 29)
+		E(4, 0x3e, rnd(256) | 0x90, 0xd3, 0x7f);	// psg volume
+	else
+		E(4, 0x0e, 0x7e, 0xed, 0x78);		// in a,(c)
+}
+
+static void z80_block(void)
+{
+	static const unsigned char jr[] = { 0x18, 0x20, 0x28, 0x30, 0x38 };
+	static const unsigned char loop[] = { 0x3c, 0x87, 0x8f, 0x2f, 0x81 };
+	static const unsigned char call[] = { 0xcd, 0xc4, 0xcc, 0xd4, 0xdc };
+	static const unsigned char jp[] = { 0xc2, 0xca, 0xd2, 0xda, 0xe2, 0xea, 0xf2, 0xfa, 0xc3 };
+	int k = rnd(10), i, p, t;
+
+	if (k < 6) {
+		for (i = rnd(7) + 1; i > 0; i--)
+			z80_simple();
+	}
+	else if (k < 7) {
+		// forward jr
+		E(2, pick(jr), 0);
+		p = z80_pc;
+		for (i = rnd(3) + 1; i > 0; i--)
+			z80_simple();
+		z80[p - 1] = z80_pc - p;
+	}
+	else if (k < 8) {
+		// djnz loop
+		E(2, 0x06, rnd(5) + 1);
+		t = z80_pc;
+		for (i = rnd(2) + 1; i > 0; i--)
+			E(1, pick(loop));
+		E(2, 0x10, (t - z80_pc - 2) & 0xff);
+	}
+	else if (k < 9)
+		E(3, pick(call), 0x00, 0x01);
+	else {
+		// forward jp
+		E(3, pick(jp), 0, 0);
+		p = z80_pc;
+		for (i = rnd(2) + 1; i > 0; i--)
+			z80_simple();
+		z80[p - 2] = z80_pc;
+		z80[p - 1] = z80_pc >> 8;
+	}
+}
+
+// Writes code to RAM and runs it, maps ROM banks and calls into them,
+// jumps around through rst and jp (hl), saving the registers after each
+// block. The main loop never ends, the irq handler counts frames.
+static void make_z80(int md)
+{
+	static const unsigned char sub[] = { 0x3c, 0x80, 0xc0, 0x04, 0xc9 };
+	// copied to RAM at c800: one with an operand changed by its callers,
+	// one changing an operand of its own right before running it
+	static const unsigned char smc[] = { 0x3e, 0x11, 0x80, 0xc9, 0, 0, 0, 0,
+		0x21, 0x0e, 0xc8, 0x34, 0x00, 0x3e, 0x00, 0x80, 0xc9 };
+	int end = md ? 0x1a00 : 0x3f00;
+	int i, n, top, slot;
+
+	z80_md = md;
+	z80 = calloc(0x10000, 1);
+	if (z80 == NULL)
+		fail("out of memory");
+
+	// start: di, sp, im 1, vdp irq on, copy the smc routines, ei
+	z80_pc = 0;
+	E(7, 0xf3, 0x31, 0xf0, H(0xdf), 0xc3, 0x50, 0x00);
+	z80_pc = 0x50;
+	E(10, 0xed, 0x56, 0x3e, 0x60, 0xd3, 0xbf, 0x3e, 0x81, 0xd3, 0xbf);
+	E(15, 0x21, 0x80, 0x01, 0x11, 0x00, H(0xc8), 0x01, 0x20, 0x00, 0xed, 0xb0, 0xfb,
+		0xc3, Z80_BASE & 0xff, Z80_BASE >> 8);
+	// rst 08, rst 10
+	z80_pc = 0x08;
+	E(3, 0x2c, 0xa5, 0xc9);
+	z80_pc = 0x10;
+	E(3, 0x1d, 0x83, 0xc9);
+	// irq: ack the vdp, count
+	z80_pc = 0x38;
+	E(13, 0xf5, 0xe5, 0xdb, 0xbf, 0x21, 0x00, H(0xc0), 0x34, 0xe1, 0xf1, 0xfb, 0xed, 0x4d);
+	memcpy(z80 + 0x100, sub, sizeof(sub));
+	memcpy(z80 + 0x180, smc, sizeof(smc));
+	z80[0x18a] = H(0xc8);
+
+	z80_pc = top = Z80_BASE;
+	for (n = 0; n < 60 && z80_pc < end - 0x100; n++) {
+		z80_block();
+		if (rnd(5) == 0)
+			E(1, rnd(2) ? 0xcf : 0xd7);
+		if (rnd(7) == 0)
+			// bump the smc routine's operand and call it
+			E(7, 0x21, 0x01, H(0xc8), 0x34, 0xcd, 0x00, H(0xc8));
+		if (rnd(7) == 0)
+			E(3, 0xcd, 0x08, H(0xc8));
+		if (rnd(10) == 0)
+			E(4, 0x21, (z80_pc + 4) & 0xff, (z80_pc + 4) >> 8, 0xe9);
+		if (!md && rnd(8) == 0)
+			// map bank 2 or 3 at 8000 and call what's there
+			E(8, 0x3e, rnd(2) + 2, 0x32, 0xff, 0xff, 0xcd, 0x00, 0x80);
+		if (!md && rnd(8) == 0)
+			// map bank 1-3 at 4000, call code running into it
+			E(8, 0x3e, rnd(3) + 1, 0x32, 0xfe, 0xff, 0xcd, 0xfc, 0x3f);
+		// save the registers to a slot of this block
+		slot = (md ? 0x1a00 : 0xd000) + n * 16;
+		E(3, 0x32, slot & 0xff, slot >> 8);
+		E(4, 0xed, 0x43, (slot + 2) & 0xff, (slot + 2) >> 8);
+		E(4, 0xed, 0x53, (slot + 4) & 0xff, (slot + 4) >> 8);
+		E(3, 0x22, (slot + 6) & 0xff, (slot + 6) >> 8);
+		E(4, 0xdd, 0x22, (slot + 8) & 0xff, (slot + 8) >> 8);
+		E(4, 0xfd, 0x22, (slot + 10) & 0xff, (slot + 10) >> 8);
+		E(5, 0xf5, 0xe1, 0x22, (slot + 12) & 0xff, (slot + 12) >> 8);
+		E(7, 0xed, 0x73, 0xe0, H(0xc0), 0x31, 0xf0, H(0xdf));
+	}
+	E(7, 0x21, 0x02, H(0xc0), 0x34, 0xc3, top & 0xff, top >> 8);
+	if (z80_pc > end)
+		fail("z80 code too large");
+
+	if (!md) {
+		rom_size = 0x10000;
+		rom = z80;
+		memcpy(rom + 0x7ff0, "TMR SEGA", 8);
+		// end of bank 0 and banks 1-3, for the mapper
+		memset(rom + 0x3ffc, 0x3c, 4);		// inc a
+		rom[0x4000] = 0xa8;			// xor b
+		rom[0x4001] = 0xc9;
+		rom[0x8000] = 0x80;			// add a,b
+		rom[0x8001] = 0xc9;
+		rom[0xc000] = 0x07;			// rlca
+		rom[0xc001] = 0xa9;			// xor c
+		rom[0xc002] = 0xc9;
+		return;
+	}
+
+	// md: the 68k loads the z80 and spins with vint on
+	rom_size = 0x20000;
+	rom = calloc(rom_size, 1);
+	if (rom == NULL)
+		fail("out of memory");
+	w32(0, 0x00ff0000);
+	w32(4, 0x200);
+	for (i = 2; i < 64; i++)
+		w32(i * 4, 0x180);
+	memcpy(rom + 0x100, "SEGA MEGA DRIVE ", 16);
+	w16(0x180, 0x4e73);				// rte
+	i = 0x200;
+	w16(i, 0x46fc); w16(i + 2, 0x2700); i += 4;	// move.w #$2700,sr
+	w16(i, 0x33fc); w16(i + 2, 0x0100); w32(i + 4, 0xa11100); i += 8; // busreq
+	w16(i, 0x33fc); w16(i + 2, 0x0100); w32(i + 4, 0xa11200); i += 8; // reset off
+	w16(i, 0x41f9); w32(i + 2, 0x1000); i += 6;	// lea $1000,a0
+	w16(i, 0x43f9); w32(i + 2, 0xa00000); i += 6;	// lea $a00000,a1
+	w16(i, 0x303c); w16(i + 2, 0x19ff); i += 4;	// move.w #$19ff,d0
+	w16(i, 0x12d8); w16(i + 2, 0x51c8); w16(i + 4, 0xfffc); i += 6; // copy
+	w16(i, 0x33fc); w16(i + 2, 0x0000); w32(i + 4, 0xa11200); i += 8; // reset
+	w16(i, 0x33fc); w16(i + 2, 0x0000); w32(i + 4, 0xa11100); i += 8; // release
+	w16(i, 0x33fc); w16(i + 2, 0x0100); w32(i + 4, 0xa11200); i += 8; // run
+	w16(i, 0x33fc); w16(i + 2, 0x8174); w32(i + 4, 0xc00004); i += 8; // vint on
+	w16(i, 0x46fc); w16(i + 2, 0x2000); i += 4;	// move.w #$2000,sr
+	w16(i, 0x5281); w16(i + 2, 0x60fc);		// addq.l #1,d1; bra
+	memcpy(rom + 0x1000, z80, 0x1a00);
+	free(z80);
+}
+
+/* ------------------------------------------------------------------ */
+/* 68k */
+
+#define M68K_CODE	0x1000	// in ROM, copied to M68K_RAM for 68kram
+#define M68K_CSIZE	0x6000
+#define M68K_RAM	0xff9000
+#define M68K_SLOTS	0xff0100	// registers after each block, 64 bytes each
+#define M68K_DATA	0xff2000	// A0-A3 point in here, +-0x1000 around it
+
+static unsigned short *m68k;	// code, in words
+static int m68k_pc, m68k_base, m68k_ram;
+static int m68k_subs[4], m68k_smc_sub;
+
+struct ea68 {
+	int f;			// mode and register
+	int n;			// extension words
+	unsigned short x[2];
+};
+
+static void M(int n, ...)
+{
+	va_list ap;
+
+	va_start(ap, n);
+	while (n-- > 0) {
+		if (m68k_pc >= M68K_CSIZE / 2)
+			fail("68k code too large");
+		m68k[m68k_pc++] = va_arg(ap, int);
+	}
+	va_end(ap);
+}
+
+// address of the next word when running
+static unsigned int m68k_addr(void)
+{
+	return m68k_base + m68k_pc * 2;
+}
+
+static void M_ea(const struct ea68 *e)
+{
+	int i;
+
+	for (i = 0; i < e->n; i++)
+		M(1, e->x[i]);
+}
+
+static void M_abs(unsigned int a)
+{
+	M(2, a >> 16, a & 0xffff);
+}
+
+// A0-A3 are pointers into M68K_DATA, A3 for bytes only since (A3)+ and
+// -(A3) leave it odd. A4/A5 take anything, but are never used for
+// addressing. D6 counts loops, D7 is scratch for divisors and indexes,
+// the rest of the code only writes D0-D5.
+static int m68k_areg(int sz)
+{
+	return sz == 1 ? rnd(4) : rnd(3);
+}
+
+static void ea_dreg(struct ea68 *e, int r)
+{
+	e->f = r;
+	e->n = 0;
+}
+
+// memory operand, pc relative and immediates only if rd
+static void ea_mem(struct ea68 *e, int sz, int rd)
+{
+	int a = m68k_areg(sz), v;
+
+	e->n = 0;
+	switch (rnd(rd ? 9 : 7)) {
+	case 0: e->f = 0x10 | a; break;
+	case 1: e->f = 0x18 | (sz == 1 ? 3 : a); break;
+	case 2: e->f = 0x20 | (sz == 1 ? 3 : a); break;
+	case 3:
+		e->f = 0x28 | a;
+		e->x[e->n++] = (rnd(0x800) - 0x400) & ~1;
+		break;
+	case 4:
+		// d8(An,D7.w), with D7 made an even index first
+		M(2, 0x0247, 0x0ffe);			// andi.w #$ffe,d7
+		e->f = 0x30 | a;
+		e->x[e->n++] = 0x7000 | (rnd(0x100) & 0xfe);
+		break;
+	case 5:
+		e->f = 0x38;
+		e->x[e->n++] = 0x8000 | (rnd(0x1000) & (sz == 1 ? ~0 : ~1));
+		break;
+	case 6:
+		e->f = 0x39;
+		e->x[e->n++] = 0x00ff;
+		e->x[e->n++] = 0x8000 | (rnd(0x1000) & (sz == 1 ? ~0 : ~1));
+		break;
+	case 7:
+		e->f = 0x3a;
+		e->x[e->n++] = (rnd(0x200) - 0x100) & ~1;
+		break;
+	case 8:
+		e->f = 0x3c;
+		v = rnd(0);
+		if (sz == 4)
+			e->x[e->n++] = v >> 16;
+		e->x[e->n++] = sz == 1 ? v & 0xff : v & 0xffff;
+		break;
+	}
+}
+
+static void ea_src(struct ea68 *e, int sz)
+{
+	switch (rnd(4)) {
+	case 0:
+	case 1: ea_dreg(e, rnd(8)); break;
+	case 2:
+		if (sz != 1) {
+			e->f = 0x08 | rnd(6);
+			e->n = 0;
+			break;
+		}
+		// fallthrough
+	default: ea_mem(e, sz, 1); break;
+	}
+}
+
+static void ea_dst(struct ea68 *e, int sz)
+{
+	if (rnd(2))
+		ea_dreg(e, rnd(6));
+	else
+		ea_mem(e, sz, 0);
+}
+
+static void m68k_simple(void)
+{
+	static const unsigned short alu[] = { 0x8000, 0x9000, 0xb000, 0xc000, 0xd000 };
+	static const unsigned short imm[] = { 0x0000, 0x0200, 0x0400, 0x0600, 0x0a00, 0x0c00 };
+	static const unsigned short unary[] = { 0x4000, 0x4200, 0x4400, 0x4600, 0x4a00 };
+	static const unsigned short ccr[] = { 0x003c, 0x023c, 0x0a3c };
+	static const unsigned short sr[] = { 0x007c, 0x027c, 0x0a7c };
+	static const int szs[] = { 1, 2, 4 };
+	static const int move_sz[] = { 1, 3, 2 };
+	struct ea68 e, e2;
+	int k = rnd(32), s, sz, op, r, v;
+
+	// one rnd() per call, argument order is up to the compiler
+
+	s = rnd(3);
+	sz = szs[s];
+	if (k < 5) {
+		// move, movea to A4/A5
+		ea_src(&e, sz);
+		if (sz != 1 && rnd(6) == 0) {
+			r = rnd(2) + 4;
+			M(1, move_sz[s] << 12 | r << 9 | 0x40 | e.f);
+			M_ea(&e);
+			return;
+		}
+		ea_dst(&e2, sz);
+		M(1, move_sz[s] << 12 | (e2.f & 7) << 9 | (e2.f & 0x38) << 3 | e.f);
+		M_ea(&e);
+		M_ea(&e2);
+	}
+	else if (k < 6) {
+		r = rnd(6);
+		M(1, 0x7000 | r << 9 | rnd(256));	// moveq
+	}
+	else if (k < 10) {
+		// or/sub/cmp/and/add <ea>,Dn and Dn,<ea>, eor Dn,<ea>
+		op = pick(alu);
+		r = rnd(6);
+		v = rnd(3);
+		if (v == 0 && op != 0xb000) {
+			ea_mem(&e, sz, 0);
+			M(1, op | r << 9 | (s + 4) << 6 | e.f);
+		}
+		else if (v == 1) {
+			ea_dst(&e, sz);
+			M(1, 0xb000 | rnd(8) << 9 | (s + 4) << 6 | e.f);
+		}
+		else {
+			ea_src(&e, sz);
+			if ((op == 0x8000 || op == 0xc000) && (e.f & 0x38) == 0x08)
+				e.f &= 7;
+			M(1, op | r << 9 | s << 6 | e.f);
+		}
+		M_ea(&e);
+	}
+	else if (k < 12) {
+		// immediates
+		op = pick(imm);
+		v = rnd(0);
+		ea_dst(&e, sz);
+		M(1, op | s << 6 | e.f);
+		if (sz == 4)
+			M(1, v >> 16);
+		M(1, sz == 1 ? v & 0xff : v & 0xffff);
+		M_ea(&e);
+	}
+	else if (k < 14) {
+		// addq/subq, also on A4/A5
+		v = rnd(16);
+		if (sz != 1 && rnd(4) == 0)
+			ea_dreg(&e, 0x08 | (rnd(2) + 4));
+		else
+			ea_dst(&e, sz);
+		M(1, 0x5000 | (v & 7) << 9 | (v & 8) << 5 | s << 6 | e.f);
+		M_ea(&e);
+	}
+	else if (k < 15) {
+		op = pick(unary);
+		ea_dst(&e, sz);
+		M(1, op | s << 6 | e.f);
+		M_ea(&e);
+	}
+	else if (k < 16) {
+		r = rnd(6);
+		switch (rnd(6)) {
+		case 0: M(1, 0x4880 | r); break;	// ext.w
+		case 1: M(1, 0x48c0 | r); break;	// ext.l
+		case 2: M(1, 0x4840 | r); break;	// swap
+		case 3: M(1, 0xc140 | r << 9 | rnd(6)); break; // exg dx,dy
+		case 4: M(1, 0xc188 | r << 9 | (rnd(2) + 4)); break; // exg dx,ay
+		case 5: M(1, 0xc148 | (r % 2 + 4) << 9 | 5); break; // exg a4/a5,a5
+		}
+	}
+	else if (k < 17) {
+		// mulu/muls
+		ea_src(&e, 2);
+		if ((e.f & 0x38) == 0x08)
+			e.f &= 7;
+		r = rnd(6);
+		M(1, (rnd(2) ? 0xc0c0 : 0xc1c0) | r << 9 | e.f);
+		M_ea(&e);
+	}
+	else if (k < 18) {
+		// divu/divs, never by 0
+		r = rnd(6);
+		if (rnd(2)) {
+			v = rnd(0x10000);
+			M(2, (rnd(2) ? 0x80fc : 0x81fc) | r << 9, v | 1);
+		}
+		else {
+			v = rnd(8);
+			M(1, 0x3e00 | v);			// move.w dv,d7
+			M(2, 0x0047, 0x0001);			// ori.w #1,d7
+			M(1, (rnd(2) ? 0x80c7 : 0x81c7) | r << 9);
+		}
+	}
+	else if (k < 20) {
+		// shifts and rotates, by a count or register, and on memory
+		v = rnd(4);
+		if (v == 3) {
+			ea_mem(&e, 2, 0);
+			op = 0xe0c0 | rnd(4) << 9;
+			M(1, op | rnd(2) << 8 | e.f);
+			M_ea(&e);
+		}
+		else {
+			op = 0xe000 | rnd(8) << 9;
+			op |= rnd(2) << 8;
+			op |= s << 6 | (v == 2) << 5;
+			op |= rnd(4) << 3;
+			M(1, op | rnd(6));
+		}
+	}
+	else if (k < 22) {
+		// btst/bchg/bclr/bset, static and dynamic
+		v = rnd(4);
+		if (rnd(2))
+			ea_dreg(&e, v == 0 ? rnd(8) : rnd(6));
+		else
+			ea_mem(&e, 1, v == 0);
+		if (rnd(2)) {
+			r = rnd(8);
+			M(1, 0x0100 | r << 9 | v << 6 | e.f);
+		}
+		else {
+			if (e.f == 0x3c)			// no btst #n,#imm
+				ea_dreg(&e, rnd(8));
+			M(2, 0x0800 | v << 6 | e.f, rnd(64));
+		}
+		M_ea(&e);
+	}
+	else if (k < 23) {
+		// scc
+		ea_dst(&e, 1);
+		M(1, 0x50c0 | rnd(16) << 8 | e.f);
+		M_ea(&e);
+	}
+	else if (k < 25) {
+		// addx/subx/abcd/sbcd/nbcd/negx, on registers and -(An)
+		r = rnd(6);
+		v = rnd(6);
+		switch (rnd(5)) {
+		case 0: M(1, 0xd100 | r << 9 | s << 6 | rnd(8)); break;
+		case 1: M(1, 0x9100 | r << 9 | s << 6 | rnd(8)); break;
+		case 2:
+			v = sz == 1 ? 3 : v % 3;
+			r = sz == 1 ? 3 : r % 3;
+			M(1, (rnd(2) ? 0xd108 : 0x9108) | r << 9 | s << 6 | v);
+			break;
+		case 3:
+			op = rnd(2) ? 0xc100 : 0x8100;
+			if (rnd(2))
+				M(1, op | r << 9 | v);
+			else
+				M(1, op | 3 << 9 | 8 | 3);
+			break;
+		case 4:
+			ea_dst(&e, 1);
+			M(1, 0x4800 | e.f);
+			M_ea(&e);
+			break;
+		}
+	}
+	else if (k < 26) {
+		// ccr and sr, S stays set and T clear
+		v = rnd(0x10000);
+		switch (rnd(5)) {
+		case 0: M(2, pick(ccr), v & 0x1f); break;
+		case 1:
+			op = pick(sr);
+			M(2, op, op == 0x027c ? (v | 0x2000) & 0x271f : v & 0x071f);
+			break;
+		case 2:
+			ea_src(&e, 2);
+			if ((e.f & 0x38) == 0x08)
+				e.f &= 7;
+			M(1, 0x44c0 | e.f);			// move <ea>,ccr
+			M_ea(&e);
+			break;
+		case 3: M(2, 0x46fc, 0x2000 | (v & 0x071f)); break; // move #,sr
+		case 4:
+			ea_dst(&e, 2);
+			M(1, 0x40c0 | e.f);			// move sr,<ea>
+			M_ea(&e);
+			break;
+		}
+	}
+	else if (k < 27) {
+		// movem, loads only to D0-D5/A4/A5
+		v = rnd(0x10000);
+		r = m68k_areg(2);
+		switch (rnd(4)) {
+		case 0: M(2, 0x48a0 | (s == 2) << 6 | r, v & 0xfffe); break; // -(An)
+		case 1: M(2, 0x4890 | (s == 2) << 6 | r, v & 0x7fff); break; // (An)
+		case 2: M(2, 0x4c98 | (s == 2) << 6 | r, v & 0x303f); break; // (An)+
+		case 3:
+			M(3, 0x4ca8 | (s == 2) << 6 | r, v & 0x303f, (rnd(0x800) - 0x400) & ~1);
+			break;
+		}
+	}
+	else if (k < 28) {
+		// movep
+		r = rnd(6);
+		v = rnd(4);
+		op = 0x0108 | r << 9 | (v + 4) << 6 | rnd(4);
+		M(2, op, rnd(0x400));
+	}
+	else if (k < 29) {
+		// lea/pea into A4/A5, tas, cmpm, link/unlk
+		switch (rnd(5)) {
+		case 0:
+			ea_mem(&e, 2, 1);
+			if (e.f == 0x3c || (e.f & 0x38) == 0x18 || (e.f & 0x38) == 0x20) {
+				e.f = 0x10 | (e.f & 3);
+				e.n = 0;
+			}
+			M(1, 0x41c0 | (rnd(2) + 4) << 9 | e.f);
+			M_ea(&e);
+			break;
+		case 1:
+			ea_mem(&e, 2, 1);
+			if (e.f == 0x3c || (e.f & 0x38) == 0x18 || (e.f & 0x38) == 0x20) {
+				e.f = 0x10 | (e.f & 3);
+				e.n = 0;
+			}
+			M(1, 0x4840 | e.f);
+			M_ea(&e);
+			M(1, 0x285f);				// movea.l (sp)+,a4
+			break;
+		case 2:
+			ea_dst(&e, 1);
+			M(1, 0x4ac0 | e.f);
+			M_ea(&e);
+			break;
+		case 3:
+			r = sz == 1 ? 3 : rnd(3);
+			v = sz == 1 ? 3 : rnd(3);
+			M(1, 0xb108 | r << 9 | s << 6 | v);
+			break;
+		case 4:
+			v = rnd(8);
+			M(3, 0x4e55, -(v * 2 + 2) & 0xffff, 0x4e5d);
+			break;
+		}
+	}
+	else if (k < 30) {
+		// adda/suba/cmpa on A4/A5
+		static const unsigned short aop[] = { 0xd0c0, 0x90c0, 0xb0c0 };
+		sz = rnd(2) ? 2 : 4;
+		ea_src(&e, sz);
+		op = pick(aop);
+		M(1, op | (rnd(2) + 4) << 9 | (sz == 4) << 8 | e.f);
+		M_ea(&e);
+	}
+	else if (k < 31) {
+		// the HV counter, the cycle counts must match
+		r = rnd(6);
+		M(3, 0x3039 | r << 9, 0x00c0, 0x0008);
+	}
+	else
+		M(1, 0x4e71);
+}
+
+static void m68k_branch_w(int op, unsigned int to)
+{
+	unsigned int at = m68k_addr();
+	M(2, op, (to - at - 2) & 0xffff);
+}
+
+// 68kram: change an operand or an opcode a bit further on, usually in
+// the same translated block, or the operand of a routine before calling it
+static void m68k_smc(void)
+{
+	int r = rnd(6), at, i;
+
+	switch (rnd(3)) {
+	case 0:
+		M(1, 0x5079 | rnd(8) << 9);		// addq.w #n,(xxx).l
+		at = m68k_pc;
+		M(2, 0, 0);
+		for (i = rnd(3); i > 0; i--)
+			m68k_simple();
+		M(1, 0x0640 | r);			// addi.w #n,dr
+		m68k[at] = m68k_addr() >> 16;
+		m68k[at + 1] = m68k_addr();
+		M(1, rnd(0x10000));
+		break;
+	case 1:
+		// addq.w #1,dr <-> subq.w #1,dr
+		M(2, 0x0a79, 0x0100);			// eori.w #$100,(xxx).l
+		at = m68k_pc;
+		M(2, 0, 0);
+		for (i = rnd(3); i > 0; i--)
+			m68k_simple();
+		m68k[at] = m68k_addr() >> 16;
+		m68k[at + 1] = m68k_addr();
+		M(1, 0x5240 | r);
+		break;
+	case 2:
+		M(1, 0x33c0 | r);			// move.w dr,(sub+2).l
+		M_abs(m68k_smc_sub + 2);
+		M(1, 0x4eb9);				// jsr sub
+		M_abs(m68k_smc_sub);
+		break;
+	}
+}
+
+static void m68k_block(int depth)
+{
+	int k = rnd(12), i, cc, p, t;
+
+	if (k < 6) {
+		for (i = rnd(7) + 1; i > 0; i--)
+			m68k_simple();
+	}
+	else if (k < 7) {
+		// forward bcc.s/bcc.w, not bsr
+		cc = rnd(15);
+		cc += cc != 0;
+		if (rnd(2)) {
+			M(1, 0x6000 | cc << 8);
+			p = m68k_pc;
+			for (i = rnd(3) + 1; i > 0; i--)
+				m68k_simple();
+			m68k[p - 1] |= (m68k_pc - p) * 2;
+		}
+		else {
+			M(2, 0x6000 | cc << 8, 0);
+			p = m68k_pc;
+			for (i = rnd(3) + 1; i > 0; i--)
+				m68k_simple();
+			m68k[p - 1] = (m68k_pc - p + 1) * 2;
+		}
+	}
+	else if (k < 8 && depth == 0) {
+		// dbcc loop on d6
+		M(1, 0x7c00 | rnd(16));			// moveq #n,d6
+		t = m68k_addr();
+		for (i = rnd(3) + 1; i > 0; i--)
+			m68k_block(depth + 1);
+		m68k_branch_w(0x50ce | rnd(16) << 8, t);
+	}
+	else if (k < 9) {
+		t = m68k_subs[rnd(4)];
+		switch (rnd(3)) {
+		case 0: m68k_branch_w(0x6100, t); break;	// bsr.w
+		case 1: M(1, 0x4eb9); M_abs(t); break;		// jsr (xxx).l
+		case 2:
+			M(1, 0x49f9); M_abs(t);			// lea (xxx).l,a4
+			M(1, 0x4e94);				// jsr (a4)
+			break;
+		}
+	}
+	else if (k < 10) {
+		if (rnd(2)) {
+			M(3, 0x49fa, 4, 0x4ed4);		// lea 4(pc),a4; jmp (a4)
+		}
+		else {
+			M(1, 0x4ef9);				// jmp (xxx).l
+			M_abs(m68k_addr() + 4);
+		}
+	}
+	else if (k < 11 && m68k_ram)
+		m68k_smc();
+	else
+		m68k_simple();
+}
+
+// The 68k runs random code forever, from ROM or copied to RAM (ram),
+// with vblank irqs, subroutines and, in RAM, self modifying code. Its
+// registers are stored after each block, the irq handler counts frames.
+// FAME and the recompiler count cycles the same, so every frame must
+// match.
+static void make_m68k(int ram)
+{
+	int i, n, r, top, slot, loop;
+
+	m68k = calloc(M68K_CSIZE, 1);
+	if (m68k == NULL)
+		fail("out of memory");
+	m68k_ram = ram;
+	m68k_base = ram ? M68K_RAM : M68K_CODE;
+	m68k_pc = 0;
+
+	for (i = 0; i < 4; i++) {
+		m68k_subs[i] = m68k_addr();
+		for (n = rnd(4) + 1; n > 0; n--)
+			m68k_simple();
+		if (rnd(3) == 0)
+			M(2, 0x3f00 | rnd(8), 0x4e77);	// move.w dn,-(sp); rtr
+		else
+			M(1, 0x4e75);
+	}
+	m68k_smc_sub = m68k_addr();
+	M(3, 0x0640, 0, 0x4e75);			// addi.w #n,d0; rts
+
+	top = m68k_addr();
+	for (n = 0; n < 60 && m68k_pc * 2 < M68K_CSIZE - 0x800; n++) {
+		for (r = 0; r < 4; r++) {
+			M(1, 0x41f9 | r << 9);			// lea (xxx).l,ar
+			M_abs(M68K_DATA + (rnd(0x4000) & ~1));
+		}
+		for (i = rnd(5) + 4; i > 0; i--)
+			m68k_block(0);
+		// save the registers to a slot of this block
+		slot = M68K_SLOTS + n * 64;
+		M(1, 0x40f9);				// move.w sr,(xxx).l
+		M_abs(slot + 60);
+		M(2, 0x48f9, 0x7fff);			// movem.l d0-a6,(xxx).l
+		M_abs(slot);
+		M(2, 0x46fc, 0x2000);			// move.w #$2000,sr
+	}
+	M(1, 0x52b9);					// addq.l #1,$ff0004
+	M_abs(0xff0004);
+	M(1, 0x4ef9);
+	M_abs(top);
+
+	rom_size = 0x20000;
+	rom = calloc(rom_size, 1);
+	if (rom == NULL)
+		fail("out of memory");
+	w32(0, 0x00ff0100);
+	w32(4, 0x200);
+	for (i = 2; i < 64; i++)
+		w32(i * 4, i >= 24 && i < 32 ? 0x188 : 0x190);
+	w32(30 * 4, 0x180);
+	memcpy(rom + 0x100, "SEGA MEGA DRIVE ", 16);
+	w16(0x180, 0x52b9); w32(0x182, 0xff0000);	// addq.l #1,$ff0000
+	w16(0x186, 0x4e73);				// rte
+	w16(0x188, 0x4e73);
+	// anything else is a bug in this file, count it and hang
+	w16(0x190, 0x5279); w32(0x192, 0xff0008);	// addq.w #1,$ff0008
+	w16(0x196, 0x60fe);
+	i = 0x200;
+	w16(i, 0x46fc); w16(i + 2, 0x2700); i += 4;	// move.w #$2700,sr
+	if (ram) {
+		w16(i, 0x41f9); w32(i + 2, M68K_CODE); i += 6;	// lea $1000,a0
+		w16(i, 0x43f9); w32(i + 2, M68K_RAM); i += 6;	// lea $ff9000,a1
+		w16(i, 0x303c); w16(i + 2, M68K_CSIZE / 4 - 1); i += 4; // move.w #n,d0
+		loop = i;
+		w16(i, 0x22d8); i += 2;			// move.l (a0)+,(a1)+
+		w16(i, 0x51c8); w16(i + 2, loop - i - 2); i += 4; // dbf d0,loop
+	}
+	w16(i, 0x33fc); w16(i + 2, 0x8174); w32(i + 4, 0xc00004); i += 8; // vint on
+	for (r = 0; r < 8; r++) {
+		w16(i, 0x7000 | r << 9 | rnd(256)); i += 2;	// moveq #n,dr
+	}
+	for (r = 4; r < 6; r++) {
+		w16(i, 0x41f9 | r << 9); w32(i + 2, rnd(0)); i += 6;
+	}
+	w16(i, 0x46fc); w16(i + 2, 0x2000); i += 4;	// move.w #$2000,sr
+	w16(i, 0x4ef9); w32(i + 2, top);		// jmp top
+	for (i = 0; i < m68k_pc; i++)
+		w16(M68K_CODE + i * 2, m68k[i]);
+	free(m68k);
+}
+
+/* ------------------------------------------------------------------ */
+/* fm */
+
+#define FM_TABLE	0x1000
+#define FM_FRAMES	1000
+
+// table entries: port, reg, value
+enum { FM_P0, FM_P1, FM_PSG, FM_FRAME, FM_RESTART };
+
+static int fm_pos;
+
+static void F(int port, int reg, int v)
+{
+	if (fm_pos + 3 > rom_size)
+		fail("fm table too large");
+	rom[fm_pos++] = port;
+	rom[fm_pos++] = reg;
+	rom[fm_pos++] = v;
+}
+
+// a random write to channel c (0-5) or a global reg
+static void fm_write(void)
+{
+	int c = rnd(6), port = c / 3, k = rnd(16);
+
+	if (k < 3)
+		F(FM_P0, 0x28, (rnd(3) ? 0xf0 : 0) | (c / 3) << 2 | c % 3);
+	else if (k < 6) {
+		F(port, 0xa4 + c % 3, rnd(0x40));
+		F(port, 0xa0 + c % 3, rnd(256));
+	}
+	else if (k < 10)
+		F(port, 0x30 + rnd(6) * 0x10 + rnd(4) * 4 + c % 3, rnd(256));
+	else if (k < 11)
+		F(port, 0xb0 + c % 3, rnd(0x40));
+	else if (k < 12)
+		F(port, 0xb4 + c % 3, 0xc0 | rnd(0x40));
+	else if (k < 13)
+		F(FM_P0, 0x22, (rnd(4) ? 8 : 0) | rnd(8));
+	else if (k < 14) {
+		// ch3 special mode, timers running
+		F(FM_P0, 0x27, (rnd(2) ? 0x40 : 0) | 0x0f);
+		F(FM_P1, 0xa8 + rnd(3), rnd(256));
+	}
+	else if (k < 15)
+		F(FM_P0, rnd(2) ? 0x2b : 0x2a, rnd(256));
+	else
+		F(FM_PSG, 0, rnd(256));
+}
+
+// The 68k plays a table of random YM2612 and PSG writes, a few per
+// vblank, with the LFO on and feedback, for checking sound state saving
+// (run-ahead against normal runs, racmp.sh). The z80 is held.
+static void make_fm(void)
+{
+	int i, f, w1, w2, e, p1, other, frame;
+
+	rom_size = 0x20000;
+	rom = calloc(rom_size, 1);
+	if (rom == NULL)
+		fail("out of memory");
+	w32(0, 0x00ff0000);
+	w32(4, 0x200);
+	for (i = 2; i < 64; i++)
+		w32(i * 4, 0x180);
+	memcpy(rom + 0x100, "SEGA MEGA DRIVE ", 16);
+	w16(0x180, 0x4e73);				// rte
+	i = 0x200;
+	w16(i, 0x46fc); w16(i + 2, 0x2700); i += 4;	// move.w #$2700,sr
+	w16(i, 0x33fc); w16(i + 2, 0x0100); w32(i + 4, 0xa11100); i += 8; // busreq
+	w16(i, 0x33fc); w16(i + 2, 0x0100); w32(i + 4, 0xa11200); i += 8; // reset off
+	w16(i, 0x33fc); w16(i + 2, 0x8144); w32(i + 4, 0xc00004); i += 8; // display on
+	frame = i;
+	w16(i, 0x41f9); w32(i + 2, FM_TABLE); i += 6;	// lea table,a0
+	w1 = i;
+	w16(i, 0x3039); w32(i + 2, 0xc00004); i += 6;	// move.w $c00004,d0
+	w16(i, 0x0800); w16(i + 2, 3); i += 4;		// btst #3,d0
+	w16(i, 0x6600 | ((w1 - i - 2) & 0xff)); i += 2;	// bne.s w1
+	w2 = i;
+	w16(i, 0x3039); w32(i + 2, 0xc00004); i += 6;
+	w16(i, 0x0800); w16(i + 2, 3); i += 4;
+	w16(i, 0x6700 | ((w2 - i - 2) & 0xff)); i += 2;	// beq.s w2
+	e = i;
+	w16(i, 0x1218); w16(i + 2, 0x1418); w16(i + 4, 0x1618); i += 6; // port, reg, value
+	w16(i, 0x0c01); w16(i + 2, FM_P1); i += 4;	// cmp.b #FM_P1,d1
+	p1 = i;
+	i += 4;						// beq.s p1, bhi.s other
+	w16(i, 0x13c2); w32(i + 2, 0xa04000); i += 6;	// move.b d2,$a04000
+	w16(i, 0x13c3); w32(i + 2, 0xa04001); i += 6;	// move.b d3,$a04001
+	w16(i, 0x6000 | ((e - i - 2) & 0xff)); i += 2;	// bra.s e
+	w16(p1, 0x6700 | (i - p1 - 2));
+	w16(i, 0x13c2); w32(i + 2, 0xa04002); i += 6;
+	w16(i, 0x13c3); w32(i + 2, 0xa04003); i += 6;
+	w16(i, 0x6000 | ((e - i - 2) & 0xff)); i += 2;
+	other = i;
+	w16(p1 + 2, 0x6200 | (other - p1 - 4));
+	w16(i, 0x0c01); w16(i + 2, FM_PSG); i += 4;	// cmp.b #FM_PSG,d1
+	w16(i, 0x6608); i += 2;				// bne.s +8
+	w16(i, 0x13c3); w32(i + 2, 0xc00011); i += 6;	// move.b d3,$c00011
+	w16(i, 0x6000 | ((e - i - 2) & 0xff)); i += 2;
+	w16(i, 0x0c01); w16(i + 2, FM_FRAME); i += 4;	// cmp.b #FM_FRAME,d1
+	w16(i, 0x6700 | ((w1 - i - 2) & 0xff)); i += 2;	// beq.s w1
+	w16(i, 0x6000 | ((frame - i - 2) & 0xff));	// bra.s frame
+
+	// all channels on, audible
+	fm_pos = FM_TABLE;
+	F(FM_P0, 0x22, 0x08 | rnd(8));
+	F(FM_P0, 0x2b, 0);
+	for (i = 0; i < 6; i++) {
+		for (f = 0; f < 4; f++) {
+			F(i / 3, 0x30 + f * 4 + i % 3, rnd(256));
+			F(i / 3, 0x40 + f * 4 + i % 3, rnd(0x30));
+			F(i / 3, 0x50 + f * 4 + i % 3, 0x1f | rnd(4) << 6);
+			F(i / 3, 0x60 + f * 4 + i % 3, 0x80 | rnd(0x20));
+			F(i / 3, 0x80 + f * 4 + i % 3, rnd(256));
+		}
+		F(i / 3, 0xb0 + i % 3, rnd(0x40));
+		F(i / 3, 0xb4 + i % 3, 0xc0 | rnd(0x40));
+		F(i / 3, 0xa4 + i % 3, 0x10 | rnd(0x28));
+		F(i / 3, 0xa0 + i % 3, rnd(256));
+		F(FM_P0, 0x28, 0xf0 | (i / 3) << 2 | i % 3);
+	}
+	F(FM_FRAME, 0, 0);
+	for (f = 0; f < FM_FRAMES; f++) {
+		for (i = rnd(4); i > 0; i--)
+			fm_write();
+		F(FM_FRAME, 0, 0);
+	}
+	F(FM_RESTART, 0, 0);
+}
+
+/* ------------------------------------------------------------------ */
+/* svp */
+
+#define SSP_START	0x440	// word address, clear of "OHMP" and [30fe08] waits
+#define SSP_END		0x2700	// [30fe06] wait detection at 0x2789
+#define SSP_SAVE	0x1ff	// RAM1 word for A in loops
+#define SSP_IRAM	0x100	// IRAM routine, clear of the context probes
+
+static unsigned short *ssp;	// ROM from 0x800, in words
+static int ssp_pc;
+static int ssp_subs[4];
+
+static void S(int n, ...)
+{
+	va_list ap;
+
+	va_start(ap, n);
+	while (n-- > 0)
+		ssp[ssp_pc++ - 0x400] = va_arg(ap, int);
+	va_end(ap);
+}
+
+// X, Y, A, AL
+static int ssp_reg(void)
+{
+	static const unsigned char regs[] = { 1, 2, 3, 15 };
+	return pick(regs);
+}
+
+// (ri): r0-r3 | j << 8 | mod << 2, r3 with mod is RAMx[mod]
+static int ssp_ptr(int mod)
+{
+	return rnd(0x400) & (mod ? 0x10f : 0x103);
+}
+
+// r0-r2 | j << 8
+static int ssp_ri(void)
+{
+	int r = rnd(6);
+	return (r >> 1) | (r & 1) << 8;
+}
+
+static int ssp_cond(void)
+{
+	static const unsigned short conds[] = { 0x000, 0x050, 0x150, 0x070, 0x170 };
+	return pick(conds);
+}
+
+// program PMC for PM4 reads or writes and do the blind access setting it
+static void ssp_pm_setup(int w)
+{
+	int m = 0x0018 | rnd(5) << 11;		// DRAM, inc 0-8
+
+	m |= rnd(2) << 15;			// maybe decrementing
+	if (w || rnd(2))
+		S(4, 0x08e0, 0x2000 + rnd(0x4000), 0x08e0, m);
+	else
+		S(4, 0x08e0, rnd(0xe000), 0x08e0, 0x0800);	// ROM
+	S(1, w ? 0x00c0 : 0x000c);		// ld PM4, - / ld -, PM4
+}
+
+static void ssp_simple(void)
+{
+	int k = rnd(0x10000), d = ssp_reg(), s = ssp_reg();
+
+	switch (rnd(20)) {
+	case 0: S(2, 0x0800 | d << 4, k); break;		// ldi d, imm
+	case 1:							// ld d, s
+		if (k & 3)
+			S(1, d << 4 | s);
+		else
+			S(1, d << 4 | 7);			// P
+		break;
+	case 2: S(1, 0x0200 | d << 4 | ssp_ptr(1)); break;	// ld d, (ri)
+	case 3: S(1, 0x0400 | s << 4 | ssp_ptr(1)); break;	// ld (ri), s
+	case 4: S(2, 0x0c00 | ssp_ptr(1), k); break;		// ldi (ri), imm
+	case 5: S(1, 0x0a00 | d << 4 | ssp_ptr(0)); break;	// ld d, ((ri))
+	case 6: S(1, 0x0e00 | (k & 0x1ff)); break;		// ld adr, a
+	case 7: S(1, 0x0600 | (k & 0x1ff)); break;		// ld A, adr
+	case 8: S(1, 0x1200 | d << 4 | ssp_ri()); break;	// ld d, ri
+	case 9: S(1, 0x1400 | s << 4 | ssp_ri()); break;	// ld ri, s
+	case 10:						// ldi ri, simm
+		S(1, 0x1800 | (k % 3 + (k & 4)) << 8 | (k & 0xff));
+		break;
+	case 11: S(1, 0x4a00 | d << 4); break;			// ld d, (a)
+	case 12:						// mod cond, op
+		for (d = k & 3; d >= 0; d--) {
+			static const unsigned char mods[] = { 2, 3, 6, 7 };
+			int op = pick(mods);
+			S(1, 0x9000 | ssp_cond() | op);
+		}
+		break;
+	case 13: {						// mpys, mpya, mld
+		static const unsigned short mul[] = { 0x3600, 0x9600, 0xb600 };
+		S(1, pick(mul) | (k & 0xff));
+		break;
+	}
+	case 14: S(2, 0x0840, k & 0xa007); break;		// ldi ST: RPL, N, Z
+	case 15:						// PM4
+		switch (k & 7) {
+		case 0: ssp_pm_setup(1); break;
+		case 1: ssp_pm_setup(0); break;
+		case 2:
+		case 3:
+		case 4: S(1, 0x00c0 | s); break;		// ld PM4, s
+		default: S(1, 0x000c | d << 4); break;		// ld d, PM4
+		}
+		break;
+	default: {						// OP a, ...
+		static const unsigned char aops[] = { 1, 3, 4, 5, 6, 7 };
+		int op = pick(aops) << 13;
+
+		switch (k % 7) {
+		case 0: S(1, op | ((k & 0x30) ? s : 7)); break;	// s or P
+		case 1: S(1, op | 0x0200 | ssp_ptr(1)); break;	// (ri)
+		case 2: S(1, op | 0x0600 | (k & 0x1ff)); break;	// adr
+		case 3: S(2, op | 0x0800, rnd(0x10000)); break;	// imm
+		case 4: S(1, op | 0x0a00 | ssp_ptr(0)); break;	// ((ri))
+		case 5: S(1, op | 0x1200 | ssp_ri()); break;	// ri
+		case 6: S(1, op | 0x1900 | (k >> 8)); break;	// simm
+		}
+		break;
+	}
+	}
+}
+
+// A to SSP_SAVE, count to the stack
+static void ssp_push_count(int count)
+{
+	S(4, 0x0e00 | SSP_SAVE, 0x0830, count, 0x0053);
+	S(1, 0x0600 | SSP_SAVE);
+}
+
+// decrement the count, loop to top while not zero, pop it when done.
+// A is restored but AL is cleared
+static void ssp_loop_end(int top)
+{
+	S(5, 0x0e00 | SSP_SAVE, 0x0035, 0xb9ff, 0x3901, 0x0053);
+	S(4, 0x0600 | SSP_SAVE, 0x4c50, top, 0x0005);
+}
+
+static void ssp_block(int depth, int size)
+{
+	int i, k, p;
+
+	for (i = 0; i < size; i++) {
+		k = rnd(16);
+		if (k < 10)
+			ssp_simple();
+		else if (k < 12) {
+			// forward bra cond
+			S(2, 0x4c00 | ssp_cond(), 0);
+			p = ssp_pc;
+			for (k = rnd(4) + 1; k > 0; k--)
+				ssp_simple();
+			ssp[p - 1 - 0x400] = ssp_pc;
+		}
+		else if (k < 13) {
+			ssp_push_count(rnd(5) + 2);
+			p = ssp_pc;
+			for (k = rnd(8) + 1; k > 0; k--)
+				ssp_simple();
+			ssp_loop_end(p);
+		}
+		else if (k < 14)
+			S(2, 0x4800 | ssp_cond(), SSP_IRAM);
+		else if (depth == 0) {
+			p = ssp_subs[rnd(4)];
+			S(2, 0x4800 | ssp_cond(), p);
+		}
+	}
+}
+
+// The SSP runs random code out of ROM and IRAM, with PM4 going to DRAM
+// and ROM, and stores its registers to DRAM when done. IRAM is written
+// once only, the recompiler keeps IRAM blocks for the contexts Virtua
+// Racing uses and doesn't look at anything else.
+static void make_svp(int outer)
+{
+	unsigned short iram[32];
+	int i, len, top, start;
+
+	rom_size = 0x20000;
+	rom = calloc(rom_size, 1);
+	ssp = calloc(0x8000, 2);
+	if (rom == NULL || ssp == NULL)
+		fail("out of memory");
+
+	// 68k: spin
+	w32(0, 0x00ff0000);
+	w32(4, 0x200);
+	memcpy(rom + 0x100, "SEGA MEGA DRIVE ", 16);
+	memcpy(rom + 0x150, "Virtua Racing", 13);
+	w16(0x200, 0x60fe);			// bra *
+
+	// subroutines first, so that calls know where they are
+	ssp_pc = SSP_START;
+	for (i = 0; i < 4; i++) {
+		ssp_subs[i] = ssp_pc;
+		ssp_block(1, 12);
+		S(1, 0x0065);			// ret
+	}
+	// the IRAM routine is assembled here and then copied
+	start = ssp_pc;
+	while (ssp_pc - start < 12)
+		ssp_simple();
+	S(1, 0x0065);
+	len = ssp_pc - start;
+	memcpy(iram, &ssp[start - 0x400], len * 2);
+	ssp_pc = 0x400;
+	S(2, 0x4c00, start);			// skip "OHMP"
+	ssp_pc = start;
+
+	// registers, RAM, PM4 modes
+	for (i = 1; i < 4; i++)
+		S(2, 0x0800 | i << 4, rnd(0x10000));
+	S(2, 0x08f0, rnd(0x10000));
+	for (i = 0; i < 8; i++)
+		if ((i & 3) != 3)
+			S(1, 0x1800 | i << 8 | rnd(256));
+	for (i = 0; i < 16; i++) {
+		int ptr = ssp_ptr(1);
+		S(2, 0x0c00 | ptr, rnd(0x10000));
+	}
+	S(5, 0x08e0, 0x8000 | SSP_IRAM, 0x08e0, 0x081c, 0x00c0);
+	for (i = 0; i < len; i++)
+		S(3, 0x0810, iram[i], 0x00c1);	// ldi X, w; ld PM4, X
+	ssp_pm_setup(0);
+	ssp_pm_setup(1);
+
+	ssp_push_count(outer);
+	top = ssp_pc;
+	for (i = 0; i < 6; i++)
+		ssp_block(0, 30);
+	ssp_loop_end(top);
+
+	// registers to DRAM at 0xf000 and spin
+	S(5, 0x08e0, 0xf000, 0x08e0, 0x0818, 0x00c0);
+	S(6, 0x00c1, 0x00c2, 0x00c3, 0x00cf, 0x00c4, 0x00c7); // X Y A AL ST P
+	for (i = 0; i < 8; i++)
+		if ((i & 3) != 3)
+			S(1, 0x12c0 | (i & 3) | (i & 4) << 6);	// ld PM4, ri
+	S(2, 0x4c00, ssp_pc);
+	if (ssp_pc > SSP_END)
+		fail("ssp code too large");
+
+	for (i = 0x400; i < ssp_pc; i++)
+		w16(i * 2, ssp[i - 0x400]);
+	memcpy(rom + 0x810, "OHMP", 4);
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *f;
+
+	if (argc != 4) {
+		fprintf(stderr, "usage: %s <32x|sms|md|68k|68kram|svp|fm> <seed> <out>\n", argv[0]);
+		return 1;
+	}
+	rnd_state = strtoul(argv[2], NULL, 0) * 2654435761u + 1;
+	if (rnd_state == 0)
+		rnd_state = 1;
+
+	if (strcmp(argv[1], "32x") == 0)
+		make_32x(200);
+	else if (strcmp(argv[1], "sms") == 0)
+		make_z80(0);
+	else if (strcmp(argv[1], "md") == 0)
+		make_z80(1);
+	else if (strcmp(argv[1], "68k") == 0)
+		make_m68k(0);
+	else if (strcmp(argv[1], "68kram") == 0)
+		make_m68k(1);
+	else if (strcmp(argv[1], "svp") == 0)
+		make_svp(200);
+	else if (strcmp(argv[1], "fm") == 0)
+		make_fm();
+	else {
+		fprintf(stderr, "mkrandrom: unknown system %s\n", argv[1]);
+		return 1;
+	}
+
+	f = fopen(argv[3], "wb");
+	if (f == NULL) {
+		perror(argv[3]);
+		return 1;
+	}
+	fwrite(rom, 1, rom_size, f);
+	fclose(f);
+	return 0;
+}
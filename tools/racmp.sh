@@ -0,0 +1,47 @@
+#!/bin/sh
+# run random test ROMs with and without run-ahead and compare the emulated
+# memory and the sound, see mkrandrom.c
+#
+# usage: tools/racmp.sh <fm|md|sms|32x|svp> <first seed> <last seed> [frames] [run-ahead]
+# needs picodrive_bench (make -f Makefile.libretro bench=1 picodrive_bench)
+# Run-ahead shows a later frame, so video is not compared. Everything
+# else is, every frame: the snapshot restore must leave the real frame's
+# state, and the sound comes from the real frames only. 32x, svp: the
+# sh2s/SSP1601 are resynced to the 68k on restore, so only the memory
+# after the program is done and the sound (hashed over all frames) are.
+
+top=$(dirname "$0")/..
+bench=${BENCH:-$top/picodrive_bench}
+tmp=${TMPDIR:-/tmp}/racmp.$$
+sys=$1; first=$2; last=$3; frames=${4:-300}; ahead=${5:-2}
+
+case "$sys" in
+fm|md|sms) cmp_lines=$frames ;;
+32x|svp) cmp_lines=1 ;;
+*) last= ;;
+esac
+[ -n "$last" ] || { echo "usage: $0 <fm|md|sms|32x|svp> <first seed> <last seed> [frames] [run-ahead]"; exit 1; }
+[ -x "$bench" ] || { echo "$bench not built"; exit 1; }
+make -s -C "$top/tools" mkrandrom || exit 1
+
+mkdir -p "$tmp" || exit 1
+trap 'rm -rf "$tmp"' EXIT
+fails=0
+seed=$first
+while [ "$seed" -le "$last" ]; do
+	"$top/tools/mkrandrom" "$sys" "$seed" "$tmp/rom" || exit 1
+	for ra in disabled $ahead; do
+		"$bench" -n "$frames" -o picodrive_runahead=$ra -d "$tmp/$ra" \
+			"$tmp/rom" > /dev/null 2>&1 || echo "seed $seed: run-ahead $ra run failed"
+	done
+	# frame number, the ram/vram/zram/sdram/dram hashes and the sound
+	tail -n $cmp_lines "$tmp/disabled" | cut -d' ' -f1-6,8 > "$tmp/a"
+	tail -n $cmp_lines "$tmp/$ahead" | cut -d' ' -f1-6,8 > "$tmp/b"
+	if ! cmp -s "$tmp/a" "$tmp/b"; then
+		echo "seed $seed: differs"
+		fails=$((fails + 1))
+	fi
+	seed=$((seed + 1))
+done
+echo "$((last - first + 1)) roms, $fails differ"
+[ "$fails" -eq 0 ]